@@ -22,12 +22,12 @@
 #include <boost/filesystem/convenience.hpp>
 #include <boost/program_options.hpp>
 #include <iostream>
-#include <map>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 enum TokenType : int8_t
@@ -50,24 +50,396 @@ struct Stream
 
 Stream stringStream;
 std::vector<Stream> streams;
-std::map<std::string, int> streamIndex;
+std::unordered_map<std::string, int> streamIndex;
 std::vector<int> streamStack;
 
 std::vector<int64_t> labels;
 std::vector<std::string> labelNames;
-std::map<std::string, int> labelIndex;
+std::unordered_map<std::string, int> labelIndex;
 
 std::vector<std::string> preText, postText;
 
 const char *skipWhitespace(const char *p)
 {
-    if (p == nullptr)
-        return "";
     while (*p == ' ' || *p == '\t')
         p++;
     return p;
 }
 
+// Split off the next word of a line, in the way strtok(p, " \t\r\n") would
+char *nextWord(char *&p)
+{
+    while (*p == ' ' || *p == '\t')
+        p++;
+    char *word = p;
+    while (*p != 0 && *p != ' ' && *p != '\t')
+        p++;
+    if (*p != 0)
+        *(p++) = 0;
+    return word;
+}
+
+// Reads lines of any length from a file without per-line allocation. Line endings are stripped.
+struct LineReader
+{
+    FILE *f;
+    std::vector<char> buf = std::vector<char>(1 << 20);
+    size_t start = 0, end = 0;
+    bool eof = false;
+
+    LineReader(FILE *f) : f(f) {}
+
+    char *next()
+    {
+        while (true) {
+            char *nl = (char *)memchr(buf.data() + start, '\n', end - start);
+            if (nl == nullptr && eof && start < end)
+                nl = buf.data() + end; // last line without newline, buf always has room for the terminator
+            if (nl != nullptr) {
+                char *line = buf.data() + start;
+                start = (nl - buf.data()) + 1;
+                *nl = 0;
+                if (nl > line && nl[-1] == '\r')
+                    nl[-1] = 0;
+                if (start > end)
+                    start = end;
+                return line;
+            }
+            if (eof)
+                return nullptr;
+            // Move the partial line to the front and read more, growing the buffer if a line doesn't fit
+            memmove(buf.data(), buf.data() + start, end - start);
+            end -= start;
+            start = 0;
+            if (end + 1 >= buf.size())
+                buf.resize(buf.size() * 2);
+            size_t n = fread(buf.data() + end, 1, buf.size() - end - 1, f);
+            end += n;
+            if (n == 0)
+                eof = true;
+        }
+    }
+};
+
+int getLabel(const std::string &label, bool debug, bool *created = nullptr)
+{
+    auto found = labelIndex.find(label);
+    if (created != nullptr)
+        *created = (found == labelIndex.end());
+    if (found != labelIndex.end())
+        return found->second;
+    int idx = labels.size();
+    labelIndex.emplace(label, idx);
+    if (debug)
+        labelNames.push_back(label);
+    labels.push_back(-1);
+    return idx;
+}
+
+// Writes the output blob in fixed size chunks, so it never has to be held in memory as a whole
+struct BlobWriter
+{
+    FILE *f;
+    bool writeC;
+    std::vector<uint8_t> chunk;
+    int64_t written = 0;
+    // C string output needs one byte of lookahead to decide how to escape the previous byte
+    bool havePending = false;
+    uint8_t pending = 0;
+    int column = 1;
+
+    BlobWriter(FILE *f, bool writeC) : f(f), writeC(writeC) { chunk.reserve(1 << 20); }
+
+    void put(uint8_t d)
+    {
+        chunk.push_back(d);
+        if (chunk.size() == chunk.capacity())
+            flush();
+    }
+
+    void flush()
+    {
+        if (writeC) {
+            for (auto d : chunk)
+                putC(d, true);
+        } else if (!chunk.empty()) {
+            fwrite(chunk.data(), chunk.size(), 1, f);
+        }
+        written += chunk.size();
+        chunk.clear();
+    }
+
+    void putC(uint8_t next, bool haveNext)
+    {
+        if (!havePending) {
+            pending = next;
+            havePending = haveNext;
+            return;
+        }
+        uint8_t d = pending;
+        if (column > 70) {
+            fputc('\"', f);
+            fputc('\n', f);
+            column = 0;
+        }
+        if (column == 0) {
+            fputc('\"', f);
+            column = 1;
+        }
+        if (d < 32 || d >= 127) {
+            if (haveNext && (next < '0' || '9' < next))
+                column += fprintf(f, "\\%o", int(d));
+            else
+                column += fprintf(f, "\\%03o", int(d));
+        } else if (d == '\"' || d == '\'' || d == '\\') {
+            fputc('\\', f);
+            fputc(d, f);
+            column += 2;
+        } else {
+            fputc(d, f);
+            column++;
+        }
+        pending = next;
+        havePending = haveNext;
+    }
+
+    void finish()
+    {
+        flush();
+        if (writeC)
+            putC(0, false);
+    }
+};
+
+void pushStream(const std::string &name)
+{
+    auto found = streamIndex.find(name);
+    if (found == streamIndex.end()) {
+        found = streamIndex.emplace(name, int(streams.size())).first;
+        streams.resize(streams.size() + 1);
+        streams.back().name = name;
+    }
+    streamStack.push_back(found->second);
+}
+
+void addToken(Stream &s, TokenType type, uint32_t value, const char *comment, bool debug)
+{
+    s.tokenTypes.push_back(type);
+    s.tokenValues.push_back(value);
+    if (debug)
+        s.tokenComments.push_back(comment);
+}
+
+void addString(const char *value, const char *comment, bool debug)
+{
+    std::string label = "str:";
+    label += value;
+    bool created;
+    int labelIdx = getLabel(label, debug, &created);
+    addToken(streams.at(streamStack.back()), TOK_REF, labelIdx, comment, debug);
+    // All refs resolve to the same label, so repeated strings only need to be emitted once
+    if (!created)
+        return;
+
+    addToken(stringStream, TOK_ALIGN, 0, "", debug);
+    addToken(stringStream, TOK_LABEL, labelIdx, "", debug);
+    while (1) {
+        char char_comment[4] = {'\'', *value, '\'', 0};
+        if (*value < 32 || *value >= 127)
+            char_comment[0] = 0;
+        addToken(stringStream, TOK_U8, *value, char_comment, debug);
+        if (*value == 0)
+            break;
+        value++;
+    }
+}
+
+void readText(FILE *fileIn, bool debug, bool &offset32)
+{
+    LineReader reader(fileIn);
+    char *line;
+    while ((line = reader.next()) != nullptr) {
+        char *p = line;
+        const char *cmd = nextWord(p);
+        if (*cmd == 0)
+            continue;
+
+        if (!strcmp(cmd, "offset32")) {
+            offset32 = true;
+            continue;
+        }
+
+        if (!strcmp(cmd, "pre")) {
+            preText.push_back(skipWhitespace(p));
+            continue;
+        }
+
+        if (!strcmp(cmd, "post")) {
+            postText.push_back(skipWhitespace(p));
+            continue;
+        }
+
+        if (!strcmp(cmd, "push")) {
+            pushStream(nextWord(p));
+            continue;
+        }
+
+        if (!strcmp(cmd, "pop")) {
+            streamStack.pop_back();
+            continue;
+        }
+
+        if (!strcmp(cmd, "label") || !strcmp(cmd, "ref")) {
+            const char *label = nextWord(p);
+            const char *comment = skipWhitespace(p);
+            addToken(streams.at(streamStack.back()), cmd[0] == 'l' ? TOK_LABEL : TOK_REF, getLabel(label, debug),
+                     comment, debug);
+            continue;
+        }
+
+        if (cmd[0] == 'u' && (!strcmp(cmd, "u8") || !strcmp(cmd, "u16") || !strcmp(cmd, "u32"))) {
+            const char *value = nextWord(p);
+            const char *comment = skipWhitespace(p);
+            addToken(streams.at(streamStack.back()), cmd[1] == '8' ? TOK_U8 : cmd[1] == '1' ? TOK_U16 : TOK_U32,
+                     atoll(value), comment, debug);
+            continue;
+        }
+
+        if (!strcmp(cmd, "align")) {
+            addToken(streams.at(streamStack.back()), TOK_ALIGN, 0, "", debug);
+            continue;
+        }
+
+        if (!strcmp(cmd, "str")) {
+            char *value = (char *)skipWhitespace(p);
+            assert(*value != 0);
+            char *end = strchr(value + 1, *value);
+            assert(end != nullptr);
+            *end = 0;
+            addString(value + 1, skipWhitespace(end + 1), debug);
+            continue;
+        }
+
+        assert(0);
+    }
+}
+
+// Binary input, as written by BinaryBBAWriter in xilinx/python/bba.py. Each command is an opcode byte followed by
+// LEB128 varints and length-prefixed strings. Label names are sent once, and then referred to by their index.
+static const char binaryMagic[8] = {'B', 'B', 'A', 'B', 'I', 'N', '0', '1'};
+
+enum BinaryOp : uint8_t
+{
+    OP_PRE = 1,
+    OP_POST,
+    OP_PUSH,
+    OP_POP,
+    OP_OFFSET32,
+    OP_LABEL_NAME,
+    OP_LABEL,
+    OP_REF,
+    OP_U8,
+    OP_U16,
+    OP_U32,
+    OP_ALIGN,
+    OP_STR,
+    OP_END
+};
+
+struct BinaryReader
+{
+    FILE *f;
+    std::vector<uint8_t> buf = std::vector<uint8_t>(1 << 20);
+    size_t pos = 0, end = 0;
+
+    BinaryReader(FILE *f) : f(f) {}
+
+    uint8_t byte()
+    {
+        if (pos == end) {
+            end = fread(buf.data(), 1, buf.size(), f);
+            pos = 0;
+            if (end == 0) {
+                printf("Unexpected end of binary input\n");
+                exit(-1);
+            }
+        }
+        return buf[pos++];
+    }
+
+    uint32_t varint()
+    {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t b = byte();
+            value |= uint32_t(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return value;
+        }
+    }
+
+    void str(std::string &s)
+    {
+        s.resize(varint());
+        for (auto &c : s)
+            c = byte();
+    }
+};
+
+void readBinary(FILE *fileIn, bool debug, bool &offset32)
+{
+    BinaryReader reader(fileIn);
+    std::vector<int> fileLabels;
+    std::string text;
+    while (true) {
+        uint8_t op = reader.byte();
+        switch (op) {
+        case OP_PRE:
+        case OP_POST:
+            reader.str(text);
+            (op == OP_PRE ? preText : postText).push_back(text);
+            break;
+        case OP_PUSH:
+            reader.str(text);
+            pushStream(text);
+            break;
+        case OP_POP:
+            streamStack.pop_back();
+            break;
+        case OP_OFFSET32:
+            offset32 = true;
+            break;
+        case OP_LABEL_NAME:
+            reader.str(text);
+            fileLabels.push_back(getLabel(text, debug));
+            break;
+        case OP_LABEL:
+        case OP_REF:
+            addToken(streams.at(streamStack.back()), op == OP_LABEL ? TOK_LABEL : TOK_REF,
+                     fileLabels.at(reader.varint()), "", debug);
+            break;
+        case OP_U8:
+        case OP_U16:
+        case OP_U32:
+            addToken(streams.at(streamStack.back()), op == OP_U8 ? TOK_U8 : op == OP_U16 ? TOK_U16 : TOK_U32,
+                     reader.varint(), "", debug);
+            break;
+        case OP_ALIGN:
+            addToken(streams.at(streamStack.back()), TOK_ALIGN, 0, "", debug);
+            break;
+        case OP_STR:
+            reader.str(text);
+            addString(text.c_str(), "", debug);
+            break;
+        case OP_END:
+            return;
+        default:
+            printf("Invalid opcode %d in binary input\n", int(op));
+            exit(-1);
+        }
+    }
+}
+
 int main(int argc, char **argv)
 {
     bool debug = false;
@@ -76,7 +448,6 @@ int main(int argc, char **argv)
     bool writeC = false;
     bool offset32 = false;
     bool writeE = false;
-    char buffer[512];
 
     namespace po = boost::program_options;
     po::positional_options_description pos;
@@ -137,131 +508,22 @@ int main(int argc, char **argv)
         exit(-1);
     }
 
-    FILE *fileIn = fopen(files.at(0).c_str(), "rt");
+    FILE *fileIn = fopen(files.at(0).c_str(), "rb");
     assert(fileIn != nullptr);
 
     FILE *fileOut = fopen(files.at(1).c_str(), writeC ? "wt" : "wb");
     assert(fileOut != nullptr);
 
-    while (fgets(buffer, 512, fileIn) != nullptr) {
-        std::string cmd = strtok(buffer, " \t\r\n");
-        if (cmd == "offset32") {
-            offset32 = true;
-            continue;
-        }
-
-        if (cmd == "pre") {
-            const char *p = skipWhitespace(strtok(nullptr, "\r\n"));
-            preText.push_back(p);
-            continue;
-        }
-
-        if (cmd == "post") {
-            const char *p = skipWhitespace(strtok(nullptr, "\r\n"));
-            postText.push_back(p);
-            continue;
-        }
-
-        if (cmd == "push") {
-            const char *p = strtok(nullptr, " \t\r\n");
-            if (streamIndex.count(p) == 0) {
-                streamIndex[p] = streams.size();
-                streams.resize(streams.size() + 1);
-                streams.back().name = p;
-            }
-            streamStack.push_back(streamIndex.at(p));
-            continue;
-        }
-
-        if (cmd == "pop") {
-            streamStack.pop_back();
-            continue;
-        }
-
-        if (cmd == "label" || cmd == "ref") {
-            const char *label = strtok(nullptr, " \t\r\n");
-            const char *comment = skipWhitespace(strtok(nullptr, "\r\n"));
-            Stream &s = streams.at(streamStack.back());
-            if (labelIndex.count(label) == 0) {
-                labelIndex[label] = labels.size();
-                if (debug)
-                    labelNames.push_back(label);
-                labels.push_back(-1);
-            }
-            s.tokenTypes.push_back(cmd == "label" ? TOK_LABEL : TOK_REF);
-            s.tokenValues.push_back(labelIndex.at(label));
-            if (debug)
-                s.tokenComments.push_back(comment);
-            continue;
-        }
-
-        if (cmd == "u8" || cmd == "u16" || cmd == "u32") {
-            const char *value = strtok(nullptr, " \t\r\n");
-            const char *comment = skipWhitespace(strtok(nullptr, "\r\n"));
-            Stream &s = streams.at(streamStack.back());
-            s.tokenTypes.push_back(cmd == "u8" ? TOK_U8 : cmd == "u16" ? TOK_U16 : TOK_U32);
-            s.tokenValues.push_back(atoll(value));
-            if (debug)
-                s.tokenComments.push_back(comment);
-            continue;
-        }
-
-        if (cmd == "align") {
-            Stream &s = streams.at(streamStack.back());
-            s.tokenTypes.push_back(TOK_ALIGN);
-            s.tokenValues.push_back(0);
-            if (debug)
-                s.tokenComments.push_back("");
-            continue;
-        }
-
-        if (cmd == "str") {
-            const char *value = skipWhitespace(strtok(nullptr, "\r\n"));
-            assert(*value != 0);
-            char *end = strchr((char *)value + 1, *value);
-            assert(end != nullptr);
-            *end = 0;
-            value += 1;
-            const char *comment = skipWhitespace(strtok(end + 1, "\r\n"));
-            std::string label = std::string("str:") + value;
-            Stream &s = streams.at(streamStack.back());
-            if (labelIndex.count(label) == 0) {
-                labelIndex[label] = labels.size();
-                if (debug)
-                    labelNames.push_back(label);
-                labels.push_back(-1);
-            }
-            s.tokenTypes.push_back(TOK_REF);
-            s.tokenValues.push_back(labelIndex.at(label));
-            if (debug)
-                s.tokenComments.push_back(comment);
-
-            stringStream.tokenTypes.push_back(TOK_ALIGN);
-            stringStream.tokenValues.push_back(0);
-            if (debug)
-                stringStream.tokenComments.push_back("");
-
-            stringStream.tokenTypes.push_back(TOK_LABEL);
-            stringStream.tokenValues.push_back(labelIndex.at(label));
-            stringStream.tokenComments.push_back("");
-            while (1) {
-                stringStream.tokenTypes.push_back(TOK_U8);
-                stringStream.tokenValues.push_back(*value);
-                if (debug) {
-                    char char_comment[4] = {'\'', *value, '\'', 0};
-                    if (*value < 32 || *value >= 127)
-                        char_comment[0] = 0;
-                    stringStream.tokenComments.push_back(char_comment);
-                }
-                if (*value == 0)
-                    break;
-                value++;
-            }
-            continue;
-        }
-
-        assert(0);
+    char magic[sizeof(binaryMagic)];
+    if (fread(magic, 1, sizeof(magic), fileIn) == sizeof(magic) && !memcmp(magic, binaryMagic, sizeof(magic))) {
+        readBinary(fileIn, debug, offset32);
+    } else {
+        rewind(fileIn);
+        readText(fileIn, debug, offset32);
     }
+    fclose(fileIn);
+    // The label names are only needed for debug output from here on
+    labelIndex.clear();
 
     if (verbose) {
         printf("Constructed %d streams:\n", int(streams.size()));
@@ -315,14 +577,33 @@ int main(int argc, char **argv)
         printf("total data (including strings): %.2f MB\n", double(cursor) / (1024 * 1024));
     }
 
-    std::vector<uint8_t> data(cursor);
+    int64_t totalSize = cursor;
+
+    if (writeC || writeE) {
+        for (auto &s : preText)
+            fprintf(fileOut, "%s\n", s.c_str());
+        fprintf(fileOut, "const char %s[%lld] =\n", streams[0].name.c_str(), (long long)totalSize + 1);
+    }
+    if (writeC)
+        fputc('\"', fileOut);
+    if (writeE) {
+        fprintf(fileOut, "#embed_str \"%s\"\n", boost::filesystem::basename(files.at(2)).c_str());
+        fprintf(fileOut, ";\n");
+    }
+
+    FILE *fileBin = fileOut;
+    if (writeE) {
+        fileBin = fopen(files.at(2).c_str(), "wb");
+        assert(fileBin != nullptr);
+    }
+    BlobWriter writer(fileBin, writeC);
 
     cursor = 0;
     for (auto &s : streams) {
         if (debug)
             printf("-- %s --\n", s.name.c_str());
 
-        for (int i = 0; i < int(s.tokenTypes.size()); i++) {
+        for (int64_t i = 0; i < int64_t(s.tokenTypes.size()); i++) {
             uint32_t value = s.tokenValues[i];
             int numBytes = 0;
 
@@ -347,56 +628,23 @@ int main(int argc, char **argv)
             case TOK_ALIGN:
                 if (cursor % 4 != 0)
                     numBytes = 4 - (cursor % 4);
+                value = 0;
                 break;
             default:
                 assert(0);
             }
 
-            if (bigEndian) {
-                switch (numBytes) {
-                case 4:
-                    data[cursor++] = value >> 24;
-                /* fall-through */
-                case 3:
-                    data[cursor++] = value >> 16;
-                /* fall-through */
-                case 2:
-                    data[cursor++] = value >> 8;
-                /* fall-through */
-                case 1:
-                    data[cursor++] = value;
-                /* fall-through */
-                case 0:
-                    break;
-                default:
-                    assert(0);
-                }
-            } else {
-                switch (numBytes) {
-                case 4:
-                    data[cursor + 3] = value >> 24;
-                /* fall-through */
-                case 3:
-                    data[cursor + 2] = value >> 16;
-                /* fall-through */
-                case 2:
-                    data[cursor + 1] = value >> 8;
-                /* fall-through */
-                case 1:
-                    data[cursor] = value;
-                /* fall-through */
-                case 0:
-                    break;
-                default:
-                    assert(0);
-                }
-                cursor += numBytes;
-            }
+            uint8_t bytes[4];
+            for (int k = 0; k < numBytes; k++)
+                bytes[k] = value >> (8 * (bigEndian ? (numBytes - 1 - k) : k));
+            for (int k = 0; k < numBytes; k++)
+                writer.put(bytes[k]);
+            cursor += numBytes;
 
             if (debug) {
                 printf("%08x ", cursor - numBytes);
-                for (int k = cursor - numBytes; k < cursor; k++)
-                    printf("%02x ", data[k]);
+                for (int k = 0; k < numBytes; k++)
+                    printf("%02x ", bytes[k]);
                 for (int k = numBytes; k < 4; k++)
                     printf("   ");
 
@@ -440,63 +688,18 @@ int main(int argc, char **argv)
         }
     }
 
-    assert(cursor == int64_t(data.size()));
-
-    if (writeC) {
-        for (auto &s : preText)
-            fprintf(fileOut, "%s\n", s.c_str());
-
-        fprintf(fileOut, "const char %s[%d] =\n\"", streams[0].name.c_str(), int64_t(data.size()) + 1);
-
-        cursor = 1;
-        for (int64_t i = 0; i < int64_t(data.size()); i++) {
-            auto d = data[i];
-            if (cursor > 70) {
-                fputc('\"', fileOut);
-                fputc('\n', fileOut);
-                cursor = 0;
-            }
-            if (cursor == 0) {
-                fputc('\"', fileOut);
-                cursor = 1;
-            }
-            if (d < 32 || d >= 127) {
-                if (i + 1 < int64_t(data.size()) && (data[i + 1] < '0' || '9' < data[i + 1]))
-                    cursor += fprintf(fileOut, "\\%o", int(d));
-                else
-                    cursor += fprintf(fileOut, "\\%03o", int(d));
-            } else if (d == '\"' || d == '\'' || d == '\\') {
-                fputc('\\', fileOut);
-                fputc(d, fileOut);
-                cursor += 2;
-            } else {
-                fputc(d, fileOut);
-                cursor++;
-            }
-        }
+    writer.finish();
+    assert(cursor == totalSize && writer.written == totalSize);
 
+    if (writeC)
         fprintf(fileOut, "\";\n");
-
+    if (writeC || writeE) {
         for (auto &s : postText)
             fprintf(fileOut, "%s\n", s.c_str());
-    } else if (writeE) {
-        for (auto &s : preText)
-            fprintf(fileOut, "%s\n", s.c_str());
-
-        fprintf(fileOut, "const char %s[%d] =\n", streams[0].name.c_str(), int(data.size()) + 1);
-        fprintf(fileOut, "#embed_str \"%s\"\n", boost::filesystem::basename(files.at(2)).c_str());
-        fprintf(fileOut, ";\n");
-
-        for (auto &s : postText)
-            fprintf(fileOut, "%s\n", s.c_str());
-
-        FILE *fileBin = fopen(files.at(2).c_str(), "wb");
-        assert(fileBin != nullptr);
-        fwrite(data.data(), int(data.size()), 1, fileBin);
-        fclose(fileBin);
-    } else {
-        fwrite(data.data(), int64_t(data.size()), 1, fileOut);
     }
+    if (fileBin != fileOut)
+        fclose(fileBin);
+    fclose(fileOut);
 
     return 0;
 }
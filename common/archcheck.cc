@@ -17,8 +17,10 @@
  *
  */
 
+#include <thread>
 #include "log.h"
 #include "nextpnr.h"
+#include "thread_pool.h"
 
 #if 0
 #define dbg(...) log(__VA_ARGS__)
@@ -30,89 +32,156 @@ USING_NEXTPNR_NAMESPACE
 
 namespace {
 
-void archcheck_names(const Context *ctx)
+// Runs func(begin, end, failures) over [0, count) in small chunks handed out to the worker threads, then reports the
+// failures of all chunks in order, one line each. Returns the number of failures.
+template <typename F> int archcheck_parallel(const Context *ctx, int threads, int count, F func)
 {
-    log_info("Checking entity names.\n");
+    int chunk = std::max(1, count / (threads * 16));
+    int num_chunks = (count + chunk - 1) / chunk;
+    std::vector<std::vector<std::string>> failures(num_chunks);
+    ctx->threadPool().parallel_for(
+            num_chunks, 1, [&](size_t i) { func(i * chunk, std::min(count, int(i + 1) * chunk), failures.at(i)); },
+            threads);
+    int total = 0;
+    for (auto &chunk_failures : failures)
+        for (auto &line : chunk_failures) {
+            log_nonfatal_error("%s\n", line.c_str());
+            ++total;
+        }
+    return total;
+}
 
+int archcheck_names(const Context *ctx, int threads)
+{
+    log_info("Checking entity names.\n");
+    int failures = 0;
+
+#ifdef ARCH_XILINX
+    // Names are built from the tile or site name and the name data of the tile type, so they are checked in those two
+    // parts, plus the wires of nodes
+    const ChipInfoPOD *chip = ctx->chip_info;
+    log_info("Checking tile type names..\n");
+    failures += archcheck_parallel(ctx, threads, chip->num_tiletypes, [&](int b, int e, std::vector<std::string> &f) {
+        ctx->archcheckTileTypeNames(b, e, f);
+    });
+    log_info("Checking tile and site names..\n");
+    failures += archcheck_parallel(ctx, threads, chip->num_tiles, [&](int b, int e, std::vector<std::string> &f) {
+        ctx->archcheckTileNames(b, e, f);
+    });
+    log_info("Checking node names..\n");
+    failures += archcheck_parallel(ctx, threads, chip->num_nodes, [&](int b, int e, std::vector<std::string> &f) {
+        ctx->archcheckNodeNames(b, e, f);
+    });
+#else
     log_info("Checking bel names..\n");
-    for (BelId bel : ctx->getBels()) {
-        IdString name = ctx->getBelName(bel);
-        BelId bel2 = ctx->getBelByName(name);
-        log_assert(bel == bel2);
-    }
+    std::vector<BelId> bels;
+    for (BelId bel : ctx->getBels())
+        bels.push_back(bel);
+    failures += archcheck_parallel(ctx, threads, int(bels.size()), [&](int b, int e, std::vector<std::string> &f) {
+        for (int i = b; i < e; i++) {
+            IdString name = ctx->getBelName(bels[i]);
+            if (ctx->getBelByName(name) != bels[i])
+                f.push_back(stringf("bel %s does not look up by name", name.c_str(ctx)));
+        }
+    });
 
     log_info("Checking wire names..\n");
-    for (WireId wire : ctx->getWires()) {
-        IdString name = ctx->getWireName(wire);
-        WireId wire2 = ctx->getWireByName(name);
-        log_assert(wire == wire2);
-    }
+    std::vector<WireId> wires;
+    for (WireId wire : ctx->getWires())
+        wires.push_back(wire);
+    failures += archcheck_parallel(ctx, threads, int(wires.size()), [&](int b, int e, std::vector<std::string> &f) {
+        for (int i = b; i < e; i++) {
+            IdString name = ctx->getWireName(wires[i]);
+            if (ctx->getWireByName(name) != wires[i])
+                f.push_back(stringf("wire %s does not look up by name", name.c_str(ctx)));
+        }
+    });
 
     log_info("Checking pip names..\n");
-    for (PipId pip : ctx->getPips()) {
-        IdString name = ctx->getPipName(pip);
-        PipId pip2 = ctx->getPipByName(name);
-        log_assert(pip == pip2);
-    }
+    std::vector<PipId> pips;
+    for (PipId pip : ctx->getPips())
+        pips.push_back(pip);
+    failures += archcheck_parallel(ctx, threads, int(pips.size()), [&](int b, int e, std::vector<std::string> &f) {
+        for (int i = b; i < e; i++) {
+            IdString name = ctx->getPipName(pips[i]);
+            if (ctx->getPipByName(name) != pips[i])
+                f.push_back(stringf("pip %s does not look up by name", name.c_str(ctx)));
+        }
+    });
+#endif
 
     log_break();
+    return failures;
 }
 
-void archcheck_locs(const Context *ctx)
+int archcheck_locs(const Context *ctx, int threads)
 {
     log_info("Checking location data.\n");
+    int failures = 0;
 
     log_info("Checking all bels..\n");
-    for (BelId bel : ctx->getBels()) {
-        log_assert(bel != BelId());
-        dbg("> %s\n", ctx->getBelName(bel).c_str(ctx));
-
-        Loc loc = ctx->getBelLocation(bel);
-        dbg("   ... %d %d %d\n", loc.x, loc.y, loc.z);
-
-        log_assert(0 <= loc.x);
-        log_assert(0 <= loc.y);
-        log_assert(0 <= loc.z);
-        log_assert(loc.x < ctx->getGridDimX());
-        log_assert(loc.y < ctx->getGridDimY());
-        log_assert(loc.z < ctx->getTileBelDimZ(loc.x, loc.y));
-
-        BelId bel2 = ctx->getBelByLocation(loc);
-        dbg("   ... %s\n", ctx->getBelName(bel2).c_str(ctx));
-        log_assert(bel == bel2);
-    }
-
-    log_info("Checking all locations..\n");
-    for (int x = 0; x < ctx->getGridDimX(); x++)
-        for (int y = 0; y < ctx->getGridDimY(); y++) {
-            dbg("> %d %d\n", x, y);
-            std::unordered_set<int> usedz;
-
-            for (int z = 0; z < ctx->getTileBelDimZ(x, y); z++) {
-                BelId bel = ctx->getBelByLocation(Loc(x, y, z));
-                if (bel == BelId())
-                    continue;
-                Loc loc = ctx->getBelLocation(bel);
-                dbg("   + %d %s\n", z, ctx->getBelName(bel).c_str(ctx));
-                log_assert(x == loc.x);
-                log_assert(y == loc.y);
-                log_assert(z == loc.z);
-                usedz.insert(z);
+    std::vector<BelId> bels;
+    for (BelId bel : ctx->getBels())
+        bels.push_back(bel);
+    failures += archcheck_parallel(ctx, threads, int(bels.size()), [&](int b, int e, std::vector<std::string> &f) {
+        for (int i = b; i < e; i++) {
+            BelId bel = bels[i];
+            dbg("> %s\n", ctx->getBelName(bel).c_str(ctx));
+
+            Loc loc = ctx->getBelLocation(bel);
+            dbg("   ... %d %d %d\n", loc.x, loc.y, loc.z);
+
+            if (loc.x < 0 || loc.y < 0 || loc.z < 0 || loc.x >= ctx->getGridDimX() || loc.y >= ctx->getGridDimY() ||
+                loc.z >= ctx->getTileBelDimZ(loc.x, loc.y)) {
+                f.push_back(stringf("bel %s has location (%d, %d, %d) outside the grid",
+                                    ctx->getBelName(bel).c_str(ctx), loc.x, loc.y, loc.z));
+                continue;
             }
 
-            for (BelId bel : ctx->getBelsByTile(x, y)) {
-                Loc loc = ctx->getBelLocation(bel);
-                dbg("   - %d %s\n", loc.z, ctx->getBelName(bel).c_str(ctx));
-                log_assert(x == loc.x);
-                log_assert(y == loc.y);
-                log_assert(usedz.count(loc.z));
-                usedz.erase(loc.z);
-            }
-
-            log_assert(usedz.empty());
+            BelId bel2 = ctx->getBelByLocation(loc);
+            dbg("   ... %s\n", ctx->getBelName(bel2).c_str(ctx));
+            if (bel != bel2)
+                f.push_back(stringf("bel %s at (%d, %d, %d) does not look up by location",
+                                    ctx->getBelName(bel).c_str(ctx), loc.x, loc.y, loc.z));
         }
+    });
+
+    log_info("Checking all locations..\n");
+    failures += archcheck_parallel(ctx, threads, ctx->getGridDimX(), [&](int b, int e, std::vector<std::string> &f) {
+        for (int x = b; x < e; x++)
+            for (int y = 0; y < ctx->getGridDimY(); y++) {
+                dbg("> %d %d\n", x, y);
+                std::unordered_set<int> usedz;
+
+                for (int z = 0; z < ctx->getTileBelDimZ(x, y); z++) {
+                    BelId bel = ctx->getBelByLocation(Loc(x, y, z));
+                    if (bel == BelId())
+                        continue;
+                    Loc loc = ctx->getBelLocation(bel);
+                    dbg("   + %d %s\n", z, ctx->getBelName(bel).c_str(ctx));
+                    if (x != loc.x || y != loc.y || z != loc.z)
+                        f.push_back(stringf("location (%d, %d, %d) has bel %s, which is at (%d, %d, %d)", x, y, z,
+                                            ctx->getBelName(bel).c_str(ctx), loc.x, loc.y, loc.z));
+                    usedz.insert(z);
+                }
+
+                for (BelId bel : ctx->getBelsByTile(x, y)) {
+                    Loc loc = ctx->getBelLocation(bel);
+                    dbg("   - %d %s\n", loc.z, ctx->getBelName(bel).c_str(ctx));
+                    if (x != loc.x || y != loc.y || !usedz.count(loc.z))
+                        f.push_back(stringf("bel %s in the bels of tile (%d, %d) is at (%d, %d, %d)",
+                                            ctx->getBelName(bel).c_str(ctx), x, y, loc.x, loc.y, loc.z));
+                    usedz.erase(loc.z);
+                }
+
+                if (!usedz.empty())
+                    f.push_back(stringf("tile (%d, %d) has %d bels missing from its bel list", x, y,
+                                        int(usedz.size())));
+            }
+    });
 
     log_break();
+    return failures;
 }
 
 void archcheck_conn(const Context *ctx)
@@ -137,9 +206,20 @@ void Context::archcheck() const
     log_info("Running architecture database integrity check.\n");
     log_break();
 
-    archcheck_names(this);
-    archcheck_locs(this);
+#ifdef ARCH_XILINX
+    int threads = std::max(1, settings.count(id("threads")) ? setting<int>("threads")
+                                                            : std::max<int>(1, std::thread::hardware_concurrency()));
+#else
+    // The lookup tables of the other arches may be built lazily on first use, so are not safe to share between threads
+    int threads = 1;
+#endif
+
+    int failures = archcheck_names(this, threads);
+    failures += archcheck_locs(this, threads);
     archcheck_conn(this);
+
+    if (failures > 0)
+        log_error("Architecture database integrity check failed with %d errors.\n", failures);
 }
 
 NEXTPNR_NAMESPACE_END
@@ -20,7 +20,11 @@
 #ifndef CHAIN_UTILS_H
 #define CHAIN_UTILS_H
 
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include "nextpnr.h"
+#include "thread_pool.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -30,40 +34,73 @@ struct CellChain
     std::vector<CellInfo *> cells;
 };
 
-// Generic chain finder
-template <typename F1, typename F2, typename F3>
-std::vector<CellChain> find_chains(const Context *ctx, F1 cell_type_predicate, F2 get_previous, F3 get_next,
-                                   size_t min_length = 2)
+// Generic chain finder, over cells that already pass the type predicate, in name order. The neighbours of every
+// candidate are looked up in parallel, so get_previous and get_next must only read the context. Chains are then
+// assembled serially, in the order of their first candidate, so the result doesn't depend on the thread count.
+template <typename F2, typename F3>
+std::vector<CellChain> find_chains(const Context *ctx, const std::vector<CellInfo *> &candidates, F2 get_previous,
+                                   F3 get_next, size_t min_length = 2)
 {
-    std::set<IdString> chained;
+    std::vector<CellInfo *> prev(candidates.size()), next(candidates.size());
+    int threads = std::max(1, ctx->settings.count(ctx->id("threads"))
+                                      ? ctx->setting<int>("threads")
+                                      : std::max<int>(1, std::thread::hardware_concurrency()));
+    threads = std::min<int>(threads, std::max<size_t>(1, candidates.size() / 256));
+    ctx->threadPool().parallel_for(
+            candidates.size(), 1,
+            [&](size_t i) {
+                prev.at(i) = get_previous(ctx, candidates.at(i));
+                next.at(i) = get_next(ctx, candidates.at(i));
+            },
+            threads);
+
+    // Chains can go through cells that aren't candidates, their neighbours are looked up as needed
+    std::unordered_map<const CellInfo *, size_t> cand_idx;
+    for (size_t i = 0; i < candidates.size(); i++)
+        cand_idx[candidates.at(i)] = i;
+    auto lookup_prev = [&](CellInfo *cell) {
+        auto fnd = cand_idx.find(cell);
+        return (fnd == cand_idx.end()) ? get_previous(ctx, cell) : prev.at(fnd->second);
+    };
+    auto lookup_next = [&](CellInfo *cell) {
+        auto fnd = cand_idx.find(cell);
+        return (fnd == cand_idx.end()) ? get_next(ctx, cell) : next.at(fnd->second);
+    };
+
+    std::unordered_set<IdString> chained;
     std::vector<CellChain> chains;
-    for (auto cell : sorted(ctx->cells)) {
-        if (chained.find(cell.first) != chained.end())
+    for (auto ci : candidates) {
+        if (chained.count(ci->name))
             continue;
-        CellInfo *ci = cell.second;
-        if (cell_type_predicate(ctx, ci)) {
-            CellInfo *start = ci;
-            CellInfo *prev_start = ci;
-            while (prev_start != nullptr) {
-                start = prev_start;
-                prev_start = get_previous(ctx, start);
-            }
-            CellChain chain;
-            CellInfo *end = start;
-            while (end != nullptr) {
-                if (chained.insert(end->name).second)
-                    chain.cells.push_back(end);
-                end = get_next(ctx, end);
-            }
-            if (chain.cells.size() >= min_length) {
-                chains.push_back(chain);
-                for (auto c : chain.cells)
-                    chained.insert(c->name);
-            }
+        CellInfo *start = ci;
+        CellInfo *prev_start = ci;
+        while (prev_start != nullptr) {
+            start = prev_start;
+            prev_start = lookup_prev(start);
+        }
+        CellChain chain;
+        CellInfo *end = start;
+        while (end != nullptr) {
+            if (chained.insert(end->name).second)
+                chain.cells.push_back(end);
+            end = lookup_next(end);
         }
+        if (chain.cells.size() >= min_length)
+            chains.push_back(chain);
     }
     return chains;
 }
 
+template <typename F1, typename F2, typename F3>
+std::vector<CellChain> find_chains(const Context *ctx, F1 cell_type_predicate, F2 get_previous, F3 get_next,
+                                   size_t min_length = 2)
+{
+    std::vector<CellInfo *> candidates;
+    for (auto cell : sorted(ctx->cells))
+        if (cell_type_predicate(ctx, cell.second))
+            candidates.push_back(cell.second);
+    return find_chains(ctx, candidates, get_previous, get_next, min_length);
+}
+
 NEXTPNR_NAMESPACE_END
 #endif
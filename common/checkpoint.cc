@@ -0,0 +1,615 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "checkpoint.h"
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstring>
+#include <fstream>
+#include "log.h"
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+/*
+ * Checkpoint file layout, all integers are native endian:
+ *
+ *   char[8]  magic "NPCKPT01"
+ *   u32      format version
+ *   str      chip database identity, see chipdb_identity()
+ *   u32      number of strings, followed by that many strs
+ *   body     design sections, in the order written by CheckpointWriter::write_design
+ *
+ * A str is a u32 length followed by the characters without a terminator. In the body, names and property values
+ * are u32 indices into the string table, and 0xFFFFFFFF stands for a null cell or net. The file is memory mapped
+ * on load and strings are only turned into IdStrings where the design needs them.
+ */
+
+std::string chipdb_identity(const Context *ctx)
+{
+    std::string ident = ctx->archId().str(ctx) + ";" + ctx->archArgsToId(ctx->archArgs()).str(ctx);
+#ifdef ARCH_XILINX
+    // Bels, wires and pips are stored by index, which is only meaningful for an identical chipdb
+    const ChipInfoPOD *chip = ctx->chip_info;
+    ident += stringf(";%s;%s;%d;%d;%d;%d", chip->name.get(), chip->generator.get(), chip->version, chip->num_tiles,
+                     chip->num_tiletypes, chip->num_nodes);
+#endif
+    return ident;
+}
+
+namespace {
+
+const char checkpoint_magic[8] = {'N', 'P', 'C', 'K', 'P', 'T', '0', '1'};
+const uint32_t checkpoint_version = 1;
+const uint32_t NO_STRING = 0xFFFFFFFF;
+
+struct CheckpointWriter
+{
+    CheckpointWriter(Context *ctx) : ctx(ctx){};
+    Context *ctx;
+
+    std::string body;
+    std::vector<const std::string *> strings;
+    std::unordered_map<std::string, uint32_t> string_index;
+    // IdString index to string table index
+    std::vector<uint32_t> id_index;
+
+    template <typename T> void put(T value) { body.append(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+    uint32_t add_string(const std::string &s)
+    {
+        auto ins = string_index.emplace(s, uint32_t(strings.size()));
+        if (ins.second)
+            strings.push_back(&(ins.first->first));
+        return ins.first->second;
+    }
+
+    void put_str(const std::string &s) { put<uint32_t>(add_string(s)); }
+
+    void put_id(IdString id)
+    {
+        if (id.index >= int(id_index.size()))
+            id_index.resize(id.index + 1, NO_STRING);
+        uint32_t &idx = id_index.at(id.index);
+        if (idx == NO_STRING)
+            idx = add_string(id.str(ctx));
+        put<uint32_t>(idx);
+    }
+
+    void put_net(const NetInfo *ni)
+    {
+        if (ni == nullptr)
+            put<uint32_t>(NO_STRING);
+        else
+            put_id(ni->name);
+    }
+
+    void put_cell(const CellInfo *ci)
+    {
+        if (ci == nullptr)
+            put<uint32_t>(NO_STRING);
+        else
+            put_id(ci->name);
+    }
+
+    template <typename Tdict> void put_dict(const Tdict &dict)
+    {
+        put<uint32_t>(dict.size());
+        for (auto &entry : dict) {
+            put_id(entry.first);
+            put<uint8_t>(entry.second.is_string);
+            if (entry.second.is_string) {
+                put_str(entry.second.str);
+            } else {
+                // Numeric values as a string of [01xz], lowest bit first
+                std::string bits = entry.second.to_string();
+                put_str(std::string(bits.rbegin(), bits.rend()));
+            }
+        }
+    }
+
+#ifdef ARCH_XILINX
+    void put_bel(BelId bel)
+    {
+        put<int32_t>(bel.tile);
+        put<int32_t>(bel.index);
+    }
+    void put_wire(WireId wire)
+    {
+        put<int32_t>(wire.tile);
+        put<int32_t>(wire.index);
+    }
+    void put_pip(PipId pip)
+    {
+        put<int32_t>(pip.tile);
+        put<int32_t>(pip.index);
+    }
+#else
+    void put_bel(BelId bel) { put_id(bel == BelId() ? IdString() : ctx->getBelName(bel)); }
+    void put_wire(WireId wire) { put_id(wire == WireId() ? IdString() : ctx->getWireName(wire)); }
+    void put_pip(PipId pip) { put_id(pip == PipId() ? IdString() : ctx->getPipName(pip)); }
+#endif
+
+    void write_design()
+    {
+        put_dict(ctx->settings);
+        put_dict(ctx->attrs);
+
+        put<uint32_t>(ctx->nets.size());
+        for (auto &net : ctx->nets) {
+            NetInfo *ni = net.second.get();
+            put_id(ni->name);
+            put_id(ni->hierpath);
+            put_dict(ni->attrs);
+        }
+
+        put<uint32_t>(ctx->cells.size());
+        for (auto &cell : ctx->cells) {
+            CellInfo *ci = cell.second.get();
+            put_id(ci->name);
+            put_id(ci->type);
+            put_id(ci->hierpath);
+            put_dict(ci->attrs);
+            put_dict(ci->params);
+            put<uint32_t>(ci->ports.size());
+            for (auto &port : ci->ports) {
+                put_id(port.first);
+                put<uint8_t>(port.second.type);
+                put_net(port.second.net);
+            }
+            put<uint32_t>(ci->pins.size());
+            for (auto &pin : ci->pins) {
+                put_id(pin.first);
+                put_id(pin.second);
+            }
+            put_bel(ci->bel);
+            put<uint8_t>(ci->belStrength);
+            put<int32_t>(ci->constr_x);
+            put<int32_t>(ci->constr_y);
+            put<int32_t>(ci->constr_z);
+            put<uint8_t>(ci->constr_abs_z);
+        }
+
+        // Relative placement constraints, in the same order as the cells section
+        for (auto &cell : ctx->cells) {
+            CellInfo *ci = cell.second.get();
+            put_cell(ci->constr_parent);
+            put<uint32_t>(ci->constr_children.size());
+            for (auto child : ci->constr_children)
+                put_cell(child);
+        }
+
+        // Net connectivity, in the same order as the nets section, keeping user order as-is
+        for (auto &net : ctx->nets) {
+            NetInfo *ni = net.second.get();
+            put_cell(ni->driver.cell);
+            put_id(ni->driver.port);
+            put<uint32_t>(ni->users.size());
+            for (auto &usr : ni->users) {
+                put_cell(usr.cell);
+                put_id(usr.port);
+            }
+        }
+
+        put<uint32_t>(ctx->ports.size());
+        for (auto &port : ctx->ports) {
+            put_id(port.first);
+            put<uint8_t>(port.second.type);
+            put_net(port.second.net);
+        }
+
+        put<uint32_t>(ctx->net_aliases.size());
+        for (auto &alias : ctx->net_aliases) {
+            put_id(alias.first);
+            put_id(alias.second);
+        }
+
+        // Routing, again in the same order as the nets section
+        for (auto &net : ctx->nets) {
+            NetInfo *ni = net.second.get();
+            put<uint32_t>(ni->wires.size());
+            for (auto &wire : ni->wires) {
+                put_wire(wire.first);
+                put_pip(wire.second.pip);
+                put<uint8_t>(wire.second.strength);
+            }
+        }
+    }
+
+    void write_file(std::ostream &out)
+    {
+        std::string header;
+        auto put_raw_str = [&](const std::string &s) {
+            uint32_t len = s.size();
+            header.append(reinterpret_cast<const char *>(&len), sizeof(len));
+            header.append(s);
+        };
+        header.append(checkpoint_magic, sizeof(checkpoint_magic));
+        header.append(reinterpret_cast<const char *>(&checkpoint_version), sizeof(checkpoint_version));
+        put_raw_str(chipdb_identity(ctx));
+        uint32_t num_strings = strings.size();
+        header.append(reinterpret_cast<const char *>(&num_strings), sizeof(num_strings));
+        for (auto s : strings)
+            put_raw_str(*s);
+        out.write(header.data(), header.size());
+        out.write(body.data(), body.size());
+    }
+};
+
+struct CheckpointReader
+{
+    CheckpointReader(Context *ctx, const std::string &filename) : ctx(ctx), filename(filename){};
+    Context *ctx;
+    const std::string &filename;
+
+    const char *ptr = nullptr, *end = nullptr;
+    // Entries of the string table, pointing into the mapped file
+    std::vector<std::pair<const char *, uint32_t>> strings;
+    std::vector<IdString> ids;
+    std::vector<bool> id_valid;
+
+    NPNR_NORETURN void truncated() { log_error("Checkpoint file '%s' is truncated or corrupt.\n", filename.c_str()); }
+
+    template <typename T> T get()
+    {
+        if (size_t(end - ptr) < sizeof(T))
+            truncated();
+        T value;
+        memcpy(&value, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return value;
+    }
+
+    std::pair<const char *, uint32_t> get_raw_str()
+    {
+        uint32_t len = get<uint32_t>();
+        if (size_t(end - ptr) < len)
+            truncated();
+        std::pair<const char *, uint32_t> result(ptr, len);
+        ptr += len;
+        return result;
+    }
+
+    uint32_t get_str_index()
+    {
+        uint32_t idx = get<uint32_t>();
+        if (idx != NO_STRING && idx >= strings.size())
+            truncated();
+        return idx;
+    }
+
+    std::string get_str()
+    {
+        uint32_t idx = get_str_index();
+        if (idx == NO_STRING)
+            truncated();
+        return std::string(strings.at(idx).first, strings.at(idx).second);
+    }
+
+    IdString to_id(uint32_t idx)
+    {
+        if (!id_valid.at(idx)) {
+            ids.at(idx) = ctx->id(std::string(strings.at(idx).first, strings.at(idx).second));
+            id_valid.at(idx) = true;
+        }
+        return ids.at(idx);
+    }
+
+    IdString get_id()
+    {
+        uint32_t idx = get_str_index();
+        if (idx == NO_STRING)
+            truncated();
+        return to_id(idx);
+    }
+
+    NetInfo *get_net()
+    {
+        uint32_t idx = get_str_index();
+        if (idx == NO_STRING)
+            return nullptr;
+        auto found = ctx->nets.find(to_id(idx));
+        if (found == ctx->nets.end())
+            truncated();
+        return found->second.get();
+    }
+
+    CellInfo *get_cell()
+    {
+        uint32_t idx = get_str_index();
+        if (idx == NO_STRING)
+            return nullptr;
+        auto found = ctx->cells.find(to_id(idx));
+        if (found == ctx->cells.end())
+            truncated();
+        return found->second.get();
+    }
+
+    template <typename Tdict> void get_dict(Tdict &dict)
+    {
+        uint32_t count = get<uint32_t>();
+        for (uint32_t i = 0; i < count; i++) {
+            IdString key = get_id();
+            Property &prop = dict[key];
+            bool is_string = get<uint8_t>() != 0;
+            std::string str = get_str();
+            if (is_string) {
+                prop = Property(str);
+                prop.intval = 0;
+            } else {
+                if (str.find_first_not_of("01xz") != std::string::npos)
+                    truncated();
+                prop = Property::from_string(std::string(str.rbegin(), str.rend()));
+            }
+        }
+    }
+
+#ifdef ARCH_XILINX
+    // Ids are range checked so that a corrupt file is reported rather than crashing
+    void check_tile(int32_t tile)
+    {
+        if (tile < 0 || tile >= ctx->chip_info->num_tiles)
+            truncated();
+    }
+
+    BelId get_bel()
+    {
+        BelId bel;
+        bel.tile = get<int32_t>();
+        bel.index = get<int32_t>();
+        if (bel != BelId()) {
+            check_tile(bel.tile);
+            if (bel.index < 0 || bel.index >= ctx->locInfo(bel).num_bels)
+                truncated();
+        }
+        return bel;
+    }
+    WireId get_wire()
+    {
+        WireId wire;
+        wire.tile = get<int32_t>();
+        wire.index = get<int32_t>();
+        if (wire.tile == -1) {
+            if (wire.index < 0 || wire.index >= ctx->chip_info->num_nodes)
+                truncated();
+        } else {
+            check_tile(wire.tile);
+            if (wire.index < 0 || wire.index >= ctx->locInfo(wire).num_wires)
+                truncated();
+        }
+        return wire;
+    }
+    PipId get_pip()
+    {
+        PipId pip;
+        pip.tile = get<int32_t>();
+        pip.index = get<int32_t>();
+        if (pip != PipId()) {
+            check_tile(pip.tile);
+            if (pip.index < 0 || pip.index >= ctx->locInfo(pip).num_pips)
+                truncated();
+        }
+        return pip;
+    }
+#else
+    BelId get_bel()
+    {
+        IdString name = get_id();
+        return name == IdString() ? BelId() : ctx->getBelByName(name);
+    }
+    WireId get_wire()
+    {
+        IdString name = get_id();
+        return name == IdString() ? WireId() : ctx->getWireByName(name);
+    }
+    PipId get_pip()
+    {
+        IdString name = get_id();
+        return name == IdString() ? PipId() : ctx->getPipByName(name);
+    }
+#endif
+
+    void read_file(const char *data, size_t size)
+    {
+        ptr = data;
+        end = data + size;
+        if (size < sizeof(checkpoint_magic) || memcmp(ptr, checkpoint_magic, sizeof(checkpoint_magic)) != 0)
+            log_error("File '%s' is not a nextpnr checkpoint.\n", filename.c_str());
+        ptr += sizeof(checkpoint_magic);
+        uint32_t version = get<uint32_t>();
+        if (version != checkpoint_version)
+            log_error("Checkpoint '%s' has format version %u, but this version of nextpnr only supports %u.\n",
+                      filename.c_str(), version, checkpoint_version);
+        auto ident = get_raw_str();
+        std::string expected_ident = chipdb_identity(ctx);
+        if (std::string(ident.first, ident.second) != expected_ident)
+            log_error("Checkpoint '%s' was written for a different chip database or device (%s, expected %s).\n",
+                      filename.c_str(), std::string(ident.first, ident.second).c_str(), expected_ident.c_str());
+        uint32_t num_strings = get<uint32_t>();
+        if (size_t(end - ptr) / sizeof(uint32_t) < num_strings)
+            truncated();
+        strings.reserve(num_strings);
+        for (uint32_t i = 0; i < num_strings; i++)
+            strings.push_back(get_raw_str());
+        ids.resize(num_strings);
+        id_valid.resize(num_strings, false);
+        read_design();
+        if (ptr != end)
+            truncated();
+    }
+
+    void read_design()
+    {
+        get_dict(ctx->settings);
+        get_dict(ctx->attrs);
+
+        std::vector<NetInfo *> net_order(get<uint32_t>());
+        for (auto &ni : net_order) {
+            ni = ctx->createNet(get_id());
+            ni->hierpath = get_id();
+            get_dict(ni->attrs);
+        }
+
+        std::vector<CellInfo *> cell_order(get<uint32_t>());
+        std::vector<BelId> placement(cell_order.size());
+        for (size_t i = 0; i < cell_order.size(); i++) {
+            IdString name = get_id();
+            IdString type = get_id();
+            CellInfo *ci = ctx->createCell(name, type);
+            cell_order.at(i) = ci;
+            ci->hierpath = get_id();
+            get_dict(ci->attrs);
+            get_dict(ci->params);
+            uint32_t num_ports = get<uint32_t>();
+            for (uint32_t j = 0; j < num_ports; j++) {
+                IdString port_name = get_id();
+                PortInfo &port = ci->ports[port_name];
+                port.name = port_name;
+                port.type = PortType(get<uint8_t>());
+                port.net = get_net();
+            }
+            uint32_t num_pins = get<uint32_t>();
+            for (uint32_t j = 0; j < num_pins; j++) {
+                IdString cell_pin = get_id();
+                ci->pins[cell_pin] = get_id();
+            }
+            placement.at(i) = get_bel();
+            ci->belStrength = PlaceStrength(get<uint8_t>());
+            ci->constr_x = get<int32_t>();
+            ci->constr_y = get<int32_t>();
+            ci->constr_z = get<int32_t>();
+            ci->constr_abs_z = get<uint8_t>() != 0;
+        }
+
+        for (auto ci : cell_order) {
+            ci->constr_parent = get_cell();
+            ci->constr_children.resize(get<uint32_t>());
+            for (auto &child : ci->constr_children) {
+                child = get_cell();
+                if (child == nullptr)
+                    truncated();
+            }
+        }
+
+        for (auto ni : net_order) {
+            ni->driver.cell = get_cell();
+            ni->driver.port = get_id();
+            ni->users.resize(get<uint32_t>());
+            for (size_t i = 0; i < ni->users.size(); i++) {
+                auto &usr = ni->users.at(i);
+                usr.cell = get_cell();
+                usr.port = get_id();
+                if (usr.cell == nullptr)
+                    truncated();
+                auto port = usr.cell->ports.find(usr.port);
+                if (port != usr.cell->ports.end())
+                    port->second.user_idx = int(i);
+            }
+        }
+
+        uint32_t num_ports = get<uint32_t>();
+        for (uint32_t i = 0; i < num_ports; i++) {
+            IdString port_name = get_id();
+            PortInfo &port = ctx->ports[port_name];
+            port.name = port_name;
+            port.type = PortType(get<uint8_t>());
+            port.net = get_net();
+        }
+
+        uint32_t num_aliases = get<uint32_t>();
+        for (uint32_t i = 0; i < num_aliases; i++) {
+            IdString alias = get_id();
+            ctx->net_aliases[alias] = get_id();
+            auto found = ctx->nets.find(ctx->net_aliases.at(alias));
+            if (found != ctx->nets.end())
+                found->second->aliases.push_back(alias);
+        }
+
+#ifdef ARCH_XILINX
+        // Packing sets up the arch-specific cell data that bel validity checks depend on
+        if (ctx->attrs.count(ctx->id("step")))
+            ctx->assignArchInfo();
+#endif
+        for (size_t i = 0; i < cell_order.size(); i++) {
+            if (placement.at(i) == BelId())
+                continue;
+            CellInfo *ci = cell_order.at(i);
+            if (!ctx->checkBelAvail(placement.at(i)))
+                log_error("Checkpoint '%s' places more than one cell at bel '%s'.\n", filename.c_str(),
+                          ctx->nameOfBel(placement.at(i)));
+            ctx->bindBel(placement.at(i), ci, ci->belStrength);
+        }
+
+        for (auto ni : net_order) {
+            uint32_t num_wires = get<uint32_t>();
+            for (uint32_t i = 0; i < num_wires; i++) {
+                WireId wire = get_wire();
+                PipId pip = get_pip();
+                PlaceStrength strength = PlaceStrength(get<uint8_t>());
+                if (pip == PipId())
+                    ctx->bindWire(wire, ni, strength);
+                else
+                    ctx->bindPip(pip, ni, strength);
+            }
+        }
+    }
+};
+
+} // namespace
+
+bool write_checkpoint(const std::string &filename, Context *ctx)
+{
+    try {
+        std::ofstream out(filename, std::ios::binary);
+        if (!out)
+            log_error("Failed to open checkpoint file '%s' for writing.\n", filename.c_str());
+        CheckpointWriter writer(ctx);
+        writer.write_design();
+        writer.write_file(out);
+        if (!out)
+            log_error("Failed to write checkpoint file '%s'.\n", filename.c_str());
+        log_info("Wrote checkpoint with %d cells and %d nets to '%s'.\n", int(ctx->cells.size()),
+                 int(ctx->nets.size()), filename.c_str());
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
+bool load_checkpoint(const std::string &filename, Context *ctx)
+{
+    try {
+        if (!ctx->cells.empty() || !ctx->nets.empty())
+            log_error("A checkpoint can only be loaded into an empty design.\n");
+        boost::iostreams::mapped_file_source file;
+        try {
+            file.open(filename);
+        } catch (...) {
+            log_error("Failed to open checkpoint file '%s'.\n", filename.c_str());
+        }
+        if (!file.is_open())
+            log_error("Failed to open checkpoint file '%s'.\n", filename.c_str());
+        CheckpointReader reader(ctx, filename);
+        reader.read_file(file.data(), file.size());
+        log_info("Loaded checkpoint with %d cells and %d nets from '%s'.\n", int(ctx->cells.size()),
+                 int(ctx->nets.size()), filename.c_str());
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,207 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <cstdio>
+#include <fstream>
+#include "nextpnr.h"
+#include "chipdb_cache.h"
+#include "log.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+/*
+ * Cache file layout, all integers are native endian:
+ *
+ *   char[8]  magic "NPCACH01"
+ *   str      key
+ *   u32      number of sections, then per section:
+ *              str  name
+ *              u64  size
+ *              data, padded to a multiple of 8 bytes
+ *
+ * A str is a u32 length followed by the characters without a terminator, padded to a multiple of 8 bytes; so the
+ * data of every section is 8 byte aligned in the mapped file.
+ */
+
+namespace {
+
+const char cache_magic[8] = {'N', 'P', 'C', 'A', 'C', 'H', '0', '1'};
+
+size_t padded(size_t size) { return (size + 7) & ~size_t(7); }
+
+struct CacheReader
+{
+    const char *data;
+    size_t size, pos = 0;
+    bool ok = true;
+
+    CacheReader(const char *data, size_t size) : data(data), size(size) {}
+
+    template <typename T> T get()
+    {
+        T value{};
+        if (pos + sizeof(T) > size) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string get_str()
+    {
+        uint32_t len = get<uint32_t>();
+        if (!ok || pos + len > size) {
+            ok = false;
+            return std::string();
+        }
+        std::string s(data + pos, len);
+        pos = padded(pos + len);
+        return s;
+    }
+};
+
+template <typename T> void append_value(std::string &out, T value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void append_str(std::string &out, const std::string &s)
+{
+    append_value<uint32_t>(out, s.size());
+    out += s;
+    out.resize(padded(out.size()), '\0');
+}
+
+} // namespace
+
+void ChipdbCache::open(const std::string &filename, const std::string &key)
+{
+    this->filename = filename;
+    this->key = key;
+    try {
+        file.open(filename);
+    } catch (...) {
+        log_info("Chipdb cache '%s' not found, it will be created.\n", filename.c_str());
+        return;
+    }
+    if (!file.is_open())
+        return;
+    CacheReader rd(file.data(), file.size());
+    bool magic_ok = rd.size >= sizeof(cache_magic) && memcmp(rd.data, cache_magic, sizeof(cache_magic)) == 0;
+    rd.pos = sizeof(cache_magic);
+    if (!magic_ok || rd.get_str() != key || !rd.ok) {
+        log_info("Chipdb cache '%s' is for another chip database, it will be replaced.\n", filename.c_str());
+        file.close();
+        return;
+    }
+    uint32_t num_sections = rd.get<uint32_t>();
+    for (uint32_t i = 0; rd.ok && i < num_sections; i++) {
+        std::string name = rd.get_str();
+        uint64_t size = rd.get<uint64_t>();
+        if (!rd.ok || rd.pos + size > rd.size) {
+            rd.ok = false;
+            break;
+        }
+        mapped[name] = std::make_pair(rd.pos, size_t(size));
+        rd.pos = padded(rd.pos + size);
+    }
+    if (!rd.ok) {
+        log_warning("Chipdb cache '%s' is truncated, it will be replaced.\n", filename.c_str());
+        mapped.clear();
+        file.close();
+        return;
+    }
+    log_info("Using chipdb cache '%s' with %d sections.\n", filename.c_str(), int(mapped.size()));
+}
+
+bool ChipdbCache::get(const std::string &name, const char *&data, size_t &size) const
+{
+    auto fnd_added = added.find(name);
+    if (fnd_added != added.end()) {
+        data = fnd_added->second.data();
+        size = fnd_added->second.size();
+        return true;
+    }
+    auto fnd = mapped.find(name);
+    if (fnd == mapped.end())
+        return false;
+    data = file.data() + fnd->second.first;
+    size = fnd->second.second;
+    return true;
+}
+
+void ChipdbCache::put(const std::string &name, const std::string &data)
+{
+    if (!enabled())
+        return;
+    added[name] = data;
+    save();
+}
+
+void ChipdbCache::save() const
+{
+    std::string out(cache_magic, sizeof(cache_magic));
+    append_str(out, key);
+    uint32_t num_sections = added.size();
+    for (auto &sec : mapped)
+        if (!added.count(sec.first))
+            ++num_sections;
+    append_value<uint32_t>(out, num_sections);
+    auto put_section = [&](const std::string &name, const char *data, size_t size) {
+        append_str(out, name);
+        append_value<uint64_t>(out, size);
+        out.append(data, size);
+        out.resize(padded(out.size()), '\0');
+    };
+    for (auto &sec : mapped)
+        if (!added.count(sec.first))
+            put_section(sec.first, file.data() + sec.second.first, sec.second.second);
+    for (auto &sec : added)
+        put_section(sec.first, sec.second.data(), sec.second.size());
+
+    // Write a new file and move it into place, so that the mapping of the old one stays valid
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary);
+        if (f)
+            f.write(out.data(), out.size());
+        if (!f) {
+            log_warning("Failed to write chipdb cache '%s'.\n", tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+        log_warning("Failed to replace chipdb cache '%s'.\n", filename.c_str());
+}
+
+std::string chipdb_content_key(const char *data, size_t size)
+{
+    // FNV-1a over the first 256 bytes of every 4KiB block
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t block = 0; block < size; block += 4096) {
+        size_t end = std::min(size, block + 256);
+        for (size_t i = block; i < end; i++) {
+            hash ^= uint8_t(data[i]);
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    return stringf("%llu;%016llx", (unsigned long long)size, (unsigned long long)hash);
+}
+
+NEXTPNR_NAMESPACE_END
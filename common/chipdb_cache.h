@@ -0,0 +1,82 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef NEXTPNR_H
+#error Include "chipdb_cache.h" after "nextpnr.h"; arch.h may include it from there.
+#endif
+
+#ifndef CHIPDB_CACHE_H
+#define CHIPDB_CACHE_H
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Cache file for tables that are derived from the chip database alone, so that they don't have to be rebuilt on
+// every run against the same device. The file holds named binary sections and is memory mapped; it is only used if
+// it was written for the same key, which identifies the chipdb content. Adding a section rewrites the file.
+class ChipdbCache
+{
+  public:
+    // Use filename as the cache, if it was written for this key; otherwise start an empty one that will replace it
+    void open(const std::string &filename, const std::string &key);
+    bool enabled() const { return !filename.empty(); }
+
+    // The data of a section, or false if the cache doesn't have it. The data stays valid for the cache's lifetime.
+    bool get(const std::string &name, const char *&data, size_t &size) const;
+    // Add or replace a section, and write the cache file
+    void put(const std::string &name, const std::string &data);
+
+    template <typename T> bool get_vector(const std::string &name, std::vector<T> &out) const
+    {
+        const char *data;
+        size_t size;
+        if (!get(name, data, size) || size % sizeof(T) != 0)
+            return false;
+        out.resize(size / sizeof(T));
+        if (size > 0)
+            memcpy(out.data(), data, size);
+        return true;
+    }
+
+    template <typename T> void put_vector(const std::string &name, const std::vector<T> &data)
+    {
+        put(name, std::string(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(T)));
+    }
+
+  private:
+    std::string filename, key;
+    boost::iostreams::mapped_file_source file;
+    // Sections of the mapped file, as offset and size
+    std::map<std::string, std::pair<size_t, size_t>> mapped;
+    // Sections added since the file was opened
+    std::map<std::string, std::string> added;
+
+    void save() const;
+};
+
+// Cache key for a chip database file: its size and a hash of a sample of its content. Sampling keeps this fast for
+// multi-gigabyte databases, while any regenerated database differs in far more than the bytes that are skipped.
+std::string chipdb_content_key(const char *data, size_t size);
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <chrono>
+#include "nextpnr.h"
+#include "chipdb_file.h"
+#include "log.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+NEXTPNR_NAMESPACE_BEGIN
+
+bool parse_chipdb_load_mode(const std::string &name, ChipdbLoadMode &mode)
+{
+    if (name == "mmap")
+        mode = ChipdbLoadMode::MMAP;
+    else if (name == "prefetch")
+        mode = ChipdbLoadMode::PREFETCH;
+    else if (name == "populate")
+        mode = ChipdbLoadMode::POPULATE;
+    else if (name == "hugepage")
+        mode = ChipdbLoadMode::HUGEPAGE;
+    else
+        return false;
+    return true;
+}
+
+#ifndef _WIN32
+namespace {
+
+const size_t huge_page_size = 2 * 1024 * 1024;
+
+// Anonymous memory of at least size bytes, preferably backed by huge pages
+void *alloc_huge(size_t size, size_t &mapped_size, const char *&kind)
+{
+    mapped_size = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+#ifdef MAP_HUGETLB
+    // Reserved hugetlbfs pages, if the system has enough of them
+    void *mem = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mem != MAP_FAILED) {
+        kind = "reserved huge pages";
+        return mem;
+    }
+#endif
+    void *mem2 = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem2 == MAP_FAILED)
+        return nullptr;
+#ifdef MADV_HUGEPAGE
+    // Transparent huge pages; only a hint, and the kernel may still use small pages
+    madvise(mem2, mapped_size, MADV_HUGEPAGE);
+    kind = "transparent huge pages";
+#else
+    kind = "anonymous memory";
+#endif
+    return mem2;
+}
+
+} // namespace
+#endif
+
+bool ChipdbFile::open(const std::string &filename, ChipdbLoadMode mode)
+{
+    close();
+    auto start = std::chrono::steady_clock::now();
+    const char *kind = "mapped";
+#ifndef _WIN32
+    if (mode == ChipdbLoadMode::POPULATE || mode == ChipdbLoadMode::HUGEPAGE) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        size_t size = st.st_size;
+        if (mode == ChipdbLoadMode::POPULATE) {
+#ifdef MAP_POPULATE
+            void *mem = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (mem != MAP_FAILED) {
+                own_map = mem;
+                own_map_size = size;
+                kind = "mapped and populated";
+            }
+#endif
+        } else {
+            size_t mapped_size;
+            void *mem = alloc_huge(size, mapped_size, kind);
+            size_t done = 0;
+            while (mem != nullptr && done < size) {
+                ssize_t n = pread(fd, reinterpret_cast<char *>(mem) + done, size - done, done);
+                if (n <= 0) {
+                    munmap(mem, mapped_size);
+                    mem = nullptr;
+                    break;
+                }
+                done += n;
+            }
+            if (mem != nullptr) {
+                mprotect(mem, mapped_size, PROT_READ);
+                own_map = mem;
+                own_map_size = mapped_size;
+            }
+        }
+        ::close(fd);
+        if (own_map != nullptr) {
+            blob = reinterpret_cast<const char *>(own_map);
+            blob_size = size;
+        } else {
+            log_warning("Failed to load chipdb '%s' in the requested mode, mapping it instead.\n", filename.c_str());
+        }
+    }
+#endif
+    if (blob == nullptr) {
+        try {
+            file.open(filename);
+        } catch (...) {
+            return false;
+        }
+        if (!file.is_open())
+            return false;
+        blob = file.data();
+        blob_size = file.size();
+#ifndef _WIN32
+        if (mode == ChipdbLoadMode::PREFETCH) {
+            // Start readahead of the whole file; pages arrive in the background while the design is loaded and packed
+            posix_madvise(const_cast<char *>(blob), blob_size, POSIX_MADV_WILLNEED);
+            kind = "mapped with prefetch";
+        }
+#endif
+    }
+    if (mode != ChipdbLoadMode::MMAP)
+        log_info("Loaded chipdb '%s' (%.1f MiB, %s) in %.2fs.\n", filename.c_str(), blob_size / (1024.0 * 1024.0),
+                 kind, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+void ChipdbFile::close()
+{
+#ifndef _WIN32
+    if (own_map != nullptr)
+        munmap(own_map, own_map_size);
+#endif
+    own_map = nullptr;
+    own_map_size = 0;
+    if (file.is_open())
+        file.close();
+    blob = nullptr;
+    blob_size = 0;
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,71 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef NEXTPNR_H
+#error Include "chipdb_file.h" after "nextpnr.h"; arch.h may include it from there.
+#endif
+
+#ifndef CHIPDB_FILE_H
+#define CHIPDB_FILE_H
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <string>
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// How the chip database is brought into memory. The chipdb is accessed randomly through relative pointers, so with a
+// plain mapping every first touch of a page is a fault, which is slow when the file is on a network filesystem.
+enum class ChipdbLoadMode
+{
+    MMAP,     // map the file, pages are read in on first access
+    PREFETCH, // map the file and ask the kernel to start reading all of it in the background
+    POPULATE, // map the file and read all of it in before continuing (MAP_POPULATE)
+    HUGEPAGE  // copy the file into anonymous memory backed by huge pages, to also reduce TLB misses
+};
+
+bool parse_chipdb_load_mode(const std::string &name, ChipdbLoadMode &mode);
+
+// Read-only chip database blob, loaded according to a ChipdbLoadMode. Modes that the platform doesn't support fall
+// back to a plain mapping.
+class ChipdbFile
+{
+  public:
+    ChipdbFile() = default;
+    ChipdbFile(const ChipdbFile &) = delete;
+    ChipdbFile &operator=(const ChipdbFile &) = delete;
+    ~ChipdbFile() { close(); }
+
+    // Returns false if the file can't be read
+    bool open(const std::string &filename, ChipdbLoadMode mode);
+    void close();
+
+    bool is_open() const { return blob != nullptr; }
+    const char *data() const { return blob; }
+    size_t size() const { return blob_size; }
+
+  private:
+    boost::iostreams::mapped_file_source file;
+    const char *blob = nullptr;
+    size_t blob_size = 0;
+    // Memory mapped by open() itself rather than through file, to be unmapped on close
+    void *own_map = nullptr;
+    size_t own_map_size = 0;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
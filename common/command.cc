@@ -33,14 +33,35 @@
 #include <boost/program_options.hpp>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <thread>
+#include "checkpoint.h"
 #include "command.h"
 #include "design_utils.h"
+#include "fmax_search.h"
+#include "incremental.h"
 #include "json_frontend.h"
 #include "jsonwrite.h"
 #include "log.h"
+#include "mem_account.h"
+#include "perf_report.h"
+#include "plugin.h"
 #include "timing.h"
+#include "timing_db.h"
+#include "trace.h"
 #include "util.h"
 #include "version.h"
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -48,7 +69,9 @@ CommandHandler::CommandHandler(int argc, char **argv) : argc(argc), argv(argv) {
 
 bool CommandHandler::parseOptions()
 {
-    options.add(getGeneralOptions()).add(getArchOptions());
+    // A server job parses its own command line again with the same options
+    if (options.options().empty())
+        options.add(getGeneralOptions()).add(getArchOptions());
     try {
         po::parsed_options parsed =
                 po::command_line_parser(argc, argv)
@@ -79,6 +102,9 @@ bool CommandHandler::executeBeforeContext()
                   << " -- Next Generation Place and Route (Version " GIT_DESCRIBE_STR ")\n";
         return true;
     }
+    conflicting_options(vm, "json", "load-checkpoint");
+    conflicting_options(vm, "incremental", "load-checkpoint");
+    conflicting_options(vm, "server", "batch");
     validate();
 
     if (vm.count("quiet")) {
@@ -106,6 +132,7 @@ po::options_description CommandHandler::getGeneralOptions()
     general.add_options()("log,l", po::value<std::string>(),
                           "log file, all log messages are written to this file regardless of -q");
     general.add_options()("debug", "debug output");
+    general.add_options()("async-log", "write the log from a background thread, for faster verbose and debug output");
     general.add_options()("force,f", "keep running after errors");
 #ifndef NO_GUI
     general.add_options()("gui", "start gui");
@@ -121,9 +148,18 @@ po::options_description CommandHandler::getGeneralOptions()
     general.add_options()("post-route", po::value<std::vector<std::string>>(), "python file to run after routing");
 
 #endif
+    general.add_options()("plugin", po::value<std::vector<std::string>>(),
+                          "shared object with native callbacks to run at the same points as --pre-pack etc.");
     general.add_options()("json", po::value<std::string>(), "JSON design file to ingest");
     general.add_options()("write", po::value<std::string>(), "JSON design file to write");
+    general.add_options()("load-checkpoint", po::value<std::string>(),
+                          "binary design checkpoint to resume from, instead of a JSON design");
+    general.add_options()("write-checkpoint", po::value<std::string>(), "binary design checkpoint to write");
+    general.add_options()("incremental", po::value<std::string>(),
+                          "checkpoint of an earlier run, reusing the placement and routing of unchanged parts");
     general.add_options()("seed", po::value<int>(), "seed value for random number generator");
+    general.add_options()("threads", po::value<int>(), "number of threads shared by the multithreaded passes");
+    general.add_options()("numa", "pin the threads to the NUMA nodes, and place routing data near its threads");
     general.add_options()("randomize-seed,r", "randomize seed value for random number generator");
 
     general.add_options()(
@@ -142,6 +178,51 @@ po::options_description CommandHandler::getGeneralOptions()
     general.add_options()("cstrweight", po::value<float>(), "placer weighting for relative constraint satisfaction");
     general.add_options()("starttemp", po::value<float>(), "placer SA start temperature");
     general.add_options()("placer-budgets", "use budget rather than criticality in placer timing weights");
+    general.add_options()("placer-heap-starts", po::value<int>(),
+                          "run the HeAP placer this many times with different seeds and keep the best placement");
+    general.add_options()("placer-heap-multilevel", po::value<int>(),
+                          "create the initial HeAP placement from up to this many coarsened levels of the netlist");
+    general.add_options()("placer-heap-region-solve",
+                          "solve the cells of each region constraint as a separate system in the HeAP placer");
+    general.add_options()("placer-heap-routability",
+                          "make the HeAP placer spread cells further where the estimated routing demand is high");
+    general.add_options()("placer-heap-reference", po::value<std::string>(),
+                          "placed JSON design or checkpoint of an earlier run to start the HeAP placer from");
+    general.add_options()("router2-time-budget", po::value<float>(),
+                          "stop router2 iterations after this many seconds and finish with router1");
+    general.add_options()("router2-small-design", po::value<int>(),
+                          "for designs with at most this many cells, only set up router2 wires near the nets");
+    general.add_options()("router2-deterministic",
+                          "make router2 results independent of the thread count, at some cost in parallelism");
+    general.add_options()("router2-stats", po::value<std::string>(),
+                          "file to write per-iteration router2 statistics to, as one JSON object per line");
+    general.add_options()("router2-lookahead", po::value<std::string>(),
+                          "cache file for the router2 map lookahead, computed and written there on first use");
+    general.add_options()("router2-cong-history", po::value<std::string>(),
+                          "file to start router2 from the congestion history of a previous run in, if it exists, "
+                          "and to save this run's to");
+    general.add_options()("perf-report", po::value<std::string>(),
+                          "file to write the wall time, CPU time and memory growth of each flow phase to, as JSON");
+    general.add_options()("perf-counters", "also record cycles, instructions, LLC misses and branch misses of each "
+                                           "phase in the --perf-report, from the hardware counters (Linux only)");
+    general.add_options()("mem-report", "log the estimated memory use of each subsystem after each flow step");
+#ifndef NO_TRACING
+    general.add_options()("trace", po::value<std::string>(),
+                          "file to write a Chrome trace of the placer, router and timing analysis threads to");
+#endif
+
+#ifndef _WIN32
+    general.add_options()("server", po::value<std::string>(),
+                          "load the chipdb once, then run the jobs sent to this unix socket, each in a copy of the "
+                          "loaded context");
+    general.add_options()("client", po::value<std::string>(),
+                          "run the rest of the command line as a job on the server listening on this unix socket");
+    general.add_options()("batch", po::value<std::string>(),
+                          "load the chipdb once, then run the job command lines in this file concurrently, each in a "
+                          "copy of the loaded context and with its log in <file>.<job>.log");
+    general.add_options()("batch-jobs", po::value<int>(),
+                          "number of batch jobs to run at once, by default one per core");
+#endif
 
     general.add_options()("pack-only", "pack design only without placement or routing");
     general.add_options()("no-route", "process design without routing");
@@ -153,9 +234,15 @@ po::options_description CommandHandler::getGeneralOptions()
     general.add_options()("version,V", "show version");
     general.add_options()("test", "check architecture database integrity");
     general.add_options()("freq", po::value<double>(), "set target frequency for design in MHz");
+    general.add_options()("fmax-search", "after routing, reroute failing nets with a rising target frequency to find "
+                                         "the highest frequency the placement can reach");
     general.add_options()("timing-allow-fail", "allow timing to fail in design");
+    general.add_options()("report-worst-paths", po::value<int>(),
+                          "after routing, also report this many of the worst paths over all clock domains");
     general.add_options()("no-tmdriv", "disable timing-driven placement");
     general.add_options()("sdf", po::value<std::string>(), "SDF delay back-annotation file to write");
+    general.add_options()("timing-db", po::value<std::string>(),
+                          "binary database of routed arc delays, cell delays and slacks to write");
     general.add_options()("sdf-cvc", "enable tweaks for SDF file compatibility with the CVC simulator");
 
     return general;
@@ -192,6 +279,13 @@ void CommandHandler::setupContext(Context *ctx)
         ctx->rngseed(r);
     }
 
+    if (vm.count("threads")) {
+        ctx->settings[ctx->id("threads")] = vm["threads"].as<int>();
+    }
+
+    if (vm.count("numa"))
+        ctx->settings[ctx->id("numa")] = true;
+
     if (vm.count("slack_redist_iter")) {
         ctx->settings[ctx->id("slack_redist_iter")] = vm["slack_redist_iter"].as<int>();
         if (vm.count("freq") && vm["freq"].as<double>() == 0) {
@@ -211,6 +305,10 @@ void CommandHandler::setupContext(Context *ctx)
         ctx->settings[ctx->id("timing/allowFail")] = true;
     }
 
+    if (vm.count("report-worst-paths")) {
+        ctx->settings[ctx->id("timing/worstPaths")] = std::to_string(vm["report-worst-paths"].as<int>());
+    }
+
     if (vm.count("placer")) {
         std::string placer = vm["placer"].as<std::string>();
         if (std::find(Arch::availablePlacers.begin(), Arch::availablePlacers.end(), placer) ==
@@ -239,6 +337,39 @@ void CommandHandler::setupContext(Context *ctx)
     if (vm.count("placer-budgets")) {
         ctx->settings[ctx->id("placer1/budgetBased")] = true;
     }
+    if (vm.count("placer-heap-starts")) {
+        ctx->settings[ctx->id("placerHeap/starts")] = std::to_string(vm["placer-heap-starts"].as<int>());
+    }
+    if (vm.count("placer-heap-multilevel")) {
+        ctx->settings[ctx->id("placerHeap/multilevel")] = std::to_string(vm["placer-heap-multilevel"].as<int>());
+    }
+    if (vm.count("placer-heap-region-solve")) {
+        ctx->settings[ctx->id("placerHeap/regionSolve")] = true;
+    }
+    if (vm.count("placer-heap-routability")) {
+        ctx->settings[ctx->id("placerHeap/routabilityRatio")] = std::to_string(1.5);
+    }
+    if (vm.count("placer-heap-reference")) {
+        ctx->settings[ctx->id("placerHeap/reference")] = vm["placer-heap-reference"].as<std::string>();
+    }
+    if (vm.count("router2-time-budget")) {
+        ctx->settings[ctx->id("router2/timeBudget")] = std::to_string(vm["router2-time-budget"].as<float>());
+    }
+    if (vm.count("router2-small-design")) {
+        ctx->settings[ctx->id("router2/smallDesignCells")] = std::to_string(vm["router2-small-design"].as<int>());
+    }
+    if (vm.count("router2-deterministic")) {
+        ctx->settings[ctx->id("router2/deterministic")] = true;
+    }
+    if (vm.count("router2-stats")) {
+        ctx->settings[ctx->id("router2/statsJson")] = vm["router2-stats"].as<std::string>();
+    }
+    if (vm.count("router2-lookahead")) {
+        ctx->settings[ctx->id("router2/lookahead")] = vm["router2-lookahead"].as<std::string>();
+    }
+    if (vm.count("router2-cong-history")) {
+        ctx->settings[ctx->id("router2/congHistory")] = vm["router2-cong-history"].as<std::string>();
+    }
     if (vm.count("freq")) {
         auto freq = vm["freq"].as<double>();
         if (freq > 0)
@@ -300,8 +431,20 @@ int CommandHandler::executeMain(std::unique_ptr<Context> ctx)
     if (vm.count("json")) {
         std::string filename = vm["json"].as<std::string>();
         std::ifstream f(filename);
-        if (!parse_json(f, filename, ctx.get()))
-            log_error("Loading design failed.\n");
+        {
+            PerfScope scope("parse json");
+            if (!parse_json(f, filename, ctx.get()))
+                log_error("Loading design failed.\n");
+        }
+
+        customAfterLoad(ctx.get());
+        mem_account_log(ctx.get(), "loading the design");
+    }
+
+    if (vm.count("load-checkpoint")) {
+        std::string filename = vm["load-checkpoint"].as<std::string>();
+        if (!load_checkpoint(filename, ctx.get()))
+            log_error("Loading checkpoint failed.\n");
 
         customAfterLoad(ctx.get());
     }
@@ -318,44 +461,87 @@ int CommandHandler::executeMain(std::unique_ptr<Context> ctx)
     } else
 #endif
 
-            if (vm.count("json")) {
+            if (vm.count("json") || vm.count("load-checkpoint")) {
         bool do_pack = vm.count("pack-only") != 0 || vm.count("no-pack") == 0;
         bool do_place = vm.count("pack-only") == 0 && vm.count("no-place") == 0;
         bool do_route = vm.count("pack-only") == 0 && vm.count("no-route") == 0;
 
+        if (vm.count("load-checkpoint")) {
+            // Resume after the last flow step that had completed when the checkpoint was written
+            auto step = ctx->attrs.find(ctx->id("step"));
+            if (step != ctx->attrs.end()) {
+                do_pack = false;
+                if (step->second.is_string && step->second.str == "place")
+                    do_place = false;
+            }
+            if (ctx->settings.count(ctx->id("route")))
+                do_route = false;
+        }
+
         if (do_pack) {
-            run_script_hook("pre-pack");
+            run_script_hook("pre-pack", ctx.get());
+            PerfScope scope("pack");
             if (!ctx->pack() && !ctx->force)
                 log_error("Packing design failed.\n");
+            compact_netlist(ctx.get());
+            mem_account_log(ctx.get(), "packing");
+        }
+        IncrementalFlow incremental;
+        if (vm.count("incremental")) {
+            std::string filename = vm["incremental"].as<std::string>();
+            PerfScope scope("incremental");
+            if (!incremental.load(filename, ctx.get()))
+                log_error("Loading incremental reference failed.\n");
+            incremental.restore_placement();
         }
         assign_budget(ctx.get());
         ctx->check();
         print_utilisation(ctx.get());
 
         if (do_place) {
-            run_script_hook("pre-place");
+            run_script_hook("pre-place", ctx.get());
+            PerfScope scope("place");
             if (!ctx->place() && !ctx->force)
                 log_error("Placing design failed.\n");
+            scope.stop();
+            mem_account_log(ctx.get(), "placement");
             ctx->check();
         }
 
         if (do_route) {
-            run_script_hook("pre-route");
+            if (vm.count("incremental"))
+                incremental.restore_routing();
+            run_script_hook("pre-route", ctx.get());
+            PerfScope scope("route");
             if (!ctx->route() && !ctx->force)
                 log_error("Routing design failed.\n");
-            run_script_hook("post-route");
+            scope.stop();
+            mem_account_log(ctx.get(), "routing");
+            if (vm.count("fmax-search")) {
+                PerfScope search_scope("fmax search");
+                fmax_search(ctx.get());
+            }
+            run_script_hook("post-route", ctx.get());
         }
 
+        PerfScope scope("bitstream");
         customBitstream(ctx.get());
     }
 
     if (vm.count("write")) {
         std::string filename = vm["write"].as<std::string>();
+        PerfScope scope("write json");
         std::ofstream f(filename);
         if (!write_json_file(f, filename, ctx.get()))
             log_error("Saving design failed.\n");
     }
 
+    if (vm.count("write-checkpoint")) {
+        std::string filename = vm["write-checkpoint"].as<std::string>();
+        if (!write_checkpoint(filename, ctx.get()))
+            log_error("Saving checkpoint failed.\n");
+    }
+
     if (vm.count("sdf")) {
         std::string filename = vm["sdf"].as<std::string>();
         std::ofstream f(filename);
@@ -364,6 +550,12 @@ int CommandHandler::executeMain(std::unique_ptr<Context> ctx)
         ctx->writeSDF(f, vm.count("sdf-cvc"));
     }
 
+    if (vm.count("timing-db")) {
+        std::string filename = vm["timing-db"].as<std::string>();
+        if (!write_timing_db(filename, ctx.get()))
+            log_error("Saving timing database failed.\n");
+    }
+
 #ifndef NO_PYTHON
     deinit_python();
 #endif
@@ -395,20 +587,366 @@ int CommandHandler::exec()
         if (!parseOptions())
             return -1;
 
+#ifndef _WIN32
+        if (vm.count("client"))
+            return runClient();
+#endif
+
         if (executeBeforeContext())
             return 0;
 
-        std::unordered_map<std::string, Property> values;
-        std::unique_ptr<Context> ctx = createContext(values);
-        setupContext(ctx.get());
-        setupArchContext(ctx.get());
-        int rc = executeMain(std::move(ctx));
+#ifndef _WIN32
+        if (vm.count("server"))
+            return runServer();
+        if (vm.count("batch"))
+            return runBatch();
+#endif
+        return runFlow(nullptr);
+    } catch (log_execution_error_exception) {
         printFooter();
-        return rc;
+        log_async_stop();
+        return -1;
+    }
+}
+
+// Run the flow for the parsed options, in ctx if it was loaded earlier and suits them, otherwise in a new context
+int CommandHandler::runFlow(std::unique_ptr<Context> ctx)
+{
+    if (vm.count("async-log") && !vm.count("gui"))
+        log_async_start();
+
+    if (vm.count("perf-report"))
+        perf_report_enable();
+    if (vm.count("perf-report") && vm.count("perf-counters") && !perf_report_enable_hw_counters())
+        log_warning("Hardware performance counters are not available (see /proc/sys/kernel/perf_event_paranoid).\n");
+    if (vm.count("mem-report"))
+        mem_account_enable();
+#ifndef NO_TRACING
+    if (vm.count("trace"))
+        trace_enable();
+#endif
+
+    if (ctx == nullptr || !canReuseContext(ctx.get())) {
+        std::unordered_map<std::string, Property> values;
+        PerfScope scope("load chipdb");
+        ctx = createContext(values);
+    }
+    setupContext(ctx.get());
+    setupArchContext(ctx.get());
+    if (vm.count("plugin")) {
+        for (auto &filename : vm["plugin"].as<std::vector<std::string>>())
+            plugin_load(filename);
+    }
+    int rc = executeMain(std::move(ctx));
+    writePerfReport();
+    writeTrace();
+    mem_account_log_peak();
+    printFooter();
+    log_async_stop();
+    return rc;
+}
+
+#ifndef _WIN32
+// Run the flow for a job command line, in place of the command line of this process
+int CommandHandler::runJob(std::vector<std::string> &args, std::unique_ptr<Context> ctx)
+{
+    std::vector<char *> job_argv;
+    job_argv.push_back(argv[0]);
+    for (auto &arg : args)
+        job_argv.push_back(&arg[0]);
+    job_argv.push_back(nullptr);
+    argc = int(job_argv.size()) - 1;
+    argv = job_argv.data();
+    vm.clear();
+    log_streams.clear();
+    if (logfile.is_open())
+        logfile.close();
+
+    int rc = -1;
+    try {
+        if (parseOptions())
+            rc = executeBeforeContext() ? 0 : runFlow(std::move(ctx));
     } catch (log_execution_error_exception) {
         printFooter();
+        log_async_stop();
+    }
+    if (logfile.is_open())
+        logfile.close();
+    std::cout.flush();
+    std::cerr.flush();
+    return rc;
+}
+#endif
+
+#ifndef _WIN32
+namespace {
+
+// A job is sent as the client's working directory followed by its arguments, each NUL terminated, and ended by an
+// empty argument. The server replies with the log output of the job, then a NUL and the exit code of the job.
+
+int open_socket(const std::string &path, bool listening)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        log_error("Socket path '%s' is too long.\n", path.c_str());
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        log_error("Failed to create socket: %s.\n", strerror(errno));
+    if (listening) {
+        // Replace the socket left behind by an earlier server
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, 16) != 0)
+            log_error("Failed to listen on '%s': %s.\n", path.c_str(), strerror(errno));
+    } else if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        log_error("Failed to connect to server '%s': %s.\n", path.c_str(), strerror(errno));
+    }
+    return fd;
+}
+
+bool write_all(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool read_request(int fd, std::vector<std::string> &args)
+{
+    std::string arg;
+    char buf[4096];
+    while (true) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] != '\0') {
+                arg += buf[i];
+            } else if (arg.empty()) {
+                return !args.empty();
+            } else {
+                args.push_back(arg);
+                arg.clear();
+            }
+        }
+    }
+}
+
+} // namespace
+
+int CommandHandler::runServer()
+{
+    std::string path = vm["server"].as<std::string>();
+    std::unique_ptr<Context> ctx;
+    {
+        std::unordered_map<std::string, Property> values;
+        ctx = createContext(values);
+    }
+    int listen_fd = open_socket(path, true);
+    // Finished jobs are reaped by the kernel
+    signal(SIGCHLD, SIG_IGN);
+    log_info("Waiting for jobs on '%s'.\n", path.c_str());
+    while (true) {
+        int conn = accept(listen_fd, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            log_error("Failed to accept job: %s.\n", strerror(errno));
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        // The job runs in a copy-on-write copy of the loaded context, so the chipdb and the tables derived from it are
+        // shared with the server, and anything the job changes is discarded with its process
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listen_fd);
+            signal(SIGCHLD, SIG_DFL);
+            _exit(runServerJob(conn, std::move(ctx)) == 0 ? 0 : 1);
+        }
+        if (pid < 0)
+            log_warning("Failed to start job: %s.\n", strerror(errno));
+        close(conn);
+    }
+}
+
+int CommandHandler::runServerJob(int conn, std::unique_ptr<Context> ctx)
+{
+    std::vector<std::string> args;
+    if (!read_request(conn, args))
         return -1;
+    dup2(conn, STDOUT_FILENO);
+    dup2(conn, STDERR_FILENO);
+
+    int rc = -1;
+    if (chdir(args.front().c_str()) != 0) {
+        std::cerr << "ERROR: Failed to change to directory '" << args.front() << "': " << strerror(errno) << ".\n";
+    } else {
+        args.erase(args.begin());
+        rc = runJob(args, std::move(ctx));
     }
+    std::string status = std::string(1, '\0') + std::to_string(rc) + "\n";
+    write_all(conn, status.data(), status.size());
+    return rc;
+}
+
+int CommandHandler::runBatch()
+{
+    std::string filename = vm["batch"].as<std::string>();
+    std::ifstream in(filename);
+    if (!in)
+        log_error("Failed to open batch file '%s'.\n", filename.c_str());
+    // One job command line per line, without the program name; blank lines and lines starting with # are skipped
+    std::vector<std::vector<std::string>> jobs;
+    std::string line;
+    while (std::getline(in, line)) {
+        boost::algorithm::trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::vector<std::string> args;
+        boost::algorithm::split(args, line, boost::algorithm::is_any_of(" \t"), boost::algorithm::token_compress_on);
+        jobs.push_back(args);
+    }
+    int max_running = vm.count("batch-jobs") ? vm["batch-jobs"].as<int>() : int(std::thread::hardware_concurrency());
+    max_running = std::max(max_running, 1);
+
+    std::unique_ptr<Context> ctx;
+    {
+        std::unordered_map<std::string, Property> values;
+        ctx = createContext(values);
+    }
+    log_info("Running %d jobs from '%s', at most %d at a time.\n", int(jobs.size()), filename.c_str(), max_running);
+
+    // As in server mode, each job runs in a forked copy of the loaded context, so that all of them share one copy
+    // of the chipdb and the tables derived from it
+    std::map<pid_t, size_t> running;
+    size_t next = 0;
+    int failed = 0;
+    while (next < jobs.size() || !running.empty()) {
+        if (next < jobs.size() && int(running.size()) < max_running) {
+            std::string logname = filename + "." + std::to_string(next + 1) + ".log";
+            std::cout.flush();
+            std::cerr.flush();
+            pid_t pid = fork();
+            if (pid == 0) {
+                int fd = open(logname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd >= 0) {
+                    dup2(fd, STDOUT_FILENO);
+                    dup2(fd, STDERR_FILENO);
+                    close(fd);
+                }
+                _exit(runJob(jobs.at(next), std::move(ctx)) == 0 ? 0 : 1);
+            }
+            if (pid < 0)
+                log_error("Failed to start job %d: %s.\n", int(next + 1), strerror(errno));
+            running[pid] = next++;
+            continue;
+        }
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            log_error("Failed to wait for jobs: %s.\n", strerror(errno));
+        }
+        auto found = running.find(pid);
+        if (found == running.end())
+            continue;
+        bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!ok)
+            ++failed;
+        log_info("Job %d %s, log in '%s.%d.log'.\n", int(found->second + 1), ok ? "finished" : "failed",
+                 filename.c_str(), int(found->second + 1));
+        running.erase(found);
+    }
+    if (failed > 0)
+        log_warning("%d of %d jobs failed.\n", failed, int(jobs.size()));
+    return failed > 0 ? 1 : 0;
+}
+
+int CommandHandler::runClient()
+{
+    std::string path = vm["client"].as<std::string>();
+    log_streams.push_back(std::make_pair(&std::cerr, LogLevel::WARNING_MSG));
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == nullptr)
+        log_error("Failed to get the working directory: %s.\n", strerror(errno));
+    std::string request = std::string(cwd) + '\0';
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--client") {
+            i++;
+            continue;
+        }
+        if (boost::algorithm::starts_with(arg, "--client="))
+            continue;
+        request += arg + '\0';
+    }
+    request += '\0';
+
+    int fd = open_socket(path, false);
+    if (!write_all(fd, request.data(), request.size()))
+        log_error("Failed to send job to server '%s': %s.\n", path.c_str(), strerror(errno));
+    // Relay the log output of the job until the NUL that precedes its exit code
+    std::string status;
+    bool finished = false;
+    char buf[4096];
+    while (true) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        ssize_t i = 0;
+        if (!finished) {
+            while (i < n && buf[i] != '\0')
+                i++;
+            std::cerr.write(buf, i);
+            if (i == n)
+                continue;
+            finished = true;
+            i++;
+        }
+        status.append(buf + i, n - i);
+    }
+    close(fd);
+    std::cerr.flush();
+    if (!finished)
+        log_error("Server '%s' closed the connection before the job finished.\n", path.c_str());
+    return std::stoi(status);
+}
+#endif
+
+void CommandHandler::writePerfReport()
+{
+    if (!vm.count("perf-report"))
+        return;
+    // The thread count that the multithreaded passes default to
+    int threads = vm.count("threads") ? vm["threads"].as<int>() : int(std::thread::hardware_concurrency());
+    std::string filename = vm["perf-report"].as<std::string>();
+    if (!write_perf_report(filename, threads))
+        log_error("Failed to write performance report '%s'.\n", filename.c_str());
+}
+
+void CommandHandler::writeTrace()
+{
+#ifndef NO_TRACING
+    if (!vm.count("trace"))
+        return;
+    std::string filename = vm["trace"].as<std::string>();
+    if (!trace_write(filename))
+        log_error("Failed to write trace '%s'.\n", filename.c_str());
+#endif
 }
 
 std::unique_ptr<Context> CommandHandler::load_json(std::string filename)
@@ -427,7 +965,7 @@ std::unique_ptr<Context> CommandHandler::load_json(std::string filename)
     return ctx;
 }
 
-void CommandHandler::run_script_hook(const std::string &name)
+void CommandHandler::run_script_hook(const std::string &name, Context *ctx)
 {
 #ifndef NO_PYTHON
     if (vm.count(name)) {
@@ -436,6 +974,10 @@ void CommandHandler::run_script_hook(const std::string &name)
             execute_python_file(filename.c_str());
     }
 #endif
+    if (vm.count("plugin")) {
+        for (auto &filename : vm["plugin"].as<std::vector<std::string>>())
+            plugin_run_hook(filename, name, ctx);
+    }
 }
 
 NEXTPNR_NAMESPACE_END
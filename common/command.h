@@ -46,6 +46,8 @@ class CommandHandler
     virtual void validate(){};
     virtual void customAfterLoad(Context *ctx){};
     virtual void customBitstream(Context *ctx){};
+    // Whether a context already loaded by a server process suits the options of a job, rather than a new one
+    virtual bool canReuseContext(const Context *ctx) { return false; };
     void conflicting_options(const boost::program_options::variables_map &vm, const char *opt1, const char *opt2);
 
   private:
@@ -53,9 +55,17 @@ class CommandHandler
     bool executeBeforeContext();
     void setupContext(Context *ctx);
     int executeMain(std::unique_ptr<Context> ctx);
+    int runFlow(std::unique_ptr<Context> ctx);
+    int runJob(std::vector<std::string> &args, std::unique_ptr<Context> ctx);
+    int runServer();
+    int runServerJob(int conn, std::unique_ptr<Context> ctx);
+    int runBatch();
+    int runClient();
     po::options_description getGeneralOptions();
-    void run_script_hook(const std::string &name);
+    void run_script_hook(const std::string &name, Context *ctx);
     void printFooter();
+    void writePerfReport();
+    void writeTrace();
 
   protected:
     po::variables_map vm;
@@ -0,0 +1,398 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <queue>
+#include "nextpnr.h"
+#include "delay_model.h"
+#include "log.h"
+#include "thread_pool.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+/*
+ * Saved model layout, all integers are native endian:
+ *
+ *   char[8]  magic "NPDLYM01"
+ *   i32      radius, i32 samples per bel type
+ *   u32      number of bel types, then per type a str with its name
+ *   f32 x 3  global fit a, bx, by
+ *   u32      number of tables, then per table:
+ *              u32  source type * number of types + destination type
+ *              f32  fit a, bx, by, then (radius + 1)^2 delays
+ *
+ * A str is a u32 length followed by the characters without a terminator.
+ */
+
+namespace {
+
+const char model_magic[8] = {'N', 'P', 'D', 'L', 'Y', 'M', '0', '1'};
+
+template <typename T> void put(std::string &out, T value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+struct ModelReader
+{
+    const char *data;
+    size_t size, pos = 0;
+    bool ok = true;
+
+    ModelReader(const char *data, size_t size) : data(data), size(size) {}
+
+    template <typename T> T get()
+    {
+        T value{};
+        if (pos + sizeof(T) > size) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string get_str()
+    {
+        uint32_t len = get<uint32_t>();
+        if (!ok || pos + len > size) {
+            ok = false;
+            return std::string();
+        }
+        pos += len;
+        return std::string(data + pos - len, len);
+    }
+};
+
+struct QueuedWire
+{
+    delay_t delay;
+    WireId wire;
+    bool operator<(const QueuedWire &other) const { return delay > other.delay; }
+};
+
+// Weighted least squares for delay = a + bx dx + by dy, by the normal equations
+struct LeastSquares
+{
+    double m[3][3] = {}, v[3] = {};
+    int points = 0;
+
+    void add(int dx, int dy, double delay, double weight)
+    {
+        double x[3] = {1, double(dx), double(dy)};
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++)
+                m[i][j] += weight * x[i] * x[j];
+            v[i] += weight * x[i] * delay;
+        }
+        ++points;
+    }
+
+    static double det(const double a[3][3])
+    {
+        return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+               a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+    }
+
+    // Solve by Cramer's rule; false if there are too few points, or they are all in a line
+    template <typename F> bool solve(F &fit) const
+    {
+        double d = det(m);
+        if (points < 3 || std::abs(d) < 1e-9)
+            return false;
+        double coef[3];
+        for (int k = 0; k < 3; k++) {
+            double mk[3][3];
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < 3; j++)
+                    mk[i][j] = (j == k) ? v[i] : m[i][j];
+            coef[k] = det(mk) / d;
+        }
+        // Delays don't fall with distance; a negative slope is noise from a sparse table
+        fit.bx = float(std::max(0.0, coef[1]));
+        fit.by = float(std::max(0.0, coef[2]));
+        fit.a = float((v[0] - fit.bx * m[0][1] - fit.by * m[0][2]) / m[0][0]);
+        return true;
+    }
+};
+
+} // namespace
+
+int DelayModel::class_of(BelId bel) const
+{
+    auto fnd = class_index.find(ctx->getBelType(bel));
+    return (fnd == class_index.end()) ? -1 : fnd->second;
+}
+
+void DelayModel::build(Context *ctx, int radius, int samples)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    this->ctx = ctx;
+    this->radius = radius;
+    this->samples = samples;
+    classes.clear();
+    class_index.clear();
+    tables.clear();
+
+    std::vector<int> class_count;
+    for (BelId bel : ctx->getBels()) {
+        auto ins = class_index.emplace(ctx->getBelType(bel), int(classes.size()));
+        if (ins.second) {
+            classes.push_back(ctx->getBelType(bel));
+            class_count.push_back(0);
+        }
+        ++class_count[ins.first->second];
+    }
+
+    // Sources are bels with an output pin, spread evenly over the getBels order, which goes roughly tile by tile
+    struct Source
+    {
+        int cls;
+        Loc loc;
+        std::vector<WireId> wires;
+    };
+    std::vector<Source> sources;
+    {
+        std::vector<int> seen(classes.size(), 0), taken(classes.size(), 0);
+        for (BelId bel : ctx->getBels()) {
+            int cls = class_of(bel);
+            int idx = seen[cls]++;
+            if (taken[cls] >= samples || idx < ((taken[cls] + 1) * class_count[cls]) / (samples + 1))
+                continue;
+            Source src{cls, ctx->getBelLocation(bel), {}};
+            for (IdString pin : ctx->getBelPins(bel)) {
+                WireId wire = ctx->getBelPinWire(bel, pin);
+                if (wire != WireId() && ctx->getBelPinType(bel, pin) == PORT_OUT)
+                    src.wires.push_back(wire);
+            }
+            if (src.wires.empty())
+                continue;
+            sources.push_back(std::move(src));
+            ++taken[cls];
+        }
+    }
+    log_info("Fitting placement delay model for %d bel types from %d sources...\n", int(classes.size()),
+             int(sources.size()));
+
+    int size = (radius + 1) * (radius + 1);
+    int num_classes = int(classes.size());
+    auto get_loc = [&](WireId wire) {
+        ArcBounds bb = ctx->getRouteBoundingBox(wire, wire);
+        return std::make_pair((bb.x0 + bb.x1) / 2, (bb.y0 + bb.y1) / 2);
+    };
+
+    // Sum and count of the delays to each offset; each worker has its own, merged at the end
+    typedef std::unordered_map<int, std::vector<std::pair<double, int>>> Sums;
+    int threads = std::max(1, std::min(ctx->threadPool().size(), int(sources.size())));
+    std::vector<Sums> worker_sums(threads);
+    std::atomic<int> next_source(0);
+    auto worker = [&](int t) {
+        auto &sums = worker_sums.at(t);
+        std::unordered_map<WireId, delay_t> best;
+        std::priority_queue<QueuedWire> queue;
+        for (int s = next_source++; s < int(sources.size()); s = next_source++) {
+            const Source &src = sources[s];
+            best.clear();
+            for (WireId wire : src.wires) {
+                best[wire] = 0;
+                queue.push(QueuedWire{0, wire});
+            }
+            while (!queue.empty()) {
+                QueuedWire curr = queue.top();
+                queue.pop();
+                if (curr.delay > best.at(curr.wire))
+                    continue;
+                // Wire locations are approximate, so search a little beyond the radius
+                auto loc = get_loc(curr.wire);
+                if (std::abs(loc.first - src.loc.x) > radius + 2 || std::abs(loc.second - src.loc.y) > radius + 2)
+                    continue;
+                for (auto bp : ctx->getWireBelPins(curr.wire)) {
+                    if (ctx->getBelPinType(bp.bel, bp.pin) != PORT_IN)
+                        continue;
+                    Loc dst = ctx->getBelLocation(bp.bel);
+                    int dx = std::abs(dst.x - src.loc.x), dy = std::abs(dst.y - src.loc.y);
+                    if (dx > radius || dy > radius)
+                        continue;
+                    auto &table = sums[src.cls * num_classes + class_of(bp.bel)];
+                    if (table.empty())
+                        table.resize(size, std::make_pair(0.0, 0));
+                    table[dy * (radius + 1) + dx].first += ctx->getDelayNS(curr.delay);
+                    table[dy * (radius + 1) + dx].second++;
+                }
+                for (PipId pip : ctx->getPipsDownhill(curr.wire)) {
+                    WireId next = ctx->getPipDstWire(pip);
+                    delay_t next_delay =
+                            curr.delay + ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(next).maxDelay();
+                    auto ins = best.emplace(next, next_delay);
+                    if (!ins.second) {
+                        if (next_delay >= ins.first->second)
+                            continue;
+                        ins.first->second = next_delay;
+                    }
+                    queue.push(QueuedWire{next_delay, next});
+                }
+            }
+        }
+    };
+    ThreadPool::TaskGroup workers(ctx->threadPool());
+    for (int t = 1; t < threads; t++)
+        workers.run([&worker, t]() { worker(t); });
+    worker(0);
+    workers.wait();
+
+    Sums sums = std::move(worker_sums.at(0));
+    for (int t = 1; t < threads; t++)
+        for (auto &other : worker_sums.at(t)) {
+            auto &table = sums[other.first];
+            if (table.empty()) {
+                table = std::move(other.second);
+                continue;
+            }
+            for (int i = 0; i < size; i++) {
+                table[i].first += other.second[i].first;
+                table[i].second += other.second[i].second;
+            }
+        }
+    fit_tables(sums);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    log_info("Placement delay model has %d bel type pairs (fit %.3f + %.3f/x + %.3f/y ns), computed in %.02fs.\n",
+             int(tables.size()), global_fit.a, global_fit.bx, global_fit.by,
+             std::chrono::duration<float>(end - start).count());
+}
+
+void DelayModel::fit_tables(const std::unordered_map<int, std::vector<std::pair<double, int>>> &sums)
+{
+    LeastSquares global;
+    std::vector<int> unfitted;
+    for (auto &entry : sums) {
+        PairTable &table = tables[entry.first];
+        table.delay.assign(entry.second.size(), -1);
+        LeastSquares pair;
+        for (int dy = 0; dy <= radius; dy++)
+            for (int dx = 0; dx <= radius; dx++) {
+                auto &sum = entry.second.at(dy * (radius + 1) + dx);
+                if (sum.second == 0)
+                    continue;
+                double mean = sum.first / sum.second;
+                table.delay.at(dy * (radius + 1) + dx) = float(mean);
+                pair.add(dx, dy, mean, sum.second);
+                global.add(dx, dy, mean, sum.second);
+            }
+        if (!pair.solve(table.fit))
+            unfitted.push_back(entry.first);
+    }
+    if (!global.solve(global_fit))
+        global_fit = Fit();
+    // Pairs with too few entries for a fit of their own use the global one
+    for (int key : unfitted)
+        tables.at(key).fit = global_fit;
+}
+
+delay_t DelayModel::predict(BelId src, BelId dst) const
+{
+    Loc sl = ctx->getBelLocation(src), dl = ctx->getBelLocation(dst);
+    int dx = std::abs(dl.x - sl.x), dy = std::abs(dl.y - sl.y);
+    const Fit *fit = &global_fit;
+    int src_cls = class_of(src), dst_cls = class_of(dst);
+    if (src_cls >= 0 && dst_cls >= 0) {
+        auto fnd = tables.find(src_cls * int(classes.size()) + dst_cls);
+        if (fnd != tables.end()) {
+            const PairTable &table = fnd->second;
+            if (dx <= radius && dy <= radius && table.delay[dy * (radius + 1) + dx] >= 0)
+                return ctx->getDelayFromNS(table.delay[dy * (radius + 1) + dx]).maxDelay();
+            fit = &table.fit;
+        }
+    }
+    return ctx->getDelayFromNS(std::max(0.0f, fit->eval(dx, dy))).maxDelay();
+}
+
+std::string DelayModel::save() const
+{
+    std::string out(model_magic, sizeof(model_magic));
+    put<int32_t>(out, radius);
+    put<int32_t>(out, samples);
+    put<uint32_t>(out, classes.size());
+    for (IdString cls : classes) {
+        std::string name = cls.str(ctx);
+        put<uint32_t>(out, name.size());
+        out += name;
+    }
+    auto put_fit = [&](const Fit &fit) {
+        put<float>(out, fit.a);
+        put<float>(out, fit.bx);
+        put<float>(out, fit.by);
+    };
+    put_fit(global_fit);
+    put<uint32_t>(out, tables.size());
+    for (auto &entry : tables) {
+        put<uint32_t>(out, entry.first);
+        put_fit(entry.second.fit);
+        for (float delay : entry.second.delay)
+            put<float>(out, delay);
+    }
+    return out;
+}
+
+bool DelayModel::load(Context *ctx, const char *data, size_t size, int radius, int samples)
+{
+    this->ctx = ctx;
+    classes.clear();
+    class_index.clear();
+    tables.clear();
+    ModelReader rd(data, size);
+    if (size < sizeof(model_magic) || memcmp(data, model_magic, sizeof(model_magic)) != 0)
+        return false;
+    rd.pos = sizeof(model_magic);
+    this->radius = rd.get<int32_t>();
+    this->samples = rd.get<int32_t>();
+    if (!rd.ok || this->radius != radius || this->samples != samples)
+        return false;
+    uint32_t num_classes = rd.get<uint32_t>();
+    for (uint32_t i = 0; rd.ok && i < num_classes; i++) {
+        IdString cls = ctx->id(rd.get_str());
+        class_index[cls] = int(classes.size());
+        classes.push_back(cls);
+    }
+    auto get_fit = [&](Fit &fit) {
+        fit.a = rd.get<float>();
+        fit.bx = rd.get<float>();
+        fit.by = rd.get<float>();
+    };
+    get_fit(global_fit);
+    uint32_t num_tables = rd.get<uint32_t>();
+    for (uint32_t i = 0; rd.ok && i < num_tables; i++) {
+        PairTable &table = tables[rd.get<uint32_t>()];
+        get_fit(table.fit);
+        table.delay.resize((radius + 1) * (radius + 1));
+        for (auto &delay : table.delay)
+            delay = rd.get<float>();
+    }
+    if (!rd.ok || rd.pos != size) {
+        classes.clear();
+        class_index.clear();
+        tables.clear();
+        return false;
+    }
+    return true;
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,77 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef NEXTPNR_H
+#error Include "delay_model.h" after "nextpnr.h"; arch.h may include it from there.
+#endif
+
+#ifndef DELAY_MODEL_H
+#define DELAY_MODEL_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Placement delay model fitted to routes on the empty device, for predictDelay. For each pair of bel types it has the
+// mean delay from the output pins of a bel of the first type to the input pins of bels of the second at each offset
+// (|dx|, |dy|) up to a radius, found by shortest path searches (the routes the router takes without congestion) from
+// a sample of the bels of each type. Offsets beyond the radius, or that no search reached, use a linear fit
+// a + bx |dx| + by |dy| to the table of the pair, or to all tables if the pair has too few entries.
+//
+// Building the model takes a while, so an architecture would normally keep the result of save in a cache.
+struct DelayModel
+{
+    // Compute the model, searching from samples bels of each type
+    void build(Context *ctx, int radius, int samples);
+    // The model as bytes, and back; load returns false if data is not a model for these settings
+    std::string save() const;
+    bool load(Context *ctx, const char *data, size_t size, int radius, int samples);
+
+    bool empty() const { return classes.empty(); }
+    // Predicted delay of a connection from a pin of bel src to one of bel dst
+    delay_t predict(BelId src, BelId dst) const;
+
+  private:
+    struct Fit
+    {
+        float a = 0, bx = 0, by = 0;
+        float eval(int dx, int dy) const { return a + bx * dx + by * dy; }
+    };
+    struct PairTable
+    {
+        // (radius + 1)^2 mean delays in ns, indexed by |dy| * (radius + 1) + |dx|; negative where no sample reached
+        std::vector<float> delay;
+        Fit fit;
+    };
+
+    Context *ctx = nullptr;
+    int radius = 0, samples = 0;
+    std::vector<IdString> classes;
+    std::unordered_map<IdString, int> class_index;
+    // By source class * number of classes + destination class
+    std::unordered_map<int, PairTable> tables;
+    Fit global_fit;
+
+    int class_of(BelId bel) const;
+    void fit_tables(const std::unordered_map<int, std::vector<std::pair<double, int>>> &sums);
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -23,8 +23,24 @@
 #include <map>
 #include "log.h"
 #include "util.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 NEXTPNR_NAMESPACE_BEGIN
 
+namespace {
+// Index of the user of net that is port_name of cell, or -1; uses the index recorded in the port if it is still right
+int find_user(NetInfo *net, CellInfo *cell, IdString port_name, const PortInfo &port)
+{
+    auto is_port = [&](const PortRef &user) { return user.cell == cell && user.port == port_name; };
+    if (port.user_idx >= 0 && port.user_idx < int(net->users.size()) && is_port(net->users.at(port.user_idx)))
+        return port.user_idx;
+    auto fnd = std::find_if(net->users.begin(), net->users.end(), is_port);
+    return fnd == net->users.end() ? -1 : int(fnd - net->users.begin());
+}
+} // namespace
+
 void replace_port(CellInfo *old_cell, IdString old_name, CellInfo *rep_cell, IdString rep_name)
 {
     if (!old_cell->ports.count(old_name))
@@ -42,11 +58,12 @@ void replace_port(CellInfo *old_cell, IdString old_name, CellInfo *rep_cell, IdS
         }
     } else if (rep.type == PORT_IN || rep.type == PORT_INOUT) {
         if (rep.net != nullptr) {
-            for (PortRef &load : rep.net->users) {
-                if (load.cell == old_cell && load.port == old_name) {
-                    load.cell = rep_cell;
-                    load.port = rep_name;
-                }
+            int idx = find_user(rep.net, old_cell, old_name, old);
+            if (idx != -1) {
+                PortRef &load = rep.net->users.at(idx);
+                load.cell = rep_cell;
+                load.port = rep_name;
+                rep.user_idx = idx;
             }
         }
     } else {
@@ -62,11 +79,15 @@ void print_utilisation(const Context *ctx)
     for (auto &cell : ctx->cells) {
         used_types[cell.second.get()->type]++;
     }
+    // Only the bel types that the design uses are counted and listed
     std::map<IdString, int> available_types;
-    for (auto bel : ctx->getBels()) {
-        if (ctx->getBelHidden(bel))
-            continue;
-        available_types[ctx->getBelType(bel)]++;
+    for (auto &used : used_types) {
+        int available = 0;
+        for (auto bel : ctx->getBelsByType(used.first))
+            if (!ctx->getBelHidden(bel))
+                available++;
+        if (available > 0)
+            available_types[used.first] = available;
     }
     log_break();
     log_info("Device utilisation:\n");
@@ -97,6 +118,7 @@ void connect_port(const Context *ctx, NetInfo *net, CellInfo *cell, IdString por
         PortRef user;
         user.cell = cell;
         user.port = port_name;
+        port.user_idx = int(net->users.size());
         net->users.push_back(user);
     } else {
         NPNR_ASSERT_FALSE("invalid port type for connect_port");
@@ -109,15 +131,24 @@ void disconnect_port(const Context *ctx, CellInfo *cell, IdString port_name)
         return;
     PortInfo &port = cell->ports.at(port_name);
     if (port.net != nullptr) {
-        port.net->users.erase(std::remove_if(port.net->users.begin(), port.net->users.end(),
-                                             [cell, port_name](const PortRef &user) {
-                                                 return user.cell == cell && user.port == port_name;
-                                             }),
-                              port.net->users.end());
+        auto &users = port.net->users;
+        int idx = find_user(port.net, cell, port_name, port);
+        if (idx != -1) {
+            // Move the last user into the gap rather than shifting all the users after it, so that detaching many
+            // cells from a high fanout net isn't quadratic. This reorders the users, but deterministically.
+            if (idx != int(users.size()) - 1) {
+                users.at(idx) = users.back();
+                auto moved = users.at(idx).cell->ports.find(users.at(idx).port);
+                if (moved != users.at(idx).cell->ports.end())
+                    moved->second.user_idx = idx;
+            }
+            users.pop_back();
+        }
         if (port.net->driver.cell == cell && port.net->driver.port == port_name)
             port.net->driver.cell = nullptr;
     }
     port.net = nullptr;
+    port.user_idx = -1;
 }
 
 void connect_ports(Context *ctx, CellInfo *cell1, IdString port1_name, CellInfo *cell2, IdString port2_name)
@@ -144,9 +175,11 @@ void rename_port(Context *ctx, CellInfo *cell, IdString old_name, IdString new_n
     if (pi.net != nullptr) {
         if (pi.net->driver.cell == cell && pi.net->driver.port == old_name)
             pi.net->driver.port = new_name;
-        for (auto &usr : pi.net->users)
-            if (usr.cell == cell && usr.port == old_name)
-                usr.port = new_name;
+        int idx = find_user(pi.net, cell, old_name, pi);
+        if (idx != -1) {
+            pi.net->users.at(idx).port = new_name;
+            pi.user_idx = idx;
+        }
     }
     cell->ports.erase(old_name);
     pi.name = new_name;
@@ -163,4 +196,32 @@ void rename_net(Context *ctx, NetInfo *net, IdString new_name)
     net->name = new_name;
 }
 
+void compact_netlist(Context *ctx)
+{
+    ctx->cells.compact();
+    ctx->nets.compact();
+    for (auto it = ctx->net_aliases.begin(); it != ctx->net_aliases.end();) {
+        if (ctx->nets.count(it->second))
+            ++it;
+        else
+            it = ctx->net_aliases.erase(it);
+    }
+    // Hash tables keep their peak bucket count after erasing, vectors their peak capacity
+    ctx->net_aliases.rehash(0);
+    for (auto &net : ctx->nets) {
+        NetInfo *ni = net.second.get();
+        ni->users.shrink_to_fit();
+        ni->user_cache.shrink_to_fit();
+        ni->aliases.shrink_to_fit();
+        ni->attrs.rehash(0);
+    }
+    for (auto &cell : ctx->cells) {
+        cell.second->pins.rehash(0);
+        cell.second->constr_children.shrink_to_fit();
+    }
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
 NEXTPNR_NAMESPACE_END
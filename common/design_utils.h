@@ -99,6 +99,11 @@ void rename_net(Context *ctx, NetInfo *net, IdString new_name);
 
 void print_utilisation(const Context *ctx);
 
+// Release the memory left behind by the cells and nets removed during packing: drops the netlist tombstones and the
+// aliases of removed nets, shrinks the per-object containers to their contents, and gives free heap back to the OS.
+// Invalidates all iterators into ctx->cells and ctx->nets, but not pointers to cells and nets.
+void compact_netlist(Context *ctx);
+
 NEXTPNR_NAMESPACE_END
 
 #endif
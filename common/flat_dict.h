@@ -0,0 +1,369 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef FLAT_DICT_H
+#define FLAT_DICT_H
+
+// A map with all entries in one contiguous array, for the routing of a net (NetInfo::wires) where the per-entry
+// allocations and bucket array of std::unordered_map dominate memory use and make walking the whole net slow. It has
+// the subset of the std::unordered_map interface that is used for routing. Lookups are a linear scan, until the map
+// grows beyond index_threshold entries and an open addressing hash index is added. Iteration is in insertion order.
+//
+// Unlike std::unordered_map, adding an entry may move the others, invalidating references and iterators to them.
+// Erasing leaves a dead slot behind and moves nothing, so erasing while iterating, or erasing the entries found by a
+// walk before it, is fine; dead slots are reclaimed when the array next has to grow.
+template <typename K, typename V> class flat_dict
+{
+  public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<const K, V> value_type;
+
+  private:
+    enum : int32_t
+    {
+        index_threshold = 8,
+        index_empty = -1,
+        index_dead = -2
+    };
+
+    struct slot_t
+    {
+        alignas(value_type) unsigned char data[sizeof(value_type)];
+        bool live;
+        value_type &value() { return *reinterpret_cast<value_type *>(data); }
+        const value_type &value() const { return *reinterpret_cast<const value_type *>(data); }
+    };
+
+    std::unique_ptr<slot_t[]> slots;
+    // Allocated slots, slots that have been used at least once, and the number of those that are currently live
+    int capacity = 0, used = 0, live = 0;
+    // Open addressing table of slot indices, a power of two in size and at most half full; empty below the threshold
+    std::vector<int32_t> index;
+
+    int next_live(int i) const
+    {
+        while (i < used && !slots[i].live)
+            i++;
+        return i;
+    }
+
+    size_t hash_pos(const K &key) const { return std::hash<K>()(key) & (index.size() - 1); }
+
+    // Position in the index of the entry for a key, or -1
+    int64_t find_index(const K &key) const
+    {
+        for (size_t pos = hash_pos(key);; pos = (pos + 1) & (index.size() - 1)) {
+            int32_t i = index[pos];
+            if (i == index_empty)
+                return -1;
+            if (i != index_dead && slots[i].value().first == key)
+                return int64_t(pos);
+        }
+    }
+
+    int find_slot(const K &key) const
+    {
+        if (!index.empty()) {
+            int64_t pos = find_index(key);
+            return (pos == -1) ? -1 : index[pos];
+        }
+        for (int i = 0; i < used; i++)
+            if (slots[i].live && slots[i].value().first == key)
+                return i;
+        return -1;
+    }
+
+    void index_insert(const K &key, int i)
+    {
+        size_t pos = hash_pos(key);
+        while (index[pos] >= 0)
+            pos = (pos + 1) & (index.size() - 1);
+        index[pos] = i;
+    }
+
+    void build_index()
+    {
+        index.clear();
+        if (live <= index_threshold)
+            return;
+        size_t size = 4;
+        while (size < 2 * size_t(capacity))
+            size *= 2;
+        index.resize(size, int32_t(index_empty));
+        for (int i = 0; i < used; i++)
+            if (slots[i].live)
+                index_insert(slots[i].value().first, i);
+    }
+
+    // Move the live entries into a new array of the given size, dropping dead slots
+    void reallocate(int new_capacity)
+    {
+        std::unique_ptr<slot_t[]> new_slots(new_capacity ? new slot_t[new_capacity] : nullptr);
+        int j = 0;
+        for (int i = 0; i < used; i++) {
+            if (!slots[i].live)
+                continue;
+            new (new_slots[j].data) value_type(std::move(slots[i].value()));
+            new_slots[j].live = true;
+            slots[i].value().~value_type();
+            j++;
+        }
+        slots = std::move(new_slots);
+        capacity = new_capacity;
+        used = j;
+        build_index();
+    }
+
+    int free_slot()
+    {
+        if (used == capacity) {
+            // Reclaim dead slots rather than growing while at least half the array is dead
+            if (2 * live <= used && used > 0)
+                reallocate(capacity);
+            else
+                reallocate(std::max(4, 2 * capacity));
+        }
+        return used++;
+    }
+
+    void steal(flat_dict &other)
+    {
+        slots = std::move(other.slots);
+        index = std::move(other.index);
+        capacity = other.capacity;
+        used = other.used;
+        live = other.live;
+        other.index.clear();
+        other.capacity = 0;
+        other.used = 0;
+        other.live = 0;
+    }
+
+    void copy(const flat_dict &other)
+    {
+        reserve(other.size());
+        for (auto &entry : other)
+            emplace(entry.first, entry.second);
+    }
+
+  public:
+    class const_iterator;
+
+    class iterator
+    {
+        friend class flat_dict;
+        friend class const_iterator;
+        flat_dict *ptr;
+        int idx;
+        iterator(flat_dict *ptr, int idx) : ptr(ptr), idx(idx) {}
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef flat_dict::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type *pointer;
+        typedef value_type &reference;
+
+        iterator() : ptr(nullptr), idx(0) {}
+        iterator &operator++()
+        {
+            idx = ptr->next_live(idx + 1);
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const iterator &other) const { return idx == other.idx; }
+        bool operator!=(const iterator &other) const { return idx != other.idx; }
+        value_type &operator*() const { return ptr->slots[idx].value(); }
+        value_type *operator->() const { return &ptr->slots[idx].value(); }
+    };
+
+    class const_iterator
+    {
+        friend class flat_dict;
+        const flat_dict *ptr;
+        int idx;
+        const_iterator(const flat_dict *ptr, int idx) : ptr(ptr), idx(idx) {}
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef const flat_dict::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type *pointer;
+        typedef value_type &reference;
+
+        const_iterator() : ptr(nullptr), idx(0) {}
+        const_iterator(const iterator &other) : ptr(other.ptr), idx(other.idx) {}
+        const_iterator &operator++()
+        {
+            idx = ptr->next_live(idx + 1);
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const const_iterator &other) const { return idx == other.idx; }
+        bool operator!=(const const_iterator &other) const { return idx != other.idx; }
+        const value_type &operator*() const { return ptr->slots[idx].value(); }
+        const value_type *operator->() const { return &ptr->slots[idx].value(); }
+    };
+
+    flat_dict() {}
+    flat_dict(const flat_dict &other) { copy(other); }
+    flat_dict(flat_dict &&other) { steal(other); }
+    ~flat_dict() { clear(); }
+
+    flat_dict &operator=(const flat_dict &other)
+    {
+        if (this != &other) {
+            clear();
+            copy(other);
+        }
+        return *this;
+    }
+
+    flat_dict &operator=(flat_dict &&other)
+    {
+        if (this != &other) {
+            clear();
+            steal(other);
+        }
+        return *this;
+    }
+
+    iterator begin() { return iterator(this, next_live(0)); }
+    iterator end() { return iterator(this, used); }
+    const_iterator begin() const { return const_iterator(this, next_live(0)); }
+    const_iterator end() const { return const_iterator(this, used); }
+
+    size_t size() const { return live; }
+    bool empty() const { return live == 0; }
+
+    iterator find(const K &key)
+    {
+        int i = find_slot(key);
+        return iterator(this, (i == -1) ? used : i);
+    }
+
+    const_iterator find(const K &key) const
+    {
+        int i = find_slot(key);
+        return const_iterator(this, (i == -1) ? used : i);
+    }
+
+    size_t count(const K &key) const { return (find_slot(key) == -1) ? 0 : 1; }
+
+    V &at(const K &key)
+    {
+        int i = find_slot(key);
+        if (i == -1)
+            throw std::out_of_range("flat_dict::at()");
+        return slots[i].value().second;
+    }
+
+    const V &at(const K &key) const
+    {
+        int i = find_slot(key);
+        if (i == -1)
+            throw std::out_of_range("flat_dict::at()");
+        return slots[i].value().second;
+    }
+
+    template <typename... Args> std::pair<iterator, bool> emplace(const K &key, Args &&... args)
+    {
+        int i = find_slot(key);
+        if (i != -1)
+            return std::make_pair(iterator(this, i), false);
+        i = free_slot();
+        slot_t &s = slots[i];
+        new (s.data) value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+        s.live = true;
+        live++;
+        if (!index.empty())
+            index_insert(key, i);
+        else if (live > index_threshold)
+            build_index();
+        return std::make_pair(iterator(this, i), true);
+    }
+
+    template <typename P> std::pair<iterator, bool> insert(P &&entry)
+    {
+        return emplace(entry.first, std::forward<P>(entry).second);
+    }
+
+    V &operator[](const K &key) { return emplace(key).first->second; }
+
+    size_t erase(const K &key)
+    {
+        int i;
+        if (!index.empty()) {
+            int64_t pos = find_index(key);
+            if (pos == -1)
+                return 0;
+            i = index[pos];
+            index[pos] = index_dead;
+        } else {
+            i = find_slot(key);
+            if (i == -1)
+                return 0;
+        }
+        slots[i].value().~value_type();
+        slots[i].live = false;
+        live--;
+        return 1;
+    }
+
+    iterator erase(iterator it)
+    {
+        iterator next = it;
+        ++next;
+        erase(it->first);
+        return next;
+    }
+
+    void reserve(size_t n)
+    {
+        if (int(n) > capacity)
+            reallocate(int(n));
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < used; i++)
+            if (slots[i].live)
+                slots[i].value().~value_type();
+        slots.reset();
+        index.clear();
+        capacity = 0;
+        used = 0;
+        live = 0;
+    }
+
+    // Heap memory used, not counting what the entries own
+    size_t heap_size() const { return capacity * sizeof(slot_t) + index.capacity() * sizeof(int32_t); }
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "fmax_search.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "log.h"
+#include "router2.h"
+#include "timing.h"
+#include "util.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+
+// The routing of a set of nets, to put back after a round that did worse
+struct SavedRouting
+{
+    struct Entry
+    {
+        NetInfo *net;
+        std::vector<std::pair<WireId, PipMap>> wires;
+    };
+    std::vector<Entry> nets;
+
+    void save(Context *ctx, const std::vector<IdString> &names)
+    {
+        nets.clear();
+        for (IdString name : names) {
+            NetInfo *ni = ctx->nets.at(name).get();
+            nets.push_back({ni, std::vector<std::pair<WireId, PipMap>>(ni->wires.begin(), ni->wires.end())});
+        }
+    }
+
+    void restore(Context *ctx)
+    {
+        for (auto &entry : nets) {
+            std::vector<WireId> bound;
+            for (auto &w : entry.net->wires)
+                bound.push_back(w.first);
+            for (WireId wire : bound)
+                ctx->unbindWire(wire);
+        }
+        for (auto &entry : nets) {
+            for (auto &w : entry.wires) {
+                if (w.second.pip == PipId())
+                    ctx->bindWire(w.first, entry.net, w.second.strength);
+                else
+                    ctx->bindPip(w.second.pip, entry.net, w.second.strength);
+            }
+        }
+        ctx->archInfoToAttributes();
+    }
+};
+
+// Nets with at least one arc that fails the current target frequency
+std::vector<IdString> failing_nets(Context *ctx)
+{
+    NetCriticalityMap net_crit;
+    assign_net_udata(ctx);
+    get_criticalities(ctx, &net_crit);
+    std::vector<IdString> failing;
+    for (auto net : sorted(ctx->nets)) {
+        NetInfo *ni = net.second;
+        for (int i = 0; i < net_crit.num_arcs(ni); i++) {
+            if (net_crit.arc_slack(ni, i) < 0) {
+                failing.push_back(ni->name);
+                break;
+            }
+        }
+    }
+    return failing;
+}
+
+void reroute_nets(Context *ctx, const std::vector<IdString> &names)
+{
+#ifdef ARCH_XILINX
+    ctx->reroute(names, {})->wait();
+#else
+    Router2Cfg cfg(ctx);
+    cfg.only_nets = names;
+    router2(ctx, cfg);
+#endif
+}
+
+} // namespace
+
+double fmax_search(Context *ctx)
+{
+    int steps = std::max(1, ctx->setting<int>("fmaxSearch/steps", 8));
+    float step = std::max(0.001f, ctx->setting<float>("fmaxSearch/step", 0.05f));
+    Property orig_target = ctx->settings.at(ctx->id("target_freq"));
+
+    double best = achieved_fmax(ctx);
+    log_break();
+    log_info("Searching for the highest frequency, starting from %.2f MHz.\n", best / 1e6);
+    SavedRouting saved;
+    for (int round = 0; round < steps && best > 0; round++) {
+        double target = best * (1 + step);
+        ctx->settings[ctx->id("target_freq")] = std::to_string(target);
+        std::vector<IdString> failing = failing_nets(ctx);
+        log_info("    round %d: target %.2f MHz, rerouting %d nets\n", round + 1, target / 1e6, int(failing.size()));
+        if (failing.empty())
+            break;
+        saved.save(ctx, failing);
+        reroute_nets(ctx, failing);
+        double fmax = achieved_fmax(ctx);
+        log_info("    round %d: achieved %.2f MHz\n", round + 1, fmax / 1e6);
+        if (fmax <= best) {
+            saved.restore(ctx);
+            break;
+        }
+        best = fmax;
+    }
+    ctx->settings[ctx->id("target_freq")] = orig_target;
+    log_info("Highest frequency found: %.2f MHz.\n", best / 1e6);
+    return best;
+}
+
+NEXTPNR_NAMESPACE_END
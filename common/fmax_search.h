@@ -0,0 +1,34 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef FMAX_SEARCH_H
+#define FMAX_SEARCH_H
+
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Find the highest frequency a placed and routed design can be routed at, without running the flow again. The target
+// is repeatedly set a step (fmaxSearch/step, default 5%) above the frequency achieved so far, and only the nets with
+// arcs failing at that target are rerouted by timing-driven router2, keeping the routing of the rest. The search
+// stops after fmaxSearch/steps rounds, or once a round doesn't improve on the best frequency, whose routing is then
+// put back. The target frequency setting is left as it was. Returns the best frequency found, in Hz.
+double fmax_search(Context *ctx);
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -12,9 +12,6 @@
 #ifndef HASHLIB_H
 #define HASHLIB_H
 
-const int hashtable_size_trigger = 2;
-const int hashtable_size_factor = 3;
-
 // The XOR version of DJB2
 inline unsigned int mkhash(unsigned int a, unsigned int b) { return ((a << 5) + a) ^ b; }
 
@@ -75,7 +72,10 @@ template <> struct hash_ops<uint64_t> : hash_int_ops
 
 template <> struct hash_ops<std::string>
 {
+    // Strings can also be looked up by a C string, without making a std::string of it
+    typedef void is_transparent;
     static inline bool cmp(const std::string &a, const std::string &b) { return a == b; }
+    static inline bool cmp(const std::string &a, const char *b) { return a == b; }
     static inline unsigned int hash(const std::string &a)
     {
         unsigned int v = 0;
@@ -83,6 +83,13 @@ template <> struct hash_ops<std::string>
             v = mkhash(v, c);
         return v;
     }
+    static inline unsigned int hash(const char *a)
+    {
+        unsigned int v = 0;
+        while (*a)
+            v = mkhash(v, *(a++));
+        return v;
+    }
 };
 
 template <typename P, typename Q> struct hash_ops<std::pair<P, Q>>
@@ -154,186 +161,300 @@ struct hash_obj_ops
 
 template <typename T> inline unsigned int mkhash(const T &v) { return hash_ops<T>().hash(v); }
 
-inline int hashtable_size(int min_size)
-{
-    static std::vector<int> zero_and_some_primes = {
-            0,         23,        29,        37,        47,       59,       79,       101,      127,      163,
-            211,       269,       337,       431,       541,      677,      853,      1069,     1361,     1709,
-            2137,      2677,      3347,      4201,      5261,     6577,     8231,     10289,    12889,    16127,
-            20161,     25219,     31531,     39419,     49277,    61603,    77017,    96281,    120371,   150473,
-            188107,    235159,    293957,    367453,    459317,   574157,   717697,   897133,   1121423,  1401791,
-            1752239,   2190299,   2737937,   3422429,   4278037,  5347553,  6684443,  8355563,  10444457, 13055587,
-            16319519,  20399411,  25499291,  31874149,  39842687, 49803361, 62254207, 77817767, 97272239, 121590311,
-            151987889, 189984863, 237481091, 296851369, 371064217};
-
-    for (auto p : zero_and_some_primes)
-        if (p >= min_size)
-            return p;
-
-    if (sizeof(int) == 4)
-        throw std::length_error("hash table exceeded maximum size. use a ILP64 abi for larger tables.");
-
-    for (auto p : zero_and_some_primes)
-        if (100129 * p > min_size)
-            return 100129 * p;
-
-    throw std::length_error("hash table exceeded maximum size.");
-}
-
-template <typename K, typename T, typename OPS = hash_ops<K>> class dict;
-template <typename K, int offset = 0, typename OPS = hash_ops<K>> class idict;
-template <typename K, typename OPS = hash_ops<K>> class pool;
-template <typename K, typename OPS = hash_ops<K>> class mfp;
-
-template <typename K, typename T, typename OPS> class dict
+// The hash index of a dict or pool, in the style of SwissTable. It maps hashes to entry numbers, the entries
+// themselves being kept densely in insertion order by the container. Slots are open addressed, in groups of 12 that
+// are probed as a whole: each slot has a control byte with 7 bits of the hash of its entry, or marking it empty or
+// deleted, so a group is searched by comparing its control bytes (with SSE2, in one instruction) and only the entries
+// whose bits match are compared by key. A group keeps its control bytes next to its slots, 64 bytes in all, so that
+// probing it takes one cache line. Groups are visited in triangular order from the one the hash picks.
+class hashtable_index
 {
-    struct entry_t
+  public:
+    enum
     {
-        std::pair<K, T> udata;
-        int next;
+        group_slots = 12
+    };
+    enum : uint8_t
+    {
+        ctrl_empty = 0x80,
+        ctrl_deleted = 0xfe
+    };
 
-        entry_t() {}
-        entry_t(const std::pair<K, T> &udata, int next) : udata(udata), next(next) {}
-        entry_t(std::pair<K, T> &&udata, int next) : udata(std::move(udata)), next(next) {}
-        bool operator<(const entry_t &other) const { return udata.first < other.udata.first; }
+    struct group_t
+    {
+        // Padded to 16 for the SSE2 compare; the padding bytes are never looked at
+        uint8_t ctrl[16];
+        int32_t slots[group_slots];
     };
 
-    std::vector<int> hashtable;
-    std::vector<entry_t> entries;
-    OPS ops;
+    // Groups are aligned to cache lines within storage, which has room for that
+    std::unique_ptr<char[]> storage;
+    group_t *groups = nullptr;
+    size_t group_count = 0;
+    // Slots that can still be filled before the index has to grow; deleted slots are only reused, not counted
+    size_t growth_left = 0;
+
+    // Spread the bits of a hash from hash_ops, many of which only set the low bits: the high half of a multiplication
+    // by the golden ratio, whose bits all depend on those of the hash. The low 7 bits are the control byte of an entry.
+    static inline unsigned int mix(unsigned int h) { return unsigned((uint64_t(h) * 0x9e3779b97f4a7c15ULL) >> 32); }
+
+    // At most 7/8 of the slots are filled
+    static size_t max_load(size_t capacity) { return capacity - capacity / 8; }
+
+    // The size to rebuild for when there is no growth left with size entries: twice as large if they fill more than
+    // half of it, otherwise the same size, just clearing out the deleted slots
+    size_t grow_size(size_t size) const { return 2 * size > max_load(capacity()) ? 2 * size : size + 1; }
 
-#ifdef NDEBUG
-    static inline void do_assert(bool) {}
+    bool empty() const { return group_count == 0; }
+    size_t capacity() const { return group_count * group_slots; }
+
+    // Bit i is set if control byte i of group g is b
+    static inline uint32_t match(const group_t &g, uint8_t b)
+    {
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g.ctrl));
+        return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(char(b))))) & 0xfff;
 #else
-    static inline void do_assert(bool cond) { NPNR_ASSERT(cond); }
+        uint32_t bits = 0;
+        for (int i = 0; i < group_slots; i++)
+            if (g.ctrl[i] == b)
+                bits |= (1U << i);
+        return bits;
 #endif
+    }
 
-    int do_hash(const K &key) const
+    // Bit i is set if slot i of group g is empty or deleted, the control bytes with the top bit set
+    static inline uint32_t match_free(const group_t &g)
     {
-        unsigned int hash = 0;
-        if (!hashtable.empty())
-            hash = ops.hash(key) % (unsigned int)(hashtable.size());
-        return hash;
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g.ctrl));
+        return uint32_t(_mm_movemask_epi8(ctrl)) & 0xfff;
+#else
+        uint32_t bits = 0;
+        for (int i = 0; i < group_slots; i++)
+            if (g.ctrl[i] & 0x80)
+                bits |= (1U << i);
+        return bits;
+#endif
     }
 
-    void do_rehash()
+    static inline int lowest_bit(uint32_t bits)
     {
-        hashtable.clear();
-        hashtable.resize(hashtable_size(entries.capacity() * hashtable_size_factor), -1);
-
-        for (int i = 0; i < int(entries.size()); i++) {
-            do_assert(-1 <= entries[i].next && entries[i].next < int(entries.size()));
-            int hash = do_hash(entries[i].udata.first);
-            entries[i].next = hashtable[hash];
-            hashtable[hash] = i;
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctz(bits);
+#else
+        int i = 0;
+        while (!(bits & 1)) {
+            bits >>= 1;
+            i++;
         }
+        return i;
+#endif
     }
 
-    int do_erase(int index, int hash)
+    // The entry number of the first slot on the probe sequence of hash with a matching entry, or -1; its position is
+    // stored in pos if given
+    template <typename F> int find(unsigned int hash, F is_match, size_t *pos = nullptr) const
     {
-        do_assert(index < int(entries.size()));
-        if (hashtable.empty() || index < 0)
-            return 0;
-
-        int k = hashtable[hash];
-        do_assert(0 <= k && k < int(entries.size()));
-
-        if (k == index) {
-            hashtable[hash] = entries[index].next;
-        } else {
-            while (entries[k].next != index) {
-                k = entries[k].next;
-                do_assert(0 <= k && k < int(entries.size()));
+        if (group_count == 0)
+            return -1;
+        size_t mask = group_count - 1;
+        size_t g = (hash >> 7) & mask;
+        for (size_t step = 1;; step++) {
+            const group_t &group = groups[g];
+            for (uint32_t bits = match(group, hash & 0x7f); bits != 0; bits &= bits - 1) {
+                int i = group.slots[lowest_bit(bits)];
+                if (is_match(i)) {
+                    if (pos != nullptr)
+                        *pos = g * group_slots + lowest_bit(bits);
+                    return i;
+                }
             }
-            entries[k].next = entries[index].next;
+            if (match(group, ctrl_empty) != 0)
+                return -1;
+            g = (g + step) & mask;
         }
+    }
 
-        int back_idx = entries.size() - 1;
+    // The position of the slot holding entry number i, which has hash
+    size_t find_slot(unsigned int hash, int i) const
+    {
+        size_t mask = group_count - 1;
+        size_t g = (hash >> 7) & mask;
+        for (size_t step = 1;; step++) {
+            const group_t &group = groups[g];
+            for (uint32_t bits = match(group, hash & 0x7f); bits != 0; bits &= bits - 1)
+                if (group.slots[lowest_bit(bits)] == i)
+                    return g * group_slots + lowest_bit(bits);
+            NPNR_ASSERT(match(group, ctrl_empty) == 0);
+            g = (g + step) & mask;
+        }
+    }
 
-        if (index != back_idx) {
-            int back_hash = do_hash(entries[back_idx].udata.first);
+    void set_slot(size_t pos, int i) { groups[pos / group_slots].slots[pos % group_slots] = i; }
 
-            k = hashtable[back_hash];
-            do_assert(0 <= k && k < int(entries.size()));
+    // Start loading the first group on the probe sequence of hash
+    void prefetch(unsigned int hash) const
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(&groups[(hash >> 7) & (group_count - 1)]);
+#endif
+    }
 
-            if (k == back_idx) {
-                hashtable[back_hash] = index;
-            } else {
-                while (entries[k].next != back_idx) {
-                    k = entries[k].next;
-                    do_assert(0 <= k && k < int(entries.size()));
-                }
-                entries[k].next = index;
+    // Add entry numbers 0 to count - 1, with hashes given by hash_of, after a reset. Their groups are visited in
+    // random order, so each is loaded a few entries ahead
+    template <typename F> void insert_all(int count, F hash_of)
+    {
+        const int ahead = 8;
+        unsigned int hashes[ahead];
+        for (int i = 0; i < std::min(ahead, count); i++) {
+            hashes[i] = hash_of(i);
+            prefetch(hashes[i]);
+        }
+        for (int i = 0; i < count; i++) {
+            unsigned int hash = hashes[i % ahead];
+            if (i + ahead < count) {
+                hashes[i % ahead] = hash_of(i + ahead);
+                prefetch(hashes[i % ahead]);
             }
+            insert(hash, i);
+        }
+    }
 
-            entries[index] = std::move(entries[back_idx]);
+    // Add entry number i with hash, which must not be in the index yet; there must be growth left
+    void insert(unsigned int hash, int i)
+    {
+        size_t mask = group_count - 1;
+        size_t g = (hash >> 7) & mask;
+        for (size_t step = 1;; step++) {
+            group_t &group = groups[g];
+            uint32_t bits = match_free(group);
+            if (bits != 0) {
+                int k = lowest_bit(bits);
+                if (group.ctrl[k] == ctrl_empty)
+                    growth_left--;
+                group.ctrl[k] = uint8_t(hash & 0x7f);
+                group.slots[k] = i;
+                return;
+            }
+            g = (g + step) & mask;
         }
+    }
 
-        entries.pop_back();
+    // A slot can go back to empty if its group still has an empty slot, as then no probe has gone past the group
+    void erase_slot(size_t pos)
+    {
+        group_t &group = groups[pos / group_slots];
+        int k = pos % group_slots;
+        if (match(group, ctrl_empty) != 0) {
+            group.ctrl[k] = ctrl_empty;
+            growth_left++;
+        } else {
+            group.ctrl[k] = ctrl_deleted;
+        }
+        group.slots[k] = -1;
+    }
 
-        if (entries.empty())
-            hashtable.clear();
+    // Empty the index, making room for at least n entries
+    void reset(size_t n)
+    {
+        if (n == 0) {
+            clear();
+            return;
+        }
+        size_t count = 1;
+        while (max_load(count * group_slots) < n) {
+            if (count * group_slots > size_t(std::numeric_limits<int>::max() / 2))
+                throw std::length_error("hash table exceeded maximum size.");
+            count *= 2;
+        }
+        storage.reset(new char[(count + 1) * sizeof(group_t)]);
+        groups = reinterpret_cast<group_t *>((uintptr_t(storage.get()) + sizeof(group_t) - 1) & ~uintptr_t(63));
+        group_count = count;
+        for (size_t g = 0; g < count; g++) {
+            std::fill(groups[g].ctrl, groups[g].ctrl + 16, uint8_t(ctrl_empty));
+            std::fill(groups[g].slots, groups[g].slots + group_slots, -1);
+        }
+        growth_left = max_load(capacity());
+    }
 
-        return 1;
+    void clear()
+    {
+        storage.reset();
+        groups = nullptr;
+        group_count = 0;
+        growth_left = 0;
     }
 
-    int do_lookup(const K &key, int &hash) const
+    void swap(hashtable_index &other)
     {
-        if (hashtable.empty())
-            return -1;
+        storage.swap(other.storage);
+        std::swap(groups, other.groups);
+        std::swap(group_count, other.group_count);
+        std::swap(growth_left, other.growth_left);
+    }
+};
 
-        if (entries.size() * hashtable_size_trigger > hashtable.size()) {
-            ((dict *)this)->do_rehash();
-            hash = do_hash(key);
-        }
+template <typename K, typename T, typename OPS = hash_ops<K>> class dict;
+template <typename K, int offset = 0, typename OPS = hash_ops<K>> class idict;
+template <typename K, typename OPS = hash_ops<K>> class pool;
+template <typename K, typename OPS = hash_ops<K>> class mfp;
 
-        int index = hashtable[hash];
+template <typename K, typename T, typename OPS> class dict
+{
+    struct entry_t
+    {
+        std::pair<K, T> udata;
 
-        while (index >= 0 && !ops.cmp(entries[index].udata.first, key)) {
-            index = entries[index].next;
-            do_assert(-1 <= index && index < int(entries.size()));
-        }
+        entry_t() {}
+        entry_t(const std::pair<K, T> &udata) : udata(udata) {}
+        entry_t(std::pair<K, T> &&udata) : udata(std::move(udata)) {}
+        bool operator<(const entry_t &other) const { return udata.first < other.udata.first; }
+    };
 
-        return index;
+    hashtable_index index;
+    std::vector<entry_t> entries;
+    OPS ops;
+
+    template <typename Q> unsigned int do_hash(const Q &key) const { return hashtable_index::mix(ops.hash(key)); }
+
+    // Rebuild the index with room for at least n entries
+    void do_rehash(size_t n = 0)
+    {
+        index.reset(std::max(n, entries.size()));
+        index.insert_all(int(entries.size()), [&](int i) { return do_hash(entries[i].udata.first); });
     }
 
-    int do_insert(const K &key, int &hash)
+    // Erase entry number i, which is in slot pos of the index
+    int do_erase(int i, size_t pos)
     {
-        if (hashtable.empty()) {
-            entries.emplace_back(std::pair<K, T>(key, T()), -1);
-            do_rehash();
-            hash = do_hash(key);
-        } else {
-            entries.emplace_back(std::pair<K, T>(key, T()), hashtable[hash]);
-            hashtable[hash] = entries.size() - 1;
+        if (i < 0)
+            return 0;
+        index.erase_slot(pos);
+
+        int back_idx = entries.size() - 1;
+        if (i != back_idx) {
+            index.set_slot(index.find_slot(do_hash(entries[back_idx].udata.first), back_idx), i);
+            entries[i] = std::move(entries[back_idx]);
         }
-        return entries.size() - 1;
+        entries.pop_back();
+
+        if (entries.empty())
+            index.clear();
+        return 1;
     }
 
-    int do_insert(const std::pair<K, T> &value, int &hash)
+    template <typename Q> int do_lookup(const Q &key, unsigned int hash, size_t *pos = nullptr) const
     {
-        if (hashtable.empty()) {
-            entries.emplace_back(value, -1);
-            do_rehash();
-            hash = do_hash(value.first);
-        } else {
-            entries.emplace_back(value, hashtable[hash]);
-            hashtable[hash] = entries.size() - 1;
-        }
-        return entries.size() - 1;
+        return index.find(hash, [&](int i) { return ops.cmp(entries[i].udata.first, key); }, pos);
     }
 
-    int do_insert(std::pair<K, T> &&rvalue, int &hash)
+    template <typename V> int do_insert(V &&value, unsigned int hash)
     {
-        if (hashtable.empty()) {
-            auto key = rvalue.first;
-            entries.emplace_back(std::forward<std::pair<K, T>>(rvalue), -1);
-            do_rehash();
-            hash = do_hash(key);
-        } else {
-            entries.emplace_back(std::forward<std::pair<K, T>>(rvalue), hashtable[hash]);
-            hashtable[hash] = entries.size() - 1;
-        }
+        if (index.growth_left == 0)
+            do_rehash(index.grow_size(entries.size()));
+        entries.emplace_back(std::forward<V>(value));
+        index.insert(hash, entries.size() - 1);
         return entries.size() - 1;
     }
 
@@ -441,17 +562,17 @@ template <typename K, typename T, typename OPS> class dict
 
     std::pair<iterator, bool> insert(const K &key)
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i >= 0)
             return std::pair<iterator, bool>(iterator(this, i), false);
-        i = do_insert(key, hash);
+        i = do_insert(std::pair<K, T>(key, T()), hash);
         return std::pair<iterator, bool>(iterator(this, i), true);
     }
 
     std::pair<iterator, bool> insert(const std::pair<K, T> &value)
     {
-        int hash = do_hash(value.first);
+        unsigned int hash = do_hash(value.first);
         int i = do_lookup(value.first, hash);
         if (i >= 0)
             return std::pair<iterator, bool>(iterator(this, i), false);
@@ -461,7 +582,7 @@ template <typename K, typename T, typename OPS> class dict
 
     std::pair<iterator, bool> insert(std::pair<K, T> &&rvalue)
     {
-        int hash = do_hash(rvalue.first);
+        unsigned int hash = do_hash(rvalue.first);
         int i = do_lookup(rvalue.first, hash);
         if (i >= 0)
             return std::pair<iterator, bool>(iterator(this, i), false);
@@ -471,7 +592,7 @@ template <typename K, typename T, typename OPS> class dict
 
     std::pair<iterator, bool> emplace(K const &key, T const &value)
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i >= 0)
             return std::pair<iterator, bool>(iterator(this, i), false);
@@ -481,7 +602,7 @@ template <typename K, typename T, typename OPS> class dict
 
     std::pair<iterator, bool> emplace(K const &key, T &&rvalue)
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i >= 0)
             return std::pair<iterator, bool>(iterator(this, i), false);
@@ -491,7 +612,7 @@ template <typename K, typename T, typename OPS> class dict
 
     std::pair<iterator, bool> emplace(K &&rkey, T const &value)
     {
-        int hash = do_hash(rkey);
+        unsigned int hash = do_hash(rkey);
         int i = do_lookup(rkey, hash);
         if (i >= 0)
             return std::pair<iterator, bool>(iterator(this, i), false);
@@ -501,7 +622,7 @@ template <typename K, typename T, typename OPS> class dict
 
     std::pair<iterator, bool> emplace(K &&rkey, T &&rvalue)
     {
-        int hash = do_hash(rkey);
+        unsigned int hash = do_hash(rkey);
         int i = do_lookup(rkey, hash);
         if (i >= 0)
             return std::pair<iterator, bool>(iterator(this, i), false);
@@ -511,35 +632,34 @@ template <typename K, typename T, typename OPS> class dict
 
     int erase(const K &key)
     {
-        int hash = do_hash(key);
-        int index = do_lookup(key, hash);
-        return do_erase(index, hash);
+        size_t pos = 0;
+        int i = do_lookup(key, do_hash(key), &pos);
+        return do_erase(i, pos);
     }
 
     iterator erase(iterator it)
     {
-        int hash = do_hash(it->first);
-        do_erase(it.index, hash);
+        do_erase(it.index, index.find_slot(do_hash(it->first), it.index));
         return ++it;
     }
 
     int count(const K &key) const
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         return i < 0 ? 0 : 1;
     }
 
     int count(const K &key, const_iterator it) const
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         return i < 0 || i > it.index ? 0 : 1;
     }
 
     iterator find(const K &key)
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i < 0)
             return end();
@@ -548,7 +668,7 @@ template <typename K, typename T, typename OPS> class dict
 
     const_iterator find(const K &key) const
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i < 0)
             return end();
@@ -557,7 +677,7 @@ template <typename K, typename T, typename OPS> class dict
 
     T &at(const K &key)
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i < 0)
             throw std::out_of_range("dict::at()");
@@ -566,7 +686,7 @@ template <typename K, typename T, typename OPS> class dict
 
     const T &at(const K &key) const
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i < 0)
             throw std::out_of_range("dict::at()");
@@ -575,16 +695,55 @@ template <typename K, typename T, typename OPS> class dict
 
     const T &at(const K &key, const T &defval) const
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i < 0)
             return defval;
         return entries[i].udata.second;
     }
 
+    // Lookup by another type of key, for hash_ops that can hash it and compare it with K, marked is_transparent
+    template <typename Q, typename O = OPS, typename = typename O::is_transparent> iterator find(const Q &key)
+    {
+        int i = do_lookup(key, do_hash(key));
+        if (i < 0)
+            return end();
+        return iterator(this, i);
+    }
+
+    template <typename Q, typename O = OPS, typename = typename O::is_transparent>
+    const_iterator find(const Q &key) const
+    {
+        int i = do_lookup(key, do_hash(key));
+        if (i < 0)
+            return end();
+        return const_iterator(this, i);
+    }
+
+    template <typename Q, typename O = OPS, typename = typename O::is_transparent> int count(const Q &key) const
+    {
+        return do_lookup(key, do_hash(key)) < 0 ? 0 : 1;
+    }
+
+    template <typename Q, typename O = OPS, typename = typename O::is_transparent> T &at(const Q &key)
+    {
+        int i = do_lookup(key, do_hash(key));
+        if (i < 0)
+            throw std::out_of_range("dict::at()");
+        return entries[i].udata.second;
+    }
+
+    template <typename Q, typename O = OPS, typename = typename O::is_transparent> const T &at(const Q &key) const
+    {
+        int i = do_lookup(key, do_hash(key));
+        if (i < 0)
+            throw std::out_of_range("dict::at()");
+        return entries[i].udata.second;
+    }
+
     T &operator[](const K &key)
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i < 0)
             i = do_insert(std::pair<K, T>(key, T()), hash);
@@ -600,7 +759,7 @@ template <typename K, typename T, typename OPS> class dict
 
     void swap(dict &other)
     {
-        hashtable.swap(other.hashtable);
+        index.swap(other.index);
         entries.swap(other.entries);
     }
 
@@ -628,12 +787,18 @@ template <typename K, typename T, typename OPS> class dict
         return h;
     }
 
-    void reserve(size_t n) { entries.reserve(n); }
+    // Make room for n entries, so that adding up to that many does not rehash
+    void reserve(size_t n)
+    {
+        entries.reserve(n);
+        if (n > entries.size() + index.growth_left)
+            do_rehash(n);
+    }
     size_t size() const { return entries.size(); }
     bool empty() const { return entries.empty(); }
     void clear()
     {
-        hashtable.clear();
+        index.clear();
         entries.clear();
     }
 
@@ -654,131 +819,55 @@ template <typename K, typename OPS> class pool
     struct entry_t
     {
         K udata;
-        int next;
 
         entry_t() {}
-        entry_t(const K &udata, int next) : udata(udata), next(next) {}
-        entry_t(K &&udata, int next) : udata(std::move(udata)), next(next) {}
+        entry_t(const K &udata) : udata(udata) {}
+        entry_t(K &&udata) : udata(std::move(udata)) {}
     };
 
-    std::vector<int> hashtable;
+    hashtable_index index;
     std::vector<entry_t> entries;
     OPS ops;
 
-#ifdef NDEBUG
-    static inline void do_assert(bool) {}
-#else
-    static inline void do_assert(bool cond) { NPNR_ASSERT(cond); }
-#endif
-
-    int do_hash(const K &key) const
-    {
-        unsigned int hash = 0;
-        if (!hashtable.empty())
-            hash = ops.hash(key) % (unsigned int)(hashtable.size());
-        return hash;
-    }
+    template <typename Q> unsigned int do_hash(const Q &key) const { return hashtable_index::mix(ops.hash(key)); }
 
-    void do_rehash()
+    // Rebuild the index with room for at least n entries
+    void do_rehash(size_t n = 0)
     {
-        hashtable.clear();
-        hashtable.resize(hashtable_size(entries.capacity() * hashtable_size_factor), -1);
-
-        for (int i = 0; i < int(entries.size()); i++) {
-            do_assert(-1 <= entries[i].next && entries[i].next < int(entries.size()));
-            int hash = do_hash(entries[i].udata);
-            entries[i].next = hashtable[hash];
-            hashtable[hash] = i;
-        }
+        index.reset(std::max(n, entries.size()));
+        index.insert_all(int(entries.size()), [&](int i) { return do_hash(entries[i].udata); });
     }
 
-    int do_erase(int index, int hash)
+    // Erase entry number i, which is in slot pos of the index
+    int do_erase(int i, size_t pos)
     {
-        do_assert(index < int(entries.size()));
-        if (hashtable.empty() || index < 0)
+        if (i < 0)
             return 0;
-
-        int k = hashtable[hash];
-        if (k == index) {
-            hashtable[hash] = entries[index].next;
-        } else {
-            while (entries[k].next != index) {
-                k = entries[k].next;
-                do_assert(0 <= k && k < int(entries.size()));
-            }
-            entries[k].next = entries[index].next;
-        }
+        index.erase_slot(pos);
 
         int back_idx = entries.size() - 1;
-
-        if (index != back_idx) {
-            int back_hash = do_hash(entries[back_idx].udata);
-
-            k = hashtable[back_hash];
-            if (k == back_idx) {
-                hashtable[back_hash] = index;
-            } else {
-                while (entries[k].next != back_idx) {
-                    k = entries[k].next;
-                    do_assert(0 <= k && k < int(entries.size()));
-                }
-                entries[k].next = index;
-            }
-
-            entries[index] = std::move(entries[back_idx]);
+        if (i != back_idx) {
+            index.set_slot(index.find_slot(do_hash(entries[back_idx].udata), back_idx), i);
+            entries[i] = std::move(entries[back_idx]);
         }
-
         entries.pop_back();
 
         if (entries.empty())
-            hashtable.clear();
-
+            index.clear();
         return 1;
     }
 
-    int do_lookup(const K &key, int &hash) const
-    {
-        if (hashtable.empty())
-            return -1;
-
-        if (entries.size() * hashtable_size_trigger > hashtable.size()) {
-            ((pool *)this)->do_rehash();
-            hash = do_hash(key);
-        }
-
-        int index = hashtable[hash];
-
-        while (index >= 0 && !ops.cmp(entries[index].udata, key)) {
-            index = entries[index].next;
-            do_assert(-1 <= index && index < int(entries.size()));
-        }
-
-        return index;
-    }
-
-    int do_insert(const K &value, int &hash)
+    template <typename Q> int do_lookup(const Q &key, unsigned int hash, size_t *pos = nullptr) const
     {
-        if (hashtable.empty()) {
-            entries.emplace_back(value, -1);
-            do_rehash();
-            hash = do_hash(value);
-        } else {
-            entries.emplace_back(value, hashtable[hash]);
-            hashtable[hash] = entries.size() - 1;
-        }
-        return entries.size() - 1;
+        return index.find(hash, [&](int i) { return ops.cmp(entries[i].udata, key); }, pos);
     }
 
-    int do_insert(K &&rvalue, int &hash)
+    template <typename V> int do_insert(V &&value, unsigned int hash)
     {
-        if (hashtable.empty()) {
-            entries.emplace_back(std::forward<K>(rvalue), -1);
-            do_rehash();
-            hash = do_hash(rvalue);
-        } else {
-            entries.emplace_back(std::forward<K>(rvalue), hashtable[hash]);
-            hashtable[hash] = entries.size() - 1;
-        }
+        if (index.growth_left == 0)
+            do_rehash(index.grow_size(entries.size()));
+        entries.emplace_back(std::forward<V>(value));
+        index.insert(hash, entries.size() - 1);
         return entries.size() - 1;
     }
 
@@ -870,7 +959,7 @@ template <typename K, typename OPS> class pool
 
     std::pair<iterator, bool> insert(const K &value)
     {
-        int hash = do_hash(value);
+        unsigned int hash = do_hash(value);
         int i = do_lookup(value, hash);
         if (i >= 0)
             return std::pair<iterator, bool>(iterator(this, i), false);
@@ -880,7 +969,7 @@ template <typename K, typename OPS> class pool
 
     std::pair<iterator, bool> insert(K &&rvalue)
     {
-        int hash = do_hash(rvalue);
+        unsigned int hash = do_hash(rvalue);
         int i = do_lookup(rvalue, hash);
         if (i >= 0)
             return std::pair<iterator, bool>(iterator(this, i), false);
@@ -895,35 +984,34 @@ template <typename K, typename OPS> class pool
 
     int erase(const K &key)
     {
-        int hash = do_hash(key);
-        int index = do_lookup(key, hash);
-        return do_erase(index, hash);
+        size_t pos = 0;
+        int i = do_lookup(key, do_hash(key), &pos);
+        return do_erase(i, pos);
     }
 
     iterator erase(iterator it)
     {
-        int hash = do_hash(*it);
-        do_erase(it.index, hash);
+        do_erase(it.index, index.find_slot(do_hash(*it), it.index));
         return ++it;
     }
 
     int count(const K &key) const
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         return i < 0 ? 0 : 1;
     }
 
     int count(const K &key, const_iterator it) const
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         return i < 0 || i > it.index ? 0 : 1;
     }
 
     iterator find(const K &key)
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i < 0)
             return end();
@@ -932,16 +1020,31 @@ template <typename K, typename OPS> class pool
 
     const_iterator find(const K &key) const
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         if (i < 0)
             return end();
         return const_iterator(this, i);
     }
 
+    // Lookup by another type of key, for hash_ops that can hash it and compare it with K, marked is_transparent
+    template <typename Q, typename O = OPS, typename = typename O::is_transparent>
+    const_iterator find(const Q &key) const
+    {
+        int i = do_lookup(key, do_hash(key));
+        if (i < 0)
+            return end();
+        return const_iterator(this, i);
+    }
+
+    template <typename Q, typename O = OPS, typename = typename O::is_transparent> int count(const Q &key) const
+    {
+        return do_lookup(key, do_hash(key)) < 0 ? 0 : 1;
+    }
+
     bool operator[](const K &key)
     {
-        int hash = do_hash(key);
+        unsigned int hash = do_hash(key);
         int i = do_lookup(key, hash);
         return i >= 0;
     }
@@ -963,7 +1066,7 @@ template <typename K, typename OPS> class pool
 
     void swap(pool &other)
     {
-        hashtable.swap(other.hashtable);
+        index.swap(other.index);
         entries.swap(other.entries);
     }
 
@@ -987,12 +1090,18 @@ template <typename K, typename OPS> class pool
         return hashval;
     }
 
-    void reserve(size_t n) { entries.reserve(n); }
+    // Make room for n entries, so that adding up to that many does not rehash
+    void reserve(size_t n)
+    {
+        entries.reserve(n);
+        if (n > entries.size() + index.growth_left)
+            do_rehash(n);
+    }
     size_t size() const { return entries.size(); }
     bool empty() const { return entries.empty(); }
     void clear()
     {
-        hashtable.clear();
+        index.clear();
         entries.clear();
     }
 
@@ -1034,7 +1143,7 @@ template <typename K, int offset, typename OPS> class idict
 
     int operator()(const K &key)
     {
-        int hash = database.do_hash(key);
+        unsigned int hash = database.do_hash(key);
         int i = database.do_lookup(key, hash);
         if (i < 0)
             i = database.do_insert(key, hash);
@@ -1043,7 +1152,7 @@ template <typename K, int offset, typename OPS> class idict
 
     int at(const K &key) const
     {
-        int hash = database.do_hash(key);
+        unsigned int hash = database.do_hash(key);
         int i = database.do_lookup(key, hash);
         if (i < 0)
             throw std::out_of_range("idict::at()");
@@ -1052,7 +1161,7 @@ template <typename K, int offset, typename OPS> class idict
 
     int at(const K &key, int defval) const
     {
-        int hash = database.do_hash(key);
+        unsigned int hash = database.do_hash(key);
         int i = database.do_lookup(key, hash);
         if (i < 0)
             return defval;
@@ -1061,7 +1170,7 @@ template <typename K, int offset, typename OPS> class idict
 
     int count(const K &key) const
     {
-        int hash = database.do_hash(key);
+        unsigned int hash = database.do_hash(key);
         int i = database.do_lookup(key, hash);
         return i < 0 ? 0 : 1;
     }
@@ -0,0 +1,231 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "incremental.h"
+#include <algorithm>
+#include <vector>
+#include "checkpoint.h"
+#include "log.h"
+#include "util.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+
+#ifdef ARCH_XILINX
+// Bels, wires and pips are numbered by the chipdb, which both contexts were created from
+BelId to_ctx(const Context *, const Context *, BelId bel) { return bel; }
+WireId to_ctx(const Context *, const Context *, WireId wire) { return wire; }
+PipId to_ctx(const Context *, const Context *, PipId pip) { return pip; }
+#else
+// Other arches may name their objects by IdString, which differ between the two contexts
+BelId to_ctx(Context *ctx, const Context *ref, BelId bel)
+{
+    return ctx->getBelByName(ctx->id(ref->getBelName(bel).str(ref)));
+}
+WireId to_ctx(Context *ctx, const Context *ref, WireId wire)
+{
+    return ctx->getWireByName(ctx->id(ref->getWireName(wire).str(ref)));
+}
+PipId to_ctx(Context *ctx, const Context *ref, PipId pip)
+{
+    return ctx->getPipByName(ctx->id(ref->getPipName(pip).str(ref)));
+}
+#endif
+
+// All cells of the relative placement cluster a cell belongs to
+std::vector<CellInfo *> cluster_of(CellInfo *ci)
+{
+    while (ci->constr_parent != nullptr)
+        ci = ci->constr_parent;
+    std::vector<CellInfo *> cluster{ci};
+    for (size_t i = 0; i < cluster.size(); i++)
+        for (auto child : cluster.at(i)->constr_children)
+            cluster.push_back(child);
+    return cluster;
+}
+
+} // namespace
+
+bool IncrementalFlow::load(const std::string &filename, Context *ctx)
+{
+    this->ctx = ctx;
+    ref.reset(new Context(ctx->archArgs()));
+    if (!load_checkpoint(filename, ref.get()))
+        return false;
+    bool placed = false;
+    for (auto &cell : ref->cells)
+        placed |= (cell.second->bel != BelId());
+    if (!placed)
+        log_warning("Checkpoint '%s' is not of a placed design, nothing can be reused.\n", filename.c_str());
+    return true;
+}
+
+CellInfo *IncrementalFlow::ref_cell(const CellInfo *ci) const
+{
+    auto fnd = ref->cells.find(ref->id(ci->name.str(ctx)));
+    return (fnd == ref->cells.end()) ? nullptr : fnd->second.get();
+}
+
+bool IncrementalFlow::cell_matches(const CellInfo *ci, const CellInfo *rc) const
+{
+    if (rc->bel == BelId() || ci->type.str(ctx) != rc->type.str(ref.get()))
+        return false;
+    if (ci->params.size() != rc->params.size() || ci->ports.size() != rc->ports.size())
+        return false;
+    for (auto &param : ci->params) {
+        auto fnd = rc->params.find(ref->id(param.first.str(ctx)));
+        if (fnd == rc->params.end() || !(fnd->second == param.second))
+            return false;
+    }
+    for (auto &port : ci->ports) {
+        auto fnd = rc->ports.find(ref->id(port.first.str(ctx)));
+        if (fnd == rc->ports.end() || fnd->second.type != port.second.type)
+            return false;
+        const NetInfo *net = port.second.net, *ref_net = fnd->second.net;
+        if ((net == nullptr) != (ref_net == nullptr))
+            return false;
+        if (net != nullptr && net->name.str(ctx) != ref_net->name.str(ref.get()))
+            return false;
+    }
+    return true;
+}
+
+void IncrementalFlow::restore_placement()
+{
+    std::unordered_set<IdString> matched, bound;
+    int unplaced = 0;
+    for (auto cell : sorted(ctx->cells)) {
+        CellInfo *ci = cell.second;
+        CellInfo *rc = ref_cell(ci);
+        bool matches = rc != nullptr && cell_matches(ci, rc);
+        if (ci->bel != BelId()) {
+            // Placed by the packer or a constraint, which counts as kept if it is where it was before
+            if (matches && ci->bel == to_ctx(ctx, ref.get(), rc->bel))
+                restored.insert(ci->name);
+            continue;
+        }
+        ++unplaced;
+        if (matches)
+            matched.insert(ci->name);
+    }
+
+    // Relative placement constraints are only kept for clusters that are unchanged as a whole
+    auto whole_cluster = [&](CellInfo *ci) {
+        for (auto member : cluster_of(ci))
+            if (!matched.count(member->name) && !restored.count(member->name))
+                return false;
+        return true;
+    };
+
+    for (auto cell : sorted(ctx->cells)) {
+        CellInfo *ci = cell.second;
+        if (!matched.count(ci->name) || !whole_cluster(ci))
+            continue;
+        BelId bel = to_ctx(ctx, ref.get(), ref_cell(ci)->bel);
+        if (bel == BelId() || !ctx->checkBelAvail(bel) || !ctx->isValidBelForCell(ci, bel))
+            continue;
+        ctx->bindBel(bel, ci, STRENGTH_STRONG);
+        bound.insert(ci->name);
+        restored.insert(ci->name);
+    }
+
+    // Undo clusters that could only be bound in part, and cells whose site no longer validates
+    for (auto cell : sorted(ctx->cells)) {
+        CellInfo *ci = cell.second;
+        if (!bound.count(ci->name))
+            continue;
+        bool keep = ctx->isBelLocationValid(ci->bel);
+        for (auto member : cluster_of(ci))
+            keep &= bool(restored.count(member->name));
+        if (keep)
+            continue;
+        for (auto member : cluster_of(ci)) {
+            if (!bound.count(member->name))
+                continue;
+            ctx->unbindBel(member->bel);
+            bound.erase(member->name);
+            restored.erase(member->name);
+        }
+    }
+
+    log_info("Incremental: kept the placement of %d of %d cells, %d cells left to place.\n", int(bound.size()),
+             unplaced, unplaced - int(bound.size()));
+}
+
+void IncrementalFlow::restore_routing()
+{
+    int kept = 0, total = 0;
+    std::vector<std::pair<std::string, std::string>> users, ref_users;
+    for (auto net : sorted(ctx->nets)) {
+        NetInfo *ni = net.second;
+        if (ni->driver.cell == nullptr || ni->users.empty() || !ni->wires.empty())
+            continue;
+        ++total;
+        auto fnd = ref->nets.find(ref->id(ni->name.str(ctx)));
+        if (fnd == ref->nets.end())
+            continue;
+        NetInfo *rn = fnd->second.get();
+        if (rn->wires.empty() || rn->driver.cell == nullptr || !restored.count(ni->driver.cell->name) ||
+            ni->driver.cell->name.str(ctx) != rn->driver.cell->name.str(ref.get()) ||
+            ni->driver.port.str(ctx) != rn->driver.port.str(ref.get()) || ni->users.size() != rn->users.size())
+            continue;
+
+        users.clear();
+        ref_users.clear();
+        bool all_users_kept = true;
+        for (auto &usr : ni->users) {
+            all_users_kept &= bool(restored.count(usr.cell->name));
+            users.emplace_back(usr.cell->name.str(ctx), usr.port.str(ctx));
+        }
+        for (auto &usr : rn->users)
+            ref_users.emplace_back(usr.cell->name.str(ref.get()), usr.port.str(ref.get()));
+        std::sort(users.begin(), users.end());
+        std::sort(ref_users.begin(), ref_users.end());
+        if (!all_users_kept || users != ref_users)
+            continue;
+
+        // Routing that the arch binds more strongly, such as dedicated clock routing, is redone by the arch's own
+        // routing passes
+        bool usable = true;
+        for (auto &w : rn->wires) {
+            if (w.second.strength > STRENGTH_WEAK) {
+                usable = false;
+                break;
+            }
+            WireId wire = to_ctx(ctx, ref.get(), w.first);
+            PipId pip = (w.second.pip == PipId()) ? PipId() : to_ctx(ctx, ref.get(), w.second.pip);
+            if (wire == WireId() || !ctx->checkWireAvail(wire) || (w.second.pip != PipId() && pip == PipId()) ||
+                (pip != PipId() && !ctx->checkPipAvail(pip))) {
+                usable = false;
+                break;
+            }
+        }
+        if (!usable)
+            continue;
+        for (auto &w : rn->wires) {
+            if (w.second.pip == PipId())
+                ctx->bindWire(to_ctx(ctx, ref.get(), w.first), ni, w.second.strength);
+            else
+                ctx->bindPip(to_ctx(ctx, ref.get(), w.second.pip), ni, w.second.strength);
+        }
+        ++kept;
+    }
+    log_info("Incremental: kept the routing of %d of %d nets.\n", kept, total);
+}
+
+NEXTPNR_NAMESPACE_END
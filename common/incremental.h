@@ -0,0 +1,51 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Incremental place and route against the checkpoint of an earlier run of the same design. After packing, cells
+// that have the same name, type, parameters and connectivity as in the reference are bound to their reference bels
+// with STRENGTH_STRONG, so the placer only places the new and changed cells. Before routing, nets whose driver and
+// users all kept their placement get their reference routing back; the router only routes the arcs that are left.
+struct IncrementalFlow
+{
+    // Load the reference checkpoint into a context of its own, for the same chip as ctx
+    bool load(const std::string &filename, Context *ctx);
+    void restore_placement();
+    void restore_routing();
+
+  private:
+    Context *ctx = nullptr;
+    std::unique_ptr<Context> ref;
+    // Cells of ctx that are at their reference bels
+    std::unordered_set<IdString> restored;
+
+    CellInfo *ref_cell(const CellInfo *ci) const;
+    bool cell_matches(const CellInfo *ci, const CellInfo *rc) const;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
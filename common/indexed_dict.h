@@ -0,0 +1,217 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef INDEXED_DICT_H
+#define INDEXED_DICT_H
+
+// A map with the same interface as the subset of std::unordered_map used for the netlist, but which iterates in
+// insertion order. Every entry keeps the index it was inserted at; erasing only leaves a tombstone behind, so erasing
+// never invalidates iterators or references to other entries, and neither does inserting (entries live in a deque).
+// Tombstones are only removed by an explicit call to compact().
+template <typename K, typename V> class indexed_dict
+{
+  public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<const K, V> value_type;
+
+  private:
+    struct entry_t
+    {
+        value_type udata;
+        bool live;
+        entry_t(const K &key, V &&value) : udata(key, std::move(value)), live(true) {}
+    };
+
+    std::deque<entry_t> entries;
+    std::unordered_map<K, int> index;
+
+    int next_live(int i) const
+    {
+        while (i < int(entries.size()) && !entries[i].live)
+            i++;
+        return i;
+    }
+
+  public:
+    class const_iterator;
+
+    class iterator
+    {
+        friend class indexed_dict;
+        friend class const_iterator;
+        indexed_dict *ptr;
+        int idx;
+        iterator(indexed_dict *ptr, int idx) : ptr(ptr), idx(idx) {}
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef indexed_dict::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type *pointer;
+        typedef value_type &reference;
+
+        iterator() : ptr(nullptr), idx(0) {}
+        iterator &operator++()
+        {
+            idx = ptr->next_live(idx + 1);
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const iterator &other) const { return idx == other.idx; }
+        bool operator!=(const iterator &other) const { return idx != other.idx; }
+        value_type &operator*() const { return ptr->entries[idx].udata; }
+        value_type *operator->() const { return &ptr->entries[idx].udata; }
+        // Insertion index of the entry
+        int index() const { return idx; }
+    };
+
+    class const_iterator
+    {
+        friend class indexed_dict;
+        const indexed_dict *ptr;
+        int idx;
+        const_iterator(const indexed_dict *ptr, int idx) : ptr(ptr), idx(idx) {}
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef const indexed_dict::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type *pointer;
+        typedef value_type &reference;
+
+        const_iterator() : ptr(nullptr), idx(0) {}
+        const_iterator(const iterator &other) : ptr(other.ptr), idx(other.idx) {}
+        const_iterator &operator++()
+        {
+            idx = ptr->next_live(idx + 1);
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const const_iterator &other) const { return idx == other.idx; }
+        bool operator!=(const const_iterator &other) const { return idx != other.idx; }
+        const value_type &operator*() const { return ptr->entries[idx].udata; }
+        const value_type *operator->() const { return &ptr->entries[idx].udata; }
+        int index() const { return idx; }
+    };
+
+    iterator begin() { return iterator(this, next_live(0)); }
+    iterator end() { return iterator(this, int(entries.size())); }
+    const_iterator begin() const { return const_iterator(this, next_live(0)); }
+    const_iterator end() const { return const_iterator(this, int(entries.size())); }
+
+    size_t size() const { return index.size(); }
+    bool empty() const { return index.empty(); }
+
+    iterator find(const K &key)
+    {
+        auto fnd = index.find(key);
+        return iterator(this, fnd == index.end() ? int(entries.size()) : fnd->second);
+    }
+
+    const_iterator find(const K &key) const
+    {
+        auto fnd = index.find(key);
+        return const_iterator(this, fnd == index.end() ? int(entries.size()) : fnd->second);
+    }
+
+    size_t count(const K &key) const { return index.count(key); }
+
+    V &at(const K &key)
+    {
+        auto fnd = index.find(key);
+        if (fnd == index.end())
+            throw std::out_of_range("indexed_dict::at()");
+        return entries[fnd->second].udata.second;
+    }
+
+    const V &at(const K &key) const
+    {
+        auto fnd = index.find(key);
+        if (fnd == index.end())
+            throw std::out_of_range("indexed_dict::at()");
+        return entries[fnd->second].udata.second;
+    }
+
+    std::pair<iterator, bool> emplace(const K &key, V &&value)
+    {
+        auto ins = index.emplace(key, int(entries.size()));
+        if (!ins.second)
+            return std::make_pair(iterator(this, ins.first->second), false);
+        entries.emplace_back(key, std::move(value));
+        return std::make_pair(iterator(this, ins.first->second), true);
+    }
+
+    std::pair<iterator, bool> insert(value_type &&value) { return emplace(value.first, std::move(value.second)); }
+
+    V &operator[](const K &key) { return emplace(key, V()).first->second; }
+
+    size_t erase(const K &key)
+    {
+        auto fnd = index.find(key);
+        if (fnd == index.end())
+            return 0;
+        entry_t &entry = entries[fnd->second];
+        index.erase(fnd);
+        entry.live = false;
+        entry.udata.second = V();
+        return 1;
+    }
+
+    iterator erase(iterator it)
+    {
+        iterator next = it;
+        ++next;
+        erase(it->first);
+        return next;
+    }
+
+    void clear()
+    {
+        entries.clear();
+        index.clear();
+    }
+
+    // Drop tombstones left by erase(); this renumbers entries and invalidates all iterators and references
+    void compact()
+    {
+        if (entries.size() == index.size())
+            return;
+        std::deque<entry_t> new_entries;
+        for (auto &entry : entries) {
+            if (!entry.live)
+                continue;
+            index.at(entry.udata.first) = int(new_entries.size());
+            new_entries.emplace_back(entry.udata.first, std::move(entry.udata.second));
+        }
+        std::swap(entries, new_entries);
+        // The index keeps its peak bucket count otherwise
+        index.rehash(0);
+    }
+};
+
+#endif
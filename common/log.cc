@@ -17,13 +17,16 @@
  *
  */
 
+#include <condition_variable>
 #include <list>
 #include <map>
+#include <mutex>
 #include <set>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <thread>
 #include <vector>
 
 #include "log.h"
@@ -42,6 +45,83 @@ std::unordered_map<LogLevel, int> message_count_by_level;
 static int log_newline_count = 0;
 bool had_nonfatal_error = false;
 
+// Serialises messages from different threads, and protects the counters above
+static std::recursive_mutex log_mutex;
+static thread_local std::string log_thread_context;
+
+namespace {
+// Background writer for log_async_start. Messages are appended to pending under its mutex, and the writer thread
+// takes the whole batch at once, so a message costs the logging thread one short critical section and no I/O.
+struct AsyncLogWriter
+{
+    std::vector<std::pair<std::ostream *, LogLevel>> streams;
+    std::mutex mtx;
+    std::condition_variable work, drained;
+    std::vector<std::pair<LogLevel, std::string>> pending;
+    bool busy = false, stop = false;
+    std::thread thread;
+
+    void run()
+    {
+        std::vector<std::pair<LogLevel, std::string>> batch;
+        std::string text;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                work.wait(lock, [&] { return stop || !pending.empty(); });
+                if (pending.empty())
+                    break;
+                batch.swap(pending);
+                busy = true;
+            }
+            // One write per stream and batch; std::cerr is unbuffered, so this saves a syscall per message
+            for (auto &f : streams) {
+                text.clear();
+                for (auto &msg : batch)
+                    if (f.second <= msg.first)
+                        text += msg.second;
+                *f.first << text;
+                f.first->flush();
+            }
+            batch.clear();
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                busy = false;
+            }
+            drained.notify_all();
+        }
+    }
+
+    void push(LogLevel level, std::string &&str)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            pending.emplace_back(level, std::move(str));
+        }
+        work.notify_one();
+    }
+
+    void wait_drained()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        drained.wait(lock, [&] { return pending.empty() && !busy; });
+    }
+
+    ~AsyncLogWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        work.notify_one();
+        if (thread.joinable())
+            thread.join();
+    }
+};
+
+std::unique_ptr<AsyncLogWriter> async_writer;
+} // namespace
+
 std::string stringf(const char *fmt, ...)
 {
     std::string string;
@@ -99,21 +179,34 @@ void logv(const char *format, va_list ap, LogLevel level = LogLevel::LOG_MSG)
         return;
 
     size_t nnl_pos = str.find_last_not_of('\n');
+    if (!log_thread_context.empty() && nnl_pos != std::string::npos) {
+        str = "[" + log_thread_context + "] " + str;
+        nnl_pos += log_thread_context.size() + 3;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(log_mutex);
     if (nnl_pos == std::string::npos)
         log_newline_count += str.size();
     else
         log_newline_count = str.size() - nnl_pos - 1;
 
+    if (log_write_function)
+        log_write_function(str);
+    if (async_writer) {
+        async_writer->push(level, std::move(str));
+        return;
+    }
     for (auto f : log_streams)
         if (f.second <= level)
             *f.first << str;
-    if (log_write_function)
-        log_write_function(str);
 }
 
 void log_with_level(LogLevel level, const char *format, ...)
 {
-    message_count_by_level[level]++;
+    {
+        std::lock_guard<std::recursive_mutex> lock(log_mutex);
+        message_count_by_level[level]++;
+    }
     va_list ap;
     va_start(ap, format);
     logv(format, ap, level);
@@ -125,7 +218,10 @@ void logv_prefixed(const char *prefix, const char *format, va_list ap, LogLevel
     std::string message = vstringf(format, ap);
 
     log_with_level(level, "%s%s", prefix, message.c_str());
-    log_flush();
+    // With the async writer, info messages are written as soon as the writer gets to them; only warnings and errors
+    // wait until they have been written
+    if (!async_writer || level >= LogLevel::WARNING_MSG)
+        log_flush();
 }
 
 void log_always(const char *format, ...)
@@ -191,8 +287,46 @@ void log_nonfatal_error(const char *format, ...)
 
 void log_flush()
 {
+    if (async_writer) {
+        async_writer->wait_drained();
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(log_mutex);
     for (auto f : log_streams)
         f.first->flush();
 }
 
+void log_async_start()
+{
+    if (async_writer)
+        return;
+    std::lock_guard<std::recursive_mutex> lock(log_mutex);
+    async_writer.reset(new AsyncLogWriter());
+    async_writer->streams = log_streams;
+    AsyncLogWriter *writer = async_writer.get();
+    async_writer->thread = std::thread([writer]() { writer->run(); });
+    // Registered after the streams were opened, so this runs before any of them is destroyed at exit
+    static bool registered = false;
+    if (!registered)
+        atexit(log_async_stop);
+    registered = true;
+}
+
+void log_async_stop()
+{
+    if (!async_writer)
+        return;
+    std::unique_ptr<AsyncLogWriter> writer;
+    {
+        std::lock_guard<std::recursive_mutex> lock(log_mutex);
+        writer = std::move(async_writer);
+    }
+    // The destructor writes out what is still pending and joins the writer thread
+    writer.reset();
+}
+
+LogThreadContext::LogThreadContext(const std::string &name) : prev(log_thread_context) { log_thread_context = name; }
+
+LogThreadContext::~LogThreadContext() { log_thread_context = prev; }
+
 NEXTPNR_NAMESPACE_END
@@ -72,6 +72,22 @@ void log_nonfatal_error(const char *format, ...) NPNR_ATTRIBUTE(format(printf, 1
 void log_break();
 void log_flush();
 
+// Write the log streams from a background thread, so that logging never waits for the I/O; messages keep their
+// order, and log_flush, warnings and errors wait until everything logged before them has been written. The streams
+// in log_streams when this is called are used until log_async_stop, which writes out whatever is still pending.
+void log_async_start();
+void log_async_stop();
+
+// Prefix the messages logged by this thread with "[name] " while the object exists
+struct LogThreadContext
+{
+    explicit LogThreadContext(const std::string &name);
+    ~LogThreadContext();
+
+  private:
+    std::string prev;
+};
+
 static inline void log_assert_worker(bool cond, const char *expr, const char *file, int line)
 {
     if (!cond)
@@ -0,0 +1,150 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef LUT_TABLE_H
+#define LUT_TABLE_H
+
+#include <array>
+#include <stdint.h>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// The truth table of a LUT with up to 6 inputs, in one 64-bit word: bit i is the output for the input values given by
+// the bits of i. Operations on the inputs work on the whole word at once, with shifts and masks.
+struct LutTable
+{
+    uint64_t bits;
+
+    LutTable() : bits(0){};
+    explicit LutTable(uint64_t bits) : bits(bits){};
+
+    // The first 64 bits of a LUT INIT parameter; x and z bits are 0
+    static LutTable from_init(const Property &init) { return LutTable(uint64_t(init.extract(0, 64).as_int64())); }
+
+    // The bits of the table where input i is 1
+    static uint64_t input_mask(int i)
+    {
+        static const uint64_t masks[6] = {0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+                                          0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL};
+        return masks[i];
+    }
+
+    bool get(int index) const { return (bits >> index) & 1; }
+
+    // The table with input i tied to a constant, so that the output no longer depends on it
+    LutTable cofactor(int i, bool value) const
+    {
+        int shift = 1 << i;
+        uint64_t mask = input_mask(i);
+        uint64_t half = value ? (bits & mask) : (bits & ~mask);
+        return LutTable(value ? (half | (half >> shift)) : (half | (half << shift)));
+    }
+
+    // The table with inputs i and j exchanged
+    LutTable swap_inputs(int i, int j) const
+    {
+        if (i == j)
+            return *this;
+        if (i > j)
+            std::swap(i, j);
+        int shift = (1 << j) - (1 << i);
+        // Bits where input i is 1 and input j is 0 trade places with those where i is 0 and j is 1
+        uint64_t mask = input_mask(i) & ~input_mask(j);
+        return LutTable((bits & ~(mask | (mask << shift))) | ((bits & mask) << shift) | ((bits >> shift) & mask));
+    }
+
+    // The table as seen through new inputs, where new input k drives old input perm[k], or nothing if perm[k] is -1.
+    // Old inputs that no new input drives are tied to 0.
+    LutTable permute(const std::array<int, 6> &perm) const
+    {
+        LutTable result = *this;
+        bool driven[6] = {false, false, false, false, false, false};
+        for (int k = 0; k < 6; k++)
+            if (perm[k] != -1)
+                driven[perm[k]] = true;
+        // Complete perm to a permutation with the undriven inputs, which the table no longer depends on
+        std::array<int, 6> full = perm;
+        int next_free = 0;
+        for (int i = 0; i < 6; i++)
+            if (!driven[i])
+                result = result.cofactor(i, false);
+        for (int k = 0; k < 6; k++) {
+            if (full[k] != -1)
+                continue;
+            while (driven[next_free])
+                next_free++;
+            full[k] = next_free++;
+        }
+        // Sort the inputs into place one at a time; at[q] is the old input currently at position q
+        std::array<int, 6> at = {{0, 1, 2, 3, 4, 5}};
+        for (int k = 0; k < 6; k++) {
+            int q = k;
+            while (at[q] != full[k])
+                q++;
+            if (q != k) {
+                result = result.swap_inputs(k, q);
+                std::swap(at[k], at[q]);
+            }
+        }
+        return result;
+    }
+
+    // The table as seen through new inputs, where new input k drives all the old inputs set in masks[k], an old input
+    // driven by more than one new input seeing the OR of them. Old inputs that no new input drives are tied to 0.
+    LutTable remap(const std::array<uint8_t, 6> &masks) const
+    {
+        std::array<int, 6> perm = {{-1, -1, -1, -1, -1, -1}};
+        uint8_t seen = 0;
+        bool is_perm = true;
+        for (int k = 0; k < 6 && is_perm; k++) {
+            if (masks[k] == 0)
+                continue;
+            // A plain permutation if each new input drives a single old input, different for each
+            is_perm = (masks[k] & (masks[k] - 1)) == 0 && (masks[k] & seen) == 0;
+            seen |= masks[k];
+            for (int i = 0; i < 6; i++)
+                if (masks[k] == (1 << i))
+                    perm[k] = i;
+        }
+        if (is_perm)
+            return permute(perm);
+        // Otherwise look up each entry, building the old index of entry j from that of j without its lowest set bit
+        uint8_t old_index[64];
+        old_index[0] = 0;
+        uint64_t result = bits & 1;
+        for (int j = 1; j < 64; j++) {
+            int low = 0;
+            while (((j >> low) & 1) == 0)
+                low++;
+            old_index[j] = old_index[j & (j - 1)] | masks[low];
+            result |= uint64_t(get(old_index[j])) << j;
+        }
+        return LutTable(result);
+    }
+
+    // A fractured LUT6, with O5 from the lower half of lut5 and O6, when the sixth input is high, from the upper half
+    // of lut6
+    static LutTable fracture(LutTable lut5, LutTable lut6)
+    {
+        return LutTable((lut5.bits & ~input_mask(5)) | (lut6.bits & input_mask(5)));
+    }
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "mem_account.h"
+#include "log.h"
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+struct MemState
+{
+    bool enabled = false;
+    std::mutex mtx;
+    // Subsystems in the order they were first accounted, with their current and peak sizes
+    std::vector<std::pair<const char *, int64_t>> current;
+    std::vector<int64_t> peak;
+    // The sizes at the point where the total was highest, and the last flow step before that point
+    std::vector<int64_t> at_peak;
+    int64_t total = 0, peak_total = 0;
+    std::string last_step = "startup", peak_step = "startup";
+};
+
+MemState &state()
+{
+    static MemState s;
+    return s;
+}
+
+double mib(int64_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+long peak_rss_kb()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+#endif
+}
+
+size_t netlist_memory(const Context *ctx)
+{
+    size_t bytes = 0;
+    for (auto &cell : ctx->cells) {
+        const CellInfo *ci = cell.second.get();
+        bytes += sizeof(CellInfo) + ci->ports.size() * sizeof(std::pair<IdString, PortInfo>) +
+                 (ci->attrs.size() + ci->params.size()) * sizeof(std::pair<IdString, Property>);
+        for (auto &param : ci->params)
+            bytes += param.second.str.capacity() + mem_usage(param.second.words);
+    }
+    for (auto &net : ctx->nets) {
+        const NetInfo *ni = net.second.get();
+        bytes += sizeof(NetInfo) + mem_usage(ni->users) + mem_usage(ni->user_cache) + mem_usage(ni->wires) +
+                 mem_usage(ni->attrs);
+    }
+    return bytes;
+}
+} // namespace
+
+void mem_account_enable() { state().enabled = true; }
+
+bool mem_account_enabled() { return state().enabled; }
+
+void mem_account_add(const char *subsystem, int64_t delta)
+{
+    MemState &s = state();
+    std::lock_guard<std::mutex> lock(s.mtx);
+    size_t i = 0;
+    while (i < s.current.size() && std::string(s.current.at(i).first) != subsystem)
+        i++;
+    if (i == s.current.size()) {
+        s.current.emplace_back(subsystem, 0);
+        s.peak.push_back(0);
+        s.at_peak.push_back(0);
+    }
+    s.current.at(i).second += delta;
+    s.peak.at(i) = std::max(s.peak.at(i), s.current.at(i).second);
+    s.total += delta;
+    if (s.total > s.peak_total) {
+        s.peak_total = s.total;
+        s.peak_step = s.last_step;
+        for (size_t j = 0; j < s.current.size(); j++)
+            s.at_peak.at(j) = s.current.at(j).second;
+    }
+}
+
+void mem_account_log(const Context *ctx, const char *step)
+{
+    MemState &s = state();
+    if (!s.enabled)
+        return;
+    // The netlist is accounted here rather than as it changes
+    static MemAccount netlist("netlist");
+    netlist.update(netlist_memory(ctx));
+    std::lock_guard<std::mutex> lock(s.mtx);
+    s.last_step = step;
+    log_info("Memory after %s: peak RSS %.1f MiB, accounted %.1f MiB\n", step, peak_rss_kb() / 1024.0, mib(s.total));
+    for (size_t i = 0; i < s.current.size(); i++)
+        log_info("    %-12s %9.1f MiB (peak %.1f MiB)\n", s.current.at(i).first, mib(s.current.at(i).second),
+                 mib(s.peak.at(i)));
+}
+
+void mem_account_log_peak()
+{
+    MemState &s = state();
+    if (!s.enabled)
+        return;
+    std::lock_guard<std::mutex> lock(s.mtx);
+    log_info("Peak accounted memory %.1f MiB, reached after %s; peak RSS %.1f MiB\n", mib(s.peak_total),
+             s.peak_step.c_str(), peak_rss_kb() / 1024.0);
+    for (size_t i = 0; i < s.current.size(); i++)
+        log_info("    %-12s %9.1f MiB\n", s.current.at(i).first, mib(s.at_peak.at(i)));
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,77 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef MEM_ACCOUNT_H
+#define MEM_ACCOUNT_H
+
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Opt-in memory accounting (--mem-report). The big data structures of each subsystem (router2's wire arrays, the
+// timing graph, HeAP's placement state, the JSON document, ...) report their size explicitly, computed from the
+// containers' capacities, and the totals per subsystem are logged at each flow step and at their peak. This is an
+// estimate of the heap used, not allocator-exact; sizes are only computed while accounting is enabled.
+void mem_account_enable();
+bool mem_account_enabled();
+// Change the accounted size of a subsystem
+void mem_account_add(const char *subsystem, int64_t delta);
+// Log the accounted sizes, the netlist size and the process RSS after a flow step
+void mem_account_log(const Context *ctx, const char *step);
+// Log the breakdown at the point where the accounted total was highest
+void mem_account_log_peak();
+
+// The accounted size of one data structure, given back when it is destroyed
+class MemAccount
+{
+  public:
+    explicit MemAccount(const char *subsystem) : subsystem(subsystem) {}
+    MemAccount(const MemAccount &) = delete;
+    MemAccount &operator=(const MemAccount &) = delete;
+    ~MemAccount() { update(0); }
+    void update(size_t bytes)
+    {
+        if (bytes == current)
+            return;
+        mem_account_add(subsystem, int64_t(bytes) - int64_t(current));
+        current = bytes;
+    }
+
+  private:
+    const char *subsystem;
+    size_t current = 0;
+};
+
+// Estimated heap use of the standard containers, not counting what their elements own
+template <typename T, typename A> size_t mem_usage(const std::vector<T, A> &v) { return v.capacity() * sizeof(T); }
+
+template <typename K, typename V, typename H, typename E, typename A>
+size_t mem_usage(const std::unordered_map<K, V, H, E, A> &m)
+{
+    return m.bucket_count() * sizeof(void *) + m.size() * (sizeof(std::pair<const K, V>) + 2 * sizeof(void *));
+}
+
+template <typename K, typename V> size_t mem_usage(const flat_dict<K, V> &m) { return m.heap_size(); }
+
+template <typename K, typename H, typename E, typename A> size_t mem_usage(const std::unordered_set<K, H, E, A> &s)
+{
+    return s.bucket_count() * sizeof(void *) + s.size() * (sizeof(K) + 2 * sizeof(void *));
+}
+
+NEXTPNR_NAMESPACE_END
+
+#endif
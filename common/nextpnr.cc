@@ -19,6 +19,7 @@
 
 #include "nextpnr.h"
 #include <boost/algorithm/string.hpp>
+#include <cstring>
 #include "design_utils.h"
 #include "log.h"
 #include "util.h"
@@ -32,28 +33,157 @@ assertion_failure::assertion_failure(std::string msg, std::string expr_str, std:
     log_flush();
 }
 
-void IdString::set(const BaseCtx *ctx, const std::string &s)
+IdStringDb::IdStringDb() : next_idx(0), count(0)
 {
-    auto it = ctx->idstring_str_to_idx->find(s);
-    if (it == ctx->idstring_str_to_idx->end()) {
-        index = ctx->idstring_idx_to_str->size();
-        auto insert_rc = ctx->idstring_str_to_idx->insert({s, index});
-        ctx->idstring_idx_to_str->push_back(&insert_rc.first->first);
-    } else {
-        index = it->second;
+    for (auto &page : pages)
+        page.store(nullptr, std::memory_order_relaxed);
+}
+
+IdStringDb::~IdStringDb()
+{
+    // Static strings that were asked for are the only ones owned by the pages
+    for (int i = 0; i < int(static_strs.size()); i++) {
+        int idx = static_begin + i;
+        delete pages[idx >> page_bits].load(std::memory_order_relaxed)[idx & page_mask].load(std::memory_order_relaxed);
+    }
+    for (auto &page : pages)
+        delete[] page.load(std::memory_order_relaxed);
+}
+
+void IdStringDb::publish(int idx, const std::string *s)
+{
+    NPNR_ASSERT((idx >> page_bits) < max_pages);
+    auto &page_ptr = pages[idx >> page_bits];
+    auto page = page_ptr.load(std::memory_order_acquire);
+    if (page == nullptr) {
+        std::lock_guard<std::mutex> lock(page_mutex);
+        page = page_ptr.load(std::memory_order_acquire);
+        if (page == nullptr) {
+            page = new std::atomic<const std::string *>[1 << page_bits];
+            for (int i = 0; i < (1 << page_bits); i++)
+                page[i].store(nullptr, std::memory_order_relaxed);
+            page_ptr.store(page, std::memory_order_release);
+        }
+    }
+    page[idx & page_mask].store(s, std::memory_order_release);
+    // Indices can be handed out to racing threads slightly out of order, so count only covers the entries
+    // known to be published
+    int expected = idx;
+    while (!count.compare_exchange_weak(expected, idx + 1, std::memory_order_acq_rel)) {
+        if (expected > idx)
+            break;
+        expected = idx;
+    }
+}
+
+namespace {
+uint32_t static_hash(const char *s, size_t len)
+{
+    uint32_t h = 2166136261U;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ uint8_t(s[i])) * 16777619U;
+    return h;
+}
+} // namespace
+
+int IdStringDb::find_static(const std::string &s) const
+{
+    if (static_index.empty())
+        return -1;
+    size_t mask = static_index.size() - 1;
+    for (size_t i = static_hash(s.data(), s.size()) & mask;; i = (i + 1) & mask) {
+        int32_t entry = static_index[i];
+        if (entry == 0)
+            return -1;
+        if (s == static_strs[entry - 1])
+            return static_begin + entry - 1;
+    }
+}
+
+const std::string &IdStringDb::static_str(int idx) const
+{
+    NPNR_ASSERT(idx >= static_begin && idx < static_begin + int(static_strs.size()));
+    auto &slot = pages[idx >> page_bits].load(std::memory_order_acquire)[idx & page_mask];
+    const std::string *copy = new std::string(static_strs[idx - static_begin]);
+    const std::string *expected = nullptr;
+    if (slot.compare_exchange_strong(expected, copy, std::memory_order_acq_rel))
+        return *copy;
+    // Another thread got there first
+    delete copy;
+    return *expected;
+}
+
+void IdStringDb::add_static(std::vector<const char *> strs, int idx)
+{
+    NPNR_ASSERT(next_idx.load() == idx);
+    if (static_strs.empty())
+        static_begin = idx;
+    NPNR_ASSERT(static_begin + int(static_strs.size()) == idx);
+    static_strs.insert(static_strs.end(), strs.begin(), strs.end());
+    // Pages for the new indices, with their entries left empty until asked for
+    int end = idx + int(strs.size());
+    for (int page = idx >> page_bits; page <= ((end - 1) >> page_bits) && end > idx; page++) {
+        if (pages[page].load(std::memory_order_relaxed) != nullptr)
+            continue;
+        auto new_page = new std::atomic<const std::string *>[1 << page_bits];
+        for (int i = 0; i < (1 << page_bits); i++)
+            new_page[i].store(nullptr, std::memory_order_relaxed);
+        pages[page].store(new_page, std::memory_order_release);
     }
+    next_idx.store(end);
+    count.store(end, std::memory_order_release);
+    // Rebuild the index at no more than half full
+    size_t size = 64;
+    while (size < 2 * static_strs.size())
+        size *= 2;
+    static_index.assign(size, 0);
+    for (size_t j = 0; j < static_strs.size(); j++) {
+        const char *str = static_strs[j];
+        size_t i = static_hash(str, strlen(str)) & (size - 1);
+        while (static_index[i] != 0)
+            i = (i + 1) & (size - 1);
+        static_index[i] = int32_t(j + 1);
+    }
+}
+
+int IdStringDb::get(const std::string &s)
+{
+    int static_idx = find_static(s);
+    if (static_idx >= 0)
+        return static_idx;
+    Shard &shard = shard_for(s);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.str_to_idx.find(s);
+    if (it != shard.str_to_idx.end())
+        return it->second;
+    int idx = next_idx.fetch_add(1, std::memory_order_relaxed);
+    auto insert_rc = shard.str_to_idx.insert({s, idx});
+    publish(idx, &insert_rc.first->first);
+    return idx;
+}
+
+void IdStringDb::add(const std::string &s, int idx)
+{
+    Shard &shard = shard_for(s);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    NPNR_ASSERT(shard.str_to_idx.count(s) == 0 && find_static(s) < 0);
+    NPNR_ASSERT(next_idx.load() == idx);
+    next_idx.store(idx + 1);
+    auto insert_rc = shard.str_to_idx.insert({s, idx});
+    publish(idx, &insert_rc.first->first);
 }
 
-const std::string &IdString::str(const BaseCtx *ctx) const { return *ctx->idstring_idx_to_str->at(index); }
+void IdString::set(const BaseCtx *ctx, const std::string &s) { index = ctx->idstring_db->get(s); }
+
+const std::string &IdString::str(const BaseCtx *ctx) const { return ctx->idstring_db->str(index); }
 
 const char *IdString::c_str(const BaseCtx *ctx) const { return str(ctx).c_str(); }
 
-void IdString::initialize_add(const BaseCtx *ctx, const char *s, int idx)
+void IdString::initialize_add(const BaseCtx *ctx, const char *s, int idx) { ctx->idstring_db->add(s, idx); }
+
+void IdString::initialize_add_static(const BaseCtx *ctx, std::vector<const char *> strs, int idx)
 {
-    NPNR_ASSERT(ctx->idstring_str_to_idx->count(s) == 0);
-    NPNR_ASSERT(int(ctx->idstring_idx_to_str->size()) == idx);
-    auto insert_rc = ctx->idstring_str_to_idx->insert({s, idx});
-    ctx->idstring_idx_to_str->push_back(&insert_rc.first->first);
+    ctx->idstring_db->add_static(std::move(strs), idx);
 }
 
 TimingConstrObjectId BaseCtx::timingWildcardObject()
@@ -133,18 +263,87 @@ TimingConstrObjectId BaseCtx::timingPortObject(CellInfo *cell, IdString port)
     }
 }
 
-Property::Property() : is_string(false), str(""), intval(0) {}
+Property::Property() : is_string(false), str(""), intval(0), width(0) {}
 
-Property::Property(int64_t intval, int width) : is_string(false), intval(intval)
+Property::Property(int64_t intval, int width) : is_string(false), intval(intval), width(width)
 {
-    str.reserve(width);
-    for (int i = 0; i < width; i++)
-        str.push_back((intval & (1ULL << i)) ? S1 : S0);
+    // Bits beyond the 64 of intval are copies of its sign bit
+    words.assign(2 * word_count(), 0);
+    for (int w = 0; w < word_count(); w++)
+        words[2 * w] = (w == 0) ? uint64_t(intval) : ((intval < 0) ? ~0ULL : 0);
+    if (width % 64 != 0)
+        words[2 * (word_count() - 1)] &= (1ULL << (width % 64)) - 1;
 }
 
-Property::Property(const std::string &strval) : is_string(true), str(strval), intval(0xDEADBEEF) {}
+Property::Property(const std::string &strval) : is_string(true), str(strval), intval(0xDEADBEEF), width(0) {}
 
-Property::Property(State bit) : is_string(false), str(std::string("") + char(bit)), intval(bit == S1) {}
+Property::Property(State bit) : is_string(false), intval(0), width(1)
+{
+    words.assign(2, 0);
+    set_bit(0, bit);
+}
+
+Property Property::extract(int offset, int len, State padding) const
+{
+    NPNR_ASSERT(!is_string);
+    Property ret(0, len);
+    if (offset % 64 == 0) {
+        for (int w = 0; w < ret.word_count() && 2 * (offset / 64 + w) < int(words.size()); w++) {
+            ret.words[2 * w] = words[2 * (offset / 64 + w)];
+            ret.words[2 * w + 1] = words[2 * (offset / 64 + w) + 1];
+        }
+        // Bits past the source width are 0 in both planes, which is the default S0 padding
+        if (len % 64 != 0) {
+            ret.words[2 * (ret.word_count() - 1)] &= (1ULL << (len % 64)) - 1;
+            ret.words[2 * (ret.word_count() - 1) + 1] &= (1ULL << (len % 64)) - 1;
+        }
+        if (padding != S0)
+            for (int i = std::max(0, width - offset); i < len; i++)
+                ret.set_bit(i, padding);
+        ret.intval = int64_t(ret.word(0));
+    } else {
+        for (int i = 0; i < len; i++) {
+            State s = (offset + i < width) ? bit(offset + i) : padding;
+            if (s != S0)
+                ret.set_bit(i, s);
+        }
+    }
+    return ret;
+}
+// Anything derived from CellInfo/NetInfo with a different size falls back to the global allocator
+void *CellInfo::operator new(std::size_t size)
+{
+    if (size != sizeof(CellInfo))
+        return ::operator new(size);
+    return object_pool<sizeof(CellInfo)>::get().alloc();
+}
+
+void CellInfo::operator delete(void *ptr, std::size_t size)
+{
+    if (ptr == nullptr)
+        return;
+    if (size != sizeof(CellInfo))
+        ::operator delete(ptr);
+    else
+        object_pool<sizeof(CellInfo)>::get().free(ptr);
+}
+
+void *NetInfo::operator new(std::size_t size)
+{
+    if (size != sizeof(NetInfo))
+        return ::operator new(size);
+    return object_pool<sizeof(NetInfo)>::get().alloc();
+}
+
+void NetInfo::operator delete(void *ptr, std::size_t size)
+{
+    if (ptr == nullptr)
+        return;
+    if (size != sizeof(NetInfo))
+        ::operator delete(ptr);
+    else
+        object_pool<sizeof(NetInfo)>::get().free(ptr);
+}
 
 void CellInfo::addInput(IdString name)
 {
@@ -187,7 +386,10 @@ std::string Property::to_string() const
             result += " ";
         return result;
     } else {
-        return std::string(str.rbegin(), str.rend());
+        std::string result(width, S0);
+        for (int i = 0; i < width; i++)
+            result[width - 1 - i] = bit(i);
+        return result;
     }
 }
 
@@ -197,9 +399,10 @@ Property Property::from_string(const std::string &s)
 
     size_t cursor = s.find_first_not_of("01xz");
     if (cursor == std::string::npos) {
-        p.str = std::string(s.rbegin(), s.rend());
-        p.is_string = false;
-        p.update_intval();
+        p = Property(0, int(s.size()));
+        for (int i = 0; i < int(s.size()); i++)
+            if (s[s.size() - 1 - i] != S0)
+                p.set_bit(i, State(s[s.size() - 1 - i]));
     } else if (s.find_first_not_of(' ', cursor) == std::string::npos) {
         p = Property(s.substr(0, s.size() - 1));
     } else {
@@ -232,6 +435,45 @@ void BaseCtx::removeConstraint(IdString constrName)
     constraints.erase(constrName);
 }
 
+std::shared_ptr<const DesignSnapshot> BaseCtx::publishSnapshot()
+{
+    auto snap = std::make_shared<DesignSnapshot>();
+    snap->epoch = ++snapshot_epoch;
+    snap->ui_reload = allUiReload || frameUiReload || !groupUiReload.empty();
+    for (auto &cell : cells)
+        if (cell.second->bel != BelId())
+            snap->cell_bels.emplace_back(cell.first, cell.second->bel);
+    for (auto &net : nets) {
+        if (net.second->wires.empty())
+            continue;
+        snap->net_wires.emplace_back(net.first, std::vector<std::pair<WireId, PipId>>());
+        auto &wires = snap->net_wires.back().second;
+        wires.reserve(net.second->wires.size());
+        for (auto &w : net.second->wires)
+            wires.emplace_back(w.first, w.second.pip);
+    }
+    // The snapshots supersede the per-object reload sets, which would otherwise keep growing
+    belUiReload.clear();
+    wireUiReload.clear();
+    pipUiReload.clear();
+    std::lock_guard<std::mutex> guard(snapshot_mutex);
+    snapshot = snap;
+    snapshot_wanted = false;
+    return snap;
+}
+
+std::shared_ptr<const DesignSnapshot> BaseCtx::getSnapshot()
+{
+    snapshot_wanted = true;
+    {
+        std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+        if (lock.owns_lock())
+            return publishSnapshot();
+    }
+    std::lock_guard<std::mutex> guard(snapshot_mutex);
+    return snapshot;
+}
+
 const char *BaseCtx::nameOfBel(BelId bel) const
 {
     const Context *ctx = getCtx();
@@ -292,20 +534,95 @@ WireId Context::getNetinfoSinkWire(const NetInfo *net_info, const PortRef &user_
     return getBelPinWire(dst_bel, user_port);
 }
 
+PortRefCache &Context::getNetinfoSinkCache(const NetInfo *net_info, size_t user_idx) const
+{
+    const PortRef &user_info = net_info->users.at(user_idx);
+    if (net_info->user_cache.size() != net_info->users.size())
+        net_info->user_cache.resize(net_info->users.size());
+    PortRefCache &entry = net_info->user_cache.at(user_idx);
+    if (entry.cell != user_info.cell || entry.port != user_info.port || entry.cell_type != user_info.cell->type ||
+        entry.bel != user_info.cell->bel) {
+        entry = PortRefCache();
+        entry.cell = user_info.cell;
+        entry.port = user_info.port;
+        entry.cell_type = user_info.cell->type;
+        entry.bel = user_info.cell->bel;
+    }
+    return entry;
+}
+
+Loc Context::getNetinfoSinkLoc(const NetInfo *net_info, size_t user_idx) const
+{
+    PortRefCache &entry = getNetinfoSinkCache(net_info, user_idx);
+    if (!entry.have_loc) {
+        if (entry.bel != BelId())
+            entry.loc = getBelLocation(entry.bel);
+        entry.have_loc = true;
+    }
+    return entry.loc;
+}
+
+WireId Context::getNetinfoSinkWire(const NetInfo *net_info, size_t user_idx) const
+{
+    PortRefCache &entry = getNetinfoSinkCache(net_info, user_idx);
+    if (!entry.have_wire) {
+        entry.wire = getNetinfoSinkWire(net_info, net_info->users.at(user_idx));
+        entry.have_wire = true;
+    }
+    return entry.wire;
+}
+
+TimingPortClass Context::getNetinfoSinkTimingClass(const NetInfo *net_info, size_t user_idx,
+                                                   int &clockInfoCount) const
+{
+    PortRefCache &entry = getNetinfoSinkCache(net_info, user_idx);
+    if (!entry.have_tmg) {
+        entry.tmg_class = getPortTimingClass(entry.cell, entry.port, entry.clock_info_count);
+        entry.have_tmg = true;
+    }
+    clockInfoCount = entry.clock_info_count;
+    return entry.tmg_class;
+}
+
 delay_t Context::getNetinfoRouteDelay(const NetInfo *net_info, const PortRef &user_info) const
 {
+    delay_t min_delay;
+    return getNetinfoRouteDelay(net_info, user_info, min_delay);
+}
+
+delay_t Context::getNetinfoRouteDelay(const NetInfo *net_info, const PortRef &user_info, delay_t &min_delay) const
+{
+    min_delay = 0;
 #ifdef ARCH_ECP5
     if (net_info->is_global)
         return 0;
 #endif
 
     if (net_info->wires.empty())
-        return predictDelay(net_info, user_info);
+        return min_delay = predictDelay(net_info, user_info);
 
     WireId src_wire = getNetinfoSourceWire(net_info);
     if (src_wire == WireId())
         return 0;
 
+    // Users of the net itself are answered from the per-user cache, filled for the whole net at once; anything else
+    // falls back to walking back from the sink
+    auto port_it = user_info.cell->ports.find(user_info.port);
+    if (port_it != user_info.cell->ports.end()) {
+        size_t user_idx = size_t(port_it->second.user_idx);
+        if (user_idx < net_info->users.size() && net_info->users[user_idx].cell == user_info.cell &&
+            net_info->users[user_idx].port == user_info.port) {
+            PortRefCache &entry = getNetinfoSinkCache(net_info, user_idx);
+            if (!entry.have_route_delay || entry.route_version != net_info->route_version ||
+                net_info->route_delay_src != src_wire)
+                cacheNetinfoRouteDelays(net_info, src_wire);
+            if (!entry.routed)
+                return min_delay = predictDelay(net_info, user_info);
+            min_delay = entry.min_route_delay;
+            return entry.route_delay;
+        }
+    }
+
     WireId dst_wire = getNetinfoSinkWire(net_info, user_info);
     WireId cursor = dst_wire;
     delay_t delay = 0;
@@ -320,15 +637,62 @@ delay_t Context::getNetinfoRouteDelay(const NetInfo *net_info, const PortRef &us
         if (pip == PipId())
             break;
 
-        delay += getPipDelay(pip).maxDelay();
-        delay += getWireDelay(cursor).maxDelay();
+        DelayInfo pip_delay = getPipDelay(pip), wire_delay = getWireDelay(cursor);
+        delay += pip_delay.maxDelay() + wire_delay.maxDelay();
+        min_delay += pip_delay.minDelay() + wire_delay.minDelay();
         cursor = getPipSrcWire(pip);
     }
 
-    if (cursor == src_wire)
-        return delay + getWireDelay(src_wire).maxDelay();
+    if (cursor == src_wire) {
+        DelayInfo wire_delay = getWireDelay(src_wire);
+        min_delay += wire_delay.minDelay();
+        return delay + wire_delay.maxDelay();
+    }
+
+    return min_delay = predictDelay(net_info, user_info);
+}
+
+void Context::cacheNetinfoRouteDelays(const NetInfo *net_info, WireId src_wire) const
+{
+    // Downhill (wire, driving pip) of each wire in the routing tree
+    std::unordered_map<WireId, std::vector<std::pair<WireId, PipId>>> children;
+    for (auto &w : net_info->wires)
+        if (w.second.pip != PipId())
+            children[getPipSrcWire(w.second.pip)].emplace_back(w.first, w.second.pip);
+
+    // Max and min delay from the source to each wire of the tree reached from it
+    std::unordered_map<WireId, std::pair<delay_t, delay_t>> arrival;
+    DelayInfo src_delay = getWireDelay(src_wire);
+    arrival[src_wire] = std::make_pair(src_delay.maxDelay(), src_delay.minDelay());
+    std::vector<WireId> stack{src_wire};
+    while (!stack.empty()) {
+        WireId wire = stack.back();
+        stack.pop_back();
+        auto fnd = children.find(wire);
+        if (fnd == children.end())
+            continue;
+        auto curr = arrival.at(wire);
+        for (auto &child : fnd->second) {
+            if (arrival.count(child.first))
+                continue;
+            DelayInfo pip_delay = getPipDelay(child.second), wire_delay = getWireDelay(child.first);
+            arrival[child.first] = std::make_pair(curr.first + pip_delay.maxDelay() + wire_delay.maxDelay(),
+                                                  curr.second + pip_delay.minDelay() + wire_delay.minDelay());
+            stack.push_back(child.first);
+        }
+    }
 
-    return predictDelay(net_info, user_info);
+    for (size_t i = 0; i < net_info->users.size(); i++) {
+        WireId dst_wire = getNetinfoSinkWire(net_info, i);
+        PortRefCache &entry = getNetinfoSinkCache(net_info, i);
+        auto fnd = arrival.find(dst_wire);
+        entry.routed = (dst_wire != WireId() && fnd != arrival.end());
+        entry.route_delay = entry.routed ? fnd->second.first : 0;
+        entry.min_route_delay = entry.routed ? fnd->second.second : 0;
+        entry.route_version = net_info->route_version;
+        entry.have_route_delay = true;
+    }
+    net_info->route_delay_src = src_wire;
 }
 
 static uint32_t xorshift32(uint32_t x)
@@ -339,6 +703,19 @@ static uint32_t xorshift32(uint32_t x)
     return x;
 }
 
+// Mixes in the characters of the value, lowest bit first for numeric values, as when these were stored as text
+static uint32_t property_checksum(uint32_t x, const Property &p)
+{
+    if (p.is_string) {
+        for (char ch : p.str)
+            x = xorshift32(x + xorshift32((int)ch));
+    } else {
+        for (int i = 0; i < p.width; i++)
+            x = xorshift32(x + xorshift32((int)p.bit(i)));
+    }
+    return x;
+}
+
 uint32_t Context::checksum() const
 {
     uint32_t cksum = xorshift32(123456789);
@@ -365,8 +742,7 @@ uint32_t Context::checksum() const
         for (auto &a : ni.attrs) {
             uint32_t attr_x = 123456789;
             attr_x = xorshift32(attr_x + xorshift32(a.first.index));
-            for (char ch : a.second.str)
-                attr_x = xorshift32(attr_x + xorshift32((int)ch));
+            attr_x = property_checksum(attr_x, a.second);
             attr_x_sum += attr_x;
         }
         x = xorshift32(x + xorshift32(attr_x_sum));
@@ -409,8 +785,7 @@ uint32_t Context::checksum() const
         for (auto &a : ci.attrs) {
             uint32_t attr_x = 123456789;
             attr_x = xorshift32(attr_x + xorshift32(a.first.index));
-            for (char ch : a.second.str)
-                attr_x = xorshift32(attr_x + xorshift32((int)ch));
+            attr_x = property_checksum(attr_x, a.second);
             attr_x_sum += attr_x;
         }
         x = xorshift32(x + xorshift32(attr_x_sum));
@@ -419,8 +794,7 @@ uint32_t Context::checksum() const
         for (auto &p : ci.params) {
             uint32_t param_x = 123456789;
             param_x = xorshift32(param_x + xorshift32(p.first.index));
-            for (char ch : p.second.str)
-                param_x = xorshift32(param_x + xorshift32((int)ch));
+            param_x = property_checksum(param_x, p.second);
             param_x_sum += param_x;
         }
         x = xorshift32(x + xorshift32(param_x_sum));
@@ -583,10 +957,18 @@ void BaseCtx::archInfoToAttributes()
         for (auto &item : ni->wires) {
             if (!first)
                 routing += ";";
+#ifdef ARCH_XILINX
+            // Avoid creating an IdString for every routed wire and pip in the design
+            getCtx()->appendWireName(routing, item.first);
+            routing += ";";
+            if (item.second.pip != PipId())
+                getCtx()->appendPipName(routing, item.second.pip);
+#else
             routing += getCtx()->getWireName(item.first).c_str(this);
             routing += ";";
             if (item.second.pip != PipId())
                 routing += getCtx()->getPipName(item.second.pip).c_str(this);
+#endif
             routing += ";" + std::to_string(item.second.strength);
             first = false;
         }
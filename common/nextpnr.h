@@ -20,12 +20,20 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -35,6 +43,10 @@
 #include <boost/range/adaptor/reversed.hpp>
 #include <boost/thread.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 #ifndef NEXTPNR_H
 #define NEXTPNR_H
 
@@ -97,7 +109,11 @@ inline void assert_fail_impl_str(std::string message, const char *expr_str, cons
 #define NPNR_ASSERT_FALSE(msg) (assert_fail_impl(msg, "false", __FILE__, __LINE__))
 #define NPNR_ASSERT_FALSE_STR(msg) (assert_fail_impl_str(msg, "false", __FILE__, __LINE__))
 
+#include "flat_dict.h"
 #include "hashlib.h"
+#include "indexed_dict.h"
+#include "object_pool.h"
+#include "small_dict.h"
 
 struct BaseCtx;
 struct Context;
@@ -109,6 +125,8 @@ struct IdString
     static void initialize_arch(const BaseCtx *ctx);
 
     static void initialize_add(const BaseCtx *ctx, const char *s, int idx);
+    // Add a block of strings with the indices from idx on, without copying them; see IdStringDb::add_static
+    static void initialize_add_static(const BaseCtx *ctx, std::vector<const char *> strs, int idx);
 
     constexpr IdString(int index = 0) : index(index) {}
 
@@ -330,20 +348,42 @@ struct Property
 
     bool is_string;
 
-    // The string literal (for string values), or a string of [01xz] (for numeric values)
+    // The string literal (for string values only)
     std::string str;
-    // The lower 64 bits (for numeric values), unused for string values
+    // The lower 64 bits that are 1 (for numeric values), unused for string values
     int64_t intval;
 
-    void update_intval()
+    // Numeric values are packed two bits per bit rather than kept as text, as wide parameters (BRAM initialisation,
+    // LUT and DSP masks) are common and read a word at a time. Bit i is in word i / 64 of two planes, interleaved in
+    // words: words[2 * w] has the bits that are 1 or z, words[2 * w + 1] those that are x or z. Bits at and above
+    // width are 0 in both planes.
+    int width;
+    std::vector<uint64_t> words;
+
+    State bit(int i) const
     {
-        intval = 0;
-        for (int i = 0; i < int(str.size()); i++) {
-            NPNR_ASSERT(str[i] == S0 || str[i] == S1 || str[i] == Sx || str[i] == Sz);
-            if ((str[i] == S1) && i < 64)
-                intval |= (1ULL << i);
-        }
+        NPNR_ASSERT(!is_string && i >= 0 && i < width);
+        bool v = (words[2 * (i / 64)] >> (i % 64)) & 1, u = (words[2 * (i / 64) + 1] >> (i % 64)) & 1;
+        return u ? (v ? Sz : Sx) : (v ? S1 : S0);
     }
+    void set_bit(int i, State s)
+    {
+        NPNR_ASSERT(!is_string && i >= 0 && i < width);
+        NPNR_ASSERT(s == S0 || s == S1 || s == Sx || s == Sz);
+        uint64_t m = 1ULL << (i % 64);
+        uint64_t &v = words[2 * (i / 64)], &u = words[2 * (i / 64) + 1];
+        v = (s == S1 || s == Sz) ? (v | m) : (v & ~m);
+        u = (s == Sx || s == Sz) ? (u | m) : (u & ~m);
+        if (i < 64)
+            intval = int64_t(words[0] & ~words[1]);
+    }
+    // Bits 64 * w up to 64 * w + 63 that are 1, and those that are x or z; zero beyond the width
+    uint64_t word(int w) const
+    {
+        return (2 * w < int(words.size())) ? (words[2 * w] & ~words[2 * w + 1]) : 0;
+    }
+    uint64_t undef_word(int w) const { return (2 * w < int(words.size())) ? words[2 * w + 1] : 0; }
+    int word_count() const { return (width + 63) / 64; }
 
     int64_t as_int64() const
     {
@@ -353,10 +393,10 @@ struct Property
     std::vector<bool> as_bits() const
     {
         std::vector<bool> result;
-        result.reserve(str.size());
+        result.reserve(width);
         NPNR_ASSERT(!is_string);
-        for (auto c : str)
-            result.push_back(c == S1);
+        for (int i = 0; i < width; i++)
+            result.push_back((word(i / 64) >> (i % 64)) & 1);
         return result;
     }
     std::string as_string() const
@@ -369,7 +409,7 @@ struct Property
         NPNR_ASSERT(is_string);
         return str.c_str();
     }
-    size_t size() const { return is_string ? 8 * str.size() : str.size(); }
+    size_t size() const { return is_string ? 8 * str.size() : width; }
     double as_double() const
     {
         NPNR_ASSERT(is_string);
@@ -377,25 +417,21 @@ struct Property
     }
     bool as_bool() const
     {
-        if (int(str.size()) <= 64)
-            return intval != 0;
-        else
-            return std::any_of(str.begin(), str.end(), [](char c) { return c == S1; });
+        for (int w = 0; w < word_count(); w++)
+            if (word(w) != 0)
+                return true;
+        return false;
     }
     bool is_fully_def() const
     {
-        return !is_string && std::all_of(str.begin(), str.end(), [](char c) { return c == S0 || c == S1; });
-    }
-    Property extract(int offset, int len, State padding = State::S0) const
-    {
-        Property ret;
-        ret.is_string = false;
-        ret.str.reserve(len);
-        for (int i = offset; i < offset + len; i++)
-            ret.str.push_back(i < int(str.size()) ? str[i] : padding);
-        ret.update_intval();
-        return ret;
+        if (is_string)
+            return false;
+        for (int w = 0; w < word_count(); w++)
+            if (undef_word(w) != 0)
+                return false;
+        return true;
     }
+    Property extract(int offset, int len, State padding = State::S0) const;
     // Convert to a string representation, escaping literal strings matching /^[01xz]* *$/ by adding a space at the end,
     // to disambiguate from binary strings
     std::string to_string() const;
@@ -404,8 +440,42 @@ struct Property
     static Property from_string(const std::string &s);
 };
 
-inline bool operator==(const Property &a, const Property &b) { return a.is_string == b.is_string && a.str == b.str; }
-inline bool operator!=(const Property &a, const Property &b) { return a.is_string != b.is_string || a.str != b.str; }
+inline bool operator==(const Property &a, const Property &b)
+{
+    return a.is_string == b.is_string && a.str == b.str && a.width == b.width && a.words == b.words;
+}
+inline bool operator!=(const Property &a, const Property &b) { return !(a == b); }
+
+enum TimingPortClass
+{
+    TMG_CLOCK_INPUT,     // Clock input to a sequential cell
+    TMG_GEN_CLOCK,       // Generated clock output (PLL, DCC, etc)
+    TMG_REGISTER_INPUT,  // Input to a register, with an associated clock (may also have comb. fanout too)
+    TMG_REGISTER_OUTPUT, // Output from a register
+    TMG_COMB_INPUT,      // Combinational input, no paths end here
+    TMG_COMB_OUTPUT,     // Combinational output, no paths start here
+    TMG_STARTPOINT,      // Unclocked primary startpoint, such as an IO cell output
+    TMG_ENDPOINT,        // Unclocked primary endpoint, such as an IO cell input
+    TMG_IGNORE,          // Asynchronous to all clocks, "don't care", and should be ignored (false path) for analysis
+};
+
+// Per-user data cached by the Context::getNetinfoSink* accessors; an entry is only used while the user's cell, port,
+// cell type and bel all still match the ones it was computed for
+struct PortRefCache
+{
+    const CellInfo *cell = nullptr;
+    IdString port, cell_type;
+    BelId bel;
+    Loc loc;
+    WireId wire;
+    TimingPortClass tmg_class = TMG_IGNORE;
+    int clock_info_count = 0;
+    // Routed delay from the source, valid while route_version matches the net's; routed is false if the route
+    // doesn't reach the sink, in which case the delay is predicted on each query instead
+    delay_t route_delay = 0, min_route_delay = 0;
+    uint32_t route_version = 0;
+    bool have_loc = false, have_wire = false, have_tmg = false, have_route_delay = false, routed = false;
+};
 
 struct ClockConstraint;
 
@@ -416,10 +486,16 @@ struct NetInfo : ArchNetInfo
 
     PortRef driver;
     std::vector<PortRef> users;
+    // Sink location, wire and timing class of each user, see PortRefCache
+    mutable std::vector<PortRefCache> user_cache;
     std::unordered_map<IdString, Property> attrs;
 
     // wire -> uphill_pip
-    std::unordered_map<WireId, PipMap> wires;
+    flat_dict<WireId, PipMap> wires;
+    // Incremented by the Arch whenever a wire or pip of the net is bound or unbound, invalidating the route delays
+    // in user_cache; route_delay_src is the source wire those delays were found from
+    uint32_t route_version = 0;
+    mutable WireId route_delay_src;
 
     std::vector<IdString> aliases; // entries in net_aliases that point to this net
 
@@ -428,6 +504,10 @@ struct NetInfo : ArchNetInfo
     TimingConstrObjectId tmg_id;
 
     Region *region = nullptr;
+
+    // Nets are allocated from a shared object_pool
+    static void *operator new(std::size_t size);
+    static void operator delete(void *ptr, std::size_t size);
 };
 
 enum PortType
@@ -443,6 +523,9 @@ struct PortInfo
     NetInfo *net;
     PortType type;
     TimingConstrObjectId tmg_id;
+    // Position of an input port in net->users, so that it can be disconnected without a search. Kept by the
+    // design_utils functions; only a hint, checked before use, as other code may edit the user list directly.
+    int user_idx;
 };
 
 struct CellInfo : ArchCellInfo
@@ -450,8 +533,8 @@ struct CellInfo : ArchCellInfo
     IdString name, type, hierpath;
     int32_t udata;
 
-    std::unordered_map<IdString, PortInfo> ports;
-    std::unordered_map<IdString, Property> attrs, params;
+    small_dict<IdString, PortInfo> ports;
+    small_dict<IdString, Property, 4> attrs, params;
 
     BelId bel;
     PlaceStrength belStrength = STRENGTH_NONE;
@@ -480,19 +563,10 @@ struct CellInfo : ArchCellInfo
     void unsetParam(IdString name);
     void setAttr(IdString name, Property value);
     void unsetAttr(IdString name);
-};
 
-enum TimingPortClass
-{
-    TMG_CLOCK_INPUT,     // Clock input to a sequential cell
-    TMG_GEN_CLOCK,       // Generated clock output (PLL, DCC, etc)
-    TMG_REGISTER_INPUT,  // Input to a register, with an associated clock (may also have comb. fanout too)
-    TMG_REGISTER_OUTPUT, // Output from a register
-    TMG_COMB_INPUT,      // Combinational input, no paths end here
-    TMG_COMB_OUTPUT,     // Combinational output, no paths start here
-    TMG_STARTPOINT,      // Unclocked primary startpoint, such as an IO cell output
-    TMG_ENDPOINT,        // Unclocked primary endpoint, such as an IO cell input
-    TMG_IGNORE,          // Asynchronous to all clocks, "don't care", and should be ignored (false path) for analysis
+    // Cells are allocated from a shared object_pool
+    static void *operator new(std::size_t size);
+    static void operator delete(void *ptr, std::size_t size);
 };
 
 enum ClockEdge
@@ -647,6 +721,78 @@ struct DeterministicRNG
     }
 };
 
+// ID String database, safe to use from several threads at once. Getting the string for an index is wait-free;
+// looking up or adding a string locks one of a number of shards picked by its hash, so threads only contend
+// when they hit the same shard. Note that new indices are handed out in the order strings are first added, so
+// code that needs a deterministic result should not create new IdStrings from racing threads.
+//
+// The constids of the arch and the chipdb are added as static strings instead: they are used in place, found
+// through a flat hash index, and only copied into a std::string the first time one is asked for.
+struct IdStringDb
+{
+    IdStringDb();
+    ~IdStringDb();
+
+    // Get the index of a string, adding it if needed
+    int get(const std::string &s);
+    // Add a string with a fixed index, used for the constids added before anything else
+    void add(const std::string &s, int idx);
+    // Add strings with the indices from idx on, which must be the next ones, while no other thread uses the
+    // database. The strings aren't copied, so must outlive it.
+    void add_static(std::vector<const char *> strs, int idx);
+
+    const std::string &str(int idx) const
+    {
+        NPNR_ASSERT(idx >= 0 && idx < count.load(std::memory_order_acquire));
+        auto page = pages[idx >> page_bits].load(std::memory_order_acquire);
+        const std::string *s = page[idx & page_mask].load(std::memory_order_acquire);
+        return (s != nullptr) ? *s : static_str(idx);
+    }
+
+    int size() const { return count.load(std::memory_order_acquire); }
+
+  private:
+    static const int page_bits = 16, page_mask = (1 << page_bits) - 1, max_pages = 4096;
+    static const int shard_count = 64;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, int> str_to_idx;
+    };
+    Shard shards[shard_count];
+
+    // Index to string, in fixed size pages so entries never move once published
+    std::atomic<std::atomic<const std::string *> *> pages[max_pages];
+    std::mutex page_mutex;
+    std::atomic<int> next_idx, count;
+
+    // Static strings, for the indices from static_begin on, and an open addressing hash index of them holding
+    // index + 1, or 0 where empty
+    std::vector<const char *> static_strs;
+    int static_begin = 0;
+    std::vector<int32_t> static_index;
+
+    Shard &shard_for(const std::string &s) { return shards[std::hash<std::string>()(s) % shard_count]; }
+    void publish(int idx, const std::string *s);
+    int find_static(const std::string &s) const;
+    const std::string &static_str(int idx) const;
+};
+
+// A consistent copy of the placement and routing, for readers such as the GUI that can't take the context lock
+// while a pass holds it. See BaseCtx::getSnapshot()
+struct DesignSnapshot
+{
+    // Increases with each snapshot published
+    uint64_t epoch = 0;
+    // Whether the UI had been asked to reload everything (refreshUi()), or any groups, when the snapshot was taken
+    bool ui_reload = false;
+    // Placed cells and their bels, in cell order
+    std::vector<std::pair<IdString, BelId>> cell_bels;
+    // Routed nets, with each wire they use and the pip driving it
+    std::vector<std::pair<IdString, std::vector<std::pair<WireId, PipId>>>> net_wires;
+};
+
 struct BaseCtx
 {
     // Lock to perform mutating actions on the Context.
@@ -658,16 +804,21 @@ struct BaseCtx
     // sure the UI is not starved.
     std::mutex ui_mutex;
 
+    // The latest snapshot of the design, and whether a reader is waiting for a newer one
+    std::mutex snapshot_mutex;
+    std::shared_ptr<const DesignSnapshot> snapshot;
+    std::atomic<bool> snapshot_wanted{false};
+    uint64_t snapshot_epoch = 0;
+
     // ID String database.
-    mutable std::unordered_map<std::string, int> *idstring_str_to_idx;
-    mutable std::vector<const std::string *> *idstring_idx_to_str;
+    mutable IdStringDb *idstring_db;
 
     // Project settings and config switches
     std::unordered_map<IdString, Property> settings;
 
-    // Placed nets and cells.
-    std::unordered_map<IdString, std::unique_ptr<NetInfo>> nets;
-    std::unordered_map<IdString, std::unique_ptr<CellInfo>> cells;
+    // Placed nets and cells, iterated in the order they were created
+    indexed_dict<IdString, std::unique_ptr<NetInfo>> nets;
+    indexed_dict<IdString, std::unique_ptr<CellInfo>> cells;
 
     // Hierarchical (non-leaf) cells by full path
     std::unordered_map<IdString, HierarchicalCell> hierarchy;
@@ -688,8 +839,7 @@ struct BaseCtx
 
     BaseCtx()
     {
-        idstring_str_to_idx = new std::unordered_map<std::string, int>;
-        idstring_idx_to_str = new std::vector<const std::string *>;
+        idstring_db = new IdStringDb;
         IdString::initialize_add(this, "", 0);
         IdString::initialize_arch(this);
 
@@ -699,11 +849,7 @@ struct BaseCtx
         constraintObjects.push_back(wildcard);
     }
 
-    ~BaseCtx()
-    {
-        delete idstring_str_to_idx;
-        delete idstring_idx_to_str;
-    }
+    ~BaseCtx() { delete idstring_db; }
 
     // Must be called before performing any mutating changes on the Ctx/Arch.
     void lock(void)
@@ -715,6 +861,8 @@ struct BaseCtx
     void unlock(void)
     {
         NPNR_ASSERT(boost::this_thread::get_id() == mutex_owner);
+        if (snapshot_wanted)
+            publishSnapshot();
         mutex.unlock();
     }
 
@@ -745,6 +893,15 @@ struct BaseCtx
         lock();
     }
 
+    // Take a snapshot of the placement and routing and make it the latest, called with the main lock taken. This
+    // happens in unlock() and yield() when a reader has asked for one, so passes only pay for it when watched
+    std::shared_ptr<const DesignSnapshot> publishSnapshot();
+
+    // The latest snapshot of the design, without waiting for the main lock. If no pass holds the lock a new snapshot
+    // is taken straight away, otherwise the pass running publishes one at its next yield() or unlock(). Returns
+    // nullptr until the first snapshot. Must not be called with the main lock taken
+    std::shared_ptr<const DesignSnapshot> getSnapshot();
+
     IdString id(const std::string &s) const { return IdString(this, s); }
 
     IdString id(const char *s) const { return IdString(this, s); }
@@ -780,7 +937,14 @@ struct BaseCtx
 
     void refreshUiFrame() { frameUiReload = true; }
 
-    void refreshUiBel(BelId bel) { belUiReload.insert(bel); }
+    // Set while bels are bound from several threads at once, a full refresh is requested afterwards instead
+    bool batchUiReload = false;
+
+    void refreshUiBel(BelId bel)
+    {
+        if (!batchUiReload)
+            belUiReload.insert(bel);
+    }
 
     void refreshUiWire(WireId wire) { wireUiReload.insert(wire); }
 
@@ -846,6 +1010,8 @@ NEXTPNR_NAMESPACE_END
 
 NEXTPNR_NAMESPACE_BEGIN
 
+class ThreadPool;
+
 struct Context : Arch, DeterministicRNG
 {
     bool verbose = false;
@@ -859,6 +1025,17 @@ struct Context : Arch, DeterministicRNG
     WireId getNetinfoSourceWire(const NetInfo *net_info) const;
     WireId getNetinfoSinkWire(const NetInfo *net_info, const PortRef &sink) const;
     delay_t getNetinfoRouteDelay(const NetInfo *net_info, const PortRef &sink) const;
+    // As above, also returning the fast corner delay of the route in min_delay
+    delay_t getNetinfoRouteDelay(const NetInfo *net_info, const PortRef &sink, delay_t &min_delay) const;
+
+    // Cached versions of the sink lookups for net_info->users.at(user_idx), which are recomputed only after the
+    // user's cell has moved. These update net_info->user_cache, so are not thread safe for the same net.
+    Loc getNetinfoSinkLoc(const NetInfo *net_info, size_t user_idx) const;
+    WireId getNetinfoSinkWire(const NetInfo *net_info, size_t user_idx) const;
+    TimingPortClass getNetinfoSinkTimingClass(const NetInfo *net_info, size_t user_idx, int &clockInfoCount) const;
+    PortRefCache &getNetinfoSinkCache(const NetInfo *net_info, size_t user_idx) const;
+    // Fill in the route delays of every user of a routed net, in one walk of its routing tree from src_wire
+    void cacheNetinfoRouteDelays(const NetInfo *net_info, WireId src_wire) const;
 
     // provided by router1.cc
     bool checkRoutedDesign() const;
@@ -881,6 +1058,10 @@ struct Context : Arch, DeterministicRNG
     void check() const;
     void archcheck() const;
 
+    // Threads shared by the parallel passes, sized by the threads setting the first time this is called. Thread safe;
+    // provided by thread_pool.cc
+    ThreadPool &threadPool() const;
+
     template <typename T> T setting(const char *name, T defaultValue)
     {
         IdString new_id = id(name);
@@ -904,6 +1085,10 @@ struct Context : Arch, DeterministicRNG
         else
             throw std::runtime_error("settings does not exists");
     }
+
+  private:
+    mutable std::mutex thread_pool_mutex;
+    mutable std::shared_ptr<ThreadPool> thread_pool;
 };
 
 NEXTPNR_NAMESPACE_END
@@ -0,0 +1,81 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+// Slab allocator for objects of one size, used for the class-specific operator new/delete of CellInfo and NetInfo so
+// that the netlist is allocated in large contiguous slabs rather than one heap block per object. Freed objects go on
+// a free list and are reused by the next allocation; addresses never change. Once every object has been freed again
+// (i.e. when the last Context is destroyed) all the slabs are released at once.
+template <size_t Size> class object_pool
+{
+    struct free_node
+    {
+        free_node *next;
+    };
+
+    static const size_t align = alignof(std::max_align_t);
+    static const size_t stride = (((Size > sizeof(free_node)) ? Size : sizeof(free_node)) + align - 1) / align * align;
+    static const size_t slab_objects = ((256 * 1024) / stride > 16) ? (256 * 1024) / stride : 16;
+
+    std::mutex mtx;
+    std::vector<std::unique_ptr<char[]>> slabs;
+    free_node *free_list = nullptr;
+    size_t slab_used = slab_objects;
+    size_t live = 0;
+
+  public:
+    void *alloc()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ++live;
+        if (free_list != nullptr) {
+            free_node *node = free_list;
+            free_list = node->next;
+            return node;
+        }
+        if (slab_used == slab_objects) {
+            slabs.emplace_back(new char[slab_objects * stride]);
+            slab_used = 0;
+        }
+        return slabs.back().get() + stride * (slab_used++);
+    }
+
+    void free(void *ptr)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (--live == 0) {
+            slabs.clear();
+            free_list = nullptr;
+            slab_used = slab_objects;
+            return;
+        }
+        free_node *node = reinterpret_cast<free_node *>(ptr);
+        node->next = free_list;
+        free_list = node;
+    }
+
+    // The pools are never destroyed, so that objects can still be freed during static destruction
+    static object_pool &get()
+    {
+        static object_pool *pool = new object_pool();
+        return *pool;
+    }
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "opencl_device.h"
+
+#ifdef WITH_OPENCL
+
+#include <vector>
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Work groups of the kernels are this size
+static const size_t min_group_size = 256;
+
+OpenCLDevice::OpenCLDevice()
+{
+    cl_uint num_platforms = 0;
+    if (clGetPlatformIDs(0, nullptr, &num_platforms) != CL_SUCCESS || num_platforms == 0) {
+        error = "no OpenCL platform found";
+        return;
+    }
+    std::vector<cl_platform_id> platforms(num_platforms);
+    clGetPlatformIDs(num_platforms, platforms.data(), nullptr);
+    for (auto platform : platforms) {
+        cl_uint num_devices = 0;
+        if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 0, nullptr, &num_devices) != CL_SUCCESS)
+            continue;
+        std::vector<cl_device_id> devices(num_devices);
+        clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, num_devices, devices.data(), nullptr);
+        for (auto dev : devices) {
+            cl_device_fp_config fp64_config = 0;
+            clGetDeviceInfo(dev, CL_DEVICE_DOUBLE_FP_CONFIG, sizeof(fp64_config), &fp64_config, nullptr);
+            size_t max_group = 0;
+            clGetDeviceInfo(dev, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_group), &max_group, nullptr);
+            if (max_group < min_group_size)
+                continue;
+            if (device == nullptr || (!fp64 && fp64_config != 0)) {
+                device = dev;
+                fp64 = (fp64_config != 0);
+            }
+        }
+    }
+    if (device == nullptr) {
+        error = "no OpenCL GPU found";
+        return;
+    }
+    size_t name_len = 0;
+    clGetDeviceInfo(device, CL_DEVICE_NAME, 0, nullptr, &name_len);
+    std::vector<char> name_buf(name_len + 1, 0);
+    clGetDeviceInfo(device, CL_DEVICE_NAME, name_len, name_buf.data(), nullptr);
+    name = name_buf.data();
+
+    cl_int err;
+    context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+    if (err != CL_SUCCESS) {
+        context = nullptr;
+        error = "failed to create OpenCL context";
+        return;
+    }
+    ok = true;
+}
+
+OpenCLDevice::~OpenCLDevice()
+{
+    if (context != nullptr)
+        clReleaseContext(context);
+}
+
+cl_program OpenCLDevice::build(const char *source, std::string &error) const
+{
+    if (!ok) {
+        error = this->error;
+        return nullptr;
+    }
+    cl_int err;
+    cl_program program = clCreateProgramWithSource(context, 1, &source, nullptr, &err);
+    if (err != CL_SUCCESS) {
+        error = "failed to create OpenCL program";
+        return nullptr;
+    }
+    if (clBuildProgram(program, 1, &device, "", nullptr, nullptr) != CL_SUCCESS) {
+        error = "failed to build OpenCL kernels";
+        clReleaseProgram(program);
+        return nullptr;
+    }
+    return program;
+}
+
+const OpenCLDevice &opencl_device()
+{
+    static OpenCLDevice device;
+    return device;
+}
+
+NEXTPNR_NAMESPACE_END
+
+#endif
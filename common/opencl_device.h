@@ -0,0 +1,59 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef OPENCL_DEVICE_H
+#define OPENCL_DEVICE_H
+
+#ifdef WITH_OPENCL
+
+#define CL_TARGET_OPENCL_VERSION 120
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <string>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// The GPU used by the passes with an OpenCL backend (the HeAP solver and the router2 wavefront router), in builds with
+// BUILD_OPENCL. It is found the first time it is asked for; a GPU with double precision support is preferred.
+struct OpenCLDevice
+{
+    // Whether a device was found, and if not why not
+    bool ok = false;
+    std::string error;
+    std::string name;
+    bool fp64 = false;
+    cl_device_id device = nullptr;
+    cl_context context = nullptr;
+
+    OpenCLDevice();
+    ~OpenCLDevice();
+
+    // Build a program for the device, returning nullptr and setting error if that fails
+    cl_program build(const char *source, std::string &error) const;
+};
+
+const OpenCLDevice &opencl_device();
+
+NEXTPNR_NAMESPACE_END
+
+#endif
+
+#endif
@@ -0,0 +1,276 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "perf_report.h"
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include "log.h"
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+struct PerfReport
+{
+    bool enabled = false;
+    std::thread::id owner;
+    // Phase indices of the open scopes
+    std::vector<size_t> stack;
+    // Phases in the order they were first entered
+    std::vector<PerfPhaseStats> phases;
+    std::unordered_map<std::string, size_t> phase_index;
+};
+
+PerfReport &report()
+{
+    static PerfReport r;
+    return r;
+}
+
+// Process CPU time, including all threads, and peak RSS in KiB
+double process_cpu_time()
+{
+#ifdef _WIN32
+    return double(std::clock()) / CLOCKS_PER_SEC;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+// Hardware counters: one event of each kind per counted thread, read and summed over all of them
+const char *hw_names[] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+const int hw_kinds = 4;
+
+struct HwCounters
+{
+    bool enabled = false;
+    std::mutex mutex;
+    // hw_kinds file descriptors per thread
+    std::vector<int> fds;
+};
+
+HwCounters &hw_counters()
+{
+    static HwCounters h;
+    return h;
+}
+
+// Open the counters of the calling thread; false if any fails
+bool open_thread_counters()
+{
+#ifdef __linux__
+    const uint64_t configs[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                PERF_COUNT_HW_BRANCH_MISSES};
+    std::vector<int> fds;
+    for (int i = 0; i < hw_kinds; i++) {
+        struct perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // There may be fewer hardware counters than events, in which case the kernel time slices them; the running
+        // and enabled times let the counts be scaled up to the whole time
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd < 0) {
+            for (int open_fd : fds)
+                close(open_fd);
+            return false;
+        }
+        fds.push_back(fd);
+    }
+    HwCounters &h = hw_counters();
+    std::lock_guard<std::mutex> lock(h.mutex);
+    h.fds.insert(h.fds.end(), fds.begin(), fds.end());
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Current totals over all counted threads
+std::vector<int64_t> read_hw_counters()
+{
+    std::vector<int64_t> totals(hw_kinds, 0);
+#ifdef __linux__
+    HwCounters &h = hw_counters();
+    std::lock_guard<std::mutex> lock(h.mutex);
+    for (size_t i = 0; i < h.fds.size(); i++) {
+        uint64_t value[3];
+        if (read(h.fds.at(i), value, sizeof(value)) != sizeof(value) || value[2] == 0)
+            continue;
+        totals.at(i % hw_kinds) += int64_t(double(value[0]) * double(value[1]) / double(value[2]));
+    }
+#endif
+    return totals;
+}
+
+long peak_rss_kb()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+#endif
+}
+void add_counter(PerfPhaseStats &ph, const char *name, int64_t value)
+{
+    for (auto &c : ph.counters) {
+        if (c.first == name) {
+            c.second += value;
+            return;
+        }
+    }
+    ph.counters.emplace_back(name, value);
+}
+} // namespace
+
+void perf_report_enable()
+{
+    report().enabled = true;
+    report().owner = std::this_thread::get_id();
+}
+
+bool perf_report_enabled() { return report().enabled; }
+
+bool perf_report_enable_hw_counters()
+{
+    if (!open_thread_counters())
+        return false;
+    hw_counters().enabled = true;
+    return true;
+}
+
+void perf_report_thread_start()
+{
+    if (hw_counters().enabled)
+        open_thread_counters();
+}
+
+PerfScope::PerfScope(const char *name)
+{
+    if (report().enabled)
+        start(name);
+}
+
+PerfScope::PerfScope(const std::string &name)
+{
+    if (report().enabled)
+        start(name);
+}
+
+void PerfScope::start(const std::string &name)
+{
+    PerfReport &r = report();
+    if (std::this_thread::get_id() != r.owner)
+        return;
+    std::string path = r.stack.empty() ? name : (r.phases.at(r.stack.back()).path + "/" + name);
+    auto fnd = r.phase_index.find(path);
+    if (fnd == r.phase_index.end()) {
+        fnd = r.phase_index.emplace(path, r.phases.size()).first;
+        r.phases.emplace_back();
+        r.phases.back().path = path;
+    }
+    r.stack.push_back(fnd->second);
+    active = true;
+    if (hw_counters().enabled)
+        hw_start = read_hw_counters();
+    rss_start = peak_rss_kb();
+    cpu_start = process_cpu_time();
+    wall_start = std::chrono::steady_clock::now();
+}
+
+void PerfScope::stop()
+{
+    if (!active)
+        return;
+    active = false;
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double cpu = process_cpu_time() - cpu_start;
+    PerfReport &r = report();
+    PerfPhaseStats &ph = r.phases.at(r.stack.back());
+    ph.count++;
+    ph.wall += wall;
+    ph.cpu += cpu;
+    ph.rss_delta_kb += peak_rss_kb() - rss_start;
+    if (!hw_start.empty()) {
+        std::vector<int64_t> hw_end = read_hw_counters();
+        for (int i = 0; i < hw_kinds; i++)
+            add_counter(ph, hw_names[i], hw_end.at(i) - hw_start.at(i));
+    }
+    r.stack.pop_back();
+}
+
+void perf_report_counter(const char *name, int64_t value)
+{
+    PerfReport &r = report();
+    if (!r.enabled || r.stack.empty() || std::this_thread::get_id() != r.owner)
+        return;
+    add_counter(r.phases.at(r.stack.back()), name, value);
+}
+
+const std::vector<PerfPhaseStats> &perf_report_phases() { return report().phases; }
+
+bool write_perf_report(const std::string &filename, int threads)
+{
+    std::ofstream out(filename);
+    if (!out)
+        return false;
+    PerfReport &r = report();
+    out << stringf("{\n  \"threads\": %d,\n  \"peak_rss_kb\": %ld,\n  \"phases\": [", threads, peak_rss_kb());
+    bool first = true;
+    for (auto &ph : r.phases) {
+        // Average number of busy threads, and that as a fraction of the threads available
+        double parallelism = ph.wall > 0 ? ph.cpu / ph.wall : 0;
+        out << (first ? "\n" : ",\n");
+        out << stringf("    {\"phase\": \"%s\", \"count\": %d, \"wall_time\": %.6f, \"cpu_time\": %.6f, "
+                       "\"peak_rss_delta_kb\": %ld, \"parallelism\": %.3f, \"thread_utilisation\": %.3f",
+                       ph.path.c_str(), ph.count, ph.wall, ph.cpu, ph.rss_delta_kb, parallelism,
+                       parallelism / std::max(1, threads));
+        if (!ph.counters.empty()) {
+            out << ", \"counters\": {";
+            for (size_t i = 0; i < ph.counters.size(); i++)
+                out << stringf("%s\"%s\": %lld", i ? ", " : "", ph.counters.at(i).first.c_str(),
+                               (long long)ph.counters.at(i).second);
+            out << "}";
+        }
+        out << "}";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+    return bool(out);
+}
+
+NEXTPNR_NAMESPACE_END
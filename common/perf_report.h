@@ -0,0 +1,77 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef PERF_REPORT_H
+#define PERF_REPORT_H
+
+#include <chrono>
+#include <string>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Per-phase performance report (--perf-report). Phases are timed by PerfScope objects, which nest, and are
+// accumulated by their full path, e.g. "place/spread". Scopes only count on the thread that enabled the report; the
+// CPU time of a phase includes any worker threads it runs. When the report is disabled a scope does nothing.
+void perf_report_enable();
+bool perf_report_enabled();
+// Write the report as JSON; threads is the thread count the run was configured with
+bool write_perf_report(const std::string &filename, int threads);
+// Add to a named counter of the innermost open phase, e.g. the work done by a router iteration
+void perf_report_counter(const char *name, int64_t value);
+
+// Also record the cycles, instructions, LLC misses and branch misses of each phase, as its counters of those names,
+// from the hardware performance counters (Linux only; returns false if they can't be opened). They count user space
+// on the calling thread and on the threads started after this that call perf_report_thread_start, which the thread
+// pool workers do, so this should be called before the thread pool is created.
+bool perf_report_enable_hw_counters();
+void perf_report_thread_start();
+
+struct PerfPhaseStats
+{
+    std::string path;
+    int count = 0;
+    double wall = 0, cpu = 0;
+    long rss_delta_kb = 0;
+    // In the order they were first added
+    std::vector<std::pair<std::string, int64_t>> counters;
+};
+
+// The phases recorded so far, in the order they were first entered
+const std::vector<PerfPhaseStats> &perf_report_phases();
+
+class PerfScope
+{
+  public:
+    explicit PerfScope(const char *name);
+    explicit PerfScope(const std::string &name);
+    ~PerfScope() { stop(); }
+    // End the phase before the scope is left
+    void stop();
+
+  private:
+    void start(const std::string &name);
+    bool active = false;
+    std::chrono::steady_clock::time_point wall_start;
+    double cpu_start = 0;
+    long rss_start = 0;
+    std::vector<int64_t> hw_start;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -18,8 +18,13 @@
  */
 
 #include "place_common.h"
+#include <algorithm>
 #include <cmath>
+#include <map>
+#include <set>
+#include <thread>
 #include "log.h"
+#include "thread_pool.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -43,7 +48,8 @@ wirelen_t get_net_metric(const Context *ctx, const NetInfo *net, MetricType type
     delay_t worst_slack = std::numeric_limits<delay_t>::max();
     Loc driver_loc = ctx->getBelLocation(driver_cell->bel);
     int xmin = driver_loc.x, xmax = driver_loc.x, ymin = driver_loc.y, ymax = driver_loc.y;
-    for (auto load : net->users) {
+    for (size_t i = 0; i < net->users.size(); i++) {
+        const PortRef &load = net->users.at(i);
         if (load.cell == nullptr)
             continue;
         CellInfo *load_cell = load.cell;
@@ -59,7 +65,7 @@ wirelen_t get_net_metric(const Context *ctx, const NetInfo *net, MetricType type
 
         if (ctx->getBelGlobalBuf(load_cell->bel))
             continue;
-        Loc load_loc = ctx->getBelLocation(load_cell->bel);
+        Loc load_loc = ctx->getNetinfoSinkLoc(net, i);
 
         xmin = std::min(xmin, load_loc.x);
         ymin = std::min(ymin, load_loc.y);
@@ -102,8 +108,293 @@ wirelen_t get_cell_metric_at_bel(const Context *ctx, CellInfo *cell, BelId bel,
     return wirelen;
 }
 
+NetMetricCache::NetMetricCache(const Context *ctx, MetricType type) : ctx(ctx), type(type)
+{
+    timing_driven = ctx->setting<bool>("timing_driven") && type == MetricType::COST;
+}
+
+const std::vector<NetMetricCache::CellNet> &NetMetricCache::get_cell_nets(const CellInfo *cell)
+{
+    auto fnd = cell_nets.find(cell->name);
+    if (fnd != cell_nets.end())
+        return fnd->second;
+    auto &nets = cell_nets[cell->name];
+    for (auto &port : cell->ports) {
+        NetInfo *net = port.second.net;
+        if (net == nullptr)
+            continue;
+        auto cn = std::find_if(nets.begin(), nets.end(), [net](const CellNet &n) { return n.net == net; });
+        if (cn == nets.end()) {
+            nets.emplace_back();
+            cn = std::prev(nets.end());
+            cn->net = net;
+        }
+        if (net->driver.cell == cell && net->driver.port == port.first)
+            cn->is_driver = true;
+        for (size_t i = 0; i < net->users.size(); i++)
+            if (net->users.at(i).cell == cell && net->users.at(i).port == port.first)
+                cn->users.push_back(i);
+    }
+    for (auto &cn : nets)
+        std::sort(cn.users.begin(), cn.users.end());
+    return nets;
+}
+
+bool NetMetricCache::is_timing_net(const NetInfo *net) const
+{
+    int clock_count;
+    return timing_driven && net->driver.cell != nullptr &&
+           ctx->getPortTimingClass(net->driver.cell, net->driver.port, clock_count) != TMG_IGNORE;
+}
+
+delay_t NetMetricCache::get_slack(const NetInfo *net, size_t user) const
+{
+    const PortRef &load = net->users.at(user);
+    if (load.cell == nullptr || load.cell->bel == BelId())
+        return std::numeric_limits<delay_t>::max();
+    return load.budget - ctx->predictDelay(net, load);
+}
+
+void NetMetricCache::add_pin(NetEntry &e, Loc loc)
+{
+    if (e.npins++ == 0) {
+        e.x0 = e.x1 = loc.x;
+        e.y0 = e.y1 = loc.y;
+        e.nx0 = e.nx1 = e.ny0 = e.ny1 = 1;
+        return;
+    }
+    if (loc.x == e.x0)
+        ++e.nx0;
+    else if (loc.x < e.x0) {
+        e.x0 = loc.x;
+        e.nx0 = 1;
+    }
+    if (loc.x == e.x1)
+        ++e.nx1;
+    else if (loc.x > e.x1) {
+        e.x1 = loc.x;
+        e.nx1 = 1;
+    }
+    if (loc.y == e.y0)
+        ++e.ny0;
+    else if (loc.y < e.y0) {
+        e.y0 = loc.y;
+        e.ny0 = 1;
+    }
+    if (loc.y == e.y1)
+        ++e.ny1;
+    else if (loc.y > e.y1) {
+        e.y1 = loc.y;
+        e.ny1 = 1;
+    }
+}
+
+void NetMetricCache::remove_pin(NetEntry &e, Loc loc)
+{
+    if (--e.npins == 0)
+        return;
+    // Removing the last pin at an edge needs a full recompute
+    if ((loc.x == e.x0 && e.nx0 == 1) || (loc.x == e.x1 && e.nx1 == 1) || (loc.y == e.y0 && e.ny0 == 1) ||
+        (loc.y == e.y1 && e.ny1 == 1)) {
+        e.bounds_valid = false;
+        return;
+    }
+    if (loc.x == e.x0)
+        --e.nx0;
+    if (loc.x == e.x1)
+        --e.nx1;
+    if (loc.y == e.y0)
+        --e.ny0;
+    if (loc.y == e.y1)
+        --e.ny1;
+}
+
+NetMetricCache::NetEntry &NetMetricCache::get_entry(const NetInfo *net)
+{
+    auto &e = entries[net->name];
+    if (!e.bounds_valid) {
+        e.npins = 0;
+        if (net->driver.cell != nullptr && net->driver.cell->bel != BelId() &&
+            !ctx->getBelGlobalBuf(net->driver.cell->bel))
+            add_pin(e, ctx->getBelLocation(net->driver.cell->bel));
+        for (auto &usr : net->users)
+            if (usr.cell != nullptr && usr.cell->bel != BelId() && !ctx->getBelGlobalBuf(usr.cell->bel))
+                add_pin(e, ctx->getBelLocation(usr.cell->bel));
+        e.bounds_valid = true;
+    }
+    if (!e.timing_valid && is_timing_net(net)) {
+        e.slack.resize(net->users.size());
+        e.negative_slack = 0;
+        e.worst_slack = std::numeric_limits<delay_t>::max();
+        for (size_t i = 0; i < net->users.size(); i++) {
+            delay_t slack = get_slack(net, i);
+            e.slack.at(i) = slack;
+            if (slack < 0)
+                e.negative_slack += slack;
+            e.worst_slack = std::min(e.worst_slack, slack);
+        }
+        e.timing_valid = true;
+    }
+    return e;
+}
+
+wirelen_t NetMetricCache::net_cost(const NetInfo *net, int hpwl, delay_t worst_slack, delay_t negative_slack,
+                                   float &tns) const
+{
+    if (!is_timing_net(net))
+        return wirelen_t(hpwl);
+    tns += ctx->getDelayNS(negative_slack);
+    return wirelen_t(hpwl * std::min(5.0, (1.0 + std::exp(-ctx->getDelayNS(worst_slack) / 5))));
+}
+
+wirelen_t NetMetricCache::get_net_metric(const NetInfo *net, float &tns)
+{
+    CellInfo *driver_cell = net->driver.cell;
+    if (driver_cell == nullptr || driver_cell->bel == BelId() || ctx->getBelGlobalBuf(driver_cell->bel))
+        return 0;
+    auto &e = get_entry(net);
+    int hpwl = (e.npins == 0) ? 0 : ((e.x1 - e.x0) + (e.y1 - e.y0));
+    return net_cost(net, hpwl, e.worst_slack, e.negative_slack, tns);
+}
+
+wirelen_t NetMetricCache::get_cell_metric(const CellInfo *cell)
+{
+    wirelen_t wirelength = 0;
+    float tns = 0;
+    for (auto &cn : get_cell_nets(cell))
+        wirelength += get_net_metric(cn.net, tns);
+    return wirelength;
+}
+
+wirelen_t NetMetricCache::get_cell_metric_at_bel(CellInfo *cell, BelId bel)
+{
+    BelId old_bel = cell->bel;
+    bool old_pin = (old_bel != BelId()) && !ctx->getBelGlobalBuf(old_bel);
+    bool new_pin = !ctx->getBelGlobalBuf(bel);
+    Loc old_loc = old_pin ? ctx->getBelLocation(old_bel) : Loc();
+    Loc new_loc = ctx->getBelLocation(bel);
+    wirelen_t wirelength = 0;
+    float tns = 0;
+    for (auto &cn : get_cell_nets(cell)) {
+        NetInfo *net = cn.net;
+        CellInfo *driver_cell = net->driver.cell;
+        if (driver_cell == nullptr)
+            continue;
+        BelId driver_bel = (driver_cell == cell) ? bel : driver_cell->bel;
+        if (driver_bel == BelId() || ctx->getBelGlobalBuf(driver_bel))
+            continue;
+        auto &e = get_entry(net);
+        int own_pins = int(cn.users.size()) + (cn.is_driver ? 1 : 0);
+        // Bounding box with the pins of the cell moved
+        NetEntry bounds;
+        bounds.bounds_valid = true;
+        bounds.npins = e.npins;
+        bounds.x0 = e.x0, bounds.x1 = e.x1, bounds.y0 = e.y0, bounds.y1 = e.y1;
+        bounds.nx0 = e.nx0, bounds.nx1 = e.nx1, bounds.ny0 = e.ny0, bounds.ny1 = e.ny1;
+        if (old_pin)
+            for (int i = 0; i < own_pins && bounds.bounds_valid; i++)
+                remove_pin(bounds, old_loc);
+        if (!bounds.bounds_valid) {
+            bounds.npins = 0;
+            if (driver_cell != cell && !ctx->getBelGlobalBuf(driver_bel))
+                add_pin(bounds, ctx->getBelLocation(driver_bel));
+            for (auto &usr : net->users)
+                if (usr.cell != nullptr && usr.cell != cell && usr.cell->bel != BelId() &&
+                    !ctx->getBelGlobalBuf(usr.cell->bel))
+                    add_pin(bounds, ctx->getBelLocation(usr.cell->bel));
+            bounds.bounds_valid = true;
+        }
+        if (new_pin)
+            for (int i = 0; i < own_pins; i++)
+                add_pin(bounds, new_loc);
+        int hpwl = (bounds.npins == 0) ? 0 : ((bounds.x1 - bounds.x0) + (bounds.y1 - bounds.y0));
+
+        delay_t worst_slack = std::numeric_limits<delay_t>::max(), negative_slack = 0;
+        if (is_timing_net(net)) {
+            cell->bel = bel;
+            if (cn.is_driver) {
+                // Every arc changes
+                for (size_t i = 0; i < net->users.size(); i++) {
+                    delay_t slack = get_slack(net, i);
+                    if (slack < 0)
+                        negative_slack += slack;
+                    worst_slack = std::min(worst_slack, slack);
+                }
+            } else {
+                negative_slack = e.negative_slack;
+                bool worst_moved = false;
+                for (size_t i : cn.users) {
+                    delay_t old_slack = e.slack.at(i), new_slack = get_slack(net, i);
+                    if (old_slack < 0)
+                        negative_slack -= old_slack;
+                    if (new_slack < 0)
+                        negative_slack += new_slack;
+                    if (old_slack <= e.worst_slack)
+                        worst_moved = true;
+                    worst_slack = std::min(worst_slack, new_slack);
+                }
+                if (!worst_moved) {
+                    worst_slack = std::min(worst_slack, e.worst_slack);
+                } else {
+                    auto own = cn.users.begin();
+                    for (size_t i = 0; i < net->users.size(); i++) {
+                        if (own != cn.users.end() && *own == i) {
+                            ++own;
+                            continue;
+                        }
+                        worst_slack = std::min(worst_slack, e.slack.at(i));
+                    }
+                }
+            }
+            cell->bel = old_bel;
+        }
+        wirelength += net_cost(net, hpwl, worst_slack, negative_slack, tns);
+    }
+    return wirelength;
+}
+
+void NetMetricCache::cell_moved(const CellInfo *cell, BelId old_bel)
+{
+    bool old_pin = (old_bel != BelId()) && !ctx->getBelGlobalBuf(old_bel);
+    bool new_pin = (cell->bel != BelId()) && !ctx->getBelGlobalBuf(cell->bel);
+    for (auto &cn : get_cell_nets(cell)) {
+        auto fnd = entries.find(cn.net->name);
+        if (fnd == entries.end())
+            continue;
+        auto &e = fnd->second;
+        int own_pins = int(cn.users.size()) + (cn.is_driver ? 1 : 0);
+        if (old_pin)
+            for (int i = 0; i < own_pins && e.bounds_valid; i++)
+                remove_pin(e, ctx->getBelLocation(old_bel));
+        if (new_pin && e.bounds_valid)
+            for (int i = 0; i < own_pins; i++)
+                add_pin(e, ctx->getBelLocation(cell->bel));
+        if (!e.timing_valid)
+            continue;
+        if (cn.is_driver) {
+            e.timing_valid = false;
+            continue;
+        }
+        for (size_t i : cn.users) {
+            delay_t old_slack = e.slack.at(i), new_slack = get_slack(cn.net, i);
+            e.slack.at(i) = new_slack;
+            if (old_slack < 0)
+                e.negative_slack -= old_slack;
+            if (new_slack < 0)
+                e.negative_slack += new_slack;
+            if (new_slack <= e.worst_slack) {
+                e.worst_slack = new_slack;
+            } else if (old_slack == e.worst_slack) {
+                // The worst arc got better, so the new worst one isn't known
+                e.timing_valid = false;
+                break;
+            }
+        }
+    }
+}
+
 // Placing a single cell
-bool place_single_cell(Context *ctx, CellInfo *cell, bool require_legality)
+bool place_single_cell(Context *ctx, CellInfo *cell, bool require_legality, NetMetricCache *cache)
 {
     bool all_placed = false;
     int iters = 25;
@@ -114,13 +405,17 @@ bool place_single_cell(Context *ctx, CellInfo *cell, bool require_legality)
         CellInfo *ripup_target = nullptr;
         BelId ripup_bel = BelId();
         if (cell->bel != BelId()) {
-            ctx->unbindBel(cell->bel);
+            BelId old_bel = cell->bel;
+            ctx->unbindBel(old_bel);
+            if (cache)
+                cache->cell_moved(cell, old_bel);
         }
         IdString targetType = cell->type;
-        for (auto bel : ctx->getBels()) {
-            if (ctx->getBelType(bel) == targetType && (!require_legality || ctx->isValidBelForCell(cell, bel))) {
+        for (auto bel : ctx->getBelsByType(targetType)) {
+            if (!require_legality || ctx->isValidBelForCell(cell, bel)) {
                 if (ctx->checkBelAvail(bel)) {
-                    wirelen_t wirelen = get_cell_metric_at_bel(ctx, cell, bel, MetricType::COST);
+                    wirelen_t wirelen = cache ? cache->get_cell_metric_at_bel(cell, bel)
+                                              : get_cell_metric_at_bel(ctx, cell, bel, MetricType::COST);
                     if (iters >= 4)
                         wirelen += ctx->rng(25);
                     if (wirelen <= best_wirelen) {
@@ -128,7 +423,8 @@ bool place_single_cell(Context *ctx, CellInfo *cell, bool require_legality)
                         best_bel = bel;
                     }
                 } else {
-                    wirelen_t wirelen = get_cell_metric_at_bel(ctx, cell, bel, MetricType::COST);
+                    wirelen_t wirelen = cache ? cache->get_cell_metric_at_bel(cell, bel)
+                                              : get_cell_metric_at_bel(ctx, cell, bel, MetricType::COST);
                     if (iters >= 4)
                         wirelen += ctx->rng(25);
                     if (wirelen <= best_ripup_wirelen) {
@@ -151,7 +447,10 @@ bool place_single_cell(Context *ctx, CellInfo *cell, bool require_legality)
                 log_error("failed to place cell '%s' of type '%s'\n", cell->name.c_str(ctx), cell->type.c_str(ctx));
             }
             --iters;
-            ctx->unbindBel(ripup_target->bel);
+            BelId ripup_old_bel = ripup_target->bel;
+            ctx->unbindBel(ripup_old_bel);
+            if (cache)
+                cache->cell_moved(ripup_target, ripup_old_bel);
             best_bel = ripup_bel;
         } else {
             all_placed = true;
@@ -160,6 +459,8 @@ bool place_single_cell(Context *ctx, CellInfo *cell, bool require_legality)
             log_info("   placed single cell '%s' at '%s'\n", cell->name.c_str(ctx),
                      ctx->getBelName(best_bel).c_str(ctx));
         ctx->bindBel(best_bel, cell, STRENGTH_WEAK);
+        if (cache)
+            cache->cell_moved(cell, BelId());
 
         cell = ripup_target;
     }
@@ -172,6 +473,7 @@ class ConstraintLegaliseWorker
     Context *ctx;
     std::set<IdString> rippedCells;
     std::unordered_map<IdString, Loc> oldLocations;
+    int threads = 1;
     class IncreasingDiameterSearch
     {
       public:
@@ -220,6 +522,167 @@ class ConstraintLegaliseWorker
 
     typedef std::unordered_map<IdString, Loc> CellLocations;
 
+    // The shape of a chain where every cell below the root has a fixed x, y and z offset, as columns of cells of one
+    // type at the same x offset and z. z is either absolute or relative to the z of the root.
+    struct ChainShape
+    {
+        struct Column
+        {
+            int dx;
+            IdString type;
+            bool abs_z;
+            int z;
+            int dy_min, dy_max;
+            std::vector<int> dys;
+            bool contiguous;
+        };
+        bool rigid = false;
+        std::vector<Column> columns;
+    };
+
+    typedef std::map<std::tuple<int, IdString, bool, int>, std::vector<int>> ShapeColumns;
+
+    bool add_to_shape(const CellInfo *cell, int dx, int dy, bool abs_z, int z, ShapeColumns &cols)
+    {
+        cols[std::make_tuple(dx, cell->type, abs_z, z)].push_back(dy);
+        for (auto child : cell->constr_children) {
+            if (child->constr_x == child->UNCONSTR || child->constr_y == child->UNCONSTR ||
+                child->constr_z == child->UNCONSTR)
+                return false;
+            bool child_abs_z = child->constr_abs_z || abs_z;
+            int child_z = child->constr_abs_z ? child->constr_z : (z + child->constr_z);
+            if (!add_to_shape(child, dx + child->constr_x, dy + child->constr_y, child_abs_z, child_z, cols))
+                return false;
+        }
+        return true;
+    }
+
+    ChainShape get_chain_shape(const CellInfo *root)
+    {
+        ChainShape shape;
+        ShapeColumns cols;
+        if (!add_to_shape(root, 0, 0, false, 0, cols))
+            return shape;
+        shape.rigid = true;
+        for (auto &col : cols) {
+            ChainShape::Column c;
+            std::tie(c.dx, c.type, c.abs_z, c.z) = col.first;
+            c.dys = col.second;
+            std::sort(c.dys.begin(), c.dys.end());
+            c.dy_min = c.dys.front();
+            c.dy_max = c.dys.back();
+            c.contiguous = true;
+            for (size_t i = 1; i < c.dys.size(); i++)
+                if (c.dys.at(i) != c.dys.at(i - 1) + 1)
+                    c.contiguous = false;
+            shape.columns.push_back(c);
+        }
+        return shape;
+    }
+
+    // For each bel type and z used by a rigid chain, the number of usable locations in a row going up in y from each
+    // location. A location is usable if it has a bel of that type and z, and there are no strongly bound bels in its
+    // tile. This lets a root location be rejected with one lookup per column of the chain.
+    struct ChainIndex
+    {
+        int width = 0, height = 0;
+        // Indexed by y * width + x
+        std::vector<uint8_t> blocked;
+        std::unordered_map<uint64_t, int> key_idx;
+        // Indexed by key, then x * height + y
+        std::vector<std::vector<uint8_t>> present;
+        std::vector<std::vector<int>> run;
+
+        static uint64_t key(IdString type, int z) { return (uint64_t(type.index) << 32) | uint32_t(z); }
+
+        void update_column(int k, int x)
+        {
+            int count = 0;
+            for (int y = height - 1; y >= 0; y--) {
+                int i = x * height + y;
+                count = (present.at(k).at(i) && !blocked.at(y * width + x)) ? (count + 1) : 0;
+                run.at(k).at(i) = count;
+            }
+        }
+
+        int get_run(IdString type, int z, int x, int y) const
+        {
+            auto fnd = key_idx.find(key(type, z));
+            if (fnd == key_idx.end())
+                return 0;
+            return run.at(fnd->second).at(x * height + y);
+        }
+    };
+    ChainIndex chain_index;
+    bool chain_index_built = false;
+
+    void build_chain_index(const std::unordered_set<IdString> &types)
+    {
+        auto &ci = chain_index;
+        ci.width = ctx->getGridDimX();
+        ci.height = ctx->getGridDimY();
+        ci.blocked.assign(ci.width * ci.height, 0);
+        // In a fixed order, as the chain index keys are numbered as they are found
+        std::set<IdString> sorted_types(types.begin(), types.end());
+        for (IdString type : sorted_types) {
+            for (auto bel : ctx->getBelsByType(type)) {
+                Loc loc = ctx->getBelLocation(bel);
+                auto ins = ci.key_idx.emplace(ChainIndex::key(type, loc.z), int(ci.present.size()));
+                if (ins.second) {
+                    ci.present.emplace_back(ci.width * ci.height, 0);
+                    ci.run.emplace_back(ci.width * ci.height, 0);
+                }
+                ci.present.at(ins.first->second).at(loc.x * ci.height + loc.y) = 1;
+            }
+        }
+        for (auto &cell : ctx->cells) {
+            if (cell.second->bel == BelId() || cell.second->belStrength < STRENGTH_STRONG)
+                continue;
+            Loc loc = ctx->getBelLocation(cell.second->bel);
+            ci.blocked.at(loc.y * ci.width + loc.x) = 1;
+        }
+        for (int k = 0; k < int(ci.present.size()); k++)
+            for (int x = 0; x < ci.width; x++)
+                ci.update_column(k, x);
+        chain_index_built = true;
+    }
+
+    // Keep the chain index up to date when a cell becomes strongly bound
+    void mark_strong(const CellInfo *cell)
+    {
+        if (!chain_index_built || cell->bel == BelId())
+            return;
+        auto &ci = chain_index;
+        Loc loc = ctx->getBelLocation(cell->bel);
+        uint8_t &blocked = ci.blocked.at(loc.y * ci.width + loc.x);
+        if (blocked)
+            return;
+        blocked = 1;
+        for (int k = 0; k < int(ci.present.size()); k++)
+            ci.update_column(k, loc.x);
+    }
+
+    // A necessary condition for valid_loc_for to succeed for a rigid chain at a root location
+    bool chain_fits(const ChainShape &shape, Loc root) const
+    {
+        auto &ci = chain_index;
+        for (auto &col : shape.columns) {
+            int x = root.x + col.dx, z = col.abs_z ? col.z : (root.z + col.z);
+            int y0 = root.y + col.dy_min, y1 = root.y + col.dy_max;
+            if (x < 0 || x >= ci.width || y0 < 0 || y1 >= ci.height)
+                return false;
+            if (col.contiguous) {
+                if (ci.get_run(col.type, z, x, y0) < (y1 - y0 + 1))
+                    return false;
+            } else {
+                for (int dy : col.dys)
+                    if (ci.get_run(col.type, z, x, root.y + dy) == 0)
+                        return false;
+            }
+        }
+        return true;
+    }
+
     // Check if a location would be suitable for a cell and all its constrained children
     // This also makes a crude attempt to "solve" unconstrained constraints, that is slow and horrible
     // and will need to be reworked if mixed constrained/unconstrained chains become common
@@ -305,102 +768,152 @@ class ConstraintLegaliseWorker
     void lockdown_chain(CellInfo *root)
     {
         root->belStrength = STRENGTH_STRONG;
+        mark_strong(root);
         for (auto child : root->constr_children)
             lockdown_chain(child);
     }
 
-    // Legalise placement constraints on a cell
-    bool legalise_cell(CellInfo *cell)
+    // The location that the search for a root location starts from
+    Loc search_start(const CellInfo *cell)
     {
-        if (cell->constr_parent != nullptr)
-            return true; // Only process chain roots
-        if (constraints_satisfied(cell)) {
-            if (cell->constr_children.size() > 0 || cell->constr_x != cell->UNCONSTR ||
-                cell->constr_y != cell->UNCONSTR || cell->constr_z != cell->UNCONSTR)
-                lockdown_chain(cell);
-        } else {
-            IncreasingDiameterSearch xRootSearch, yRootSearch, zRootSearch;
-            Loc currentLoc;
-            if (cell->bel != BelId())
-                currentLoc = ctx->getBelLocation(cell->bel);
-            else
-                currentLoc = oldLocations[cell->name];
-            if (cell->constr_x == cell->UNCONSTR)
-                xRootSearch = IncreasingDiameterSearch(currentLoc.x, 0, ctx->getGridDimX() - 1);
-            else
-                xRootSearch = IncreasingDiameterSearch(cell->constr_x);
+        if (cell->bel != BelId())
+            return ctx->getBelLocation(cell->bel);
+        else
+            return oldLocations[cell->name];
+    }
 
-            if (cell->constr_y == cell->UNCONSTR)
-                yRootSearch = IncreasingDiameterSearch(currentLoc.y, 0, ctx->getGridDimY() - 1);
-            else
-                yRootSearch = IncreasingDiameterSearch(cell->constr_y);
+    // Find the first valid root location for a chain in search order. With the shape of a rigid chain, locations are
+    // checked against the chain index first. Only reads the context, so can be run for several chains at once.
+    bool find_root_loc(const CellInfo *cell, const ChainShape *shape, Loc currentLoc, Loc &result)
+    {
+        IncreasingDiameterSearch xRootSearch, yRootSearch, zRootSearch;
+        if (cell->constr_x == cell->UNCONSTR)
+            xRootSearch = IncreasingDiameterSearch(currentLoc.x, 0, ctx->getGridDimX() - 1);
+        else
+            xRootSearch = IncreasingDiameterSearch(cell->constr_x);
 
-            if (cell->constr_z == cell->UNCONSTR)
-                zRootSearch =
-                        IncreasingDiameterSearch(currentLoc.z, 0, ctx->getTileBelDimZ(currentLoc.x, currentLoc.y));
-            else
-                zRootSearch = IncreasingDiameterSearch(cell->constr_z);
-            while (!xRootSearch.done()) {
-                Loc rootLoc;
-
-                rootLoc.x = xRootSearch.get();
-                rootLoc.y = yRootSearch.get();
-                rootLoc.z = zRootSearch.get();
-                zRootSearch.next();
-                if (zRootSearch.done()) {
-                    zRootSearch.reset();
-                    yRootSearch.next();
-                    if (yRootSearch.done()) {
-                        yRootSearch.reset();
-                        xRootSearch.next();
-                    }
+        if (cell->constr_y == cell->UNCONSTR)
+            yRootSearch = IncreasingDiameterSearch(currentLoc.y, 0, ctx->getGridDimY() - 1);
+        else
+            yRootSearch = IncreasingDiameterSearch(cell->constr_y);
+
+        if (cell->constr_z == cell->UNCONSTR)
+            zRootSearch = IncreasingDiameterSearch(currentLoc.z, 0, ctx->getTileBelDimZ(currentLoc.x, currentLoc.y));
+        else
+            zRootSearch = IncreasingDiameterSearch(cell->constr_z);
+        while (!xRootSearch.done()) {
+            Loc rootLoc;
+
+            rootLoc.x = xRootSearch.get();
+            rootLoc.y = yRootSearch.get();
+            rootLoc.z = zRootSearch.get();
+            zRootSearch.next();
+            if (zRootSearch.done()) {
+                zRootSearch.reset();
+                yRootSearch.next();
+                if (yRootSearch.done()) {
+                    yRootSearch.reset();
+                    xRootSearch.next();
                 }
+            }
 
-                CellLocations solution;
-                std::unordered_set<Loc> used;
-                if (valid_loc_for(cell, rootLoc, solution, used)) {
-                    for (auto cp : solution) {
-                        // First unbind all cells
-                        if (ctx->cells.at(cp.first)->bel != BelId())
-                            ctx->unbindBel(ctx->cells.at(cp.first)->bel);
-                    }
-                    for (auto cp : solution) {
-                        if (ctx->verbose)
-                            log_info("     placing '%s' at (%d, %d, %d)\n", cp.first.c_str(ctx), cp.second.x,
-                                     cp.second.y, cp.second.z);
-                        BelId target = ctx->getBelByLocation(cp.second);
-                        if (!ctx->checkBelAvail(target)) {
-                            CellInfo *confl_cell = ctx->getConflictingBelCell(target);
-                            if (confl_cell != nullptr) {
-                                if (ctx->verbose)
-                                    log_info("       '%s' already placed at '%s'\n", ctx->nameOf(confl_cell),
-                                             ctx->getBelName(confl_cell->bel).c_str(ctx));
-                                NPNR_ASSERT(confl_cell->belStrength < STRENGTH_STRONG);
-                                ctx->unbindBel(target);
-                                rippedCells.insert(confl_cell->name);
-                            }
-                        }
-                        ctx->bindBel(target, ctx->cells.at(cp.first).get(), STRENGTH_STRONG);
-                        rippedCells.erase(cp.first);
-                    }
-                    for (auto cp : solution) {
-                        for (auto bel : ctx->getBelsByTile(cp.second.x, cp.second.y)) {
-                            CellInfo *belCell = ctx->getBoundBelCell(bel);
-                            if (belCell != nullptr && !solution.count(belCell->name)) {
-                                if (!ctx->isValidBelForCell(belCell, bel)) {
-                                    NPNR_ASSERT(belCell->belStrength < STRENGTH_STRONG);
-                                    ctx->unbindBel(bel);
-                                    rippedCells.insert(belCell->name);
-                                }
-                            }
-                        }
+            if (shape != nullptr && !chain_fits(*shape, rootLoc))
+                continue;
+            CellLocations solution;
+            std::unordered_set<Loc> used;
+            if (valid_loc_for(cell, rootLoc, solution, used)) {
+                result = rootLoc;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Bind the cells of a chain at the locations found by valid_loc_for, ripping up weakly bound cells in the way
+    void place_solution(const CellLocations &solution)
+    {
+        for (auto cp : solution) {
+            // First unbind all cells
+            if (ctx->cells.at(cp.first)->bel != BelId())
+                ctx->unbindBel(ctx->cells.at(cp.first)->bel);
+        }
+        for (auto cp : solution) {
+            if (ctx->verbose)
+                log_info("     placing '%s' at (%d, %d, %d)\n", cp.first.c_str(ctx), cp.second.x, cp.second.y,
+                         cp.second.z);
+            BelId target = ctx->getBelByLocation(cp.second);
+            if (!ctx->checkBelAvail(target)) {
+                CellInfo *confl_cell = ctx->getConflictingBelCell(target);
+                if (confl_cell != nullptr) {
+                    if (ctx->verbose)
+                        log_info("       '%s' already placed at '%s'\n", ctx->nameOf(confl_cell),
+                                 ctx->getBelName(confl_cell->bel).c_str(ctx));
+                    NPNR_ASSERT(confl_cell->belStrength < STRENGTH_STRONG);
+                    ctx->unbindBel(target);
+                    rippedCells.insert(confl_cell->name);
+                }
+            }
+            CellInfo *cell = ctx->cells.at(cp.first).get();
+            ctx->bindBel(target, cell, STRENGTH_STRONG);
+            mark_strong(cell);
+            rippedCells.erase(cp.first);
+        }
+        for (auto cp : solution) {
+            for (auto bel : ctx->getBelsByTile(cp.second.x, cp.second.y)) {
+                CellInfo *belCell = ctx->getBoundBelCell(bel);
+                if (belCell != nullptr && !solution.count(belCell->name)) {
+                    if (!ctx->isValidBelForCell(belCell, bel)) {
+                        NPNR_ASSERT(belCell->belStrength < STRENGTH_STRONG);
+                        ctx->unbindBel(bel);
+                        rippedCells.insert(belCell->name);
                     }
-                    NPNR_ASSERT(constraints_satisfied(cell));
-                    return true;
                 }
             }
-            return false;
         }
+    }
+
+    // The result of find_root_loc for a chain, run before the chains ahead of it were legalised
+    struct RootHint
+    {
+        bool valid = false;
+        Loc start;
+        bool found = false;
+        Loc loc;
+    };
+
+    // Legalise placement constraints on a cell. Legalising a chain only ever takes locations away from the others,
+    // by binding cells strongly. So if the location in a hint is still valid, it's still the first valid one.
+    bool legalise_cell(CellInfo *cell, const ChainShape *shape = nullptr, const RootHint *hint = nullptr)
+    {
+        if (cell->constr_parent != nullptr)
+            return true; // Only process chain roots
+        if (constraints_satisfied(cell)) {
+            if (cell->constr_children.size() > 0 || cell->constr_x != cell->UNCONSTR ||
+                cell->constr_y != cell->UNCONSTR || cell->constr_z != cell->UNCONSTR)
+                lockdown_chain(cell);
+            return true;
+        }
+        Loc currentLoc = search_start(cell);
+        Loc rootLoc;
+        CellLocations solution;
+        std::unordered_set<Loc> used;
+        if (hint != nullptr && hint->valid && hint->start == currentLoc) {
+            if (!hint->found)
+                return false;
+            if (valid_loc_for(cell, hint->loc, solution, used)) {
+                place_solution(solution);
+                NPNR_ASSERT(constraints_satisfied(cell));
+                return true;
+            }
+            solution.clear();
+            used.clear();
+        }
+        if (!find_root_loc(cell, shape, currentLoc, rootLoc))
+            return false;
+        bool valid = valid_loc_for(cell, rootLoc, solution, used);
+        NPNR_ASSERT(valid);
+        place_solution(solution);
+        NPNR_ASSERT(constraints_satisfied(cell));
         return true;
     }
 
@@ -408,7 +921,10 @@ class ConstraintLegaliseWorker
     bool constraints_satisfied(const CellInfo *cell) { return get_constraints_distance(ctx, cell) == 0; }
 
   public:
-    ConstraintLegaliseWorker(Context *ctx) : ctx(ctx){};
+    ConstraintLegaliseWorker(Context *ctx) : ctx(ctx)
+    {
+        threads = std::max(1, ctx->setting<int>("threads", std::max<int>(1, std::thread::hardware_concurrency())));
+    };
 
     void print_chain(CellInfo *cell, int depth = 0)
     {
@@ -466,19 +982,63 @@ class ConstraintLegaliseWorker
         for (auto cell : sorted(ctx->cells)) {
             oldLocations[cell.first] = ctx->getBelLocation(cell.second->bel);
         }
+        std::vector<CellInfo *> roots;
+        std::vector<ChainShape> shapes;
+        std::unordered_set<IdString> rigid_types;
         for (auto cell : sorted(ctx->cells)) {
-            bool res = legalise_cell(cell.second);
-            if (!res) {
-                if (ctx->verbose)
-                    print_chain(cell.second);
-                log_error("failed to place chain starting at cell '%s'\n", cell.first.c_str(ctx));
-                return -1;
+            if (cell.second->constr_parent != nullptr)
+                continue;
+            roots.push_back(cell.second);
+            shapes.push_back(cell.second->constr_children.empty() ? ChainShape() : get_chain_shape(cell.second));
+            for (auto &col : shapes.back().columns)
+                rigid_types.insert(col.type);
+        }
+        if (!rigid_types.empty())
+            build_chain_index(rigid_types);
+        // The root locations of a batch of chains are searched for in parallel, then the chains are legalised in
+        // order using them as hints
+        size_t batch_size = (threads > 1) ? 16 * threads : 1;
+        std::vector<RootHint> hints;
+        std::vector<size_t> todo;
+        for (size_t b = 0; b < roots.size(); b += batch_size) {
+            size_t e = std::min(roots.size(), b + batch_size);
+            hints.assign(e - b, RootHint());
+            todo.clear();
+            if (threads > 1) {
+                for (size_t i = b; i < e; i++) {
+                    if (constraints_satisfied(roots.at(i)))
+                        continue;
+                    hints.at(i - b).start = search_start(roots.at(i));
+                    todo.push_back(i);
+                }
+            }
+            ctx->threadPool().parallel_for(
+                    todo.size(), 1,
+                    [&](size_t t) {
+                        size_t i = todo.at(t);
+                        auto &hint = hints.at(i - b);
+                        hint.found = find_root_loc(roots.at(i), shapes.at(i).rigid ? &shapes.at(i) : nullptr,
+                                                   hint.start, hint.loc);
+                        hint.valid = true;
+                    },
+                    threads);
+
+            for (size_t i = b; i < e; i++) {
+                CellInfo *cell = roots.at(i);
+                bool res = legalise_cell(cell, shapes.at(i).rigid ? &shapes.at(i) : nullptr, &hints.at(i - b));
+                if (!res) {
+                    if (ctx->verbose)
+                        print_chain(cell);
+                    log_error("failed to place chain starting at cell '%s'\n", cell->name.c_str(ctx));
+                    return -1;
+                }
             }
         }
         if (print_stats("legalising chains") == 0)
             return 0;
+        NetMetricCache metric_cache(ctx, MetricType::COST);
         for (auto rippedCell : rippedCells) {
-            bool res = place_single_cell(ctx, ctx->cells.at(rippedCell).get(), true);
+            bool res = place_single_cell(ctx, ctx->cells.at(rippedCell).get(), true, &metric_cache);
             if (!res) {
                 log_error("failed to place cell '%s' after relative constraint legalisation\n", rippedCell.c_str(ctx));
                 return -1;
@@ -41,8 +41,62 @@ wirelen_t get_cell_metric(const Context *ctx, const CellInfo *cell, MetricType t
 // Return the wirelength of all nets connected to a cell, when the cell is at a given bel
 wirelen_t get_cell_metric_at_bel(const Context *ctx, CellInfo *cell, BelId bel, MetricType type);
 
-// Place a single cell in the lowest wirelength Bel available, optionally requiring validity check
-bool place_single_cell(Context *ctx, CellInfo *cell, bool require_legality);
+// Cache of the metrics of nets, as returned by get_net_metric, for evaluating many locations of a cell. Bounding
+// boxes keep the number of pins at each edge, like in placer1, so they are updated in constant time as cells move,
+// and only recomputed when the last pin at an edge moves inwards. Arc slacks are kept per user. Every bind and
+// unbind of a cell must be followed by cell_moved while the cache is in use.
+class NetMetricCache
+{
+  public:
+    NetMetricCache(const Context *ctx, MetricType type);
+
+    wirelen_t get_net_metric(const NetInfo *net, float &tns);
+    wirelen_t get_cell_metric(const CellInfo *cell);
+    // Metric of a cell's nets with it at a given bel. Only nets with a pin moving outside their bounding box, or a
+    // changed worst arc, need more than constant time
+    wirelen_t get_cell_metric_at_bel(CellInfo *cell, BelId bel);
+    // Update the cache after a cell moved from old_bel to its current bel; either can be BelId()
+    void cell_moved(const CellInfo *cell, BelId old_bel);
+
+  private:
+    struct NetEntry
+    {
+        // Bounding box of placed pins outside global buffers, and the number of pins at each edge
+        bool bounds_valid = false;
+        int npins = 0;
+        int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+        int nx0 = 0, nx1 = 0, ny0 = 0, ny1 = 0;
+        // Slack of each user, or the maximum delay if it's unplaced
+        bool timing_valid = false;
+        std::vector<delay_t> slack;
+        delay_t negative_slack = 0, worst_slack = 0;
+    };
+    // The nets of a cell, with the indices of the users of each net on the cell
+    struct CellNet
+    {
+        NetInfo *net;
+        bool is_driver = false;
+        std::vector<size_t> users;
+    };
+
+    const Context *ctx;
+    MetricType type;
+    bool timing_driven;
+    std::unordered_map<IdString, NetEntry> entries;
+    std::unordered_map<IdString, std::vector<CellNet>> cell_nets;
+
+    const std::vector<CellNet> &get_cell_nets(const CellInfo *cell);
+    bool is_timing_net(const NetInfo *net) const;
+    delay_t get_slack(const NetInfo *net, size_t user) const;
+    static void add_pin(NetEntry &e, Loc loc);
+    static void remove_pin(NetEntry &e, Loc loc);
+    NetEntry &get_entry(const NetInfo *net);
+    wirelen_t net_cost(const NetInfo *net, int hpwl, delay_t worst_slack, delay_t negative_slack, float &tns) const;
+};
+
+// Place a single cell in the lowest wirelength Bel available, optionally requiring validity check. With a cache,
+// candidate bels are evaluated using it and the cache is kept up to date
+bool place_single_cell(Context *ctx, CellInfo *cell, bool require_legality, NetMetricCache *cache = nullptr);
 
 // Modify a design s.t. all relative placement constraints are satisfied
 bool legalise_relative_constraints(Context *ctx);
@@ -23,6 +23,8 @@
 
 #include "placer1.h"
 #include <algorithm>
+#include <atomic>
+#include <boost/container/small_vector.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <chrono>
@@ -38,9 +40,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <thread>
 #include <vector>
 #include "log.h"
 #include "place_common.h"
+#include "thread_pool.h"
 #include "timing.h"
 #include "util.h"
 
@@ -74,45 +78,62 @@ class SAPlacer
         }
     };
 
+    struct MoveChangeData;
+
+    // A block of the grid refined independently of the other regions moved at the same time
+    struct RefineRegion
+    {
+        int x0, y0, x1, y1;
+        std::vector<CellInfo *> cells;
+        DeterministicRNG rng;
+        int n_move = 0, n_accept = 0;
+
+        bool contains(int x, int y) const { return x >= x0 && x <= x1 && y >= y0 && y <= y1; }
+    };
+
   public:
-    SAPlacer(Context *ctx, Placer1Cfg cfg) : ctx(ctx), cfg(cfg)
+    SAPlacer(Context *ctx, Placer1Cfg cfg) : ctx(ctx), tmg(ctx), cfg(cfg)
     {
+        // Only the bel types of cells in the design are indexed
+        std::set<IdString> cell_types;
+        for (auto &cell : ctx->cells)
+            cell_types.insert(cell.second->type);
         int num_bel_types = 0;
-        for (auto bel : ctx->getBels()) {
-            IdString type = ctx->getBelType(bel);
-            if (bel_types.find(type) == bel_types.end()) {
-                bel_types[type] = std::tuple<int, int>(num_bel_types++, 1);
-            } else {
-                std::get<1>(bel_types.at(type))++;
+        for (IdString type : cell_types) {
+            std::vector<BelId> type_bels;
+            for (auto bel : ctx->getBelsByType(type))
+                type_bels.push_back(bel);
+            if (type_bels.empty())
+                continue;
+            int type_idx = num_bel_types++, type_cnt = int(type_bels.size());
+            bel_types[type] = std::tuple<int, int>(type_idx, type_cnt);
+            fast_bels.resize(num_bel_types);
+            for (auto bel : type_bels) {
+                Loc loc = ctx->getBelLocation(bel);
+                if (type_cnt < cfg.minBelsForGridPick)
+                    loc.x = loc.y = 0;
+                if (int(fast_bels.at(type_idx).size()) < (loc.x + 1))
+                    fast_bels.at(type_idx).resize(loc.x + 1);
+                if (int(fast_bels.at(type_idx).at(loc.x).size()) < (loc.y + 1))
+                    fast_bels.at(type_idx).at(loc.x).resize(loc.y + 1);
+                fast_bels.at(type_idx).at(loc.x).at(loc.y).push_back(bel);
             }
         }
-        for (auto bel : ctx->getBels()) {
-            Loc loc = ctx->getBelLocation(bel);
-            IdString type = ctx->getBelType(bel);
-            int type_idx = std::get<0>(bel_types.at(type));
-            int type_cnt = std::get<1>(bel_types.at(type));
-            if (type_cnt < cfg.minBelsForGridPick)
-                loc.x = loc.y = 0;
-            if (int(fast_bels.size()) < type_idx + 1)
-                fast_bels.resize(type_idx + 1);
-            if (int(fast_bels.at(type_idx).size()) < (loc.x + 1))
-                fast_bels.at(type_idx).resize(loc.x + 1);
-            if (int(fast_bels.at(type_idx).at(loc.x).size()) < (loc.y + 1))
-                fast_bels.at(type_idx).at(loc.x).resize(loc.y + 1);
-            max_x = std::max(max_x, loc.x);
-            max_y = std::max(max_y, loc.y);
-            fast_bels.at(type_idx).at(loc.x).at(loc.y).push_back(bel);
-        }
+        max_x = ctx->getGridDimX() - 1;
+        max_y = ctx->getGridDimY() - 1;
         diameter = std::max(max_x, max_y) + 1;
 
         net_bounds.resize(ctx->nets.size());
         net_arc_tcost.resize(ctx->nets.size());
+        net_arc_delay.resize(ctx->nets.size());
+        tmg_dirty.resize(ctx->nets.size());
         old_udata.reserve(ctx->nets.size());
         net_by_udata.reserve(ctx->nets.size());
         decltype(NetInfo::udata) n = 0;
         for (auto &net : ctx->nets) {
             old_udata.emplace_back(net.second->udata);
             net_arc_tcost.at(n).resize(net.second->users.size());
+            net_arc_delay.at(n).resize(net.second->users.size());
             net.second->udata = n++;
             net_by_udata.push_back(net.second.get());
         }
@@ -247,9 +268,12 @@ class SAPlacer
         }
         auto saplace_start = std::chrono::high_resolution_clock::now();
 
-        // Invoke timing analysis to obtain criticalities
-        if (!cfg.budgetBased)
-            get_criticalities(ctx, &net_crit);
+        // Invoke timing analysis to obtain criticalities; the graph is kept, so that later updates only re-time the
+        // nets that moves have changed
+        if (!cfg.budgetBased) {
+            tmg.setup();
+            tmg.get_criticalities(&net_crit);
+        }
 
         // Calculate costs after initial placement
         setup_costs();
@@ -262,6 +286,18 @@ class SAPlacer
         if (cfg.netShareWeight > 0)
             setup_nets_by_tile();
 
+        // Net sharing costs are global, so placement with them enabled stays serial
+        bool parallel_ok = cfg.parallelRefine && cfg.netShareWeight == 0;
+        bool parallel_started = false;
+        std::vector<CellInfo *> serial_cells;
+        if (parallel_ok) {
+            refine_mc.resize(cfg.threads);
+            for (auto &mc : refine_mc) {
+                mc.init(this);
+                mc.local_only = true;
+            }
+        }
+
         wirelen_t avg_wirelen = curr_wirelen_cost;
         wirelen_t min_wirelen = curr_wirelen_cost;
 
@@ -278,9 +314,26 @@ class SAPlacer
                          "%.0f, wirelen = %.0f\n",
                          iter, temp, double(curr_timing_cost), double(curr_wirelen_cost));
 
+            // Once the placement is legal and the move diameter fits well within a region (always the case when
+            // refining), the moves of most cells are made in parallel within grid regions
+            bool parallel_moves = parallel_ok && !require_legal && (refine || 2 * diameter < cfg.parallelRefineRegion);
+            if (parallel_moves) {
+                if (!parallel_started) {
+                    // Cells of rare types are not picked from a location grid, so are left to the serial moves
+                    for (auto cell : autoplaced)
+                        if (std::get<1>(bel_types.at(cell->type)) < cfg.minBelsForGridPick)
+                            serial_cells.push_back(cell);
+                    log_info("%s in %dx%d tile regions using %d threads.\n", refine ? "Refining" : "Annealing",
+                             cfg.parallelRefineRegion, cfg.parallelRefineRegion, cfg.threads);
+                    parallel_started = true;
+                }
+                refine_regions(iter, autoplaced);
+            }
+
+            const std::vector<CellInfo *> &move_cells = parallel_moves ? serial_cells : autoplaced;
             for (int m = 0; m < 15; ++m) {
                 // Loop through all automatically placed cells
-                for (auto cell : autoplaced) {
+                for (auto cell : move_cells) {
                     // Find another random Bel for this cell
                     BelId try_bel = random_bel_for_cell(cell);
                     // If valid, try and swap to a new position and see if
@@ -378,17 +431,26 @@ class SAPlacer
                     // Legalisation is a big change so force a slack redistribution here
                     if (cfg.slack_redist_iter > 0 && cfg.budgetBased)
                         assign_budget(ctx, true /* quiet */);
+                    legalised = true;
                 }
                 require_legal = false;
             } else if (cfg.budgetBased && cfg.slack_redist_iter > 0 && iter % cfg.slack_redist_iter == 0) {
                 assign_budget(ctx, true /* quiet */);
             }
 
-            // Invoke timing analysis to obtain criticalities
-            if (!cfg.budgetBased && cfg.timing_driven)
-                get_criticalities(ctx, &net_crit);
-            // Need to rebuild costs after criticalities change
-            setup_costs();
+            // Update criticalities, and rebuild costs after they change. Without legalisation having moved cells
+            // behind the placer's back, the bounds are already up to date and only the delays of the nets touched by
+            // accepted moves need to be estimated again
+            if (!cfg.budgetBased && cfg.timing_driven && !legalised) {
+                update_timing_costs();
+            } else {
+                if (!cfg.budgetBased && cfg.timing_driven) {
+                    tmg.setup();
+                    tmg.get_criticalities(&net_crit);
+                }
+                setup_costs();
+            }
+            legalised = false;
             // Reset incremental bounds
             moveChange.reset(this);
             moveChange.new_net_bounds = net_bounds;
@@ -406,9 +468,13 @@ class SAPlacer
         auto saplace_end = std::chrono::high_resolution_clock::now();
         log_info("SA placement time %.02fs\n", std::chrono::duration<float>(saplace_end - saplace_start).count());
 
-        // Final post-pacement validitiy check
+        // Final post-pacement validitiy check, of the bels of the types that cells were placed on
         ctx->yield();
-        for (auto bel : ctx->getBels()) {
+        std::vector<BelId> placed_type_bels;
+        for (auto &type : bel_types)
+            for (auto bel : ctx->getBelsByType(type.first))
+                placed_type_bels.push_back(bel);
+        for (auto bel : placed_type_bels) {
             CellInfo *cell = ctx->getBoundBelCell(bel);
             if (!ctx->isBelLocationValid(bel)) {
                 std::string cell_text = "no cell";
@@ -476,7 +542,7 @@ class SAPlacer
                     proc_bel(bel);
                 }
             } else {
-                for (auto bel : ctx->getBels()) {
+                for (auto bel : ctx->getBelsByType(targetType)) {
                     proc_bel(bel);
                 }
             }
@@ -499,10 +565,15 @@ class SAPlacer
     }
 
     // Attempt a SA position swap, return true on success or false on failure
-    bool try_swap_position(CellInfo *cell, BelId newBel)
+    bool try_swap_position(CellInfo *cell, BelId newBel) { return try_swap_position(cell, newBel, moveChange, nullptr); }
+
+    // As above, with the move change data and random state of a refinement region when running in parallel
+    bool try_swap_position(CellInfo *cell, BelId newBel, MoveChangeData &mc, RefineRegion *region)
     {
         static const double epsilon = 1e-20;
-        moveChange.reset(this);
+        DeterministicRNG &rng = region ? region->rng : *ctx;
+        int &moves = region ? region->n_move : n_move, &accepts = region ? region->n_accept : n_accept;
+        mc.reset(this);
         if (!require_legal && is_constrained(cell))
             return false;
         BelId oldBel = cell->bel;
@@ -535,10 +606,10 @@ class SAPlacer
                         update_nets_by_tile(other_cell, ctx->getBelLocation(newBel), ctx->getBelLocation(oldBel));
         }
 
-        add_move_cell(moveChange, cell, oldBel);
+        add_move_cell(mc, cell, oldBel);
 
         if (other_cell != nullptr) {
-            add_move_cell(moveChange, other_cell, newBel);
+            add_move_cell(mc, other_cell, newBel);
         }
 
         if (!ctx->isBelLocationValid(newBel) || ((other_cell != nullptr && !ctx->isBelLocationValid(oldBel)))) {
@@ -549,27 +620,28 @@ class SAPlacer
         }
 
         // Recalculate metrics for all nets touched by the peturbation
-        compute_cost_changes(moveChange);
+        compute_cost_changes(mc);
 
         new_dist = get_constraints_distance(ctx, cell);
         if (other_cell != nullptr)
             new_dist += get_constraints_distance(ctx, other_cell);
-        delta = lambda * (moveChange.timing_delta / std::max<double>(last_timing_cost, epsilon)) +
-                (1 - lambda) * (double(moveChange.wirelen_delta) / std::max<double>(last_wirelen_cost, epsilon));
+        delta = lambda * (mc.timing_delta / std::max<double>(last_timing_cost, epsilon)) +
+                (1 - lambda) * (double(mc.wirelen_delta) / std::max<double>(last_wirelen_cost, epsilon));
         delta += (cfg.constraintWeight / temp) * (new_dist - old_dist) / last_wirelen_cost;
         if (cfg.netShareWeight > 0)
             delta += -cfg.netShareWeight * (net_delta_score / std::max<double>(total_net_share, epsilon));
-        n_move++;
+        moves++;
         // SA acceptance criterea
-        if (delta < 0 || (temp > 1e-8 && (ctx->rng() / float(0x3fffffff)) <= std::exp(-delta / temp))) {
-            n_accept++;
+        if (delta < 0 || (temp > 1e-8 && (rng.rng() / float(0x3fffffff)) <= std::exp(-delta / temp))) {
+            accepts++;
         } else {
             if (other_cell != nullptr)
                 ctx->unbindBel(oldBel);
             ctx->unbindBel(newBel);
             goto swap_fail;
         }
-        commit_cost_changes(moveChange);
+        // Total costs are recomputed once all regions are done
+        commit_cost_changes(mc, region == nullptr);
 #if 0
         log_info("swap %s -> %s\n", cell->name.c_str(ctx), ctx->getBelName(newBel).c_str(ctx));
         if (other_cell != nullptr)
@@ -710,9 +782,10 @@ class SAPlacer
     }
 
     // Find a random Bel of the correct type for a cell, within the specified
-    // diameter
-    BelId random_bel_for_cell(CellInfo *cell, int force_z = -1)
+    // diameter, and within the refinement region if one is given
+    BelId random_bel_for_cell(CellInfo *cell, int force_z = -1, RefineRegion *region = nullptr)
     {
+        DeterministicRNG &rng = region ? region->rng : *ctx;
         IdString targetType = cell->type;
         Loc curr_loc = ctx->getBelLocation(cell->bel);
         int count = 0;
@@ -731,8 +804,8 @@ class SAPlacer
         }
 
         while (true) {
-            int nx = ctx->rng(2 * dx + 1) + std::max(curr_loc.x - dx, 0);
-            int ny = ctx->rng(2 * dy + 1) + std::max(curr_loc.y - dy, 0);
+            int nx = rng.rng(2 * dx + 1) + std::max(curr_loc.x - dx, 0);
+            int ny = rng.rng(2 * dy + 1) + std::max(curr_loc.y - dy, 0);
             int beltype_idx, beltype_cnt;
             std::tie(beltype_idx, beltype_cnt) = bel_types.at(targetType);
             if (beltype_cnt < cfg.minBelsForGridPick)
@@ -744,7 +817,9 @@ class SAPlacer
             const auto &fb = fast_bels.at(beltype_idx).at(nx).at(ny);
             if (fb.size() == 0)
                 continue;
-            BelId bel = fb.at(ctx->rng(int(fb.size())));
+            if (region != nullptr && !region->contains(nx, ny))
+                continue;
+            BelId bel = fb.at(rng.rng(int(fb.size())));
             if (force_z != -1) {
                 Loc loc = ctx->getBelLocation(bel);
                 if (loc.z != force_z)
@@ -759,6 +834,124 @@ class SAPlacer
         }
     }
 
+    // One iteration of moves of the given cells, made in parallel within grid regions. The grid is split into
+    // four groups of regions in a checkerboard so that no two regions moving together touch; nets spanning more
+    // than one moving region are left out of the move costs and recomputed after each group. Each region has its
+    // own random state, seeded in order from the context, so the result does not depend on the thread count.
+    void refine_regions(int iter, const std::vector<CellInfo *> &cells)
+    {
+        const int size = cfg.parallelRefineRegion;
+        // Shift the grid every other iteration so cells can also move across region edges
+        const int offset = (iter % 2) ? size / 2 : 0;
+        const int nx = (max_x + offset) / size + 1, ny = (max_y + offset) / size + 1;
+        auto region_idx = [&](Loc loc) { return ((loc.y + offset) / size) * nx + (loc.x + offset) / size; };
+
+        std::vector<RefineRegion> regions(nx * ny);
+        for (int ry = 0; ry < ny; ry++) {
+            for (int rx = 0; rx < nx; rx++) {
+                auto &r = regions.at(ry * nx + rx);
+                r.x0 = rx * size - offset;
+                r.y0 = ry * size - offset;
+                r.x1 = r.x0 + size - 1;
+                r.y1 = r.y0 + size - 1;
+                r.rng.rngseed(ctx->rng64());
+            }
+        }
+        for (auto cell : cells) {
+            if (std::get<1>(bel_types.at(cell->type)) < cfg.minBelsForGridPick)
+                continue;
+            regions.at(region_idx(ctx->getBelLocation(cell->bel))).cells.push_back(cell);
+        }
+
+        net_shared.resize(net_by_udata.size());
+        ctx->batchUiReload = true;
+        for (int group = 0; group < 4; group++) {
+            auto is_active = [&](int idx) { return (((idx % nx) & 1) | (((idx / nx) & 1) << 1)) == group; };
+            std::vector<RefineRegion *> active;
+            for (int i = 0; i < int(regions.size()); i++)
+                if (is_active(i) && !regions.at(i).cells.empty())
+                    active.push_back(&regions.at(i));
+            if (active.empty())
+                continue;
+
+            std::vector<decltype(NetInfo::udata)> shared;
+            for (size_t i = 0; i < net_by_udata.size(); i++) {
+                NetInfo *ni = net_by_udata.at(i);
+                net_shared[i] = false;
+                if (ignore_net(ni))
+                    continue;
+                int owner = -1;
+                auto visit = [&](CellInfo *ci) {
+                    if (ci == nullptr || ci->bel == BelId())
+                        return;
+                    int idx = region_idx(ctx->getBelLocation(ci->bel));
+                    if (!is_active(idx))
+                        return;
+                    if (owner == -1)
+                        owner = idx;
+                    else if (owner != idx)
+                        net_shared[i] = true;
+                };
+                visit(ni->driver.cell);
+                for (auto &usr : ni->users) {
+                    if (net_shared[i])
+                        break;
+                    visit(usr.cell);
+                }
+                if (net_shared[i])
+                    shared.push_back(i);
+            }
+
+            int group_threads = std::min<int>(refine_mc.size(), active.size());
+            for (int t = 0; t < group_threads; t++) {
+                refine_mc.at(t).reset(this);
+                refine_mc.at(t).new_net_bounds = net_bounds;
+            }
+            std::atomic<int> next_region(0);
+            auto worker = [&](int t) {
+                MoveChangeData &mc = refine_mc.at(t);
+                int i;
+                while ((i = next_region++) < int(active.size())) {
+                    RefineRegion &r = *active.at(i);
+                    for (int m = 0; m < 15; ++m) {
+                        for (auto cell : r.cells) {
+                            BelId try_bel = random_bel_for_cell(cell, -1, &r);
+                            if (try_bel != BelId() && try_bel != cell->bel)
+                                try_swap_position(cell, try_bel, mc, &r);
+                        }
+                    }
+                }
+            };
+            ThreadPool::TaskGroup workers(ctx->threadPool());
+            for (int t = 1; t < group_threads; t++)
+                workers.run([&worker, t]() { worker(t); });
+            worker(0);
+            workers.wait();
+
+            // Bring the shared nets up to date with the moves made in all regions
+            for (auto n : shared) {
+                NetInfo *ni = net_by_udata.at(n);
+                net_bounds[n] = get_net_bounds(ni);
+                tmg_dirty[n] = true;
+                if (cfg.timing_driven && int(ni->users.size()) < cfg.timingFanoutThresh)
+                    for (size_t i = 0; i < ni->users.size(); i++)
+                        net_arc_tcost[n][i] = get_timing_cost(ni, i);
+            }
+        }
+        ctx->batchUiReload = false;
+        ctx->refreshUi();
+
+        for (auto &r : regions) {
+            n_move += r.n_move;
+            n_accept += r.n_accept;
+        }
+        curr_wirelen_cost = total_wirelen_cost();
+        curr_timing_cost = total_timing_cost();
+        // The serial moves that follow start from the updated bounds
+        moveChange.reset(this);
+        moveChange.new_net_bounds = net_bounds;
+    }
+
     // Return true if a net is to be entirely ignored
     inline bool ignore_net(NetInfo *net)
     {
@@ -825,11 +1018,10 @@ class SAPlacer
             double delay = ctx->getDelayNS(ctx->predictDelay(net, net->users.at(user)));
             return std::min(10.0, std::exp(delay - ctx->getDelayNS(net->users.at(user).budget) / 10));
         } else {
-            auto crit = net_crit.find(net->name);
-            if (crit == net_crit.end() || crit->second.criticality.empty())
+            if (!net_crit.has(net))
                 return 0;
             double delay = ctx->getDelayNS(ctx->predictDelay(net, net->users.at(user)));
-            return delay * std::pow(crit->second.criticality.at(user), crit_exp);
+            return delay * std::pow(net_crit.arc_criticality(net, user), crit_exp);
         }
     }
 
@@ -842,8 +1034,39 @@ class SAPlacer
                 continue;
             net_bounds[ni->udata] = get_net_bounds(ni);
             if (cfg.timing_driven && int(ni->users.size()) < cfg.timingFanoutThresh)
-                for (size_t i = 0; i < ni->users.size(); i++)
+                for (size_t i = 0; i < ni->users.size(); i++) {
                     net_arc_tcost[ni->udata][i] = get_timing_cost(ni, i);
+                    net_arc_delay[ni->udata][i] = ctx->getDelayNS(ctx->predictDelay(ni, ni->users.at(i)));
+                }
+            tmg_dirty[ni->udata] = false;
+        }
+    }
+
+    // Bring criticalities and timing costs up to date with the moves accepted since the last update. Only the nets
+    // touched by those moves are re-timed in the timing graph and have their arc delays predicted again; the arc costs
+    // of all other nets are rescaled from their cached delays, as the criticalities of the whole design may shift.
+    void update_timing_costs()
+    {
+        for (size_t n = 0; n < net_by_udata.size(); n++)
+            if (tmg_dirty[n])
+                tmg.mark_dirty(net_by_udata[n]);
+        tmg.get_criticalities(&net_crit);
+        for (size_t n = 0; n < net_by_udata.size(); n++) {
+            NetInfo *ni = net_by_udata[n];
+            bool dirty = tmg_dirty[n];
+            tmg_dirty[n] = false;
+            if (ignore_net(ni) || int(ni->users.size()) >= cfg.timingFanoutThresh)
+                continue;
+            int cc;
+            if (ctx->getPortTimingClass(ni->driver.cell, ni->driver.port, cc) == TMG_IGNORE || !net_crit.has(ni)) {
+                std::fill(net_arc_tcost[n].begin(), net_arc_tcost[n].end(), 0);
+                continue;
+            }
+            for (size_t i = 0; i < ni->users.size(); i++) {
+                if (dirty)
+                    net_arc_delay[n][i] = ctx->getDelayNS(ctx->predictDelay(ni, ni->users.at(i)));
+                net_arc_tcost[n][i] = net_arc_delay[n][i] * std::pow(net_crit.arc_criticality(ni, i), crit_exp);
+            }
         }
     }
 
@@ -882,6 +1105,8 @@ class SAPlacer
 
         std::vector<decltype(NetInfo::udata)> bounds_changed_nets_x, bounds_changed_nets_y;
         std::vector<std::pair<decltype(NetInfo::udata), size_t>> changed_arcs;
+        // Every net with a moved cell on it, possibly more than once, to mark for timing once the move is accepted
+        std::vector<decltype(NetInfo::udata)> moved_nets;
 
         std::vector<BoundChangeType> already_bounds_changed_x, already_bounds_changed_y;
         std::vector<std::vector<bool>> already_changed_arcs;
@@ -892,6 +1117,9 @@ class SAPlacer
         wirelen_t wirelen_delta = 0;
         double timing_delta = 0;
 
+        // Used by a parallel refinement worker, nets shared with other regions are left out of the costs
+        bool local_only = false;
+
         void init(SAPlacer *p)
         {
             already_bounds_changed_x.resize(p->ctx->nets.size());
@@ -918,6 +1146,7 @@ class SAPlacer
             bounds_changed_nets_x.clear();
             bounds_changed_nets_y.clear();
             changed_arcs.clear();
+            moved_nets.clear();
             new_arc_costs.clear();
             wirelen_delta = 0;
             timing_delta = 0;
@@ -936,6 +1165,9 @@ class SAPlacer
                 continue;
             if (ignore_net(pn))
                 continue;
+            if (mc.local_only && net_shared[pn->udata])
+                continue;
+            mc.moved_nets.push_back(pn->udata);
             BoundingBox &curr_bounds = mc.new_net_bounds[pn->udata];
             // Incremental bounding box updates
             // Note that everything other than full updates are applied immediately rather than being queued,
@@ -1109,7 +1341,7 @@ class SAPlacer
         }
     }
 
-    void commit_cost_changes(MoveChangeData &md)
+    void commit_cost_changes(MoveChangeData &md, bool update_totals = true)
     {
         for (const auto &bc : md.bounds_changed_nets_x)
             net_bounds[bc] = md.new_net_bounds[bc];
@@ -1117,8 +1349,12 @@ class SAPlacer
             net_bounds[bc] = md.new_net_bounds[bc];
         for (const auto &tc : md.new_arc_costs)
             net_arc_tcost[tc.first.first].at(tc.first.second) = tc.second;
-        curr_wirelen_cost += md.wirelen_delta;
-        curr_timing_cost += md.timing_delta;
+        for (auto n : md.moved_nets)
+            tmg_dirty[n] = true;
+        if (update_totals) {
+            curr_wirelen_cost += md.wirelen_delta;
+            curr_timing_cost += md.timing_delta;
+        }
     }
     // Build the cell port -> user index
     void build_port_index()
@@ -1135,23 +1371,41 @@ class SAPlacer
     // Simple routeability driven placement
     const int large_cell_thresh = 50;
     int total_net_share = 0;
-    std::vector<std::vector<std::unordered_map<IdString, int>>> nets_by_tile;
+    // Number of cells in each tile using each net, as (net udata, count) pairs; a tile only sees a few nets, so a
+    // short inline array is cheaper to search and update than a hash map
+    typedef boost::container::small_vector<std::pair<int, int>, 8> TileNets;
+    std::vector<TileNets> nets_by_tile;
+    TileNets &tile_nets(Loc loc) { return nets_by_tile.at(loc.x * (max_y + 1) + loc.y); }
+
+    static int &tile_net_count(TileNets &tn, int net)
+    {
+        for (auto &entry : tn)
+            if (entry.first == net)
+                return entry.second;
+        tn.emplace_back(net, 0);
+        return tn.back().second;
+    }
+
+    // Whether a port's net counts towards net sharing
+    bool is_shared_net(const PortInfo &port)
+    {
+        return port.net != nullptr && port.net->driver.cell != nullptr &&
+               !ctx->getBelGlobalBuf(port.net->driver.cell->bel);
+    }
+
     void setup_nets_by_tile()
     {
         total_net_share = 0;
-        nets_by_tile.resize(max_x + 1, std::vector<std::unordered_map<IdString, int>>(max_y + 1));
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
+        nets_by_tile.assign((max_x + 1) * (max_y + 1), TileNets());
+        for (auto &cell : ctx->cells) {
+            CellInfo *ci = cell.second.get();
             if (int(ci->ports.size()) > large_cell_thresh)
                 continue;
-            Loc loc = ctx->getBelLocation(ci->bel);
-            auto &nbt = nets_by_tile.at(loc.x).at(loc.y);
+            auto &nbt = tile_nets(ctx->getBelLocation(ci->bel));
             for (const auto &port : ci->ports) {
-                if (port.second.net == nullptr)
-                    continue;
-                if (port.second.net->driver.cell == nullptr || ctx->getBelGlobalBuf(port.second.net->driver.cell->bel))
+                if (!is_shared_net(port.second))
                     continue;
-                int &s = nbt[port.second.net->name];
+                int &s = tile_net_count(nbt, port.second.net->udata);
                 if (s > 0)
                     ++total_net_share;
                 ++s;
@@ -1164,20 +1418,26 @@ class SAPlacer
         if (int(ci->ports.size()) > large_cell_thresh)
             return 0;
         int loss = 0, gain = 0;
-        auto &nbt_old = nets_by_tile.at(old_loc.x).at(old_loc.y);
-        auto &nbt_new = nets_by_tile.at(new_loc.x).at(new_loc.y);
+        auto &nbt_old = tile_nets(old_loc);
+        auto &nbt_new = tile_nets(new_loc);
 
         for (const auto &port : ci->ports) {
-            if (port.second.net == nullptr)
+            if (!is_shared_net(port.second))
                 continue;
-            if (port.second.net->driver.cell == nullptr || ctx->getBelGlobalBuf(port.second.net->driver.cell->bel))
-                continue;
-            int &o = nbt_old[port.second.net->name];
+            int net = port.second.net->udata;
+            int &o = tile_net_count(nbt_old, net);
             --o;
             NPNR_ASSERT(o >= 0);
-            if (o > 0)
+            if (o > 0) {
                 ++loss;
-            int &n = nbt_new[port.second.net->name];
+            } else {
+                // Drop the entry, so that each tile only holds the nets it currently uses
+                auto it = std::find_if(nbt_old.begin(), nbt_old.end(),
+                                       [net](const std::pair<int, int> &entry) { return entry.first == net; });
+                *it = nbt_old.back();
+                nbt_old.pop_back();
+            }
+            int &n = tile_net_count(nbt_new, net);
             if (n > 0)
                 ++gain;
             ++n;
@@ -1193,10 +1453,21 @@ class SAPlacer
         return lambda * curr_timing_cost + (1 - lambda) * curr_wirelen_cost - cfg.netShareWeight * total_net_share;
     }
 
+    // Per-thread move data for parallel refinement, and nets spanning more than one region being moved
+    std::vector<MoveChangeData> refine_mc;
+    std::vector<bool> net_shared;
+
     // Map nets to their bounding box (so we can skip recompute for moves that do not exceed the bounds
     std::vector<BoundingBox> net_bounds;
     // Map net arcs to their timing cost (criticality * delay ns)
     std::vector<std::vector<double>> net_arc_tcost;
+    // Predicted delay in ns of each net arc, as of the last timing update
+    std::vector<std::vector<double>> net_arc_delay;
+    // Nets that accepted moves have changed since the last timing update. A char per net rather than a bit, as the
+    // parallel refinement workers each mark their own nets
+    std::vector<char> tmg_dirty;
+    // Set when legalisation has moved cells outside of the moves, so costs and the timing graph must be rebuilt
+    bool legalised = false;
 
     // Fast lookup for cell port to net user index
     std::unordered_map<const PortInfo *, size_t> fast_port_to_user;
@@ -1209,6 +1480,7 @@ class SAPlacer
     NetCriticalityMap net_crit;
 
     Context *ctx;
+    TimingAnalyser tmg;
     float temp = 10;
     float crit_exp = 8;
     float lambda = 0.5;
@@ -1238,6 +1510,9 @@ Placer1Cfg::Placer1Cfg(Context *ctx)
     slack_redist_iter = ctx->setting<int>("slack_redist_iter");
     hpwl_scale_x = 1;
     hpwl_scale_y = 1;
+    parallelRefine = ctx->setting<bool>("placer1/parallelRefine", true);
+    parallelRefineRegion = std::max(4, ctx->setting<int>("placer1/parallelRefineRegion", 16));
+    threads = std::max(1, ctx->setting<int>("threads", std::max<int>(1, std::thread::hardware_concurrency())));
 }
 
 bool placer1(Context *ctx, Placer1Cfg cfg)
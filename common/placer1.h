@@ -35,6 +35,11 @@ struct Placer1Cfg
     bool timing_driven;
     int slack_redist_iter;
     int hpwl_scale_x, hpwl_scale_y;
+    // Run refinement, and annealing once the move diameter is small, as independent moves inside disjoint grid
+    // regions, with this region size in tiles
+    bool parallelRefine;
+    int parallelRefineRegion;
+    int threads;
 };
 
 extern bool placer1(Context *ctx, Placer1Cfg cfg);
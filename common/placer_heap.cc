@@ -36,20 +36,32 @@
 #include "placer_heap.h"
 #include <Eigen/Core>
 #include <Eigen/IterativeLinearSolvers>
+#include <atomic>
 #include <boost/optional.hpp>
-#include <boost/thread.hpp>
 #include <chrono>
+#include <cmath>
 #include <deque>
 #include <fstream>
+#include <limits>
+#include <map>
 #include <numeric>
 #include <queue>
+#include <set>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
+#include "checkpoint.h"
+#include "json_frontend.h"
 #include "log.h"
+#include "mem_account.h"
 #include "nextpnr.h"
+#include "perf_report.h"
 #include "place_common.h"
 #include "placer1.h"
+#include "placer_heap_gpu.h"
+#include "thread_pool.h"
 #include "timing.h"
+#include "trace.h"
 #include "util.h"
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -66,6 +78,18 @@ template <typename T> struct EquationSystem
         rhs.resize(rows);
     }
 
+    // Resize for a new set of cells, keeping allocations if the size is unchanged
+    void resize(size_t rows, size_t cols)
+    {
+        if (A.size() != cols || rhs.size() != rows) {
+            A.clear();
+            A.resize(cols);
+            rhs.resize(rows);
+            mat_valid = false;
+        }
+        reset();
+    }
+
     // Simple sparse format, easy to convert to CCS for solver
     std::vector<std::vector<std::pair<int, T>>> A; // col -> (row, x[row, col]) sorted by row
     std::vector<T> rhs;                            // RHS vector
@@ -97,16 +121,45 @@ template <typename T> struct EquationSystem
 
     void add_rhs(int row, T val) { rhs[row] += val; }
 
-    void solve(std::vector<T> &x, float tolerance)
+    // The system is symmetric, so each column of A is also a row of the matrix. A row-major matrix lets Eigen
+    // run the matrix-vector products in the CG solver in parallel when built with OpenMP.
+    typedef Eigen::SparseMatrix<T, Eigen::RowMajor> Matrix;
+    Matrix mat;
+    bool mat_valid = false;
+    Eigen::ConjugateGradient<Matrix, Eigen::Lower | Eigen::Upper, Eigen::IdentityPreconditioner> cg_none;
+    Eigen::ConjugateGradient<Matrix, Eigen::Lower | Eigen::Upper, Eigen::DiagonalPreconditioner<T>> cg_jacobi;
+    Eigen::ConjugateGradient<Matrix, Eigen::Lower | Eigen::Upper, Eigen::IncompleteCholesky<T>> cg_ichol;
+    // The device copy of mat, for PlacerHeapCfg::gpuSolver; not used again once the device has failed
+    std::unique_ptr<HeapGpuSolver> gpu;
+    bool gpu_failed = false;
+
+    // Update the persistent matrix from A. If the sparsity pattern is the same as last time, the values are updated
+    // in place, which is the common case when only weights have changed; returns true if it had to be rebuilt.
+    bool update_matrix()
     {
-        using namespace Eigen;
-        if (x.empty())
-            return;
-        NPNR_ASSERT(x.size() == A.size());
-
-        VectorXd vx(x.size()), vb(rhs.size());
-        SparseMatrix<T> mat(A.size(), A.size());
+        if (mat_valid) {
+            const auto *outer = mat.outerIndexPtr();
+            const auto *inner = mat.innerIndexPtr();
+            bool same_pattern = true;
+            for (int col = 0; col < int(A.size()) && same_pattern; col++) {
+                auto &Ac = A.at(col);
+                if (outer[col + 1] - outer[col] != int(Ac.size()))
+                    same_pattern = false;
+                for (int i = 0; i < int(Ac.size()) && same_pattern; i++)
+                    if (inner[outer[col] + i] != Ac.at(i).first)
+                        same_pattern = false;
+            }
+            if (same_pattern) {
+                T *values = mat.valuePtr();
+                for (int col = 0; col < int(A.size()); col++)
+                    for (int i = 0; i < int(A.at(col).size()); i++)
+                        values[outer[col] + i] = A.at(col).at(i).second;
+                return false;
+            }
+        }
 
+        mat.resize(A.size(), A.size());
+        mat.setZero();
         std::vector<int> colnnz;
         for (auto &Ac : A)
             colnnz.push_back(int(Ac.size()));
@@ -114,7 +167,45 @@ template <typename T> struct EquationSystem
         for (int col = 0; col < int(A.size()); col++) {
             auto &Ac = A.at(col);
             for (auto &el : Ac)
-                mat.insert(el.first, col) = el.second;
+                mat.insert(col, el.first) = el.second;
+        }
+        mat.makeCompressed();
+        mat_valid = true;
+        return true;
+    }
+
+    template <typename Solver>
+    void run_solver(Solver &solver, bool rebuilt, float tolerance, const Eigen::VectorXd &vb, Eigen::VectorXd &vx)
+    {
+        solver.setTolerance(tolerance);
+        // The symbolic analysis (for the preconditioners that need one) can be kept if the pattern hasn't changed
+        if (rebuilt)
+            solver.analyzePattern(mat);
+        solver.factorize(mat);
+        vx = solver.solveWithGuess(vb, vx);
+    }
+
+    void solve(std::vector<T> &x, float tolerance, PlacerHeapCfg::SolverPreconditioner precond, bool use_gpu)
+    {
+        using namespace Eigen;
+        if (x.empty())
+            return;
+        NPNR_ASSERT(x.size() == A.size());
+
+        VectorXd vx(x.size()), vb(rhs.size());
+        bool rebuilt = update_matrix();
+
+        if (use_gpu && !gpu_failed) {
+            if (!gpu)
+                gpu.reset(new HeapGpuSolver());
+            gpu->set_matrix(int(mat.rows()), mat.outerIndexPtr(), mat.innerIndexPtr(), mat.valuePtr(), rebuilt);
+            // The same iteration limit as Eigen
+            bool jacobi = precond != PlacerHeapCfg::PRECOND_NONE;
+            if (gpu->solve(rhs.data(), x.data(), tolerance, 2 * int(x.size()), jacobi))
+                return;
+            log_warning("HeAP GPU solver failed, using Eigen from now on.\n");
+            gpu_failed = true;
+            gpu.reset();
         }
 
         for (int i = 0; i < int(x.size()); i++)
@@ -122,54 +213,98 @@ template <typename T> struct EquationSystem
         for (int i = 0; i < int(rhs.size()); i++)
             vb[i] = rhs.at(i);
 
-        ConjugateGradient<SparseMatrix<T>, Lower | Upper> solver;
-        solver.setTolerance(tolerance);
-        VectorXd xr = solver.compute(mat).solveWithGuess(vb, vx);
+        switch (precond) {
+        case PlacerHeapCfg::PRECOND_NONE:
+            run_solver(cg_none, rebuilt, tolerance, vb, vx);
+            break;
+        case PlacerHeapCfg::PRECOND_JACOBI:
+            run_solver(cg_jacobi, rebuilt, tolerance, vb, vx);
+            break;
+        case PlacerHeapCfg::PRECOND_ICHOL:
+            run_solver(cg_ichol, rebuilt, tolerance, vb, vx);
+            break;
+        }
         for (int i = 0; i < int(x.size()); i++)
-            x.at(i) = xr[i];
+            x.at(i) = vx[i];
         // for (int i = 0; i < int(x.size()); i++)
         //    log_info("x[%d] = %f\n", i, x.at(i));
     }
 };
 
+void update_criticalities(Context *ctx, const PlacerHeapCfg &cfg, NetCriticalityMap *net_crit)
+{
+    // HeAP doesn't use the udata of nets itself, so gives them the dense index net_crit is keyed by
+    assign_net_udata(ctx);
+    if (cfg.minCriticality > 0)
+        get_critical_arcs(ctx, net_crit, cfg.minCriticality);
+    else
+        get_criticalities(ctx, net_crit);
+}
+
+// Load the bel locations of a placed JSON design or checkpoint of the same chip, keyed by cell name
+bool load_reference_locs(Context *ctx, const std::string &filename,
+                         std::unordered_map<IdString, std::pair<IdString, Loc>> &locs)
+{
+    std::ifstream f(filename, std::ios::binary);
+    if (!f)
+        return false;
+    char first = 0;
+    f >> first;
+    f.seekg(0);
+    std::unique_ptr<Context> ref(new Context(ctx->archArgs()));
+    bool loaded = (first == '{') ? parse_json(f, filename, ref.get()) : load_checkpoint(filename, ref.get());
+    if (!loaded)
+        return false;
+    locs.clear();
+    for (auto &cell : ref->cells) {
+        CellInfo *rc = cell.second.get();
+        if (rc->bel == BelId())
+            continue;
+        locs[ctx->id(rc->name.str(ref.get()))] = std::make_pair(ctx->id(rc->type.str(ref.get())),
+                                                                ref->getBelLocation(rc->bel));
+    }
+    if (locs.empty())
+        log_warning("HeAP reference '%s' has no placed cells.\n", filename.c_str());
+    return true;
+}
+
 } // namespace
 
 class HeAPPlacer
 {
   public:
-    HeAPPlacer(Context *ctx, PlacerHeapCfg cfg) : ctx(ctx), cfg(cfg) { Eigen::initParallel(); }
+    HeAPPlacer(Context *ctx, PlacerHeapCfg cfg) : ctx(ctx), cfg(cfg), esx(0, 0), esy(0, 0)
+    {
+        Eigen::initParallel();
+        // The x and y systems are solved concurrently, so share the threads between them
+        Eigen::setNbThreads(std::max(1, cfg.threads / 2));
+    }
 
     bool place()
     {
         auto startt = std::chrono::high_resolution_clock::now();
 
         ctx->lock();
+        index_cells();
         place_constraints();
         build_fast_bels();
         seed_placement();
+        if (place_cells.empty()) {
+            // Everything was placed beforehand, e.g. by an incremental run
+            ctx->unlock();
+            log_info("All cells are already placed, skipping analytic placement.\n");
+            return true;
+        }
+        bool warm_start = !cfg.referenceLocs.empty();
+        if (warm_start)
+            seed_from_reference();
         update_all_chains();
+        build_hpwl_nets();
+        setup_star_nets();
         wirelen_t hpwl = total_hpwl();
-        log_info("Creating initial analytic placement for %d cells, random placement wirelen = %d.\n",
-                 int(place_cells.size()), int(hpwl));
-        for (int i = 0; i < 4; i++) {
-            setup_solve_cells();
-            auto solve_startt = std::chrono::high_resolution_clock::now();
-            boost::thread xaxis([&]() { build_solve_direction(false, -1); });
-            build_solve_direction(true, -1);
-            xaxis.join();
-            auto solve_endt = std::chrono::high_resolution_clock::now();
-            solve_time += std::chrono::duration<double>(solve_endt - solve_startt).count();
-
-            update_all_chains();
-
-            hpwl = total_hpwl();
-            log_info("    at initial placer iter %d, wirelen = %d\n", i, int(hpwl));
-        }
-
-        wirelen_t solved_hpwl = 0, spread_hpwl = 0, legal_hpwl = 0, best_hpwl = std::numeric_limits<wirelen_t>::max();
-        int iter = 0, stalled = 0;
-
-        std::vector<std::tuple<CellInfo *, BelId, PlaceStrength>> solution;
+        if (!warm_start)
+            log_info("Creating initial analytic placement for %d cells, random placement wirelen = %d.\n",
+                     int(place_cells.size()), int(hpwl));
 
         std::vector<std::unordered_set<IdString>> heap_runs;
         std::unordered_set<IdString> all_celltypes;
@@ -182,6 +317,30 @@ class HeAPPlacer
             }
             ct_count[cell->type]++;
         }
+
+        // The number of spreading rounds already done by the multilevel placement, which the anchor weights of the
+        // main loop carry on from
+        int ml_rounds = 0;
+        if (warm_start)
+            ml_rounds = cfg.referenceRounds;
+        else if (cfg.multilevel > 0)
+            ml_rounds = place_multilevel(all_celltypes);
+        if (ml_rounds == 0) {
+            for (int i = 0; i < 4; i++) {
+                setup_solve_cells();
+                solve_xy(-1);
+                update_all_chains();
+
+                hpwl = total_hpwl();
+                log_info("    at initial placer iter %d, wirelen = %d\n", i, int(hpwl));
+            }
+        }
+        account_memory();
+
+        wirelen_t solved_hpwl = 0, spread_hpwl = 0, legal_hpwl = 0, best_hpwl = std::numeric_limits<wirelen_t>::max();
+        int iter = 0, stalled = 0;
+
+        std::vector<std::tuple<CellInfo *, BelId, PlaceStrength>> solution;
         // If more than 98% of cells are one cell type, always solve all at once
         // Otherwise, follow full HeAP strategy of rotate&all
         for (auto &c : ct_count)
@@ -190,7 +349,7 @@ class HeAPPlacer
                 break;
             }
 
-        if (cfg.placeAllAtOnce) {
+        if (cfg.placeAllAtOnce || warm_start) {
             // Never want to deal with LUTs, FFs, MUXFxs seperately,
             // for now disable all single-cell-type runs and only have heteregenous
             // runs
@@ -200,7 +359,7 @@ class HeAPPlacer
         heap_runs.push_back(all_celltypes);
         // The main HeAP placer loop
         log_info("Running main analytical placer.\n");
-        while (stalled < 5 && (solved_hpwl <= legal_hpwl * 0.8)) {
+        while (stalled < 5 && (solved_hpwl <= legal_hpwl * 0.8) && (!warm_start || iter < cfg.referenceIters)) {
             // Alternate between particular Bel types and all bels
             for (auto &run : heap_runs) {
                 auto run_startt = std::chrono::high_resolution_clock::now();
@@ -208,35 +367,20 @@ class HeAPPlacer
                 setup_solve_cells(&run);
                 if (solve_cells.empty())
                     continue;
-                // Heuristic: don't bother with threading below a certain size
-                auto solve_startt = std::chrono::high_resolution_clock::now();
-
-                if (solve_cells.size() < 500) {
-                    build_solve_direction(false, (iter == 0) ? -1 : iter);
-                    build_solve_direction(true, (iter == 0) ? -1 : iter);
-                } else {
-                    boost::thread xaxis([&]() { build_solve_direction(false, (iter == 0) ? -1 : iter); });
-                    build_solve_direction(true, (iter == 0) ? -1 : iter);
-                    xaxis.join();
-                }
-                auto solve_endt = std::chrono::high_resolution_clock::now();
-                solve_time += std::chrono::duration<double>(solve_endt - solve_startt).count();
+                solve_xy((iter + ml_rounds == 0) ? -1 : iter + ml_rounds);
                 update_all_chains();
                 solved_hpwl = total_hpwl();
 
                 update_all_chains();
 
-                for (const auto &group : cfg.cellGroups)
-                    CutSpreader(this, group).run();
-
-                for (auto type : sorted(run))
-                    if (std::all_of(cfg.cellGroups.begin(), cfg.cellGroups.end(),
-                                    [type](const std::unordered_set<IdString> &grp) { return !grp.count(type); }))
-                        CutSpreader(this, {type}).run();
-
+                spread_types(run);
                 update_all_chains();
                 spread_hpwl = total_hpwl();
+                if (cfg.routabilityRatio > 0)
+                    update_cell_inflation();
+                PerfScope legalise_scope("legalise");
                 legalise_placement_strict(true);
+                legalise_scope.stop();
                 update_all_chains();
 
                 legal_hpwl = total_hpwl();
@@ -248,7 +392,7 @@ class HeAPPlacer
             }
 
             if (cfg.timing_driven)
-                get_criticalities(ctx, &net_crit);
+                update_criticalities(ctx, cfg, &net_crit);
 
             if (legal_hpwl < best_hpwl) {
                 best_hpwl = legal_hpwl;
@@ -262,10 +406,11 @@ class HeAPPlacer
                 ++stalled;
             }
             for (auto &cl : cell_locs) {
-                cl.second.legal_x = cl.second.x;
-                cl.second.legal_y = cl.second.y;
+                cl.legal_x = cl.x;
+                cl.legal_y = cl.y;
             }
             ctx->yield();
+            account_memory();
             ++iter;
         }
 
@@ -297,6 +442,9 @@ class HeAPPlacer
         log_info("HeAP Placer Time: %.02fs\n", std::chrono::duration<double>(endtt - startt).count());
         log_info("  of which solving equations: %.02fs\n", solve_time);
         log_info("  of which spreading cells: %.02fs\n", cl_time);
+        if (cl_thread_time.size() > 1)
+            for (size_t i = 0; i < cl_thread_time.size(); i++)
+                log_info("    spreading thread %d: %.02fs\n", int(i), cl_thread_time.at(i));
         log_info("  of which strict legalisation: %.02fs\n", sl_time);
 
         ctx->check();
@@ -315,7 +463,55 @@ class HeAPPlacer
     PlacerHeapCfg cfg;
 
     int max_x = 0, max_y = 0;
-    std::vector<std::vector<std::vector<std::vector<BelId>>>> fast_bels;
+
+    struct BelRange
+    {
+        const BelId *b, *e;
+        const BelId *begin() const { return b; }
+        const BelId *end() const { return e; }
+    };
+
+    // The available bels of one type by location, in one contiguous array: the bels in tile (x, y) are bels[start[i]]
+    // up to bels[start[i + 1]], where i = x * height + y
+    struct FastBelGrid
+    {
+        int width = 0, height = 0;
+        std::vector<int> start;
+        std::vector<BelId> bels;
+        // Number of bels in the tiles left of x and below y, at x * (height + 1) + y
+        std::vector<int> prefix;
+
+        int count(int x, int y) const
+        {
+            if (x < 0 || y < 0 || x >= width || y >= height)
+                return 0;
+            int i = x * height + y;
+            return start[i + 1] - start[i];
+        }
+
+        // Number of bels in the tiles x0..x1, y0..y1 (inclusive)
+        int count(int x0, int y0, int x1, int y1) const
+        {
+            x0 = std::max(x0, 0);
+            y0 = std::max(y0, 0);
+            x1 = std::min(x1, width - 1);
+            y1 = std::min(y1, height - 1);
+            if (x0 > x1 || y0 > y1)
+                return 0;
+            int h = height + 1;
+            return prefix[(x1 + 1) * h + y1 + 1] - prefix[x0 * h + y1 + 1] - prefix[(x1 + 1) * h + y0] +
+                   prefix[x0 * h + y0];
+        }
+
+        BelRange at(int x, int y) const
+        {
+            if (count(x, y) == 0)
+                return BelRange{nullptr, nullptr};
+            int i = x * height + y;
+            return BelRange{bels.data() + start[i], bels.data() + start[i + 1]};
+        }
+    };
+    std::vector<FastBelGrid> fast_bels;
     std::unordered_map<IdString, std::tuple<int, int>> bel_types;
 
     // For fast handling of heterogeneosity during initial placement without full legalisation,
@@ -337,12 +533,19 @@ class HeAPPlacer
     // structure instead
     struct CellLocation
     {
-        int x, y;
-        int legal_x, legal_y;
-        double rawx, rawy;
-        bool locked, global;
+        int x = 0, y = 0;
+        int legal_x = 0, legal_y = 0;
+        double rawx = 0, rawy = 0;
+        bool locked = false, global = false;
+        // Cells only get a location once seeded, or once their chain root has one
+        bool valid = false;
     };
-    std::unordered_map<IdString, CellLocation> cell_locs;
+    // All cells, by the dense index HeAP stores in their udata for the duration of placement; the per-cell
+    // structures below are indexed the same way
+    std::vector<CellInfo *> cells_by_index;
+    std::vector<CellLocation> cell_locs;
+    // The row of each cell in the equations currently being solved, or dont_solve
+    std::vector<int> solve_row;
     // The set of cells that we will actually place. This excludes locked cells and children cells of macros/chains
     // (only the root of each macro is placed.)
     std::vector<CellInfo *> place_cells;
@@ -351,16 +554,55 @@ class HeAPPlacer
     // cells of a certain type)
     std::vector<CellInfo *> solve_cells;
 
+    // With cfg.regionSolve, the solve_cells are split by region constraint into parts that are solved as separate
+    // systems of equations. Cells of other parts are fixed at their current position in the equations of a part
+    struct SolvePart
+    {
+        int id;
+        // Rows of solve_cells in this part, in order
+        std::vector<int> rows;
+        // Nets with a pin in this part
+        std::vector<NetInfo *> nets;
+        EquationSystem<double> esx{0, 0}, esy{0, 0};
+    };
+    std::deque<SolvePart> solve_parts;
+    // The part, and row within it, of each row of solve_cells
+    std::vector<int> row_part, part_row;
+    // Cell positions at the start of the solve, which the parts being solved concurrently read for each other's cells
+    std::vector<int> frozen_x, frozen_y;
+
     // For cells in a chain, this is the ultimate root cell of the chain (sometimes this is not constr_parent
     // where chains are within chains
-    std::unordered_map<IdString, CellInfo *> chain_root;
-    std::unordered_map<IdString, int> chain_size;
+    std::vector<CellInfo *> chain_root;
+    // Number of cells of the root's type in each chain, indexed by root; 1 for other placed cells, 0 for the rest
+    std::vector<int> chain_size;
 
     // The offset from chain_root to a cell in the chain
     std::unordered_map<IdString, std::pair<int, int>> cell_offsets;
 
+    // Pins of the nets that count towards HPWL, flattened: net i has the pins from hpwl_net_start[i] up to
+    // hpwl_net_start[i + 1]. The netlist doesn't change during HeAP, so this is built once, pointing into cell_locs.
+    std::vector<int> hpwl_net_start;
+    std::vector<const CellLocation *> hpwl_pins;
+    // Pin coordinates, gathered from cell_locs at the start of each HPWL evaluation
+    std::vector<int> hpwl_pin_x, hpwl_pin_y;
+
+    // With cfg.routabilityRatio, the factor by which the cells at each location, at x * (max_y + 1) + y, count
+    // towards its utilisation when spreading; from the routing demand of the last spread placement
+    std::vector<float> cell_inflation;
+
+    // Current centre of each star net, see is_star_net
+    std::vector<double> star_x, star_y;
+
+    // Multilevel mode: the node of each entry of place_cells at every coarsening level, level 0 being the flat
+    // netlist with one node per entry, and the number of nodes at each level
+    std::vector<std::vector<int>> ml_node;
+    std::vector<int> ml_count;
+
     // Performance counting
     double solve_time = 0, cl_time = 0, sl_time = 0;
+    // Busy time of each spreading thread
+    std::vector<double> cl_thread_time;
 
     NetCriticalityMap net_crit;
 
@@ -407,43 +649,86 @@ class HeAPPlacer
         ctx->yield();
     }
 
+    // Types of the cells in the design, in a deterministic order
+    std::set<IdString> cell_types() const
+    {
+        std::set<IdString> types;
+        for (auto &cell : ctx->cells)
+            types.insert(cell.second->type);
+        return types;
+    }
+
     // Construct the fast_bels, nearest_row_with_bel and nearest_col_with_bel
     void build_fast_bels()
     {
-
+        struct AvailBel
+        {
+            int type_idx;
+            Loc loc;
+            BelId bel;
+        };
+        // Only the bel types of cells in the design are indexed
         int num_bel_types = 0;
-        for (auto bel : ctx->getBels()) {
-            IdString type = ctx->getBelType(bel);
-            if (bel_types.find(type) == bel_types.end()) {
-                bel_types[type] = std::tuple<int, int>(num_bel_types++, 1);
-            } else {
-                std::get<1>(bel_types.at(type))++;
+        std::vector<AvailBel> avail;
+        for (IdString type : cell_types()) {
+            int type_cnt = 0;
+            for (auto bel : ctx->getBelsByType(type)) {
+                type_cnt++;
+                if (!ctx->checkBelAvail(bel))
+                    continue;
+                Loc loc = ctx->getBelLocation(bel);
+                max_x = std::max(max_x, loc.x);
+                max_y = std::max(max_y, loc.y);
+                avail.push_back(AvailBel{num_bel_types, loc, bel});
+            }
+            if (type_cnt > 0)
+                bel_types[type] = std::tuple<int, int>(num_bel_types++, type_cnt);
+        }
+
+        // Counting sort of the bels of each type by tile, keeping them in getBels order within a tile
+        int width = max_x + 1, height = max_y + 1;
+        fast_bels.assign(num_bel_types, FastBelGrid());
+        for (auto &ab : avail) {
+            auto &fb = fast_bels.at(ab.type_idx);
+            if (fb.start.empty()) {
+                fb.width = width;
+                fb.height = height;
+                fb.start.assign(width * height + 1, 0);
+            }
+            ++fb.start.at(ab.loc.x * height + ab.loc.y + 1);
+        }
+        for (auto &fb : fast_bels) {
+            for (size_t i = 1; i < fb.start.size(); i++)
+                fb.start.at(i) += fb.start.at(i - 1);
+            if (!fb.start.empty())
+                fb.bels.resize(fb.start.back());
+        }
+        {
+            std::vector<std::vector<int>> next(num_bel_types);
+            for (auto &ab : avail) {
+                auto &fb = fast_bels.at(ab.type_idx);
+                auto &nt = next.at(ab.type_idx);
+                if (nt.empty())
+                    nt.assign(fb.start.begin(), fb.start.end() - 1);
+                fb.bels.at(nt.at(ab.loc.x * height + ab.loc.y)++) = ab.bel;
             }
         }
-        for (auto bel : ctx->getBels()) {
-            if (!ctx->checkBelAvail(bel))
+        for (auto &fb : fast_bels) {
+            if (fb.start.empty())
                 continue;
-            Loc loc = ctx->getBelLocation(bel);
-            IdString type = ctx->getBelType(bel);
-            int type_idx = std::get<0>(bel_types.at(type));
-            if (int(fast_bels.size()) < type_idx + 1)
-                fast_bels.resize(type_idx + 1);
-            if (int(fast_bels.at(type_idx).size()) < (loc.x + 1))
-                fast_bels.at(type_idx).resize(loc.x + 1);
-            if (int(fast_bels.at(type_idx).at(loc.x).size()) < (loc.y + 1))
-                fast_bels.at(type_idx).at(loc.x).resize(loc.y + 1);
-            max_x = std::max(max_x, loc.x);
-            max_y = std::max(max_y, loc.y);
-            fast_bels.at(type_idx).at(loc.x).at(loc.y).push_back(bel);
+            int h = height + 1;
+            fb.prefix.assign((width + 1) * h, 0);
+            for (int x = 0; x < width; x++)
+                for (int y = 0; y < height; y++)
+                    fb.prefix.at((x + 1) * h + y + 1) = fb.count(x, y) + fb.prefix.at(x * h + y + 1) +
+                                                        fb.prefix.at((x + 1) * h + y) - fb.prefix.at(x * h + y);
         }
 
         nearest_row_with_bel.resize(num_bel_types, std::vector<int>(max_y + 1, -1));
         nearest_col_with_bel.resize(num_bel_types, std::vector<int>(max_x + 1, -1));
-        for (auto bel : ctx->getBels()) {
-            if (!ctx->checkBelAvail(bel))
-                continue;
-            Loc loc = ctx->getBelLocation(bel);
-            int type_idx = std::get<0>(bel_types.at(ctx->getBelType(bel)));
+        for (auto &ab : avail) {
+            Loc loc = ab.loc;
+            int type_idx = ab.type_idx;
             auto &nr = nearest_row_with_bel.at(type_idx), &nc = nearest_col_with_bel.at(type_idx);
             // Traverse outwards through nearest_row_with_bel and nearest_col_with_bel, stopping once
             // another row/col is already recorded as being nearer
@@ -495,16 +780,349 @@ class HeAPPlacer
         }
     }
 
-    // Build and solve in one direction
-    void build_solve_direction(bool yaxis, int iter)
+    // Equation systems for each axis, kept between solves so the solver matrix can be reused
+    EquationSystem<double> esx, esy;
+
+    MemAccount mem{"heap"};
+
+    void account_memory()
+    {
+        if (!mem_account_enabled())
+            return;
+        size_t bytes = mem_usage(bel_types) + mem_usage(cell_locs) + mem_usage(place_cells) + mem_usage(solve_cells) +
+                       mem_usage(cells_by_index) + mem_usage(solve_row) + mem_usage(chain_root) +
+                       mem_usage(chain_size) + mem_usage(cell_offsets) +
+                       mem_usage(hpwl_net_start) + mem_usage(hpwl_pins) + mem_usage(hpwl_pin_x) +
+                       mem_usage(hpwl_pin_y);
+        for (auto &fb : fast_bels)
+            bytes += mem_usage(fb.start) + mem_usage(fb.bels) + mem_usage(fb.prefix);
+        for (auto es : {&esx, &esy}) {
+            bytes += mem_usage(es->A) + mem_usage(es->rhs);
+            for (auto &col : es->A)
+                bytes += mem_usage(col);
+        }
+        mem.update(bytes);
+    }
+
+    // Build and solve in one direction, for all solve_cells or one part of them
+    void build_solve_direction(bool yaxis, int iter, SolvePart *part = nullptr)
     {
+        NPNR_TRACE_SCOPE_ARG("solve", "axis", yaxis ? "y" : "x");
+        auto &es = (part != nullptr) ? (yaxis ? part->esy : part->esx) : (yaxis ? esy : esx);
+        // High fanout nets get a row for their star centre, unless they are left out of this iteration
+        size_t rows = (part != nullptr) ? part->rows.size() : solve_cells.size();
+        if (part == nullptr && (cfg.starDropIters <= 0 || iter >= cfg.starDropIters))
+            rows += star_x.size();
         for (int i = 0; i < 5; i++) {
-            EquationSystem<double> esx(solve_cells.size(), solve_cells.size());
-            build_equations(esx, yaxis, iter);
-            solve_equations(esx, yaxis);
+            es.resize(rows, rows);
+            build_equations(es, yaxis, iter, part);
+            solve_equations(es, yaxis, part);
         }
     }
 
+    // Split the solve_cells into parts by region constraint, and find the nets of each part. Cells in a chain are
+    // solved as their root, so are in the part of the root's region
+    void setup_solve_parts()
+    {
+        solve_parts.clear();
+        row_part.assign(solve_cells.size(), -1);
+        part_row.assign(solve_cells.size(), -1);
+        std::unordered_map<Region *, int> region_part;
+        for (int row = 0; row < int(solve_cells.size()); row++) {
+            auto ins = region_part.emplace(solve_cells.at(row)->region, int(solve_parts.size()));
+            if (ins.second) {
+                solve_parts.emplace_back();
+                solve_parts.back().id = ins.first->second;
+            }
+            auto &part = solve_parts.at(ins.first->second);
+            row_part.at(row) = part.id;
+            part_row.at(row) = int(part.rows.size());
+            part.rows.push_back(row);
+        }
+        std::vector<int> last_net(solve_parts.size(), -1);
+        int net_idx = 0;
+        for (auto net : sorted(ctx->nets)) {
+            NetInfo *ni = net.second;
+            ++net_idx;
+            if (ni->driver.cell == nullptr || ni->users.empty() || cell_locs[ni->driver.cell->udata].global)
+                continue;
+            foreach_port(ni, [&](PortRef &port, int user_idx) {
+                int row = solve_row[port.cell->udata];
+                if (row == dont_solve || last_net.at(row_part.at(row)) == net_idx)
+                    return;
+                last_net.at(row_part.at(row)) = net_idx;
+                solve_parts.at(row_part.at(row)).nets.push_back(ni);
+            });
+        }
+    }
+
+    // Solve both axes for the current solve_cells, concurrently unless there are only a few cells
+    void solve_xy(int iter)
+    {
+        auto solve_startt = std::chrono::high_resolution_clock::now();
+        PerfScope solve_scope("solve");
+        bool by_region = false;
+        if (cfg.regionSolve) {
+            setup_solve_parts();
+            by_region = solve_parts.size() > 1;
+        }
+        if (by_region) {
+            // Each axis of each part is an independent system, so they're all solved at once
+            frozen_x.resize(cell_locs.size());
+            frozen_y.resize(cell_locs.size());
+            for (size_t i = 0; i < cell_locs.size(); i++) {
+                frozen_x[i] = cell_locs[i].x;
+                frozen_y[i] = cell_locs[i].y;
+            }
+            ctx->threadPool().parallel_for(
+                    2 * solve_parts.size(), 1,
+                    [&](size_t i) { build_solve_direction(i % 2, iter, &solve_parts.at(i / 2)); }, cfg.threads);
+        } else if (solve_cells.size() < 500) {
+            build_solve_direction(false, iter);
+            build_solve_direction(true, iter);
+        } else {
+            ThreadPool::TaskGroup xaxis(ctx->threadPool());
+            xaxis.run([&]() {
+                NPNR_TRACE_SCOPE("heap x solve");
+                build_solve_direction(false, iter);
+            });
+            build_solve_direction(true, iter);
+            xaxis.wait();
+        }
+        solve_scope.stop();
+        auto solve_endt = std::chrono::high_resolution_clock::now();
+        solve_time += std::chrono::duration<double>(solve_endt - solve_startt).count();
+    }
+
+    // Spread the solve_cells of the given types, together with the rest of their cell group
+    void spread_types(const std::unordered_set<IdString> &run)
+    {
+        PerfScope spread_scope("spread");
+        for (const auto &group : cfg.cellGroups)
+            CutSpreader(this, group).run();
+        // Keep spread cells within the bounds of their region, as their solved positions were
+        if (cfg.regionSolve) {
+            for (auto cell : solve_cells) {
+                if (cell->region == nullptr)
+                    continue;
+                auto &cl = cell_locs[cell->udata];
+                cl.x = limit_to_reg(cell->region, cl.x, false);
+                cl.y = limit_to_reg(cell->region, cl.y, true);
+            }
+        }
+
+        for (auto type : sorted(run))
+            if (std::all_of(cfg.cellGroups.begin(), cfg.cellGroups.end(),
+                            [type](const std::unordered_set<IdString> &grp) { return !grp.count(type); }))
+                CutSpreader(this, {type}).run();
+    }
+
+    // Coarsen the netlist by heavy-edge matching of place_cells, one level at a time, until there are
+    // cfg.multilevel coarse levels or matching no longer shrinks it much
+    void coarsen()
+    {
+        // Nets with more users than this hardly tie any two of their cells together
+        const int max_fanout = 16;
+        // Bound the cells in a node, so that clusters don't snowball around well connected cells
+        const int max_node_cells = 256;
+        const int min_nodes = 64;
+
+        int n = int(place_cells.size());
+        std::vector<int> place_index(cells_by_index.size(), -1);
+        for (int i = 0; i < n; i++)
+            place_index[place_cells[i]->udata] = i;
+        ml_node.assign(1, std::vector<int>(n));
+        std::iota(ml_node.back().begin(), ml_node.back().end(), 0);
+        ml_count.assign(1, n);
+        std::vector<int> node_cells(n);
+        std::vector<Region *> node_region(n);
+        for (int i = 0; i < n; i++) {
+            node_cells[i] = std::max(1, chain_size[place_cells[i]->udata]);
+            node_region[i] = place_cells[i]->region;
+        }
+
+        std::vector<int> pins, touched;
+        std::vector<float> rating;
+        while (int(ml_node.size()) <= cfg.multilevel && ml_count.back() > min_nodes) {
+            const std::vector<int> &node = ml_node.back();
+            int count = ml_count.back();
+            // Clique model of each net between the nodes it connects
+            std::vector<std::vector<std::pair<int, float>>> adj(count);
+            for (auto net : sorted(ctx->nets)) {
+                NetInfo *ni = net.second;
+                if (ni->driver.cell == nullptr || ni->users.empty() || int(ni->users.size()) > max_fanout)
+                    continue;
+                if (cell_locs[ni->driver.cell->udata].global)
+                    continue;
+                pins.clear();
+                foreach_port(ni, [&](PortRef &port, int user_idx) {
+                    CellInfo *root = chain_root[port.cell->udata] ? chain_root[port.cell->udata] : port.cell;
+                    int pi = place_index[root->udata];
+                    if (pi != -1 && std::find(pins.begin(), pins.end(), node[pi]) == pins.end())
+                        pins.push_back(node[pi]);
+                });
+                if (pins.size() < 2)
+                    continue;
+                float w = 1.0f / (pins.size() - 1);
+                for (size_t a = 0; a < pins.size(); a++)
+                    for (size_t b = a + 1; b < pins.size(); b++) {
+                        adj[pins[a]].emplace_back(pins[b], w);
+                        adj[pins[b]].emplace_back(pins[a], w);
+                    }
+            }
+
+            // Visit nodes in random order, matching each with the unmatched neighbour of the heaviest edge per cell
+            std::vector<int> order(count);
+            std::iota(order.begin(), order.end(), 0);
+            std::random_shuffle(order.begin(), order.end(), [&](size_t sz) { return ctx->rng(int(sz)); });
+            std::vector<int> match(count, -1);
+            rating.assign(count, 0);
+            int next = 0;
+            for (int u : order) {
+                if (match[u] != -1)
+                    continue;
+                touched.clear();
+                for (auto &e : adj[u]) {
+                    if (match[e.first] != -1)
+                        continue;
+                    if (rating[e.first] == 0)
+                        touched.push_back(e.first);
+                    rating[e.first] += e.second;
+                }
+                int best = -1;
+                float best_rating = 0;
+                for (int v : touched) {
+                    float r = rating[v] / (node_cells[u] * node_cells[v]);
+                    rating[v] = 0;
+                    if (node_cells[u] + node_cells[v] > max_node_cells || node_region[u] != node_region[v])
+                        continue;
+                    if (r > best_rating) {
+                        best = v;
+                        best_rating = r;
+                    }
+                }
+                match[u] = next;
+                if (best != -1)
+                    match[best] = next;
+                ++next;
+            }
+            if (next > 0.9 * count)
+                break;
+
+            std::vector<int> coarse(n);
+            for (int i = 0; i < n; i++)
+                coarse[i] = match[node[i]];
+            std::vector<int> coarse_cells(next, 0);
+            std::vector<Region *> coarse_region(next);
+            for (int v = 0; v < count; v++) {
+                coarse_cells[match[v]] += node_cells[v];
+                coarse_region[match[v]] = node_region[v];
+            }
+            ml_node.push_back(std::move(coarse));
+            ml_count.push_back(next);
+            node_cells.swap(coarse_cells);
+            node_region.swap(coarse_region);
+        }
+    }
+
+    // Solve for one representative cell of each node of a coarsening level, moving all cells of the node to the
+    // centroid of their current locations first, which is also where the anchor of the node goes
+    void setup_level_solve(int level)
+    {
+        const std::vector<int> &node = ml_node.at(level);
+        int count = ml_count.at(level);
+        solve_cells.assign(count, nullptr);
+        std::fill(solve_row.begin(), solve_row.end(), dont_solve);
+        std::vector<double> sum_x(count, 0), sum_y(count, 0);
+        std::vector<int> members(count, 0);
+        for (size_t i = 0; i < place_cells.size(); i++) {
+            CellInfo *cell = place_cells[i];
+            if (solve_cells.at(node[i]) == nullptr)
+                solve_cells.at(node[i]) = cell;
+            solve_row[cell->udata] = node[i];
+            sum_x.at(node[i]) += cell_locs[cell->udata].rawx;
+            sum_y.at(node[i]) += cell_locs[cell->udata].rawy;
+            members.at(node[i])++;
+        }
+        for (size_t i = 0; i < chain_root.size(); i++)
+            if (chain_root[i] != nullptr)
+                solve_row[i] = solve_row[chain_root[i]->udata];
+        for (size_t i = 0; i < place_cells.size(); i++) {
+            auto &cl = cell_locs[place_cells[i]->udata];
+            cl.rawx = sum_x.at(node[i]) / members.at(node[i]);
+            cl.rawy = sum_y.at(node[i]) / members.at(node[i]);
+            cl.x = cl.legal_x = std::min(max_x, std::max(0, int(cl.rawx + 0.5)));
+            cl.y = cl.legal_y = std::min(max_y, std::max(0, int(cl.rawy + 0.5)));
+        }
+        update_all_chains();
+    }
+
+    // Move every cell of a node to where its representative was solved to
+    void propagate_level(int level)
+    {
+        const std::vector<int> &node = ml_node.at(level);
+        for (size_t i = 0; i < place_cells.size(); i++) {
+            const auto &rl = cell_locs[solve_cells.at(node[i])->udata];
+            auto &cl = cell_locs[place_cells[i]->udata];
+            cl.x = rl.x;
+            cl.y = rl.y;
+            cl.rawx = rl.rawx;
+            cl.rawy = rl.rawy;
+        }
+        update_all_chains();
+    }
+
+    // Multilevel initial placement: solve and spread the coarsest netlist, then at each finer level solve again
+    // anchored to where its nodes were spread to, and spread again. The flat netlist is solved once but not spread,
+    // which the main loop does. Returns the number of spreading rounds, or 0 if the netlist couldn't be coarsened.
+    int place_multilevel(const std::unordered_set<IdString> &all_celltypes)
+    {
+        PerfScope ml_scope("multilevel");
+        for (auto cell : place_cells) {
+            auto &cl = cell_locs[cell->udata];
+            cl.rawx = cl.x;
+            cl.rawy = cl.y;
+        }
+        coarsen();
+        int top = int(ml_node.size()) - 1;
+        if (top == 0) {
+            log_info("    netlist does not coarsen, skipping multilevel placement\n");
+            return 0;
+        }
+        log_info("    coarsened to %d levels, %d nodes at the coarsest\n", top, ml_count.at(top));
+
+        int rounds = 0;
+        for (int level = top; level >= 0; level--) {
+            int level_rounds = (level == 0) ? 1 : cfg.multilevelRefine;
+            for (int i = 0; i < level_rounds; i++) {
+                setup_level_solve(level);
+                // Like the initial placement, the coarsest level is first solved a few times without anchors
+                if (level == top && i == 0) {
+                    for (int j = 0; j < 3; j++) {
+                        solve_xy(-1);
+                        propagate_level(level);
+                        setup_level_solve(level);
+                    }
+                }
+                solve_xy((rounds == 0) ? -1 : rounds);
+                propagate_level(level);
+                wirelen_t solved_hpwl = total_hpwl();
+                if (level == 0) {
+                    log_info("    at multilevel level 0 (%d cells), wirelen solved = %d\n", ml_count.at(level),
+                             int(solved_hpwl));
+                    break;
+                }
+                setup_solve_cells();
+                spread_types(all_celltypes);
+                update_all_chains();
+                ++rounds;
+                log_info("    at multilevel level %d (%d nodes), wirelen solved = %d, spread = %d\n", level,
+                         ml_count.at(level), int(solved_hpwl), int(total_hpwl()));
+            }
+        }
+        return rounds;
+    }
+
     // Check if a cell has any meaningful connectivity
     bool has_connectivity(CellInfo *cell)
     {
@@ -516,16 +1134,29 @@ class HeAPPlacer
         return false;
     }
 
+    // Give each cell a dense index, in its udata, and size the per-cell structures
+    void index_cells()
+    {
+        cells_by_index.clear();
+        for (auto cell : sorted(ctx->cells)) {
+            cell.second->udata = int(cells_by_index.size());
+            cells_by_index.push_back(cell.second);
+        }
+        cell_locs.assign(cells_by_index.size(), CellLocation());
+        solve_row.assign(cells_by_index.size(), dont_solve);
+        chain_root.assign(cells_by_index.size(), nullptr);
+        chain_size.assign(cells_by_index.size(), 0);
+    }
+
     // Build up a random initial placement, without regard to legality
     // FIXME: Are there better approaches to the initial placement (e.g. greedy?)
     void seed_placement()
     {
         std::unordered_map<IdString, std::deque<BelId>> available_bels;
-        for (auto bel : ctx->getBels()) {
-            if (!ctx->checkBelAvail(bel))
-                continue;
-            available_bels[ctx->getBelType(bel)].push_back(bel);
-        }
+        for (IdString type : cell_types())
+            for (auto bel : ctx->getBelsByType(type))
+                if (ctx->checkBelAvail(bel))
+                    available_bels[type].push_back(bel);
         for (auto &t : available_bels) {
             std::random_shuffle(t.second.begin(), t.second.end(), [&](size_t n) { return ctx->rng(int(n)); });
         }
@@ -533,10 +1164,11 @@ class HeAPPlacer
             CellInfo *ci = cell.second;
             if (ci->bel != BelId()) {
                 Loc loc = ctx->getBelLocation(ci->bel);
-                cell_locs[cell.first].x = loc.x;
-                cell_locs[cell.first].y = loc.y;
-                cell_locs[cell.first].locked = true;
-                cell_locs[cell.first].global = ctx->getBelGlobalBuf(ci->bel);
+                cell_locs[ci->udata].valid = true;
+                cell_locs[ci->udata].x = loc.x;
+                cell_locs[ci->udata].y = loc.y;
+                cell_locs[ci->udata].locked = true;
+                cell_locs[ci->udata].global = ctx->getBelGlobalBuf(ci->bel);
             } else if (ci->constr_parent == nullptr) {
                 bool placed = false;
                 while (!placed) {
@@ -546,10 +1178,11 @@ class HeAPPlacer
                     BelId bel = available_bels.at(ci->type).back();
                     available_bels.at(ci->type).pop_back();
                     Loc loc = ctx->getBelLocation(bel);
-                    cell_locs[cell.first].x = loc.x;
-                    cell_locs[cell.first].y = loc.y;
-                    cell_locs[cell.first].locked = false;
-                    cell_locs[cell.first].global = ctx->getBelGlobalBuf(bel);
+                    cell_locs[ci->udata].valid = true;
+                    cell_locs[ci->udata].x = loc.x;
+                    cell_locs[ci->udata].y = loc.y;
+                    cell_locs[ci->udata].locked = false;
+                    cell_locs[ci->udata].global = ctx->getBelGlobalBuf(bel);
                     // FIXME
                     if (has_connectivity(cell.second) && !cfg.ioBufTypes.count(ci->type)) {
                         place_cells.push_back(ci);
@@ -557,7 +1190,7 @@ class HeAPPlacer
                     } else {
                         if (ctx->isValidBelForCell(ci, bel)) {
                             ctx->bindBel(bel, ci, STRENGTH_STRONG);
-                            cell_locs[cell.first].locked = true;
+                            cell_locs[ci->udata].locked = true;
                             placed = true;
                         } else {
                             available_bels.at(ci->type).push_front(bel);
@@ -568,44 +1201,98 @@ class HeAPPlacer
         }
     }
 
+    // Move the cells to be placed to their location in the reference placement, and the cells that have none, or
+    // changed type, to the mean location of the cells they share a net with that do
+    void seed_from_reference()
+    {
+        std::vector<bool> seeded(cell_locs.size(), false);
+        for (size_t i = 0; i < cell_locs.size(); i++)
+            seeded[i] = cell_locs[i].locked;
+        std::vector<CellInfo *> unseeded;
+        for (auto cell : place_cells) {
+            auto fnd = cfg.referenceLocs.find(cell->name);
+            if (fnd == cfg.referenceLocs.end() || fnd->second.first != cell->type) {
+                unseeded.push_back(cell);
+                continue;
+            }
+            auto &cl = cell_locs[cell->udata];
+            cl.x = std::min(max_x, std::max(0, fnd->second.second.x));
+            cl.y = std::min(max_y, std::max(0, fnd->second.second.y));
+            seeded[cell->udata] = true;
+        }
+        for (auto cell : unseeded) {
+            int64_t sum_x = 0, sum_y = 0, count = 0;
+            for (auto &port : cell->ports) {
+                NetInfo *ni = port.second.net;
+                // High fanout nets, such as clocks and resets, say little about where a cell belongs
+                if (ni == nullptr || ni->users.size() > 100)
+                    continue;
+                auto visit = [&](const PortRef &pr) {
+                    if (pr.cell == nullptr || pr.cell == cell || !seeded[pr.cell->udata])
+                        return;
+                    sum_x += cell_locs[pr.cell->udata].x;
+                    sum_y += cell_locs[pr.cell->udata].y;
+                    ++count;
+                };
+                visit(ni->driver);
+                for (auto &usr : ni->users)
+                    visit(usr);
+            }
+            if (count == 0)
+                continue;
+            auto &cl = cell_locs[cell->udata];
+            cl.x = int(sum_x / count);
+            cl.y = int(sum_y / count);
+        }
+        for (auto cell : place_cells) {
+            auto &cl = cell_locs[cell->udata];
+            cl.rawx = cl.legal_x = cl.x;
+            cl.rawy = cl.legal_y = cl.y;
+        }
+        log_info("Seeding HeAP from the reference placement: %d of %d cells have a reference location.\n",
+                 int(place_cells.size() - unseeded.size()), int(place_cells.size()));
+    }
+
     // Setup the cells to be solved, returns the number of rows
     int setup_solve_cells(std::unordered_set<IdString> *celltypes = nullptr)
     {
         int row = 0;
         solve_cells.clear();
-        // First clear the udata of all cells
-        for (auto cell : sorted(ctx->cells))
-            cell.second->udata = dont_solve;
+        // First clear the rows of all cells
+        std::fill(solve_row.begin(), solve_row.end(), dont_solve);
         // Then update cells to be placed, which excludes cell children
         for (auto cell : place_cells) {
             if (celltypes && !celltypes->count(cell->type))
                 continue;
-            cell->udata = row++;
+            solve_row[cell->udata] = row++;
             solve_cells.push_back(cell);
         }
-        // Finally, update the udata of children
-        for (auto chained : chain_root)
-            ctx->cells.at(chained.first)->udata = chained.second->udata;
+        // Finally, update the rows of children
+        for (size_t i = 0; i < chain_root.size(); i++)
+            if (chain_root[i] != nullptr)
+                solve_row[i] = solve_row[chain_root[i]->udata];
         return row;
     }
 
     // Update the location of all children of a chain
     void update_chain(CellInfo *cell, CellInfo *root)
     {
-        const auto &base = cell_locs[cell->name];
+        const auto &base = cell_locs[cell->udata];
         for (auto child : cell->constr_children) {
             // FIXME: Improve handling of heterogeneous chains
             if (child->type == root->type)
-                chain_size[root->name]++;
+                chain_size[root->udata]++;
+            auto &cl = cell_locs[child->udata];
+            cl.valid = true;
             if (child->constr_x != child->UNCONSTR)
-                cell_locs[child->name].x = std::max(0, std::min(max_x, base.x + child->constr_x));
+                cl.x = std::max(0, std::min(max_x, base.x + child->constr_x));
             else
-                cell_locs[child->name].x = base.x; // better handling of UNCONSTR?
+                cl.x = base.x; // better handling of UNCONSTR?
             if (child->constr_y != child->UNCONSTR)
-                cell_locs[child->name].y = std::max(0, std::min(max_y, base.y + child->constr_y));
+                cl.y = std::max(0, std::min(max_y, base.y + child->constr_y));
             else
-                cell_locs[child->name].y = base.y; // better handling of UNCONSTR?
-            chain_root[child->name] = root;
+                cl.y = base.y; // better handling of UNCONSTR?
+            chain_root[child->udata] = root;
             if (!child->constr_children.empty())
                 update_chain(child, root);
         }
@@ -615,7 +1302,7 @@ class HeAPPlacer
     void update_all_chains()
     {
         for (auto cell : place_cells) {
-            chain_size[cell->name] = 1;
+            chain_size[cell->udata] = 1;
             if (!cell->constr_children.empty())
                 update_chain(cell, cell);
         }
@@ -630,25 +1317,48 @@ class HeAPPlacer
             func(net->users.at(i), i);
     }
 
-    // Build the system of equations for either X or Y
-    void build_equations(EquationSystem<double> &es, bool yaxis, int iter = -1)
+    // Build the system of equations for either X or Y, for all solve_cells or one part of them. Star nets are only
+    // used when solving all at once
+    void build_equations(EquationSystem<double> &es, bool yaxis, int iter = -1, const SolvePart *part = nullptr)
     {
+        // The row of a cell in these equations, or dont_solve if it is fixed in them
+        auto eqn_row = [&](CellInfo *cell) {
+            int row = solve_row[cell->udata];
+            if (part == nullptr || row == dont_solve)
+                return row;
+            return (row_part.at(row) == part->id) ? part_row.at(row) : dont_solve;
+        };
         // Return the x or y position of a cell, depending on ydir
-        auto cell_pos = [&](CellInfo *cell) { return yaxis ? cell_locs.at(cell->name).y : cell_locs.at(cell->name).x; };
+        auto cell_pos = [&](CellInfo *cell) {
+            if (part != nullptr && eqn_row(cell) == dont_solve)
+                return yaxis ? frozen_y[cell->udata] : frozen_x[cell->udata];
+            return yaxis ? cell_locs[cell->udata].y : cell_locs[cell->udata].x;
+        };
         auto legal_pos = [&](CellInfo *cell) {
-            return yaxis ? cell_locs.at(cell->name).legal_y : cell_locs.at(cell->name).legal_x;
+            return yaxis ? cell_locs[cell->udata].legal_y : cell_locs[cell->udata].legal_x;
         };
 
         es.reset();
 
-        for (auto net : sorted(ctx->nets)) {
-            NetInfo *ni = net.second;
+        bool use_star = part == nullptr && es.A.size() > solve_cells.size();
+        int star_idx = 0;
+        std::vector<NetInfo *> all_nets;
+        if (part == nullptr)
+            for (auto net : sorted(ctx->nets))
+                all_nets.push_back(net.second);
+        for (NetInfo *ni : (part != nullptr) ? part->nets : all_nets) {
             if (ni->driver.cell == nullptr)
                 continue;
             if (ni->users.empty())
                 continue;
-            if (cell_locs.at(ni->driver.cell->name).global)
+            if (cell_locs[ni->driver.cell->udata].global)
+                continue;
+            if (part == nullptr && is_star_net(ni)) {
+                if (use_star)
+                    build_star_equations(es, yaxis, ni, star_idx);
+                ++star_idx;
                 continue;
+            }
             // Find the bounds of the net in this axis, and the ports that correspond to these bounds
             PortRef *lbport = nullptr, *ubport = nullptr;
             int lbpos = std::numeric_limits<int>::max(), ubpos = std::numeric_limits<int>::min();
@@ -667,12 +1377,13 @@ class HeAPPlacer
             NPNR_ASSERT(ubport != nullptr);
 
             auto stamp_equation = [&](PortRef &var, PortRef &eqn, double weight) {
-                if (eqn.cell->udata == dont_solve)
+                int row = eqn_row(eqn.cell);
+                if (row == dont_solve)
                     return;
-                int row = eqn.cell->udata;
                 int v_pos = cell_pos(var.cell);
-                if (var.cell->udata != dont_solve) {
-                    es.add_coeff(row, var.cell->udata, weight);
+                int var_row = eqn_row(var.cell);
+                if (var_row != dont_solve) {
+                    es.add_coeff(row, var_row, weight);
                 } else {
                     es.add_rhs(row, -v_pos * weight);
                 }
@@ -694,12 +1405,9 @@ class HeAPPlacer
                                            std::max<double>(1, (yaxis ? cfg.hpwl_scale_y : cfg.hpwl_scale_x) *
                                                                        std::abs(o_pos - this_pos)));
 
-                    if (user_idx != -1 && net_crit.count(ni->name)) {
-                        auto &nc = net_crit.at(ni->name);
-                        if (user_idx < int(nc.criticality.size()))
-                            weight *= (1.0 + cfg.timingWeight *
-                                                     std::pow(nc.criticality.at(user_idx), cfg.criticalityExponent));
-                    }
+                    if (user_idx != -1 && user_idx < net_crit.num_arcs(ni))
+                        weight *= (1.0 + cfg.timingWeight * std::pow(net_crit.arc_criticality(ni, user_idx),
+                                                                     cfg.criticalityExponent));
 
                     // If cell 0 is not fixed, it will stamp +w on its equation and -w on the other end's equation,
                     // if the other end isn't fixed
@@ -712,11 +1420,13 @@ class HeAPPlacer
                 process_arc(ubport);
             });
         }
+        size_t rows = (part != nullptr) ? part->rows.size() : solve_cells.size();
+        auto row_cell = [&](size_t row) { return solve_cells.at((part != nullptr) ? part->rows.at(row) : row); };
         if (iter != -1) {
             float alpha = cfg.alpha;
-            for (size_t row = 0; row < solve_cells.size(); row++) {
-                int l_pos = legal_pos(solve_cells.at(row));
-                int c_pos = cell_pos(solve_cells.at(row));
+            for (size_t row = 0; row < rows; row++) {
+                int l_pos = legal_pos(row_cell(row));
+                int c_pos = cell_pos(row_cell(row));
 
                 double weight =
                         alpha * iter /
@@ -725,75 +1435,314 @@ class HeAPPlacer
                 es.add_coeff(row, row, weight);
                 es.add_rhs(row, weight * l_pos);
             }
+        } else if (part != nullptr) {
+            // A part may have no connections to cells outside it, so weakly hold its cells where they are to keep
+            // the system from being singular
+            for (size_t row = 0; row < rows; row++) {
+                es.add_coeff(row, row, 1e-6);
+                es.add_rhs(row, 1e-6 * cell_pos(row_cell(row)));
+            }
         }
     }
 
-    // Build the system of equations for either X or Y
-    void solve_equations(EquationSystem<double> &es, bool yaxis)
+    // Nets with more users than cfg.starFanout use the star model, with a variable for the position of their centre.
+    // This needs one matrix entry per pin, rather than the two per pin of the bound-to-bound model, which adds up
+    // for the resets and enables of large designs.
+    bool is_star_net(const NetInfo *ni) const
+    {
+        return cfg.starFanout > 0 && int(ni->users.size()) > cfg.starFanout;
+    }
+
+    // Index the star nets, in the same order as build_equations visits them
+    void setup_star_nets()
+    {
+        int count = 0;
+        for (auto net : sorted(ctx->nets)) {
+            NetInfo *ni = net.second;
+            if (ni->driver.cell == nullptr || ni->users.empty() || cell_locs[ni->driver.cell->udata].global)
+                continue;
+            if (is_star_net(ni))
+                ++count;
+        }
+        // Centres are set to the centroid of their pins when first solved for
+        star_x.assign(count, std::numeric_limits<double>::quiet_NaN());
+        star_y.assign(count, std::numeric_limits<double>::quiet_NaN());
+        if (count > 0)
+            log_info("Using the star net model for %d nets with more than %d users.\n", count, cfg.starFanout);
+    }
+
+    // Stamp the arcs between each pin of a star net and its centre, which is the variable after all solve_cells
+    void build_star_equations(EquationSystem<double> &es, bool yaxis, NetInfo *ni, int star_idx)
+    {
+        auto cell_pos = [&](CellInfo *cell) { return yaxis ? cell_locs[cell->udata].y : cell_locs[cell->udata].x; };
+        int centre_row = int(solve_cells.size()) + star_idx;
+        double &centre = (yaxis ? star_y : star_x).at(star_idx);
+        if (std::isnan(centre)) {
+            double sum = 0;
+            foreach_port(ni, [&](PortRef &port, int user_idx) { sum += cell_pos(port.cell); });
+            centre = sum / (ni->users.size() + 1);
+        }
+        int num_arcs = net_crit.num_arcs(ni);
+        foreach_port(ni, [&](PortRef &port, int user_idx) {
+            int pos = cell_pos(port.cell);
+            // Each pin is pulled towards the centre about as strongly as the two bound arcs would pull it
+            double weight = 2.0 / (ni->users.size() *
+                                   std::max<double>(1, (yaxis ? cfg.hpwl_scale_y : cfg.hpwl_scale_x) *
+                                                               std::abs(pos - centre)));
+            if (user_idx != -1 && user_idx < num_arcs)
+                weight *= (1.0 +
+                           cfg.timingWeight * std::pow(net_crit.arc_criticality(ni, user_idx), cfg.criticalityExponent));
+            es.add_coeff(centre_row, centre_row, weight);
+            int row = solve_row[port.cell->udata];
+            if (row == dont_solve) {
+                es.add_rhs(centre_row, pos * weight);
+            } else {
+                es.add_coeff(row, row, weight);
+                es.add_coeff(row, centre_row, -weight);
+                es.add_coeff(centre_row, row, -weight);
+            }
+        });
+    }
+
+    // Solve the system of equations for either X or Y, for all solve_cells or one part of them
+    void solve_equations(EquationSystem<double> &es, bool yaxis, const SolvePart *part = nullptr)
     {
         // Return the x or y position of a cell, depending on ydir
-        auto cell_pos = [&](CellInfo *cell) { return yaxis ? cell_locs.at(cell->name).y : cell_locs.at(cell->name).x; };
+        auto cell_pos = [&](CellInfo *cell) { return yaxis ? cell_locs[cell->udata].y : cell_locs[cell->udata].x; };
+        std::vector<CellInfo *> part_cells;
+        if (part != nullptr)
+            for (int row : part->rows)
+                part_cells.push_back(solve_cells.at(row));
+        const std::vector<CellInfo *> &cells = (part != nullptr) ? part_cells : solve_cells;
         std::vector<double> vals;
-        std::transform(solve_cells.begin(), solve_cells.end(), std::back_inserter(vals), cell_pos);
-        es.solve(vals, cfg.solverTolerance);
-        for (size_t i = 0; i < vals.size(); i++)
+        std::transform(cells.begin(), cells.end(), std::back_inserter(vals), cell_pos);
+        std::vector<double> &star_pos = yaxis ? star_y : star_x;
+        bool use_star = part == nullptr && es.A.size() > solve_cells.size();
+        if (use_star)
+            vals.insert(vals.end(), star_pos.begin(), star_pos.end());
+        es.solve(vals, cfg.solverTolerance, cfg.solverPreconditioner, cfg.gpuSolver);
+        if (use_star)
+            std::copy(vals.begin() + solve_cells.size(), vals.end(), star_pos.begin());
+        for (size_t i = 0; i < cells.size(); i++) {
+            CellInfo *ci = cells.at(i);
+            auto &cl = cell_locs[ci->udata];
             if (yaxis) {
-                cell_locs.at(solve_cells.at(i)->name).rawy = vals.at(i);
-                cell_locs.at(solve_cells.at(i)->name).y = std::min(max_y, std::max(0, int(vals.at(i))));
-                if (solve_cells.at(i)->region != nullptr)
-                    cell_locs.at(solve_cells.at(i)->name).y =
-                            limit_to_reg(solve_cells.at(i)->region, cell_locs.at(solve_cells.at(i)->name).y, true);
+                cl.rawy = vals.at(i);
+                cl.y = std::min(max_y, std::max(0, int(vals.at(i))));
+                if (ci->region != nullptr)
+                    cl.y = limit_to_reg(ci->region, cl.y, true);
             } else {
-                cell_locs.at(solve_cells.at(i)->name).rawx = vals.at(i);
-                cell_locs.at(solve_cells.at(i)->name).x = std::min(max_x, std::max(0, int(vals.at(i))));
-                if (solve_cells.at(i)->region != nullptr)
-                    cell_locs.at(solve_cells.at(i)->name).x =
-                            limit_to_reg(solve_cells.at(i)->region, cell_locs.at(solve_cells.at(i)->name).x, false);
+                cl.rawx = vals.at(i);
+                cl.x = std::min(max_x, std::max(0, int(vals.at(i))));
+                if (ci->region != nullptr)
+                    cl.x = limit_to_reg(ci->region, cl.x, false);
             }
+        }
     }
 
-    // Compute HPWL
-    wirelen_t total_hpwl()
+    // Build the pin table used by total_hpwl
+    void build_hpwl_nets()
     {
-        wirelen_t hpwl = 0;
+        hpwl_net_start.clear();
+        hpwl_pins.clear();
         for (auto net : sorted(ctx->nets)) {
             NetInfo *ni = net.second;
-            if (ni->driver.cell == nullptr)
+            if (ni->driver.cell == nullptr || ni->users.empty())
                 continue;
-            CellLocation &drvloc = cell_locs.at(ni->driver.cell->name);
+            const CellLocation &drvloc = cell_locs[ni->driver.cell->udata];
             if (drvloc.global)
                 continue;
-            int xmin = drvloc.x, xmax = drvloc.x, ymin = drvloc.y, ymax = drvloc.y;
-            for (auto &user : ni->users) {
-                CellLocation &usrloc = cell_locs.at(user.cell->name);
-                xmin = std::min(xmin, usrloc.x);
-                xmax = std::max(xmax, usrloc.x);
-                ymin = std::min(ymin, usrloc.y);
-                ymax = std::max(ymax, usrloc.y);
+            hpwl_net_start.push_back(int(hpwl_pins.size()));
+            hpwl_pins.push_back(&drvloc);
+            for (auto &user : ni->users)
+                hpwl_pins.push_back(&cell_locs[user.cell->udata]);
+        }
+        hpwl_net_start.push_back(int(hpwl_pins.size()));
+        hpwl_pin_x.resize(hpwl_pins.size());
+        hpwl_pin_y.resize(hpwl_pins.size());
+    }
+
+    // Estimate the routing demand at each location with the RUDY model, where each net spreads (w + h) / (w * h)
+    // over its bounding box, and set cell_inflation from how far it exceeds the mean demand
+    void update_cell_inflation()
+    {
+        int w = max_x + 1, h = max_y + 1;
+        // Added over the bounding boxes through a 2D difference array, then summed up
+        std::vector<double> demand((w + 1) * (h + 1), 0);
+        for (int n = 0; n + 1 < int(hpwl_net_start.size()); n++) {
+            int start = hpwl_net_start[n], stop = hpwl_net_start[n + 1];
+            int x0 = hpwl_pins[start]->x, x1 = x0, y0 = hpwl_pins[start]->y, y1 = y0;
+            for (int i = start + 1; i < stop; i++) {
+                x0 = std::min(x0, hpwl_pins[i]->x);
+                x1 = std::max(x1, hpwl_pins[i]->x);
+                y0 = std::min(y0, hpwl_pins[i]->y);
+                y1 = std::max(y1, hpwl_pins[i]->y);
             }
-            hpwl += cfg.hpwl_scale_x * (xmax - xmin) + cfg.hpwl_scale_y * (ymax - ymin);
+            double bw = x1 - x0 + 1, bh = y1 - y0 + 1;
+            double d = (bw + bh) / (bw * bh);
+            demand[x0 * (h + 1) + y0] += d;
+            demand[(x1 + 1) * (h + 1) + y0] -= d;
+            demand[x0 * (h + 1) + y1 + 1] -= d;
+            demand[(x1 + 1) * (h + 1) + y1 + 1] += d;
         }
-        return hpwl;
+        for (int x = 0; x <= w; x++)
+            for (int y = 0; y <= h; y++)
+                demand[x * (h + 1) + y] += ((x > 0) ? demand[(x - 1) * (h + 1) + y] : 0) +
+                                           ((y > 0) ? demand[x * (h + 1) + y - 1] : 0) -
+                                           ((x > 0 && y > 0) ? demand[(x - 1) * (h + 1) + y - 1] : 0);
+        double total = 0;
+        int used = 0;
+        for (int x = 0; x < w; x++)
+            for (int y = 0; y < h; y++)
+                if (demand[x * (h + 1) + y] > 1e-9) {
+                    total += demand[x * (h + 1) + y];
+                    ++used;
+                }
+        cell_inflation.assign(w * h, 1.0f);
+        if (used == 0)
+            return;
+        double threshold = cfg.routabilityRatio * total / used;
+        int inflated = 0;
+        for (int x = 0; x < w; x++)
+            for (int y = 0; y < h; y++) {
+                double d = demand[x * (h + 1) + y];
+                if (d <= threshold)
+                    continue;
+                cell_inflation[x * h + y] = float(std::min<double>(cfg.routabilityMaxInflation, d / threshold));
+                ++inflated;
+            }
+        if (ctx->verbose)
+            log_info("    routing demand above %.02f in %d of %d locations\n", threshold, inflated, used);
+    }
+
+    // Compute HPWL
+    wirelen_t total_hpwl()
+    {
+        int n_nets = int(hpwl_net_start.size()) - 1;
+        // HPWL of nets [begin, end), each thread gathering the coordinates of its own nets' pins so the min/max
+        // reductions run over contiguous arrays
+        auto nets_hpwl = [&](int begin, int end) {
+            int pin_begin = hpwl_net_start.at(begin), pin_end = hpwl_net_start.at(end);
+            int *px = hpwl_pin_x.data(), *py = hpwl_pin_y.data();
+            for (int i = pin_begin; i < pin_end; i++) {
+                px[i] = hpwl_pins[i]->x;
+                py[i] = hpwl_pins[i]->y;
+            }
+            wirelen_t hpwl = 0;
+            for (int n = begin; n < end; n++) {
+                int start = hpwl_net_start[n], stop = hpwl_net_start[n + 1];
+                int xmin = px[start], xmax = px[start], ymin = py[start], ymax = py[start];
+                for (int i = start + 1; i < stop; i++) {
+                    xmin = std::min(xmin, px[i]);
+                    xmax = std::max(xmax, px[i]);
+                    ymin = std::min(ymin, py[i]);
+                    ymax = std::max(ymax, py[i]);
+                }
+                hpwl += cfg.hpwl_scale_x * (xmax - xmin) + cfg.hpwl_scale_y * (ymax - ymin);
+            }
+            return hpwl;
+        };
+        // Heuristic: only worth starting threads for large designs
+        int threads = (hpwl_pins.size() < 100000) ? 1 : std::min(cfg.threads, n_nets);
+        if (threads <= 1)
+            return nets_hpwl(0, n_nets);
+        std::vector<wirelen_t> partial(threads, 0);
+        ctx->threadPool().parallel_for(
+                threads, 1,
+                [&](size_t t) {
+                    partial.at(t) =
+                            nets_hpwl(int(int64_t(n_nets) * t / threads), int(int64_t(n_nets) * (t + 1) / threads));
+                },
+                threads);
+        return std::accumulate(partial.begin(), partial.end(), wirelen_t(0));
     }
 
     // Strict placement legalisation, performed after the initial HeAP spreading
     void legalise_placement_strict(bool require_validity = false)
     {
+        NPNR_TRACE_SCOPE("legalise");
         auto startt = std::chrono::high_resolution_clock::now();
 
         // Unbind all cells placed in this solution
         for (auto cell : sorted(ctx->cells)) {
             CellInfo *ci = cell.second;
-            if (ci->bel != BelId() && (ci->udata != dont_solve ||
-                                       (chain_root.count(ci->name) && chain_root.at(ci->name)->udata != dont_solve)))
+            if (ci->bel != BelId() && solve_row[ci->udata] != dont_solve)
                 ctx->unbindBel(ci->bel);
         }
 
+
+        std::vector<CellInfo *> serial_cells = solve_cells;
+        if (!cfg.hardBlockTypes.empty())
+            serial_cells = legalise_hard_blocks(serial_cells, require_validity);
+        if (cfg.parallelLegalise)
+            serial_cells = legalise_windows(serial_cells, require_validity);
+        LegaliseScope scope;
+        scope.rng = ctx;
+        scope.x0 = 0;
+        scope.y0 = 0;
+        scope.x1 = max_x;
+        scope.y1 = max_y;
+        scope.window = -1;
+        scope.owner = nullptr;
+        legalise_cells(scope, serial_cells, require_validity);
+
+        auto endt = std::chrono::high_resolution_clock::now();
+        sl_time += std::chrono::duration<float>(endt - startt).count();
+    }
+
+    // State of one run of the strict legaliser over a set of cells: the whole device for the serial legaliser, or
+    // one window of it for the parallel one
+    struct LegaliseScope
+    {
+        DeterministicRNG *rng;
+        // Random state of a window, rng points here
+        DeterministicRNG window_rng;
+        // Bounds of the locations cells can be legalised to, inclusive
+        int x0, y0, x1, y1;
+        // For a window, its index and the window of each cell being legalised; only cells of this window may be
+        // ripped up. Cells that cannot be placed inside the window are deferred to the serial legaliser, rather
+        // than being an error.
+        int window;
+        const std::unordered_map<IdString, int> *owner;
+        std::vector<CellInfo *> deferred;
+        // For a window, the new locations of its cells, which go into cell_locs once all windows of a group are done
+        std::unordered_map<IdString, Loc> locs;
+    };
+
+    int size_of(const CellInfo *cell) const { return chain_size[cell->udata]; }
+
+    // Strict placement legalisation of cells within a scope
+    void legalise_cells(LegaliseScope &scope, const std::vector<CellInfo *> &cells, bool require_validity)
+    {
+        const bool windowed = (scope.owner != nullptr);
+        const int max_radius = std::max(scope.x1 - scope.x0, scope.y1 - scope.y0);
+        auto may_ripup = [&](CellInfo *bound) {
+            if (!windowed)
+                return true;
+            auto fnd = scope.owner->find(bound->name);
+            return fnd != scope.owner->end() && fnd->second == scope.window;
+        };
+        auto loc_of = [&](CellInfo *ci) {
+            auto fnd = scope.locs.find(ci->name);
+            if (fnd != scope.locs.end())
+                return fnd->second;
+            auto &cl = cell_locs[ci->udata];
+            return Loc(cl.x, cl.y, 0);
+        };
+        auto set_loc = [&](CellInfo *ci, Loc loc) {
+            if (windowed) {
+                scope.locs[ci->name] = loc;
+            } else {
+                cell_locs[ci->udata].x = loc.x;
+                cell_locs[ci->udata].y = loc.y;
+            }
+        };
+
         // At the moment we don't follow the full HeAP algorithm using cuts for legalisation, instead using
         // the simple greedy largest-macro-first approach.
         std::priority_queue<std::pair<int, IdString>> remaining;
-        for (auto cell : solve_cells) {
-            remaining.emplace(chain_size[cell->name], cell->name);
+        for (auto cell : cells) {
+            remaining.emplace(size_of(cell), cell->name);
         }
         int ripup_radius = 2;
         int total_iters = 0;
@@ -818,12 +1767,19 @@ class HeAPPlacer
 
             total_iters++;
             total_iters_noreset++;
-            if (total_iters > int(solve_cells.size())) {
+            if (total_iters > int(cells.size())) {
                 total_iters = 0;
-                ripup_radius = std::max(std::max(max_x, max_y), ripup_radius * 2);
+                ripup_radius = std::max(max_radius, ripup_radius * 2);
             }
 
             if (total_iters_noreset > std::max(5000, 8 * int(ctx->cells.size()))) {
+                if (windowed) {
+                    // Leave everything that is still unplaced to the serial legaliser
+                    scope.deferred.push_back(ci);
+                    for (; !remaining.empty(); remaining.pop())
+                        scope.deferred.push_back(ctx->cells.at(remaining.top().second).get());
+                    break;
+                }
                 log_error("Unable to find legal placement for all cells, design is probably at utilisation limit.\n");
             }
 
@@ -847,72 +1803,66 @@ class HeAPPlacer
                                                   1);
                 }
 
-                int nx = ctx->rng(2 * rx + 1) + std::max(cell_locs.at(ci->name).x - rx, 0);
-                int ny = ctx->rng(2 * ry + 1) + std::max(cell_locs.at(ci->name).y - ry, 0);
+                Loc cloc = loc_of(ci);
+                int nx = scope.rng->rng(2 * rx + 1) + std::max(cloc.x - rx, 0);
+                int ny = scope.rng->rng(2 * ry + 1) + std::max(cloc.y - ry, 0);
 
                 iter++;
                 iter_at_radius++;
                 if (iter >= (10 * (radius + 1))) {
-                    radius = std::min(std::max(max_x, max_y), radius + 1);
-                    while (radius < std::max(max_x, max_y)) {
-                        for (int x = std::max(0, cell_locs.at(ci->name).x - radius);
-                             x <= std::min(max_x, cell_locs.at(ci->name).x + radius); x++) {
-                            if (x >= int(fb.size()))
-                                break;
-                            for (int y = std::max(0, cell_locs.at(ci->name).y - radius);
-                                 y <= std::min(max_y, cell_locs.at(ci->name).y + radius); y++) {
-                                if (y >= int(fb.at(x).size()))
-                                    break;
-                                if (fb.at(x).at(y).size() > 0)
-                                    goto notempty;
-                            }
-                        }
-                        radius = std::min(std::max(max_x, max_y), radius + 1);
+                    if (windowed && radius == max_radius) {
+                        // Searched the whole window without success
+                        scope.deferred.push_back(ci);
+                        break;
                     }
-                notempty:
+                    radius = std::min(max_radius, radius + 1);
+                    // Grow the radius until the window contains a bel of the right type
+                    while (radius < max_radius &&
+                           fb.count(std::max(scope.x0, cloc.x - radius), std::max(scope.y0, cloc.y - radius),
+                                    std::min(scope.x1, cloc.x + radius), std::min(scope.y1, cloc.y + radius)) == 0)
+                        radius = std::min(max_radius, radius + 1);
                     iter_at_radius = 0;
                     iter = 0;
                 }
-                if (nx < 0 || nx > max_x)
+                if (nx < scope.x0 || nx > scope.x1)
                     continue;
-                if (ny < 0 || ny > max_y)
+                if (ny < scope.y0 || ny > scope.y1)
                     continue;
 
                 // ny = nearest_row_with_bel.at(bt).at(ny);
                 // nx = nearest_col_with_bel.at(bt).at(nx);
 
-                if (nx >= int(fb.size()))
-                    continue;
-                if (ny >= int(fb.at(nx).size()))
-                    continue;
-                if (fb.at(nx).at(ny).empty())
+                if (fb.count(nx, ny) == 0)
                     continue;
 
                 int need_to_explore = 2 * radius;
 
                 if (iter_at_radius >= need_to_explore && bestBel != BelId()) {
                     CellInfo *bound = ctx->getBoundBelCell(bestBel);
+                    if (bound != nullptr && !may_ripup(bound)) {
+                        // Taken by a cell of another window since it was found
+                        bestBel = BelId();
+                        continue;
+                    }
                     if (bound != nullptr) {
                         ctx->unbindBel(bound->bel);
-                        remaining.emplace(chain_size[bound->name], bound->name);
+                        remaining.emplace(size_of(bound), bound->name);
                     }
                     ctx->bindBel(bestBel, ci, STRENGTH_WEAK);
                     placed = true;
-                    Loc loc = ctx->getBelLocation(bestBel);
-                    cell_locs[ci->name].x = loc.x;
-                    cell_locs[ci->name].y = loc.y;
+                    set_loc(ci, ctx->getBelLocation(bestBel));
                     break;
                 }
 
                 if (ci->constr_children.empty() && !ci->constr_abs_z) {
-                    for (auto sz : fb.at(nx).at(ny)) {
+                    for (auto sz : fb.at(nx, ny)) {
                         if (ci->region != nullptr && ci->region->constr_bels && !ci->region->bels.count(sz))
                             continue;
-                        if (ctx->checkBelAvail(sz) || (radius > ripup_radius || ctx->rng(20000) < 10)) {
+                        if (ctx->checkBelAvail(sz) || (radius > ripup_radius || scope.rng->rng(20000) < 10)) {
                             CellInfo *bound = ctx->getBoundBelCell(sz);
                             if (bound != nullptr) {
                                 if (bound->constr_parent != nullptr || !bound->constr_children.empty() ||
-                                    bound->constr_abs_z)
+                                    bound->constr_abs_z || !may_ripup(bound))
                                     continue;
                                 ctx->unbindBel(bound->bel);
                             }
@@ -931,12 +1881,10 @@ class HeAPPlacer
                                     if (p.type != PORT_IN || p.net == nullptr || p.net->driver.cell == nullptr)
                                         continue;
                                     CellInfo *drv = p.net->driver.cell;
-                                    auto drv_loc = cell_locs.find(drv->name);
-                                    if (drv_loc == cell_locs.end())
-                                        continue;
-                                    if (drv_loc->second.global)
+                                    auto &drv_loc = cell_locs[drv->udata];
+                                    if (!drv_loc.valid || drv_loc.global)
                                         continue;
-                                    input_len += std::abs(drv_loc->second.x - nx) + std::abs(drv_loc->second.y - ny);
+                                    input_len += std::abs(drv_loc.x - nx) + std::abs(drv_loc.y - ny);
                                 }
                                 if (input_len < best_inp_len) {
                                     best_inp_len = input_len;
@@ -945,17 +1893,15 @@ class HeAPPlacer
                                 break;
                             } else {
                                 if (bound != nullptr)
-                                    remaining.emplace(chain_size[bound->name], bound->name);
-                                Loc loc = ctx->getBelLocation(sz);
-                                cell_locs[ci->name].x = loc.x;
-                                cell_locs[ci->name].y = loc.y;
+                                    remaining.emplace(size_of(bound), bound->name);
+                                set_loc(ci, ctx->getBelLocation(sz));
                                 placed = true;
                                 break;
                             }
                         }
                     }
                 } else {
-                    for (auto sz : fb.at(nx).at(ny)) {
+                    for (auto sz : fb.at(nx, ny)) {
                         Loc loc = ctx->getBelLocation(sz);
                         if (ci->constr_abs_z && loc.z != ci->constr_z)
                             continue;
@@ -968,6 +1914,8 @@ class HeAPPlacer
                             NPNR_ASSERT(vc->bel == BelId());
                             Loc ploc = visit.front().second;
                             visit.pop();
+                            if (ploc.x < scope.x0 || ploc.x > scope.x1 || ploc.y < scope.y0 || ploc.y > scope.y1)
+                                goto fail;
                             BelId target = ctx->getBelByLocation(ploc);
                             if (vc->region != nullptr && vc->region->constr_bels && !vc->region->bels.count(target))
                                 goto fail;
@@ -978,7 +1926,8 @@ class HeAPPlacer
                             // Chains cannot overlap
                             if (bound != nullptr)
                                 if (bound->constr_z != bound->UNCONSTR || bound->constr_parent != nullptr ||
-                                    !bound->constr_children.empty() || bound->belStrength > STRENGTH_WEAK)
+                                    !bound->constr_children.empty() || bound->belStrength > STRENGTH_WEAK ||
+                                    !may_ripup(bound))
                                     goto fail;
                             targets.emplace_back(vc, target);
                             for (auto child : vc->constr_children) {
@@ -1017,13 +1966,12 @@ class HeAPPlacer
                         }
                         for (auto &target : targets) {
                             Loc loc = ctx->getBelLocation(target.second);
-                            cell_locs[target.first->name].x = loc.x;
-                            cell_locs[target.first->name].y = loc.y;
+                            set_loc(target.first, loc);
                             // log_info("%s %d %d %d\n", target.first->name.c_str(ctx), loc.x, loc.y, loc.z);
                         }
                         for (auto &swap : swaps_made) {
                             if (swap.second != nullptr)
-                                remaining.emplace(chain_size[swap.second->name], swap.second->name);
+                                remaining.emplace(size_of(swap.second), swap.second->name);
                         }
 
                         placed = true;
@@ -1032,17 +1980,270 @@ class HeAPPlacer
                 }
             }
         }
-        auto endt = std::chrono::high_resolution_clock::now();
-        sl_time += std::chrono::duration<float>(endt - startt).count();
     }
+
+    // Legalise cells in windows of the device in parallel, returning the cells left to the serial legaliser. As for
+    // the parallel placer1 refinement, the windows are split into four groups in a checkerboard, so that windows
+    // legalised at the same time are a window apart and never share a site. Each window has its own random state,
+    // seeded in order from the context, and only reads the locations of other windows' cells from before the group
+    // started, so the result does not depend on the thread count.
+    std::vector<CellInfo *> legalise_windows(const std::vector<CellInfo *> &cells, bool require_validity)
+    {
+        const int wx = cfg.legaliseWindowX, wy = cfg.legaliseWindowY;
+        const int nx = max_x / wx + 1, ny = max_y / wy + 1;
+        std::vector<LegaliseScope> windows(nx * ny);
+        std::vector<std::vector<CellInfo *>> window_cells(windows.size());
+        for (int y = 0; y < ny; y++) {
+            for (int x = 0; x < nx; x++) {
+                auto &w = windows.at(y * nx + x);
+                w.window_rng.rngseed(ctx->rng64());
+                w.rng = &w.window_rng;
+                w.x0 = x * wx;
+                w.y0 = y * wy;
+                w.x1 = std::min(max_x, w.x0 + wx - 1);
+                w.y1 = std::min(max_y, w.y0 + wy - 1);
+                w.window = y * nx + x;
+            }
+        }
+
+        std::vector<CellInfo *> deferred;
+        std::unordered_map<IdString, int> owner;
+        for (auto cell : cells) {
+            // Region constrained cells may need to go anywhere in their region
+            if (cell->region != nullptr) {
+                deferred.push_back(cell);
+                continue;
+            }
+            auto &cl = cell_locs[cell->udata];
+            int idx = (std::max(0, std::min(max_y, cl.y)) / wy) * nx + std::max(0, std::min(max_x, cl.x)) / wx;
+            window_cells.at(idx).push_back(cell);
+            owner[cell->name] = idx;
+        }
+        for (auto &w : windows)
+            w.owner = &owner;
+
+        ctx->batchUiReload = true;
+        for (int group = 0; group < 4; group++) {
+            auto is_active = [&](int idx) { return (((idx % nx) & 1) | (((idx / nx) & 1) << 1)) == group; };
+            std::vector<int> active;
+            for (int i = 0; i < int(windows.size()); i++)
+                if (is_active(i) && !window_cells.at(i).empty())
+                    active.push_back(i);
+            ctx->threadPool().parallel_for(
+                    active.size(), 1,
+                    [&](size_t i) {
+                        legalise_cells(windows.at(active.at(i)), window_cells.at(active.at(i)), require_validity);
+                    },
+                    cfg.threads);
+            for (int i : active) {
+                for (auto &loc : windows.at(i).locs) {
+                    cell_locs[ctx->cells.at(loc.first)->udata].x = loc.second.x;
+                    cell_locs[ctx->cells.at(loc.first)->udata].y = loc.second.y;
+                }
+            }
+        }
+        ctx->batchUiReload = false;
+        ctx->refreshUi();
+
+        std::unordered_set<IdString> seen;
+        for (auto &w : windows)
+            for (auto cell : w.deferred)
+                if (cell->bel == BelId() && seen.insert(cell->name).second)
+                    deferred.push_back(cell);
+        int window_placed = int(cells.size() - deferred.size());
+        log_info("        legalised %d cells in %d windows in parallel, %d left to legalise serially\n", window_placed,
+                 int(windows.size()), int(deferred.size()));
+        return deferred;
+    }
+
+    // Legalise the single cells of the cfg.hardBlockTypes by a minimum cost matching between them and the free bels of
+    // their type, the cost being the distance from the solved position. This is deterministic, close to the least total
+    // displacement, and fast as these cells are few and their bels sparse, where the greedy random search of
+    // legalise_cells is slow and leaves the columns in a poor order. Returns the other cells, and those whose bel
+    // turned out not to be valid, for the other legalisers.
+    std::vector<CellInfo *> legalise_hard_blocks(const std::vector<CellInfo *> &cells, bool require_validity)
+    {
+        std::vector<CellInfo *> rest;
+        std::map<int, std::vector<CellInfo *>> by_type;
+        for (auto cell : cells) {
+            if (cfg.hardBlockTypes.count(cell->type) && cell->constr_children.empty() && !cell->constr_abs_z)
+                by_type[std::get<0>(bel_types.at(cell->type))].push_back(cell);
+            else
+                rest.push_back(cell);
+        }
+        int matched = 0;
+        int64_t total_cost = 0;
+        for (auto &type_cells : by_type) {
+            std::vector<BelId> sites;
+            for (BelId bel : fast_bels.at(type_cells.first).bels)
+                if (ctx->checkBelAvail(bel))
+                    sites.push_back(bel);
+            std::vector<int> cell_site;
+            if (!match_hard_blocks(type_cells.second, sites, cell_site)) {
+                // Not enough bels; leave it to the greedy legaliser to report
+                rest.insert(rest.end(), type_cells.second.begin(), type_cells.second.end());
+                continue;
+            }
+            for (int i = 0; i < int(type_cells.second.size()); i++) {
+                CellInfo *ci = type_cells.second.at(i);
+                BelId bel = sites.at(cell_site.at(i));
+                ctx->bindBel(bel, ci, STRENGTH_WEAK);
+                if (require_validity && !ctx->isBelLocationValid(bel)) {
+                    ctx->unbindBel(bel);
+                    rest.push_back(ci);
+                    continue;
+                }
+                Loc loc = ctx->getBelLocation(bel);
+                auto &cl = cell_locs[ci->udata];
+                total_cost += std::abs(loc.x - cl.x) + std::abs(loc.y - cl.y);
+                cl.x = loc.x;
+                cl.y = loc.y;
+                ++matched;
+            }
+        }
+        if (matched > 0)
+            log_info("        legalised %d hard blocks by matching, mean displacement %.1f\n", matched,
+                     double(total_cost) / matched);
+        return rest;
+    }
+
+    // Minimum cost assignment of cells to distinct sites by shortest augmenting paths (the Hungarian method), with
+    // the edges of each cell limited to its nearest sites, so that an augmentation only explores the neighbourhood of
+    // the congestion it resolves; the result is optimal for the edges kept. If that leaves no assignment, retry with
+    // more edges. Returns false if there are
+    // fewer sites than cells.
+    bool match_hard_blocks(const std::vector<CellInfo *> &cells, const std::vector<BelId> &sites,
+                           std::vector<int> &cell_site)
+    {
+        const int n = int(cells.size()), m = int(sites.size());
+        const int64_t inf = std::numeric_limits<int64_t>::max() / 4;
+        std::vector<Loc> site_locs;
+        for (BelId bel : sites)
+            site_locs.push_back(ctx->getBelLocation(bel));
+        // Edge e of cell i, for e from edge_begin[i] to edge_begin[i + 1], is to edge_site[e] at edge_cost[e]
+        std::vector<int> edge_begin, edge_site;
+        std::vector<int64_t> edge_cost;
+        auto build_edges = [&](int k) {
+            edge_begin.assign(1, 0);
+            edge_site.clear();
+            edge_cost.clear();
+            std::vector<std::pair<int64_t, int>> cand;
+            for (auto cell : cells) {
+                auto &cl = cell_locs[cell->udata];
+                bool constr_bels = cell->region != nullptr && cell->region->constr_bels;
+                cand.clear();
+                for (int j = 0; j < m; j++) {
+                    if (constr_bels && !cell->region->bels.count(sites[j]))
+                        continue;
+                    // Hundredths of a tile, so that the fractional solved position breaks ties
+                    double cost = cfg.hpwl_scale_x * std::abs(site_locs[j].x - cl.rawx) +
+                                  cfg.hpwl_scale_y * std::abs(site_locs[j].y - cl.rawy);
+                    cand.emplace_back(int64_t(100 * cost), j);
+                }
+                if (int(cand.size()) > k) {
+                    std::nth_element(cand.begin(), cand.begin() + k, cand.end());
+                    cand.resize(k);
+                }
+                for (auto &c : cand) {
+                    edge_site.push_back(c.second);
+                    edge_cost.push_back(c.first);
+                }
+                edge_begin.push_back(int(edge_site.size()));
+            }
+        };
+
+        if (m < n)
+            return false;
+        std::vector<int> site_cell, pred;
+        std::vector<int64_t> u, v, dist;
+        std::vector<int> scanned, touched;
+        for (int k = std::min(m, 32);; k = std::min(m, 4 * k)) {
+            build_edges(k);
+            cell_site.assign(n, -1);
+            site_cell.assign(m, -1);
+            pred.assign(m, -1);
+            u.assign(n, 0);
+            v.assign(m, 0);
+            dist.assign(m, inf);
+            bool failed = false;
+            for (int s = 0; s < n && !failed; s++) {
+                // The potentials u and v keep the reduced costs c - u - v of all edges at or above zero, and zero on
+                // matched edges, so that Dijkstra finds the shortest augmenting path from s to a free site
+                u[s] = inf;
+                for (int e = edge_begin[s]; e < edge_begin[s + 1]; e++)
+                    u[s] = std::min(u[s], edge_cost[e] - v[edge_site[e]]);
+                std::priority_queue<std::pair<int64_t, int>, std::vector<std::pair<int64_t, int>>,
+                                    std::greater<std::pair<int64_t, int>>>
+                        queue;
+                auto relax = [&](int i, int64_t base) {
+                    for (int e = edge_begin[i]; e < edge_begin[i + 1]; e++) {
+                        int j = edge_site[e];
+                        int64_t d = base + edge_cost[e] - u[i] - v[j];
+                        if (d < dist[j]) {
+                            if (dist[j] == inf)
+                                touched.push_back(j);
+                            dist[j] = d;
+                            pred[j] = i;
+                            queue.emplace(d, j);
+                        }
+                    }
+                };
+                relax(s, 0);
+                int target = -1;
+                while (!queue.empty()) {
+                    auto top = queue.top();
+                    queue.pop();
+                    if (top.first > dist[top.second])
+                        continue;
+                    int j = top.second;
+                    scanned.push_back(j);
+                    if (site_cell[j] == -1) {
+                        target = j;
+                        break;
+                    }
+                    relax(site_cell[j], top.first);
+                }
+                if (target == -1) {
+                    failed = true;
+                } else {
+                    int64_t length = dist[target];
+                    for (int j : scanned) {
+                        v[j] += dist[j] - length;
+                        if (site_cell[j] != -1)
+                            u[site_cell[j]] -= dist[j] - length;
+                    }
+                    u[s] += length;
+                    for (int j = target;;) {
+                        int i = pred[j], prev = cell_site[i];
+                        cell_site[i] = j;
+                        site_cell[j] = i;
+                        if (i == s)
+                            break;
+                        j = prev;
+                    }
+                }
+                for (int j : touched)
+                    dist[j] = inf;
+                touched.clear();
+                scanned.clear();
+            }
+            if (!failed)
+                return true;
+            // Region constrained cells may have no assignment at all
+            if (k == m)
+                return false;
+        }
+    }
+
     // Implementation of the cut-based spreading as described in the HeAP/SimPL papers
 
     template <typename T> T limit_to_reg(Region *reg, T val, bool dir)
     {
         if (reg == nullptr)
             return val;
-        int limit_low = dir ? constraint_region_bounds[reg->name].y0 : constraint_region_bounds[reg->name].x0;
-        int limit_high = dir ? constraint_region_bounds[reg->name].y1 : constraint_region_bounds[reg->name].x1;
+        auto &bounds = constraint_region_bounds.at(reg->name);
+        int limit_low = dir ? bounds.y0 : bounds.x0;
+        int limit_high = dir ? bounds.y1 : bounds.x1;
         return std::max<T>(std::min<T>(val, limit_high), limit_low);
     }
 
@@ -1087,6 +2288,7 @@ class HeAPPlacer
         static int seq;
         void run()
         {
+            NPNR_TRACE_SCOPE("spread");
             auto startt = std::chrono::high_resolution_clock::now();
             init();
             find_overused_regions();
@@ -1099,13 +2301,13 @@ class HeAPPlacer
 #endif
             }
             expand_regions();
-            std::queue<std::pair<int, bool>> workqueue;
 #if 0
             std::vector<std::pair<double, double>> orig;
             if (ctx->debug)
                 for (auto c : p->solve_cells)
-                    orig.emplace_back(p->cell_locs[c->name].rawx, p->cell_locs[c->name].rawy);
+                    orig.emplace_back(p->cell_locs[c->udata].rawx, p->cell_locs[c->udata].rawy);
 #endif
+            std::vector<int> roots;
             for (auto &r : regions) {
                 if (merged_regions.count(r.id))
                     continue;
@@ -1116,28 +2318,32 @@ class HeAPPlacer
                 }
 
 #endif
-                workqueue.emplace(r.id, false);
-                // cut_region(r, false);
+                roots.push_back(r.id);
             }
-            while (!workqueue.empty()) {
-                auto front = workqueue.front();
-                workqueue.pop();
-                auto &r = regions.at(front.first);
-                if (std::all_of(r.cells.begin(), r.cells.end(), [](int x) { return x == 0; }))
-                    continue;
-                auto res = cut_region(r, front.second);
-                if (res) {
-                    workqueue.emplace(res->first, !front.second);
-                    workqueue.emplace(res->second, !front.second);
-                } else {
-                    // Try the other dir, in case stuck in one direction only
-                    auto res2 = cut_region(r, !front.second);
-                    if (res2) {
-                        // log_info("RETRY SUCCESS\n");
-                        workqueue.emplace(res2->first, front.second);
-                        workqueue.emplace(res2->second, front.second);
-                    }
-                }
+            // Once expanded, the top-level regions are disjoint and are cut independently of each other, so they can
+            // be spread in parallel with the same result as spreading them one after another
+            int threads = std::min<int>(p->cfg.threads, roots.size());
+            if (int(p->cl_thread_time.size()) < threads)
+                p->cl_thread_time.resize(threads, 0);
+            std::atomic<int> next_root(0);
+            auto worker = [&](int thread) {
+                NPNR_TRACE_SCOPE_ARG("spread regions", "thread", thread);
+                auto wstart = std::chrono::high_resolution_clock::now();
+                std::vector<CellInfo *> cut_cells;
+                for (int i = next_root++; i < int(roots.size()); i = next_root++)
+                    spread_region(regions.at(roots.at(i)), cut_cells);
+                auto wend = std::chrono::high_resolution_clock::now();
+                p->cl_thread_time.at(thread) += std::chrono::duration<double>(wend - wstart).count();
+            };
+            if (threads <= 1) {
+                if (!roots.empty())
+                    worker(0);
+            } else {
+                ThreadPool::TaskGroup workers(ctx->threadPool());
+                for (int i = 1; i < threads; i++)
+                    workers.run([&worker, i]() { worker(i); });
+                worker(0);
+                workers.wait();
             }
 #if 0
             if (ctx->debug) {
@@ -1146,7 +2352,7 @@ class HeAPPlacer
                     auto &c = p->solve_cells.at(i);
                     if (c->type != beltype)
                         continue;
-                    sp << orig.at(i).first << "," << orig.at(i).second << "," << p->cell_locs[c->name].rawx << "," << p->cell_locs[c->name].rawy << std::endl;
+                    sp << orig.at(i).first << "," << orig.at(i).second << "," << p->cell_locs[c->udata].rawx << "," << p->cell_locs[c->udata].rawy << std::endl;
                 }
                 std::ofstream oc("cells" + std::to_string(seq) + ".csv");
                 for (size_t y = 0; y <= p->max_y; y++) {
@@ -1167,47 +2373,61 @@ class HeAPPlacer
         Context *ctx;
         std::unordered_set<IdString> beltype;
         std::unordered_map<IdString, int> type_index;
-        std::vector<std::vector<std::vector<int>>> occupancy;
+        // Cells of each type at each location, at (x * (max_y + 1) + y) * types + type, and summed over the locations
+        // left of x and below y, at (x * (max_y + 2) + y) * types + type. Cells don't move while the spreader finds
+        // and grows regions, so both are built once by init()
+        std::vector<int> occupancy, occ_prefix;
         std::vector<std::vector<int>> groups;
         std::vector<std::vector<ChainExtent>> chaines;
-        std::map<IdString, ChainExtent> cell_extents;
+        // Extent of each chain, indexed by the root's cell index; only valid where has_extent is set
+        std::vector<ChainExtent> cell_extents;
+        std::vector<bool> has_extent;
 
-        std::vector<std::vector<std::vector<std::vector<BelId>>> *> fb;
+        std::vector<const FastBelGrid *> fb;
 
         std::vector<SpreaderRegion> regions;
         std::unordered_set<int> merged_regions;
         // Cells at a location, sorted by real (not integer) x and y
         std::vector<std::vector<std::vector<CellInfo *>>> cells_at_location;
 
-        int occ_at(int x, int y, int type) { return occupancy.at(x).at(y).at(type); }
+        int occ_at(int x, int y, int type) { return occupancy[(x * (p->max_y + 1) + y) * int(beltype.size()) + type]; }
 
-        int bels_at(int x, int y, int type)
+        // Cells of a type in the locations x0..x1, y0..y1 (inclusive)
+        int occ_in(int x0, int y0, int x1, int y1, int type)
         {
-            if (fb.at(type) == nullptr || x >= int(fb.at(type)->size()) || y >= int(fb.at(type)->at(x).size()))
-                return 0;
-            return int(fb.at(type)->at(x).at(y).size());
+            int h = p->max_y + 2, nt = int(beltype.size());
+            auto sum = [&](int x, int y) { return occ_prefix[(x * h + y) * nt + type]; };
+            return sum(x1 + 1, y1 + 1) - sum(x0, y1 + 1) - sum(x1 + 1, y0) + sum(x0, y0);
+        }
+
+        int bels_at(int x, int y, int type) { return fb.at(type) == nullptr ? 0 : fb.at(type)->count(x, y); }
+
+        // Bels of a type in the tiles x0..x1, y0..y1 (inclusive)
+        int bels_in(int x0, int y0, int x1, int y1, int type)
+        {
+            return fb.at(type) == nullptr ? 0 : fb.at(type)->count(x0, y0, x1, y1);
         }
 
         void init()
         {
-            occupancy.resize(p->max_x + 1,
-                             std::vector<std::vector<int>>(p->max_y + 1, std::vector<int>(beltype.size(), 0)));
+            int nt = int(beltype.size());
+            occupancy.assign((p->max_x + 1) * (p->max_y + 1) * nt, 0);
             groups.resize(p->max_x + 1, std::vector<int>(p->max_y + 1, -1));
             chaines.resize(p->max_x + 1, std::vector<ChainExtent>(p->max_y + 1));
             cells_at_location.resize(p->max_x + 1, std::vector<std::vector<CellInfo *>>(p->max_y + 1));
             for (int x = 0; x <= p->max_x; x++)
                 for (int y = 0; y <= p->max_y; y++) {
-                    for (int t = 0; t < int(beltype.size()); t++) {
-                        occupancy.at(x).at(y).at(t) = 0;
-                    }
                     groups.at(x).at(y) = -1;
                     chaines.at(x).at(y) = {x, y, x, y};
                 }
 
-            auto set_chain_ext = [&](IdString cell, int x, int y) {
-                if (!cell_extents.count(cell))
+            cell_extents.resize(p->cells_by_index.size());
+            has_extent.assign(p->cells_by_index.size(), false);
+            auto set_chain_ext = [&](int cell, int x, int y) {
+                if (!has_extent[cell]) {
                     cell_extents[cell] = {x, y, x, y};
-                else {
+                    has_extent[cell] = true;
+                } else {
                     cell_extents[cell].x0 = std::min(cell_extents[cell].x0, x);
                     cell_extents[cell].y0 = std::min(cell_extents[cell].y0, y);
                     cell_extents[cell].x1 = std::max(cell_extents[cell].x1, x);
@@ -1215,42 +2435,83 @@ class HeAPPlacer
                 }
             };
 
-            for (auto &cell : p->cell_locs) {
-                if (!beltype.count(ctx->cells.at(cell.first)->type))
+            for (int i = 0; i < int(p->cell_locs.size()); i++) {
+                auto &cl = p->cell_locs[i];
+                CellInfo *ci = p->cells_by_index[i];
+                if (!cl.valid || !beltype.count(ci->type))
                     continue;
-                if (ctx->cells.at(cell.first)->belStrength > STRENGTH_STRONG)
+                if (ci->belStrength > STRENGTH_STRONG)
                     continue;
-                occupancy.at(cell.second.x).at(cell.second.y).at(type_index.at(ctx->cells.at(cell.first)->type))++;
+                occupancy.at((cl.x * (p->max_y + 1) + cl.y) * nt + type_index.at(ci->type))++;
                 // Compute ultimate extent of each chain root
-                if (p->chain_root.count(cell.first)) {
-                    set_chain_ext(p->chain_root.at(cell.first)->name, cell.second.x, cell.second.y);
-                } else if (!ctx->cells.at(cell.first)->constr_children.empty()) {
-                    set_chain_ext(cell.first, cell.second.x, cell.second.y);
+                if (p->chain_root[i] != nullptr) {
+                    set_chain_ext(p->chain_root[i]->udata, cl.x, cl.y);
+                } else if (!ci->constr_children.empty()) {
+                    set_chain_ext(i, cl.x, cl.y);
                 }
             }
-            for (auto &cell : p->cell_locs) {
-                if (!beltype.count(ctx->cells.at(cell.first)->type))
+            for (int i = 0; i < int(p->cell_locs.size()); i++) {
+                auto &cl = p->cell_locs[i];
+                CellInfo *ci = p->cells_by_index[i];
+                if (!cl.valid || !beltype.count(ci->type))
                     continue;
                 // Transfer chain extents to the actual chaines structure
                 ChainExtent *ce = nullptr;
-                if (p->chain_root.count(cell.first))
-                    ce = &(cell_extents.at(p->chain_root.at(cell.first)->name));
-                else if (!ctx->cells.at(cell.first)->constr_children.empty())
-                    ce = &(cell_extents.at(cell.first));
+                if (p->chain_root[i] != nullptr)
+                    ce = &(cell_extents.at(p->chain_root[i]->udata));
+                else if (!ci->constr_children.empty())
+                    ce = &(cell_extents.at(i));
                 if (ce) {
-                    auto &lce = chaines.at(cell.second.x).at(cell.second.y);
+                    auto &lce = chaines.at(cl.x).at(cl.y);
                     lce.x0 = std::min(lce.x0, ce->x0);
                     lce.y0 = std::min(lce.y0, ce->y0);
                     lce.x1 = std::max(lce.x1, ce->x1);
                     lce.y1 = std::max(lce.y1, ce->y1);
                 }
             }
+            if (!p->cell_inflation.empty())
+                inflate_occupancy();
+            int h = p->max_y + 2;
+            occ_prefix.assign((p->max_x + 2) * h * nt, 0);
+            for (int x = 0; x <= p->max_x; x++)
+                for (int y = 0; y <= p->max_y; y++)
+                    for (int t = 0; t < nt; t++)
+                        occ_prefix.at(((x + 1) * h + y + 1) * nt + t) = occ_at(x, y, t) +
+                                                                        occ_prefix.at((x * h + y + 1) * nt + t) +
+                                                                        occ_prefix.at(((x + 1) * h + y) * nt + t) -
+                                                                        occ_prefix.at((x * h + y) * nt + t);
             for (auto cell : p->solve_cells) {
                 if (!beltype.count(cell->type))
                     continue;
-                cells_at_location.at(p->cell_locs.at(cell->name).x).at(p->cell_locs.at(cell->name).y).push_back(cell);
+                cells_at_location.at(p->cell_locs[cell->udata].x).at(p->cell_locs[cell->udata].y).push_back(cell);
+            }
+        }
+        // Count the cells in routing congested locations as more than one, so that the regions around them grow
+        // further and are spread more thinly. The cells actually moved are unchanged. The extra cells of a type are
+        // limited to half the free bels of that type, so that the whole device always remains large enough.
+        void inflate_occupancy()
+        {
+            int nt = int(beltype.size()), h = p->max_y + 1;
+            for (int t = 0; t < nt; t++) {
+                double cells = 0, extra = 0;
+                for (int x = 0; x <= p->max_x; x++)
+                    for (int y = 0; y <= p->max_y; y++) {
+                        int occ = occupancy[(x * h + y) * nt + t];
+                        cells += occ;
+                        extra += occ * (p->cell_inflation[x * h + y] - 1);
+                    }
+                double budget = std::max(0.0, (bels_in(0, 0, p->max_x, p->max_y, t) - cells) / 2);
+                if (extra <= 0 || budget <= 0)
+                    continue;
+                double scale = std::min(1.0, budget / extra);
+                for (int x = 0; x <= p->max_x; x++)
+                    for (int y = 0; y <= p->max_y; y++) {
+                        int &occ = occupancy[(x * h + y) * nt + t];
+                        occ += int(occ * (p->cell_inflation[x * h + y] - 1) * scale);
+                    }
             }
         }
+
         void merge_regions(SpreaderRegion &merged, SpreaderRegion &mergee)
         {
             // Prevent grow_region from recursing while doing this
@@ -1259,11 +2520,11 @@ class HeAPPlacer
                     // log_info("%d %d\n", groups.at(x).at(y), mergee.id);
                     NPNR_ASSERT(groups.at(x).at(y) == mergee.id);
                     groups.at(x).at(y) = merged.id;
-                    for (size_t t = 0; t < beltype.size(); t++) {
-                        merged.cells.at(t) += occ_at(x, y, t);
-                        merged.bels.at(t) += bels_at(x, y, t);
-                    }
                 }
+            for (size_t t = 0; t < beltype.size(); t++) {
+                merged.cells.at(t) += occ_in(mergee.x0, mergee.y0, mergee.x1, mergee.y1, t);
+                merged.bels.at(t) += bels_in(mergee.x0, mergee.y0, mergee.x1, mergee.y1, t);
+            }
             merged_regions.insert(mergee.id);
             grow_region(merged, mergee.x0, mergee.y0, mergee.x1, mergee.y1);
         }
@@ -1441,29 +2702,56 @@ class HeAPPlacer
             }
         }
 
+        // Recursively cut a top-level region. The sub-regions created are kept local, so that spreading only touches
+        // the cells and locations within the top-level region
+        void spread_region(const SpreaderRegion &root, std::vector<CellInfo *> &cut_cells)
+        {
+            std::vector<SpreaderRegion> subregions{root};
+            subregions.front().id = 0;
+            std::queue<std::pair<int, bool>> workqueue;
+            workqueue.emplace(0, false);
+            while (!workqueue.empty()) {
+                auto front = workqueue.front();
+                workqueue.pop();
+                auto &r = subregions.at(front.first);
+                if (std::all_of(r.cells.begin(), r.cells.end(), [](int x) { return x == 0; }))
+                    continue;
+                auto res = cut_region(subregions, r, front.second, cut_cells);
+                if (res) {
+                    workqueue.emplace(res->first, !front.second);
+                    workqueue.emplace(res->second, !front.second);
+                } else {
+                    // Try the other dir, in case stuck in one direction only
+                    auto res2 = cut_region(subregions, subregions.at(front.first), !front.second, cut_cells);
+                    if (res2) {
+                        // log_info("RETRY SUCCESS\n");
+                        workqueue.emplace(res2->first, front.second);
+                        workqueue.emplace(res2->second, front.second);
+                    }
+                }
+            }
+        }
+
         // Implementation of the recursive cut-based spreading as described in the HeAP paper
         // Note we use "left" to mean "-x/-y" depending on dir and "right" to mean "+x/+y" depending on dir
-
-        std::vector<CellInfo *> cut_cells;
-
-        boost::optional<std::pair<int, int>> cut_region(SpreaderRegion &r, bool dir)
+        // The two halves are appended to subregions (which r is part of), and their indices returned
+        boost::optional<std::pair<int, int>> cut_region(std::vector<SpreaderRegion> &subregions, SpreaderRegion &r,
+                                                        bool dir, std::vector<CellInfo *> &cut_cells)
         {
             cut_cells.clear();
             auto &cal = cells_at_location;
             int total_cells = 0, total_bels = 0;
-            for (int x = r.x0; x <= r.x1; x++) {
-                for (int y = r.y0; y <= r.y1; y++) {
+            for (int x = r.x0; x <= r.x1; x++)
+                for (int y = r.y0; y <= r.y1; y++)
                     std::copy(cal.at(x).at(y).begin(), cal.at(x).at(y).end(), std::back_inserter(cut_cells));
-                    for (size_t t = 0; t < beltype.size(); t++)
-                        total_bels += bels_at(x, y, t);
-                }
-            }
+            for (size_t t = 0; t < beltype.size(); t++)
+                total_bels += bels_in(r.x0, r.y0, r.x1, r.y1, t);
             for (auto &cell : cut_cells) {
-                total_cells += p->chain_size.count(cell->name) ? p->chain_size.at(cell->name) : 1;
+                total_cells += std::max(1, p->chain_size[cell->udata]);
             }
             std::sort(cut_cells.begin(), cut_cells.end(), [&](const CellInfo *a, const CellInfo *b) {
-                return dir ? (p->cell_locs.at(a->name).rawy < p->cell_locs.at(b->name).rawy)
-                           : (p->cell_locs.at(a->name).rawx < p->cell_locs.at(b->name).rawx);
+                return dir ? (p->cell_locs[a->udata].rawy < p->cell_locs[b->udata].rawy)
+                           : (p->cell_locs[a->udata].rawx < p->cell_locs[b->udata].rawx);
             });
 
             if (cut_cells.size() < 2)
@@ -1472,7 +2760,7 @@ class HeAPPlacer
             int pivot_cells = 0;
             int pivot = 0;
             for (auto &cell : cut_cells) {
-                pivot_cells += p->chain_size.count(cell->name) ? p->chain_size.at(cell->name) : 1;
+                pivot_cells += std::max(1, p->chain_size[cell->udata]);
                 if (pivot_cells >= total_cells / 2)
                     break;
                 pivot++;
@@ -1487,8 +2775,8 @@ class HeAPPlacer
             int clearance_l = 0, clearance_r = 0;
             for (size_t i = 0; i < cut_cells.size(); i++) {
                 int size;
-                if (cell_extents.count(cut_cells.at(i)->name)) {
-                    auto &ce = cell_extents.at(cut_cells.at(i)->name);
+                if (has_extent[cut_cells.at(i)->udata]) {
+                    auto &ce = cell_extents.at(cut_cells.at(i)->udata);
                     size = dir ? (ce.y1 - ce.y0 + 1) : (ce.x1 - ce.x0 + 1);
                 } else {
                     size = 1;
@@ -1504,30 +2792,20 @@ class HeAPPlacer
             // First trim the boundaries of the region in the axis-of-interest, skipping any rows/cols without any
             // bels of the appropriate type
             int trimmed_l = dir ? r.y0 : r.x0, trimmed_r = dir ? r.y1 : r.x1;
-            while (trimmed_l < (dir ? r.y1 : r.x1)) {
-                bool have_bels = false;
-                for (int i = dir ? r.x0 : r.y0; i <= (dir ? r.x1 : r.y1); i++)
-                    for (size_t t = 0; t < beltype.size(); t++)
-                        if (bels_at(dir ? i : trimmed_l, dir ? trimmed_l : i, t) > 0) {
-                            have_bels = true;
-                            break;
-                        }
-                if (have_bels)
-                    break;
+            // Bels of the given type in row/column i of the region
+            auto slice_bels = [&](int i, size_t t) {
+                return dir ? bels_in(r.x0, i, r.x1, i, t) : bels_in(i, r.y0, i, r.y1, t);
+            };
+            auto slice_has_bels = [&](int i) {
+                for (size_t t = 0; t < beltype.size(); t++)
+                    if (slice_bels(i, t) > 0)
+                        return true;
+                return false;
+            };
+            while (trimmed_l < (dir ? r.y1 : r.x1) && !slice_has_bels(trimmed_l))
                 trimmed_l++;
-            }
-            while (trimmed_r > (dir ? r.y0 : r.x0)) {
-                bool have_bels = false;
-                for (int i = dir ? r.x0 : r.y0; i <= (dir ? r.x1 : r.y1); i++)
-                    for (size_t t = 0; t < beltype.size(); t++)
-                        if (bels_at(dir ? i : trimmed_r, dir ? trimmed_r : i, t) > 0) {
-                            have_bels = true;
-                            break;
-                        }
-                if (have_bels)
-                    break;
+            while (trimmed_r > (dir ? r.y0 : r.x0) && !slice_has_bels(trimmed_r))
                 trimmed_r--;
-            }
             // log_info("tl %d tr %d cl %d cr %d\n", trimmed_l, trimmed_r, clearance_l, clearance_r);
             if ((trimmed_r - trimmed_l + 1) <= std::max(clearance_l, clearance_r))
                 return {};
@@ -1537,10 +2815,10 @@ class HeAPPlacer
             std::vector<int> left_bels_v(beltype.size(), 0), right_bels_v(r.bels);
             for (int i = 0; i <= pivot; i++)
                 left_cells_v.at(type_index.at(cut_cells.at(i)->type)) +=
-                        p->chain_size.count(cut_cells.at(i)->name) ? p->chain_size.at(cut_cells.at(i)->name) : 1;
+                        std::max(1, p->chain_size[cut_cells.at(i)->udata]);
             for (int i = pivot + 1; i < int(cut_cells.size()); i++)
                 right_cells_v.at(type_index.at(cut_cells.at(i)->type)) +=
-                        p->chain_size.count(cut_cells.at(i)->name) ? p->chain_size.at(cut_cells.at(i)->name) : 1;
+                        std::max(1, p->chain_size[cut_cells.at(i)->udata]);
 
             int best_tgt_cut = -1;
             double best_deltaU = std::numeric_limits<double>::max();
@@ -1548,11 +2826,7 @@ class HeAPPlacer
             std::vector<int> slither_bels(beltype.size(), 0);
             for (int i = trimmed_l; i <= trimmed_r; i++) {
                 for (size_t t = 0; t < beltype.size(); t++)
-                    slither_bels.at(t) = 0;
-                for (int j = dir ? r.x0 : r.y0; j <= (dir ? r.x1 : r.y1); j++) {
-                    for (size_t t = 0; t < beltype.size(); t++)
-                        slither_bels.at(t) += dir ? bels_at(j, i, t) : bels_at(i, j, t);
-                }
+                    slither_bels.at(t) = slice_bels(i, t);
                 for (size_t t = 0; t < beltype.size(); t++) {
                     left_bels_v.at(t) += slither_bels.at(t);
                     right_bels_v.at(t) -= slither_bels.at(t);
@@ -1576,21 +2850,10 @@ class HeAPPlacer
             // left_bels = target_cut_bels.first;
             // right_bels = target_cut_bels.second;
             for (size_t t = 0; t < beltype.size(); t++) {
-                left_bels_v.at(t) = 0;
-                right_bels_v.at(t) = 0;
+                left_bels_v.at(t) = bels_in(r.x0, r.y0, dir ? r.x1 : best_tgt_cut, dir ? best_tgt_cut : r.y1, t);
+                right_bels_v.at(t) =
+                        bels_in(dir ? r.x0 : (best_tgt_cut + 1), dir ? (best_tgt_cut + 1) : r.y0, r.x1, r.y1, t);
             }
-            for (int x = r.x0; x <= (dir ? r.x1 : best_tgt_cut); x++)
-                for (int y = r.y0; y <= (dir ? best_tgt_cut : r.y1); y++) {
-                    for (size_t t = 0; t < beltype.size(); t++) {
-                        left_bels_v.at(t) += bels_at(x, y, t);
-                    }
-                }
-            for (int x = dir ? r.x0 : (best_tgt_cut + 1); x <= r.x1; x++)
-                for (int y = dir ? (best_tgt_cut + 1) : r.y0; y <= r.y1; y++) {
-                    for (size_t t = 0; t < beltype.size(); t++) {
-                        right_bels_v.at(t) += bels_at(x, y, t);
-                    }
-                }
             if (std::accumulate(left_bels_v.begin(), left_bels_v.end(), 0) == 0 ||
                 std::accumulate(right_bels_v.begin(), right_bels_v.end(), 0) == 0)
                 return {};
@@ -1611,14 +2874,14 @@ class HeAPPlacer
             };
             while (pivot > 0 && is_part_overutil(false)) {
                 auto &move_cell = cut_cells.at(pivot);
-                int size = p->chain_size.count(move_cell->name) ? p->chain_size.at(move_cell->name) : 1;
+                int size = std::max(1, p->chain_size[move_cell->udata]);
                 left_cells_v.at(type_index.at(cut_cells.at(pivot)->type)) -= size;
                 right_cells_v.at(type_index.at(cut_cells.at(pivot)->type)) += size;
                 pivot--;
             }
             while (pivot < int(cut_cells.size()) - 1 && is_part_overutil(true)) {
                 auto &move_cell = cut_cells.at(pivot + 1);
-                int size = p->chain_size.count(move_cell->name) ? p->chain_size.at(move_cell->name) : 1;
+                int size = std::max(1, p->chain_size[move_cell->udata]);
                 left_cells_v.at(type_index.at(cut_cells.at(pivot)->type)) += size;
                 right_cells_v.at(type_index.at(cut_cells.at(pivot)->type)) -= size;
                 pivot++;
@@ -1630,8 +2893,8 @@ class HeAPPlacer
                 int N = cells_end - cells_start;
                 if (N <= 2) {
                     for (int i = cells_start; i < cells_end; i++) {
-                        auto &pos = dir ? p->cell_locs.at(cut_cells.at(i)->name).rawy
-                                        : p->cell_locs.at(cut_cells.at(i)->name).rawx;
+                        auto &pos = dir ? p->cell_locs[cut_cells.at(i)->udata].rawy
+                                        : p->cell_locs[cut_cells.at(i)->udata].rawx;
                         pos = area_l + i * ((area_r - area_l) / N);
                     }
                     return;
@@ -1645,10 +2908,10 @@ class HeAPPlacer
                 bin_bounds.emplace_back(cells_end, area_r + 0.99);
                 for (int i = 0; i < K; i++) {
                     auto &bl = bin_bounds.at(i), br = bin_bounds.at(i + 1);
-                    double orig_left = dir ? p->cell_locs.at(cut_cells.at(bl.first)->name).rawy
-                                           : p->cell_locs.at(cut_cells.at(bl.first)->name).rawx;
-                    double orig_right = dir ? p->cell_locs.at(cut_cells.at(br.first - 1)->name).rawy
-                                            : p->cell_locs.at(cut_cells.at(br.first - 1)->name).rawx;
+                    double orig_left = dir ? p->cell_locs[cut_cells.at(bl.first)->udata].rawy
+                                           : p->cell_locs[cut_cells.at(bl.first)->udata].rawx;
+                    double orig_right = dir ? p->cell_locs[cut_cells.at(br.first - 1)->udata].rawy
+                                            : p->cell_locs[cut_cells.at(br.first - 1)->udata].rawx;
                     double m = (br.second - bl.second) / std::max(0.00001, orig_right - orig_left);
                     for (int j = bl.first; j < br.first; j++) {
                         Region *cr = cut_cells.at(j)->region;
@@ -1657,13 +2920,13 @@ class HeAPPlacer
                             double brsc = p->limit_to_reg(cr, br.second, dir);
                             double blsc = p->limit_to_reg(cr, bl.second, dir);
                             double mr = (brsc - blsc) / std::max(0.00001, orig_right - orig_left);
-                            auto &pos = dir ? p->cell_locs.at(cut_cells.at(j)->name).rawy
-                                            : p->cell_locs.at(cut_cells.at(j)->name).rawx;
+                            auto &pos = dir ? p->cell_locs[cut_cells.at(j)->udata].rawy
+                                            : p->cell_locs[cut_cells.at(j)->udata].rawx;
                             NPNR_ASSERT(pos >= orig_left && pos <= orig_right);
                             pos = blsc + mr * (pos - orig_left);
                         } else {
-                            auto &pos = dir ? p->cell_locs.at(cut_cells.at(j)->name).rawy
-                                            : p->cell_locs.at(cut_cells.at(j)->name).rawx;
+                            auto &pos = dir ? p->cell_locs[cut_cells.at(j)->udata].rawy
+                                            : p->cell_locs[cut_cells.at(j)->udata].rawx;
                             NPNR_ASSERT(pos >= orig_left && pos <= orig_right);
                             pos = bl.second + m * (pos - orig_left);
                         }
@@ -1680,35 +2943,29 @@ class HeAPPlacer
                     cells_at_location.at(x).at(y).clear();
                 }
             for (auto cell : cut_cells) {
-                auto &cl = p->cell_locs.at(cell->name);
+                auto &cl = p->cell_locs[cell->udata];
                 cl.x = std::min(r.x1, std::max(r.x0, int(cl.rawx)));
                 cl.y = std::min(r.y1, std::max(r.y0, int(cl.rawy)));
                 cells_at_location.at(cl.x).at(cl.y).push_back(cell);
                 // log_info("spread pos %d %d\n", cl.x, cl.y);
             }
             SpreaderRegion rl, rr;
-            rl.id = int(regions.size());
+            rl.id = int(subregions.size());
             rl.x0 = r.x0;
             rl.y0 = r.y0;
             rl.x1 = dir ? r.x1 : best_tgt_cut;
             rl.y1 = dir ? best_tgt_cut : r.y1;
             rl.cells = left_cells_v;
             rl.bels = left_bels_v;
-            rr.id = int(regions.size()) + 1;
+            rr.id = int(subregions.size()) + 1;
             rr.x0 = dir ? r.x0 : (best_tgt_cut + 1);
             rr.y0 = dir ? (best_tgt_cut + 1) : r.y0;
             rr.x1 = r.x1;
             rr.y1 = r.y1;
             rr.cells = right_cells_v;
             rr.bels = right_bels_v;
-            regions.push_back(rl);
-            regions.push_back(rr);
-            for (int x = rl.x0; x <= rl.x1; x++)
-                for (int y = rl.y0; y <= rl.y1; y++)
-                    groups.at(x).at(y) = rl.id;
-            for (int x = rr.x0; x <= rr.x1; x++)
-                for (int y = rr.y0; y <= rr.y1; y++)
-                    groups.at(x).at(y) = rr.id;
+            subregions.push_back(rl);
+            subregions.push_back(rr);
             return std::make_pair(rl.id, rr.id);
         };
     };
@@ -1717,7 +2974,86 @@ class HeAPPlacer
 };
 int HeAPPlacer::CutSpreader::seq = 0;
 
-bool placer_heap(Context *ctx, PlacerHeapCfg cfg) { return HeAPPlacer(ctx, cfg).place(); }
+namespace {
+// Total HPWL of the placement, with each net weighted by the criticality of its most critical arc in the same way
+// that HeAP weights arcs in the equation system
+double weighted_wirelength(Context *ctx, const PlacerHeapCfg &cfg)
+{
+    NetCriticalityMap net_crit;
+    if (cfg.timing_driven)
+        update_criticalities(ctx, cfg, &net_crit);
+    double total = 0;
+    for (auto &net : ctx->nets) {
+        float tns = 0;
+        double weight = 1;
+        if (net_crit.has(net.second.get())) {
+            auto &nc = net_crit.at(net.second.get());
+            float crit = *std::max_element(net_crit.criticality.begin() + nc.arc_begin,
+                                           net_crit.criticality.begin() + nc.arc_end);
+            weight += cfg.timingWeight * std::pow(crit, cfg.criticalityExponent);
+        }
+        total += weight * get_net_metric(ctx, net.second.get(), MetricType::WIRELENGTH, tns);
+    }
+    return total;
+}
+
+typedef std::vector<std::pair<CellInfo *, std::pair<BelId, PlaceStrength>>> placement_t;
+
+placement_t save_placement(Context *ctx)
+{
+    placement_t placement;
+    for (auto &cell : ctx->cells)
+        if (cell.second->bel != BelId())
+            placement.emplace_back(cell.second.get(), std::make_pair(cell.second->bel, cell.second->belStrength));
+    return placement;
+}
+
+void restore_placement(Context *ctx, const placement_t &placement)
+{
+    for (auto &cell : ctx->cells)
+        if (cell.second->bel != BelId())
+            ctx->unbindBel(cell.second->bel);
+    for (auto &entry : placement)
+        ctx->bindBel(entry.second.first, entry.first, entry.second.second);
+}
+} // namespace
+
+bool placer_heap(Context *ctx, PlacerHeapCfg cfg)
+{
+    if (!cfg.reference.empty() && !load_reference_locs(ctx, cfg.reference, cfg.referenceLocs))
+        log_error("Loading HeAP reference placement '%s' failed.\n", cfg.reference.c_str());
+    if (cfg.starts <= 1)
+        return HeAPPlacer(ctx, cfg).place();
+
+    // Place from the same starting point with a different random seed each time, keeping the best result. The first
+    // start uses the current random state, so is the same as a single run.
+    placement_t initial = save_placement(ctx), best;
+    uint64_t base_seed = ctx->rngstate, best_rngstate = 0;
+    double best_cost = std::numeric_limits<double>::max();
+    int best_start = -1;
+    for (int start = 0; start < cfg.starts; start++) {
+        log_info("Running HeAP placement start %d/%d.\n", start + 1, cfg.starts);
+        if (start > 0) {
+            restore_placement(ctx, initial);
+            ctx->rngseed(base_seed + start);
+        }
+        if (!HeAPPlacer(ctx, cfg).place())
+            return false;
+        double cost = weighted_wirelength(ctx, cfg);
+        log_info("    placement start %d: weighted wirelength = %.0f\n", start + 1, cost);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_start = start;
+            best = save_placement(ctx);
+            best_rngstate = ctx->rngstate;
+        }
+    }
+    log_info("Keeping placement start %d.\n", best_start + 1);
+    if (best_start != cfg.starts - 1)
+        restore_placement(ctx, best);
+    ctx->rngstate = best_rngstate;
+    return true;
+}
 
 PlacerHeapCfg::PlacerHeapCfg(Context *ctx)
 {
@@ -1726,8 +3062,45 @@ PlacerHeapCfg::PlacerHeapCfg(Context *ctx)
     criticalityExponent = ctx->setting<int>("placerHeap/criticalityExponent", 2);
     timingWeight = ctx->setting<int>("placerHeap/timingWeight", 10);
     timing_driven = ctx->setting<bool>("timing_driven");
+    minCriticality = std::max(0.0f, ctx->setting<float>("placerHeap/minCriticality", 0));
     solverTolerance = 1e-5;
+    std::string precond = str_or_default(ctx->settings, ctx->id("placerHeap/solverPreconditioner"), "jacobi");
+    if (precond == "none")
+        solverPreconditioner = PRECOND_NONE;
+    else if (precond == "jacobi")
+        solverPreconditioner = PRECOND_JACOBI;
+    else if (precond == "ichol")
+        solverPreconditioner = PRECOND_ICHOL;
+    else
+        log_error("Unknown HeAP solver preconditioner '%s', expected 'none', 'jacobi' or 'ichol'\n", precond.c_str());
+    std::string solver = str_or_default(ctx->settings, ctx->id("placerHeap/solver"), "eigen");
+    gpuSolver = false;
+    if (solver == "gpu") {
+        std::string error;
+        gpuSolver = HeapGpuSolver::available(error);
+        if (gpuSolver)
+            log_info("Solving HeAP equations on %s.\n", HeapGpuSolver::device_name().c_str());
+        else
+            log_warning("No device for the HeAP GPU solver (%s), using Eigen.\n", error.c_str());
+    } else if (solver != "eigen") {
+        log_error("Unknown HeAP solver '%s', expected 'eigen' or 'gpu'\n", solver.c_str());
+    }
+    threads = std::max(1, ctx->setting<int>("threads", std::max<int>(1, std::thread::hardware_concurrency())));
     placeAllAtOnce = false;
+    starts = std::max(1, ctx->setting<int>("placerHeap/starts", 1));
+    parallelLegalise = ctx->setting<bool>("placerHeap/parallelLegalise", false);
+    legaliseWindowX = std::max(4, ctx->setting<int>("placerHeap/legaliseWindowX", 30));
+    legaliseWindowY = std::max(4, ctx->setting<int>("placerHeap/legaliseWindowY", 60));
+    starFanout = std::max(0, ctx->setting<int>("placerHeap/starFanout", 0));
+    starDropIters = std::max(0, ctx->setting<int>("placerHeap/starDropIters", 0));
+    multilevel = std::max(0, ctx->setting<int>("placerHeap/multilevel", 0));
+    multilevelRefine = std::max(1, ctx->setting<int>("placerHeap/multilevelRefine", 2));
+    regionSolve = ctx->setting<bool>("placerHeap/regionSolve", false);
+    routabilityRatio = std::max(0.0f, ctx->setting<float>("placerHeap/routabilityRatio", 0));
+    routabilityMaxInflation = std::max(1.0f, ctx->setting<float>("placerHeap/routabilityMaxInflation", 2.0));
+    reference = str_or_default(ctx->settings, ctx->id("placerHeap/reference"), "");
+    referenceIters = std::max(1, ctx->setting<int>("placerHeap/referenceIters", 3));
+    referenceRounds = std::max(1, ctx->setting<int>("placerHeap/referenceRounds", 10));
 
     hpwl_scale_x = 1;
     hpwl_scale_y = 1;
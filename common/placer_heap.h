@@ -39,15 +39,63 @@ struct PlacerHeapCfg
     float criticalityExponent;
     float timingWeight;
     bool timing_driven;
+    // If above zero, only arcs that may reach this criticality are weighted, using the cheaper cone-limited timing
+    // analysis; the weight of an arc below it is small anyway with the default exponent
+    float minCriticality;
     float solverTolerance;
+    // Preconditioner for the conjugate gradient solver
+    enum SolverPreconditioner
+    {
+        PRECOND_NONE,
+        PRECOND_JACOBI,
+        PRECOND_ICHOL
+    } solverPreconditioner;
+    // Run the conjugate gradient solver on an OpenCL device rather than with Eigen (placerHeap/solver=gpu), where the
+    // build has it and a device is found; incomplete Cholesky is replaced by Jacobi preconditioning on the device
+    bool gpuSolver;
+    // Worker threads for the spreader, and for the solver where built with OpenMP
+    int threads;
     bool placeAllAtOnce;
     float netShareWeight;
+    // Number of placement runs with different seeds, of which the one with the lowest criticality weighted
+    // wirelength is kept
+    int starts;
+    // Legalise in parallel within windows of this many tiles, about a clock region on Xilinx devices, before the
+    // serial legaliser picks up the cells that did not fit in their window
+    bool parallelLegalise;
+    int legaliseWindowX, legaliseWindowY;
+    // If above zero, nets with more users than this use a star model with a net centre variable rather than the
+    // bound-to-bound model, and are left out of the solve in the initial placement and the first starDropIters
+    // iterations of the main loop
+    int starFanout, starDropIters;
+    // If above zero, build up to this many coarser levels of the netlist by heavy-edge matching, and create the
+    // initial placement by solving and spreading from the coarsest level down, with multilevelRefine solve and
+    // spread rounds at each level
+    int multilevel, multilevelRefine;
+    // Solve the cells of each region constraint, and the unconstrained cells, as separate systems of equations in
+    // parallel, with the cells of other regions fixed; high fanout nets then use the bound-to-bound model throughout
+    bool regionSolve;
+    // If above zero, estimate the routing demand of the spread placement after each spreading pass (RUDY), and count
+    // cells in locations whose demand is more than routabilityRatio times the mean as up to routabilityMaxInflation
+    // cells when finding the regions to spread next time
+    float routabilityRatio, routabilityMaxInflation;
+    // If set, a placed JSON design or checkpoint of an earlier run (placerHeap/reference). Cells with the same name
+    // and type start at their reference location, and cells without one at the centre of their placed neighbours;
+    // the initial placement is skipped, and the main loop stops after referenceIters iterations, with the anchors
+    // to the legal locations as strong as after referenceRounds rounds so that cells only move a short distance
+    std::string reference;
+    int referenceIters, referenceRounds;
+    // Reference location and type of each cell, by name, loaded by placer_heap() from the reference
+    std::unordered_map<IdString, std::pair<IdString, Loc>> referenceLocs;
 
     int hpwl_scale_x, hpwl_scale_y;
     int spread_scale_x, spread_scale_y;
 
     // These cell types will be randomly locked to prevent singular matrices
     std::unordered_set<IdString> ioBufTypes;
+    // Cells of these types that are not part of a macro, hard blocks such as block RAMs and DSPs, are legalised by a
+    // minimum displacement matching to the bels of their type rather than by the greedy search used for logic
+    std::unordered_set<IdString> hardBlockTypes;
     // These cell types are part of the same unit (e.g. slices split into
     // components) so will always be spread together
     std::vector<std::unordered_set<IdString>> cellGroups;
@@ -0,0 +1,415 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "placer_heap_gpu.h"
+#include <algorithm>
+#include <vector>
+
+#include "opencl_device.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+#ifdef WITH_OPENCL
+
+namespace {
+
+// Each kernel also sums up to three dot products over its work group, for the host to add up
+const char *cg_kernels = R"(
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+
+void reduce3(double a, double b, double c, __global double *partial, __local double *scratch)
+{
+    int l = get_local_id(0);
+    scratch[3 * l] = a;
+    scratch[3 * l + 1] = b;
+    scratch[3 * l + 2] = c;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int s = get_local_size(0) / 2; s > 0; s >>= 1) {
+        if (l < s) {
+            scratch[3 * l] += scratch[3 * (l + s)];
+            scratch[3 * l + 1] += scratch[3 * (l + s) + 1];
+            scratch[3 * l + 2] += scratch[3 * (l + s) + 2];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if (l == 0) {
+        int g = get_group_id(0);
+        partial[3 * g] = scratch[0];
+        partial[3 * g + 1] = scratch[1];
+        partial[3 * g + 2] = scratch[2];
+    }
+}
+
+double row_product(int i, __global const int *row_ptr, __global const int *cols, __global const double *vals,
+                   __global const double *v)
+{
+    double sum = 0;
+    for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+        sum += vals[k] * v[cols[k]];
+    return sum;
+}
+
+// r = b - Ax, z = p = M^-1 r; sums r.r, r.z, b.b
+__kernel void cg_start(int n, __global const int *row_ptr, __global const int *cols, __global const double *vals,
+                       __global const double *inv_diag, __global const double *b, __global const double *x,
+                       __global double *r, __global double *z, __global double *p, __global double *partial,
+                       __local double *scratch)
+{
+    int i = get_global_id(0);
+    double rr = 0, rz = 0, bb = 0;
+    if (i < n) {
+        double ri = b[i] - row_product(i, row_ptr, cols, vals, x);
+        double zi = inv_diag[i] * ri;
+        r[i] = ri;
+        z[i] = zi;
+        p[i] = zi;
+        rr = ri * ri;
+        rz = ri * zi;
+        bb = b[i] * b[i];
+    }
+    reduce3(rr, rz, bb, partial, scratch);
+}
+
+// q = Ap; sums p.q
+__kernel void cg_product(int n, __global const int *row_ptr, __global const int *cols, __global const double *vals,
+                         __global const double *p, __global double *q, __global double *partial,
+                         __local double *scratch)
+{
+    int i = get_global_id(0);
+    double pq = 0;
+    if (i < n) {
+        double qi = row_product(i, row_ptr, cols, vals, p);
+        q[i] = qi;
+        pq = p[i] * qi;
+    }
+    reduce3(pq, 0, 0, partial, scratch);
+}
+
+// x += alpha p, r -= alpha q, z = M^-1 r; sums r.r, r.z
+__kernel void cg_update(int n, double alpha, __global const double *inv_diag, __global const double *p,
+                        __global const double *q, __global double *x, __global double *r, __global double *z,
+                        __global double *partial, __local double *scratch)
+{
+    int i = get_global_id(0);
+    double rr = 0, rz = 0;
+    if (i < n) {
+        x[i] += alpha * p[i];
+        double ri = r[i] - alpha * q[i];
+        double zi = inv_diag[i] * ri;
+        r[i] = ri;
+        z[i] = zi;
+        rr = ri * ri;
+        rz = ri * zi;
+    }
+    reduce3(rr, rz, 0, partial, scratch);
+}
+
+// p = z + beta p
+__kernel void cg_direction(int n, double beta, __global const double *z, __global double *p)
+{
+    int i = get_global_id(0);
+    if (i < n)
+        p[i] = z[i] + beta * p[i];
+}
+)";
+
+const size_t group_size = 256;
+
+// The conjugate gradient kernels, built once for the shared device
+struct CgProgram
+{
+    bool ok = false;
+    std::string error;
+    cl_program program = nullptr;
+
+    CgProgram()
+    {
+        const OpenCLDevice &dev = opencl_device();
+        if (!dev.ok) {
+            error = dev.error;
+            return;
+        }
+        if (!dev.fp64) {
+            error = "the OpenCL GPU " + dev.name + " has no double precision support";
+            return;
+        }
+        program = dev.build(cg_kernels, error);
+        ok = (program != nullptr);
+    }
+
+    ~CgProgram()
+    {
+        if (program != nullptr)
+            clReleaseProgram(program);
+    }
+};
+
+CgProgram &cg_program()
+{
+    static CgProgram program;
+    return program;
+}
+
+} // namespace
+
+struct HeapGpuSolver::Impl
+{
+    const OpenCLDevice &dev = opencl_device();
+    cl_program program = cg_program().program;
+    cl_command_queue queue = nullptr;
+    cl_kernel k_start = nullptr, k_product = nullptr, k_update = nullptr, k_direction = nullptr;
+    // Matrix, inverse of its diagonal, and the vectors of the solve
+    cl_mem row_ptr = nullptr, cols = nullptr, vals = nullptr, inv_diag = nullptr;
+    cl_mem b = nullptr, x = nullptr, r = nullptr, z = nullptr, p = nullptr, q = nullptr, partial = nullptr;
+    int n = 0, nnz = 0;
+    // Set on any device error, after which the solver isn't used again
+    bool failed = false;
+    std::vector<double> diag, inv_diag_host, host_partial;
+
+    Impl()
+    {
+        if (!cg_program().ok) {
+            failed = true;
+            return;
+        }
+        cl_int err;
+        queue = clCreateCommandQueue(dev.context, dev.device, 0, &err);
+        failed |= (err != CL_SUCCESS);
+        k_start = clCreateKernel(program, "cg_start", &err);
+        failed |= (err != CL_SUCCESS);
+        k_product = clCreateKernel(program, "cg_product", &err);
+        failed |= (err != CL_SUCCESS);
+        k_update = clCreateKernel(program, "cg_update", &err);
+        failed |= (err != CL_SUCCESS);
+        k_direction = clCreateKernel(program, "cg_direction", &err);
+        failed |= (err != CL_SUCCESS);
+    }
+
+    static void release(cl_mem &mem)
+    {
+        if (mem != nullptr)
+            clReleaseMemObject(mem);
+        mem = nullptr;
+    }
+
+    ~Impl()
+    {
+        for (cl_mem *mem : {&row_ptr, &cols, &vals, &inv_diag, &b, &x, &r, &z, &p, &q, &partial})
+            release(*mem);
+        for (cl_kernel k : {k_start, k_product, k_update, k_direction})
+            if (k != nullptr)
+                clReleaseKernel(k);
+        if (queue != nullptr)
+            clReleaseCommandQueue(queue);
+    }
+
+    cl_mem alloc(size_t bytes)
+    {
+        cl_int err;
+        cl_mem mem = clCreateBuffer(dev.context, CL_MEM_READ_WRITE, std::max<size_t>(bytes, 1), nullptr, &err);
+        failed |= (err != CL_SUCCESS);
+        return mem;
+    }
+
+    void write(cl_mem mem, const void *data, size_t bytes)
+    {
+        if (!failed && bytes > 0)
+            failed |= (clEnqueueWriteBuffer(queue, mem, CL_FALSE, 0, bytes, data, 0, nullptr, nullptr) != CL_SUCCESS);
+    }
+
+    size_t groups() const { return (size_t(n) + group_size - 1) / group_size; }
+
+    template <typename T> void arg(cl_kernel k, cl_uint idx, const T &value)
+    {
+        failed |= (clSetKernelArg(k, idx, sizeof(T), &value) != CL_SUCCESS);
+    }
+
+    void local_arg(cl_kernel k, cl_uint idx)
+    {
+        failed |= (clSetKernelArg(k, idx, 3 * group_size * sizeof(double), nullptr) != CL_SUCCESS);
+    }
+
+    void run(cl_kernel k)
+    {
+        if (failed)
+            return;
+        size_t global = groups() * group_size, local = group_size;
+        failed |= (clEnqueueNDRangeKernel(queue, k, 1, nullptr, &global, &local, 0, nullptr, nullptr) != CL_SUCCESS);
+    }
+
+    // Total over the work groups of the sums of the last kernel
+    void sums(double &a, double &b2, double &c)
+    {
+        a = b2 = c = 0;
+        if (failed)
+            return;
+        host_partial.resize(3 * groups());
+        failed |= (clEnqueueReadBuffer(queue, partial, CL_TRUE, 0, host_partial.size() * sizeof(double),
+                                       host_partial.data(), 0, nullptr, nullptr) != CL_SUCCESS);
+        for (size_t g = 0; g < groups(); g++) {
+            a += host_partial[3 * g];
+            b2 += host_partial[3 * g + 1];
+            c += host_partial[3 * g + 2];
+        }
+    }
+};
+
+bool HeapGpuSolver::available(std::string &error)
+{
+    error = cg_program().error;
+    return cg_program().ok;
+}
+
+std::string HeapGpuSolver::device_name() { return opencl_device().name; }
+
+HeapGpuSolver::HeapGpuSolver() : impl(new Impl()) {}
+
+HeapGpuSolver::~HeapGpuSolver() {}
+
+void HeapGpuSolver::set_matrix(int n, const int *row_ptr, const int *cols, const double *vals, bool pattern_changed)
+{
+    Impl &m = *impl;
+    if (m.failed)
+        return;
+    int nnz = row_ptr[n];
+    if (n != m.n) {
+        for (cl_mem *mem : {&m.row_ptr, &m.inv_diag, &m.b, &m.x, &m.r, &m.z, &m.p, &m.q, &m.partial})
+            Impl::release(*mem);
+        m.n = n;
+        m.row_ptr = m.alloc((n + 1) * sizeof(int));
+        for (cl_mem *mem : {&m.inv_diag, &m.b, &m.x, &m.r, &m.z, &m.p, &m.q})
+            *mem = m.alloc(n * sizeof(double));
+        m.partial = m.alloc(3 * m.groups() * sizeof(double));
+        pattern_changed = true;
+    }
+    if (nnz != m.nnz) {
+        Impl::release(m.cols);
+        Impl::release(m.vals);
+        m.nnz = nnz;
+        m.cols = m.alloc(nnz * sizeof(int));
+        m.vals = m.alloc(nnz * sizeof(double));
+        pattern_changed = true;
+    }
+    if (pattern_changed) {
+        m.write(m.row_ptr, row_ptr, (n + 1) * sizeof(int));
+        m.write(m.cols, cols, nnz * sizeof(int));
+    }
+    m.write(m.vals, vals, nnz * sizeof(double));
+    m.diag.assign(n, 0);
+    for (int i = 0; i < n; i++)
+        for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+            if (cols[k] == i)
+                m.diag[i] = vals[k];
+}
+
+bool HeapGpuSolver::solve(const double *b, double *x, double tolerance, int max_iters, bool jacobi)
+{
+    Impl &m = *impl;
+    if (m.failed)
+        return false;
+    int n = m.n;
+    if (n == 0)
+        return true;
+    // The preconditioner is the inverse of the diagonal, or the identity without jacobi
+    m.inv_diag_host.resize(n);
+    for (int i = 0; i < n; i++)
+        m.inv_diag_host[i] = (jacobi && m.diag[i] != 0) ? 1.0 / m.diag[i] : 1.0;
+    m.write(m.inv_diag, m.inv_diag_host.data(), n * sizeof(double));
+    m.write(m.b, b, n * sizeof(double));
+    m.write(m.x, x, n * sizeof(double));
+
+    // Mirrors Eigen::ConjugateGradient
+    int idx = 0;
+    m.arg(m.k_start, idx++, n);
+    for (cl_mem mem : {m.row_ptr, m.cols, m.vals, m.inv_diag, m.b, m.x, m.r, m.z, m.p, m.partial})
+        m.arg(m.k_start, idx++, mem);
+    m.local_arg(m.k_start, idx++);
+    m.run(m.k_start);
+    double rr, rz, bb;
+    m.sums(rr, rz, bb);
+
+    std::vector<double> result(n, 0);
+    if (bb == 0) {
+        // Eigen returns zero for a zero right hand side
+        std::copy(result.begin(), result.end(), x);
+        return !m.failed;
+    }
+    double threshold = tolerance * tolerance * bb;
+    idx = 0;
+    m.arg(m.k_product, idx++, n);
+    for (cl_mem mem : {m.row_ptr, m.cols, m.vals, m.p, m.q, m.partial})
+        m.arg(m.k_product, idx++, mem);
+    m.local_arg(m.k_product, idx++);
+    m.arg(m.k_update, 0, n);
+    idx = 2;
+    for (cl_mem mem : {m.inv_diag, m.p, m.q, m.x, m.r, m.z, m.partial})
+        m.arg(m.k_update, idx++, mem);
+    m.local_arg(m.k_update, idx++);
+    m.arg(m.k_direction, 0, n);
+    m.arg(m.k_direction, 2, m.z);
+    m.arg(m.k_direction, 3, m.p);
+    for (int iter = 0; iter < max_iters && rr > threshold && !m.failed; iter++) {
+        double pq, unused1, unused2;
+        m.run(m.k_product);
+        m.sums(pq, unused1, unused2);
+        if (pq == 0)
+            break;
+        double alpha = rz / pq;
+        m.arg(m.k_update, 1, alpha);
+        m.run(m.k_update);
+        double rz_old = rz;
+        m.sums(rr, rz, unused1);
+        double beta = rz / rz_old;
+        m.arg(m.k_direction, 1, beta);
+        m.run(m.k_direction);
+    }
+    if (!m.failed)
+        m.failed |= (clEnqueueReadBuffer(m.queue, m.x, CL_TRUE, 0, n * sizeof(double), result.data(), 0, nullptr,
+                                         nullptr) != CL_SUCCESS);
+    if (m.failed)
+        return false;
+    std::copy(result.begin(), result.end(), x);
+    return true;
+}
+
+#else
+
+// Without BUILD_OPENCL there is no device, and placerHeap/solver=gpu falls back to Eigen
+
+struct HeapGpuSolver::Impl
+{
+};
+
+bool HeapGpuSolver::available(std::string &error)
+{
+    error = "nextpnr was built without BUILD_OPENCL";
+    return false;
+}
+
+std::string HeapGpuSolver::device_name() { return std::string(); }
+
+HeapGpuSolver::HeapGpuSolver() {}
+
+HeapGpuSolver::~HeapGpuSolver() {}
+
+void HeapGpuSolver::set_matrix(int, const int *, const int *, const double *, bool) {}
+
+bool HeapGpuSolver::solve(const double *, double *, double, int, bool) { return false; }
+
+#endif
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,58 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef PLACER_HEAP_GPU_H
+#define PLACER_HEAP_GPU_H
+
+#include <memory>
+#include <string>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Conjugate gradient solver for the symmetric systems of equations of the HeAP placer on an OpenCL device, used with
+// placerHeap/solver=gpu in builds with BUILD_OPENCL. The matrix stays on the device between solves, and when
+// only its values have changed, as between the iterations of the placer, only those are uploaded again.
+//
+// All solvers share one device; each has its own command queue, so separate solvers can be used concurrently.
+class HeapGpuSolver
+{
+  public:
+    // Whether there is a device with double precision support, and if not, why not in error
+    static bool available(std::string &error);
+    // Name of the device used
+    static std::string device_name();
+
+    HeapGpuSolver();
+    ~HeapGpuSolver();
+
+    // Set the n by n matrix from compressed row storage. The row and column index arrays are only uploaded if
+    // pattern_changed is set or the size has changed.
+    void set_matrix(int n, const int *row_ptr, const int *cols, const double *vals, bool pattern_changed);
+    // Solve for b starting from x, until the norm of the residual is at most tolerance times that of b or after
+    // max_iters iterations, with a Jacobi preconditioner if jacobi is set. Returns false if the device failed, in
+    // which case x is left unchanged.
+    bool solve(const double *b, double *x, double tolerance, int max_iters, bool jacobi);
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "plugin.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include "log.h"
+#include "perf_report.h"
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+const char *hook_names[] = {"pre-pack", "pre-place", "pre-route", "post-route"};
+
+// Plugins stay loaded for the life of the process, by file name
+std::mutex plugins_mutex;
+std::map<std::string, PluginRegistry> plugins;
+} // namespace
+
+void PluginRegistry::add_hook(const std::string &hook, PluginCallback callback)
+{
+    if (std::find(std::begin(hook_names), std::end(hook_names), hook) == std::end(hook_names))
+        log_error("plugin registered a callback at unknown hook '%s'\n", hook.c_str());
+    hooks.emplace_back(hook, std::move(callback));
+}
+
+void plugin_load(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(plugins_mutex);
+    if (plugins.count(filename))
+        return;
+#ifndef _WIN32
+    void *handle = dlopen(filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+        log_error("failed to load plugin '%s': %s\n", filename.c_str(), dlerror());
+    auto init = reinterpret_cast<PluginInitFunc>(dlsym(handle, "nextpnr_plugin_init"));
+    if (init == nullptr)
+        log_error("plugin '%s' has no nextpnr_plugin_init function\n", filename.c_str());
+    PluginRegistry reg;
+    if (!init(&reg))
+        log_error("initialising plugin '%s' failed\n", filename.c_str());
+    log_info("Loaded plugin '%s' with %d callbacks.\n", filename.c_str(), int(reg.hooks.size()));
+    plugins[filename] = std::move(reg);
+#else
+    log_error("loading plugin '%s' failed: plugins are not supported on Windows\n", filename.c_str());
+#endif
+}
+
+void plugin_run_hook(const std::string &filename, const std::string &hook, Context *ctx)
+{
+    PluginRegistry *reg;
+    {
+        std::lock_guard<std::mutex> lock(plugins_mutex);
+        reg = &plugins.at(filename);
+    }
+    for (auto &cb : reg->hooks) {
+        if (cb.first != hook)
+            continue;
+        PerfScope scope("plugin " + hook);
+        cb.second(ctx);
+    }
+}
+
+NEXTPNR_NAMESPACE_END
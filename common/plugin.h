@@ -0,0 +1,66 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "nextpnr.h"
+
+// Bumped whenever the registry or the layout of the Context changes in a way that breaks existing plugins
+#define NEXTPNR_PLUGIN_API_VERSION 1
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Native plugins (--plugin) are shared objects that register C++ callbacks at the same points in the flow as the
+// --pre-pack, --pre-place, --pre-route and --post-route Python scripts, with direct access to the Context. They are
+// built against the headers of the nextpnr binary that loads them, with the same NEXTPNR_NAMESPACE and ARCH_*
+// definitions, and export an initialisation function declared with NEXTPNR_PLUGIN_INIT:
+//
+//     NEXTPNR_PLUGIN_INIT(reg)
+//     {
+//         reg->add_hook("pre-route", [](Context *ctx) { ... });
+//         return true;
+//     }
+typedef std::function<void(Context *ctx)> PluginCallback;
+
+struct PluginRegistry
+{
+    // The API version of the loading binary, which a plugin should check against its own
+    int api_version = NEXTPNR_PLUGIN_API_VERSION;
+    // Run a callback at a hook point ("pre-pack", "pre-place", "pre-route" or "post-route"). Callbacks at one hook
+    // run in the order they were added, after any Python scripts for it
+    void add_hook(const std::string &hook, PluginCallback callback);
+
+    std::vector<std::pair<std::string, PluginCallback>> hooks;
+};
+
+typedef bool (*PluginInitFunc)(PluginRegistry *reg);
+
+#define NEXTPNR_PLUGIN_INIT(reg) extern "C" bool nextpnr_plugin_init(NEXTPNR_NAMESPACE_PREFIX PluginRegistry *reg)
+
+// Load a plugin and run its initialisation function, or fail with an error. A plugin loaded before (e.g. by an
+// earlier job of a server process) is not loaded again
+void plugin_load(const std::string &filename);
+// Run the callbacks of a loaded plugin for a hook point
+void plugin_run_hook(const std::string &filename, const std::string &hook, Context *ctx);
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -25,7 +25,9 @@
 #include "json_frontend.h"
 #include "log.h"
 #include "nextpnr.h"
+#include "perf_report.h"
 
+#include <algorithm>
 #include <boost/filesystem.hpp>
 #include <fstream>
 #include <memory>
@@ -90,6 +92,144 @@ template <> struct string_converter<Property>
 
 } // namespace PythonConversion
 
+// Bulk netlist accessors for analysis scripts. These walk the netlist once and return the results as flat memoryviews
+// of int32 ('i') or float32 ('f'), filled in place, rather than converting every element through the map wrappers.
+// Cells and nets are in ctx.cells and ctx.nets iteration order, the same order as getCellNames and getNetNames.
+
+// Create a memoryview over a new buffer of count elements, returning a pointer to fill it through
+template <typename T> object new_buffer(size_t count, const char *format, T *&data)
+{
+    object bytes(handle<>(PyBytes_FromStringAndSize(nullptr, count * sizeof(T))));
+    data = reinterpret_cast<T *>(PyBytes_AS_STRING(bytes.ptr()));
+    object view(handle<>(PyMemoryView_FromObject(bytes.ptr())));
+    return view.attr("cast")(format);
+}
+
+list bulk_cell_names(Context &ctx)
+{
+    list names;
+    for (auto &cell : ctx.cells)
+        names.append(cell.first.str(&ctx));
+    return names;
+}
+
+list bulk_net_names(Context &ctx)
+{
+    list names;
+    for (auto &net : ctx.nets)
+        names.append(net.first.str(&ctx));
+    return names;
+}
+
+// x, y, z of the bel of each cell; -1, -1, -1 for unplaced cells
+object bulk_cell_placement(Context &ctx)
+{
+    int32_t *data;
+    object view = new_buffer(3 * ctx.cells.size(), "i", data);
+    for (auto &cell : ctx.cells) {
+        Loc loc(-1, -1, -1);
+        if (cell.second->bel != BelId())
+            loc = ctx.getBelLocation(cell.second->bel);
+        *(data++) = loc.x;
+        *(data++) = loc.y;
+        *(data++) = loc.z;
+    }
+    return view;
+}
+
+// (offsets, locs): net i has the pips offsets[i] to offsets[i+1], in PipId order; locs holds the x, y location of each
+// pip
+tuple bulk_net_pips(Context &ctx)
+{
+    size_t count = 0;
+    for (auto &net : ctx.nets)
+        for (auto &wire : net.second->wires)
+            if (wire.second.pip != PipId())
+                count++;
+    int32_t *offsets, *locs;
+    object offsets_view = new_buffer(ctx.nets.size() + 1, "i", offsets);
+    object locs_view = new_buffer(2 * count, "i", locs);
+    int32_t offset = 0;
+    std::vector<PipId> pips;
+    for (auto &net : ctx.nets) {
+        *(offsets++) = offset;
+        pips.clear();
+        for (auto &wire : net.second->wires)
+            if (wire.second.pip != PipId())
+                pips.push_back(wire.second.pip);
+        std::sort(pips.begin(), pips.end());
+        for (auto pip : pips) {
+            Loc loc = ctx.getPipLocation(pip);
+            *(locs++) = loc.x;
+            *(locs++) = loc.y;
+        }
+        offset += int32_t(pips.size());
+    }
+    *offsets = offset;
+    return make_tuple(offsets_view, locs_view);
+}
+
+// (offsets, delays): the delays in ns of the arcs to the users of net i are entries offsets[i] to offsets[i+1] of
+// delays, in the same order as the net's users; these are the routed delays, or estimates for unrouted nets
+tuple bulk_arc_delays(Context &ctx)
+{
+    size_t count = 0;
+    for (auto &net : ctx.nets)
+        count += net.second->users.size();
+    int32_t *offsets;
+    float *delays;
+    object offsets_view = new_buffer(ctx.nets.size() + 1, "i", offsets);
+    object delays_view = new_buffer(count, "f", delays);
+    int32_t offset = 0;
+    for (auto &net : ctx.nets) {
+        NetInfo *ni = net.second.get();
+        *(offsets++) = offset;
+        for (auto &usr : ni->users)
+            *(delays++) = (ni->driver.cell == nullptr) ? 0 : ctx.getDelayNS(ctx.getNetinfoRouteDelay(ni, usr));
+        offset += int32_t(ni->users.size());
+    }
+    *offsets = offset;
+    return make_tuple(offsets_view, delays_view);
+}
+
+// The phases of the performance report so far, as a list of dicts; counters holds each phase's named counters, such
+// as the search statistics of the router iterations
+boost::python::list perf_report_shim()
+{
+    boost::python::list result;
+    for (auto &ph : perf_report_phases()) {
+        boost::python::dict phase, counters;
+        phase["phase"] = ph.path;
+        phase["count"] = ph.count;
+        phase["wall_time"] = ph.wall;
+        phase["cpu_time"] = ph.cpu;
+        phase["peak_rss_delta_kb"] = ph.rss_delta_kb;
+        for (auto &c : ph.counters)
+            counters[c.first] = c.second;
+        phase["counters"] = counters;
+        result.append(phase);
+    }
+    return result;
+}
+
+// The latest design snapshot, which can be read while a pass holds the context lock, as a dict of "epoch",
+// "placement" (cell name to bel name) and "routing" (net name to the number of wires used); None before the first
+boost::python::object snapshot_shim(Context &ctx)
+{
+    auto snap = ctx.getSnapshot();
+    if (snap == nullptr)
+        return boost::python::object();
+    boost::python::dict result, placement, routing;
+    result["epoch"] = snap->epoch;
+    for (auto &cb : snap->cell_bels)
+        placement[cb.first.str(&ctx)] = ctx.getBelName(cb.second).str(&ctx);
+    for (auto &nw : snap->net_wires)
+        routing[nw.first.str(&ctx)] = nw.second.size();
+    result["placement"] = placement;
+    result["routing"] = routing;
+    return result;
+}
+
 BOOST_PYTHON_MODULE(MODULE_NAME)
 {
     register_exception_translator<assertion_failure>(&translate_assertfail);
@@ -138,8 +278,8 @@ BOOST_PYTHON_MODULE(MODULE_NAME)
             .value("STRENGTH_USER", STRENGTH_USER)
             .export_values();
 
-    typedef std::unordered_map<IdString, Property> AttrMap;
-    typedef std::unordered_map<IdString, PortInfo> PortMap;
+    typedef small_dict<IdString, Property, 4> AttrMap;
+    typedef small_dict<IdString, PortInfo> PortMap;
     typedef std::unordered_map<IdString, IdString> IdIdMap;
     typedef std::unordered_map<IdString, std::unique_ptr<Region>> RegionMap;
 
@@ -194,7 +334,7 @@ BOOST_PYTHON_MODULE(MODULE_NAME)
                       pass_through<PortType>>::def_wrap(pi_cls, "type");
 
     typedef std::vector<PortRef> PortRefVector;
-    typedef std::unordered_map<WireId, PipMap> WireMap;
+    typedef flat_dict<WireId, PipMap> WireMap;
     typedef std::unordered_set<BelId> BelSet;
     typedef std::unordered_set<WireId> WireSet;
 
@@ -224,6 +364,9 @@ BOOST_PYTHON_MODULE(MODULE_NAME)
 
     def("parse_json", parse_json_shim);
     def("load_design", load_design_shim, return_value_policy<manage_new_object>());
+    def("enable_perf_report", perf_report_enable);
+    def("perf_report", perf_report_shim);
+    def("design_snapshot", snapshot_shim);
 
     auto region_cls = class_<ContextualWrapper<Region &>>("Region", no_init);
     readwrite_wrapper<Region &, decltype(&Region::name), &Region::name, conv_to_str<IdString>,
@@ -264,6 +407,13 @@ BOOST_PYTHON_MODULE(MODULE_NAME)
     WRAP_VECTOR(PortRefVector, wrap_context<PortRef &>);
 
     arch_wrap_python();
+
+    object ctx_cls = scope().attr("Context");
+    objects::add_to_namespace(ctx_cls, "getCellNames", make_function(bulk_cell_names));
+    objects::add_to_namespace(ctx_cls, "getNetNames", make_function(bulk_net_names));
+    objects::add_to_namespace(ctx_cls, "getCellPlacement", make_function(bulk_cell_placement));
+    objects::add_to_namespace(ctx_cls, "getNetPips", make_function(bulk_net_pips));
+    objects::add_to_namespace(ctx_cls, "getArcDelays", make_function(bulk_arc_delays));
 }
 
 #ifdef MAIN_EXECUTABLE
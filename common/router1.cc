@@ -17,12 +17,15 @@
  *
  */
 
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <queue>
+#include <thread>
 
 #include "log.h"
 #include "router1.h"
+#include "thread_pool.h"
 #include "timing.h"
 
 namespace {
@@ -91,6 +94,12 @@ struct QueuedWire
     };
 };
 
+struct SearchState
+{
+    std::unordered_map<WireId, QueuedWire> visited;
+    std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> queue;
+};
+
 struct Router1
 {
     Context *ctx;
@@ -101,8 +110,7 @@ struct Router1
     std::unordered_map<arc_key, std::unordered_set<WireId>, arc_key::Hash> arc_to_wires;
     std::unordered_set<arc_key, arc_key::Hash> queued_arcs;
 
-    std::unordered_map<WireId, QueuedWire> visited;
-    std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> queue;
+    SearchState serial_search;
 
     std::unordered_map<WireId, int> wireScores;
     std::unordered_map<NetInfo *, int> netScores;
@@ -164,6 +172,23 @@ struct Router1
         return entry.arc;
     }
 
+    arc_entry arc_queue_pop_entry()
+    {
+        arc_entry entry = arc_queue.top();
+        arc_queue.pop();
+        queued_arcs.erase(entry.arc);
+        return entry;
+    }
+
+    // Put back a popped arc, keeping its priority and tie-break tag
+    void arc_queue_reinsert(const arc_entry &entry)
+    {
+        if (queued_arcs.count(entry.arc))
+            return;
+        arc_queue.push(entry);
+        queued_arcs.insert(entry.arc);
+    }
+
     void ripup_net(NetInfo *net)
     {
         if (ctx->debug)
@@ -439,9 +464,26 @@ struct Router1
         }
     }
 
-    bool route_arc(const arc_key &arc, bool ripup)
+    // unbind wires that are currently used exclusively by this arc
+    void unbind_arc(const arc_key &arc)
     {
+        std::unordered_set<WireId> old_arc_wires;
+        old_arc_wires.swap(arc_to_wires[arc]);
+
+        for (WireId wire : old_arc_wires) {
+            auto &arc_wires = wire_to_arcs.at(wire);
+            NPNR_ASSERT(arc_wires.count(arc));
+            arc_wires.erase(arc);
+            if (arc_wires.empty()) {
+                if (ctx->debug)
+                    log("  unbind %s\n", ctx->nameOfWire(wire));
+                ctx->unbindWire(wire);
+            }
+        }
+    }
 
+    bool route_arc(const arc_key &arc, bool ripup)
+    {
         NetInfo *net_info = arc.net_info;
         int user_idx = arc.user_idx;
 
@@ -456,23 +498,35 @@ struct Router1
             log("  sink ..... %s\n", ctx->nameOfWire(dst_wire));
         }
 
-        ArcBounds bounds = ctx->getRouteBoundingBox(src_wire, dst_wire);
+        unbind_arc(arc);
 
-        // unbind wires that are currently used exclusively by this arc
+        if (!search_arc(arc, ripup, serial_search, *ctx))
+            return false;
 
-        std::unordered_set<WireId> old_arc_wires;
-        old_arc_wires.swap(arc_to_wires[arc]);
+        std::vector<PipId> path;
+        get_path(arc, serial_search, path);
+        bind_arc(arc, path);
 
-        for (WireId wire : old_arc_wires) {
-            auto &arc_wires = wire_to_arcs.at(wire);
-            NPNR_ASSERT(arc_wires.count(arc));
-            arc_wires.erase(arc);
-            if (arc_wires.empty()) {
-                if (ctx->debug)
-                    log("  unbind %s\n", ctx->nameOfWire(wire));
-                ctx->unbindWire(wire);
-            }
-        }
+        if (ripup_flag)
+            arcs_with_ripup++;
+        else
+            arcs_without_ripup++;
+
+        return true;
+    }
+
+    // A* search from the source to the sink of an arc. Only reads the context and router state, so several
+    // searches with ripup disabled and their own SearchState and rng may run at the same time
+    bool search_arc(const arc_key &arc, bool ripup, SearchState &state, DeterministicRNG &rng)
+    {
+        NetInfo *net_info = arc.net_info;
+        int user_idx = arc.user_idx;
+
+        auto src_wire = ctx->getNetinfoSourceWire(net_info);
+        auto dst_wire = ctx->getNetinfoSinkWire(net_info, net_info->users[user_idx]);
+
+        auto &visited = state.visited;
+        auto &queue = state.queue;
 
         // reset wire queue
 
@@ -482,6 +536,8 @@ struct Router1
         }
         visited.clear();
 
+        ArcBounds bounds = ctx->getRouteBoundingBox(src_wire, dst_wire);
+
         // A* main loop
 
         int visitCnt = 0;
@@ -500,7 +556,7 @@ struct Router1
                 qw.togo = ctx->estimateDelay(qw.wire, dst_wire);
                 best_est = qw.delay + qw.togo;
             }
-            qw.randtag = ctx->rng();
+            qw.randtag = rng.rng();
 
             queue.push(qw);
             visited[qw.wire] = qw;
@@ -684,7 +740,7 @@ struct Router1
                     if (best_est > this_est)
                         best_est = this_est;
                 }
-                next_qw.randtag = ctx->rng();
+                next_qw.randtag = rng.rng();
 
 #if 0
                 if (ctx->debug)
@@ -721,6 +777,31 @@ struct Router1
             log("  arc budget:      %12.2f\n", ctx->getDelayNS(net_info->users[user_idx].budget));
         }
 
+        return true;
+    }
+
+    // Pips of the route found by the last search, from the sink back to the source (which has no pip)
+    void get_path(const arc_key &arc, const SearchState &state, std::vector<PipId> &path)
+    {
+        path.clear();
+        WireId cursor = ctx->getNetinfoSinkWire(arc.net_info, arc.net_info->users[arc.user_idx]);
+        while (1) {
+            PipId pip = state.visited.at(cursor).pip;
+            path.push_back(pip);
+            if (pip == PipId())
+                break;
+            cursor = ctx->getPipSrcWire(pip);
+        }
+    }
+
+    void bind_arc(const arc_key &arc, const std::vector<PipId> &path)
+    {
+        NetInfo *net_info = arc.net_info;
+        int user_idx = arc.user_idx;
+
+        auto src_wire = ctx->getNetinfoSourceWire(net_info);
+        auto dst_wire = ctx->getNetinfoSinkWire(net_info, net_info->users[user_idx]);
+
         // bind resulting route (and maybe unroute other nets)
 
         std::unordered_set<WireId> unassign_wires = arc_to_wires[arc];
@@ -728,8 +809,8 @@ struct Router1
         WireId cursor = dst_wire;
         delay_t accumulated_path_delay = 0;
         delay_t last_path_delay_delta = 0;
-        while (1) {
-            auto pip = visited[cursor].pip;
+        for (size_t i = 0;; i++) {
+            auto pip = path.at(i);
 
             if (ctx->debug) {
                 delay_t path_delay_delta = ctx->estimateDelay(cursor, dst_wire) - accumulated_path_delay;
@@ -782,12 +863,117 @@ struct Router1
 
             cursor = ctx->getPipSrcWire(pip);
         }
+    }
 
-        if (ripup_flag)
-            arcs_with_ripup++;
-        else
-            arcs_without_ripup++;
+    // Check that a route found against an earlier state of the design can still be bound without ripup
+    bool path_avail(const arc_key &arc, const std::vector<PipId> &path)
+    {
+        NetInfo *net_info = arc.net_info;
+        WireId cursor = ctx->getNetinfoSinkWire(net_info, net_info->users[arc.user_idx]);
+        for (PipId pip : path) {
+            auto fnd = net_info->wires.find(cursor);
+            if (fnd == net_info->wires.end() || fnd->second.pip != pip) {
+                if (!ctx->checkWireAvail(cursor))
+                    return false;
+                if (pip != PipId() && !ctx->checkPipAvail(pip))
+                    return false;
+            }
+            if (pip != PipId())
+                cursor = ctx->getPipSrcWire(pip);
+        }
+        return true;
+    }
+
+    // Speculatively route a batch of arcs, from distinct nets and with disjoint (padded) bounding boxes, in
+    // parallel. Every arc is searched without ripup against the routing at the start of the batch; the routes
+    // are then checked and bound in queue order, and arcs whose route was taken by an earlier arc of the batch
+    // or that need ripup are routed serially. The batch only depends on the queue and the seeds are drawn up
+    // front, so the result does not depend on the number of threads.
+    // Sets batched to the number of arcs routed, or to 0 if too few arcs could be batched.
+    bool route_batch(int &batched, arc_key &failed_arc)
+    {
+        std::vector<arc_entry> batch, deferred;
+        std::vector<ArcBounds> batch_bounds;
+        std::unordered_set<NetInfo *> batch_nets;
+        int margin = cfg.parallelBBMargin;
+        batched = 0;
+
+        while (!arc_queue.empty() && int(batch.size()) < cfg.parallelBatchSize &&
+               int(batch.size() + deferred.size()) < 4 * cfg.parallelBatchSize) {
+            arc_entry entry = arc_queue_pop_entry();
+            NetInfo *net_info = entry.arc.net_info;
+            auto src_wire = ctx->getNetinfoSourceWire(net_info);
+            auto dst_wire = ctx->getNetinfoSinkWire(net_info, net_info->users[entry.arc.user_idx]);
+            ArcBounds bb = ctx->getRouteBoundingBox(src_wire, dst_wire);
+            bb.x0 -= margin;
+            bb.y0 -= margin;
+            bb.x1 += margin;
+            bb.y1 += margin;
+            bool disjoint = !batch_nets.count(net_info);
+            for (auto &other : batch_bounds) {
+                if (!disjoint)
+                    break;
+                if (bb.x0 <= other.x1 && other.x0 <= bb.x1 && bb.y0 <= other.y1 && other.y0 <= bb.y1)
+                    disjoint = false;
+            }
+            if (disjoint) {
+                batch.push_back(entry);
+                batch_bounds.push_back(bb);
+                batch_nets.insert(net_info);
+            } else {
+                deferred.push_back(entry);
+            }
+        }
+
+        for (auto &entry : deferred)
+            arc_queue_reinsert(entry);
+        if (int(batch.size()) < cfg.parallelMinBatch) {
+            for (auto &entry : batch)
+                arc_queue_reinsert(entry);
+            return true;
+        }
+
+        size_t n = batch.size();
+        std::vector<uint64_t> seeds(n);
+        for (size_t i = 0; i < n; i++) {
+            unbind_arc(batch.at(i).arc);
+            seeds.at(i) = ctx->rng64();
+        }
 
+        std::vector<std::vector<PipId>> paths(n);
+        std::vector<char> found(n, 0);
+        std::atomic<size_t> next_arc{0};
+        auto worker = [&]() {
+            SearchState state;
+            DeterministicRNG rng;
+            size_t i;
+            while ((i = next_arc++) < n) {
+                rng.rngseed(seeds.at(i));
+                if (search_arc(batch.at(i).arc, false, state, rng)) {
+                    get_path(batch.at(i).arc, state, paths.at(i));
+                    found.at(i) = 1;
+                }
+            }
+        };
+        ThreadPool::TaskGroup workers(ctx->threadPool());
+        for (int i = 1; i < std::min<int>(cfg.threads, int(n)); i++)
+            workers.run(worker);
+        worker();
+        workers.wait();
+
+        for (size_t i = 0; i < n; i++) {
+            const arc_key &arc = batch.at(i).arc;
+            if (found.at(i) && path_avail(arc, paths.at(i))) {
+                ripup_flag = false;
+                bind_arc(arc, paths.at(i));
+                arcs_without_ripup++;
+            } else if (!route_arc(arc, true)) {
+                failed_arc = arc;
+                return false;
+            }
+        }
+
+        batched = int(n);
         return true;
     }
 };
@@ -808,6 +994,12 @@ Router1Cfg::Router1Cfg(Context *ctx)
     reuseBonus = wireRipupPenalty / 2;
 
     estimatePrecision = 100 * ctx->getRipupDelayPenalty();
+
+    parallel = ctx->setting<bool>("router1/parallel", false);
+    threads = std::max(1, ctx->setting<int>("threads", std::max<int>(1, std::thread::hardware_concurrency())));
+    parallelBatchSize = ctx->setting<int>("router1/parallelBatchSize", 256);
+    parallelMinBatch = ctx->setting<int>("router1/parallelMinBatch", 16);
+    parallelBBMargin = ctx->setting<int>("router1/parallelBBMargin", 2);
 }
 
 bool router1(Context *ctx, const Router1Cfg &cfg)
@@ -836,8 +1028,12 @@ bool router1(Context *ctx, const Router1Cfg &cfg)
         log_info("   IterCnt |  w/ripup   wo/ripup |  w/r  wo/r |      arcs| batch(sec) total(sec)|\n");
 
         auto prev_time = rstart;
+        int next_report = 1000;
+        int serial_arcs = 0;
+        bool parallel = cfg.parallel && !ctx->debug;
         while (!router.arc_queue.empty()) {
-            if (++iter_cnt % 1000 == 0) {
+            if (++iter_cnt >= next_report) {
+                next_report = (iter_cnt / 1000 + 1) * 1000;
                 auto curr_time = std::chrono::high_resolution_clock::now();
                 log_info("%10d | %8d %10d | %4d %5d | %9d| %10.02f %10.02f|\n", iter_cnt, router.arcs_with_ripup,
                          router.arcs_without_ripup, router.arcs_with_ripup - last_arcs_with_ripup,
@@ -856,9 +1052,26 @@ bool router1(Context *ctx, const Router1Cfg &cfg)
             if (ctx->debug)
                 log("-- %d --\n", iter_cnt);
 
-            arc_key arc = router.arc_queue_pop();
+            arc_key arc;
+            bool routed = true;
+            if (parallel && serial_arcs == 0) {
+                int batched = 0;
+                routed = router.route_batch(batched, arc);
+                if (routed && batched > 0) {
+                    iter_cnt += batched - 1;
+                    continue;
+                }
+                // Too congested to batch, route the next arcs serially before trying again
+                serial_arcs = cfg.parallelBatchSize;
+            }
+            if (routed) {
+                if (serial_arcs > 0)
+                    serial_arcs--;
+                arc = router.arc_queue_pop();
+                routed = router.route_arc(arc, true);
+            }
 
-            if (!router.route_arc(arc, true)) {
+            if (!routed) {
                 log_warning("Failed to find a route for arc %d of net %s.\n", arc.user_idx, ctx->nameOf(arc.net_info));
 #ifndef NDEBUG
                 router.check();
@@ -36,6 +36,16 @@ struct Router1Cfg
     delay_t netRipupPenalty;
     delay_t reuseBonus;
     delay_t estimatePrecision;
+
+    // Speculatively route batches of arcs with disjoint bounding boxes in parallel. The result only depends
+    // on the batch settings, not on the number of threads
+    bool parallel;
+    int threads;
+    // Maximum number of arcs in a batch, and the smallest batch that is routed in parallel
+    int parallelBatchSize;
+    int parallelMinBatch;
+    // Padding added to arc bounding boxes when checking that the arcs of a batch are disjoint
+    int parallelBBMargin;
 };
 
 extern bool router1(Context *ctx, const Router1Cfg &cfg);
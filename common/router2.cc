@@ -28,21 +28,48 @@
 
 #include "router2.h"
 #include <algorithm>
+#include <atomic>
 #include <boost/container/flat_map.hpp>
+#include <boost/container/small_vector.hpp>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <deque>
 #include <fstream>
-#include <queue>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <mutex>
 #include <thread>
+#include "checkpoint.h"
 #include "log.h"
+#include "mem_account.h"
 #include "nextpnr.h"
+#include "perf_report.h"
 #include "router1.h"
+#include "router2_lookahead.h"
+#include "router2_wavefront.h"
+#include "thread_pool.h"
 #include "timing.h"
+#include "trace.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
 namespace {
+/*
+ * Congestion history file layout (router2/congHistory), all integers are native endian:
+ *
+ *   char[8]  magic "NPHCNG01"
+ *   u32      length, then the chip database identity, see chipdb_identity()
+ *   u32      number of entries, then per entry:
+ *              i32  dense wire index (getWireIndex on Xilinx, else the position in getWires())
+ *              f32  historical congestion cost
+ *
+ * Only wires with a cost other than the initial 1.0 have an entry.
+ */
+const char cong_history_magic[8] = {'N', 'P', 'H', 'C', 'N', 'G', '0', '1'};
+
 struct Router2
 {
 
@@ -52,6 +79,14 @@ struct Router2
         ArcBounds bb;
         bool routed = false;
         float arc_crit = 0;
+        // Set by hold repair: the fast corner delay the route must have at least, to fix a hold violation
+        delay_t min_delay_target = 0;
+        // Backwards fan-in cone of the sink wire (see sink_cones), or -1 to search uphill of the sink
+        int32_t cone = -1;
+        // With cfg.adaptive_search, the explore limit of the next A* search of the arc (0 for the default), and the
+        // extent of the wires used by its last route from A*
+        int32_t explore_budget = 0;
+        ArcBounds used_bb;
     };
 
     // As we allow overlap at first; the nextpnr bind functions can't be used
@@ -64,41 +99,120 @@ struct Router2
         // Coordinates of the center of the net, used for the weight-to-average
         int cx, cy, hpwl;
         int total_route_us = 0;
+        // Time taken by the last time the net was routed, as a measure of its routing work (-1 if not routed yet)
+        int last_route_us = -1;
         float max_crit = 0;
         int fail_count = 0;
     };
 
     struct WireScore
     {
-        float cost;
-        float togo_cost;
-        delay_t delay;
-        float total() const { return cost + togo_cost; }
+        // Cost so far and estimated cost to go; with cfg.fixed_point_cost these are whole numbers of
+        // 1/cfg.fixed_cost_scale units instead. Only compare them through score_total()
+        union
+        {
+            float cost;
+            uint32_t cost_q;
+        };
+        union
+        {
+            float togo_cost;
+            uint32_t togo_q;
+        };
+        // Slow and fast corner delay from the source
+        delay_t delay, min_delay;
     };
 
+    // Almost all wires are bound to at most two nets, so keep those inline rather than on the heap
+    typedef std::pair<int, std::pair<int, PipId>> BoundNetEntry;
+    typedef boost::container::flat_map<int, std::pair<int, PipId>, std::less<int>,
+                                       boost::container::small_vector<BoundNetEntry, 2>>
+            BoundNetMap;
+
+    // Binding data, only touched once a wire is actually considered for an arc
     struct PerWireData
     {
         // nextpnr
         WireId w;
         // net --> number of arcs; driving pip
-        boost::container::flat_map<int, std::pair<int, PipId>> bound_nets;
-        // Historical congestion cost
-        float hist_cong_cost = 1.0;
+        BoundNetMap bound_nets;
         // Wire is unavailable as locked to another arc
         bool unavailable = false;
+        // Wire is in overused_list
+        bool overuse_listed = false;
         // This wire has to be used for this net
         int reserved_net = -1;
         // The notional location of the wire, to guarantee thread safety
         int16_t x = 0, y = 0;
-        // Visit data
-        struct
-        {
-            bool dirty = false, visited = false;
-            PipId pip;
-            WireScore score;
-        } visit;
     };
 
+    // How a wire can be driven, for is_wire_undriveable: WIRE_BEL_OUT and WIRE_UPHILL only depend on the device,
+    // WIRE_UPHILL_AVAIL also on the placement and locked routing at the start of routing
+    enum : uint8_t
+    {
+        WIRE_BEL_OUT = 1,     // a bel pin on the wire isn't an input
+        WIRE_UPHILL = 2,      // the wire has uphill pips
+        WIRE_UPHILL_AVAIL = 4 // one of them is available
+    };
+    std::vector<uint8_t> wire_drive;
+
+    // Visit data, kept apart from PerWireData so the A* search only pulls the fields it needs into cache
+    struct PerWireVisit
+    {
+        PipId pip;
+        WireScore score;
+        // A wire is visited by a search if this matches the epoch of the searching thread, so starting a new
+        // search doesn't need to touch the wires of the last one
+        uint32_t epoch = 0;
+    };
+
+    uint32_t to_fixed_cost(float cost) const
+    {
+        float q = cost * cfg.fixed_cost_scale;
+        if (!(q > 0))
+            return 0;
+        if (q >= 4294967040.0f)
+            return std::numeric_limits<uint32_t>::max();
+        return uint32_t(q + 0.5f);
+    }
+
+    void set_score_cost(WireScore &score, const WireScore &prev, float step) const
+    {
+        if (cfg.fixed_point_cost)
+            score.cost_q = uint32_t(std::min<uint64_t>(uint64_t(prev.cost_q) + to_fixed_cost(step),
+                                                       std::numeric_limits<uint32_t>::max()));
+        else
+            score.cost = prev.cost + step;
+    }
+
+    void set_score_togo(WireScore &score, float togo) const
+    {
+        if (cfg.fixed_point_cost)
+            score.togo_q = to_fixed_cost(togo);
+        else
+            score.togo_cost = togo;
+    }
+
+    // The total of a score as an integer that orders the same way. Floats are mapped to their bit pattern with
+    // negative values flipped entirely and the sign bit of the others set, which orders them as the float values
+    uint64_t score_total(const WireScore &score) const
+    {
+        if (cfg.fixed_point_cost)
+            return uint64_t(score.cost_q) + score.togo_q;
+        float total = score.cost + score.togo_cost;
+        uint32_t bits;
+        memcpy(&bits, &total, sizeof(bits));
+        return (bits & 0x80000000U) ? ~bits : (bits | 0x80000000U);
+    }
+
+    // Key of a wire in the A* queue, with the score total in the high bits and a random tie break below it
+    uint64_t queue_key(const WireScore &score, uint32_t randtag) const
+    {
+        if (cfg.fixed_point_cost)
+            return (std::min<uint64_t>(score_total(score), (1ULL << 40) - 1) << 24) | (randtag & 0xFFFFFFU);
+        return (score_total(score) << 32) | randtag;
+    }
+
     float present_wire_cost(const PerWireData &w, int net_uid)
     {
         int other_sources = int(w.bound_nets.size());
@@ -113,7 +227,7 @@ struct Router2
     Context *ctx;
     Router2Cfg cfg;
 
-    Router2(Context *ctx, const Router2Cfg &cfg) : ctx(ctx), cfg(cfg) {}
+    Router2(Context *ctx, const Router2Cfg &cfg) : ctx(ctx), cfg(cfg), tmg(ctx) {}
 
     // Use 'udata' for fast net lookups and indexing
     std::vector<NetInfo *> nets_by_udata;
@@ -121,8 +235,86 @@ struct Router2
 
     bool timing_driven;
 
-    // Criticality data from timing analysis
+    // Criticality data from timing analysis; the timing graph persists across iterations so that only
+    // rerouted nets are re-timed
+    TimingAnalyser tmg;
     NetCriticalityMap net_crit;
+    float sta_time = 0;
+
+    // Run func(i) for i from 0 to count, on up to cfg.threads threads with at least grain items each
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t)> &func)
+    {
+        ctx->threadPool().parallel_for(count, grain, func, ctx->debug ? 1 : cfg.threads);
+    }
+
+    // Compute the arcs, bounding box and centre of a net. Returns false if a source or sink wire is missing, which
+    // is only reported as an error if report is set, so that this can be run from worker threads.
+    bool setup_net(size_t i, bool report)
+    {
+        NetInfo *ni = nets_by_udata.at(i);
+        PerNetData &nd = nets.at(i);
+        nd.arcs.clear();
+        nd.arcs.resize(ni->users.size());
+
+        // Start net bounding box at overall min/max
+        nd.bb.x0 = std::numeric_limits<int>::max();
+        nd.bb.x1 = std::numeric_limits<int>::min();
+        nd.bb.y0 = std::numeric_limits<int>::max();
+        nd.bb.y1 = std::numeric_limits<int>::min();
+        nd.cx = 0;
+        nd.cy = 0;
+
+        if (ni->driver.cell != nullptr) {
+            Loc drv_loc = ctx->getBelLocation(ni->driver.cell->bel);
+            nd.cx += drv_loc.x;
+            nd.cy += drv_loc.y;
+        }
+
+        for (size_t j = 0; j < ni->users.size(); j++) {
+            auto &usr = ni->users.at(j);
+            WireId src_wire = ctx->getNetinfoSourceWire(ni), dst_wire = ctx->getNetinfoSinkWire(ni, j);
+            nd.src_wire = src_wire;
+            if (ni->driver.cell == nullptr)
+                src_wire = dst_wire;
+            if (ni->driver.cell == nullptr && dst_wire == WireId())
+                continue;
+            if (src_wire == WireId()) {
+                if (report)
+                    log_error("No wire found for port %s on source cell %s.\n", ctx->nameOf(ni->driver.port),
+                              ctx->nameOf(ni->driver.cell));
+                return false;
+            }
+            if (dst_wire == WireId()) {
+                if (report)
+                    log_error("No wire found for port %s on destination cell %s.\n", ctx->nameOf(usr.port),
+                              ctx->nameOf(usr.cell));
+                return false;
+            }
+            nd.arcs.at(j).sink_wire = dst_wire;
+            // Set bounding box for this arc
+            nd.arcs.at(j).bb = ctx->getRouteBoundingBox(src_wire, dst_wire);
+            // Expand net bounding box to include this arc
+            nd.bb.x0 = std::min(nd.bb.x0, nd.arcs.at(j).bb.x0);
+            nd.bb.x1 = std::max(nd.bb.x1, nd.arcs.at(j).bb.x1);
+            nd.bb.y0 = std::min(nd.bb.y0, nd.arcs.at(j).bb.y0);
+            nd.bb.y1 = std::max(nd.bb.y1, nd.arcs.at(j).bb.y1);
+            // Add location to centroid sum
+            Loc usr_loc = ctx->getNetinfoSinkLoc(ni, j);
+            nd.cx += usr_loc.x;
+            nd.cy += usr_loc.y;
+        }
+        nd.hpwl = std::max(std::abs(nd.bb.y1 - nd.bb.y0) + std::abs(nd.bb.x1 - nd.bb.x0), 1);
+        nd.cx /= int(ni->users.size() + 1);
+        nd.cy /= int(ni->users.size() + 1);
+        if (ctx->debug)
+            log_info("%s: bb=(%d, %d)->(%d, %d) c=(%d, %d) hpwl=%d\n", ctx->nameOf(ni), nd.bb.x0, nd.bb.y0, nd.bb.x1,
+                     nd.bb.y1, nd.cx, nd.cy, nd.hpwl);
+        nd.bb.x0 = std::max(nd.bb.x0 - cfg.bb_margin_x, 0);
+        nd.bb.y0 = std::max(nd.bb.y0 - cfg.bb_margin_y, 0);
+        nd.bb.x1 = std::min(nd.bb.x1 + cfg.bb_margin_x, ctx->getGridDimX());
+        nd.bb.y1 = std::min(nd.bb.y1 + cfg.bb_margin_y, ctx->getGridDimY());
+        return true;
+    }
 
     void setup_nets()
     {
@@ -134,121 +326,471 @@ struct Router2
             NetInfo *ni = net.second;
             ni->udata = i;
             nets_by_udata.at(i) = ni;
-            nets.at(i).arcs.resize(ni->users.size());
-
-            // Start net bounding box at overall min/max
-            nets.at(i).bb.x0 = std::numeric_limits<int>::max();
-            nets.at(i).bb.x1 = std::numeric_limits<int>::min();
-            nets.at(i).bb.y0 = std::numeric_limits<int>::max();
-            nets.at(i).bb.y1 = std::numeric_limits<int>::min();
-            nets.at(i).cx = 0;
-            nets.at(i).cy = 0;
-
-            if (ni->driver.cell != nullptr) {
-                Loc drv_loc = ctx->getBelLocation(ni->driver.cell->bel);
-                nets.at(i).cx += drv_loc.x;
-                nets.at(i).cy += drv_loc.y;
-            }
-
-            for (size_t j = 0; j < ni->users.size(); j++) {
-                auto &usr = ni->users.at(j);
-                WireId src_wire = ctx->getNetinfoSourceWire(ni), dst_wire = ctx->getNetinfoSinkWire(ni, usr);
-                nets.at(i).src_wire = src_wire;
-                if (ni->driver.cell == nullptr)
-                    src_wire = dst_wire;
-                if (ni->driver.cell == nullptr && dst_wire == WireId())
-                    continue;
-                if (src_wire == WireId())
-                    log_error("No wire found for port %s on source cell %s.\n", ctx->nameOf(ni->driver.port),
-                              ctx->nameOf(ni->driver.cell));
-                if (dst_wire == WireId())
-                    log_error("No wire found for port %s on destination cell %s.\n", ctx->nameOf(usr.port),
-                              ctx->nameOf(usr.cell));
-                nets.at(i).arcs.at(j).sink_wire = dst_wire;
-                // Set bounding box for this arc
-                nets.at(i).arcs.at(j).bb = ctx->getRouteBoundingBox(src_wire, dst_wire);
-                // Expand net bounding box to include this arc
-                nets.at(i).bb.x0 = std::min(nets.at(i).bb.x0, nets.at(i).arcs.at(j).bb.x0);
-                nets.at(i).bb.x1 = std::max(nets.at(i).bb.x1, nets.at(i).arcs.at(j).bb.x1);
-                nets.at(i).bb.y0 = std::min(nets.at(i).bb.y0, nets.at(i).arcs.at(j).bb.y0);
-                nets.at(i).bb.y1 = std::max(nets.at(i).bb.y1, nets.at(i).arcs.at(j).bb.y1);
-                // Add location to centroid sum
-                Loc usr_loc = ctx->getBelLocation(usr.cell->bel);
-                nets.at(i).cx += usr_loc.x;
-                nets.at(i).cy += usr_loc.y;
-            }
-            nets.at(i).hpwl = std::max(
-                    std::abs(nets.at(i).bb.y1 - nets.at(i).bb.y0) + std::abs(nets.at(i).bb.x1 - nets.at(i).bb.x0), 1);
-            nets.at(i).cx /= int(ni->users.size() + 1);
-            nets.at(i).cy /= int(ni->users.size() + 1);
-            if (ctx->debug)
-                log_info("%s: bb=(%d, %d)->(%d, %d) c=(%d, %d) hpwl=%d\n", ctx->nameOf(ni), nets.at(i).bb.x0,
-                         nets.at(i).bb.y0, nets.at(i).bb.x1, nets.at(i).bb.y1, nets.at(i).cx, nets.at(i).cy,
-                         nets.at(i).hpwl);
-            nets.at(i).bb.x0 = std::max(nets.at(i).bb.x0 - cfg.bb_margin_x, 0);
-            nets.at(i).bb.y0 = std::max(nets.at(i).bb.y0 - cfg.bb_margin_y, 0);
-            nets.at(i).bb.x1 = std::min(nets.at(i).bb.x1 + cfg.bb_margin_x, ctx->getGridDimX());
-            nets.at(i).bb.y1 = std::min(nets.at(i).bb.y1 + cfg.bb_margin_y, ctx->getGridDimY());
             i++;
         }
+        if (!cfg.only_nets.empty()) {
+            selected_nets.assign(nets_by_udata.size(), false);
+            for (IdString name : cfg.only_nets) {
+                auto found = ctx->nets.find(name);
+                if (found == ctx->nets.end())
+                    log_error("Net '%s' to reroute doesn't exist.\n", name.c_str(ctx));
+                selected_nets.at(found->second->udata) = true;
+            }
+        }
+        // Nets only touch their own data (including the sink caches of their NetInfo), so can be set up in
+        // parallel; errors are reported afterwards, for the first failing net in name order as before
+        std::atomic<bool> failed(false);
+        parallel_for(nets.size(), 256, [&](size_t i) {
+            if (!setup_net(i, false))
+                failed = true;
+        });
+        if (failed) {
+            for (size_t i = 0; i < nets.size(); i++)
+                setup_net(i, true);
+        }
     }
 
-    dict<WireId, int> wire_to_idx;
+    // Per-wire data, indexed by wire_to_idx; split into separate arrays by access pattern
     std::vector<PerWireData> flat_wires;
+    std::vector<PerWireVisit> wire_visit;
+    // Historical congestion cost
+    std::vector<float> wire_hist_cost;
+    // With router2/lookahead, the lookahead wire class of each wire
+    Router2Lookahead lookahead;
+    std::vector<int16_t> wire_lookahead_class;
+
+    // With router2/pruneWires, wires that can't reach any sink get no entry, and wire_to_idx returns -1 for them
+#ifdef ARCH_XILINX
+    // The Xilinx arch provides a dense wire numbering, which is used directly as index into flat_wires, or
+    // through wire_remap when pruning
+    std::vector<int32_t> wire_remap;
+    int wire_to_idx(WireId w) const
+    {
+        int32_t idx = ctx->getWireIndex(w);
+        return wire_remap.empty() ? idx : wire_remap[idx];
+    }
+#else
+    dict<WireId, int> wire_idx_map;
+    int wire_to_idx(WireId w) const
+    {
+        if (!cfg.prune_wires)
+            return wire_idx_map.at(w);
+        auto fnd = wire_idx_map.find(w);
+        return fnd == wire_idx_map.end() ? -1 : fnd->second;
+    }
+#endif
+
+    PerWireData &wire_data(WireId w) { return flat_wires[wire_to_idx(w)]; }
+
+    // Set for designs with at most cfg.small_design_cells cells, see find_useful_wires
+    bool small_design = false;
+
+#ifdef ARCH_XILINX
+    // Site of a site wire, as an index over the sites of all tiles, or -1 for wires outside sites
+    int32_t get_wire_site(WireId w) const
+    {
+        if (w == WireId() || w.tile == -1)
+            return -1;
+        int site = ctx->wireInfo(w).site;
+        return site < 0 ? -1 : ctx->tile_site_start[w.tile] + site;
+    }
+    // With cfg.site_abstraction, get_wire_site of each wire in flat_wires
+    std::vector<int32_t> wire_site;
+#endif
+
+    // Find the wires that can reach the sink of some arc, by a backwards search from all sinks. Wires that are
+    // already bound and net sources are kept too. The search doesn't step outside the region around the nets in the
+    // small design mode, nor into sites the design doesn't use with the site abstraction, so a kept wire can have
+    // pruned uphill neighbours as well as downhill ones: every caller of wire_to_idx must handle -1, in the backwards
+    // searches as much as in the forward one.
+#ifdef ARCH_XILINX
+    std::vector<char> find_useful_wires()
+    {
+        std::vector<char> useful(ctx->getWireIndexCount(), 0);
+        auto is_useful = [&](WireId w) { return useful[ctx->getWireIndex(w)] != 0; };
+        auto set_useful = [&](WireId w) { useful[ctx->getWireIndex(w)] = 1; };
+#else
+    pool<WireId> find_useful_wires()
+    {
+        pool<WireId> useful;
+        auto is_useful = [&](WireId w) { return useful.count(w) != 0; };
+        auto set_useful = [&](WireId w) { useful.insert(w); };
+#endif
+        std::vector<WireId> queue;
+        auto visit = [&](WireId w) {
+            if (w == WireId() || is_useful(w))
+                return;
+            set_useful(w);
+            queue.push_back(w);
+        };
+        // In the small design mode, the search doesn't leave the region around the nets
+        ArcBounds region;
+        region.x0 = region.y0 = std::numeric_limits<int>::max();
+        region.x1 = region.y1 = std::numeric_limits<int>::min();
+        if (small_design) {
+            for (auto &nd : nets) {
+                if (nd.arcs.empty())
+                    continue;
+                region.x0 = std::min(region.x0, nd.bb.x0 - cfg.small_design_margin);
+                region.y0 = std::min(region.y0, nd.bb.y0 - cfg.small_design_margin);
+                region.x1 = std::max(region.x1, nd.bb.x1 + cfg.small_design_margin);
+                region.y1 = std::max(region.y1, nd.bb.y1 + cfg.small_design_margin);
+            }
+        }
+        auto in_region = [&](WireId w) {
+            if (!small_design)
+                return true;
+            ArcBounds wire_loc = ctx->getRouteBoundingBox(w, w);
+            return region.distance(Loc((wire_loc.x0 + wire_loc.x1) / 2, (wire_loc.y0 + wire_loc.y1) / 2, 0)) == 0;
+        };
+#ifdef ARCH_XILINX
+        // With the site abstraction, the search only enters the sites that the design uses
+        std::vector<char> used_sites;
+        if (cfg.site_abstraction) {
+            used_sites.resize(ctx->tile_site_start.back(), 0);
+            auto use_site = [&](WireId w) {
+                int32_t site = get_wire_site(w);
+                if (site != -1)
+                    used_sites[site] = 1;
+            };
+            for (auto &nd : nets) {
+                use_site(nd.src_wire);
+                for (auto &ad : nd.arcs)
+                    use_site(ad.sink_wire);
+            }
+            for (auto ni : nets_by_udata)
+                for (auto &w : ni->wires)
+                    use_site(w.first);
+        }
+        auto in_used_site = [&](WireId w) {
+            int32_t site = used_sites.empty() ? -1 : get_wire_site(w);
+            return site == -1 || used_sites[site];
+        };
+#else
+        auto in_used_site = [&](WireId) { return true; };
+#endif
+        for (auto &nd : nets) {
+            for (auto &ad : nd.arcs)
+                visit(ad.sink_wire);
+        }
+        for (size_t i = 0; i < queue.size(); i++) {
+            for (auto pip : ctx->getPipsUphill(queue[i])) {
+                WireId src = ctx->getPipSrcWire(pip);
+                if (src != WireId() && !is_useful(src) && in_used_site(src) && in_region(src))
+                    visit(src);
+            }
+        }
+        for (auto &nd : nets) {
+            if (nd.src_wire != WireId())
+                set_useful(nd.src_wire);
+        }
+        for (auto ni : nets_by_udata) {
+            for (auto &w : ni->wires)
+                set_useful(w.first);
+        }
+        return useful;
+    }
 
-    PerWireData &wire_data(WireId w) { return flat_wires[wire_to_idx.at(w)]; }
+    // The device is split into one vertical stripe per NUMA node, for placing the per-wire data and preferring the
+    // partitions near it; 0 unless cfg.numa is set and the threads are pinned to more than one node
+    int numa_stripe_node(int x)
+    {
+        int nodes = cfg.numa ? ctx->threadPool().numa_nodes() : 1;
+        return std::max(0, std::min(nodes - 1, int(int64_t(x) * nodes / std::max(1, ctx->getGridDimX()))));
+    }
+
+    // Move the pages of flat_wires and wire_visit to the node of the stripe of the first wire on them. Wires are
+    // numbered tile by tile, so pages are mostly within one stripe.
+    void place_wires_numa()
+    {
+        if (!cfg.numa || ctx->threadPool().numa_nodes() <= 1)
+            return;
+        auto &pool = ctx->threadPool();
+        auto place = [&](const char *base, size_t item_size) {
+            const size_t page = 4096;
+            size_t per_page = std::max<size_t>(1, page / item_size);
+            size_t run_start = 0;
+            int run_node = -1;
+            for (size_t i = 0; i <= flat_wires.size(); i += per_page) {
+                int node = (i < flat_wires.size()) ? numa_stripe_node(flat_wires[i].x) : -1;
+                if (node == run_node)
+                    continue;
+                if (run_node != -1)
+                    pool.bind_memory(base + run_start * item_size,
+                                     (std::min(i, flat_wires.size()) - run_start) * item_size, run_node);
+                run_start = i;
+                run_node = node;
+            }
+        };
+        place(reinterpret_cast<const char *>(flat_wires.data()), sizeof(PerWireData));
+        place(reinterpret_cast<const char *>(wire_visit.data()), sizeof(PerWireVisit));
+    }
 
     void setup_wires()
     {
         // Set up per-wire structures, so that MT parts don't have to do any memory allocation
         // This is possibly quite wasteful and not cache-optimal; further consideration necessary
-        for (auto wire : ctx->getWires()) {
+        auto pstart = std::chrono::high_resolution_clock::now();
+        int pruned = 0;
+#ifdef ARCH_XILINX
+        std::vector<char> useful;
+        if (cfg.prune_wires) {
+            useful = find_useful_wires();
+            wire_remap.assign(ctx->getWireIndexCount(), -1);
+            int32_t next_idx = 0;
+            for (int32_t idx = 0; idx < ctx->getWireIndexCount(); idx++) {
+                if (useful[idx])
+                    wire_remap[idx] = next_idx++;
+                else if (ctx->getWireByIndex(idx) != WireId())
+                    ++pruned;
+            }
+            flat_wires.resize(next_idx);
+        } else {
+            flat_wires.resize(ctx->getWireIndexCount());
+        }
+        // Wire locations only depend on the device, so are kept in the chipdb cache as x, y per dense wire index.
+        // They are only recorded when every wire is visited, i.e. without pruning.
+        std::vector<int16_t> wire_locs;
+        bool cached_locs = ctx->chipdb_cache.get_vector("router2/wireLocs", wire_locs) &&
+                           wire_locs.size() == 2 * size_t(ctx->getWireIndexCount());
+        if (!cached_locs && ctx->chipdb_cache.enabled() && !cfg.prune_wires)
+            wire_locs.assign(2 * size_t(ctx->getWireIndexCount()), 0);
+        // Likewise the device part of wire_drive, per dense wire index
+        std::vector<uint8_t> drive_cache;
+        bool cached_drive = ctx->chipdb_cache.get_vector("router2/wireDrive", drive_cache) &&
+                            drive_cache.size() == size_t(ctx->getWireIndexCount());
+        if (!cached_drive && ctx->chipdb_cache.enabled() && !cfg.prune_wires)
+            drive_cache.assign(ctx->getWireIndexCount(), 0);
+#else
+        pool<WireId> useful;
+        if (cfg.prune_wires)
+            useful = find_useful_wires();
+#endif
+        auto init_wire = [&](WireId wire) {
             PerWireData pwd;
             pwd.w = wire;
             NetInfo *bound = ctx->getBoundWireNet(wire);
             if (bound != nullptr) {
                 pwd.bound_nets[bound->udata] = std::make_pair(1, bound->wires.at(wire).pip);
-                if (bound->wires.at(wire).strength > STRENGTH_STRONG)
+                wire_use_count.fetch_add(1, std::memory_order_relaxed);
+                if (bound->wires.at(wire).strength > STRENGTH_STRONG || !is_selected(bound))
                     pwd.unavailable = true;
             }
 
-            ArcBounds wire_loc = ctx->getRouteBoundingBox(wire, wire);
-            pwd.x = (wire_loc.x0 + wire_loc.x1) / 2;
-            pwd.y = (wire_loc.y0 + wire_loc.y1) / 2;
-
-            wire_to_idx[wire] = int(flat_wires.size());
-            flat_wires.push_back(pwd);
+#ifdef ARCH_XILINX
+            if (cached_locs) {
+                int32_t idx = ctx->getWireIndex(wire);
+                pwd.x = wire_locs[2 * idx];
+                pwd.y = wire_locs[2 * idx + 1];
+            } else
+#endif
+            {
+                ArcBounds wire_loc = ctx->getRouteBoundingBox(wire, wire);
+                pwd.x = (wire_loc.x0 + wire_loc.x1) / 2;
+                pwd.y = (wire_loc.y0 + wire_loc.y1) / 2;
+#ifdef ARCH_XILINX
+                if (!wire_locs.empty()) {
+                    int32_t idx = ctx->getWireIndex(wire);
+                    wire_locs[2 * idx] = pwd.x;
+                    wire_locs[2 * idx + 1] = pwd.y;
+                }
+#endif
+            }
+            return pwd;
+        };
+        auto init_drive = [&](WireId wire) {
+            uint8_t flags = 0;
+#ifdef ARCH_XILINX
+            if (cached_drive) {
+                flags = drive_cache[ctx->getWireIndex(wire)];
+            } else
+#endif
+            {
+                for (auto bp : ctx->getWireBelPins(wire))
+                    if (ctx->getBelPinType(bp.bel, bp.pin) != PORT_IN) {
+                        flags |= WIRE_BEL_OUT;
+                        break;
+                    }
+                for (auto pip : ctx->getPipsUphill(wire)) {
+                    (void)pip;
+                    flags |= WIRE_UPHILL;
+                    break;
+                }
+#ifdef ARCH_XILINX
+                if (!drive_cache.empty())
+                    drive_cache[ctx->getWireIndex(wire)] = flags;
+#endif
+            }
+            if (flags & WIRE_UPHILL)
+                for (auto pip : ctx->getPipsUphill(wire))
+                    if (ctx->checkPipAvail(pip)) {
+                        flags |= WIRE_UPHILL_AVAIL;
+                        break;
+                    }
+            return flags;
+        };
+#ifdef ARCH_XILINX
+        // Every wire has its own slot in flat_wires, so ranges of the dense wire numbering can be set up in parallel
+        wire_drive.resize(flat_wires.size());
+        const int32_t chunk = 4096;
+        int32_t count = ctx->getWireIndexCount();
+        parallel_for((count + chunk - 1) / chunk, 16, [&](size_t c) {
+            for (int32_t idx = int32_t(c) * chunk; idx < std::min(count, int32_t(c + 1) * chunk); idx++) {
+                if (cfg.prune_wires && !useful[idx])
+                    continue;
+                WireId wire = ctx->getWireByIndex(idx);
+                if (wire == WireId())
+                    continue;
+                flat_wires[wire_to_idx(wire)] = init_wire(wire);
+                wire_drive[wire_to_idx(wire)] = init_drive(wire);
+            }
+        });
+        if (!cached_locs && !wire_locs.empty())
+            ctx->chipdb_cache.put_vector("router2/wireLocs", wire_locs);
+        if (!cached_drive && !drive_cache.empty())
+            ctx->chipdb_cache.put_vector("router2/wireDrive", drive_cache);
+#else
+        if (cfg.prune_wires)
+            wire_idx_map.reserve(useful.size());
+        for (auto wire : ctx->getWires()) {
+            if (cfg.prune_wires && !useful.count(wire)) {
+                ++pruned;
+                continue;
+            }
+            wire_idx_map[wire] = int(flat_wires.size());
+            flat_wires.push_back(init_wire(wire));
+            wire_drive.push_back(init_drive(wire));
+        }
+#endif
+        wire_visit.resize(flat_wires.size());
+        wire_hist_cost.resize(flat_wires.size(), 1.0f);
+#ifdef ARCH_XILINX
+        if (cfg.site_abstraction) {
+            wire_site.resize(flat_wires.size());
+            parallel_for(flat_wires.size(), 4096, [&](size_t i) { wire_site[i] = get_wire_site(flat_wires[i].w); });
+        }
+#endif
+        place_wires_numa();
+        if (!cfg.lookahead_file.empty()) {
+            lookahead.init(ctx, cfg.lookahead_file, cfg.lookahead_radius, cfg.lookahead_samples, cfg.threads);
+            wire_lookahead_class.resize(flat_wires.size(), -1);
+            for (size_t i = 0; i < flat_wires.size(); i++)
+                if (flat_wires[i].w != WireId())
+                    wire_lookahead_class[i] = lookahead.wire_class(flat_wires[i].w);
+        }
+        if (cfg.prune_wires)
+            log_info("Pruned %d wires that can't reach any sink, %d left (%.02fs)\n", pruned, int(flat_wires.size()),
+                     std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - pstart).count());
+        if (cfg.perf_profile) {
+            const double mib = 1024.0 * 1024.0;
+            size_t heap_bound = 0;
+            for (auto &wd : flat_wires)
+                if (wd.bound_nets.capacity() > 2)
+                    heap_bound += wd.bound_nets.capacity() * sizeof(BoundNetEntry);
+            log_info("Router2 wire data: %d entries; search %.02fMiB (%dB/wire), binding %.02fMiB (%dB/wire) + "
+                     "%.02fMiB out-of-line bound nets\n",
+                     int(flat_wires.size()),
+                     (flat_wires.size() * (sizeof(PerWireVisit) + sizeof(float))) / mib,
+                     int(sizeof(PerWireVisit) + sizeof(float)), (flat_wires.size() * sizeof(PerWireData)) / mib,
+                     int(sizeof(PerWireData)), heap_bound / mib);
         }
     }
 
     struct QueuedWire
     {
 
-        explicit QueuedWire(int wire = -1, PipId pip = PipId(), Loc loc = Loc(), WireScore score = WireScore{},
-                            int randtag = 0)
-                : wire(wire), pip(pip), loc(loc), score(score), randtag(randtag){};
+        explicit QueuedWire(int wire = -1, WireScore score = WireScore{}, uint64_t key = 0)
+                : wire(wire), score(score), key(key){};
 
         int wire;
-        PipId pip;
-        Loc loc;
         WireScore score;
-        int randtag = 0;
+        // From queue_key(), so that the heap only compares one integer
+        uint64_t key = 0;
 
         struct Greater
         {
-            bool operator()(const QueuedWire &lhs, const QueuedWire &rhs) const noexcept
-            {
-                float lhs_score = lhs.score.cost + lhs.score.togo_cost,
-                      rhs_score = rhs.score.cost + rhs.score.togo_cost;
-                return lhs_score == rhs_score ? lhs.randtag > rhs.randtag : lhs_score > rhs_score;
-            }
+            bool operator()(const QueuedWire &lhs, const QueuedWire &rhs) const noexcept { return lhs.key > rhs.key; }
         };
     };
 
+    // Binary heap on a vector rather than a std::priority_queue, so that it can be cleared between searches
+    // without giving up its storage
+    struct WireQueue
+    {
+        std::vector<QueuedWire> heap;
+
+        bool empty() const { return heap.empty(); }
+        void clear() { heap.clear(); }
+        void push(const QueuedWire &qw)
+        {
+            heap.push_back(qw);
+            std::push_heap(heap.begin(), heap.end(), QueuedWire::Greater());
+        }
+        QueuedWire pop()
+        {
+            std::pop_heap(heap.begin(), heap.end(), QueuedWire::Greater());
+            QueuedWire qw = heap.back();
+            heap.pop_back();
+            return qw;
+        }
+    };
+
+    // FIFO for the backwards BFS, likewise reusable
+    struct WireFifo
+    {
+        std::vector<int> items;
+        size_t head = 0;
+
+        bool empty() const { return head == items.size(); }
+        void clear()
+        {
+            items.clear();
+            head = 0;
+        }
+        void push(int wire) { items.push_back(wire); }
+        int pop() { return items.at(head++); }
+    };
+
     bool hit_test_pip(ArcBounds &bb, Loc l) { return l.x >= bb.x0 && l.x <= bb.x1 && l.y >= bb.y0 && l.y <= bb.y1; }
 
     double curr_cong_weight, hist_cong_weight, estimate_weight;
 
+    // Work done by the router, reported for each iteration
+    struct RouteCounters
+    {
+        // Forward A*: wires popped from the queue and pushed onto it, and searches stopped by the toexplore limit
+        int64_t nodes_expanded = 0, heap_pushes = 0, explore_limit_hits = 0;
+        // Backwards BFS: wires expanded, searches that reached the source and searches stopped by backwards_limit
+        int64_t backwards_iters = 0, backwards_routed = 0, backwards_limit_hits = 0;
+        // Arcs that failed within the bounding box, whether or not they could then be retried without it
+        int64_t bb_failures = 0;
+        // Calls to route_net that routed every arc, and that left arcs to retry outside the bounding box
+        int64_t routed_nets = 0, failed_nets = 0;
+        // Arcs with a hold repair target that no route within the search limits met
+        int64_t hold_fallbacks = 0;
+        // Arcs that the site abstraction kept from routing within their own sites, retried through other used sites
+        int64_t site_fallbacks = 0;
+        // Arcs of the nets routed that were still legally routed and kept, and that were ripped up and rerouted
+        int64_t kept_arcs = 0, rerouted_arcs = 0;
+
+        void add(const RouteCounters &other)
+        {
+            nodes_expanded += other.nodes_expanded;
+            heap_pushes += other.heap_pushes;
+            explore_limit_hits += other.explore_limit_hits;
+            backwards_iters += other.backwards_iters;
+            backwards_routed += other.backwards_routed;
+            backwards_limit_hits += other.backwards_limit_hits;
+            bb_failures += other.bb_failures;
+            routed_nets += other.routed_nets;
+            failed_nets += other.failed_nets;
+            hold_fallbacks += other.hold_fallbacks;
+            site_fallbacks += other.site_fallbacks;
+            kept_arcs += other.kept_arcs;
+            rerouted_arcs += other.rerouted_arcs;
+        }
+    };
+
     struct ThreadContext
     {
         // Nets to route
@@ -258,19 +800,33 @@ struct Router2
 
         std::vector<int> route_arcs;
 
-        std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> queue;
+        WireQueue queue;
         // Special case where one net has multiple logical arcs to the same physical sink
         pool<WireId> processed_sinks;
 
         // Backwards routing
-        std::queue<int> backwards_queue;
+        WireFifo backwards_queue;
+
+        // Epoch of the current search, see PerWireVisit
+        uint32_t epoch = 0;
 
-        std::vector<int> dirty_wires;
+        // Shared tree mode for high fanout nets: the wires of the net's routing so far, which later searches of
+        // the same net are seeded from. With tree_reuse, the net is only in tree mode to reuse the arcs kept from
+        // the last iteration, and the backwards search is still used.
+        bool tree_mode = false, tree_reuse = false;
+        std::vector<int> tree_wires;
+        pool<int> tree_set;
+        std::vector<std::pair<int, int>> tree_seeds;
+
+        // Wires of the sink cone being walked, by cone wire number (-1 if not reached yet)
+        std::vector<int> cone_wires;
 
         // Thread bounding box
         ArcBounds bb;
 
         DeterministicRNG rng;
+
+        RouteCounters counters;
     };
 
     bool thread_test_wire(ThreadContext &t, PerWireData &w)
@@ -278,6 +834,53 @@ struct Router2
         return w.x >= t.bb.x0 && w.x <= t.bb.x1 && w.y >= t.bb.y0 && w.y <= t.bb.y1;
     }
 
+    // Add the routing of an arc to the shared tree of the current net
+    void add_arc_to_tree(ThreadContext &t, NetInfo *net, size_t i)
+    {
+        auto &ad = nets.at(net->udata).arcs.at(i);
+        if (!ad.routed)
+            return;
+        int cursor = wire_to_idx(ad.sink_wire);
+        while (t.tree_set.insert(cursor).second) {
+            t.tree_wires.push_back(cursor);
+            auto &bound = flat_wires.at(cursor).bound_nets;
+            auto fnd = bound.find(net->udata);
+            if (fnd == bound.end() || fnd->second.second == PipId())
+                break;
+            PipId pip = fnd->second.second;
+            cursor = wire_to_idx(ctx->getPipSrcWire(pip));
+        }
+    }
+
+    // In shared tree mode, also start the search from the tree wires closest to the sink, at no cost. Only wires
+    // nearer to the sink than the source is are considered, and at most tree_max_seeds of them
+    void seed_from_tree(ThreadContext &t, NetInfo *net, size_t i, WireId dst_wire)
+    {
+        auto &dwd = flat_wires.at(wire_to_idx(dst_wire));
+        auto &swd = flat_wires.at(wire_to_idx(nets.at(net->udata).src_wire));
+        int max_dist = std::abs(swd.x - dwd.x) + std::abs(swd.y - dwd.y);
+        t.tree_seeds.clear();
+        for (int w : t.tree_wires) {
+            auto &wd = flat_wires.at(w);
+            int dist = std::abs(wd.x - dwd.x) + std::abs(wd.y - dwd.y);
+            if (dist > max_dist || was_visited(t, w) || !thread_test_wire(t, wd))
+                continue;
+            t.tree_seeds.emplace_back(dist, w);
+        }
+        if (int(t.tree_seeds.size()) > cfg.tree_max_seeds) {
+            std::nth_element(t.tree_seeds.begin(), t.tree_seeds.begin() + cfg.tree_max_seeds, t.tree_seeds.end());
+            t.tree_seeds.resize(cfg.tree_max_seeds);
+        }
+        for (auto &seed : t.tree_seeds) {
+            int w = seed.second;
+            WireScore score{};
+            score.delay = score.min_delay = 0; // not used for costing
+            set_score_togo(score, cfg.estimate_weight * get_togo_cost(net, i, w, dst_wire));
+            t.queue.push(QueuedWire(w, score, queue_key(score, t.rng.rng())));
+            set_visited(t, w, flat_wires.at(w).bound_nets.at(net->udata).second, score);
+        }
+    }
+
     enum ArcRouteResult
     {
         ARC_SUCCESS,
@@ -301,10 +904,18 @@ struct Router2
 
     void bind_pip_internal(NetInfo *net, size_t user, int wire, PipId pip)
     {
-        auto &b = flat_wires.at(wire).bound_nets[net->udata];
+        auto &wd = flat_wires.at(wire);
+        auto &b = wd.bound_nets[net->udata];
         ++b.first;
         if (b.first == 1) {
             b.second = pip;
+            wire_use_count.fetch_add(1, std::memory_order_relaxed);
+            if (wd.bound_nets.size() > 1 && !wd.overuse_listed) {
+                // Wires are only touched by the thread routing their area, so the flag needs no locking
+                wd.overuse_listed = true;
+                std::lock_guard<std::mutex> lock(overused_mutex);
+                overused_list.push_back(wire);
+            }
         } else {
             NPNR_ASSERT(b.second == pip);
         }
@@ -316,6 +927,7 @@ struct Router2
         --b.first;
         if (b.first == 0) {
             wire_data(wire).bound_nets.erase(net->udata);
+            wire_use_count.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 
@@ -337,12 +949,13 @@ struct Router2
 
     float score_wire_for_arc(NetInfo *net, size_t user, WireId wire, PipId pip)
     {
-        auto &wd = wire_data(wire);
+        int wire_idx = wire_to_idx(wire);
+        auto &wd = flat_wires[wire_idx];
         auto &nd = nets.at(net->udata);
         float base_cost = ctx->getDelayNS(ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(wire).maxDelay() +
                                           ctx->getDelayEpsilon());
         float present_cost = present_wire_cost(wd, net->udata);
-        float hist_cost = wd.hist_cong_cost;
+        float hist_cost = wire_hist_cost[wire_idx];
         float bias_cost = 0;
         int source_uses = 0;
         if (wd.bound_nets.count(net->udata))
@@ -370,8 +983,15 @@ struct Router2
         int source_uses = 0;
         if (wd.bound_nets.count(net->udata))
             source_uses = wd.bound_nets.at(net->udata).first;
+        float delay = -1;
+        if (!cfg.lookahead_file.empty() && wd.w != sink) {
+            auto &sd = wire_data(sink);
+            delay = lookahead.estimate(wire_lookahead_class[wire], sd.x - wd.x, sd.y - wd.y);
+        }
+        if (delay < 0)
+            delay = ctx->getDelayNS(ctx->estimateDelay(wd.w, sink));
         // FIXME: timing/wirelength balance?
-        return (ctx->getDelayNS(ctx->estimateDelay(wd.w, sink)) / (1 + source_uses)) + cfg.ipin_cost_adder;
+        return (delay / (1 + source_uses)) + cfg.ipin_cost_adder;
     }
 
     bool check_arc_routing(NetInfo *net, size_t usr)
@@ -403,17 +1023,24 @@ struct Router2
         // and LUT
         if (iter_count > 0)
             return false; // heuristic to assume we've hit general routing
-        if (wire_data(wire).reserved_net != -1 && wire_data(wire).reserved_net != net->udata)
+        int idx = wire_to_idx(wire);
+        if (flat_wires[idx].reserved_net != -1 && flat_wires[idx].reserved_net != net->udata)
             return true; // reserved for another net
-        for (auto bp : ctx->getWireBelPins(wire))
-            if ((net->driver.cell == nullptr || bp.bel == net->driver.cell->bel) &&
-                ctx->getBelPinType(bp.bel, bp.pin) != PORT_IN)
+        // Any available uphill pip reaches general routing, see above. Which pips are available doesn't change while
+        // wires are reserved, so then this was found once in setup_wires.
+        if (reserving_wires) {
+            if (wire_drive[idx] & WIRE_UPHILL_AVAIL)
                 return false;
-        for (auto p : ctx->getPipsUphill(wire))
-            if (ctx->checkPipAvail(p)) {
-                if (!is_wire_undriveable(ctx->getPipSrcWire(p), net, iter_count + 1))
+        } else if (wire_drive[idx] & WIRE_UPHILL) {
+            for (auto p : ctx->getPipsUphill(wire))
+                if (ctx->checkPipAvail(p))
+                    return false;
+        }
+        if (wire_drive[idx] & WIRE_BEL_OUT)
+            for (auto bp : ctx->getWireBelPins(wire))
+                if ((net->driver.cell == nullptr || bp.bel == net->driver.cell->bel) &&
+                    ctx->getBelPinType(bp.bel, bp.pin) != PORT_IN)
                     return false;
-            }
         return true;
     }
 
@@ -456,8 +1083,12 @@ struct Router2
         return did_something;
     }
 
+    // Set while find_all_reserved_wires runs, before anything is bound
+    bool reserving_wires = false;
+
     void find_all_reserved_wires()
     {
+        reserving_wires = true;
         // Run iteratively, as reserving wires for one net might limit choices for another
         bool did_something = false;
         do {
@@ -470,85 +1101,403 @@ struct Router2
                     did_something |= reserve_wires_for_arc(net, i);
             }
         } while (did_something);
+        reserving_wires = false;
     }
 
-    void reset_wires(ThreadContext &t)
+    // Epochs handed out to searches; never 0, which is the epoch of wires that have not been visited yet
+    std::atomic<uint32_t> last_epoch{0};
+
+    void reset_wires(ThreadContext &t) { t.epoch = ++last_epoch; }
+
+    // Called between iterations, while no searches are running, long before the epoch counter could wrap
+    void reset_epochs()
     {
-        for (auto w : t.dirty_wires) {
-            flat_wires[w].visit.visited = false;
-            flat_wires[w].visit.dirty = false;
-            flat_wires[w].visit.pip = PipId();
-            flat_wires[w].visit.score = WireScore();
-        }
-        t.dirty_wires.clear();
+        if (last_epoch < 0xF0000000U)
+            return;
+        for (auto &v : wire_visit)
+            v.epoch = 0;
+        last_epoch = 0;
     }
 
     void set_visited(ThreadContext &t, int wire, PipId pip, WireScore score)
     {
-        auto &v = flat_wires.at(wire).visit;
-        if (!v.dirty)
-            t.dirty_wires.push_back(wire);
-        v.dirty = true;
-        v.visited = true;
+        auto &v = wire_visit.at(wire);
+        v.epoch = t.epoch;
         v.pip = pip;
         v.score = score;
     }
-    bool was_visited(int wire) { return flat_wires.at(wire).visit.visited; }
+    bool was_visited(ThreadContext &t, int wire) { return wire_visit.at(wire).epoch == t.epoch; }
 
 #ifdef ARCH_XILINX
-    // Special-case constant ground/vcc routing for Xilinx devices
-    void route_xilinx_const(ThreadContext &t, NetInfo *net, size_t i, int src_wire_idx, WireId dst_wire, bool is_mt,
-                            bool is_bb = true)
+    // Routes from the constant pseudo-network to a sink pin found by search, as pips relative to the tile of the
+    // sink, keyed by the value, the tile type and the wire of the sink. Sinks of the same kind are mostly tied off
+    // the same way, so a template is tried first and only sinks where it doesn't fit are searched for.
+    struct ConstTemplateStep
     {
-        auto &nd = nets[net->udata];
-        auto &ad = nd.arcs[i];
+        int32_t dtile, tile_type, index;
+    };
+    std::unordered_map<uint64_t, std::vector<ConstTemplateStep>> const_templates;
+    int const_template_hits = 0, const_searches = 0;
 
-        int backwards_iter = 0;
-        int backwards_limit = 5000000;
+    uint64_t const_template_key(WireId dst_wire, bool const_val) const
+    {
+        return (uint64_t(const_val) << 63) | (uint64_t(ctx->chip_info->tile_insts[dst_wire.tile].type) << 32) |
+               uint32_t(dst_wire.index);
+    }
 
-        bool const_val = false;
-        if (net->name == ctx->id("$PACKER_VCC_NET"))
-            const_val = true;
-        else
-            NPNR_ASSERT(net->name == ctx->id("$PACKER_GND_NET"));
+    void record_const_template(ThreadContext &t, int src_wire_idx, WireId dst_wire, bool const_val)
+    {
+        if (dst_wire.tile < 0 || const_templates.count(const_template_key(dst_wire, const_val)))
+            return;
+        std::vector<PipId> path;
+        for (int cursor = src_wire_idx; was_visited(t, cursor) && wire_visit.at(cursor).pip != PipId();) {
+            path.push_back(wire_visit.at(cursor).pip);
+            cursor = wire_to_idx(ctx->getPipDstWire(path.back()));
+        }
+        // Start the template at the last wire on the constant network
+        int start = -1;
+        for (int j = 0; j < int(path.size()); j++)
+            if (ctx->wireIntent(ctx->getPipSrcWire(path.at(j))) == (const_val ? ID_PSEUDO_VCC : ID_PSEUDO_GND))
+                start = j;
+        if (start == -1)
+            return;
+        auto &tmpl = const_templates[const_template_key(dst_wire, const_val)];
+        for (int j = start; j < int(path.size()); j++) {
+            PipId pip = path.at(j);
+            tmpl.push_back(ConstTemplateStep{pip.tile - dst_wire.tile, ctx->chip_info->tile_insts[pip.tile].type,
+                                             pip.index});
+        }
+    }
 
-        for (int allowed_cong = 0; allowed_cong < 10; allowed_cong++) {
-            backwards_iter = 0;
-            if (!t.backwards_queue.empty()) {
-                std::queue<int> new_queue;
-                t.backwards_queue.swap(new_queue);
-            }
-            t.backwards_queue.push(wire_to_idx.at(dst_wire));
-            reset_wires(t);
-            while (!t.backwards_queue.empty() && backwards_iter < backwards_limit) {
-                int cursor = t.backwards_queue.front();
-                t.backwards_queue.pop();
-                auto &cwd = flat_wires[cursor];
-                PipId cpip;
-                if (cwd.bound_nets.count(net->udata)) {
-                    // If we can tack onto existing routing; try that
-                    // Only do this if the existing routing is uncontented; however
-                    int cursor2 = cursor;
-                    bool bwd_merge_fail = false;
-                    while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
-                        if (int(flat_wires.at(cursor2).bound_nets.size()) > (allowed_cong + 1)) {
-                            bwd_merge_fail = true;
-                            break;
-                        }
-                        PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
-                        if (p == PipId())
-                            break;
-                        cursor2 = wire_to_idx.at(ctx->getPipSrcWire(p));
-                    }
-                    if (!bwd_merge_fail && cursor2 == src_wire_idx) {
-                        // Found a path to merge to existing routing; backwards
-                        cursor2 = cursor;
-                        while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
-                            PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
-                            if (p == PipId())
-                                break;
-                            cursor2 = wire_to_idx.at(ctx->getPipSrcWire(p));
-                            set_visited(t, cursor2, p, WireScore());
+    // Follow a template back from the sink, requiring every wire to be free; true if it reaches the constant network
+    bool apply_const_template(ThreadContext &t, NetInfo *net, WireId dst_wire, bool const_val, int &network_wire)
+    {
+        if (dst_wire.tile < 0)
+            return false;
+        auto fnd = const_templates.find(const_template_key(dst_wire, const_val));
+        if (fnd == const_templates.end())
+            return false;
+        reset_wires(t);
+        WireId cursor = dst_wire;
+        for (auto step = fnd->second.rbegin(); step != fnd->second.rend(); ++step) {
+            int tile = dst_wire.tile + step->dtile;
+            if (tile < 0 || tile >= ctx->chip_info->num_tiles)
+                return false;
+            if (ctx->chip_info->tile_insts[tile].type != step->tile_type)
+                return false;
+            PipId pip;
+            pip.tile = tile;
+            pip.index = step->index;
+            if (ctx->getPipDstWire(pip) != cursor)
+                return false;
+            if (!ctx->checkPipAvail(pip) && ctx->getBoundPipNet(pip) != net)
+                return false;
+            int cursor_idx = wire_to_idx(cursor);
+            auto &cwd = flat_wires.at(cursor_idx);
+            if (cwd.bound_nets.count(net->udata) && cwd.bound_nets.at(net->udata).second != pip)
+                return false;
+            WireId src = ctx->getPipSrcWire(pip);
+            int src_idx = wire_to_idx(src);
+            if (src_idx < 0)
+                return false;
+            auto &wd = flat_wires.at(src_idx);
+            if (wd.unavailable || (wd.reserved_net != -1 && wd.reserved_net != net->udata) ||
+                (!wd.bound_nets.empty() && !wd.bound_nets.count(net->udata)))
+                return false;
+            set_visited(t, src_idx, pip, WireScore());
+            cursor = src;
+        }
+        if (ctx->wireIntent(cursor) != (const_val ? ID_PSEUDO_VCC : ID_PSEUDO_GND))
+            return false;
+        network_wire = wire_to_idx(cursor);
+        return true;
+    }
+
+    // Backwards fan-in cones of sink wires, as pips relative to the tile of the sink (the first tile of its node, for
+    // a nodal sink), shared by all sinks with the same tile type and wire. The backwards search from a sink walks
+    // the cone of its kind, in the order the search would take in free routing, instead of finding the uphill pips
+    // of every wire again. Like constant templates, each pip is checked against the wire it should drive when used,
+    // and an arc whose sink doesn't have the shape of its cone goes back to the normal search.
+    struct SinkConeEdge
+    {
+        // Wires of the cone are numbered in search order, the sink being 0. The pip drives wire dst from wire src.
+        int32_t dst, src;
+        int32_t dtile, tile_type, index;
+    };
+    struct SinkCone
+    {
+        std::vector<SinkConeEdge> edges;
+        int32_t num_wires = 1;
+    };
+    std::vector<SinkCone> sink_cones;
+
+    int32_t sink_anchor_tile(WireId wire) const
+    {
+        return (wire.tile >= 0) ? wire.tile : nodeTileWire(ctx->chip_info, wire.index, 0).tile;
+    }
+
+    uint64_t sink_cone_key(WireId wire) const
+    {
+        int32_t index = (wire.tile >= 0) ? wire.index : nodeTileWire(ctx->chip_info, wire.index, 0).index;
+        return (uint64_t(ctx->chip_info->tile_insts[sink_anchor_tile(wire)].type) << 32) | uint32_t(index);
+    }
+
+    // Record the cone of a sink as far as a backwards search with the default limit would go without any routing
+    void build_sink_cone(SinkCone &cone, WireId sink)
+    {
+        int32_t anchor = sink_anchor_tile(sink);
+        std::vector<int> wires{wire_to_idx(sink)};
+        dict<int, int32_t> wire_nums;
+        wire_nums[wires.front()] = 0;
+        int expanded = 0;
+        for (size_t i = 0; i < wires.size() && expanded < cfg.backwards_max_iter; i++) {
+            bool did_something = false;
+            for (auto uh : ctx->getPipsUphill(flat_wires[wires[i]].w)) {
+                did_something = true;
+                int src = wire_to_idx(ctx->getPipSrcWire(uh));
+                if (src < 0)
+                    continue;
+                auto ins = wire_nums.emplace(src, int32_t(wires.size()));
+                if (ins.second)
+                    wires.push_back(src);
+                cone.edges.push_back(SinkConeEdge{int32_t(i), ins.first->second, uh.tile - anchor,
+                                                  ctx->chip_info->tile_insts[uh.tile].type, uh.index});
+            }
+            if (did_something)
+                ++expanded;
+        }
+        cone.num_wires = int32_t(wires.size());
+    }
+
+    void setup_sink_cones()
+    {
+        std::unordered_map<uint64_t, int32_t> cone_by_key;
+        int sinks = 0;
+        for (size_t i = 0; i < nets_by_udata.size(); i++) {
+            for (auto &ad : nets.at(i).arcs) {
+                if (ad.sink_wire == WireId() || wire_to_idx(ad.sink_wire) < 0)
+                    continue;
+                auto ins = cone_by_key.emplace(sink_cone_key(ad.sink_wire), int32_t(sink_cones.size()));
+                if (ins.second) {
+                    sink_cones.emplace_back();
+                    build_sink_cone(sink_cones.back(), ad.sink_wire);
+                }
+                ad.cone = ins.first->second;
+                ++sinks;
+            }
+        }
+        if (ctx->verbose)
+            log_info("    %d backwards search cones for %d sinks\n", int(sink_cones.size()), sinks);
+    }
+
+    // Backwards search from a sink over its cone. Returns false if the cone doesn't fit the sink, leaving wires
+    // visited that the caller must reset.
+    bool backwards_cone(ThreadContext &t, NetInfo *net, const SinkCone &cone, WireId dst_wire, int src_wire_idx,
+                        int &iters)
+    {
+        int32_t anchor = sink_anchor_tile(dst_wire);
+        auto &cw = t.cone_wires;
+        cw.assign(cone.num_wires, -1);
+        cw[0] = wire_to_idx(dst_wire);
+        int32_t curr = -1;
+        bool expand = false;
+        PipId cpip;
+        for (auto &e : cone.edges) {
+            if (e.dst != curr) {
+                // Next wire of the cone: only expanded if the search reached it
+                if (was_visited(t, src_wire_idx))
+                    break;
+                curr = e.dst;
+                int cursor = cw[curr];
+                expand = cursor != -1 && (curr == 0 || was_visited(t, cursor));
+                if (!expand)
+                    continue;
+                ++iters;
+                if (backwards_merge(t, net, cursor, src_wire_idx))
+                    break;
+                auto &cwd = flat_wires[cursor];
+                cpip = cwd.bound_nets.count(net->udata) ? cwd.bound_nets.at(net->udata).second : PipId();
+            }
+            if (!expand)
+                continue;
+            PipId uh;
+            uh.tile = anchor + e.dtile;
+            uh.index = e.index;
+            if (uh.tile < 0 || uh.tile >= ctx->chip_info->num_tiles ||
+                ctx->chip_info->tile_insts[uh.tile].type != e.tile_type)
+                return false;
+            if (ctx->getPipDstWire(uh) != flat_wires[cw[curr]].w)
+                return false;
+            int next = backwards_step(t, net, uh, cpip);
+            if (next >= 0 && cw[e.src] == -1)
+                cw[e.src] = next;
+        }
+        return true;
+    }
+#endif
+
+    // Called when the backwards search reaches a wire: if it is already routed from the source, uncontended, follow
+    // that routing back and return true
+    bool backwards_merge(ThreadContext &t, NetInfo *net, int cursor, int src_wire_idx)
+    {
+        if (!flat_wires[cursor].bound_nets.count(net->udata))
+            return false;
+        int cursor2 = cursor;
+        while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
+            PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
+            if (p == PipId())
+                break;
+            cursor2 = wire_to_idx(ctx->getPipSrcWire(p));
+        }
+        if (cursor2 != src_wire_idx)
+            return false;
+        // Found a path to merge to existing routing; backwards
+        cursor2 = cursor;
+        while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
+            PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
+            if (p == PipId())
+                break;
+            cursor2 = wire_to_idx(ctx->getPipSrcWire(p));
+            set_visited(t, cursor2, p, WireScore());
+        }
+        return true;
+    }
+
+    // Step of the backwards search uphill over a pip, where cpip is the pip that already drives the wire with the
+    // net, if any. Returns the wire reached, or -1 if the pip can't be used.
+    int backwards_step(ThreadContext &t, NetInfo *net, PipId uh, PipId cpip)
+    {
+        if (!ctx->checkPipAvail(uh) && ctx->getBoundPipNet(uh) != net)
+            return -1;
+        if (cpip != PipId() && cpip != uh)
+            return -1; // don't allow multiple pips driving a wire with a net
+        int next = wire_to_idx(ctx->getPipSrcWire(uh));
+        if (next < 0 || was_visited(t, next))
+            return -1; // skip wires that have been pruned or already visited
+        auto &wd = flat_wires[next];
+        if (wd.unavailable)
+            return -1;
+        if (wd.reserved_net != -1 && wd.reserved_net != net->udata)
+            return -1;
+        if (wd.bound_nets.size() > 1 || (wd.bound_nets.size() == 1 && !wd.bound_nets.count(net->udata)))
+            return -1; // never allow congestion in backwards routing
+        if (!thread_test_wire(t, wd))
+            return -1; // thread safety issue
+        set_visited(t, next, uh, WireScore());
+        return next;
+    }
+
+#ifdef ARCH_XILINX
+    // Continue uphill over the constant pseudo-network from a wire on it to the source
+    bool walk_const_network(ThreadContext &t, NetInfo *net, int cursor, int src_wire_idx, bool const_val,
+                            bool required)
+    {
+        while (cursor != src_wire_idx) {
+            auto &cwd = flat_wires.at(cursor);
+            bool found = false;
+            for (auto p : ctx->getPipsUphill(cwd.w)) {
+                if (!ctx->checkPipAvail(p) && ctx->getBoundPipNet(p) != net)
+                    continue;
+                WireId src = ctx->getPipSrcWire(p);
+                if (ctx->wireIntent(src) != (const_val ? ID_PSEUDO_VCC : ID_PSEUDO_GND))
+                    continue;
+                if (is_wire_undriveable(src, net) || wire_to_idx(src) < 0)
+                    continue;
+                cursor = wire_to_idx(src);
+                set_visited(t, cursor, p, WireScore());
+                found = true;
+                break;
+            }
+            if (!found) {
+                if (required)
+                    log_error("Invalid global constant node '%s'\n", ctx->nameOfWire(cwd.w));
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Bind the visited route from the source to the sink of an arc
+    void bind_const_route(ThreadContext &t, NetInfo *net, size_t i, int src_wire_idx, WireId dst_wire, bool is_mt)
+    {
+        auto &ad = nets[net->udata].arcs[i];
+        int dst_wire_idx = wire_to_idx(dst_wire);
+        ROUTE_LOG_DBG("   Routed (backwards): ");
+        int cursor_fwd = src_wire_idx;
+        bind_pip_internal(net, i, src_wire_idx, PipId());
+        while (was_visited(t, cursor_fwd)) {
+            auto &v = wire_visit.at(cursor_fwd);
+            cursor_fwd = wire_to_idx(ctx->getPipDstWire(v.pip));
+            bind_pip_internal(net, i, cursor_fwd, v.pip);
+            if (ctx->debug) {
+                auto &wd = flat_wires.at(cursor_fwd);
+                ROUTE_LOG_DBG("      wire: %s (curr %d hist %f)\n", ctx->nameOfWire(wd.w),
+                              int(wd.bound_nets.size()) - 1, wire_hist_cost.at(cursor_fwd));
+            }
+        }
+        NPNR_ASSERT(cursor_fwd == dst_wire_idx);
+        ad.routed = true;
+        t.processed_sinks.insert(dst_wire);
+        reset_wires(t);
+    }
+
+    // Special-case constant ground/vcc routing for Xilinx devices
+    void route_xilinx_const(ThreadContext &t, NetInfo *net, size_t i, int src_wire_idx, WireId dst_wire, bool is_mt,
+                            bool is_bb = true)
+    {
+        int backwards_iter = 0;
+        int backwards_limit = 5000000;
+
+        bool const_val = false;
+        if (net->name == ctx->id("$PACKER_VCC_NET"))
+            const_val = true;
+        else
+            NPNR_ASSERT(net->name == ctx->id("$PACKER_GND_NET"));
+
+        // The templates are shared between threads, so they are only used by the serial router
+        int network_wire;
+        if (!is_mt && apply_const_template(t, net, dst_wire, const_val, network_wire) &&
+            walk_const_network(t, net, network_wire, src_wire_idx, const_val, false)) {
+            ++const_template_hits;
+            bind_const_route(t, net, i, src_wire_idx, dst_wire, is_mt);
+            return;
+        }
+        if (!is_mt)
+            ++const_searches;
+
+        for (int allowed_cong = 0; allowed_cong < 10; allowed_cong++) {
+            backwards_iter = 0;
+            t.backwards_queue.clear();
+            t.backwards_queue.push(wire_to_idx(dst_wire));
+            reset_wires(t);
+            while (!t.backwards_queue.empty() && backwards_iter < backwards_limit) {
+                int cursor = t.backwards_queue.pop();
+                auto &cwd = flat_wires[cursor];
+                PipId cpip;
+                if (cwd.bound_nets.count(net->udata)) {
+                    // If we can tack onto existing routing; try that
+                    // Only do this if the existing routing is uncontented; however
+                    int cursor2 = cursor;
+                    bool bwd_merge_fail = false;
+                    while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
+                        if (int(flat_wires.at(cursor2).bound_nets.size()) > (allowed_cong + 1)) {
+                            bwd_merge_fail = true;
+                            break;
+                        }
+                        PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
+                        if (p == PipId())
+                            break;
+                        cursor2 = wire_to_idx(ctx->getPipSrcWire(p));
+                    }
+                    if (!bwd_merge_fail && cursor2 == src_wire_idx) {
+                        // Found a path to merge to existing routing; backwards
+                        cursor2 = cursor;
+                        while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
+                            PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
+                            if (p == PipId())
+                                break;
+                            cursor2 = wire_to_idx(ctx->getPipSrcWire(p));
+                            set_visited(t, cursor2, p, WireScore());
                         }
                         break;
                     }
@@ -562,27 +1511,7 @@ struct Router2
                     log("    Hit global network at %s\n", ctx->nameOfWire(cwd.w));
 #endif
                     // We've hit the constant pseudo-network, continue from here
-                    int cursor2 = cursor;
-                    while (cursor2 != src_wire_idx) {
-                        auto &c2wd = flat_wires.at(cursor2);
-                        bool found = false;
-                        for (auto p : ctx->getPipsUphill(c2wd.w)) {
-                            if (!ctx->checkPipAvail(p) && ctx->getBoundPipNet(p) != net)
-                                continue;
-                            WireId src = ctx->getPipSrcWire(p);
-                            if (ctx->wireIntent(src) != (const_val ? ID_PSEUDO_VCC : ID_PSEUDO_GND))
-                                continue;
-                            if (is_wire_undriveable(src, net))
-                                continue;
-                            cursor2 = wire_to_idx.at(src);
-                            set_visited(t, cursor2, p, WireScore());
-                            found = true;
-                            break;
-                        }
-                        if (!found)
-                            log_error("Invalid global constant node '%s'\n", ctx->nameOfWire(c2wd.w));
-                    }
-
+                    walk_const_network(t, net, cursor, src_wire_idx, const_val, true);
                     break;
                 }
 #if 0
@@ -600,9 +1529,9 @@ struct Router2
                         continue;
                     if (cpip != PipId() && cpip != uh)
                         continue; // don't allow multiple pips driving a wire with a net
-                    int next = wire_to_idx.at(ctx->getPipSrcWire(uh));
-                    if (was_visited(next))
-                        continue; // skip wires that have already been visited
+                    int next = wire_to_idx(ctx->getPipSrcWire(uh));
+                    if (next < 0 || was_visited(t, next))
+                        continue; // skip wires that have been pruned or already visited
                     auto &wd = flat_wires[next];
                     if (wd.unavailable)
                         continue;
@@ -617,25 +1546,10 @@ struct Router2
                 if (did_something)
                     ++backwards_iter;
             }
-            int dst_wire_idx = wire_to_idx.at(dst_wire);
-            if (was_visited(src_wire_idx)) {
-                ROUTE_LOG_DBG("   Routed (backwards): ");
-                int cursor_fwd = src_wire_idx;
-                bind_pip_internal(net, i, src_wire_idx, PipId());
-                while (was_visited(cursor_fwd)) {
-                    auto &v = flat_wires.at(cursor_fwd).visit;
-                    cursor_fwd = wire_to_idx.at(ctx->getPipDstWire(v.pip));
-                    bind_pip_internal(net, i, cursor_fwd, v.pip);
-                    if (ctx->debug) {
-                        auto &wd = flat_wires.at(cursor_fwd);
-                        ROUTE_LOG_DBG("      wire: %s (curr %d hist %f)\n", ctx->nameOfWire(wd.w),
-                                      int(wd.bound_nets.size()) - 1, wd.hist_cong_cost);
-                    }
-                }
-                NPNR_ASSERT(cursor_fwd == dst_wire_idx);
-                ad.routed = true;
-                t.processed_sinks.insert(dst_wire);
-                reset_wires(t);
+            if (was_visited(t, src_wire_idx)) {
+                if (!is_mt)
+                    record_const_template(t, src_wire_idx, dst_wire, const_val);
+                bind_const_route(t, net, i, src_wire_idx, dst_wire, is_mt);
                 return;
             }
         }
@@ -644,7 +1558,8 @@ struct Router2
     }
 #endif
 
-    ArcRouteResult route_arc(ThreadContext &t, NetInfo *net, size_t i, bool is_mt, bool is_bb = true)
+    ArcRouteResult route_arc(ThreadContext &t, NetInfo *net, size_t i, bool is_mt, bool is_bb = true,
+                             bool is_site = true)
     {
 
         auto &nd = nets[net->udata];
@@ -659,11 +1574,28 @@ struct Router2
         if (dst_wire == WireId())
             ARC_LOG_ERR("No wire found for port %s on destination cell %s.\n", ctx->nameOf(usr.port),
                         ctx->nameOf(usr.cell));
-        int src_wire_idx = wire_to_idx.at(src_wire);
-        int dst_wire_idx = wire_to_idx.at(dst_wire);
+        int src_wire_idx = wire_to_idx(src_wire);
+        int dst_wire_idx = wire_to_idx(dst_wire);
         // Check if arc was already done _in this iteration_
         if (t.processed_sinks.count(dst_wire))
             return ARC_SUCCESS;
+#ifdef ARCH_XILINX
+        // With the site abstraction, the only site wires the search may use are those of the arc's own sites, unless
+        // this is the retry of an arc that needs to pass through another site
+        int32_t src_site = -1, dst_site = -1;
+        if (cfg.site_abstraction) {
+            src_site = get_wire_site(src_wire);
+            dst_site = get_wire_site(dst_wire);
+        }
+        auto other_site = [&](int idx) {
+            if (!cfg.site_abstraction || !is_site)
+                return false;
+            int32_t site = wire_site[idx];
+            return site != -1 && site != src_site && site != dst_site;
+        };
+#else
+        auto other_site = [&](int) { return false; };
+#endif
 
             // Special case
 #ifdef ARCH_XILINX
@@ -673,92 +1605,72 @@ struct Router2
         }
 #endif
 
-        if (!t.queue.empty()) {
-            std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> new_queue;
-            t.queue.swap(new_queue);
-        }
-        if (!t.backwards_queue.empty()) {
-            std::queue<int> new_queue;
-            t.backwards_queue.swap(new_queue);
-        }
+        t.queue.clear();
+        t.backwards_queue.clear();
+        reset_wires(t);
         // First try strongly iteration-limited routing backwards BFS
         // this will deal with certain nets faster than forward A*
         // and comes at a minimal performance cost for the others
         // This could also be used to speed up forwards routing by a hybrid
         // bidirectional approach
+        // (the seeded forward search of shared tree mode already reuses existing routing, so skip it there)
         int backwards_iter = 0;
         int backwards_limit = ctx->getBelGlobalBuf(net->driver.cell->bel)
                                       ? cfg.global_backwards_max_iter
                                       : (net->users.size() > 40 ? 20 * cfg.backwards_max_iter : cfg.backwards_max_iter);
-        t.backwards_queue.push(wire_to_idx.at(dst_wire));
-        while (!t.backwards_queue.empty() && backwards_iter < backwards_limit) {
-            int cursor = t.backwards_queue.front();
-            t.backwards_queue.pop();
+        // The backwards search finds short routes, which is the opposite of what a hold repair target wants
+        if ((t.tree_mode && !t.tree_reuse) || ad.min_delay_target > 0)
+            backwards_limit = 0;
+        bool walked_cone = false;
+#ifdef ARCH_XILINX
+        if (ad.cone != -1 && backwards_limit == cfg.backwards_max_iter) {
+            // The precomputed cone of the sink stands in for the search below
+            walked_cone = backwards_cone(t, net, sink_cones.at(ad.cone), dst_wire, src_wire_idx, backwards_iter);
+            if (!walked_cone) {
+                ad.cone = -1;
+                backwards_iter = 0;
+                reset_wires(t);
+            }
+        }
+#endif
+        if (!walked_cone && backwards_limit > 0)
+            t.backwards_queue.push(wire_to_idx(dst_wire));
+        while (!walked_cone && !t.backwards_queue.empty() && backwards_iter < backwards_limit) {
+            int cursor = t.backwards_queue.pop();
             auto &cwd = flat_wires[cursor];
             PipId cpip;
             if (cwd.bound_nets.count(net->udata)) {
                 // If we can tack onto existing routing; try that
                 // Only do this if the existing routing is uncontented; however
-                int cursor2 = cursor;
-                bool bwd_merge_fail = false;
-                while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
-                    PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
-                    if (p == PipId())
-                        break;
-                    cursor2 = wire_to_idx.at(ctx->getPipSrcWire(p));
-                }
-                if (!bwd_merge_fail && cursor2 == src_wire_idx) {
-                    // Found a path to merge to existing routing; backwards
-                    cursor2 = cursor;
-                    while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
-                        PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
-                        if (p == PipId())
-                            break;
-                        cursor2 = wire_to_idx.at(ctx->getPipSrcWire(p));
-                        set_visited(t, cursor2, p, WireScore());
-                    }
+                if (backwards_merge(t, net, cursor, src_wire_idx))
                     break;
-                }
                 cpip = cwd.bound_nets.at(net->udata).second;
             }
             bool did_something = false;
             for (auto uh : ctx->getPipsUphill(flat_wires[cursor].w)) {
                 did_something = true;
-                if (!ctx->checkPipAvail(uh) && ctx->getBoundPipNet(uh) != net)
-                    continue;
-                if (cpip != PipId() && cpip != uh)
-                    continue; // don't allow multiple pips driving a wire with a net
-                int next = wire_to_idx.at(ctx->getPipSrcWire(uh));
-                if (was_visited(next))
-                    continue; // skip wires that have already been visited
-                auto &wd = flat_wires[next];
-                if (wd.unavailable)
-                    continue;
-                if (wd.reserved_net != -1 && wd.reserved_net != net->udata)
-                    continue;
-                if (wd.bound_nets.size() > 1 || (wd.bound_nets.size() == 1 && !wd.bound_nets.count(net->udata)))
-                    continue; // never allow congestion in backwards routing
-                if (!thread_test_wire(t, wd))
-                    continue; // thread safety issue
-                t.backwards_queue.push(next);
-                set_visited(t, next, uh, WireScore());
+                int next = backwards_step(t, net, uh, cpip);
+                if (next >= 0)
+                    t.backwards_queue.push(next);
             }
             if (did_something)
                 ++backwards_iter;
         }
+        t.counters.backwards_iters += backwards_iter;
         // Check if backwards routing succeeded in reaching source
-        if (was_visited(src_wire_idx)) {
+        if (was_visited(t, src_wire_idx)) {
+            ++t.counters.backwards_routed;
             ROUTE_LOG_DBG("   Routed (backwards): ");
             int cursor_fwd = src_wire_idx;
             bind_pip_internal(net, i, src_wire_idx, PipId());
-            while (was_visited(cursor_fwd)) {
-                auto &v = flat_wires.at(cursor_fwd).visit;
-                cursor_fwd = wire_to_idx.at(ctx->getPipDstWire(v.pip));
+            while (was_visited(t, cursor_fwd)) {
+                auto &v = wire_visit.at(cursor_fwd);
+                cursor_fwd = wire_to_idx(ctx->getPipDstWire(v.pip));
                 bind_pip_internal(net, i, cursor_fwd, v.pip);
                 if (ctx->debug) {
                     auto &wd = flat_wires.at(cursor_fwd);
                     ROUTE_LOG_DBG("      wire: %s (curr %d hist %f)\n", ctx->nameOfWire(wd.w),
-                                  int(wd.bound_nets.size()) - 1, wd.hist_cong_cost);
+                                  int(wd.bound_nets.size()) - 1, wire_hist_cost.at(cursor_fwd));
                 }
             }
             NPNR_ASSERT(cursor_fwd == dst_wire_idx);
@@ -767,19 +1679,25 @@ struct Router2
             reset_wires(t);
             return ARC_SUCCESS;
         }
+        if (backwards_limit > 0 && backwards_iter >= backwards_limit)
+            ++t.counters.backwards_limit_hits;
 
         // Normal forwards A* routing
         reset_wires(t);
-        WireScore base_score;
-        base_score.cost = 0;
-        base_score.delay = ctx->getWireDelay(src_wire).maxDelay();
-        base_score.togo_cost = get_togo_cost(net, i, src_wire_idx, dst_wire);
+        WireScore base_score{};
+        DelayInfo src_delay = ctx->getWireDelay(src_wire);
+        base_score.delay = src_delay.maxDelay();
+        base_score.min_delay = src_delay.minDelay();
+        set_score_togo(base_score, get_togo_cost(net, i, src_wire_idx, dst_wire));
 
         // Add source wire to queue
-        t.queue.push(QueuedWire(src_wire_idx, PipId(), Loc(), base_score));
+        t.queue.push(QueuedWire(src_wire_idx, base_score, queue_key(base_score, 0)));
         set_visited(t, src_wire_idx, PipId(), base_score);
+        if (t.tree_mode)
+            seed_from_tree(t, net, i, dst_wire);
 
-        int toexplore = 250000 * std::max(1, (ad.bb.x1 - ad.bb.x0) + (ad.bb.y1 - ad.bb.y0));
+        int default_explore = 250000 * std::max(1, (ad.bb.x1 - ad.bb.x0) + (ad.bb.y1 - ad.bb.y0));
+        int toexplore = (cfg.adaptive_search && ad.explore_budget > 0) ? ad.explore_budget : default_explore;
         int iter = 0;
         int explored = 1;
         bool debug_arc = /*usr.cell->type.str(ctx).find("RAMB") != std::string::npos && (usr.port ==
@@ -797,9 +1715,8 @@ struct Router2
         // heuristic is incorrect.
         bool must_drain_queue = !is_bb;
         while (!t.queue.empty() && (must_drain_queue || iter < toexplore)) {
-            auto curr = t.queue.top();
+            auto curr = t.queue.pop();
             auto &d = flat_wires.at(curr.wire);
-            t.queue.pop();
             ++iter;
 #if 0
             ROUTE_LOG_DBG("current wire %s\n", ctx->nameOfWire(curr.wire));
@@ -822,8 +1739,10 @@ struct Router2
 #endif
                 // Evaluate score of next wire
                 WireId next = ctx->getPipDstWire(dh);
-                int next_idx = wire_to_idx.at(next);
-                if (was_visited(next_idx))
+                int next_idx = wire_to_idx(next);
+                if (next_idx < 0 || was_visited(t, next_idx))
+                    continue; // pruned or already visited
+                if (other_site(next_idx))
                     continue;
 #if 1
                 if (debug_arc)
@@ -838,20 +1757,26 @@ struct Router2
                     continue;
                 if (!thread_test_wire(t, nwd))
                     continue; // thread safety issue
+                DelayInfo pip_delay = ctx->getPipDelay(dh), wire_delay = ctx->getWireDelay(next);
                 WireScore next_score;
-                next_score.cost = curr.score.cost + score_wire_for_arc(net, i, next, dh);
-                next_score.delay =
-                        curr.score.delay + ctx->getPipDelay(dh).maxDelay() + ctx->getWireDelay(next).maxDelay();
-                next_score.togo_cost = cfg.estimate_weight * get_togo_cost(net, i, next_idx, dst_wire);
-                const auto &v = nwd.visit;
-                if (!v.visited || (v.score.total() > next_score.total())) {
+                set_score_cost(next_score, curr.score, score_wire_for_arc(net, i, next, dh));
+                next_score.delay = curr.score.delay + pip_delay.maxDelay() + wire_delay.maxDelay();
+                next_score.min_delay = curr.score.min_delay + pip_delay.minDelay() + wire_delay.minDelay();
+                // Only accept the sink through a route slow enough to meet the hold repair target; the search
+                // carries on through other wires into the sink instead
+                if (next == dst_wire && next_score.min_delay < ad.min_delay_target)
+                    continue;
+                set_score_togo(next_score, cfg.estimate_weight * get_togo_cost(net, i, next_idx, dst_wire));
+                const auto &v = wire_visit.at(next_idx);
+                if (v.epoch != t.epoch || (score_total(v.score) > score_total(next_score))) {
                     ++explored;
 #if 0
                     ROUTE_LOG_DBG("exploring wire %s cost %f togo %f\n", ctx->nameOfWire(next), next_score.cost,
                                   next_score.togo_cost);
 #endif
                     // Add wire to queue if it meets criteria
-                    t.queue.push(QueuedWire(next_idx, dh, ctx->getPipLocation(dh), next_score, t.rng.rng()));
+                    t.queue.push(QueuedWire(next_idx, next_score, queue_key(next_score, t.rng.rng())));
+                    ++t.counters.heap_pushes;
                     set_visited(t, next_idx, dh, next_score);
                     if (next == dst_wire) {
                         toexplore = std::min(toexplore, iter + 5);
@@ -860,37 +1785,91 @@ struct Router2
                 }
             }
         }
-        if (was_visited(dst_wire_idx)) {
+        t.counters.nodes_expanded += iter;
+        if (was_visited(t, dst_wire_idx)) {
             ROUTE_LOG_DBG("   Routed (explored %d wires): ", explored);
+            if (cfg.adaptive_search) {
+                // Leave room for searches several times larger as congestion builds up
+                ad.explore_budget = std::max(20000, 4 * iter);
+                ad.used_bb = ArcBounds(std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), -1, -1);
+            }
             int cursor_bwd = dst_wire_idx;
-            while (was_visited(cursor_bwd)) {
-                auto &v = flat_wires.at(cursor_bwd).visit;
-                bind_pip_internal(net, i, cursor_bwd, v.pip);
+            while (true) {
+                if (cfg.adaptive_search) {
+                    auto &wd = flat_wires.at(cursor_bwd);
+                    ad.used_bb.x0 = std::min(ad.used_bb.x0, int(wd.x));
+                    ad.used_bb.y0 = std::min(ad.used_bb.y0, int(wd.y));
+                    ad.used_bb.x1 = std::max(ad.used_bb.x1, int(wd.x));
+                    ad.used_bb.y1 = std::max(ad.used_bb.y1, int(wd.y));
+                }
+                // In shared tree mode the route can join the tree at a seed, above which the tree is followed
+                PipId pip;
+                if (was_visited(t, cursor_bwd))
+                    pip = wire_visit.at(cursor_bwd).pip;
+                else if (t.tree_mode && t.tree_set.count(cursor_bwd))
+                    pip = flat_wires.at(cursor_bwd).bound_nets.at(net->udata).second;
+                else
+                    break;
+                bind_pip_internal(net, i, cursor_bwd, pip);
                 if (ctx->debug) {
                     auto &wd = flat_wires.at(cursor_bwd);
                     ROUTE_LOG_DBG("      wire: %s (curr %d hist %f share %d)\n", ctx->nameOfWire(wd.w),
-                                  int(wd.bound_nets.size()) - 1, wd.hist_cong_cost,
+                                  int(wd.bound_nets.size()) - 1, wire_hist_cost.at(cursor_bwd),
                                   wd.bound_nets.count(net->udata) ? wd.bound_nets.at(net->udata).first : 0);
                 }
-                if (v.pip == PipId()) {
+                if (pip == PipId()) {
                     NPNR_ASSERT(cursor_bwd == src_wire_idx);
                     break;
                 }
-                ROUTE_LOG_DBG("         pip: %s (%d, %d)\n", ctx->nameOfPip(v.pip), ctx->getPipLocation(v.pip).x,
-                              ctx->getPipLocation(v.pip).y);
-                cursor_bwd = wire_to_idx.at(ctx->getPipSrcWire(v.pip));
+                ROUTE_LOG_DBG("         pip: %s (%d, %d)\n", ctx->nameOfPip(pip), ctx->getPipLocation(pip).x,
+                              ctx->getPipLocation(pip).y);
+                cursor_bwd = wire_to_idx(ctx->getPipSrcWire(pip));
             }
             t.processed_sinks.insert(dst_wire);
             ad.routed = true;
             reset_wires(t);
             return ARC_SUCCESS;
         } else {
+            // Wires left to explore mean the search was cut short rather than there being no route
+            if (!t.queue.empty()) {
+                ++t.counters.explore_limit_hits;
+                if (cfg.adaptive_search)
+                    ad.explore_budget = int(std::min<int64_t>(int64_t(toexplore) * 2, int64_t(default_explore) * 8));
+            }
             reset_wires(t);
+            if (ad.min_delay_target > 0) {
+                // Give up on the hold repair of this arc rather than fail to route it
+                ++t.counters.hold_fallbacks;
+                ad.min_delay_target = 0;
+                return route_arc(t, net, i, is_mt, is_bb, is_site);
+            }
+            if (cfg.site_abstraction && is_site) {
+                // The route may pass through another site, such as the ILOGIC/IDELAY bypass of an input on xc7. Only
+                // sites that the design uses are in the routing graph, so this can't find a route through an empty one
+                ++t.counters.site_fallbacks;
+                ROUTE_LOG_DBG("Rerouting arc %d of net '%s' through other sites\n", int(i), ctx->nameOf(net));
+                return route_arc(t, net, i, is_mt, is_bb, false);
+            }
             return ARC_RETRY_WITHOUT_BB;
         }
     }
 #undef ARC_ERR
 
+    // Iteration of the main loop that is being routed
+    int route_iter = 0;
+
+    // Seed for routing a net in deterministic mode, depending only on its name and the iteration; FNV-1a rather
+    // than std::hash, so that it is the same with every standard library
+    uint64_t net_seed(const NetInfo *net)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (char c : std::string(net->name.c_str(ctx))) {
+            h ^= uint8_t(c);
+            h *= 0x100000001b3ULL;
+        }
+        return (h ^ (uint64_t(route_iter) * 0x9e3779b97f4a7c15ULL)) | 1;
+    }
+
     bool route_net(ThreadContext &t, NetInfo *net, bool is_mt)
     {
 
@@ -900,6 +1879,9 @@ struct Router2
 #endif
 
         ROUTE_LOG_DBG("Routing net '%s'...\n", ctx->nameOf(net));
+        NPNR_TRACE_SCOPE_ARG("net", "net", ctx->nameOf(net));
+        if (cfg.deterministic)
+            t.rng.rngseed(net_seed(net));
 
         auto rstart = std::chrono::high_resolution_clock::now();
 
@@ -924,11 +1906,40 @@ struct Router2
             ripup_arc(net, i);
             t.route_arcs.push_back(i);
         }
+        t.counters.kept_arcs += int64_t(net->users.size() - t.route_arcs.size());
+        t.counters.rerouted_arcs += int64_t(t.route_arcs.size());
+        t.tree_mode = cfg.tree_fanout > 0 && int(net->users.size()) >= cfg.tree_fanout;
+        // Only some arcs of a large net touched overused wires: route them from the rest of the net's routing,
+        // which is legal, rather than finding each one a path from the source again
+        t.tree_reuse = !t.tree_mode && cfg.reuse_fanout > 0 && int(net->users.size()) >= cfg.reuse_fanout &&
+                       !t.route_arcs.empty() && t.route_arcs.size() < net->users.size();
+        t.tree_mode |= t.tree_reuse;
+        if (t.tree_mode) {
+            // Grow a single tree from the source, routing the nearest sinks first
+            auto &nd = nets.at(net->udata);
+            int src_idx = wire_to_idx(nd.src_wire);
+            t.tree_wires.clear();
+            t.tree_set.clear();
+            t.tree_wires.push_back(src_idx);
+            t.tree_set.insert(src_idx);
+            for (size_t i = 0; i < net->users.size(); i++)
+                add_arc_to_tree(t, net, i);
+            auto &swd = flat_wires.at(src_idx);
+            auto sink_dist = [&](int i) {
+                auto &dwd = flat_wires.at(wire_to_idx(nd.arcs.at(i).sink_wire));
+                return std::abs(dwd.x - swd.x) + std::abs(dwd.y - swd.y);
+            };
+            std::stable_sort(t.route_arcs.begin(), t.route_arcs.end(),
+                             [&](int a, int b) { return sink_dist(a) < sink_dist(b); });
+        }
         for (auto i : t.route_arcs) {
             auto res1 = route_arc(t, net, i, is_mt, true);
+            if (res1 == ARC_SUCCESS && t.tree_mode)
+                add_arc_to_tree(t, net, i);
             if (res1 == ARC_FATAL)
                 return false; // Arc failed irrecoverably
             else if (res1 == ARC_RETRY_WITHOUT_BB) {
+                ++t.counters.bb_failures;
                 if (is_mt) {
                     // Can't break out of bounding box in multi-threaded mode, so mark this arc as a failure
                     have_failures = true;
@@ -937,19 +1948,30 @@ struct Router2
                     ROUTE_LOG_DBG("Rerouting arc %d of net '%s' without bounding box, possible tricky routing...\n",
                                   int(i), ctx->nameOf(net));
                     auto res2 = route_arc(t, net, i, is_mt, false);
+                    if (res2 == ARC_SUCCESS && t.tree_mode)
+                        add_arc_to_tree(t, net, i);
                     // If this also fails, no choice but to give up
                     if (res2 != ARC_SUCCESS)
-                        log_error("Failed to route arc %d of net '%s', from %s to %s.\n", int(i), ctx->nameOf(net),
+                        log_error("Failed to route arc %d of net '%s', from %s to %s.%s\n", int(i), ctx->nameOf(net),
                                   ctx->nameOfWire(ctx->getNetinfoSourceWire(net)),
-                                  ctx->nameOfWire(ctx->getNetinfoSinkWire(net, net->users.at(i))));
+                                  ctx->nameOfWire(ctx->getNetinfoSinkWire(net, net->users.at(i))),
+                                  cfg.site_abstraction ? " If the arc passes through a site that the design doesn't "
+                                                         "use, try without router2/siteAbstraction."
+                                                       : "");
                 }
             }
         }
-        if (cfg.perf_profile) {
+        {
             auto rend = std::chrono::high_resolution_clock::now();
-            nets.at(net->udata).total_route_us +=
-                    (std::chrono::duration_cast<std::chrono::microseconds>(rend - rstart).count());
+            int route_us = int(std::chrono::duration_cast<std::chrono::microseconds>(rend - rstart).count());
+            nets.at(net->udata).last_route_us = route_us;
+            if (cfg.perf_profile)
+                nets.at(net->udata).total_route_us += route_us;
         }
+        if (have_failures)
+            ++t.counters.failed_nets;
+        else
+            ++t.counters.routed_nets;
         return !have_failures;
     }
 #undef ROUTE_LOG_DBG
@@ -960,26 +1982,72 @@ struct Router2
     std::vector<int> route_queue;
     std::set<int> failed_nets;
 
-    void update_congestion()
+    // By udata, the nets of cfg.only_nets; empty if every net is routed
+    std::vector<bool> selected_nets;
+    bool is_selected(const NetInfo *net) const { return selected_nets.empty() || selected_nets.at(net->udata); }
+
+    // Number of (wire, net) bindings, kept up to date by bind_pip_internal and unbind_pip_internal
+    std::atomic<int> wire_use_count{0};
+    // Every wire that has had more than one net bound since update_congestion last found it not overused, so that
+    // update_congestion scales with routing activity rather than with the size of the device
+    std::vector<int> overused_list;
+    std::mutex overused_mutex;
+
+    // Recount the overused wires and the nets using them, dropping the wires that are no longer overused from
+    // overused_list
+    void count_overuse()
     {
         total_overuse = 0;
         overused_wires = 0;
-        total_wire_use = 0;
+        total_wire_use = wire_use_count.load();
         failed_nets.clear();
-        for (auto &wire : flat_wires) {
-            total_wire_use += int(wire.bound_nets.size());
+        size_t kept = 0;
+        for (int i : overused_list) {
+            auto &wire = flat_wires[i];
             int overuse = int(wire.bound_nets.size()) - 1;
-            if (overuse > 0) {
-                wire.hist_cong_cost += overuse * hist_cong_weight;
-                total_overuse += overuse;
-                overused_wires += 1;
-                for (auto &bound : wire.bound_nets)
-                    failed_nets.insert(bound.first);
+            if (overuse <= 0) {
+                wire.overuse_listed = false;
+                continue;
             }
+            overused_list[kept++] = i;
+            total_overuse += overuse;
+            overused_wires += 1;
+            for (auto &bound : wire.bound_nets)
+                failed_nets.insert(bound.first);
         }
+        overused_list.resize(kept);
+    }
+
+    // count_overuse, then charge the overused wires to their history cost and grow the boxes of the failed nets;
+    // once per iteration
+    void update_congestion()
+    {
+        count_overuse();
+        for (int i : overused_list)
+            wire_hist_cost[i] += (int(flat_wires[i].bound_nets.size()) - 1) * hist_cong_weight;
         for (int n : failed_nets) {
             auto &net_data = nets.at(n);
             ++net_data.fail_count;
+            if (cfg.adaptive_search) {
+                // Grow the box by one tile on each side that the routing of an arc is up against
+                bool grow_x0 = false, grow_y0 = false, grow_x1 = false, grow_y1 = false;
+                for (auto &ad : net_data.arcs) {
+                    if (ad.used_bb.x1 < 0)
+                        continue;
+                    grow_x0 |= ad.used_bb.x0 <= net_data.bb.x0;
+                    grow_y0 |= ad.used_bb.y0 <= net_data.bb.y0;
+                    grow_x1 |= ad.used_bb.x1 >= net_data.bb.x1;
+                    grow_y1 |= ad.used_bb.y1 >= net_data.bb.y1;
+                }
+                if (grow_x0)
+                    net_data.bb.x0 = std::max(net_data.bb.x0 - 1, 0);
+                if (grow_y0)
+                    net_data.bb.y0 = std::max(net_data.bb.y0 - 1, 0);
+                if (grow_x1)
+                    net_data.bb.x1 = std::min(net_data.bb.x1 + 1, ctx->getGridDimX());
+                if (grow_y1)
+                    net_data.bb.y1 = std::min(net_data.bb.y1 + 1, ctx->getGridDimY());
+            }
             if ((net_data.fail_count % 10) == 0) {
                 // Every ten times a net fails to route, expand the bounding box to increase the search space
                 net_data.bb.x0 = std::max(net_data.bb.x0 - 1, 0);
@@ -990,6 +2058,90 @@ struct Router2
         }
     }
 
+    // With cfg.rollback_iters, the routing of the iteration with the lowest overuse so far: per net its route tree,
+    // as the flat indices of its wires in order with the pip driving each, and which of its arcs were routed
+    struct NetSnapshot
+    {
+        std::vector<std::pair<int, PipId>> tree;
+        std::vector<bool> routed;
+    };
+    std::vector<NetSnapshot> best_routing;
+    // Nets that may have been rerouted since best_routing was taken, only these are saved or restored again
+    std::vector<char> changed_since_best;
+    int best_overuse = -1, best_iter = 0;
+
+    void save_best_routing()
+    {
+        best_routing.resize(nets.size());
+        parallel_for(nets.size(), 64, [&](size_t n) {
+            if (!changed_since_best.at(n))
+                return;
+            auto &nd = nets.at(n);
+            auto &snap = best_routing.at(n);
+            snap.tree.clear();
+            snap.routed.assign(nd.arcs.size(), false);
+            for (size_t i = 0; i < nd.arcs.size(); i++) {
+                auto &ad = nd.arcs.at(i);
+                if (!ad.routed)
+                    continue;
+                snap.routed.at(i) = true;
+                WireId cursor = ad.sink_wire;
+                while (true) {
+                    PipId pip = wire_data(cursor).bound_nets.at(n).second;
+                    snap.tree.emplace_back(wire_to_idx(cursor), pip);
+                    if (cursor == nd.src_wire)
+                        break;
+                    cursor = ctx->getPipSrcWire(pip);
+                }
+            }
+            auto by_wire = [](const std::pair<int, PipId> &a, const std::pair<int, PipId> &b) {
+                return a.first < b.first;
+            };
+            std::sort(snap.tree.begin(), snap.tree.end(), by_wire);
+            snap.tree.erase(std::unique(snap.tree.begin(), snap.tree.end(),
+                                        [](const std::pair<int, PipId> &a, const std::pair<int, PipId> &b) {
+                                            return a.first == b.first;
+                                        }),
+                            snap.tree.end());
+            snap.tree.shrink_to_fit();
+        });
+        std::fill(changed_since_best.begin(), changed_since_best.end(), 0);
+    }
+
+    // Replace the routing of every net changed since save_best_routing by the saved one. The congestion totals and
+    // failed_nets are left to count_overuse
+    void restore_best_routing()
+    {
+        for (size_t n = 0; n < nets.size(); n++) {
+            if (!changed_since_best.at(n))
+                continue;
+            NetInfo *net = nets_by_udata.at(n);
+            auto &nd = nets.at(n);
+            auto &snap = best_routing.at(n);
+            for (size_t i = 0; i < nd.arcs.size(); i++)
+                ripup_arc(net, i);
+            for (size_t i = 0; i < nd.arcs.size(); i++) {
+                if (!snap.routed.at(i))
+                    continue;
+                int cursor = wire_to_idx(nd.arcs.at(i).sink_wire);
+                while (true) {
+                    auto found = std::lower_bound(
+                            snap.tree.begin(), snap.tree.end(), cursor,
+                            [](const std::pair<int, PipId> &entry, int wire) { return entry.first < wire; });
+                    NPNR_ASSERT(found != snap.tree.end() && found->first == cursor);
+                    bind_pip_internal(net, i, cursor, found->second);
+                    if (found->second == PipId())
+                        break;
+                    cursor = wire_to_idx(ctx->getPipSrcWire(found->second));
+                }
+                nd.arcs.at(i).routed = true;
+            }
+            if (timing_driven)
+                tmg.mark_dirty(net);
+        }
+        std::fill(changed_since_best.begin(), changed_since_best.end(), 0);
+    }
+
     bool bind_and_check(NetInfo *net, int usr_idx)
     {
 #ifdef ARCH_ECP5
@@ -1066,16 +2218,127 @@ struct Router2
         return success;
     }
 
+    // The Arch API binds planned for one net by bind_and_check_all. Each arc either binds nothing, only the source
+    // wire, its route (pips[pip_begin, pip_end) from sink towards the source) or is an arch failure.
+    struct NetBindPlan
+    {
+        enum ArcAction : uint8_t
+        {
+            ARC_SKIP,
+            ARC_BIND_SRC,
+            ARC_BIND_ROUTE,
+            ARC_FAIL
+        };
+        struct ArcPlan
+        {
+            ArcAction action = ARC_SKIP;
+            int pip_begin = 0, pip_end = 0;
+        };
+        std::vector<ArcPlan> arcs;
+        std::vector<PipId> pips;
+        // Flat indices of the wires that the plan binds
+        std::vector<int> claimed;
+        // The plan can't be committed as is, the net is bound by bind_and_check instead
+        bool fallback = false;
+    };
+
+    // Read-only version of bind_and_check for every arc of a net, assuming that all routes ripped up by
+    // bind_and_check_all are unbound. Wires bound by earlier arcs of the same net are tracked in local. Anything out
+    // of the ordinary sets plan.fallback, so that it's handled (and reported) by the serial code.
+    void plan_net_binds(NetInfo *net, NetBindPlan &plan, std::unordered_set<WireId> &local)
+    {
+        local.clear();
+        plan.arcs.assign(net->users.size(), NetBindPlan::ArcPlan());
+        plan.pips.clear();
+        plan.claimed.clear();
+        plan.fallback = false;
+        auto &nd = nets.at(net->udata);
+        WireId src = ctx->getNetinfoSourceWire(net);
+        if (src == WireId())
+            return;
+        auto is_bound_here = [&](WireId w) { return local.count(w) || ctx->getBoundWireNet(w) == net; };
+        auto claim = [&](WireId w) {
+            int idx = wire_to_idx(w);
+            if (idx < 0)
+                plan.fallback = true;
+            local.insert(w);
+            plan.claimed.push_back(idx);
+        };
+        for (size_t i = 0; i < net->users.size(); i++) {
+            auto &ap = plan.arcs.at(i);
+            WireId dst = ctx->getNetinfoSinkWire(net, net->users.at(i));
+            if (dst == WireId() || is_bound_here(dst))
+                continue;
+            if (dst == src) {
+                NetInfo *bound = ctx->getBoundWireNet(src);
+                if (bound != nullptr && bound != net) {
+                    plan.fallback = true;
+                    return;
+                }
+                if (bound == nullptr) {
+                    ap.action = NetBindPlan::ARC_BIND_SRC;
+                    claim(src);
+                }
+                continue;
+            }
+            if (!nd.arcs.at(i).routed)
+                continue;
+            ap.pip_begin = int(plan.pips.size());
+            bool success = true;
+            WireId cursor = dst;
+            while (cursor != src) {
+                if (is_bound_here(cursor))
+                    break;
+                if (!ctx->checkWireAvail(cursor)) {
+                    success = false;
+                    break;
+                }
+                int idx = wire_to_idx(cursor);
+                if (idx < 0 || !flat_wires.at(idx).bound_nets.count(net->udata)) {
+                    // Incomplete route tree, reported by bind_and_check
+                    plan.fallback = true;
+                    return;
+                }
+                PipId p = flat_wires.at(idx).bound_nets.at(net->udata).second;
+                if (!ctx->checkPipAvail(p)) {
+                    success = false;
+                    break;
+                }
+                plan.pips.push_back(p);
+                cursor = ctx->getPipSrcWire(p);
+            }
+            if (success) {
+                ap.action = NetBindPlan::ARC_BIND_ROUTE;
+                ap.pip_end = int(plan.pips.size());
+                if (!is_bound_here(src))
+                    claim(src);
+                for (int j = ap.pip_begin; j < ap.pip_end; j++)
+                    claim(ctx->getPipDstWire(plan.pips.at(j)));
+            } else {
+                ap.action = NetBindPlan::ARC_FAIL;
+                plan.pips.resize(ap.pip_begin);
+            }
+        }
+    }
+
     int arch_fail = 0;
+    // Bind all the routes through the Arch API. All ripped up routes are unbound first, then the binds of every net
+    // are planned and checked in parallel. Wires claimed by more than one plan are given to the net that comes first
+    // in udata order, and the nets that lose any wire are bound serially by bind_and_check instead, after all earlier
+    // nets. So the result is the same as binding the nets one after another, whatever the thread count.
     bool bind_and_check_all()
     {
+        NPNR_TRACE_SCOPE("bind and check");
         bool success = true;
         std::vector<WireId> net_wires;
+        std::vector<NetInfo *> bind_nets;
         for (auto net : nets_by_udata) {
 #ifdef ARCH_ECP5
             if (net->is_global)
                 continue;
 #endif
+            if (!is_selected(net))
+                continue;
             // Ripup wires and pips used by the net in nextpnr's structures
             net_wires.clear();
             for (auto &w : net->wires) {
@@ -1084,17 +2347,159 @@ struct Router2
             }
             for (auto w : net_wires)
                 ctx->unbindWire(w);
-            // Bind the arcs using the routes we have discovered
-            for (size_t i = 0; i < net->users.size(); i++) {
-                if (!bind_and_check(net, i)) {
+            bind_nets.push_back(net);
+        }
+
+        std::vector<NetBindPlan> plans(bind_nets.size());
+        // Lowest index into bind_nets of a net claiming each wire
+        std::vector<std::atomic<int>> wire_owner(flat_wires.size());
+        for (auto &o : wire_owner)
+            o.store(std::numeric_limits<int>::max(), std::memory_order_relaxed);
+        auto run_parallel = [&](const std::function<void(size_t)> &func) { parallel_for(bind_nets.size(), 256, func); };
+        run_parallel([&](size_t i) {
+            static thread_local std::unordered_set<WireId> local;
+            auto &plan = plans.at(i);
+            plan_net_binds(bind_nets.at(i), plan, local);
+            // Fallback nets claim their wires too, as their serial binds are a subset of them
+            for (int idx : plan.claimed) {
+                if (idx < 0)
+                    continue;
+                auto &owner = wire_owner.at(idx);
+                int curr = owner.load(std::memory_order_relaxed);
+                while (int(i) < curr && !owner.compare_exchange_weak(curr, int(i), std::memory_order_relaxed))
+                    ;
+            }
+        });
+        run_parallel([&](size_t i) {
+            auto &plan = plans.at(i);
+            for (int idx : plan.claimed)
+                if (idx >= 0 && wire_owner.at(idx).load(std::memory_order_relaxed) != int(i)) {
+                    plan.fallback = true;
+                    break;
+                }
+        });
+
+        // Commit in a deterministic order
+        int fallback_nets = 0;
+        for (size_t n = 0; n < bind_nets.size(); n++) {
+            NetInfo *net = bind_nets.at(n);
+            auto &plan = plans.at(n);
+            if (plan.fallback) {
+                ++fallback_nets;
+                for (size_t i = 0; i < net->users.size(); i++) {
+                    if (!bind_and_check(net, i)) {
+                        ++arch_fail;
+                        success = false;
+                    }
+                }
+                continue;
+            }
+            WireId src = ctx->getNetinfoSourceWire(net);
+            for (size_t i = 0; i < plan.arcs.size(); i++) {
+                auto &ap = plan.arcs.at(i);
+                switch (ap.action) {
+                case NetBindPlan::ARC_SKIP:
+                    break;
+                case NetBindPlan::ARC_BIND_SRC:
+                    ctx->bindWire(src, net, STRENGTH_WEAK);
+                    break;
+                case NetBindPlan::ARC_BIND_ROUTE:
+                    if (ctx->getBoundWireNet(src) == nullptr)
+                        ctx->bindWire(src, net, STRENGTH_WEAK);
+                    for (int j = ap.pip_begin; j < ap.pip_end; j++)
+                        ctx->bindPip(plan.pips.at(j), net, STRENGTH_WEAK);
+                    break;
+                case NetBindPlan::ARC_FAIL:
+                    ripup_arc(net, i);
+                    failed_nets.insert(net->udata);
                     ++arch_fail;
                     success = false;
+                    break;
                 }
             }
         }
+        if (ctx->verbose && fallback_nets > 0)
+            log_info("    %d nets bound serially after conflicting plans\n", fallback_nets);
         return success;
     }
 
+    // Check that the nextpnr-level routing of a net is a legal tree from the source to every sink, that it is only
+    // bound to this net and that each pip is usable. Wires not leading to a sink are returned in stubs. Only reads
+    // state, so can be run for many nets in parallel.
+    bool check_net_legal(NetInfo *net, std::unordered_set<WireId> &used, std::vector<WireId> &stubs)
+    {
+#ifdef ARCH_ECP5
+        if (net->is_global)
+            return true;
+#endif
+        if (net->driver.cell == nullptr)
+            return true;
+        WireId src_wire = ctx->getNetinfoSourceWire(net);
+        if (src_wire == WireId())
+            return false;
+        if (!net->users.empty() && !net->wires.count(src_wire))
+            return false;
+        for (auto &w : net->wires) {
+            if (ctx->getBoundWireNet(w.first) != net)
+                return false;
+            PipId pip = w.second.pip;
+            if (pip == PipId())
+                continue;
+            if (ctx->getPipDstWire(pip) != w.first || ctx->getBoundPipNet(pip) != net ||
+                ctx->getConflictingPipNet(pip) != net || !net->wires.count(ctx->getPipSrcWire(pip)))
+                return false;
+        }
+        used.clear();
+        used.insert(src_wire);
+        for (auto &usr : net->users) {
+            WireId cursor = ctx->getNetinfoSinkWire(net, usr);
+            if (cursor == WireId())
+                return false;
+            // Walk back towards the source, stopping at wires whose path has already been checked
+            size_t steps = 0;
+            while (used.insert(cursor).second) {
+                auto fnd = net->wires.find(cursor);
+                if (fnd == net->wires.end() || fnd->second.pip == PipId() || ++steps > net->wires.size())
+                    return false;
+                cursor = ctx->getPipSrcWire(fnd->second.pip);
+            }
+        }
+        for (auto &w : net->wires)
+            if (w.second.strength < STRENGTH_LOCKED && !used.count(w.first))
+                stubs.push_back(w.first);
+        return true;
+    }
+
+    // Verify the final routing of every net in parallel, removing stubs. Returns the nets that need rerouting.
+    std::vector<NetInfo *> verify_routing()
+    {
+        std::vector<NetInfo *> all_nets;
+        for (auto &net : ctx->nets)
+            all_nets.push_back(net.second.get());
+        std::vector<char> legal(all_nets.size(), 0);
+        std::vector<std::vector<WireId>> stubs(all_nets.size());
+        parallel_for(all_nets.size(), 256, [&](size_t i) {
+            static thread_local std::unordered_set<WireId> used;
+            legal.at(i) = check_net_legal(all_nets.at(i), used, stubs.at(i));
+        });
+
+        std::vector<NetInfo *> failed;
+        int stub_count = 0;
+        for (size_t i = 0; i < all_nets.size(); i++) {
+            if (!legal.at(i)) {
+                failed.push_back(all_nets.at(i));
+                continue;
+            }
+            for (WireId w : stubs.at(i))
+                if (all_nets.at(i)->wires.count(w))
+                    ctx->unbindWire(w);
+            stub_count += int(stubs.at(i).size());
+        }
+        if (stub_count > 0)
+            log_info("    removed %d unused wires\n", stub_count);
+        return failed;
+    }
+
     void write_heatmap(std::ostream &out, bool congestion = false)
     {
         std::vector<std::vector<int>> hm_xy;
@@ -1132,55 +2537,214 @@ struct Router2
             out << std::endl;
         }
     }
-    int mid_x = 0, mid_y = 0;
+    // A group of nets routed together by one thread. Tasks that may run concurrently always have
+    // disjoint bounding boxes, so they never touch the same wires
+    struct RouteTask
+    {
+        ArcBounds bb;
+        std::vector<int> nets;
+        // Tasks that can only start once this one has finished
+        std::vector<int> dependents;
+        int pending = 0;
+        // NUMA node index of the stripe containing the centre of bb
+        int node = 0;
+    };
+
+    std::vector<RouteTask> route_tasks;
+
+    int add_route_task(const ArcBounds &bb, std::vector<int> &&task_nets)
+    {
+        int idx = int(route_tasks.size());
+        route_tasks.emplace_back();
+        route_tasks.back().bb = bb;
+        route_tasks.back().nets = std::move(task_nets);
+        route_tasks.back().node = numa_stripe_node((bb.x0 + bb.x1) / 2);
+        return idx;
+    }
+
+    void add_task_dependency(int before, int after)
+    {
+        route_tasks.at(before).dependents.push_back(after);
+        ++route_tasks.at(after).pending;
+    }
+
+    // Estimated routing work of a net: the time its last routing took, or before it has been routed (and always in
+    // deterministic mode, as timings vary between runs) its arc count times its bounding box area
+    int64_t net_work(int n)
+    {
+        auto &nd = nets.at(n);
+        if (nd.last_route_us >= 0 && !cfg.deterministic)
+            return 1 + nd.last_route_us;
+        int64_t area = int64_t(nd.bb.x1 - nd.bb.x0 + 1) * int64_t(nd.bb.y1 - nd.bb.y0 + 1);
+        return std::max<int64_t>(1, int64_t(nd.arcs.size()) * area);
+    }
 
-    void partition_nets()
+    // Find the split point along one axis, such that the nets with their centre below it have about lo_parts / parts
+    // of the estimated routing work between them (the median of the work by default)
+    int split_centre(const std::vector<int> &region_nets, bool split_x, int lo_parts = 1, int parts = 2)
     {
-        // Create a histogram of positions in X and Y positions
-        std::map<int, int> cxs, cys;
-        for (auto &n : nets) {
-            if (n.cx != -1)
-                ++cxs[n.cx];
-            if (n.cy != -1)
-                ++cys[n.cy];
+        std::vector<std::pair<int, int64_t>> centres;
+        centres.reserve(region_nets.size());
+        int64_t total = 0;
+        for (int n : region_nets) {
+            auto &nd = nets.at(n);
+            int64_t work = net_work(n);
+            centres.emplace_back(split_x ? nd.cx : nd.cy, work);
+            total += work;
         }
-        // 4-way split for now
-        int accum_x = 0, accum_y = 0;
-        int halfway = int(nets.size()) / 2;
-        for (auto &p : cxs) {
-            if (accum_x < halfway && (accum_x + p.second) >= halfway)
-                mid_x = p.first;
-            accum_x += p.second;
+        std::sort(centres.begin(), centres.end());
+        int64_t acc = 0;
+        for (auto &c : centres) {
+            acc += c.second;
+            if (acc * parts >= total * lo_parts)
+                return c.first;
         }
-        for (auto &p : cys) {
-            if (accum_y < halfway && (accum_y + p.second) >= halfway)
-                mid_y = p.first;
-            accum_y += p.second;
+        return centres.back().first;
+    }
+
+    // Split nets into those entirely below the cut, entirely above it and those crossing it
+    void split_nets(const std::vector<int> &region_nets, bool split_x, int cut, std::vector<int> &lo,
+                    std::vector<int> &hi, std::vector<int> &crossing)
+    {
+        for (int n : region_nets) {
+            auto &nd = nets.at(n);
+            int b0 = split_x ? nd.bb.x0 : nd.bb.y0, b1 = split_x ? nd.bb.x1 : nd.bb.y1;
+            if (b1 <= cut)
+                lo.push_back(n);
+            else if (b0 > cut)
+                hi.push_back(n);
+            else
+                crossing.push_back(n);
         }
-        if (ctx->verbose) {
-            log_info("    x splitpoint: %d\n", mid_x);
-            log_info("    y splitpoint: %d\n", mid_y);
-        }
-        std::vector<int> bins(5, 0);
-        for (auto &n : nets) {
-            if (n.bb.x0 < mid_x && n.bb.x1 < mid_x && n.bb.y0 < mid_y && n.bb.y1 < mid_y)
-                ++bins[0]; // TL
-            else if (n.bb.x0 >= mid_x && n.bb.x1 >= mid_x && n.bb.y0 < mid_y && n.bb.y1 < mid_y)
-                ++bins[1]; // TR
-            else if (n.bb.x0 < mid_x && n.bb.x1 < mid_x && n.bb.y0 >= mid_y && n.bb.y1 >= mid_y)
-                ++bins[2]; // BL
-            else if (n.bb.x0 >= mid_x && n.bb.x1 >= mid_x && n.bb.y0 >= mid_y && n.bb.y1 >= mid_y)
-                ++bins[3]; // BR
+    }
+
+    std::pair<ArcBounds, ArcBounds> split_bounds(const ArcBounds &bb, bool split_x, int cut)
+    {
+        if (split_x)
+            return std::make_pair(ArcBounds(bb.x0, bb.y0, cut, bb.y1), ArcBounds(cut + 1, bb.y0, bb.x1, bb.y1));
+        else
+            return std::make_pair(ArcBounds(bb.x0, bb.y0, bb.x1, cut), ArcBounds(bb.x0, cut + 1, bb.x1, bb.y1));
+    }
+
+    // Recursively partition the nets within a region into the given number of leaf regions, returning the task that
+    // finishes routing it. At each level the region is cut along its longer axis into two parts that are routed
+    // concurrently, with the leaf regions shared out between them and the cut placed to give each part its share of
+    // the work. Nets crossing the cut are then cut again along the other axis, giving two more concurrent tasks once
+    // both parts are done, and only the nets crossing both cuts are left to a final task for the region.
+    int partition_region(const ArcBounds &bb, std::vector<int> &region_nets, int regions)
+    {
+        if (regions <= 1 || int(region_nets.size()) < cfg.partition_min_nets)
+            return add_route_task(bb, std::move(region_nets));
+        int w = std::min(bb.x1, ctx->getGridDimX()) - bb.x0, h = std::min(bb.y1, ctx->getGridDimY()) - bb.y0;
+        bool split_x = (w >= h);
+        int lo_regions = regions / 2;
+        int cut = split_centre(region_nets, split_x, lo_regions, regions);
+        std::vector<int> lo, hi, crossing;
+        split_nets(region_nets, split_x, cut, lo, hi, crossing);
+        if (lo.empty() || hi.empty())
+            return add_route_task(bb, std::move(region_nets));
+        auto halves = split_bounds(bb, split_x, cut);
+        int lo_task = partition_region(halves.first, lo, lo_regions);
+        int hi_task = partition_region(halves.second, hi, regions - lo_regions);
+        int done_task;
+        std::vector<int> cross_lo, cross_hi, cross_both;
+        if (!crossing.empty()) {
+            int cross_cut = split_centre(crossing, !split_x);
+            split_nets(crossing, !split_x, cross_cut, cross_lo, cross_hi, cross_both);
+            auto cross_halves = split_bounds(bb, !split_x, cross_cut);
+            int cross_lo_task = add_route_task(cross_halves.first, std::move(cross_lo));
+            int cross_hi_task = add_route_task(cross_halves.second, std::move(cross_hi));
+            done_task = add_route_task(bb, std::move(cross_both));
+            for (int t : {cross_lo_task, cross_hi_task}) {
+                add_task_dependency(lo_task, t);
+                add_task_dependency(hi_task, t);
+                add_task_dependency(t, done_task);
+            }
+        } else {
+            done_task = add_route_task(bb, std::move(crossing));
+            add_task_dependency(lo_task, done_task);
+            add_task_dependency(hi_task, done_task);
+        }
+        return done_task;
+    }
+
+#ifdef ARCH_XILINX
+    // On multi-die devices the nets within each SLR are partitioned and routed concurrently, and the nets crossing
+    // between SLRs are left to a final task, to be routed around what is already there
+    int partition_slrs(std::vector<int> &all_nets, int regions)
+    {
+        const auto &bounds = ctx->slr_boundaries;
+        int slrs = int(bounds.size()) + 1;
+        std::vector<std::vector<int>> slr_nets(slrs);
+        std::vector<int> crossing;
+        for (int n : all_nets) {
+            auto &nd = nets.at(n);
+            int slr = ctx->getSlr(nd.bb.y0);
+            if (slr == ctx->getSlr(nd.bb.y1))
+                slr_nets.at(slr).push_back(n);
             else
-                ++bins[4]; // cross-boundary
+                crossing.push_back(n);
         }
-        if (ctx->verbose)
-            for (int i = 0; i < 5; i++)
-                log_info("        bin %d N=%d\n", i, bins[i]);
+        int done_task = add_route_task(
+                ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max()), std::move(crossing));
+        for (int slr = 0; slr < slrs; slr++) {
+            ArcBounds bb(0, slr == 0 ? 0 : bounds.at(slr - 1), std::numeric_limits<int>::max(),
+                         slr + 1 < slrs ? bounds.at(slr) - 1 : std::numeric_limits<int>::max());
+            // The SLRs share out the leaf regions, as do the two parts of a region
+            int slr_regions = std::max(1, regions / slrs + (slr < regions % slrs ? 1 : 0));
+            add_task_dependency(partition_region(bb, slr_nets.at(slr), slr_regions), done_task);
+        }
+        return done_task;
+    }
+#endif
+
+    static const int deterministic_regions = 16;
+
+    // Build the task graph for the current route queue, returning the final top-level task
+    int partition_nets()
+    {
+        NPNR_TRACE_SCOPE("partition");
+        route_tasks.clear();
+        // Aim for at least two leaf regions per thread by default, to give work stealing something to balance. In
+        // deterministic mode the partitioning must not depend on the thread count, so a fixed count is used instead
+        int regions = cfg.partition_regions > 0 ? cfg.partition_regions
+                                                : (cfg.deterministic ? deterministic_regions : 2 * cfg.threads);
+        std::vector<int> all_nets(route_queue);
+        int root;
+#ifdef ARCH_XILINX
+        if (!ctx->slr_boundaries.empty())
+            root = partition_slrs(all_nets, regions);
+        else
+#endif
+            root = partition_region(
+                    ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max()), all_nets,
+                    regions);
+        if (ctx->verbose) {
+            int leaves = 0;
+            for (auto &task : route_tasks)
+                if (task.pending == 0)
+                    ++leaves;
+            log_info("    partitioned %d nets into %d tasks (%d leaf regions)\n", int(route_queue.size()),
+                     int(route_tasks.size()), leaves);
+        }
+        return root;
     }
 
+    // Ready queues for the routing thread pool. Each worker runs the tasks it unblocked itself
+    // most-recent first, and when it runs out steals the oldest ready task from another worker
+    struct TaskScheduler
+    {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<std::deque<int>> ready;
+        int queued = 0, remaining = 0;
+    };
+
     void router_thread(ThreadContext &t)
     {
+        NPNR_TRACE_SCOPE_ARG("bin", "bin",
+                             stringf("(%d, %d)-(%d, %d), %d nets", t.bb.x0, t.bb.y0, t.bb.x1, t.bb.y1,
+                                     int(t.route_nets.size())));
         for (auto n : t.route_nets) {
             bool result = route_net(t, n, true);
             if (!result)
@@ -1188,100 +2752,578 @@ struct Router2
         }
     }
 
-    void do_route()
+    void router_worker(int worker, TaskScheduler &sched, std::vector<ThreadContext> &tcs, int root)
+    {
+        NPNR_TRACE_SCOPE_ARG("router2 worker", "worker", std::to_string(worker));
+        LogThreadContext log_context(stringf("router2 worker %d", worker));
+        int N = int(sched.ready.size());
+        while (true) {
+            int task = -1;
+            {
+                std::unique_lock<std::mutex> lock(sched.mtx);
+                sched.cv.wait(lock, [&] { return sched.queued > 0 || sched.remaining == 0; });
+                if (sched.queued == 0)
+                    break;
+                auto &own = sched.ready.at(worker);
+                if (!own.empty()) {
+                    task = own.back();
+                    own.pop_back();
+                } else {
+                    // Steal a task of the stripe on this thread's NUMA node if there is one (all tasks are on
+                    // node 0 without cfg.numa), otherwise any
+                    int node = cfg.numa ? ctx->threadPool().current_node() : 0;
+                    int other = -1;
+                    for (int i = 1; i < N; i++) {
+                        auto &victim = sched.ready.at((worker + i) % N);
+                        if (victim.empty())
+                            continue;
+                        if (route_tasks.at(victim.front()).node == node) {
+                            task = victim.front();
+                            victim.pop_front();
+                            break;
+                        }
+                        if (other == -1)
+                            other = (worker + i) % N;
+                    }
+                    if (task == -1 && other != -1) {
+                        task = sched.ready.at(other).front();
+                        sched.ready.at(other).pop_front();
+                    }
+                }
+                NPNR_ASSERT(task != -1);
+                --sched.queued;
+            }
+            // The top-level task contains nets that may need to leave their bounding box,
+            // so it is routed singlethreaded once the pool has finished
+            if (task != root) {
+                router_thread(tcs.at(task));
+                worker_counters.at(worker).add(tcs.at(task).counters);
+            }
+            {
+                std::unique_lock<std::mutex> lock(sched.mtx);
+                for (int dep : route_tasks.at(task).dependents) {
+                    if (--route_tasks.at(dep).pending == 0) {
+                        sched.ready.at(worker).push_back(dep);
+                        ++sched.queued;
+                    }
+                }
+                --sched.remaining;
+            }
+            sched.cv.notify_all();
+        }
+    }
+
+    // Totals of the current iteration, and the part of them done by each worker thread in the multithreaded pass
+    RouteCounters iter_counters;
+    std::vector<RouteCounters> worker_counters;
+
+    void do_route(bool serial = false)
     {
         // Don't multithread if fewer than 200 nets (heuristic)
-        if (route_queue.size() < 200) {
+        // In deterministic mode a single thread still routes the partitioned tasks, as more threads would
+        if (serial || route_queue.size() < 200 || (cfg.threads <= 1 && !cfg.deterministic)) {
+            NPNR_TRACE_SCOPE("route serial");
             ThreadContext st;
             st.rng.rngseed(ctx->rng64());
             st.bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
             for (size_t j = 0; j < route_queue.size(); j++) {
                 route_net(st, nets_by_udata[route_queue[j]], false);
             }
+            iter_counters.add(st.counters);
             return;
         }
-        const int Nq = 4, Nv = 2, Nh = 2;
-        const int N = Nq + Nv + Nh;
-        std::vector<ThreadContext> tcs(N + 1);
-        for (auto &th : tcs) {
+        int root = partition_nets();
+        std::vector<ThreadContext> tcs(route_tasks.size());
+        for (size_t i = 0; i < route_tasks.size(); i++) {
+            auto &th = tcs.at(i);
             th.rng.rngseed(ctx->rng64());
+            th.bb = route_tasks.at(i).bb;
+            for (int n : route_tasks.at(i).nets)
+                th.route_nets.push_back(nets_by_udata.at(n));
         }
-        int le_x = mid_x;
-        int rs_x = mid_x;
-        int le_y = mid_y;
-        int rs_y = mid_y;
-        // Set up thread bounding boxes
-        tcs.at(0).bb = ArcBounds(0, 0, mid_x, mid_y);
-        tcs.at(1).bb = ArcBounds(mid_x + 1, 0, std::numeric_limits<int>::max(), le_y);
-        tcs.at(2).bb = ArcBounds(0, mid_y + 1, mid_x, std::numeric_limits<int>::max());
-        tcs.at(3).bb =
-                ArcBounds(mid_x + 1, mid_y + 1, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+        if (ctx->verbose)
+            log_info("%d/%d nets not multi-threadable\n", int(tcs.at(root).route_nets.size()),
+                     int(route_queue.size()));
+        // Multithreaded part of routing
+        TaskScheduler sched;
+        sched.ready.resize(cfg.threads);
+        worker_counters.assign(cfg.threads, RouteCounters());
+        sched.remaining = int(route_tasks.size());
+        int next_worker = 0;
+        for (size_t i = 0; i < route_tasks.size(); i++) {
+            if (route_tasks.at(i).pending == 0) {
+                sched.ready.at(next_worker).push_back(int(i));
+                ++sched.queued;
+                next_worker = (next_worker + 1) % cfg.threads;
+            }
+        }
+        // Workers steal each other's tasks, so all tasks are routed even while the pool is running fewer of them
+        ThreadPool::TaskGroup workers(ctx->threadPool());
+        for (int i = 1; i < cfg.threads; i++)
+            workers.run([this, &sched, &tcs, root, i]() { router_worker(i, sched, tcs, root); });
+        router_worker(0, sched, tcs, root);
+        workers.wait();
+        // Singlethreaded part of routing - nets that cross partitions
+        // at the top level or don't fit within bounding box
+        NPNR_TRACE_SCOPE("route crossing");
+        auto &st = tcs.at(root);
+        st.bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+        for (auto st_net : st.route_nets)
+            route_net(st, st_net, false);
+        // Failed nets
+        for (size_t i = 0; i < tcs.size(); i++)
+            for (auto fail : tcs.at(i).failed_nets)
+                route_net(st, fail, false);
+        for (auto &wc : worker_counters)
+            iter_counters.add(wc);
+        iter_counters.add(st.counters);
+    }
 
-        tcs.at(4).bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), mid_y);
-        tcs.at(5).bb = ArcBounds(0, mid_y + 1, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+    // Wavefront mode (router2/wavefront): before each iteration, a batch of short nets with bounding boxes that don't
+    // overlap is routed by a WavefrontBackend, and taken out of the route queue if all their arcs were routed
+    std::unique_ptr<WavefrontBackend> wavefront;
+    WavefrontGraph wf_graph;
+    // The wire of each vertex and the pip of each edge of wf_graph
+    std::vector<int> wf_vertex_wire;
+    std::vector<PipId> wf_edge_pip;
+    // The arcs of the batch to be routed, and the vertex of their sink wire (-1 if not in the graph)
+    struct WavefrontArc
+    {
+        int net;
+        int user;
+        int vertex;
+    };
+    std::vector<WavefrontArc> wf_arcs;
 
-        tcs.at(6).bb = ArcBounds(0, 0, mid_x, std::numeric_limits<int>::max());
-        tcs.at(7).bb = ArcBounds(mid_x + 1, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+    std::vector<int> select_wavefront_nets()
+    {
+        std::vector<int> batch;
+        int width = ctx->getGridDimX() + 1;
+        // Tiles covered by the bounding box of a net already in the batch
+        std::vector<bool> taken(size_t(width) * (ctx->getGridDimY() + 1), false);
+        for (int n : route_queue) {
+            NetInfo *net = nets_by_udata.at(n);
+            auto &nd = nets.at(n);
+            if (net->driver.cell == nullptr || net->users.empty() || int(net->users.size()) > cfg.wavefront_max_users)
+                continue;
+            if (nd.bb.x1 - nd.bb.x0 > cfg.wavefront_span || nd.bb.y1 - nd.bb.y0 > cfg.wavefront_span)
+                continue;
+#ifdef ARCH_XILINX
+            if (net->name == ctx->id("$PACKER_GND_NET") || net->name == ctx->id("$PACKER_VCC_NET"))
+                continue;
+#endif
+            if (net->is_global)
+                continue;
+            // Locked routing and hold repair are left to route_net
+            bool skip = std::any_of(nd.arcs.begin(), nd.arcs.end(),
+                                    [](const PerArcData &ad) { return ad.min_delay_target > 0; });
+            for (auto &w : net->wires)
+                skip |= (w.second.strength > STRENGTH_STRONG);
+            for (int y = nd.bb.y0; y <= nd.bb.y1 && !skip; y++)
+                for (int x = nd.bb.x0; x <= nd.bb.x1 && !skip; x++)
+                    skip = taken.at(size_t(y) * width + x);
+            if (skip)
+                continue;
+            for (int y = nd.bb.y0; y <= nd.bb.y1; y++)
+                for (int x = nd.bb.x0; x <= nd.bb.x1; x++)
+                    taken.at(size_t(y) * width + x) = true;
+            batch.push_back(n);
+        }
+        return batch;
+    }
 
-        tcs.at(8).bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+    // Add the routing graph of a net within its bounding box to wf_graph, with the same restrictions on wires and
+    // pips as the forward search of route_arc, and costs for its most critical arc. Returns false if it has more than
+    // router2/wavefrontMaxWires wires, in which case nothing is added.
+    bool add_wavefront_problem(NetInfo *net, size_t crit_user)
+    {
+        auto &nd = nets.at(net->udata);
+        int src_idx = wire_to_idx(nd.src_wire);
+        if (src_idx < 0)
+            return false;
+        struct Edge
+        {
+            int from, to;
+            PipId pip;
+            float cost;
+        };
+        std::vector<int> wires{src_idx};
+        std::vector<Edge> edges;
+        dict<int, int> local;
+        local[src_idx] = 0;
+        for (size_t i = 0; i < wires.size(); i++) {
+            for (auto dh : ctx->getPipsDownhill(flat_wires.at(wires.at(i)).w)) {
+                if (!hit_test_pip(nd.bb, ctx->getPipLocation(dh)))
+                    continue;
+                if (!ctx->checkPipAvail(dh) && ctx->getBoundPipNet(dh) != net)
+                    continue;
+                WireId next = ctx->getPipDstWire(dh);
+                int next_idx = wire_to_idx(next);
+                if (next_idx < 0 || next_idx == src_idx)
+                    continue;
+                auto &nwd = flat_wires.at(next_idx);
+                if (nwd.unavailable)
+                    continue;
+                if (nwd.reserved_net != -1 && nwd.reserved_net != net->udata)
+                    continue;
+                if (nwd.bound_nets.count(net->udata) && nwd.bound_nets.at(net->udata).second != dh)
+                    continue;
+                auto fnd = local.find(next_idx);
+                int to;
+                if (fnd == local.end()) {
+                    if (int(wires.size()) >= cfg.wavefront_max_wires)
+                        return false;
+                    to = int(wires.size());
+                    local[next_idx] = to;
+                    wires.push_back(next_idx);
+                } else {
+                    to = fnd->second;
+                }
+                edges.push_back(Edge{int(i), to, dh, score_wire_for_arc(net, crit_user, next, dh)});
+            }
+        }
+        // The graph is stored as the fan-in of each vertex
+        std::stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) { return a.to < b.to; });
+        int base = wf_graph.vertex_count();
+        size_t e = 0;
+        for (int v = 0; v < int(wires.size()); v++) {
+            for (; e < edges.size() && edges.at(e).to == v; e++) {
+                wf_graph.add_edge(base + edges.at(e).from, edges.at(e).cost);
+                wf_edge_pip.push_back(edges.at(e).pip);
+            }
+            wf_graph.end_vertex();
+            wf_vertex_wire.push_back(wires.at(v));
+        }
+        wf_graph.end_problem(base);
+        for (auto &arc : wf_arcs) {
+            if (arc.net != int(net->udata))
+                continue;
+            auto fnd = local.find(wire_to_idx(nd.arcs.at(arc.user).sink_wire));
+            arc.vertex = (fnd == local.end()) ? -1 : base + fnd->second;
+        }
+        return true;
+    }
 
-        for (auto n : route_queue) {
+    // Route the nets of batch with the wavefront backend, returning those of which all arcs were routed
+    pool<int> route_wavefront(const std::vector<int> &batch)
+    {
+        NPNR_TRACE_SCOPE("route wavefront");
+        wf_graph.clear();
+        wf_vertex_wire.clear();
+        wf_edge_pip.clear();
+        wf_arcs.clear();
+        // Nets with arcs left unrouted, which route_net must pick up
+        pool<int> failed;
+        for (int n : batch) {
+            NetInfo *net = nets_by_udata.at(n);
             auto &nd = nets.at(n);
-            auto ni = nets_by_udata.at(n);
-            int bin = N;
-            // Quadrants
-            if (nd.bb.x0 < le_x && nd.bb.x1 < le_x && nd.bb.y0 < le_y && nd.bb.y1 < le_y)
-                bin = 0;
-            else if (nd.bb.x0 >= rs_x && nd.bb.x1 >= rs_x && nd.bb.y0 < le_y && nd.bb.y1 < le_y)
-                bin = 1;
-            else if (nd.bb.x0 < le_x && nd.bb.x1 < le_x && nd.bb.y0 >= rs_y && nd.bb.y1 >= rs_y)
-                bin = 2;
-            else if (nd.bb.x0 >= rs_x && nd.bb.x1 >= rs_x && nd.bb.y0 >= rs_y && nd.bb.y1 >= rs_y)
-                bin = 3;
-            // Vertical split
-            else if (nd.bb.y0 < le_y && nd.bb.y1 < le_y)
-                bin = Nq + 0;
-            else if (nd.bb.y0 >= rs_y && nd.bb.y1 >= rs_y)
-                bin = Nq + 1;
-            // Horizontal split
-            else if (nd.bb.x0 < le_x && nd.bb.x1 < le_x)
-                bin = Nq + Nv + 0;
-            else if (nd.bb.x0 >= rs_x && nd.bb.x1 >= rs_x)
-                bin = Nq + Nv + 1;
-            tcs.at(bin).route_nets.push_back(ni);
+            size_t first_arc = wf_arcs.size();
+            int crit_user = -1;
+            for (size_t i = 0; i < net->users.size(); i++) {
+                if (check_arc_routing(net, i))
+                    continue;
+                ripup_arc(net, i);
+                wf_arcs.push_back(WavefrontArc{n, int(i), -1});
+                if (crit_user < 0 || nd.arcs.at(i).arc_crit > nd.arcs.at(crit_user).arc_crit)
+                    crit_user = int(i);
+            }
+            if (wf_arcs.size() > first_arc && !add_wavefront_problem(net, size_t(crit_user))) {
+                // The arcs have already been ripped up
+                wf_arcs.resize(first_arc);
+                failed.insert(n);
+            }
         }
-        if (ctx->verbose)
-            log_info("%d/%d nets not multi-threadable\n", int(tcs.at(N).route_nets.size()), int(route_queue.size()));
-        // Multithreaded part of routing - quadrants
-        std::vector<std::thread> threads;
-        for (int i = 0; i < Nq; i++) {
-            threads.emplace_back([this, &tcs, i]() { router_thread(tcs.at(i)); });
-        }
-        for (auto &t : threads)
-            t.join();
-        threads.clear();
-        // Vertical splits
-        for (int i = Nq; i < Nq + Nv; i++) {
-            threads.emplace_back([this, &tcs, i]() { router_thread(tcs.at(i)); });
-        }
-        for (auto &t : threads)
-            t.join();
-        threads.clear();
-        // Horizontal splits
-        for (int i = Nq + Nv; i < Nq + Nv + Nh; i++) {
-            threads.emplace_back([this, &tcs, i]() { router_thread(tcs.at(i)); });
-        }
-        for (auto &t : threads)
-            t.join();
-        threads.clear();
-        // Singlethreaded part of routing - nets that cross partitions
-        // or don't fit within bounding box
-        for (auto st_net : tcs.at(N).route_nets)
-            route_net(tcs.at(N), st_net, false);
-        // Failed nets
-        for (int i = 0; i < N; i++)
-            for (auto fail : tcs.at(i).failed_nets)
-                route_net(tcs.at(N), fail, false);
+        if (!wavefront->solve(wf_graph)) {
+            std::string error;
+            log_warning("The router2 wavefront device failed, continuing on the CPU.\n");
+            wavefront = WavefrontBackend::create(ctx, false, error);
+            wavefront->solve(wf_graph);
+        }
+        // Bind the path to each sink that was reached; those that weren't are left for route_net
+        for (auto &arc : wf_arcs) {
+            NetInfo *net = nets_by_udata.at(arc.net);
+            if (arc.vertex < 0 || wf_graph.dist.at(arc.vertex) == std::numeric_limits<float>::infinity()) {
+                failed.insert(arc.net);
+                continue;
+            }
+            int cursor = arc.vertex;
+            while (true) {
+                int e = wf_graph.pred.at(cursor);
+                bind_pip_internal(net, arc.user, wf_vertex_wire.at(cursor), e < 0 ? PipId() : wf_edge_pip.at(e));
+                if (e < 0)
+                    break;
+                cursor = wf_graph.in_src.at(e);
+            }
+            NPNR_ASSERT(wf_vertex_wire.at(cursor) == wire_to_idx(nets.at(arc.net).src_wire));
+            nets.at(arc.net).arcs.at(arc.user).routed = true;
+        }
+        pool<int> routed;
+        for (int n : batch)
+            if (!failed.count(n))
+                routed.insert(n);
+        return routed;
+    }
+
+    // Total slow corner delay over the routed arcs of a net, and the number of wires it uses
+    void route_quality(NetInfo *net, double &delay, int &wires)
+    {
+        pool<WireId> used;
+        for (auto &ad : nets.at(net->udata).arcs) {
+            if (!ad.routed)
+                continue;
+            WireId cursor = ad.sink_wire;
+            while (true) {
+                used.insert(cursor);
+                delay += ctx->getDelayNS(ctx->getWireDelay(cursor).maxDelay());
+                PipId pip = wire_data(cursor).bound_nets.at(net->udata).second;
+                if (pip == PipId())
+                    break;
+                delay += ctx->getDelayNS(ctx->getPipDelay(pip).maxDelay());
+                cursor = ctx->getPipSrcWire(pip);
+            }
+        }
+        wires += int(used.size());
+    }
+
+    // Returns the number of nets routed
+    int do_route_wavefront()
+    {
+        std::vector<int> batch = select_wavefront_nets();
+        if (batch.empty())
+            return 0;
+        // With router2/wavefrontBench, route the batch with route_net first, for a comparison
+        float serial_time = 0;
+        double serial_delay = 0;
+        int serial_wires = 0;
+        if (cfg.wavefront_bench) {
+            ThreadContext st;
+            st.rng.rngseed(ctx->rng64());
+            st.bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int n : batch)
+                route_net(st, nets_by_udata.at(n), false);
+            serial_time = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+            for (int n : batch) {
+                NetInfo *net = nets_by_udata.at(n);
+                route_quality(net, serial_delay, serial_wires);
+                for (size_t i = 0; i < net->users.size(); i++)
+                    ripup_arc(net, i);
+            }
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        pool<int> routed = route_wavefront(batch);
+        float wf_time = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+        if (timing_driven)
+            for (int n : routed)
+                tmg.mark_dirty(nets_by_udata.at(n));
+        auto is_routed = [&](int n) { return routed.count(n) > 0; };
+        route_queue.erase(std::remove_if(route_queue.begin(), route_queue.end(), is_routed), route_queue.end());
+        if (ctx->verbose || cfg.wavefront_bench)
+            log_info("    wavefront: %d/%d nets routed on %s, %d wires in %d rounds\n", int(routed.size()),
+                     int(batch.size()), wavefront->name().c_str(), wf_graph.vertex_count(), wf_graph.rounds);
+        if (cfg.wavefront_bench) {
+            double wf_delay = 0;
+            int wf_wires = 0;
+            for (int n : batch)
+                route_quality(nets_by_udata.at(n), wf_delay, wf_wires);
+            log_info("    wavefront: %.3fs (route_net %.3fs), arc delay %.1f ns (%.1f ns), %d wires used (%d)\n",
+                     wf_time, serial_time, wf_delay, serial_delay, wf_wires, serial_wires);
+        }
+        return int(routed.size());
+    }
+
+    void report_counters()
+    {
+        const RouteCounters &c = iter_counters;
+        perf_report_counter("nodes_expanded", c.nodes_expanded);
+        perf_report_counter("heap_pushes", c.heap_pushes);
+        perf_report_counter("explore_limit_hits", c.explore_limit_hits);
+        perf_report_counter("backwards_iters", c.backwards_iters);
+        perf_report_counter("backwards_routed", c.backwards_routed);
+        perf_report_counter("backwards_limit_hits", c.backwards_limit_hits);
+        perf_report_counter("bb_failures", c.bb_failures);
+        perf_report_counter("routed_nets", c.routed_nets);
+        perf_report_counter("failed_nets", c.failed_nets);
+        perf_report_counter("hold_fallbacks", c.hold_fallbacks);
+        perf_report_counter("site_fallbacks", c.site_fallbacks);
+        perf_report_counter("kept_arcs", c.kept_arcs);
+        perf_report_counter("rerouted_arcs", c.rerouted_arcs);
+        if (ctx->verbose) {
+            log_info("    expanded %lld wires (%lld pushed), %lld searches hit the explore limit\n",
+                     (long long)c.nodes_expanded, (long long)c.heap_pushes, (long long)c.explore_limit_hits);
+            log_info("    backwards: %lld wires, %lld arcs routed, %lld hit the limit; %lld bounding box failures\n",
+                     (long long)c.backwards_iters, (long long)c.backwards_routed, (long long)c.backwards_limit_hits,
+                     (long long)c.bb_failures);
+            log_info("    %lld arcs rerouted, %lld legal arcs of the same nets kept\n", (long long)c.rerouted_arcs,
+                     (long long)c.kept_arcs);
+            if (c.hold_fallbacks > 0)
+                log_info("    %lld arcs missed their hold repair target\n", (long long)c.hold_fallbacks);
+            if (c.site_fallbacks > 0)
+                log_info("    %lld arcs were routed through other sites\n", (long long)c.site_fallbacks);
+        }
+    }
+
+    MemAccount mem{"router2"};
+
+    void account_memory()
+    {
+        if (!mem_account_enabled())
+            return;
+        size_t bytes = mem_usage(nets) + mem_usage(nets_by_udata) + mem_usage(flat_wires) + mem_usage(wire_visit) +
+                       mem_usage(wire_hist_cost) + mem_usage(wire_lookahead_class) + mem_usage(route_queue) +
+                       mem_usage(overused_list) + mem_usage(wire_drive);
+        for (auto &nd : nets)
+            bytes += mem_usage(nd.arcs);
+        // Bound net maps only allocate once a wire has more than two nets
+        for (auto &wd : flat_wires)
+            if (wd.bound_nets.capacity() > 2)
+                bytes += wd.bound_nets.capacity() * sizeof(BoundNetEntry);
+#ifdef ARCH_XILINX
+        bytes += mem_usage(wire_remap) + mem_usage(sink_cones);
+        for (auto &cone : sink_cones)
+            bytes += mem_usage(cone.edges);
+#else
+        bytes += wire_idx_map.size() * (sizeof(std::pair<WireId, int>) + 2 * sizeof(int));
+#endif
+        mem.update(bytes);
+    }
+
+    // The counters of the current iteration as JSON object members, with the nets routed and failed by each worker
+    std::string counters_json()
+    {
+        const RouteCounters &c = iter_counters;
+        std::string result = stringf(
+                "\"counters\": {\"nodes_expanded\": %lld, \"heap_pushes\": %lld, \"explore_limit_hits\": %lld, "
+                "\"backwards_iters\": %lld, \"backwards_routed\": %lld, \"backwards_limit_hits\": %lld, "
+                "\"bb_failures\": %lld, \"routed_nets\": %lld, \"failed_nets\": %lld, \"hold_fallbacks\": %lld, "
+                "\"site_fallbacks\": %lld, \"kept_arcs\": %lld, \"rerouted_arcs\": %lld}",
+                (long long)c.nodes_expanded, (long long)c.heap_pushes, (long long)c.explore_limit_hits,
+                (long long)c.backwards_iters, (long long)c.backwards_routed, (long long)c.backwards_limit_hits,
+                (long long)c.bb_failures, (long long)c.routed_nets, (long long)c.failed_nets,
+                (long long)c.hold_fallbacks, (long long)c.site_fallbacks, (long long)c.kept_arcs,
+                (long long)c.rerouted_arcs);
+        std::string routed, failed;
+        for (auto &wc : worker_counters) {
+            routed += stringf("%s%lld", routed.empty() ? "" : ", ", (long long)wc.routed_nets);
+            failed += stringf("%s%lld", failed.empty() ? "" : ", ", (long long)wc.failed_nets);
+        }
+        result += stringf(", \"worker_routed_nets\": [%s], \"worker_failed_nets\": [%s]", routed.c_str(),
+                          failed.c_str());
+        return result;
+    }
+
+    // Dense wire index of each flat_wires entry, -1 for empty entries
+    std::vector<int32_t> hist_wire_index()
+    {
+        std::vector<int32_t> index(flat_wires.size(), -1);
+#ifdef ARCH_XILINX
+        for (size_t i = 0; i < flat_wires.size(); i++)
+            if (flat_wires[i].w != WireId())
+                index[i] = ctx->getWireIndex(flat_wires[i].w);
+#else
+        int32_t dense = 0;
+        for (auto wire : ctx->getWires()) {
+            int idx = wire_to_idx(wire);
+            if (idx >= 0)
+                index[idx] = dense;
+            ++dense;
+        }
+#endif
+        return index;
+    }
+
+    void load_cong_history(const std::string &file)
+    {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            log_info("No router2 congestion history in '%s' yet, starting without one.\n", file.c_str());
+            return;
+        }
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        size_t pos = 0;
+        bool ok = true;
+        auto get = [&](void *value, size_t size) {
+            if (!ok || pos + size > data.size()) {
+                ok = false;
+                return;
+            }
+            memcpy(value, data.data() + pos, size);
+            pos += size;
+        };
+        char magic[8];
+        get(magic, sizeof(magic));
+        if (!ok || memcmp(magic, cong_history_magic, sizeof(magic)) != 0) {
+            log_warning("'%s' is not a router2 congestion history file, ignoring it.\n", file.c_str());
+            return;
+        }
+        uint32_t ident_len = 0;
+        get(&ident_len, sizeof(ident_len));
+        std::string ident = (ok && pos + ident_len <= data.size()) ? data.substr(pos, ident_len) : std::string();
+        pos += ident_len;
+        if (!ok || ident != chipdb_identity(ctx)) {
+            log_info("Router2 congestion history in '%s' is for another chip database, ignoring it.\n", file.c_str());
+            return;
+        }
+        uint32_t count = 0;
+        get(&count, sizeof(count));
+        if (!ok || data.size() - pos != size_t(count) * (sizeof(int32_t) + sizeof(float))) {
+            log_warning("Router2 congestion history file '%s' is truncated, ignoring it.\n", file.c_str());
+            return;
+        }
+#ifndef ARCH_XILINX
+        std::vector<WireId> chip_wires;
+        for (auto wire : ctx->getWires())
+            chip_wires.push_back(wire);
+#endif
+        int loaded = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            int32_t dense = -1;
+            float cost = 1.0f;
+            get(&dense, sizeof(dense));
+            get(&cost, sizeof(cost));
+#ifdef ARCH_XILINX
+            if (dense < 0 || dense >= ctx->getWireIndexCount())
+                continue;
+            int idx = wire_remap.empty() ? dense : wire_remap[dense];
+#else
+            if (dense < 0 || dense >= int32_t(chip_wires.size()))
+                continue;
+            int idx = wire_to_idx(chip_wires[dense]);
+#endif
+            if (idx < 0 || idx >= int(wire_hist_cost.size()))
+                continue;
+            wire_hist_cost[idx] = cost;
+            ++loaded;
+        }
+        log_info("Loaded the historical congestion cost of %d wires from '%s'.\n", loaded, file.c_str());
+    }
+
+    void save_cong_history(const std::string &file)
+    {
+        std::vector<int32_t> index = hist_wire_index();
+        std::vector<std::pair<int32_t, float>> entries;
+        for (size_t i = 0; i < wire_hist_cost.size(); i++)
+            if (wire_hist_cost[i] != 1.0f && index[i] >= 0)
+                entries.emplace_back(index[i], wire_hist_cost[i]);
+        std::sort(entries.begin(), entries.end());
+        std::string out(cong_history_magic, sizeof(cong_history_magic));
+        auto put = [&](const void *value, size_t size) { out.append(reinterpret_cast<const char *>(value), size); };
+        std::string ident = chipdb_identity(ctx);
+        uint32_t ident_len = ident.size(), count = entries.size();
+        put(&ident_len, sizeof(ident_len));
+        out += ident;
+        put(&count, sizeof(count));
+        for (auto &entry : entries) {
+            put(&entry.first, sizeof(entry.first));
+            put(&entry.second, sizeof(entry.second));
+        }
+        std::ofstream f(file, std::ios::binary);
+        if (f)
+            f.write(out.data(), out.size());
+        if (!f)
+            log_warning("Failed to write router2 congestion history file '%s'.\n", file.c_str());
+        else
+            log_info("Wrote the historical congestion cost of %d wires to '%s'.\n", int(count), file.c_str());
     }
 
     //#define ROUTER2_STATISTICS
@@ -1292,8 +3334,8 @@ struct Router2
         int total_wires = int(flat_wires.size());
         int have_hist_cong = 0;
         int have_any_bound = 0, have_1_bound = 0, have_2_bound = 0, have_gte3_bound = 0;
-        for (auto &wire : flat_wires) {
-            int bound = wire.bound_nets.size();
+        for (size_t i = 0; i < flat_wires.size(); i++) {
+            int bound = flat_wires[i].bound_nets.size();
             if (bound != 0)
                 ++have_any_bound;
             if (bound == 1)
@@ -1302,7 +3344,7 @@ struct Router2
                 ++have_2_bound;
             else if (bound >= 3)
                 ++have_gte3_bound;
-            if (wire.hist_cong_cost > 1.0)
+            if (wire_hist_cost[i] > 1.0)
                 ++have_hist_cong;
         }
         log_info("Out of %d wires:\n", total_wires);
@@ -1315,41 +3357,158 @@ struct Router2
 #endif
     }
 
-    void operator()()
+    int hold_repair_passes = 0;
+
+    // Once routing has converged, rip up the arcs that violate a hold check by the fast corner timing, and give each
+    // a minimum fast corner delay that fixes it; the next iterations then route them with a detour. Returns true if
+    // any arc was ripped up.
+    bool repair_hold()
+    {
+        ++hold_repair_passes;
+        // Earlier analyses may have seen the estimated delays of nets that were not bound yet
+        for (auto net : nets_by_udata)
+            tmg.mark_dirty(net);
+        auto sta_start = std::chrono::high_resolution_clock::now();
+        tmg.get_criticalities(&net_crit);
+        sta_time += std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - sta_start).count();
+
+        delay_t margin = ctx->getDelayFromNS(cfg.hold_margin).maxDelay();
+        delay_t worst_slack = std::numeric_limits<delay_t>::max();
+        int ripped = 0;
+        for (auto net : nets_by_udata) {
+            if (!is_selected(net))
+                continue;
+            if (!net_crit.has(net))
+                continue;
+            auto &nd = nets.at(net->udata);
+            bool net_ripped = false;
+            for (int i = 0; i < net_crit.num_arcs(net); i++) {
+                auto &ad = nd.arcs.at(i);
+                delay_t hold_slack = net_crit.arc_hold_slack(net, i);
+                if (hold_slack >= margin || !ad.routed)
+                    continue;
+                delay_t min_delay;
+                ctx->getNetinfoRouteDelay(net, net->users.at(i), min_delay);
+                ad.min_delay_target = std::max(ad.min_delay_target, min_delay + margin - hold_slack);
+                worst_slack = std::min(worst_slack, hold_slack);
+                ripup_arc(net, i);
+                net_ripped = true;
+                ++ripped;
+            }
+            if (net_ripped) {
+                failed_nets.insert(net->udata);
+                route_queue.push_back(net->udata);
+            }
+        }
+        if (ripped > 0)
+            log_info("    hold repair: rerouting %d arcs, worst hold slack %.02f ns\n", ripped,
+                     ctx->getDelayNS(worst_slack));
+        return ripped > 0;
+    }
+
+    // Rip up the unlocked routing of the nets of cfg.only_nets, before the wires are set up
+    void ripup_selected()
+    {
+        std::vector<WireId> net_wires;
+        for (auto net : nets_by_udata) {
+            if (!is_selected(net))
+                continue;
+            net_wires.clear();
+            for (auto &w : net->wires)
+                if (w.second.strength < STRENGTH_LOCKED)
+                    net_wires.push_back(w.first);
+            for (auto w : net_wires)
+                if (net->wires.count(w))
+                    ctx->unbindWire(w);
+        }
+    }
+
+    bool operator()()
     {
         log_info("Running router2...\n");
         log_info("Setting up routing resources...\n");
         auto rstart = std::chrono::high_resolution_clock::now();
+        PerfScope setup_scope("setup");
         setup_nets();
+        if (cfg.small_design_cells > 0 && int(ctx->cells.size()) <= cfg.small_design_cells) {
+            log_info("Small design (%d cells), only setting up wires near the nets.\n", int(ctx->cells.size()));
+            small_design = true;
+            cfg.prune_wires = true;
+        }
+#ifdef ARCH_XILINX
+        if (cfg.site_abstraction)
+            cfg.prune_wires = true;
+#else
+        cfg.site_abstraction = false;
+#endif
+        if (!selected_nets.empty()) {
+            log_info("Rerouting %d nets, keeping the routing of the others.\n", int(cfg.only_nets.size()));
+            ripup_selected();
+        }
         setup_wires();
+        if (!cfg.cong_history_file.empty())
+            load_cong_history(cfg.cong_history_file);
+#ifdef ARCH_XILINX
+        if (cfg.backwards_cones)
+            setup_sink_cones();
+#endif
         find_all_reserved_wires();
-        partition_nets();
+        if (cfg.wavefront != "off") {
+            std::string error;
+            wavefront = WavefrontBackend::create(ctx, cfg.wavefront == "gpu", error);
+            if (!wavefront) {
+                log_warning("No device for the router2 wavefront mode (%s), using the CPU.\n", error.c_str());
+                wavefront = WavefrontBackend::create(ctx, false, error);
+            }
+            log_info("Routing short nets in batches on %s.\n", wavefront->name().c_str());
+        }
         curr_cong_weight = cfg.init_curr_cong_weight;
         hist_cong_weight = cfg.hist_cong_weight;
         ThreadContext st;
         int iter = 1;
 
         for (size_t i = 0; i < nets_by_udata.size(); i++)
-            route_queue.push_back(i);
+            if (is_selected(nets_by_udata.at(i)))
+                route_queue.push_back(i);
 
         timing_driven = ctx->setting<bool>("timing_driven");
+        if (timing_driven)
+            tmg.setup();
+
+        std::ofstream stats_out;
+        if (!cfg.stats_json.empty()) {
+            stats_out.open(cfg.stats_json);
+            if (!stats_out)
+                log_error("Failed to open router2 statistics file '%s' for writing.\n", cfg.stats_json.c_str());
+        }
+        int last_overuse = -1, stalled_iters = 0;
+        bool serial = false, cancelled = false;
+        if (cfg.rollback_iters > 0)
+            changed_since_best.assign(nets.size(), 1);
+        setup_scope.stop();
+        account_memory();
+
         log_info("Running main router loop...\n");
         do {
+            PerfScope iter_scope(stringf("iter %d", iter));
+            NPNR_TRACE_SCOPE_ARG("router2 iter", "iter", iter);
+            route_iter = iter;
+            auto iter_start = std::chrono::high_resolution_clock::now();
+            float iter_sta_start = sta_time;
             ctx->sorted_shuffle(route_queue);
 
             if (timing_driven && (int(route_queue.size()) > (int(nets_by_udata.size()) / 50))) {
                 // Heuristic: reduce runtime by skipping STA in the case of a "long tail" of a few
                 // congested nodes
-                get_criticalities(ctx, &net_crit);
+                auto sta_start = std::chrono::high_resolution_clock::now();
+                tmg.get_criticalities(&net_crit);
+                sta_time += std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - sta_start).count();
                 for (auto n : route_queue) {
-                    IdString name = nets_by_udata.at(n)->name;
-                    auto fnd = net_crit.find(name);
+                    NetInfo *ni = nets_by_udata.at(n);
                     auto &net = nets.at(n);
                     net.max_crit = 0;
-                    if (fnd == net_crit.end())
-                        continue;
-                    for (int i = 0; i < int(fnd->second.criticality.size()); i++) {
-                        float c = fnd->second.criticality.at(i);
+                    for (int i = 0; i < net_crit.num_arcs(ni); i++) {
+                        float c = net_crit.arc_criticality(ni, i);
                         net.arcs.at(i).arc_crit = c;
                         net.max_crit = std::max(net.max_crit, c);
                     }
@@ -1365,9 +3524,37 @@ struct Router2
                     log("    routed %d/%d\n", int(j), int(route_queue.size()));
             }
 #endif
-            do_route();
+            reset_epochs();
+            iter_counters = RouteCounters();
+            worker_counters.clear();
+            if (cfg.rollback_iters > 0)
+                for (int n : route_queue)
+                    changed_since_best.at(n) = 1;
+            int wavefront_nets = wavefront ? do_route_wavefront() : 0;
+            do_route(serial);
+            if (timing_driven)
+                for (int n : route_queue)
+                    tmg.mark_dirty(nets_by_udata.at(n));
+            int routed_nets = int(route_queue.size()) + wavefront_nets;
             route_queue.clear();
             update_congestion();
+            if (cfg.rollback_iters > 0 && overused_wires > 0) {
+                if (best_overuse < 0 || total_overuse < best_overuse) {
+                    save_best_routing();
+                    best_overuse = total_overuse;
+                    best_iter = iter;
+                    hist_cong_weight = cfg.hist_cong_weight;
+                } else if (iter - best_iter >= cfg.rollback_iters) {
+                    log_info("    no improvement on iteration %d in %d iterations, going back to its routing\n",
+                             best_iter, iter - best_iter);
+                    restore_best_routing();
+                    // Try to break the cycle by making the wires that keep being fought over more expensive, up to
+                    // a limit so that repeated rollbacks can't swamp every other cost
+                    hist_cong_weight = std::min(2 * hist_cong_weight, 64.0 * cfg.hist_cong_weight);
+                    count_overuse();
+                    best_iter = iter;
+                }
+            }
 #if 0
             if (iter == 1 && ctx->debug) {
                 std::ofstream cong_map("cong_map_0.csv");
@@ -1382,11 +3569,54 @@ struct Router2
             }
             for (auto cn : failed_nets)
                 route_queue.push_back(cn);
+            if (failed_nets.empty() && timing_driven && hold_repair_passes < cfg.hold_repair_passes)
+                repair_hold();
             log_info("    iter=%d wires=%d overused=%d overuse=%d archfail=%s\n", iter, total_wire_use, overused_wires,
                      total_overuse, overused_wires > 0 ? "NA" : std::to_string(arch_fail).c_str());
+            report_counters();
+            account_memory();
+
+            auto iter_end = std::chrono::high_resolution_clock::now();
+            float elapsed = std::chrono::duration<float>(iter_end - rstart).count();
+            if (stats_out) {
+                stats_out << stringf("{\"iter\": %d, \"routed_nets\": %d, \"wires\": %d, \"overused\": %d, "
+                                     "\"overuse\": %d, \"failed_nets\": %d, \"cong_weight\": %g, \"serial\": %s, "
+                                     "\"iter_time\": %.3f, \"sta_time\": %.3f, \"time\": %.3f, %s}\n",
+                                     iter, routed_nets, total_wire_use, overused_wires, total_overuse,
+                                     int(failed_nets.size()), curr_cong_weight, serial ? "true" : "false",
+                                     std::chrono::duration<float>(iter_end - iter_start).count(),
+                                     sta_time - iter_sta_start, elapsed, counters_json().c_str());
+                stats_out.flush();
+            }
             ++iter;
+
+            // With the adaptive schedule, every iteration in a row where the overuse barely fell doubles the
+            // congestion weight increment
+            if (cfg.adaptive_cong_weight && last_overuse >= 0 && total_overuse > (1 - cfg.stall_ratio) * last_overuse)
+                stalled_iters = std::min(stalled_iters + 1, 8);
+            else
+                stalled_iters = 0;
+            last_overuse = total_overuse;
             if (curr_cong_weight < 1e9)
-                curr_cong_weight += cfg.curr_cong_mult;
+                curr_cong_weight += cfg.curr_cong_mult * (1 << stalled_iters);
+
+            // Resolve the last few conflicts on one thread, without partitioning
+            serial = cfg.serial_overused_wires > 0 && overused_wires <= cfg.serial_overused_wires;
+
+            if (!failed_nets.empty() && cfg.time_budget > 0 && elapsed > cfg.time_budget) {
+                log_warning("Router2 time budget of %.1fs exceeded with %d overused wires, leaving them to router1.\n",
+                            cfg.time_budget, overused_wires);
+                if (overused_wires > 0)
+                    bind_and_check_all();
+                break;
+            }
+            if (!failed_nets.empty() && cfg.cancel != nullptr && cfg.cancel->load()) {
+                log_warning("Router2 cancelled with %d overused wires.\n", overused_wires);
+                if (overused_wires > 0)
+                    bind_and_check_all();
+                cancelled = true;
+                break;
+            }
         } while (!failed_nets.empty());
         if (cfg.perf_profile) {
             std::vector<std::pair<int, IdString>> nets_by_runtime;
@@ -1403,25 +3633,108 @@ struct Router2
         }
         auto rend = std::chrono::high_resolution_clock::now();
         log_info("Router2 time %.02fs\n", std::chrono::duration<float>(rend - rstart).count());
-
-        log_info("Running router1 to check that route is legal...\n");
-
-        router1(ctx, Router1Cfg(ctx));
+#ifdef ARCH_XILINX
+        if (const_template_hits + const_searches > 0)
+            log_info("    constant sinks: %d routed from %d templates, %d searched\n", const_template_hits,
+                     int(const_templates.size()), const_searches);
+#endif
+        if (cfg.perf_profile && timing_driven)
+            log_info("    of which timing analysis %.02fs\n", sta_time);
+        if (!cfg.cong_history_file.empty() && !cancelled)
+            save_cong_history(cfg.cong_history_file);
+
+        log_info("Checking that route is legal...\n");
+        auto vstart = std::chrono::high_resolution_clock::now();
+        std::vector<NetInfo *> illegal_nets = verify_routing();
+        log_info("Legality check time %.02fs\n",
+                 std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - vstart).count());
+        if (illegal_nets.empty()) {
+            log_info("Checksum: 0x%08x\n", ctx->checksum());
+            timing_analysis(ctx, true /* slack_histogram */, true /* print_fmax */, true /* print_path */,
+                            true /* warn_on_failure */);
+        } else {
+            // Rip up the unlocked routing of the offending nets and leave them to router1, unless cancelled
+            if (cancelled)
+                log_info("Ripping up the routing of %d nets that failed the legality check.\n",
+                         int(illegal_nets.size()));
+            else
+                log_info("%d nets failed the legality check, rerouting them with router1...\n",
+                         int(illegal_nets.size()));
+            std::vector<WireId> net_wires;
+            for (auto net : illegal_nets) {
+                net_wires.clear();
+                for (auto &w : net->wires)
+                    if (w.second.strength < STRENGTH_LOCKED)
+                        net_wires.push_back(w.first);
+                for (auto w : net_wires)
+                    if (net->wires.count(w))
+                        ctx->unbindWire(w);
+            }
+            if (!cancelled)
+                router1(ctx, Router1Cfg(ctx));
+        }
+        return !cancelled;
     }
 };
 } // namespace
 
-void router2(Context *ctx, const Router2Cfg &cfg)
+bool router2(Context *ctx, const Router2Cfg &cfg)
 {
     Router2 rt(ctx, cfg);
     rt.ctx = ctx;
-    rt();
+    return rt();
+}
+
+Router2Job::Router2Job(Context *ctx, const Router2Cfg &cfg, std::function<void(bool)> finish)
+        : ctx(ctx), cfg(cfg), finish(finish)
+{
+    this->cfg.cancel = &cancelled;
+    thread = std::thread([this]() {
+        // Nothing may escape the thread, and the job must finish however the router does
+        try {
+            result = router2(this->ctx, this->cfg);
+        } catch (log_execution_error_exception) {
+            result = false;
+        } catch (const std::exception &e) {
+            log_nonfatal_error("Router2 job failed: %s\n", e.what());
+            result = false;
+        } catch (...) {
+            log_nonfatal_error("Router2 job failed.\n");
+            result = false;
+        }
+        if (this->finish) {
+            try {
+                this->finish(result);
+            } catch (...) {
+                result = false;
+            }
+        }
+        finished = true;
+    });
+}
+
+Router2Job::~Router2Job()
+{
+    std::lock_guard<std::mutex> lock(join_mutex);
+    if (thread.joinable()) {
+        cancel();
+        thread.join();
+    }
+}
+
+bool Router2Job::wait()
+{
+    std::lock_guard<std::mutex> lock(join_mutex);
+    if (thread.joinable())
+        thread.join();
+    return result;
 }
 
 Router2Cfg::Router2Cfg(Context *ctx)
 {
     backwards_max_iter = ctx->setting<int>("router2/bwdMaxIter", 20);
     global_backwards_max_iter = ctx->setting<int>("router2/glbBwdMaxIter", 200);
+    backwards_cones = ctx->setting<bool>("router2/bwdCones", true);
     bb_margin_x = ctx->setting<int>("router2/bbMargin/x", 3);
     bb_margin_y = ctx->setting<int>("router2/bbMargin/y", 3);
     ipin_cost_adder = ctx->setting<float>("router2/ipinCostAdder", 0.0f);
@@ -1430,7 +3743,47 @@ Router2Cfg::Router2Cfg(Context *ctx)
     hist_cong_weight = ctx->setting<float>("router2/histCongWeight", 1.0f);
     curr_cong_mult = ctx->setting<float>("router2/currCongWeightMult", 2.0f);
     estimate_weight = ctx->setting<float>("router2/estimateWeight", 1.75f);
+    fixed_point_cost = ctx->setting<bool>("router2/fixedPointCost", false);
+    fixed_cost_scale = std::max(1.0f, ctx->setting<float>("router2/fixedPointScale", 1024.0f));
+    threads = std::max(1, ctx->setting<int>("threads", std::max<int>(1, std::thread::hardware_concurrency())));
+    partition_min_nets = ctx->setting<int>("router2/partitionMinNets", 100);
+    partition_regions = ctx->setting<int>("router2/partitionRegions", 0);
+    deterministic = ctx->setting<bool>("router2/deterministic", false);
+    tree_fanout = ctx->setting<int>("router2/treeFanout", 0);
+    tree_max_seeds = ctx->setting<int>("router2/treeMaxSeeds", 64);
+    reuse_fanout = ctx->setting<int>("router2/reuseFanout", 16);
+    prune_wires = ctx->setting<bool>("router2/pruneWires", false);
+    small_design_cells = ctx->setting<int>("router2/smallDesignCells", 0);
+    small_design_margin = ctx->setting<int>("router2/smallDesignMargin", 8);
+    site_abstraction = ctx->setting<bool>("router2/siteAbstraction", false);
+    numa = ctx->setting<bool>("numa", false);
     perf_profile = ctx->setting<float>("router2/perfProfile", false);
+    adaptive_cong_weight = ctx->setting<bool>("router2/adaptiveCongWeight", false);
+    adaptive_search = ctx->setting<bool>("router2/adaptiveSearch", false);
+    stall_ratio = ctx->setting<float>("router2/stallRatio", 0.1f);
+    time_budget = ctx->setting<float>("router2/timeBudget", 0.0f);
+    rollback_iters = ctx->setting<int>("router2/rollbackIters", 0);
+    serial_overused_wires = ctx->setting<int>("router2/serialOverusedWires", 0);
+    hold_repair_passes = ctx->setting<int>("router2/holdRepairPasses", 1);
+    hold_margin = ctx->setting<float>("router2/holdMargin", 0.0f);
+    auto stats = ctx->settings.find(ctx->id("router2/statsJson"));
+    if (stats != ctx->settings.end())
+        stats_json = stats->second.as_string();
+    auto lookahead = ctx->settings.find(ctx->id("router2/lookahead"));
+    if (lookahead != ctx->settings.end())
+        lookahead_file = lookahead->second.as_string();
+    auto history = ctx->settings.find(ctx->id("router2/congHistory"));
+    if (history != ctx->settings.end())
+        cong_history_file = history->second.as_string();
+    lookahead_radius = ctx->setting<int>("router2/lookaheadRadius", 20);
+    lookahead_samples = ctx->setting<int>("router2/lookaheadSamples", 3);
+    wavefront = str_or_default(ctx->settings, ctx->id("router2/wavefront"), "off");
+    if (wavefront != "off" && wavefront != "cpu" && wavefront != "gpu")
+        log_error("Unknown router2 wavefront mode '%s', expected 'off', 'cpu' or 'gpu'\n", wavefront.c_str());
+    wavefront_span = ctx->setting<int>("router2/wavefrontSpan", 8);
+    wavefront_max_users = ctx->setting<int>("router2/wavefrontMaxUsers", 4);
+    wavefront_max_wires = ctx->setting<int>("router2/wavefrontMaxWires", 20000);
+    wavefront_bench = ctx->setting<bool>("router2/wavefrontBench", false);
 }
 
 NEXTPNR_NAMESPACE_END
@@ -17,6 +17,10 @@
  *
  */
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include "nextpnr.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -29,6 +33,9 @@ struct Router2Cfg
     int backwards_max_iter;
     // Maximum iterations for backwards routing attempt for global nets
     int global_backwards_max_iter;
+    // Walk a fan-in cone precomputed per kind of sink for the backwards routing attempt, rather than searching
+    // (Xilinx only)
+    bool backwards_cones;
     // Padding added to bounding boxes to account for imperfect routing,
     // congestion, etc
     int bb_margin_x, bb_margin_y;
@@ -46,11 +53,124 @@ struct Router2Cfg
     // mean faster and more directed routing, at the risk
     // of choosing a less congestion/delay-optimal route
     float estimate_weight;
+    // Add up and compare A* costs as whole numbers of 1/fixed_cost_scale units rather than as floats, so that the
+    // search order doesn't depend on how the compiler rounds and contracts float sums
+    bool fixed_point_cost;
+    float fixed_cost_scale;
+
+    // Number of worker threads used for routing
+    int threads;
+    // Regions with fewer nets than this are not split further
+    // when partitioning the design for multithreaded routing
+    int partition_min_nets;
+    // Number of leaf regions to split the design into (0 for two per thread)
+    int partition_regions;
+    // Give the same result at any thread count: the partitioning doesn't depend on the thread count, and each net
+    // is routed with a seed derived from its name and the iteration (a time budget still makes results timing
+    // dependent)
+    bool deterministic;
+
+    // Nets with at least this many sinks are routed as one shared tree, each search starting from the routing
+    // of the sinks nearer to the source (0 disables this)
+    int tree_fanout;
+    // Maximum number of tree wires a shared tree search is started from
+    int tree_max_seeds;
+    // Nets with at least this many sinks, of which only some arcs have to be rerouted, have those arcs routed as a
+    // shared tree grown from the legal arcs that were kept (0 disables this)
+    int reuse_fanout;
+
+    // Leave out wires that can't reach any sink of the design from the routing graph
+    bool prune_wires;
+    // Designs with at most this many cells (0 disables this) prune wires as above, and also leave out every wire
+    // further than small_design_margin tiles from the union of the nets' bounding boxes, so that setting up the
+    // routing graph only touches the used region of the device
+    int small_design_cells;
+    int small_design_margin;
+    // Xilinx only: prune wires as above, and also leave out the site wires of every site that no net has a source,
+    // sink or bound wire in; each arc then only searches through the site wires of its own source and sink sites,
+    // so that the general search doesn't explore the muxes and route-thrus of other sites. An arc that finds no route
+    // that way is retried through the other used sites, but an arc that has to pass through an otherwise empty site,
+    // such as the ILOGIC/IDELAY bypass of an input on xc7, fails to route with this enabled
+    bool site_abstraction;
+
+    // With the threads pinned to NUMA nodes (the numa setting), place the per-wire data of each vertical stripe of
+    // the device on one node, and have threads prefer routing the partitions of their own stripe
+    bool numa;
 
     // Print additional performance profiling information
     bool perf_profile = false;
+
+    // Increase the current congestion weight faster while the overuse has stopped falling, by less than
+    // stall_ratio of itself per iteration
+    bool adaptive_cong_weight;
+    float stall_ratio;
+    // Size the A* explore limit of each arc from the wires its last search needed (doubled after a search that hit the
+    // limit), and grow the bounding box of a net that failed on the sides its routing reached, not only by one tile
+    // every ten failures
+    bool adaptive_search;
+    // Stop iterating after this many seconds and leave the remaining congestion to router1 (0 for no limit)
+    float time_budget;
+    // Go back to the routing of the iteration with the lowest overuse so far once this many iterations have passed
+    // without beating it, and double the historical congestion weight, up to 64 times its setting and back to it
+    // once the overuse improves (0 to never do this)
+    int rollback_iters;
+    // Route single-threaded once no more than this many wires are overused (0 to never force this)
+    int serial_overused_wires;
+    // Times the routing is checked for hold violations once it has converged, after which the violating arcs are
+    // rerouted with a detour, until they have at least hold_margin ns of hold slack (0 to skip this)
+    int hold_repair_passes;
+    float hold_margin;
+    // File to write one JSON record per iteration to, if not empty
+    std::string stats_json;
+    // Cache file for the map based lookahead used as the A* estimate; empty to use estimateDelay
+    std::string lookahead_file;
+    // Offsets up to this many tiles are in the lookahead table, found from this many sources per wire class
+    int lookahead_radius, lookahead_samples;
+    // File with the historical congestion costs of a previous run on the same chip database, if not empty. They are
+    // loaded as the starting costs if the file exists, and this run's final costs are written back to it.
+    std::string cong_history_file;
+
+    // Route batches of short nets by wavefront expansion ("cpu" or "gpu"; "off" to disable this) before each
+    // iteration: nets with at most wavefront_max_users sinks and a bounding box of at most wavefront_span tiles each
+    // way, including the margin, and with at most wavefront_max_wires wires in it. Any arcs not routed are left to the
+    // normal search.
+    std::string wavefront;
+    int wavefront_span, wavefront_max_users, wavefront_max_wires;
+    // Also route each batch with the normal search first, and log the time taken and route quality of both
+    bool wavefront_bench;
+
+    // If not empty, only these nets are ripped up and routed again; the routing of every other net is kept, and the
+    // wires it uses are unavailable to the router
+    std::vector<IdString> only_nets;
+    // Checked after every iteration; once set, the router stops and leaves the nets it hasn't legally routed unrouted
+    const std::atomic<bool> *cancel = nullptr;
 };
 
-void router2(Context *ctx, const Router2Cfg &cfg);
+// Returns false if the router was cancelled before it finished
+bool router2(Context *ctx, const Router2Cfg &cfg);
+
+// Runs router2 on a background thread, for the nets of cfg.only_nets, then finish (if given) on the same thread with
+// its result. The design must not be changed, or routed by anything else, until done() returns true.
+class Router2Job
+{
+  public:
+    Router2Job(Context *ctx, const Router2Cfg &cfg, std::function<void(bool)> finish = nullptr);
+    ~Router2Job();
+
+    bool done() const { return finished; }
+    // Ask the router to stop after its current iteration
+    void cancel() { cancelled = true; }
+    // Block until the router has finished; returns false if it was cancelled. May be called from several threads.
+    bool wait();
+
+  private:
+    Context *ctx;
+    Router2Cfg cfg;
+    std::function<void(bool)> finish;
+    std::atomic<bool> cancelled{false}, finished{false};
+    bool result = false;
+    std::thread thread;
+    std::mutex join_mutex;
+};
 
 NEXTPNR_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,332 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "router2_lookahead.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <queue>
+#include <thread>
+#include "checkpoint.h"
+#include "log.h"
+#include "perf_report.h"
+#include "thread_pool.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+/*
+ * Lookahead file layout, all integers are native endian:
+ *
+ *   char[8]  magic "NPLKAH01"
+ *   str      chip database identity, see chipdb_identity()
+ *   i32      radius, i32 samples per class
+ *   u32      number of classes, then per class:
+ *              str  wire type
+ *              f32  delay per tile beyond the table
+ *              f32  (2 * radius + 1)^2 delays, by offset
+ *
+ * A str is a u32 length followed by the characters without a terminator.
+ */
+
+namespace {
+
+const char lookahead_magic[8] = {'N', 'P', 'L', 'K', 'A', 'H', '0', '1'};
+
+template <typename T> void put(std::string &out, T value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void put_str(std::string &out, const std::string &s)
+{
+    put<uint32_t>(out, s.size());
+    out += s;
+}
+
+struct LookaheadReader
+{
+    const std::string &data;
+    size_t pos = 0;
+    bool ok = true;
+
+    LookaheadReader(const std::string &data) : data(data) {}
+
+    template <typename T> T get()
+    {
+        T value{};
+        if (pos + sizeof(T) > data.size()) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string get_str()
+    {
+        uint32_t len = get<uint32_t>();
+        if (!ok || pos + len > data.size()) {
+            ok = false;
+            return std::string();
+        }
+        pos += len;
+        return data.substr(pos - len, len);
+    }
+};
+
+struct QueuedWire
+{
+    delay_t delay;
+    WireId wire;
+    bool operator<(const QueuedWire &other) const { return delay > other.delay; }
+};
+
+} // namespace
+
+void Router2Lookahead::init(Context *ctx, const std::string &file, int radius, int samples, int threads)
+{
+    this->ctx = ctx;
+    this->radius = radius;
+    this->samples = samples;
+    if (load(file)) {
+        log_info("Loaded router2 lookahead for %d wire classes from '%s'.\n", int(classes.size()), file.c_str());
+        return;
+    }
+    PerfScope scope("lookahead");
+    compute(threads);
+    save(file);
+}
+
+int Router2Lookahead::wire_class(WireId wire) const
+{
+    auto fnd = class_index.find(ctx->getWireType(wire));
+    return (fnd == class_index.end()) ? -1 : fnd->second;
+}
+
+float Router2Lookahead::estimate(int cls, int dx, int dy) const
+{
+    if (cls < 0)
+        return -1;
+    int cx = std::max(-radius, std::min(radius, dx)), cy = std::max(-radius, std::min(radius, dy));
+    float base = table[cls][offset_index(cx, cy)];
+    if (base < 0)
+        return -1;
+    int beyond = (std::abs(dx) - std::abs(cx)) + (std::abs(dy) - std::abs(cy));
+    if (beyond == 0)
+        return base;
+    if (rate[cls] < 0)
+        return -1;
+    return base + rate[cls] * beyond;
+}
+
+void Router2Lookahead::compute(int threads)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Count the wires of each class, then pick sources spread evenly over the getWires order, which goes roughly
+    // tile by tile over the device
+    std::vector<int> class_count;
+    for (WireId wire : ctx->getWires()) {
+        IdString type = ctx->getWireType(wire);
+        auto ins = class_index.emplace(type, int(classes.size()));
+        if (ins.second) {
+            classes.push_back(type);
+            class_count.push_back(0);
+        }
+        ++class_count[ins.first->second];
+    }
+    std::vector<std::pair<int, WireId>> sources;
+    {
+        std::vector<int> seen(classes.size(), 0), taken(classes.size(), 0);
+        for (WireId wire : ctx->getWires()) {
+            int cls = class_index.at(ctx->getWireType(wire));
+            int idx = seen[cls]++;
+            if (taken[cls] >= samples || idx < ((taken[cls] + 1) * class_count[cls]) / (samples + 1))
+                continue;
+            auto downhill = ctx->getPipsDownhill(wire);
+            if (!(downhill.begin() != downhill.end()))
+                continue;
+            sources.emplace_back(cls, wire);
+            ++taken[cls];
+        }
+    }
+    log_info("Computing router2 lookahead for %d wire classes from %d sources...\n", int(classes.size()),
+             int(sources.size()));
+
+    int size = (2 * radius + 1) * (2 * radius + 1);
+    auto get_loc = [&](WireId wire) {
+        ArcBounds bb = ctx->getRouteBoundingBox(wire, wire);
+        return std::make_pair((bb.x0 + bb.x1) / 2, (bb.y0 + bb.y1) / 2);
+    };
+    auto is_sink = [&](WireId wire) {
+        for (auto bp : ctx->getWireBelPins(wire))
+            if (ctx->getBelPinType(bp.bel, bp.pin) == PORT_IN)
+                return true;
+        return false;
+    };
+
+    // Each worker keeps a table of its own, which are merged at the end
+    threads = std::max(1, std::min(threads, int(sources.size())));
+    std::vector<std::vector<std::vector<float>>> worker_tables(
+            threads, std::vector<std::vector<float>>(classes.size(), std::vector<float>(size, -1)));
+    std::atomic<int> next_source(0);
+    auto worker = [&](int t) {
+        auto &tables = worker_tables.at(t);
+        std::unordered_map<WireId, delay_t> best;
+        std::priority_queue<QueuedWire> queue;
+        for (int s = next_source++; s < int(sources.size()); s = next_source++) {
+            int cls = sources[s].first;
+            WireId src = sources[s].second;
+            auto src_loc = get_loc(src);
+            best.clear();
+            best[src] = 0;
+            queue.push(QueuedWire{0, src});
+            while (!queue.empty()) {
+                QueuedWire curr = queue.top();
+                queue.pop();
+                if (curr.delay > best.at(curr.wire))
+                    continue;
+                auto loc = get_loc(curr.wire);
+                int dx = loc.first - src_loc.first, dy = loc.second - src_loc.second;
+                if (std::abs(dx) > radius || std::abs(dy) > radius)
+                    continue;
+                if (is_sink(curr.wire)) {
+                    float &entry = tables[cls][offset_index(dx, dy)];
+                    float delay = ctx->getDelayNS(curr.delay);
+                    if (entry < 0 || delay < entry)
+                        entry = delay;
+                }
+                for (PipId pip : ctx->getPipsDownhill(curr.wire)) {
+                    WireId next = ctx->getPipDstWire(pip);
+                    delay_t next_delay =
+                            curr.delay + ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(next).maxDelay();
+                    auto ins = best.emplace(next, next_delay);
+                    if (!ins.second) {
+                        if (next_delay >= ins.first->second)
+                            continue;
+                        ins.first->second = next_delay;
+                    }
+                    queue.push(QueuedWire{next_delay, next});
+                }
+            }
+        }
+    };
+    ThreadPool::TaskGroup workers(ctx->threadPool());
+    for (int t = 1; t < threads; t++)
+        workers.run([&worker, t]() { worker(t); });
+    worker(0);
+    workers.wait();
+
+    table = std::move(worker_tables.at(0));
+    for (int t = 1; t < threads; t++)
+        for (size_t cls = 0; cls < classes.size(); cls++)
+            for (int i = 0; i < size; i++) {
+                float other = worker_tables.at(t).at(cls).at(i);
+                float &entry = table.at(cls).at(i);
+                if (other >= 0 && (entry < 0 || other < entry))
+                    entry = other;
+            }
+
+    rate.assign(classes.size(), -1);
+    int known = 0;
+    for (size_t cls = 0; cls < classes.size(); cls++)
+        for (int dy = -radius; dy <= radius; dy++)
+            for (int dx = -radius; dx <= radius; dx++) {
+                float entry = table[cls][offset_index(dx, dy)];
+                if (entry < 0)
+                    continue;
+                ++known;
+                if (std::max(std::abs(dx), std::abs(dy)) != radius)
+                    continue;
+                float per_tile = entry / (std::abs(dx) + std::abs(dy));
+                if (rate[cls] < 0 || per_tile < rate[cls])
+                    rate[cls] = per_tile;
+            }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    log_info("Router2 lookahead has %d of %d entries, computed in %.02fs.\n", known, int(classes.size()) * size,
+             std::chrono::duration<float>(end - start).count());
+}
+
+bool Router2Lookahead::load(const std::string &file)
+{
+    std::ifstream in(file, std::ios::binary);
+    if (!in)
+        return false;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    LookaheadReader rd(data);
+    if (data.size() < sizeof(lookahead_magic) || memcmp(data.data(), lookahead_magic, sizeof(lookahead_magic)) != 0) {
+        log_warning("'%s' is not a router2 lookahead file, recomputing it.\n", file.c_str());
+        return false;
+    }
+    rd.pos = sizeof(lookahead_magic);
+    std::string ident = rd.get_str();
+    int file_radius = rd.get<int32_t>(), file_samples = rd.get<int32_t>();
+    if (!rd.ok || ident != chipdb_identity(ctx) || file_radius != radius || file_samples != samples) {
+        log_info("Router2 lookahead in '%s' is for another chip database or settings, recomputing it.\n",
+                 file.c_str());
+        return false;
+    }
+    int size = (2 * radius + 1) * (2 * radius + 1);
+    uint32_t num_classes = rd.get<uint32_t>();
+    for (uint32_t i = 0; rd.ok && i < num_classes; i++) {
+        IdString type = ctx->id(rd.get_str());
+        class_index[type] = int(classes.size());
+        classes.push_back(type);
+        rate.push_back(rd.get<float>());
+        table.emplace_back(size);
+        for (int j = 0; j < size; j++)
+            table.back()[j] = rd.get<float>();
+    }
+    if (!rd.ok || rd.pos != data.size()) {
+        log_warning("Router2 lookahead file '%s' is truncated, recomputing it.\n", file.c_str());
+        classes.clear();
+        class_index.clear();
+        rate.clear();
+        table.clear();
+        return false;
+    }
+    return true;
+}
+
+void Router2Lookahead::save(const std::string &file) const
+{
+    std::string out(lookahead_magic, sizeof(lookahead_magic));
+    put_str(out, chipdb_identity(ctx));
+    put<int32_t>(out, radius);
+    put<int32_t>(out, samples);
+    put<uint32_t>(out, classes.size());
+    for (size_t cls = 0; cls < classes.size(); cls++) {
+        put_str(out, classes[cls].str(ctx));
+        put<float>(out, rate[cls]);
+        for (float entry : table[cls])
+            put<float>(out, entry);
+    }
+    std::ofstream f(file, std::ios::binary);
+    if (f)
+        f.write(out.data(), out.size());
+    if (!f)
+        log_warning("Failed to write router2 lookahead file '%s'.\n", file.c_str());
+    else
+        log_info("Wrote router2 lookahead to '%s'.\n", file.c_str());
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,60 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ROUTER2_LOOKAHEAD_H
+#define ROUTER2_LOOKAHEAD_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Map based lookahead for the router2 A* estimate: the minimum delay from a wire of each class (getWireType) to a
+// sink pin wire at each (dx, dy) offset within a radius, found by Dijkstra searches from a sample of wires of each
+// class. Further offsets are extrapolated from the edge of the table at the best delay per tile seen for the class.
+// Computing the table takes a while, so it is cached in a file that is only valid for the same chip database.
+struct Router2Lookahead
+{
+    // Load the table from file, or compute it and then write it to file if that is missing or out of date
+    void init(Context *ctx, const std::string &file, int radius, int samples, int threads);
+
+    // Class index of a wire, -1 for wires of a type the table has nothing for
+    int wire_class(WireId wire) const;
+    // Estimated delay in ns, or a negative value if there is no estimate for this class and offset
+    float estimate(int cls, int dx, int dy) const;
+
+  private:
+    Context *ctx = nullptr;
+    int radius = 0, samples = 0;
+    std::vector<IdString> classes;
+    std::unordered_map<IdString, int> class_index;
+    // Per class, (2 * radius + 1)^2 delays indexed by offset; negative where no sink was reached
+    std::vector<std::vector<float>> table;
+    // Per class, the lowest delay per tile of Manhattan distance at the edge of the table
+    std::vector<float> rate;
+
+    int offset_index(int dx, int dy) const { return (dy + radius) * (2 * radius + 1) + (dx + radius); }
+    void compute(int threads);
+    bool load(const std::string &file);
+    void save(const std::string &file) const;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "router2_wavefront.h"
+#include <algorithm>
+#include <limits>
+#include "opencl_device.h"
+#include "thread_pool.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+void WavefrontGraph::clear()
+{
+    problem_begin.assign(1, 0);
+    problem_source.clear();
+    in_begin.assign(1, 0);
+    in_src.clear();
+    in_cost.clear();
+    dist.clear();
+    pred.clear();
+    rounds = 0;
+}
+
+namespace {
+
+const float unreached = std::numeric_limits<float>::infinity();
+
+void init_results(WavefrontGraph &g)
+{
+    g.dist.assign(g.vertex_count(), unreached);
+    g.pred.assign(g.vertex_count(), -1);
+    for (int s : g.problem_source)
+        g.dist.at(s) = 0;
+    g.rounds = 0;
+}
+
+// One round for vertex v, the same as the relax kernel below. Returns whether its distance fell.
+inline bool relax(const WavefrontGraph &g, const float *dist_in, float *dist_out, int *pred, int v)
+{
+    float best = dist_in[v];
+    int best_edge = -1;
+    for (int e = g.in_begin[v]; e < g.in_begin[v + 1]; e++) {
+        float d = dist_in[g.in_src[e]] + g.in_cost[e];
+        if (d < best) {
+            best = d;
+            best_edge = e;
+        }
+    }
+    dist_out[v] = best;
+    if (best_edge < 0)
+        return false;
+    pred[v] = best_edge;
+    return true;
+}
+
+// Problems are independent, so each is run to convergence on its own, several in parallel
+struct CpuWavefront : WavefrontBackend
+{
+    Context *ctx;
+    explicit CpuWavefront(Context *ctx) : ctx(ctx) {}
+
+    std::string name() const override { return "CPU"; }
+
+    bool solve(WavefrontGraph &g) override
+    {
+        init_results(g);
+        std::vector<float> next(g.dist);
+        std::vector<int> rounds(g.problem_count(), 0);
+        auto solve_problem = [&](size_t p) {
+            int begin = g.problem_begin[p], end = g.problem_begin[p + 1];
+            bool changed = true;
+            while (changed && rounds[p] <= end - begin) {
+                changed = false;
+                for (int v = begin; v < end; v++)
+                    changed |= relax(g, g.dist.data(), next.data(), g.pred.data(), v);
+                std::copy(next.begin() + begin, next.begin() + end, g.dist.begin() + begin);
+                ++rounds[p];
+            }
+        };
+        if (ctx != nullptr)
+            ctx->threadPool().parallel_for(g.problem_count(), 16, solve_problem);
+        else
+            for (int p = 0; p < g.problem_count(); p++)
+                solve_problem(p);
+        for (int r : rounds)
+            g.rounds = std::max(g.rounds, r);
+        return true;
+    }
+};
+
+#ifdef WITH_OPENCL
+
+// One work item per vertex; the host swaps dist_in and dist_out between rounds
+const char *wavefront_kernels = R"(
+__kernel void relax(int n, __global const int *in_begin, __global const int *in_src, __global const float *in_cost,
+                    __global const float *dist_in, __global float *dist_out, __global int *pred,
+                    __global int *changed)
+{
+    int v = get_global_id(0);
+    if (v >= n)
+        return;
+    float best = dist_in[v];
+    int best_edge = -1;
+    for (int e = in_begin[v]; e < in_begin[v + 1]; e++) {
+        float d = dist_in[in_src[e]] + in_cost[e];
+        if (d < best) {
+            best = d;
+            best_edge = e;
+        }
+    }
+    dist_out[v] = best;
+    if (best_edge >= 0) {
+        pred[v] = best_edge;
+        *changed = 1;
+    }
+}
+)";
+
+// All problems are solved together, one round per kernel run, until no distance falls any more
+struct OpenCLWavefront : WavefrontBackend
+{
+    const OpenCLDevice &dev = opencl_device();
+    cl_program program = nullptr;
+    cl_command_queue queue = nullptr;
+    cl_kernel kernel = nullptr;
+    bool failed = false;
+    // Buffers of the current solve
+    std::vector<cl_mem> buffers;
+
+    explicit OpenCLWavefront(std::string &error)
+    {
+        program = dev.build(wavefront_kernels, error);
+        if (program == nullptr) {
+            failed = true;
+            return;
+        }
+        cl_int err;
+        queue = clCreateCommandQueue(dev.context, dev.device, 0, &err);
+        failed |= (err != CL_SUCCESS);
+        kernel = clCreateKernel(program, "relax", &err);
+        failed |= (err != CL_SUCCESS);
+        if (failed)
+            error = "failed to set up the OpenCL wavefront kernel";
+    }
+
+    ~OpenCLWavefront()
+    {
+        release();
+        if (kernel != nullptr)
+            clReleaseKernel(kernel);
+        if (queue != nullptr)
+            clReleaseCommandQueue(queue);
+        if (program != nullptr)
+            clReleaseProgram(program);
+    }
+
+    std::string name() const override { return dev.name; }
+
+    void release()
+    {
+        for (cl_mem mem : buffers)
+            if (mem != nullptr)
+                clReleaseMemObject(mem);
+        buffers.clear();
+    }
+
+    template <typename T> cl_mem alloc(const std::vector<T> &data)
+    {
+        cl_int err;
+        size_t bytes = data.size() * sizeof(T);
+        cl_mem mem = clCreateBuffer(dev.context, CL_MEM_READ_WRITE | (bytes > 0 ? CL_MEM_COPY_HOST_PTR : 0),
+                                    std::max<size_t>(bytes, sizeof(T)),
+                                    bytes > 0 ? const_cast<T *>(data.data()) : nullptr, &err);
+        failed |= (err != CL_SUCCESS);
+        buffers.push_back(mem);
+        return mem;
+    }
+
+    template <typename T> void arg(cl_uint idx, const T &value)
+    {
+        failed |= (clSetKernelArg(kernel, idx, sizeof(T), &value) != CL_SUCCESS);
+    }
+
+    bool solve(WavefrontGraph &g) override
+    {
+        if (failed)
+            return false;
+        init_results(g);
+        int n = g.vertex_count();
+        if (n == 0)
+            return true;
+        cl_mem dist[2] = {alloc(g.dist), alloc(g.dist)};
+        cl_mem pred = alloc(g.pred);
+        std::vector<int> flag(1, 0);
+        cl_mem changed = alloc(flag);
+        arg(0, n);
+        arg(1, alloc(g.in_begin));
+        arg(2, alloc(g.in_src));
+        arg(3, alloc(g.in_cost));
+        arg(6, pred);
+        arg(7, changed);
+        size_t global = size_t(n);
+        int cur = 0;
+        // As on the CPU, at most one round per vertex even if the costs were to fail to converge
+        for (flag[0] = 1; flag[0] != 0 && g.rounds <= n && !failed; g.rounds++) {
+            flag[0] = 0;
+            failed |= (clEnqueueWriteBuffer(queue, changed, CL_FALSE, 0, sizeof(int), flag.data(), 0, nullptr,
+                                            nullptr) != CL_SUCCESS);
+            arg(4, dist[cur]);
+            arg(5, dist[cur ^ 1]);
+            if (!failed)
+                failed |= (clEnqueueNDRangeKernel(queue, kernel, 1, nullptr, &global, nullptr, 0, nullptr, nullptr) !=
+                           CL_SUCCESS);
+            if (!failed)
+                failed |= (clEnqueueReadBuffer(queue, changed, CL_TRUE, 0, sizeof(int), flag.data(), 0, nullptr,
+                                               nullptr) != CL_SUCCESS);
+            cur ^= 1;
+        }
+        if (!failed)
+            failed |= (clEnqueueReadBuffer(queue, dist[cur], CL_FALSE, 0, n * sizeof(float), g.dist.data(), 0, nullptr,
+                                           nullptr) != CL_SUCCESS);
+        if (!failed)
+            failed |= (clEnqueueReadBuffer(queue, pred, CL_TRUE, 0, n * sizeof(int), g.pred.data(), 0, nullptr,
+                                           nullptr) != CL_SUCCESS);
+        release();
+        return !failed;
+    }
+};
+
+#endif
+
+} // namespace
+
+std::unique_ptr<WavefrontBackend> WavefrontBackend::create(Context *ctx, bool gpu, std::string &error)
+{
+    if (!gpu)
+        return std::unique_ptr<WavefrontBackend>(new CpuWavefront(ctx));
+#ifdef WITH_OPENCL
+    std::unique_ptr<OpenCLWavefront> backend(new OpenCLWavefront(error));
+    if (backend->failed)
+        return nullptr;
+    return std::move(backend);
+#else
+    error = "nextpnr was built without BUILD_OPENCL";
+    return nullptr;
+#endif
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,87 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ROUTER2_WAVEFRONT_H
+#define ROUTER2_WAVEFRONT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// A batch of single source shortest path problems for the wavefront mode of router2 (router2/wavefront), each the
+// routing graph in the bounding box of one short net. They are solved by synchronous Bellman-Ford rounds: every round,
+// each vertex takes the lowest of its own distance and those of its fan-in plus the edge cost, all from the distances
+// of the previous round. That is one independent work item per vertex, which suits a GPU; the CPU backend runs the
+// same rounds, so both find the same routes.
+struct WavefrontGraph
+{
+    // Problem p has the vertices problem_begin[p] up to problem_begin[p + 1], and its source at problem_source[p]
+    std::vector<int> problem_begin{0}, problem_source;
+    // The fan-in of vertex v is edges in_begin[v] up to in_begin[v + 1], edge e coming from in_src[e] at in_cost[e]
+    std::vector<int> in_begin{0}, in_src;
+    std::vector<float> in_cost;
+
+    // Results: the distance of each vertex from its source (infinity if not reached), the edge it was reached
+    // through (-1 for the sources and unreached vertices), and the number of rounds to converge
+    std::vector<float> dist;
+    std::vector<int> pred;
+    int rounds = 0;
+
+    int vertex_count() const { return int(in_begin.size()) - 1; }
+    int problem_count() const { return int(problem_source.size()); }
+
+    // Add the fan-in of the next vertex, then close it with end_vertex, which returns its number
+    void add_edge(int src, float cost)
+    {
+        in_src.push_back(src);
+        in_cost.push_back(cost);
+    }
+    int end_vertex()
+    {
+        in_begin.push_back(int(in_src.size()));
+        return vertex_count() - 1;
+    }
+    // Close a problem made of the vertices added since the last one
+    void end_problem(int source)
+    {
+        problem_source.push_back(source);
+        problem_begin.push_back(vertex_count());
+    }
+
+    void clear();
+};
+
+class WavefrontBackend
+{
+  public:
+    virtual ~WavefrontBackend() {}
+    virtual std::string name() const = 0;
+    // Solve all problems of g, filling in its results. Returns false if the device failed, after which the CPU
+    // backend should be used instead.
+    virtual bool solve(WavefrontGraph &g) = 0;
+
+    // The CPU backend, which runs on the thread pool of ctx (or on the calling thread if ctx is null), or the OpenCL
+    // one; that is null if there is no device, with the reason in error
+    static std::unique_ptr<WavefrontBackend> create(Context *ctx, bool gpu, std::string &error);
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
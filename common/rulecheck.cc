@@ -1,64 +1,109 @@
 #include <assert.h>
+#include <atomic>
 #include <string>
+#include <thread>
 #include "log.h"
 #include "nextpnr.h"
+#include "thread_pool.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
-bool check_all_nets_driven(Context *ctx)
+namespace {
+bool check_cell(Context *ctx, CellInfo *cell, bool debug)
 {
-    const bool debug = false;
-
-    log_info("Rule checker, verifying imported design\n");
-
-    for (auto &cell_entry : ctx->cells) {
-        CellInfo *cell = cell_entry.second.get();
+    if (debug)
+        log_info("  Examining cell \'%s\', of type \'%s\'\n", cell->name.c_str(ctx), cell->type.c_str(ctx));
+    for (auto &port_entry : cell->ports) {
+        PortInfo &port = port_entry.second;
 
         if (debug)
-            log_info("  Examining cell \'%s\', of type \'%s\'\n", cell->name.c_str(ctx), cell->type.c_str(ctx));
-        for (auto port_entry : cell->ports) {
-            PortInfo &port = port_entry.second;
+            log_info("    Checking name of port \'%s\' "
+                     "against \'%s\'\n",
+                     port_entry.first.c_str(ctx), port.name.c_str(ctx));
+        NPNR_ASSERT(port.name == port_entry.first);
+        NPNR_ASSERT(!port.name.empty());
 
+        if (port.net == NULL) {
             if (debug)
-                log_info("    Checking name of port \'%s\' "
-                         "against \'%s\'\n",
-                         port_entry.first.c_str(ctx), port.name.c_str(ctx));
-            NPNR_ASSERT(port.name == port_entry.first);
-            NPNR_ASSERT(!port.name.empty());
-
-            if (port.net == NULL) {
-                if (debug)
-                    log_warning("    Port \'%s\' in cell \'%s\' is unconnected\n", port.name.c_str(ctx),
-                                cell->name.c_str(ctx));
-            } else {
-                NPNR_ASSERT(port.net);
-                if (debug)
-                    log_info("    Checking for a net named \'%s\'\n", port.net->name.c_str(ctx));
-                NPNR_ASSERT(ctx->nets.count(port.net->name) > 0);
-            }
+                log_warning("    Port \'%s\' in cell \'%s\' is unconnected\n", port.name.c_str(ctx),
+                            cell->name.c_str(ctx));
+        } else {
+            NPNR_ASSERT(port.net);
+            if (debug)
+                log_info("    Checking for a net named \'%s\'\n", port.net->name.c_str(ctx));
+            NPNR_ASSERT(ctx->nets.count(port.net->name) > 0);
         }
     }
+    return true;
+}
 
-    for (auto &net_entry : ctx->nets) {
-        NetInfo *net = net_entry.second.get();
+bool check_net(Context *ctx, IdString name, NetInfo *net, bool debug)
+{
+    const IdString gnd = ctx->id("GND"), vcc = ctx->id("VCC");
+    NPNR_ASSERT(net->name == name);
+    if ((net->driver.cell != NULL) && (net->driver.cell->type != gnd) && (net->driver.cell->type != vcc)) {
+
+        if (debug)
+            log_info("    Checking for a driver cell named \'%s\'\n", net->driver.cell->name.c_str(ctx));
+        NPNR_ASSERT(ctx->cells.count(net->driver.cell->name) > 0);
+    }
 
-        NPNR_ASSERT(net->name == net_entry.first);
-        if ((net->driver.cell != NULL) && (net->driver.cell->type != ctx->id("GND")) &&
-            (net->driver.cell->type != ctx->id("VCC"))) {
+    for (auto &user : net->users) {
+        if ((user.cell != NULL) && (user.cell->type != gnd) && (user.cell->type != vcc)) {
 
             if (debug)
-                log_info("    Checking for a driver cell named \'%s\'\n", net->driver.cell->name.c_str(ctx));
-            NPNR_ASSERT(ctx->cells.count(net->driver.cell->name) > 0);
+                log_info("    Checking for a user   cell named \'%s\'\n", user.cell->name.c_str(ctx));
+            NPNR_ASSERT(ctx->cells.count(user.cell->name) > 0);
         }
+    }
+    return true;
+}
+} // namespace
 
-        for (auto user : net->users) {
-            if ((user.cell != NULL) && (user.cell->type != ctx->id("GND")) && (user.cell->type != ctx->id("VCC"))) {
+bool check_all_nets_driven(Context *ctx)
+{
+    const bool debug = false;
 
-                if (debug)
-                    log_info("    Checking for a user   cell named \'%s\'\n", user.cell->name.c_str(ctx));
-                NPNR_ASSERT(ctx->cells.count(user.cell->name) > 0);
-            }
-        }
+    log_info("Rule checker, verifying imported design\n");
+
+    std::vector<CellInfo *> cell_list;
+    for (auto &cell_entry : ctx->cells)
+        cell_list.push_back(cell_entry.second.get());
+    std::vector<std::pair<IdString, NetInfo *>> net_list;
+    for (auto &net_entry : ctx->nets)
+        net_list.emplace_back(net_entry.first, net_entry.second.get());
+
+    // The cells and nets are checked independently of each other, so in parallel unless debugging. A failed
+    // assertion can't leave a worker thread, so the checks are run again serially to report the first failure
+    int threads = std::max(1, ctx->setting<int>("threads", std::max<int>(1, std::thread::hardware_concurrency())));
+    if (debug)
+        threads = 1;
+    size_t total = cell_list.size() + net_list.size();
+    threads = std::min<int>(threads, std::max<size_t>(1, total / 4096));
+    std::atomic<bool> failed(false);
+    if (threads > 1) {
+        ctx->threadPool().parallel_for(
+                total, 1,
+                [&](size_t i) {
+                    if (failed)
+                        return;
+                    try {
+                        if (i < cell_list.size())
+                            check_cell(ctx, cell_list.at(i), debug);
+                        else
+                            check_net(ctx, net_list.at(i - cell_list.size()).first,
+                                      net_list.at(i - cell_list.size()).second, debug);
+                    } catch (const assertion_failure &) {
+                        failed = true;
+                    }
+                },
+                threads);
+    }
+    if (threads <= 1 || failed) {
+        for (auto cell : cell_list)
+            check_cell(ctx, cell, debug);
+        for (auto &net : net_list)
+            check_net(ctx, net.first, net.second, debug);
     }
 
     if (debug)
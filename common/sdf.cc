@@ -17,7 +17,10 @@
  *
  */
 
+#include <algorithm>
+#include <thread>
 #include "nextpnr.h"
+#include "thread_pool.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -36,13 +39,13 @@ struct RiseFallDelay
 
 struct PortAndEdge
 {
-    std::string port;
+    IdString port;
     ClockEdge edge;
 };
 
 struct IOPath
 {
-    std::string from, to;
+    IdString from, to;
     RiseFallDelay delay;
 };
 
@@ -60,14 +63,14 @@ struct TimingCheck
 
 struct Cell
 {
-    std::string celltype, instance;
+    IdString celltype, instance;
     std::vector<IOPath> iopaths;
     std::vector<TimingCheck> checks;
 };
 
 struct CellPort
 {
-    std::string cell, port;
+    IdString cell, port;
 };
 
 struct Interconnect
@@ -76,37 +79,39 @@ struct Interconnect
     RiseFallDelay delay;
 };
 
+// The file is formatted straight into string buffers, which are written out as they fill up rather than building up
+// the whole design first
 struct SDFWriter
 {
+    const Context *ctx;
     bool cvc_mode = false;
-    std::vector<Cell> cells;
-    std::vector<Interconnect> conn;
     std::string sdfversion, design, vendor, program;
 
-    std::string format_name(const std::string &name)
+    SDFWriter(const Context *ctx) : ctx(ctx) {}
+
+    void append_name(std::string &buf, const std::string &name) const
     {
-        std::string fmt = "\"";
+        buf += '"';
         for (char c : name) {
             if (c == '\\' || c == '\"')
-                fmt += "\"";
-            fmt += c;
+                buf += '"';
+            buf += c;
         }
-        fmt += "\"";
-        return fmt;
+        buf += '"';
     }
 
-    std::string escape_name(const std::string &name)
+    void append_escaped(std::string &buf, const std::string &name) const
     {
-        std::string esc;
         for (char c : name) {
             if (c == '$' || c == '\\' || c == '[' || c == ']' || c == ':' || (cvc_mode && c == '.'))
-                esc += '\\';
-            esc += c;
+                buf += '\\';
+            buf += c;
         }
-        return esc;
     }
 
-    std::string timing_check_name(TimingCheck::CheckType type)
+    void append_escaped(std::string &buf, IdString name) const { append_escaped(buf, name.str(ctx)); }
+
+    const char *timing_check_name(TimingCheck::CheckType type) const
     {
         switch (type) {
         case TimingCheck::SETUPHOLD:
@@ -120,102 +125,123 @@ struct SDFWriter
         }
     }
 
-    void write_delay(std::ostream &out, const RiseFallDelay &delay)
+    void append_delay(std::string &buf, const RiseFallDelay &delay) const
     {
-        write_delay(out, delay.rise);
-        out << " ";
-        write_delay(out, delay.fall);
+        append_delay(buf, delay.rise);
+        buf += ' ';
+        append_delay(buf, delay.fall);
     }
 
-    void write_delay(std::ostream &out, const MinMaxTyp &delay)
+    // %g is the default formatting of a double written to a stream
+    void append_delay(std::string &buf, const MinMaxTyp &delay) const
     {
+        char tmp[80];
         if (cvc_mode)
-            out << "(" << int(delay.min) << ":" << int(delay.typ) << ":" << int(delay.max) << ")";
+            snprintf(tmp, sizeof(tmp), "(%d:%d:%d)", int(delay.min), int(delay.typ), int(delay.max));
         else
-            out << "(" << delay.min << ":" << delay.typ << ":" << delay.max << ")";
+            snprintf(tmp, sizeof(tmp), "(%g:%g:%g)", delay.min, delay.typ, delay.max);
+        buf += tmp;
     }
 
-    void write_port(std::ostream &out, const CellPort &port)
+    // Escaping never applies to the divider, so the two halves can be escaped separately
+    void append_port(std::string &buf, const CellPort &port) const
     {
-        if (cvc_mode)
-            out << escape_name(port.cell) + "." + escape_name(port.port);
-        else
-            out << escape_name(port.cell + "/" + port.port);
+        append_escaped(buf, port.cell);
+        buf += (cvc_mode ? '.' : '/');
+        append_escaped(buf, port.port);
     }
 
-    void write_portedge(std::ostream &out, const PortAndEdge &pe)
+    void append_portedge(std::string &buf, const PortAndEdge &pe) const
     {
-        out << "(" << (pe.edge == RISING_EDGE ? "posedge" : "negedge") << " " << escape_name(pe.port) << ")";
+        buf += '(';
+        buf += (pe.edge == RISING_EDGE ? "posedge" : "negedge");
+        buf += ' ';
+        append_escaped(buf, pe.port);
+        buf += ')';
     }
 
-    void write(std::ostream &out)
+    void write_header(std::ostream &out) const
     {
-        out << "(DELAYFILE" << std::endl;
+        std::string buf;
+        buf += "(DELAYFILE\n";
         // Headers and  metadata
-        out << "  (SDFVERSION " << format_name(sdfversion) << ")" << std::endl;
-        out << "  (DESIGN " << format_name(design) << ")" << std::endl;
-        out << "  (VENDOR " << format_name(vendor) << ")" << std::endl;
-        out << "  (PROGRAM " << format_name(program) << ")" << std::endl;
-        out << "  (DIVIDER " << (cvc_mode ? "." : "/") << ")" << std::endl;
-        out << "  (TIMESCALE 1ps)" << std::endl;
-        // Write interconnect delays, with the main design begin a "cell"
-        out << "  (CELL" << std::endl;
-        out << "    (CELLTYPE " << format_name(design) << ")" << std::endl;
-        out << "    (INSTANCE )" << std::endl;
-        out << "    (DELAY" << std::endl;
-        out << "      (ABSOLUTE" << std::endl;
-        for (auto &ic : conn) {
-            out << "        (INTERCONNECT ";
-            write_port(out, ic.from);
-            out << " ";
-            write_port(out, ic.to);
-            out << " ";
-            write_delay(out, ic.delay);
-            out << ")" << std::endl;
-        }
-        out << "      )" << std::endl;
-        out << "    )" << std::endl;
-        out << "  )" << std::endl;
-        // Write cells
-        for (auto &cell : cells) {
-            out << "  (CELL" << std::endl;
-            out << "    (CELLTYPE " << format_name(cell.celltype) << ")" << std::endl;
-            out << "    (INSTANCE " << escape_name(cell.instance) << ")" << std::endl;
-            // IOPATHs (combinational delay and clock-to-q)
-            if (!cell.iopaths.empty()) {
-                out << "    (DELAY" << std::endl;
-                out << "      (ABSOLUTE" << std::endl;
-                for (auto &path : cell.iopaths) {
-                    out << "        (IOPATH " << escape_name(path.from) << " " << escape_name(path.to) << " ";
-                    write_delay(out, path.delay);
-                    out << ")" << std::endl;
-                }
-                out << "      )" << std::endl;
-                out << "    )" << std::endl;
+        buf += "  (SDFVERSION ";
+        append_name(buf, sdfversion);
+        buf += ")\n  (DESIGN ";
+        append_name(buf, design);
+        buf += ")\n  (VENDOR ";
+        append_name(buf, vendor);
+        buf += ")\n  (PROGRAM ";
+        append_name(buf, program);
+        buf += ")\n  (DIVIDER ";
+        buf += (cvc_mode ? "." : "/");
+        buf += ")\n  (TIMESCALE 1ps)\n";
+        // Interconnect delays follow, with the main design being a "cell"
+        buf += "  (CELL\n    (CELLTYPE ";
+        append_name(buf, design);
+        buf += ")\n    (INSTANCE )\n    (DELAY\n      (ABSOLUTE\n";
+        out << buf;
+    }
+
+    void append_interconnect(std::string &buf, const Interconnect &ic) const
+    {
+        buf += "        (INTERCONNECT ";
+        append_port(buf, ic.from);
+        buf += ' ';
+        append_port(buf, ic.to);
+        buf += ' ';
+        append_delay(buf, ic.delay);
+        buf += ")\n";
+    }
+
+    void write_interconnect_end(std::ostream &out) const { out << "      )\n    )\n  )\n"; }
+
+    void append_cell(std::string &buf, const Cell &cell) const
+    {
+        buf += "  (CELL\n    (CELLTYPE ";
+        append_name(buf, cell.celltype.str(ctx));
+        buf += ")\n    (INSTANCE ";
+        append_escaped(buf, cell.instance);
+        buf += ")\n";
+        // IOPATHs (combinational delay and clock-to-q)
+        if (!cell.iopaths.empty()) {
+            buf += "    (DELAY\n      (ABSOLUTE\n";
+            for (auto &path : cell.iopaths) {
+                buf += "        (IOPATH ";
+                append_escaped(buf, path.from);
+                buf += ' ';
+                append_escaped(buf, path.to);
+                buf += ' ';
+                append_delay(buf, path.delay);
+                buf += ")\n";
             }
-            // Timing Checks (setup/hold, period, width)
-            if (!cell.checks.empty()) {
-                out << "    (TIMINGCHECK" << std::endl;
-                for (auto &check : cell.checks) {
-                    out << "      (" << timing_check_name(check.type) << " ";
-                    write_portedge(out, check.from);
-                    out << " ";
-                    if (check.type == TimingCheck::SETUPHOLD) {
-                        write_portedge(out, check.to);
-                        out << " ";
-                    }
-                    if (check.type == TimingCheck::SETUPHOLD)
-                        write_delay(out, check.delay);
-                    else
-                        write_delay(out, check.delay.rise);
-                    out << ")" << std::endl;
+            buf += "      )\n    )\n";
+        }
+        // Timing Checks (setup/hold, period, width)
+        if (!cell.checks.empty()) {
+            buf += "    (TIMINGCHECK\n";
+            for (auto &check : cell.checks) {
+                buf += "      (";
+                buf += timing_check_name(check.type);
+                buf += ' ';
+                append_portedge(buf, check.from);
+                buf += ' ';
+                if (check.type == TimingCheck::SETUPHOLD) {
+                    append_portedge(buf, check.to);
+                    buf += ' ';
                 }
-                out << "    )" << std::endl;
+                if (check.type == TimingCheck::SETUPHOLD)
+                    append_delay(buf, check.delay);
+                else
+                    append_delay(buf, check.delay.rise);
+                buf += ")\n";
             }
-            out << "    )" << std::endl;
+            buf += "    )\n";
         }
-        out << ")" << std::endl;
+        buf += "    )\n";
     }
+
+    void write_footer(std::ostream &out) const { out << ")\n"; }
 };
 
 } // namespace SDF
@@ -223,7 +249,7 @@ struct SDFWriter
 void Context::writeSDF(std::ostream &out, bool cvc_mode) const
 {
     using namespace SDF;
-    SDFWriter wr;
+    SDFWriter wr(this);
     wr.cvc_mode = cvc_mode;
     wr.design = str_or_default(attrs, id("module"), "top");
     wr.sdfversion = "3.0";
@@ -254,11 +280,51 @@ void Context::writeSDF(std::ostream &out, bool cvc_mode) const
         return rf;
     };
 
+    wr.write_header(out);
+
+    // Interconnect delays are computed by worker threads, a batch of chunks of nets at a time; the lines of each
+    // chunk go into a buffer of its own, and the buffers are written out in order once the batch is done
+    auto net_list = sorted(nets);
+    int threads = std::max(1, settings.count(id("threads")) ? setting<int>("threads")
+                                                            : std::max<int>(1, std::thread::hardware_concurrency()));
+    const int chunk_nets = 256;
+    std::vector<std::string> chunk_bufs(threads * 4);
+    auto write_nets = [&](int chunk_begin, std::string &buf) {
+        buf.clear();
+        int end = std::min<int>(int(net_list.size()), chunk_begin + chunk_nets);
+        for (int i = chunk_begin; i < end; i++) {
+            const NetInfo *ni = net_list.at(i).second;
+            if (ni->driver.cell == nullptr)
+                continue;
+            for (auto &usr : ni->users) {
+                Interconnect ic;
+                ic.from.cell = ni->driver.cell->name;
+                ic.from.port = ni->driver.port;
+                ic.to.cell = usr.cell->name;
+                ic.to.port = usr.port;
+                // FIXME: min/max routing delay - or at least constructing DelayInfo here
+                ic.delay = convert_delay(getDelayFromNS(getDelayNS(getNetinfoRouteDelay(ni, usr))));
+                wr.append_interconnect(buf, ic);
+            }
+        }
+    };
+    for (int batch = 0; batch < int(net_list.size()); batch += chunk_nets * int(chunk_bufs.size())) {
+        int batch_chunks = std::min<int>(int(chunk_bufs.size()),
+                                         (int(net_list.size()) - batch + chunk_nets - 1) / chunk_nets);
+        threadPool().parallel_for(
+                batch_chunks, 1, [&](size_t c) { write_nets(batch + int(c) * chunk_nets, chunk_bufs.at(c)); }, threads);
+        for (int c = 0; c < batch_chunks; c++)
+            out << chunk_bufs.at(c);
+    }
+    wr.write_interconnect_end(out);
+
+    // Cells are written one at a time as they are converted, through a single buffer
+    std::string buf;
     for (auto cell : sorted(cells)) {
         Cell sc;
         const CellInfo *ci = cell.second;
-        sc.instance = ci->name.str(this);
-        sc.celltype = ci->type.str(this);
+        sc.instance = ci->name;
+        sc.celltype = ci->type;
         for (auto port : ci->ports) {
             int clockCount = 0;
             TimingPortClass cls = getPortTimingClass(ci, port.first, clockCount);
@@ -277,8 +343,8 @@ void Context::writeSDF(std::ostream &out, bool cvc_mode) const
                     if (!getCellDelay(ci, other.first, port.first, dly))
                         continue;
                     IOPath iop;
-                    iop.from = other.first.str(this);
-                    iop.to = port.first.str(this);
+                    iop.from = other.first;
+                    iop.to = port.first;
                     iop.delay = convert_delay(dly);
                     sc.iopaths.push_back(iop);
                 }
@@ -287,8 +353,8 @@ void Context::writeSDF(std::ostream &out, bool cvc_mode) const
                     for (int i = 0; i < clockCount; i++) {
                         auto clkInfo = getPortClockingInfo(ci, port.first, i);
                         IOPath cqp;
-                        cqp.from = clkInfo.clock_port.str(this);
-                        cqp.to = port.first.str(this);
+                        cqp.from = clkInfo.clock_port;
+                        cqp.to = port.first;
                         cqp.delay = convert_delay(clkInfo.clockToQ);
                         sc.iopaths.push_back(cqp);
                     }
@@ -299,9 +365,9 @@ void Context::writeSDF(std::ostream &out, bool cvc_mode) const
                     auto clkInfo = getPortClockingInfo(ci, port.first, i);
                     TimingCheck chk;
                     chk.from.edge = RISING_EDGE; // Add setup/hold checks equally for rising and falling edges
-                    chk.from.port = port.first.str(this);
+                    chk.from.port = port.first;
                     chk.to.edge = clkInfo.edge;
-                    chk.to.port = clkInfo.clock_port.str(this);
+                    chk.to.port = clkInfo.clock_port;
                     chk.type = TimingCheck::SETUPHOLD;
                     chk.delay = convert_setuphold(clkInfo.setup, clkInfo.hold);
                     sc.checks.push_back(chk);
@@ -310,25 +376,11 @@ void Context::writeSDF(std::ostream &out, bool cvc_mode) const
                 }
             }
         }
-        wr.cells.push_back(sc);
-    }
-
-    for (auto net : sorted(nets)) {
-        NetInfo *ni = net.second;
-        if (ni->driver.cell == nullptr)
-            continue;
-        for (auto &usr : ni->users) {
-            Interconnect ic;
-            ic.from.cell = ni->driver.cell->name.str(this);
-            ic.from.port = ni->driver.port.str(this);
-            ic.to.cell = usr.cell->name.str(this);
-            ic.to.port = usr.port.str(this);
-            // FIXME: min/max routing delay - or at least constructing DelayInfo here
-            ic.delay = convert_delay(getDelayFromNS(getDelayNS(getNetinfoRouteDelay(ni, usr))));
-            wr.conn.push_back(ic);
-        }
+        buf.clear();
+        wr.append_cell(buf, sc);
+        out << buf;
     }
-    wr.write(out);
+    wr.write_footer(out);
 }
 
-NEXTPNR_NAMESPACE_END
\ No newline at end of file
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,333 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef SMALL_DICT_H
+#define SMALL_DICT_H
+
+// A flat map for the small per-cell maps (ports, attributes, parameters), with the subset of the std::unordered_map
+// interface that is used for them. The first N entries are stored inline in the object, further ones in fixed size
+// blocks that never move; so, as with std::unordered_map, references to entries stay valid when others are added or
+// removed. Lookups are a linear scan, until the map grows beyond index_threshold entries and a hash index is added.
+// Iteration is in slot order; the slot of an erased entry is reused by the next insertion.
+template <typename K, typename V, int N = 8> class small_dict
+{
+  public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<const K, V> value_type;
+
+  private:
+    static const int block_size = 8;
+    static const int index_threshold = 16;
+
+    struct slot_t
+    {
+        alignas(value_type) unsigned char data[sizeof(value_type)];
+        bool live = false;
+        value_type &value() { return *reinterpret_cast<value_type *>(data); }
+        const value_type &value() const { return *reinterpret_cast<const value_type *>(data); }
+    };
+
+    slot_t inline_slots[N];
+    std::vector<std::unique_ptr<slot_t[]>> blocks;
+    // Slots that have been used at least once, and the number of those that are currently live
+    int used = 0, live = 0;
+    std::unique_ptr<std::unordered_map<K, int>> index;
+
+    slot_t &slot(int i) { return (i < N) ? inline_slots[i] : blocks[(i - N) / block_size][(i - N) % block_size]; }
+    const slot_t &slot(int i) const
+    {
+        return (i < N) ? inline_slots[i] : blocks[(i - N) / block_size][(i - N) % block_size];
+    }
+
+    int next_live(int i) const
+    {
+        while (i < used && !slot(i).live)
+            i++;
+        return i;
+    }
+
+    int find_slot(const K &key) const
+    {
+        if (index) {
+            auto fnd = index->find(key);
+            return (fnd == index->end()) ? -1 : fnd->second;
+        }
+        for (int i = 0; i < used; i++)
+            if (slot(i).live && slot(i).value().first == key)
+                return i;
+        return -1;
+    }
+
+    int free_slot()
+    {
+        if (live < used) {
+            for (int i = 0; i < used; i++)
+                if (!slot(i).live)
+                    return i;
+        }
+        if (used >= N && (used - N) % block_size == 0)
+            blocks.emplace_back(new slot_t[block_size]);
+        return used++;
+    }
+
+    void build_index()
+    {
+        index.reset(new std::unordered_map<K, int>());
+        for (int i = 0; i < used; i++)
+            if (slot(i).live)
+                index->emplace(slot(i).value().first, i);
+    }
+
+    // Take over the entries of another map, which must be empty beforehand
+    void steal(small_dict &other)
+    {
+        for (int i = 0; i < std::min(other.used, N); i++) {
+            if (!other.inline_slots[i].live)
+                continue;
+            new (inline_slots[i].data) value_type(std::move(other.inline_slots[i].value()));
+            inline_slots[i].live = true;
+        }
+        blocks = std::move(other.blocks);
+        index = std::move(other.index);
+        used = other.used;
+        live = other.live;
+        for (int i = 0; i < std::min(other.used, N); i++) {
+            if (!other.inline_slots[i].live)
+                continue;
+            other.inline_slots[i].value().~value_type();
+            other.inline_slots[i].live = false;
+        }
+        other.blocks.clear();
+        other.used = 0;
+        other.live = 0;
+    }
+
+  public:
+    class const_iterator;
+
+    class iterator
+    {
+        friend class small_dict;
+        friend class const_iterator;
+        small_dict *ptr;
+        int idx;
+        iterator(small_dict *ptr, int idx) : ptr(ptr), idx(idx) {}
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef small_dict::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type *pointer;
+        typedef value_type &reference;
+
+        iterator() : ptr(nullptr), idx(0) {}
+        iterator &operator++()
+        {
+            idx = ptr->next_live(idx + 1);
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const iterator &other) const { return idx == other.idx; }
+        bool operator!=(const iterator &other) const { return idx != other.idx; }
+        value_type &operator*() const { return ptr->slot(idx).value(); }
+        value_type *operator->() const { return &ptr->slot(idx).value(); }
+    };
+
+    class const_iterator
+    {
+        friend class small_dict;
+        const small_dict *ptr;
+        int idx;
+        const_iterator(const small_dict *ptr, int idx) : ptr(ptr), idx(idx) {}
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef const small_dict::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type *pointer;
+        typedef value_type &reference;
+
+        const_iterator() : ptr(nullptr), idx(0) {}
+        const_iterator(const iterator &other) : ptr(other.ptr), idx(other.idx) {}
+        const_iterator &operator++()
+        {
+            idx = ptr->next_live(idx + 1);
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const const_iterator &other) const { return idx == other.idx; }
+        bool operator!=(const const_iterator &other) const { return idx != other.idx; }
+        const value_type &operator*() const { return ptr->slot(idx).value(); }
+        const value_type *operator->() const { return &ptr->slot(idx).value(); }
+    };
+
+    small_dict() {}
+    small_dict(const small_dict &other)
+    {
+        for (auto &entry : other)
+            emplace(entry.first, entry.second);
+    }
+    small_dict(small_dict &&other) { steal(other); }
+    small_dict(std::initializer_list<value_type> init)
+    {
+        for (auto &entry : init)
+            emplace(entry.first, entry.second);
+    }
+    ~small_dict() { clear(); }
+
+    small_dict &operator=(const small_dict &other)
+    {
+        if (this != &other) {
+            clear();
+            for (auto &entry : other)
+                emplace(entry.first, entry.second);
+        }
+        return *this;
+    }
+
+    small_dict &operator=(small_dict &&other)
+    {
+        if (this != &other) {
+            clear();
+            steal(other);
+        }
+        return *this;
+    }
+
+    void swap(small_dict &other)
+    {
+        small_dict tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    iterator begin() { return iterator(this, next_live(0)); }
+    iterator end() { return iterator(this, used); }
+    const_iterator begin() const { return const_iterator(this, next_live(0)); }
+    const_iterator end() const { return const_iterator(this, used); }
+
+    size_t size() const { return live; }
+    bool empty() const { return live == 0; }
+
+    iterator find(const K &key)
+    {
+        int i = find_slot(key);
+        return iterator(this, (i == -1) ? used : i);
+    }
+
+    const_iterator find(const K &key) const
+    {
+        int i = find_slot(key);
+        return const_iterator(this, (i == -1) ? used : i);
+    }
+
+    size_t count(const K &key) const { return (find_slot(key) == -1) ? 0 : 1; }
+
+    V &at(const K &key)
+    {
+        int i = find_slot(key);
+        if (i == -1)
+            throw std::out_of_range("small_dict::at()");
+        return slot(i).value().second;
+    }
+
+    const V &at(const K &key) const
+    {
+        int i = find_slot(key);
+        if (i == -1)
+            throw std::out_of_range("small_dict::at()");
+        return slot(i).value().second;
+    }
+
+    template <typename... Args> std::pair<iterator, bool> emplace(const K &key, Args &&... args)
+    {
+        int i = find_slot(key);
+        if (i != -1)
+            return std::make_pair(iterator(this, i), false);
+        i = free_slot();
+        slot_t &s = slot(i);
+        new (s.data) value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+        s.live = true;
+        live++;
+        if (index)
+            index->emplace(key, i);
+        else if (live > index_threshold)
+            build_index();
+        return std::make_pair(iterator(this, i), true);
+    }
+
+    template <typename P> std::pair<iterator, bool> insert(P &&entry)
+    {
+        return emplace(entry.first, std::forward<P>(entry).second);
+    }
+
+    // The hint is ignored, this is only for std::inserter
+    template <typename P> iterator insert(const_iterator, P &&entry) { return insert(std::forward<P>(entry)).first; }
+
+    V &operator[](const K &key) { return emplace(key).first->second; }
+
+    size_t erase(const K &key)
+    {
+        int i = find_slot(key);
+        if (i == -1)
+            return 0;
+        if (index)
+            index->erase(key);
+        slot_t &s = slot(i);
+        s.value().~value_type();
+        s.live = false;
+        live--;
+        return 1;
+    }
+
+    iterator erase(iterator it)
+    {
+        iterator next = it;
+        ++next;
+        erase(it->first);
+        return next;
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < used; i++) {
+            slot_t &s = slot(i);
+            if (s.live) {
+                s.value().~value_type();
+                s.live = false;
+            }
+        }
+        blocks.clear();
+        index.reset();
+        used = 0;
+        live = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "log.h"
+#include "perf_report.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+// The pool and queue of the worker thread running, if any
+thread_local ThreadPool *current_pool = nullptr;
+thread_local int current_queue = 0;
+} // namespace
+
+ThreadPool::ThreadPool(int threads, bool pin_numa)
+{
+    threads = std::max(1, threads);
+    for (int i = 0; i < threads; i++)
+        queues.emplace_back(new Queue());
+    if (pin_numa)
+        setup_numa();
+    // Workers read worker_node, so it is filled in before any of them starts
+    worker_node.assign(threads, 0);
+    if (node_cpus.size() > 1)
+        for (int i = 1; i < threads; i++)
+            worker_node.at(i) = i % int(node_cpus.size());
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back([this, i]() { worker_main(i); });
+#ifdef __linux__
+        if (node_cpus.size() > 1) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : node_cpus.at(worker_node.at(i)))
+                CPU_SET(cpu, &set);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set);
+        }
+#endif
+    }
+}
+
+void ThreadPool::setup_numa()
+{
+#ifdef __linux__
+    // Only the CPUs this process may run on are used; nodes without any of them are left out
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+    for (int node = 0; node < 1024; node++) {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!in)
+            continue;
+        // A list of CPU numbers and ranges, such as 0-15,32-47
+        std::vector<int> cpus;
+        std::string range;
+        while (std::getline(in, range, ',')) {
+            int first = -1, last = -1;
+            char dash;
+            std::istringstream rs(range);
+            if (!(rs >> first))
+                continue;
+            if (!(rs >> dash >> last))
+                last = first;
+            for (int cpu = first; cpu <= last; cpu++)
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+        }
+        if (cpus.empty())
+            continue;
+        for (int cpu : cpus) {
+            if (cpu >= int(cpu_node.size()))
+                cpu_node.resize(cpu + 1, -1);
+            cpu_node.at(cpu) = int(node_ids.size());
+        }
+        node_ids.push_back(node);
+        node_cpus.push_back(std::move(cpus));
+    }
+    if (node_cpus.size() <= 1) {
+        node_ids.clear();
+        node_cpus.clear();
+        cpu_node.clear();
+    }
+#endif
+}
+
+int ThreadPool::current_node() const
+{
+    if (node_cpus.size() <= 1)
+        return 0;
+    if (current_pool == this && current_queue > 0)
+        return worker_node.at(current_queue);
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu < int(cpu_node.size()) && cpu_node.at(cpu) >= 0)
+        return cpu_node.at(cpu);
+#endif
+    return 0;
+}
+
+void ThreadPool::bind_memory(const void *addr, size_t len, int node) const
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node_cpus.size() <= 1)
+        return;
+    uintptr_t page = uintptr_t(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = (uintptr_t(addr) + page - 1) & ~(page - 1);
+    uintptr_t end = (uintptr_t(addr) + len) & ~(page - 1);
+    if (end <= begin)
+        return;
+    const int bits = 8 * sizeof(unsigned long);
+    int id = node_ids.at(node);
+    std::vector<unsigned long> mask(id / bits + 1, 0);
+    mask.at(id / bits) |= 1UL << (id % bits);
+    // MPOL_PREFERRED, so that allocation still succeeds if the node is full, and MPOL_MF_MOVE to move pages that
+    // have already been touched. This is only a hint, so errors are ignored.
+    const int mpol_preferred = 1;
+    const unsigned mpol_mf_move = 1 << 1;
+    syscall(SYS_mbind, begin, end - begin, mpol_preferred, mask.data(), mask.size() * bits + 1, mpol_mf_move);
+#else
+    (void)addr;
+    (void)len;
+    (void)node;
+#endif
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto &w : workers)
+        w.join();
+}
+
+void ThreadPool::push(Task task)
+{
+    int q = (current_pool == this) ? current_queue : 0;
+    {
+        std::lock_guard<std::mutex> lock(queues[q]->mutex);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        ++queued;
+    }
+    wakeup.notify_one();
+}
+
+bool ThreadPool::pop(Task &task)
+{
+    if (queued.load() == 0)
+        return false;
+    int own = (current_pool == this) ? current_queue : 0;
+    // Newest first from our own queue, so that nested tasks finish before more of their parents start
+    {
+        auto &q = *queues[own];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            --queued;
+            return true;
+        }
+    }
+    // Then the oldest task of any other queue
+    int n = int(queues.size());
+    for (int i = 1; i < n; i++) {
+        auto &q = *queues[(own + i) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::execute(Task &task)
+{
+    TaskGroup *group = task.group;
+    try {
+        task.func();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(group->error_mutex);
+        if (!group->error)
+            group->error = std::current_exception();
+    }
+    task.func = nullptr;
+    if (--group->remaining == 0) {
+        // Taking the lock means a thread that found the group unfinished is already waiting, and gets the notify
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wakeup.notify_all();
+    }
+}
+
+void ThreadPool::help_until(const std::function<bool()> &done)
+{
+    Task task;
+    while (!done()) {
+        if (pop(task)) {
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wakeup.wait(lock, [&]() { return stopping || queued.load() > 0 || done(); });
+        if (stopping)
+            return;
+    }
+}
+
+void ThreadPool::worker_main(int index)
+{
+    current_pool = this;
+    current_queue = index;
+    perf_report_thread_start();
+    help_until([]() { return false; });
+}
+
+ThreadPool::TaskGroup::~TaskGroup()
+{
+    // Don't leave tasks running that refer to the group; errors are only reported by an explicit wait()
+    pool.help_until([this]() { return remaining.load() == 0; });
+}
+
+void ThreadPool::TaskGroup::run(std::function<void()> func)
+{
+    ++remaining;
+    pool.push(Task{std::move(func), this});
+}
+
+void ThreadPool::TaskGroup::wait()
+{
+    pool.help_until([this]() { return remaining.load() == 0; });
+    std::exception_ptr e;
+    {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        std::swap(e, error);
+    }
+    if (e)
+        std::rethrow_exception(e);
+}
+
+int ThreadPool::threads_for(size_t count, size_t grain, int max_threads) const
+{
+    int threads = (max_threads > 0) ? std::min(max_threads, size()) : size();
+    return int(std::min<size_t>(threads, std::max<size_t>(1, count / std::max<size_t>(1, grain))));
+}
+
+void ThreadPool::parallel_for(size_t count, size_t grain, const std::function<void(size_t)> &func, int max_threads)
+{
+    int threads = threads_for(count, grain, max_threads);
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; i++)
+            func(i);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        try {
+            while ((i = next++) < count)
+                func(i);
+        } catch (...) {
+            // Stop handing out items; the error is passed on once the other threads have finished theirs
+            next = count;
+            throw;
+        }
+    };
+    TaskGroup group(*this);
+    for (int i = 1; i < threads; i++)
+        group.run(worker);
+    worker();
+    group.wait();
+}
+
+ThreadPool &Context::threadPool() const
+{
+    std::lock_guard<std::mutex> lock(thread_pool_mutex);
+    if (!thread_pool) {
+        int threads = std::max<int>(1, std::thread::hardware_concurrency());
+        if (settings.count(id("threads")))
+            threads = std::max(1, setting<int>("threads"));
+        bool numa = settings.count(id("numa")) && setting<bool>("numa");
+        thread_pool = std::make_shared<ThreadPool>(threads, numa);
+        if (verbose)
+            log_info("Starting %d threads for parallel passes.\n", threads);
+        if (numa)
+            log_info("Spreading %d threads over %d NUMA nodes.\n", threads, thread_pool->numa_nodes());
+    }
+    return *thread_pool;
+}
+
+NEXTPNR_NAMESPACE_END
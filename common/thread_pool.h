@@ -0,0 +1,131 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Work stealing thread pool shared by the parallel passes (see Context::threadPool), so that threads are started
+// once rather than for every parallel loop, and the total number of threads follows the threads setting. A pool of
+// size N has N - 1 worker threads: a thread waiting for tasks always runs queued tasks itself until they are done, so
+// tasks may start and wait for further tasks without deadlocking the pool.
+//
+// Each worker has its own task queue, which it takes tasks from newest first, and steals the oldest tasks of the
+// other queues when it runs out. Tasks started from outside the pool go into a shared queue.
+//
+// On a multi-socket Linux machine the workers can be pinned to the NUMA nodes, taking turns between the nodes, so
+// that passes can place their data on the node of the threads that use it most (see bind_memory).
+class ThreadPool
+{
+  public:
+    explicit ThreadPool(int threads, bool pin_numa = false);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Number of threads that run tasks, including the waiting thread
+    int size() const { return int(workers.size()) + 1; }
+
+    // Number of NUMA nodes the workers are pinned to; 1 if they aren't pinned
+    int numa_nodes() const { return std::max<int>(1, node_cpus.size()); }
+    // Index (below numa_nodes) of the node the calling thread is running on
+    int current_node() const;
+    // Move the pages of [addr, addr + len) to the memory of a node given by its index, where possible. Only whole
+    // pages within the range are moved.
+    void bind_memory(const void *addr, size_t len, int node) const;
+
+    // Tasks that are waited for together. An exception thrown by a task (such as from log_error) is passed on by
+    // wait(), after all the tasks of the group have finished.
+    class TaskGroup
+    {
+      public:
+        explicit TaskGroup(ThreadPool &pool) : pool(pool) {}
+        ~TaskGroup();
+        TaskGroup(const TaskGroup &) = delete;
+        TaskGroup &operator=(const TaskGroup &) = delete;
+
+        void run(std::function<void()> func);
+        void wait();
+
+      private:
+        friend class ThreadPool;
+        ThreadPool &pool;
+        std::atomic<int> remaining{0};
+        std::mutex error_mutex;
+        std::exception_ptr error;
+    };
+
+    // Call func(i) for every i from 0 to count - 1, on up to max_threads threads (or the pool size, if 0), and at most
+    // one thread per grain items. Items are handed out one at a time, in order, as threads become free.
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t)> &func, int max_threads = 0);
+
+    // Number of threads that parallel_for would use
+    int threads_for(size_t count, size_t grain, int max_threads = 0) const;
+
+  private:
+    struct Task
+    {
+        std::function<void()> func;
+        TaskGroup *group;
+    };
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // Queue 0 is for tasks started outside the pool, queue i for worker i
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    // With pinning, the system node numbers and CPUs of the nodes used, the node index of each CPU (-1 if unused),
+    // and the node index of each worker (index 0 unused)
+    std::vector<int> node_ids;
+    std::vector<std::vector<int>> node_cpus;
+    std::vector<int> cpu_node, worker_node;
+    void setup_numa();
+
+    // Queued tasks, and whether the pool is shutting down; threads with nothing to do wait on wakeup
+    std::mutex sleep_mutex;
+    std::condition_variable wakeup;
+    std::atomic<int> queued{0};
+    bool stopping = false;
+
+    void push(Task task);
+    bool pop(Task &task);
+    void execute(Task &task);
+    void worker_main(int index);
+    // Run tasks until done() is true, sleeping while there are none
+    void help_until(const std::function<bool()> &done);
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -23,9 +23,15 @@
 #include <boost/range/adaptor/reversed.hpp>
 #include <deque>
 #include <map>
+#include <queue>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include "log.h"
+#include "mem_account.h"
+#include "perf_report.h"
+#include "thread_pool.h"
+#include "trace.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -86,7 +92,6 @@ struct CriticalPath
 };
 
 typedef std::unordered_map<ClockPair, CriticalPath> CriticalPathMap;
-typedef std::unordered_map<IdString, NetCriticalityInfo> NetCriticalityMap;
 
 struct Timing
 {
@@ -96,7 +101,6 @@ struct Timing
     delay_t min_slack;
     CriticalPathMap *crit_path;
     DelayFrequency *slack_histogram;
-    NetCriticalityMap *net_crit;
     IdString async_clock;
 
     struct TimingData
@@ -112,15 +116,16 @@ struct Timing
     };
 
     Timing(Context *ctx, bool net_delays, bool update, CriticalPathMap *crit_path = nullptr,
-           DelayFrequency *slack_histogram = nullptr, NetCriticalityMap *net_crit = nullptr)
+           DelayFrequency *slack_histogram = nullptr)
             : ctx(ctx), net_delays(net_delays), update(update), min_slack(1.0e12 / ctx->setting<float>("target_freq")),
-              crit_path(crit_path), slack_histogram(slack_histogram), net_crit(net_crit),
+              crit_path(crit_path), slack_histogram(slack_histogram),
               async_clock(ctx->id("$async$"))
     {
     }
 
     delay_t walk_paths()
     {
+        NPNR_TRACE_SCOPE("walk paths");
         const auto clk_period = ctx->getDelayFromNS(1.0e9 / ctx->setting<float>("target_freq")).maxDelay();
 
         // First, compute the topographical order of nets to walk through the circuit, assuming it is a _acyclic_ graph
@@ -208,9 +213,10 @@ struct Timing
             const auto net = queue.front();
             queue.pop_front();
 
-            for (auto &usr : net->users) {
+            for (size_t user_idx = 0; user_idx < net->users.size(); user_idx++) {
+                auto &usr = net->users.at(user_idx);
                 int user_clocks;
-                TimingPortClass usrClass = ctx->getPortTimingClass(usr.cell, usr.port, user_clocks);
+                TimingPortClass usrClass = ctx->getNetinfoSinkTimingClass(net, user_idx, user_clocks);
                 if (usrClass == TMG_IGNORE || usrClass == TMG_CLOCK_INPUT)
                     continue;
                 for (auto &port : usr.cell->ports) {
@@ -280,9 +286,10 @@ struct Timing
                 const auto net_arrival = nd.max_arrival;
                 const auto net_length_plus_one = nd.max_path_length + 1;
                 nd.min_remaining_budget = clk_period;
-                for (auto &usr : net->users) {
+                for (size_t user_idx = 0; user_idx < net->users.size(); user_idx++) {
+                    auto &usr = net->users.at(user_idx);
                     int port_clocks;
-                    TimingPortClass portClass = ctx->getPortTimingClass(usr.cell, usr.port, port_clocks);
+                    TimingPortClass portClass = ctx->getNetinfoSinkTimingClass(net, user_idx, port_clocks);
                     auto net_delay = net_delays ? ctx->getNetinfoRouteDelay(net, usr) : delay_t();
                     auto usr_arrival = net_arrival + net_delay;
 
@@ -313,6 +320,15 @@ struct Timing
             }
         }
 
+        // The forward pass has filled net_data, which is the largest structure here
+        MemAccount mem("timing");
+        if (mem_account_enabled()) {
+            size_t bytes = mem_usage(net_data) + mem_usage(topographical_order);
+            for (auto &nd : net_data)
+                bytes += mem_usage(nd.second);
+            mem.update(bytes);
+        }
+
         std::unordered_map<ClockPair, std::pair<delay_t, NetInfo *>> crit_nets;
 
         // Now go backwards topographically to determine the minimum path slack, and to distribute all path slack evenly
@@ -328,11 +344,12 @@ struct Timing
                     continue;
                 const delay_t net_length_plus_one = nd.max_path_length + 1;
                 auto &net_min_remaining_budget = nd.min_remaining_budget;
-                for (auto &usr : net->users) {
+                for (size_t user_idx = 0; user_idx < net->users.size(); user_idx++) {
+                    auto &usr = net->users.at(user_idx);
                     auto net_delay = net_delays ? ctx->getNetinfoRouteDelay(net, usr) : delay_t();
                     auto budget_override = ctx->getBudgetOverride(net, usr, net_delay);
                     int port_clocks;
-                    TimingPortClass portClass = ctx->getPortTimingClass(usr.cell, usr.port, port_clocks);
+                    TimingPortClass portClass = ctx->getNetinfoSinkTimingClass(net, user_idx, port_clocks);
                     if (portClass == TMG_REGISTER_INPUT || portClass == TMG_ENDPOINT) {
                         auto process_endpoint = [&](IdString clksig, ClockEdge edge, delay_t setup) {
                             const auto net_arrival = nd.max_arrival;
@@ -481,194 +498,1151 @@ struct Timing
             }
         }
 
-        if (net_crit) {
-            NPNR_ASSERT(crit_path);
-            // Go through in reverse topographical order to set required times
-            for (auto net : boost::adaptors::reverse(topographical_order)) {
-                if (!net_data.count(net))
+        return min_slack;
+    }
+
+    void assign_budget()
+    {
+        // Clear delays to a very high value first
+        for (auto &net : ctx->nets) {
+            for (auto &usr : net.second->users) {
+                usr.budget = std::numeric_limits<delay_t>::max();
+            }
+        }
+
+        walk_paths();
+    }
+};
+
+// Timing graph compiled from the netlist into flat arrays: nodes are nets in topological order, each owning a
+// contiguous range of users (sink ports), fanins and launching clock domains; users in turn own ranges of cell arcs
+// and endpoints. Clock events are numbered densely, so no hashing is needed once the graph is built.
+struct TimingGraph
+{
+    Context *ctx;
+    IdString async_clock;
+
+    // A combinational arc from a net user, through its cell, to the net driven on the other side
+    // Each delay and time is tracked for both the slow corner (max delays, for setup checks) and the fast corner
+    // (min delays, for hold checks), in the same pass over the graph
+    struct CombArc
+    {
+        int dst;
+        delay_t delay, min_delay;
+        // Arrival times propagate along the arc; required times propagate back along it
+        bool forward, backward;
+    };
+
+    struct Endpoint
+    {
+        int clock;
+        delay_t setup, hold;
+    };
+
+    struct User
+    {
+        delay_t route_delay, min_route_delay;
+        bool budget_override;
+        int arc_begin, arc_end;
+        int endpoint_begin, endpoint_end;
+    };
+
+    struct Fanin
+    {
+        // Driving node, and the index of the user on it into TimingGraph::users
+        int src, src_user;
+        delay_t delay, min_delay;
+        bool forward, backward;
+    };
+
+    // Timing of a net for one launching clock event; which events reach which nets only depends
+    // on the netlist, so the set of these is fixed once the graph is built
+    struct DomainData
+    {
+        int clock;
+        bool startpoint = false, false_startpoint = false;
+        delay_t start_arrival = 0, start_min_arrival = 0;
+        delay_t arrival = 0, min_arrival = 0;
+        unsigned path_length = 0;
+        delay_t net_min_required = std::numeric_limits<delay_t>::max();
+        // Latest time the fastest path may arrive at the net without violating a hold check downstream
+        delay_t net_hold_required = std::numeric_limits<delay_t>::min();
+        // Offset into TimingGraph::min_required and hold_required, one entry per user of the node
+        int required_begin = 0;
+    };
+
+    struct Node
+    {
+        NetInfo *net;
+        int user_begin, user_end;
+        int fanin_begin, fanin_end;
+        // Sorted by clock
+        int domain_begin, domain_end;
+        // has_crit is set if the node has an entry in crit_map
+        bool delay_dirty = false, fwd_dirty = false, bwd_dirty = false, has_crit = false;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<User> users;
+    std::vector<CombArc> arcs;
+    std::vector<Endpoint> endpoints;
+    std::vector<Fanin> fanins;
+    std::vector<DomainData> domains;
+    std::vector<delay_t> min_required, hold_required;
+
+    std::unordered_map<IdString, int> node_by_net;
+    std::vector<ClockEvent> clocks;
+    std::unordered_map<ClockEvent, int> clock_idx;
+    // Period for paths launched by clock [start] and captured by clock [end], flattened
+    std::vector<delay_t> period;
+
+    std::vector<int> dirty_nets;
+    int fwd_lo = std::numeric_limits<int>::max(), bwd_hi = -1;
+    NetCriticalityMap *crit_map = nullptr;
+
+    // Nodes grouped by level, where a node's level is one more than that of its latest fanin; nodes in the same
+    // level are independent of each other, so a full update can process each level in parallel
+    std::vector<int> level_nodes, level_begin;
+    // Set when every node needs updating, i.e. after setup
+    bool full_update = false;
+    int threads = 1;
+    MemAccount mem{"timing"};
+
+    TimingGraph(Context *ctx) : ctx(ctx), async_clock(ctx->id("$async$")) {}
+
+    // Number of chunks to split work over count items into, one per thread if there is enough work
+    int num_chunks(int count) const { return std::max(1, std::min(threads, count / 512)); }
+
+    // Run func(chunk, begin, end) for each of num_chunks(count) contiguous chunks of [0, count). The split only
+    // depends on the thread count, and chunks only ever write to disjoint data, so results are deterministic.
+    template <typename Tf> void parallel_chunks(int count, Tf func)
+    {
+        int chunks = num_chunks(count);
+        if (chunks == 1) {
+            func(0, 0, count);
+            return;
+        }
+        ctx->threadPool().parallel_for(
+                chunks, 1,
+                [&](size_t c) {
+                    NPNR_TRACE_SCOPE_ARG("chunk", "chunk", int(c));
+                    func(int(c), (count * int(c)) / chunks, (count * (int(c) + 1)) / chunks);
+                },
+                chunks);
+    }
+
+    int get_clock(IdString clock, ClockEdge edge)
+    {
+        ClockEvent ev{clock, edge};
+        auto fnd = clock_idx.find(ev);
+        if (fnd != clock_idx.end())
+            return fnd->second;
+        clock_idx[ev] = int(clocks.size());
+        clocks.push_back(ev);
+        return int(clocks.size()) - 1;
+    }
+
+    delay_t get_period(int start, int end) const { return period.at(start * clocks.size() + end); }
+
+    int domain_index(const Node &n, int clock) const
+    {
+        auto begin = domains.begin() + n.domain_begin, end = domains.begin() + n.domain_end;
+        auto fnd = std::lower_bound(begin, end, clock, [](const DomainData &d, int c) { return d.clock < c; });
+        if (fnd == end || fnd->clock != clock)
+            return -1;
+        return int(fnd - domains.begin());
+    }
+
+    bool is_required_domain(const DomainData &dd) const
+    {
+        return !dd.false_startpoint && clocks.at(dd.clock).clock != async_clock;
+    }
+
+    // Per-net data while the graph is being built, before it is packed into flat arrays
+    struct BuildNode
+    {
+        NetInfo *net;
+        std::vector<User> users;
+        std::vector<std::vector<CombArc>> user_arcs;
+        std::vector<std::vector<Endpoint>> user_endpoints;
+        std::vector<Fanin> fanin;
+        std::map<int, DomainData> domains;
+    };
+
+    void setup()
+    {
+        NPNR_TRACE_SCOPE("timing setup");
+        nodes.clear();
+        users.clear();
+        arcs.clear();
+        endpoints.clear();
+        fanins.clear();
+        domains.clear();
+        min_required.clear();
+        hold_required.clear();
+        node_by_net.clear();
+        clocks.clear();
+        clock_idx.clear();
+        dirty_nets.clear();
+        crit_map = nullptr;
+
+        std::vector<BuildNode> bnodes;
+        auto add_node = [&](NetInfo *net) {
+            auto fnd = node_by_net.find(net->name);
+            if (fnd != node_by_net.end())
+                return fnd->second;
+            int idx = int(bnodes.size());
+            node_by_net[net->name] = idx;
+            bnodes.emplace_back();
+            bnodes.back().net = net;
+            return idx;
+        };
+        auto add_startpoint = [&](NetInfo *net, int clock) -> DomainData & {
+            auto &dd = bnodes.at(add_node(net)).domains[clock];
+            dd.clock = clock;
+            dd.startpoint = true;
+            return dd;
+        };
+
+        // Find the timing startpoints and the number of fanins to each combinational output, then walk the design
+        // from there to build the topological order; this follows Timing::walk_paths.
+        std::unordered_map<const PortInfo *, unsigned> port_fanin;
+        std::vector<IdString> input_ports;
+        std::vector<const PortInfo *> output_ports;
+        for (auto &cell : ctx->cells) {
+            input_ports.clear();
+            output_ports.clear();
+            for (auto &port : cell.second->ports) {
+                if (!port.second.net)
                     continue;
-                auto &nd_map = net_data.at(net);
-                for (auto &startdomain : nd_map) {
-                    auto &nd = startdomain.second;
-                    if (nd.false_startpoint)
-                        continue;
-                    if (startdomain.first.clock == async_clock)
-                        continue;
-                    if (nd.min_required.empty())
-                        nd.min_required.resize(net->users.size(), std::numeric_limits<delay_t>::max());
-                    delay_t net_min_required = std::numeric_limits<delay_t>::max();
-                    for (size_t i = 0; i < net->users.size(); i++) {
-                        auto &usr = net->users.at(i);
-                        auto net_delay = ctx->getNetinfoRouteDelay(net, usr);
-                        int port_clocks;
-                        TimingPortClass portClass = ctx->getPortTimingClass(usr.cell, usr.port, port_clocks);
-                        if (portClass == TMG_REGISTER_INPUT || portClass == TMG_ENDPOINT) {
-                            auto process_endpoint = [&](IdString clksig, ClockEdge edge, delay_t setup) {
-                                delay_t period;
-                                // Set default period
-                                if (edge == startdomain.first.edge) {
-                                    period = clk_period;
-                                } else {
-                                    period = clk_period / 2;
-                                }
-                                if (clksig != async_clock) {
-                                    if (ctx->nets.at(clksig)->clkconstr) {
-                                        if (edge == startdomain.first.edge) {
-                                            // same edge
-                                            period = ctx->nets.at(clksig)->clkconstr->period.minDelay();
-                                        } else if (edge == RISING_EDGE) {
-                                            // falling -> rising
-                                            period = ctx->nets.at(clksig)->clkconstr->low.minDelay();
-                                        } else if (edge == FALLING_EDGE) {
-                                            // rising -> falling
-                                            period = ctx->nets.at(clksig)->clkconstr->high.minDelay();
-                                        }
-                                    }
-                                }
-                                nd.min_required.at(i) = std::min(period - setup, nd.min_required.at(i));
-                            };
-                            if (portClass == TMG_REGISTER_INPUT) {
-                                for (int j = 0; j < port_clocks; j++) {
-                                    TimingClockingInfo clkInfo = ctx->getPortClockingInfo(usr.cell, usr.port, j);
-                                    const NetInfo *clknet = get_net_or_empty(usr.cell, clkInfo.clock_port);
-                                    IdString clksig = clknet ? clknet->name : async_clock;
-                                    process_endpoint(clksig, clknet ? clkInfo.edge : RISING_EDGE,
-                                                     clkInfo.setup.maxDelay());
-                                }
-                            } else {
-                                process_endpoint(async_clock, RISING_EDGE, 0);
-                            }
-                        }
-                        net_min_required = std::min(net_min_required, nd.min_required.at(i) - net_delay);
+                if (port.second.type == PORT_OUT)
+                    output_ports.push_back(&port.second);
+                else
+                    input_ports.push_back(port.first);
+            }
+
+            for (auto o : output_ports) {
+                int port_clocks = 0;
+                TimingPortClass portClass = ctx->getPortTimingClass(cell.second.get(), o->name, port_clocks);
+                if (portClass == TMG_REGISTER_OUTPUT) {
+                    for (int i = 0; i < port_clocks; i++) {
+                        TimingClockingInfo clkInfo = ctx->getPortClockingInfo(cell.second.get(), o->name, i);
+                        const NetInfo *clknet = get_net_or_empty(cell.second.get(), clkInfo.clock_port);
+                        IdString clksig = clknet ? clknet->name : async_clock;
+                        auto &dd = add_startpoint(o->net, get_clock(clksig, clknet ? clkInfo.edge : RISING_EDGE));
+                        dd.start_arrival = clkInfo.clockToQ.maxDelay();
+                        dd.start_min_arrival = clkInfo.clockToQ.minDelay();
                     }
-                    PortRef &drv = net->driver;
-                    if (drv.cell == nullptr)
+                } else {
+                    if (portClass == TMG_STARTPOINT || portClass == TMG_GEN_CLOCK || portClass == TMG_IGNORE)
+                        add_startpoint(o->net, get_clock(async_clock, RISING_EDGE)).false_startpoint =
+                                (portClass == TMG_GEN_CLOCK || portClass == TMG_IGNORE);
+                    if (portClass == TMG_CLOCK_INPUT)
                         continue;
-                    for (const auto &port : drv.cell->ports) {
-                        if (port.second.type != PORT_IN || !port.second.net)
-                            continue;
+                    for (auto i : input_ports) {
                         DelayInfo comb_delay;
-                        bool is_path = ctx->getCellDelay(drv.cell, port.first, drv.port, comb_delay);
-                        if (!is_path)
-                            continue;
-                        int cc;
-                        auto pclass = ctx->getPortTimingClass(drv.cell, port.first, cc);
-                        if (pclass != TMG_COMB_INPUT)
-                            continue;
-                        NetInfo *sink_net = port.second.net;
-                        if (net_data.count(sink_net) && net_data.at(sink_net).count(startdomain.first)) {
-                            auto &sink_nd = net_data.at(sink_net).at(startdomain.first);
-                            if (sink_nd.min_required.empty())
-                                sink_nd.min_required.resize(sink_net->users.size(),
-                                                            std::numeric_limits<delay_t>::max());
-                            for (size_t i = 0; i < sink_net->users.size(); i++) {
-                                auto &user = sink_net->users.at(i);
-                                if (user.cell == drv.cell && user.port == port.first) {
-                                    sink_nd.min_required.at(i) = std::min(sink_nd.min_required.at(i),
-                                                                          net_min_required - comb_delay.maxDelay());
-                                    break;
-                                }
-                            }
-                        }
+                        if (ctx->getCellDelay(cell.second.get(), i, o->name, comb_delay))
+                            port_fanin[o]++;
                     }
+                    if (!port_fanin.count(o) && !node_by_net.count(o->net->name))
+                        add_startpoint(o->net, get_clock(async_clock, RISING_EDGE)).false_startpoint = true;
                 }
             }
-            std::unordered_map<ClockEvent, delay_t> worst_slack;
+        }
+
+        if (bool_or_default(ctx->settings, ctx->id("arch.ooc"))) {
+            for (auto &p : ctx->ports) {
+                if (p.second.type != PORT_IN || p.second.net == nullptr)
+                    continue;
+                add_node(p.second.net);
+            }
+        }
 
-            // Assign slack values
-            for (auto &net_entry : net_data) {
-                const NetInfo *net = net_entry.first;
-                for (auto &startdomain : net_entry.second) {
-                    auto &nd = startdomain.second;
-                    if (startdomain.first.clock == async_clock)
+        // Arcs are recorded against the driven net, as it might not have a node yet
+        std::vector<std::vector<std::pair<const NetInfo *, CombArc>>> pending_arcs;
+        for (int idx = 0; idx < int(bnodes.size()); idx++) {
+            NetInfo *net = bnodes.at(idx).net;
+            pending_arcs.emplace_back();
+            bnodes.at(idx).users.resize(net->users.size());
+            bnodes.at(idx).user_arcs.resize(net->users.size());
+            bnodes.at(idx).user_endpoints.resize(net->users.size());
+            for (size_t i = 0; i < net->users.size(); i++) {
+                auto &usr = net->users.at(i);
+                User ud;
+                ud.route_delay = ctx->getNetinfoRouteDelay(net, usr, ud.min_route_delay);
+                ud.budget_override = ctx->getBudgetOverride(net, usr, ud.route_delay);
+                bnodes.at(idx).users.at(i) = ud;
+                int user_clocks;
+                TimingPortClass usrClass = ctx->getPortTimingClass(usr.cell, usr.port, user_clocks);
+                if (usrClass == TMG_REGISTER_INPUT) {
+                    for (int j = 0; j < user_clocks; j++) {
+                        TimingClockingInfo clkInfo = ctx->getPortClockingInfo(usr.cell, usr.port, j);
+                        const NetInfo *clknet = get_net_or_empty(usr.cell, clkInfo.clock_port);
+                        IdString clksig = clknet ? clknet->name : async_clock;
+                        bnodes.at(idx).user_endpoints.at(i).push_back(
+                                Endpoint{get_clock(clksig, clknet ? clkInfo.edge : RISING_EDGE),
+                                         clkInfo.setup.maxDelay(), clkInfo.hold.maxDelay()});
+                    }
+                } else if (usrClass == TMG_ENDPOINT) {
+                    bnodes.at(idx).user_endpoints.at(i).push_back(Endpoint{get_clock(async_clock, RISING_EDGE), 0, 0});
+                }
+                if (usrClass == TMG_IGNORE || usrClass == TMG_CLOCK_INPUT)
+                    continue;
+                for (auto &port : usr.cell->ports) {
+                    if (port.second.type != PORT_OUT || !port.second.net)
+                        continue;
+                    int port_clocks;
+                    TimingPortClass portClass = ctx->getPortTimingClass(usr.cell, port.first, port_clocks);
+                    if (portClass == TMG_REGISTER_OUTPUT || portClass == TMG_STARTPOINT || portClass == TMG_IGNORE ||
+                        portClass == TMG_GEN_CLOCK)
                         continue;
-                    if (nd.min_required.empty())
+                    DelayInfo comb_delay;
+                    if (!ctx->getCellDelay(usr.cell, usr.port, port.first, comb_delay))
                         continue;
-                    auto &nc = (*net_crit)[net->name];
-                    if (nc.slack.empty())
-                        nc.slack.resize(net->users.size(), std::numeric_limits<delay_t>::max());
-#if 0
-                    if (ctx->debug)
-                        log_info("Net %s cd %s\n", net->name.c_str(ctx), startdomain.first.clock.c_str(ctx));
-#endif
-                    for (size_t i = 0; i < net->users.size(); i++) {
-                        delay_t slack = nd.min_required.at(i) -
-                                        (nd.max_arrival + ctx->getNetinfoRouteDelay(net, net->users.at(i)));
-#if 0
-                        if (ctx->debug)
-                            log_info("    user %s.%s required %.02fns arrival %.02f route %.02f slack %.02f\n",
-                                    net->users.at(i).cell->name.c_str(ctx), net->users.at(i).port.c_str(ctx),
-                                    ctx->getDelayNS(nd.min_required.at(i)), ctx->getDelayNS(nd.max_arrival),
-                                    ctx->getDelayNS(ctx->getNetinfoRouteDelay(net, net->users.at(i))), ctx->getDelayNS(slack));
-#endif
-                        if (worst_slack.count(startdomain.first))
-                            worst_slack.at(startdomain.first) = std::min(worst_slack.at(startdomain.first), slack);
-                        else
-                            worst_slack[startdomain.first] = slack;
-                        nc.slack.at(i) = slack;
+                    // CombArc::dst holds the user index until the driven net's node is known
+                    pending_arcs.at(idx).emplace_back(port.second.net,
+                                                      CombArc{int(i), comb_delay.maxDelay(), comb_delay.minDelay(),
+                                                              usrClass != TMG_ENDPOINT, usrClass == TMG_COMB_INPUT});
+                    auto it = port_fanin.find(&port.second);
+                    if (it == port_fanin.end()) {
+                        log_error("Internal timing error (negative fanin count) for %s.%s\n", ctx->nameOf(usr.cell),
+                                  ctx->nameOf(port.first));
+                    }
+                    if (--it->second == 0) {
+                        add_node(port.second.net);
+                        port_fanin.erase(it);
                     }
-                    if (ctx->debug)
-                        log_break();
                 }
             }
-            // Assign criticality values
-            for (auto &net_entry : net_data) {
-                const NetInfo *net = net_entry.first;
-                for (auto &startdomain : net_entry.second) {
-                    if (startdomain.first.clock == async_clock)
+        }
+
+        if (!port_fanin.empty() && !bool_or_default(ctx->settings, ctx->id("timing/ignoreLoops"), false)) {
+            for (auto fanin : port_fanin) {
+                NetInfo *net = fanin.first->net;
+                log_info("   remaining fanin includes %s (net %s)\n", fanin.first->name.c_str(ctx),
+                         net->name.c_str(ctx));
+                if (net->driver.cell != nullptr)
+                    log_info("        driver = %s.%s\n", net->driver.cell->name.c_str(ctx),
+                             net->driver.port.c_str(ctx));
+                for (auto net_user : net->users)
+                    log_info("        user: %s.%s\n", net_user.cell->name.c_str(ctx), net_user.port.c_str(ctx));
+            }
+            if (ctx->force)
+                log_warning("timing analysis failed due to presence of combinatorial loops, incomplete specification "
+                            "of timing ports, etc.\n");
+            else
+                log_error("timing analysis failed due to presence of combinatorial loops, incomplete specification of "
+                          "timing ports, etc.\n");
+        }
+
+        // Resolve arcs now all nodes are known; Fanin::src_user is the local user index until the graph is packed
+        for (int idx = 0; idx < int(pending_arcs.size()); idx++) {
+            for (auto &pa : pending_arcs.at(idx)) {
+                auto fnd = node_by_net.find(pa.first->name);
+                if (fnd == node_by_net.end())
+                    continue;
+                CombArc arc = pa.second;
+                int user = arc.dst;
+                arc.dst = fnd->second;
+                bnodes.at(idx).user_arcs.at(user).push_back(arc);
+                bnodes.at(arc.dst).fanin.push_back(
+                        Fanin{idx, user, arc.delay, arc.min_delay, arc.forward, arc.backward});
+            }
+        }
+
+        // Find which launching clocks reach which nets, and the longest path lengths
+        for (auto &bn : bnodes) {
+            for (auto &d : bn.domains) {
+                if (d.second.false_startpoint)
+                    continue;
+                unsigned length_plus_one = d.second.path_length + 1;
+                for (size_t i = 0; i < bn.users.size(); i++) {
+                    for (auto &arc : bn.user_arcs.at(i)) {
+                        if (!arc.forward)
+                            continue;
+                        auto &dst_dd = bnodes.at(arc.dst).domains[d.first];
+                        dst_dd.clock = d.first;
+                        if (!bn.users.at(i).budget_override)
+                            dst_dd.path_length = std::max(dst_dd.path_length, length_plus_one);
+                    }
+                }
+            }
+        }
+
+        // Pack into flat arrays; fanins always come from earlier nodes, whose users are already placed
+        nodes.resize(bnodes.size());
+        for (size_t idx = 0; idx < bnodes.size(); idx++) {
+            auto &bn = bnodes.at(idx);
+            auto &n = nodes.at(idx);
+            n.net = bn.net;
+            n.user_begin = int(users.size());
+            for (size_t i = 0; i < bn.users.size(); i++) {
+                User ud = bn.users.at(i);
+                ud.arc_begin = int(arcs.size());
+                arcs.insert(arcs.end(), bn.user_arcs.at(i).begin(), bn.user_arcs.at(i).end());
+                ud.arc_end = int(arcs.size());
+                ud.endpoint_begin = int(endpoints.size());
+                endpoints.insert(endpoints.end(), bn.user_endpoints.at(i).begin(), bn.user_endpoints.at(i).end());
+                ud.endpoint_end = int(endpoints.size());
+                users.push_back(ud);
+            }
+            n.user_end = int(users.size());
+            n.fanin_begin = int(fanins.size());
+            for (auto fi : bn.fanin) {
+                fi.src_user += nodes.at(fi.src).user_begin;
+                fanins.push_back(fi);
+            }
+            n.fanin_end = int(fanins.size());
+            n.domain_begin = int(domains.size());
+            for (auto &d : bn.domains) {
+                DomainData dd = d.second;
+                dd.required_begin = int(min_required.size());
+                min_required.resize(min_required.size() + bn.users.size(), std::numeric_limits<delay_t>::max());
+                hold_required.resize(hold_required.size() + bn.users.size(), std::numeric_limits<delay_t>::min());
+                domains.push_back(dd);
+            }
+            n.domain_end = int(domains.size());
+            n.fwd_dirty = n.bwd_dirty = true;
+        }
+        fwd_lo = 0;
+        bwd_hi = int(nodes.size()) - 1;
+        full_update = true;
+
+        std::vector<int> level(nodes.size(), 0);
+        int num_levels = 0;
+        for (size_t idx = 0; idx < nodes.size(); idx++) {
+            for (int f = nodes.at(idx).fanin_begin; f < nodes.at(idx).fanin_end; f++)
+                level.at(idx) = std::max(level.at(idx), level.at(fanins.at(f).src) + 1);
+            num_levels = std::max(num_levels, level.at(idx) + 1);
+        }
+        level_begin.assign(num_levels + 1, 0);
+        for (int l : level)
+            level_begin.at(l + 1)++;
+        for (int l = 0; l < num_levels; l++)
+            level_begin.at(l + 1) += level_begin.at(l);
+        level_nodes.resize(nodes.size());
+        std::vector<int> level_fill(level_begin.begin(), level_begin.end() - 1);
+        for (size_t idx = 0; idx < nodes.size(); idx++)
+            level_nodes.at(level_fill.at(level.at(idx))++) = int(idx);
+
+        threads = std::max(1, ctx->setting<int>("threads", std::max<int>(1, std::thread::hardware_concurrency())));
+
+        const auto clk_period = ctx->getDelayFromNS(1.0e9 / ctx->setting<float>("target_freq")).maxDelay();
+        period.resize(clocks.size() * clocks.size());
+        for (size_t s = 0; s < clocks.size(); s++) {
+            for (size_t e = 0; e < clocks.size(); e++) {
+                ClockEdge edge = clocks.at(e).edge;
+                bool same_edge = (edge == clocks.at(s).edge);
+                delay_t p = same_edge ? clk_period : clk_period / 2;
+                IdString clksig = clocks.at(e).clock;
+                if (clksig != async_clock && ctx->nets.at(clksig)->clkconstr) {
+                    auto &cc = ctx->nets.at(clksig)->clkconstr;
+                    if (same_edge)
+                        p = cc->period.minDelay();
+                    else if (edge == RISING_EDGE)
+                        p = cc->low.minDelay();
+                    else if (edge == FALLING_EDGE)
+                        p = cc->high.minDelay();
+                }
+                period.at(s * clocks.size() + e) = p;
+            }
+        }
+        if (mem_account_enabled())
+            mem.update(mem_usage(nodes) + mem_usage(users) + mem_usage(arcs) + mem_usage(endpoints) +
+                       mem_usage(fanins) + mem_usage(domains) + mem_usage(min_required) + mem_usage(hold_required) +
+                       mem_usage(node_by_net) + mem_usage(period) + mem_usage(level_nodes) + mem_usage(level_begin));
+    }
+
+    void mark_fwd(int idx)
+    {
+        nodes.at(idx).fwd_dirty = true;
+        fwd_lo = std::min(fwd_lo, idx);
+    }
+
+    void mark_bwd(int idx)
+    {
+        nodes.at(idx).bwd_dirty = true;
+        bwd_hi = std::max(bwd_hi, idx);
+    }
+
+    void mark_dirty(const NetInfo *net)
+    {
+        auto fnd = node_by_net.find(net->name);
+        if (fnd == node_by_net.end())
+            return;
+        Node &n = nodes.at(fnd->second);
+        if (!n.delay_dirty)
+            dirty_nets.push_back(fnd->second);
+        n.delay_dirty = true;
+    }
+
+    // Recompute the arrival times of a net from its fanin, returning true if any changed
+    bool update_arrival(const Node &n)
+    {
+        bool changed = false;
+        for (int d = n.domain_begin; d < n.domain_end; d++) {
+            auto &dd = domains[d];
+            if (dd.false_startpoint)
+                continue;
+            delay_t arrival = dd.startpoint ? dd.start_arrival : 0;
+            delay_t min_arrival = dd.startpoint ? dd.start_min_arrival : std::numeric_limits<delay_t>::max();
+            for (int f = n.fanin_begin; f < n.fanin_end; f++) {
+                const auto &fi = fanins[f];
+                if (!fi.forward)
+                    continue;
+                int sd = domain_index(nodes[fi.src], dd.clock);
+                if (sd == -1 || domains[sd].false_startpoint)
+                    continue;
+                const auto &src_user = users[fi.src_user];
+                arrival = std::max(arrival, domains[sd].arrival + src_user.route_delay + fi.delay);
+                min_arrival = std::min(min_arrival, domains[sd].min_arrival + src_user.min_route_delay + fi.min_delay);
+            }
+            if (min_arrival == std::numeric_limits<delay_t>::max())
+                min_arrival = 0;
+            if (arrival != dd.arrival || min_arrival != dd.min_arrival) {
+                dd.arrival = arrival;
+                dd.min_arrival = min_arrival;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    // Recompute the required times of a net from its fanout, returning true if any changed
+    bool update_required(const Node &n)
+    {
+        bool changed = false;
+        for (int d = n.domain_begin; d < n.domain_end; d++) {
+            auto &dd = domains[d];
+            if (!is_required_domain(dd))
+                continue;
+            delay_t net_min_required = std::numeric_limits<delay_t>::max();
+            delay_t net_hold_required = std::numeric_limits<delay_t>::min();
+            for (int u = n.user_begin; u < n.user_end; u++) {
+                const auto &ud = users[u];
+                delay_t required = std::numeric_limits<delay_t>::max();
+                delay_t hold = std::numeric_limits<delay_t>::min();
+                for (int e = ud.endpoint_begin; e < ud.endpoint_end; e++) {
+                    const auto &ep = endpoints[e];
+                    required = std::min(required, get_period(dd.clock, ep.clock) - ep.setup);
+                    // Hold is only checked against the same clock event; there is no clock skew model to make
+                    // cross-domain hold checks meaningful
+                    if (ep.clock == dd.clock)
+                        hold = std::max(hold, ep.hold);
+                }
+                for (int a = ud.arc_begin; a < ud.arc_end; a++) {
+                    const auto &arc = arcs[a];
+                    if (!arc.backward)
                         continue;
-                    auto &nd = startdomain.second;
-                    if (nd.min_required.empty())
+                    int dst_d = domain_index(nodes[arc.dst], dd.clock);
+                    if (dst_d == -1 || domains[dst_d].false_startpoint)
                         continue;
-                    auto &nc = (*net_crit)[net->name];
-                    if (nc.slack.empty())
+                    const auto &dst_dd = domains[dst_d];
+                    required = std::min(required, dst_dd.net_min_required - arc.delay);
+                    if (dst_dd.net_hold_required != std::numeric_limits<delay_t>::min())
+                        hold = std::max(hold, dst_dd.net_hold_required - arc.min_delay);
+                }
+                min_required[dd.required_begin + (u - n.user_begin)] = required;
+                hold_required[dd.required_begin + (u - n.user_begin)] = hold;
+                net_min_required = std::min(net_min_required, required - ud.route_delay);
+                if (hold != std::numeric_limits<delay_t>::min())
+                    net_hold_required = std::max(net_hold_required, hold - ud.min_route_delay);
+            }
+            if (net_min_required != dd.net_min_required || net_hold_required != dd.net_hold_required) {
+                dd.net_min_required = net_min_required;
+                dd.net_hold_required = net_hold_required;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    void mark_fwd_users(int user_begin, int user_end)
+    {
+        for (int u = user_begin; u < user_end; u++)
+            for (int a = users[u].arc_begin; a < users[u].arc_end; a++)
+                if (arcs[a].forward)
+                    mark_fwd(arcs[a].dst);
+    }
+
+    void propagate()
+    {
+        NPNR_TRACE_SCOPE("timing propagate");
+        for (int idx : dirty_nets) {
+            Node &n = nodes.at(idx);
+            n.delay_dirty = false;
+            for (int u = n.user_begin; u < n.user_end; u++) {
+                delay_t min_delay;
+                delay_t delay = ctx->getNetinfoRouteDelay(n.net, n.net->users.at(u - n.user_begin), min_delay);
+                if (delay == users[u].route_delay && min_delay == users[u].min_route_delay)
+                    continue;
+                users[u].route_delay = delay;
+                users[u].min_route_delay = min_delay;
+                mark_fwd_users(u, u + 1);
+                mark_bwd(idx);
+            }
+        }
+        dirty_nets.clear();
+
+        if (full_update) {
+            update_all();
+            return;
+        }
+
+        // Arcs always go forwards in the topological order, so one sweep in each direction is enough
+        for (int idx = fwd_lo; idx < int(nodes.size()); idx++) {
+            Node &n = nodes[idx];
+            if (!n.fwd_dirty)
+                continue;
+            n.fwd_dirty = false;
+            if (update_arrival(n))
+                mark_fwd_users(n.user_begin, n.user_end);
+        }
+        fwd_lo = std::numeric_limits<int>::max();
+
+        for (int idx = bwd_hi; idx >= 0; idx--) {
+            Node &n = nodes[idx];
+            if (!n.bwd_dirty)
+                continue;
+            n.bwd_dirty = false;
+            if (update_required(n))
+                for (int f = n.fanin_begin; f < n.fanin_end; f++)
+                    if (fanins[f].backward)
+                        mark_bwd(fanins[f].src);
+        }
+        bwd_hi = -1;
+    }
+
+    // Recompute every node, level by level, and clear all dirty state
+    void update_all()
+    {
+        auto update_level = [&](int l, bool forward) {
+            int begin = level_begin.at(l), count = level_begin.at(l + 1) - begin;
+            parallel_chunks(count, [&](int, int chunk_begin, int chunk_end) {
+                for (int i = chunk_begin; i < chunk_end; i++) {
+                    Node &n = nodes[level_nodes[begin + i]];
+                    if (forward)
+                        update_arrival(n);
+                    else
+                        update_required(n);
+                    n.fwd_dirty = n.bwd_dirty = false;
+                }
+            });
+        };
+        int num_levels = int(level_begin.size()) - 1;
+        for (int l = 0; l < num_levels; l++)
+            update_level(l, true);
+        for (int l = num_levels - 1; l >= 0; l--)
+            update_level(l, false);
+        fwd_lo = std::numeric_limits<int>::max();
+        bwd_hi = -1;
+        full_update = false;
+    }
+
+    void get_criticalities(NetCriticalityMap *net_crit)
+    {
+        NPNR_TRACE_SCOPE("get criticalities");
+        propagate();
+
+        // The criticality normalisation depends on the worst slack and delay of each clock domain, which can change
+        // from anywhere in the design; so this last step always covers the whole graph, but is cheap compared to the
+        // propagation.
+        int chunks = num_chunks(int(nodes.size()));
+        std::vector<std::vector<delay_t>> chunk_worst_slack(
+                chunks, std::vector<delay_t>(clocks.size(), std::numeric_limits<delay_t>::max()));
+        std::vector<std::vector<delay_t>> chunk_max_delay(
+                chunks, std::vector<delay_t>(clocks.size(), std::numeric_limits<delay_t>::min()));
+        parallel_chunks(int(nodes.size()), [&](int chunk, int begin, int end) {
+            auto &worst_slack = chunk_worst_slack.at(chunk);
+            auto &max_delay = chunk_max_delay.at(chunk);
+            for (int idx = begin; idx < end; idx++) {
+                const auto &n = nodes[idx];
+                for (int d = n.domain_begin; d < n.domain_end; d++) {
+                    const auto &dd = domains[d];
+                    if (!is_required_domain(dd))
                         continue;
-                    if (nc.criticality.empty())
-                        nc.criticality.resize(net->users.size(), 0);
-                    // Only consider intra-clock paths for criticality
-                    if (!crit_path->count(ClockPair{startdomain.first, startdomain.first}))
+                    for (int u = n.user_begin; u < n.user_end; u++) {
+                        const auto &ud = users[u];
+                        delay_t arrival = dd.arrival + ud.route_delay;
+                        worst_slack[dd.clock] = std::min(
+                                worst_slack[dd.clock], min_required[dd.required_begin + (u - n.user_begin)] - arrival);
+                        for (int e = ud.endpoint_begin; e < ud.endpoint_end; e++)
+                            if (endpoints[e].clock == dd.clock)
+                                max_delay[dd.clock] = std::max(max_delay[dd.clock], arrival + endpoints[e].setup);
+                    }
+                }
+            }
+        });
+        std::vector<delay_t> worst_slack(clocks.size(), std::numeric_limits<delay_t>::max());
+        std::vector<delay_t> max_delay(clocks.size(), std::numeric_limits<delay_t>::min());
+        std::vector<bool> has_max_delay(clocks.size(), false);
+        for (int c = 0; c < chunks; c++) {
+            for (size_t clk = 0; clk < clocks.size(); clk++) {
+                worst_slack[clk] = std::min(worst_slack[clk], chunk_worst_slack[c][clk]);
+                max_delay[clk] = std::max(max_delay[clk], chunk_max_delay[c][clk]);
+            }
+        }
+        for (size_t clk = 0; clk < clocks.size(); clk++)
+            has_max_delay[clk] = (max_delay[clk] != std::numeric_limits<delay_t>::min());
+
+        if (net_crit != crit_map) {
+            crit_map = net_crit;
+            for (auto &n : nodes) {
+                n.has_crit = false;
+                for (int d = n.domain_begin; d < n.domain_end; d++)
+                    if (is_required_domain(domains[d]))
+                        n.has_crit = true;
+            }
+            add_crit_entries(net_crit);
+        }
+        write_criticalities(net_crit, worst_slack, max_delay, has_max_delay);
+    }
+
+    // Clear net_crit, and give every node with has_crit set an entry; the arcs of an entry are the node's users, so
+    // the per-arc arrays have the same layout as users
+    void add_crit_entries(NetCriticalityMap *net_crit)
+    {
+        net_crit->nets.resize(ctx->nets.size());
+        net_crit->clear();
+        net_crit->slack.resize(users.size());
+        net_crit->hold_slack.resize(users.size());
+        net_crit->criticality.resize(users.size());
+        for (auto &n : nodes) {
+            if (!n.has_crit)
+                continue;
+            NPNR_ASSERT(n.net->udata >= 0 && size_t(n.net->udata) < net_crit->nets.size());
+            auto &nc = net_crit->nets[n.net->udata];
+            nc.arc_begin = n.user_begin;
+            nc.arc_end = n.user_end;
+        }
+    }
+
+    // Fill in the NetCriticalityInfo and arcs of every node with a crit entry
+    void write_criticalities(NetCriticalityMap *net_crit, const std::vector<delay_t> &worst_slack,
+                             const std::vector<delay_t> &max_delay, const std::vector<bool> &has_max_delay)
+    {
+        parallel_chunks(int(nodes.size()), [&](int, int begin, int end) {
+            for (int idx = begin; idx < end; idx++) {
+                auto &n = nodes[idx];
+                if (!n.has_crit)
+                    continue;
+                auto &nc = net_crit->nets[n.net->udata];
+                int num_users = n.user_end - n.user_begin;
+                delay_t *arc_slack = net_crit->slack.data() + n.user_begin;
+                delay_t *hold_slack = net_crit->hold_slack.data() + n.user_begin;
+                float *crit = net_crit->criticality.data() + n.user_begin;
+                std::fill(arc_slack, arc_slack + num_users, std::numeric_limits<delay_t>::max());
+                std::fill(hold_slack, hold_slack + num_users, std::numeric_limits<delay_t>::max());
+                std::fill(crit, crit + num_users, 0.0f);
+                nc.max_path_length = 0;
+                nc.cd_worst_slack = std::numeric_limits<delay_t>::max();
+                for (int d = n.domain_begin; d < n.domain_end; d++) {
+                    const auto &dd = domains[d];
+                    if (!is_required_domain(dd))
                         continue;
-                    delay_t dmax = crit_path->at(ClockPair{startdomain.first, startdomain.first}).path_delay;
-                    for (size_t i = 0; i < net->users.size(); i++) {
+                    for (int i = 0; i < num_users; i++) {
+                        delay_t slack = min_required[dd.required_begin + i] -
+                                        (dd.arrival + users[n.user_begin + i].route_delay);
+                        arc_slack[i] = std::min(arc_slack[i], slack);
+                        delay_t hold = hold_required[dd.required_begin + i];
+                        if (hold != std::numeric_limits<delay_t>::min())
+                            hold_slack[i] = std::min(hold_slack[i],
+                                                     dd.min_arrival + users[n.user_begin + i].min_route_delay - hold);
+                        if (!has_max_delay[dd.clock])
+                            continue;
                         float criticality =
-                                1.0f - ((float(nc.slack.at(i)) - float(worst_slack.at(startdomain.first))) / dmax);
-                        nc.criticality.at(i) = std::min<double>(1.0, std::max<double>(0.0, criticality));
+                                1.0f - ((float(slack) - float(worst_slack[dd.clock])) / max_delay[dd.clock]);
+                        criticality = std::min<double>(1.0, std::max<double>(0.0, criticality));
+                        crit[i] = std::max(crit[i], criticality);
+                    }
+                    if (has_max_delay[dd.clock]) {
+                        nc.max_path_length = std::max(nc.max_path_length, dd.path_length);
+                        nc.cd_worst_slack = std::min(nc.cd_worst_slack, worst_slack[dd.clock]);
                     }
-                    nc.max_path_length = nd.max_path_length;
-                    nc.cd_worst_slack = worst_slack.at(startdomain.first);
                 }
             }
-#if 0
-            if (ctx->debug) {
-                for (auto &nc : *net_crit) {
-                    NetInfo *net = ctx->nets.at(nc.first).get();
-                    log_info("Net %s maxlen %d worst_slack %.02fns: \n", nc.first.c_str(ctx), nc.second.max_path_length,
-                             ctx->getDelayNS(nc.second.cd_worst_slack));
-                    if (!nc.second.criticality.empty() && !nc.second.slack.empty()) {
-                        for (size_t i = 0; i < net->users.size(); i++) {
-                            log_info("   user %s.%s slack %.02fns crit %.03f\n", net->users.at(i).cell->name.c_str(ctx),
-                                     net->users.at(i).port.c_str(ctx), ctx->getDelayNS(nc.second.slack.at(i)),
-                                     nc.second.criticality.at(i));
+        });
+    }
+
+    // Run func(dd, endpoint, arrival) for every endpoint of a node's users, in each required domain
+    template <typename Tf> void for_endpoints(const Node &n, Tf func) const
+    {
+        for (int d = n.domain_begin; d < n.domain_end; d++) {
+            const auto &dd = domains[d];
+            if (!is_required_domain(dd))
+                continue;
+            for (int u = n.user_begin; u < n.user_end; u++) {
+                delay_t arrival = dd.arrival + users[u].route_delay;
+                for (int e = users[u].endpoint_begin; e < users[u].endpoint_end; e++)
+                    func(dd, e, arrival);
+            }
+        }
+    }
+
+    // Criticalities of only the arcs that may reach min_criticality, on a freshly set up graph. The worst slack and
+    // delay of each clock domain only depend on endpoint slacks, which are known after the forward pass; required times
+    // are then only propagated back through the fanin cones of the endpoints whose slack is close enough to the worst
+    // for their criticality to reach min_criticality. Any path that critical ends at one of those endpoints, so
+    // criticalities above the threshold are exact, while those below it may be underestimated. Only nets in the cones
+    // get an entry in net_crit.
+    void get_critical_arcs(NetCriticalityMap *net_crit, float min_criticality)
+    {
+        NPNR_TRACE_SCOPE("get critical arcs");
+        NPNR_ASSERT(full_update && dirty_nets.empty());
+        int num_levels = int(level_begin.size()) - 1;
+        for (int l = 0; l < num_levels; l++) {
+            int begin = level_begin.at(l);
+            parallel_chunks(level_begin.at(l + 1) - begin, [&](int, int chunk_begin, int chunk_end) {
+                for (int i = chunk_begin; i < chunk_end; i++)
+                    update_arrival(nodes[level_nodes[begin + i]]);
+            });
+        }
+
+        int chunks = num_chunks(int(nodes.size()));
+        std::vector<std::vector<delay_t>> chunk_worst_slack(
+                chunks, std::vector<delay_t>(clocks.size(), std::numeric_limits<delay_t>::max()));
+        std::vector<std::vector<delay_t>> chunk_max_delay(
+                chunks, std::vector<delay_t>(clocks.size(), std::numeric_limits<delay_t>::min()));
+        parallel_chunks(int(nodes.size()), [&](int chunk, int begin, int end) {
+            auto &worst_slack = chunk_worst_slack.at(chunk);
+            auto &max_delay = chunk_max_delay.at(chunk);
+            for (int idx = begin; idx < end; idx++)
+                for_endpoints(nodes[idx], [&](const DomainData &dd, int e, delay_t arrival) {
+                    const auto &ep = endpoints[e];
+                    worst_slack[dd.clock] =
+                            std::min(worst_slack[dd.clock], get_period(dd.clock, ep.clock) - ep.setup - arrival);
+                    if (ep.clock == dd.clock)
+                        max_delay[dd.clock] = std::max(max_delay[dd.clock], arrival + ep.setup);
+                });
+        });
+        std::vector<delay_t> worst_slack(clocks.size(), std::numeric_limits<delay_t>::max());
+        std::vector<delay_t> max_delay(clocks.size(), std::numeric_limits<delay_t>::min());
+        std::vector<bool> has_max_delay(clocks.size(), false);
+        for (int c = 0; c < chunks; c++) {
+            for (size_t clk = 0; clk < clocks.size(); clk++) {
+                worst_slack[clk] = std::min(worst_slack[clk], chunk_worst_slack[c][clk]);
+                max_delay[clk] = std::max(max_delay[clk], chunk_max_delay[c][clk]);
+            }
+        }
+        // Slack an endpoint may have, at most, for paths to it to reach min_criticality
+        std::vector<delay_t> slack_limit(clocks.size(), std::numeric_limits<delay_t>::min());
+        for (size_t clk = 0; clk < clocks.size(); clk++) {
+            has_max_delay[clk] = (max_delay[clk] != std::numeric_limits<delay_t>::min());
+            if (has_max_delay[clk])
+                slack_limit[clk] = worst_slack[clk] + delay_t((1.0f - min_criticality) * max_delay[clk]);
+        }
+
+        // Backward pass over the fanin cones of the near-critical endpoints only; nodes outside the cones keep their
+        // initial unconstrained required times
+        std::vector<char> in_cone(nodes.size(), 0);
+        for (int l = num_levels - 1; l >= 0; l--) {
+            int begin = level_begin.at(l);
+            parallel_chunks(level_begin.at(l + 1) - begin, [&](int, int chunk_begin, int chunk_end) {
+                for (int i = chunk_begin; i < chunk_end; i++) {
+                    int idx = level_nodes[begin + i];
+                    Node &n = nodes[idx];
+                    bool cone = false;
+                    for (int u = n.user_begin; u < n.user_end && !cone; u++)
+                        for (int a = users[u].arc_begin; a < users[u].arc_end && !cone; a++)
+                            cone = arcs[a].backward && in_cone[arcs[a].dst];
+                    if (!cone)
+                        for_endpoints(n, [&](const DomainData &dd, int e, delay_t arrival) {
+                            const auto &ep = endpoints[e];
+                            if (get_period(dd.clock, ep.clock) - ep.setup - arrival <= slack_limit[dd.clock])
+                                cone = true;
+                        });
+                    if (!cone)
+                        continue;
+                    in_cone[idx] = 1;
+                    update_required(n);
+                }
+            });
+        }
+        fwd_lo = std::numeric_limits<int>::max();
+        bwd_hi = -1;
+        full_update = false;
+
+        // A later get_criticalities must not reuse these entries
+        crit_map = nullptr;
+        for (size_t idx = 0; idx < nodes.size(); idx++) {
+            auto &n = nodes[idx];
+            n.fwd_dirty = n.bwd_dirty = false;
+            n.has_crit = false;
+            if (!in_cone[idx])
+                continue;
+            for (int d = n.domain_begin; d < n.domain_end; d++)
+                if (is_required_domain(domains[d]))
+                    n.has_crit = true;
+        }
+        add_crit_entries(net_crit);
+        write_criticalities(net_crit, worst_slack, max_delay, has_max_delay);
+    }
+
+    // Find the critical path for each pair of launching and capturing clocks, and optionally the slack
+    // histogram over all endpoints and the worst hold slack of each clock, as reported by timing_analysis
+    void get_crit_paths(CriticalPathMap *crit_path, DelayFrequency *slack_histogram,
+                        std::unordered_map<ClockEvent, delay_t> *hold_slack = nullptr)
+    {
+        NPNR_TRACE_SCOPE("get critical paths");
+        propagate();
+
+        struct CritEnd
+        {
+            delay_t arrival;
+            int node, user, clock;
+        };
+        std::unordered_map<ClockPair, CritEnd> crit_ends;
+        for (int idx = int(nodes.size()) - 1; idx >= 0; idx--) {
+            const auto &n = nodes[idx];
+            for (int d = n.domain_begin; d < n.domain_end; d++) {
+                const auto &dd = domains[d];
+                if (dd.false_startpoint)
+                    continue;
+                for (int u = n.user_begin; u < n.user_end; u++) {
+                    const auto &ud = users[u];
+                    for (int e = ud.endpoint_begin; e < ud.endpoint_end; e++) {
+                        const auto &ep = endpoints[e];
+                        if (hold_slack && ep.clock == dd.clock && is_required_domain(dd)) {
+                            delay_t slack = dd.min_arrival + ud.min_route_delay - ep.hold;
+                            auto fnd = hold_slack->find(clocks.at(dd.clock));
+                            if (fnd == hold_slack->end())
+                                hold_slack->emplace(clocks.at(dd.clock), slack);
+                            else
+                                fnd->second = std::min(fnd->second, slack);
+                        }
+                        delay_t endpoint_arrival = dd.arrival + ud.route_delay + ep.setup;
+                        delay_t period = get_period(dd.clock, ep.clock);
+                        if (slack_histogram) {
+                            int slack_ps = ctx->getDelayNS(period - endpoint_arrival) * 1000;
+                            (*slack_histogram)[slack_ps]++;
+                        }
+                        if (crit_path) {
+                            ClockPair clockPair{clocks.at(dd.clock), clocks.at(ep.clock)};
+                            auto fnd = crit_ends.find(clockPair);
+                            if (fnd == crit_ends.end() || fnd->second.arrival < endpoint_arrival) {
+                                crit_ends[clockPair] = CritEnd{endpoint_arrival, idx, u, dd.clock};
+                                (*crit_path)[clockPair].path_delay = endpoint_arrival;
+                                (*crit_path)[clockPair].path_period = period;
+                            }
                         }
                     }
-                    log_break();
                 }
             }
-#endif
         }
-        return min_slack;
+
+        if (!crit_path)
+            return;
+        // Walk backwards from each critical endpoint, following the fanin with the latest arrival
+        for (auto &ce : crit_ends) {
+            auto &cp_ports = (*crit_path)[ce.first].ports;
+            cp_ports.clear();
+            int idx = ce.second.node, user = ce.second.user;
+            while (true) {
+                const auto &n = nodes[idx];
+                cp_ports.push_back(&n.net->users.at(user - n.user_begin));
+                int crit_fanin = -1;
+                delay_t max_arrival = std::numeric_limits<delay_t>::min();
+                for (int f = n.fanin_begin; f < n.fanin_end; f++) {
+                    const auto &fi = fanins[f];
+                    if (!fi.forward)
+                        continue;
+                    int sd = domain_index(nodes[fi.src], ce.second.clock);
+                    if (sd == -1)
+                        continue;
+                    delay_t arrival = domains[sd].arrival + users[fi.src_user].route_delay + fi.delay;
+                    if (arrival > max_arrival) {
+                        max_arrival = arrival;
+                        crit_fanin = f;
+                    }
+                }
+                if (crit_fanin == -1)
+                    break;
+                idx = fanins[crit_fanin].src;
+                user = fanins[crit_fanin].src_user;
+            }
+            std::reverse(cp_ports.begin(), cp_ports.end());
+        }
     }
 
-    void assign_budget()
+    // A path found by get_worst_paths, between launching and capturing clocks (indices into clocks), as the net
+    // users it passes through from its startpoint to its endpoint
+    struct WorstPath
     {
-        // Clear delays to a very high value first
-        for (auto &net : ctx->nets) {
-            for (auto &usr : net.second->users) {
-                usr.budget = std::numeric_limits<delay_t>::max();
+        int launch, capture;
+        delay_t slack, delay, period;
+        std::vector<PortRef *> ports;
+    };
+
+    // The k paths with the worst setup slack over all clock pairs, worst first, by deviation from the critical paths.
+    // A candidate path is fixed from its endpoint back to its last deviation, and from there follows the latest
+    // arriving fanin of each net. Completing the worst candidate adds, for every net after its last deviation, the
+    // candidates taking one of the other fanins (or starting there), with slack worse by how much earlier that
+    // arrives; so each path is found once, and in order of slack. Only the k worst endpoints can end any of the k
+    // worst paths, as every other path ends at an endpoint whose own critical path is no worse; those endpoints are
+    // found in parallel.
+    void get_worst_paths(int k, std::vector<WorstPath> &paths)
+    {
+        NPNR_TRACE_SCOPE("get worst paths");
+        paths.clear();
+        if (k <= 0)
+            return;
+        propagate();
+
+        struct Candidate
+        {
+            delay_t slack;
+            int launch, capture;
+            delay_t period;
+            // Node and user index of the net users from the endpoint back to the last deviation, and whether the
+            // path starts at the net of the last one
+            std::vector<std::pair<int, int>> steps;
+            bool started = false;
+        };
+        auto worse = [](const Candidate &a, const Candidate &b) {
+            if (a.slack != b.slack)
+                return a.slack < b.slack;
+            if (a.steps.front() != b.steps.front())
+                return a.steps.front() < b.steps.front();
+            if (a.launch != b.launch)
+                return a.launch < b.launch;
+            return a.capture < b.capture;
+        };
+        auto keep_worst = [&](std::vector<Candidate> &cands) {
+            if (int(cands.size()) <= k)
+                return;
+            std::nth_element(cands.begin(), cands.begin() + (k - 1), cands.end(), worse);
+            cands.resize(k);
+        };
+
+        int chunks = num_chunks(int(nodes.size()));
+        std::vector<std::vector<Candidate>> chunk_ends(chunks);
+        parallel_chunks(int(nodes.size()), [&](int chunk, int begin, int end) {
+            auto &ends = chunk_ends.at(chunk);
+            for (int idx = begin; idx < end; idx++) {
+                const auto &n = nodes[idx];
+                for (int d = n.domain_begin; d < n.domain_end; d++) {
+                    const auto &dd = domains[d];
+                    if (!is_required_domain(dd))
+                        continue;
+                    for (int u = n.user_begin; u < n.user_end; u++) {
+                        delay_t arrival = dd.arrival + users[u].route_delay;
+                        for (int e = users[u].endpoint_begin; e < users[u].endpoint_end; e++) {
+                            const auto &ep = endpoints[e];
+                            Candidate c;
+                            c.launch = dd.clock;
+                            c.capture = ep.clock;
+                            c.period = get_period(dd.clock, ep.clock);
+                            c.slack = c.period - ep.setup - arrival;
+                            c.steps.emplace_back(idx, u);
+                            ends.push_back(std::move(c));
+                        }
+                    }
+                    if (int(ends.size()) > 2 * k)
+                        keep_worst(ends);
+                }
             }
-        }
+            keep_worst(ends);
+        });
 
-        walk_paths();
+        std::vector<Candidate> cands;
+        for (auto &ends : chunk_ends)
+            for (auto &c : ends)
+                cands.push_back(std::move(c));
+        keep_worst(cands);
+        // Candidates are popped worst first, and in order of creation among equal slacks, so the result only
+        // depends on the graph
+        auto cmp = [&](int a, int b) {
+            if (cands[a].slack != cands[b].slack)
+                return cands[a].slack > cands[b].slack;
+            return a > b;
+        };
+        std::sort(cands.begin(), cands.end(), worse);
+        std::priority_queue<int, std::vector<int>, decltype(cmp)> queue(cmp);
+        for (int i = 0; i < int(cands.size()); i++)
+            queue.push(i);
+
+        while (!queue.empty() && int(paths.size()) < k) {
+            int ci = queue.top();
+            queue.pop();
+            auto steps = std::move(cands[ci].steps);
+            bool started = cands[ci].started;
+            delay_t slack = cands[ci].slack;
+            int launch = cands[ci].launch, capture = cands[ci].capture;
+            delay_t period = cands[ci].period;
+            auto add_candidate = [&](delay_t dev_slack, size_t len, const std::pair<int, int> *next) {
+                Candidate c;
+                c.slack = dev_slack;
+                c.launch = launch;
+                c.capture = capture;
+                c.period = period;
+                c.steps.assign(steps.begin(), steps.begin() + len);
+                if (next != nullptr)
+                    c.steps.push_back(*next);
+                else
+                    c.started = true;
+                cands.push_back(std::move(c));
+                queue.push(int(cands.size()) - 1);
+            };
+            for (size_t s = steps.size() - 1; !started; s++) {
+                const auto &n = nodes[steps[s].first];
+                int d = domain_index(n, launch);
+                NPNR_ASSERT(d != -1);
+                const auto &dd = domains[d];
+                // Follow the latest arriving fanin, or start here if that arrives later
+                int crit_fanin = -1;
+                delay_t crit_arrival = std::numeric_limits<delay_t>::min();
+                for (int f = n.fanin_begin; f < n.fanin_end; f++) {
+                    const auto &fi = fanins[f];
+                    if (!fi.forward)
+                        continue;
+                    int sd = domain_index(nodes[fi.src], launch);
+                    if (sd == -1 || domains[sd].false_startpoint)
+                        continue;
+                    delay_t arrival = domains[sd].arrival + users[fi.src_user].route_delay + fi.delay;
+                    if (arrival > crit_arrival) {
+                        crit_arrival = arrival;
+                        crit_fanin = f;
+                    }
+                }
+                if (dd.startpoint && (crit_fanin == -1 || dd.start_arrival > crit_arrival)) {
+                    crit_fanin = -1;
+                    crit_arrival = dd.start_arrival;
+                }
+                // Deviations to every other fanin, and to starting here
+                for (int f = n.fanin_begin; f < n.fanin_end; f++) {
+                    const auto &fi = fanins[f];
+                    if (f == crit_fanin || !fi.forward)
+                        continue;
+                    int sd = domain_index(nodes[fi.src], launch);
+                    if (sd == -1 || domains[sd].false_startpoint)
+                        continue;
+                    delay_t arrival = domains[sd].arrival + users[fi.src_user].route_delay + fi.delay;
+                    std::pair<int, int> next(fi.src, fi.src_user);
+                    add_candidate(slack + (dd.arrival - arrival), s + 1, &next);
+                }
+                if (dd.startpoint && crit_fanin != -1)
+                    add_candidate(slack + (dd.arrival - dd.start_arrival), s + 1, nullptr);
+
+                if (crit_arrival != std::numeric_limits<delay_t>::min())
+                    slack += dd.arrival - crit_arrival;
+                if (crit_fanin == -1)
+                    started = true;
+                else
+                    steps.emplace_back(fanins[crit_fanin].src, fanins[crit_fanin].src_user);
+            }
+
+            paths.emplace_back();
+            auto &path = paths.back();
+            path.launch = launch;
+            path.capture = capture;
+            path.slack = slack;
+            path.period = period;
+            path.delay = period - slack;
+            for (auto &step : boost::adaptors::reverse(steps)) {
+                const auto &n = nodes[step.first];
+                path.ports.push_back(&n.net->users.at(step.second - n.user_begin));
+            }
+        }
     }
 };
 
@@ -680,6 +1654,7 @@ void assign_budget(Context *ctx, bool quiet)
                  ctx->setting<float>("target_freq") / 1e6);
     }
 
+    PerfScope scope("sta budget");
     Timing timing(ctx, ctx->setting<int>("slack_redist_iter") > 0 /* net_delays */, true /* update */);
     timing.assign_budget();
 
@@ -717,6 +1692,16 @@ void assign_budget(Context *ctx, bool quiet)
         log_info("Checksum: 0x%08x\n", ctx->checksum());
 }
 
+double achieved_fmax(Context *ctx)
+{
+    Timing timing(ctx, true /* net_delays */, false /* update */);
+    delay_t slack = timing.walk_paths();
+    delay_t period = ctx->getDelayFromNS(1.0e9 / ctx->setting<float>("target_freq")).maxDelay();
+    if (period - slack <= 0)
+        return 0;
+    return 1.0e9 / ctx->getDelayNS(period - slack);
+}
+
 void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool print_path, bool warn_on_failure)
 {
     auto format_event = [ctx](const ClockEvent &e, int field_width = 0) {
@@ -732,10 +1717,14 @@ void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool p
 
     CriticalPathMap crit_paths;
     DelayFrequency slack_histogram;
-
-    Timing timing(ctx, true /* net_delays */, false /* update */, (print_path || print_fmax) ? &crit_paths : nullptr,
-                  print_histogram ? &slack_histogram : nullptr);
-    timing.walk_paths();
+    std::unordered_map<ClockEvent, delay_t> hold_slack;
+
+    PerfScope sta_scope("sta");
+    TimingGraph timing(ctx);
+    timing.setup();
+    timing.get_crit_paths((print_path || print_fmax) ? &crit_paths : nullptr,
+                          print_histogram ? &slack_histogram : nullptr, print_fmax ? &hold_slack : nullptr);
+    sta_scope.stop();
     std::map<IdString, std::pair<ClockPair, CriticalPath>> clock_reports;
     std::map<IdString, double> clock_fmax;
     std::vector<ClockPair> xclock_paths;
@@ -908,6 +1897,22 @@ void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool p
             auto &crit_path = crit_paths.at(xclock).ports;
             print_path_report(xclock, crit_path);
         }
+
+        // The worst paths over all clock pairs, from the same analysis
+        int num_worst = ctx->setting<int>("timing/worstPaths", 0);
+        std::vector<TimingGraph::WorstPath> worst_paths;
+        timing.get_worst_paths(num_worst, worst_paths);
+        for (size_t i = 0; i < worst_paths.size(); i++) {
+            auto &wp = worst_paths.at(i);
+            ClockPair clocks{timing.clocks.at(wp.launch), timing.clocks.at(wp.capture)};
+            log_break();
+            std::string start = format_event(clocks.start);
+            std::string end = format_event(clocks.end);
+            log_info("Worst path %d of %d ('%s' -> '%s'), slack %.02f ns:\n", int(i + 1), int(worst_paths.size()),
+                     start.c_str(), end.c_str(), ctx->getDelayNS(wp.slack));
+            PortRefVector ports(wp.ports.begin(), wp.ports.end());
+            print_path_report(clocks, ports);
+        }
     }
     if (print_fmax) {
         log_break();
@@ -938,6 +1943,24 @@ void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool p
         }
         log_break();
 
+        // Hold slacks use the fast corner delays, from the same analysis pass
+        std::vector<std::pair<ClockEvent, delay_t>> holds(hold_slack.begin(), hold_slack.end());
+        std::sort(holds.begin(), holds.end(),
+                  [ctx](const std::pair<ClockEvent, delay_t> &a, const std::pair<ClockEvent, delay_t> &b) {
+                      if (a.first.clock != b.first.clock)
+                          return a.first.clock.str(ctx) < b.first.clock.str(ctx);
+                      return a.first.edge < b.first.edge;
+                  });
+        for (auto &hold : holds) {
+            auto ev = format_event(hold.first);
+            if (hold.second >= 0)
+                log_info("Worst hold slack for %s: %.02f ns (PASS)\n", ev.c_str(), ctx->getDelayNS(hold.second));
+            else
+                log_warning("Worst hold slack for %s: %.02f ns (FAIL)\n", ev.c_str(), ctx->getDelayNS(hold.second));
+        }
+        if (!holds.empty())
+            log_break();
+
         int start_field_width = 0, end_field_width = 0;
         for (auto &xclock : xclock_paths) {
             start_field_width = std::max((int)format_event(xclock.start).length(), start_field_width);
@@ -982,10 +2005,65 @@ void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool p
 
 void get_criticalities(Context *ctx, NetCriticalityMap *net_crit)
 {
-    CriticalPathMap crit_paths;
-    net_crit->clear();
-    Timing timing(ctx, true, true, &crit_paths, nullptr, net_crit);
-    timing.walk_paths();
+    PerfScope scope("sta");
+    TimingGraph timing(ctx);
+    timing.setup();
+    timing.get_criticalities(net_crit);
+}
+
+void get_worst_paths(Context *ctx, int k, std::vector<TimingPath> *paths)
+{
+    PerfScope scope("sta");
+    TimingGraph timing(ctx);
+    timing.setup();
+    std::vector<TimingGraph::WorstPath> worst_paths;
+    timing.get_worst_paths(k, worst_paths);
+    paths->clear();
+    for (auto &wp : worst_paths)
+        paths->push_back(TimingPath{std::move(wp.ports), wp.slack, wp.delay, wp.period});
+}
+
+void get_critical_arcs(Context *ctx, NetCriticalityMap *net_crit, float min_criticality)
+{
+    PerfScope scope("sta");
+    TimingGraph timing(ctx);
+    timing.setup();
+    timing.get_critical_arcs(net_crit, min_criticality);
+}
+
+void assign_net_udata(Context *ctx)
+{
+    int32_t i = 0;
+    for (auto &net : ctx->nets)
+        net.second->udata = i++;
+}
+
+TimingAnalyser::TimingAnalyser(Context *ctx) : graph(new TimingGraph(ctx)) {}
+
+TimingAnalyser::~TimingAnalyser() {}
+
+void TimingAnalyser::setup()
+{
+    PerfScope scope("sta setup");
+    graph->setup();
+}
+
+void TimingAnalyser::mark_dirty(const NetInfo *net) { graph->mark_dirty(net); }
+
+void TimingAnalyser::get_criticalities(NetCriticalityMap *net_crit)
+{
+    PerfScope scope("sta");
+    graph->get_criticalities(net_crit);
+}
+
+void TimingAnalyser::get_worst_paths(int k, std::vector<TimingPath> *paths)
+{
+    PerfScope scope("sta");
+    std::vector<TimingGraph::WorstPath> worst_paths;
+    graph->get_worst_paths(k, worst_paths);
+    paths->clear();
+    for (auto &wp : worst_paths)
+        paths->push_back(TimingPath{std::move(wp.ports), wp.slack, wp.delay, wp.period});
 }
 
 NEXTPNR_NAMESPACE_END
@@ -32,18 +32,89 @@ void assign_budget(Context *ctx, bool quiet = false);
 void timing_analysis(Context *ctx, bool slack_histogram = true, bool print_fmax = true, bool print_path = false,
                      bool warn_on_failure = false);
 
-// Data for the timing optimisation algorithm
+// The frequency in Hz that the design would meet with its current placement and routing (estimated delays for unrouted
+// arcs), going by the worst setup slack at the target frequency; 0 if there are no constrained paths
+double achieved_fmax(Context *ctx);
+
+// Data for the timing optimisation algorithm, for one net
 struct NetCriticalityInfo
 {
-    // One each per user
-    std::vector<delay_t> slack;
-    std::vector<float> criticality;
+    // The net's arcs in the slack, hold_slack and criticality arrays of its NetCriticalityMap, -1 if it has no entry
+    int arc_begin = -1, arc_end = -1;
     unsigned max_path_length = 0;
     delay_t cd_worst_slack = std::numeric_limits<delay_t>::max();
 };
 
-typedef std::unordered_map<IdString, NetCriticalityInfo> NetCriticalityMap;
+// Criticalities of every net, indexed by NetInfo::udata, which the caller must have set to a dense index of the nets
+// (0 to nets.size() - 1, see assign_net_udata). Per-arc values are in flat arrays shared by all nets, so that filling
+// the same map again reuses its storage.
+struct NetCriticalityMap
+{
+    std::vector<NetCriticalityInfo> nets;
+    // One each per arc
+    std::vector<delay_t> slack;
+    // Slack of the fastest path through the arc against hold checks, max() if it reaches none
+    std::vector<delay_t> hold_slack;
+    std::vector<float> criticality;
+
+    // Whether the net has an entry, with at least one arc
+    bool has(const NetInfo *ni) const
+    {
+        return ni->udata >= 0 && size_t(ni->udata) < nets.size() &&
+               nets[ni->udata].arc_end > nets[ni->udata].arc_begin;
+    }
+    const NetCriticalityInfo &at(const NetInfo *ni) const { return nets.at(ni->udata); }
+    int num_arcs(const NetInfo *ni) const { return has(ni) ? (at(ni).arc_end - at(ni).arc_begin) : 0; }
+    float arc_criticality(const NetInfo *ni, size_t user) const { return criticality.at(at(ni).arc_begin + user); }
+    delay_t arc_slack(const NetInfo *ni, size_t user) const { return slack.at(at(ni).arc_begin + user); }
+    delay_t arc_hold_slack(const NetInfo *ni, size_t user) const { return hold_slack.at(at(ni).arc_begin + user); }
+    // Remove all entries, keeping the storage
+    void clear() { nets.assign(nets.size(), NetCriticalityInfo()); }
+};
+
+// Set the udata of every net to a dense index, for callers of get_criticalities that don't already use it for one
+void assign_net_udata(Context *ctx);
+
 void get_criticalities(Context *ctx, NetCriticalityMap *net_crit);
+// Cheaper variant for when only the most critical arcs matter: only nets with arcs that may have a criticality of at
+// least min_criticality get an entry, and criticalities are only exact for arcs at or above it
+void get_critical_arcs(Context *ctx, NetCriticalityMap *net_crit, float min_criticality);
+
+// A path through the design: the net users it passes through, from the net driven by its startpoint to its endpoint,
+// with its setup slack, delay (including the endpoint's setup time) and clock period
+struct TimingPath
+{
+    std::vector<PortRef *> ports;
+    delay_t slack, delay, period;
+};
+
+// The k paths with the worst setup slack over all pairs of launching and capturing clocks, worst first. Unlike the
+// critical path reports, these may share nets, and several may end at the same endpoint.
+void get_worst_paths(Context *ctx, int k, std::vector<TimingPath> *paths);
+
+struct TimingGraph;
+
+// Persistent timing graph, for repeated criticality queries on a placed design such as between
+// router iterations. setup() builds the graph once; after that, only nets passed to mark_dirty()
+// have their delays re-queried, and times are only re-propagated through the affected cone.
+struct TimingAnalyser
+{
+    TimingAnalyser(Context *ctx);
+    ~TimingAnalyser();
+
+    // (Re)build the graph, must be called again if the netlist or placement changes
+    void setup();
+    // Mark a net whose routing (and therefore delay) has changed
+    void mark_dirty(const NetInfo *net);
+    // Update timing, and write criticalities in the same format as get_criticalities. Entries are
+    // updated in place rather than the map being cleared, so pass the same map on every call
+    void get_criticalities(NetCriticalityMap *net_crit);
+    // Update timing, and find the k worst paths as get_worst_paths does
+    void get_worst_paths(int k, std::vector<TimingPath> *paths);
+
+  private:
+    std::unique_ptr<TimingGraph> graph;
+};
 
 NEXTPNR_NAMESPACE_END
 
@@ -0,0 +1,234 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "timing_db.h"
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include "log.h"
+#include "nextpnr.h"
+#include "timing.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+/*
+ * Timing database layout, all integers and floats are native endian:
+ *
+ *   char[8]  magic "NPTMDB01"
+ *   u32      format version
+ *   u32      number of strings
+ *   u32      number of net arcs
+ *   u32      number of cell arcs
+ *   u64      file offset of the string offsets
+ *   u64      file offset of the string data
+ *   u64      file offset of the net arcs
+ *   u64      file offset of the cell arcs
+ *
+ * Each section starts on an 8 byte boundary. The string offsets are one u32 per string, pointing into the string
+ * data, where each string is NUL terminated; cell, net and port names are stored as indices into this table.
+ *
+ * A net arc, from the driver of a net to one of its users, is 40 bytes:
+ *   u32 net, u32 driver cell, u32 driver port, u32 user cell, u32 user port,
+ *   f32 routed delay, f32 fast corner routed delay, f32 setup slack, f32 hold slack, f32 criticality
+ * A cell arc is 24 bytes:
+ *   u32 cell, u32 from port, u32 to port, u32 kind, f32 fast corner delay, f32 slow corner delay
+ * where kind is 0 for a combinational arc between the ports, 1 for a setup check and 2 for a hold check of the to
+ * port against the from (clock) port, and 3 for the clock-to-output delay from the clock port. All times are in ns;
+ * slacks are NaN for arcs that no timing check constrains.
+ */
+
+namespace {
+
+const char timing_db_magic[8] = {'N', 'P', 'T', 'M', 'D', 'B', '0', '1'};
+const uint32_t timing_db_version = 1;
+
+enum CellArcKind : uint32_t
+{
+    CELL_ARC_COMB = 0,
+    CELL_ARC_SETUP = 1,
+    CELL_ARC_HOLD = 2,
+    CELL_ARC_CLOCK_TO_OUT = 3,
+};
+
+struct TimingDbWriter
+{
+    TimingDbWriter(Context *ctx) : ctx(ctx){};
+    Context *ctx;
+
+    std::string string_data, net_arcs, cell_arcs;
+    std::vector<uint32_t> string_offsets;
+    // IdString index to string table index
+    std::vector<uint32_t> id_index;
+    uint32_t num_net_arcs = 0, num_cell_arcs = 0;
+
+    template <typename T> static void put(std::string &buf, T value)
+    {
+        buf.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    uint32_t add_id(IdString id)
+    {
+        if (id.index >= int(id_index.size()))
+            id_index.resize(id.index + 1, std::numeric_limits<uint32_t>::max());
+        uint32_t &idx = id_index.at(id.index);
+        if (idx == std::numeric_limits<uint32_t>::max()) {
+            idx = uint32_t(string_offsets.size());
+            string_offsets.push_back(uint32_t(string_data.size()));
+            string_data += id.c_str(ctx);
+            string_data += '\0';
+        }
+        return idx;
+    }
+
+    float to_ns(delay_t delay) { return ctx->getDelayNS(delay); }
+    float slack_ns(delay_t slack)
+    {
+        return slack == std::numeric_limits<delay_t>::max() ? std::numeric_limits<float>::quiet_NaN() : to_ns(slack);
+    }
+
+    void write_net_arcs()
+    {
+        NetCriticalityMap net_crit;
+        assign_net_udata(ctx);
+        get_criticalities(ctx, &net_crit);
+        for (auto &net : ctx->nets) {
+            const NetInfo *ni = net.second.get();
+            if (ni->driver.cell == nullptr)
+                continue;
+            int num_arcs = net_crit.num_arcs(ni);
+            for (size_t i = 0; i < ni->users.size(); i++) {
+                auto &usr = ni->users.at(i);
+                delay_t min_delay;
+                delay_t delay = ctx->getNetinfoRouteDelay(ni, usr, min_delay);
+                put(net_arcs, add_id(ni->name));
+                put(net_arcs, add_id(ni->driver.cell->name));
+                put(net_arcs, add_id(ni->driver.port));
+                put(net_arcs, add_id(usr.cell->name));
+                put(net_arcs, add_id(usr.port));
+                put(net_arcs, to_ns(delay));
+                put(net_arcs, to_ns(min_delay));
+                const delay_t unconstrained = std::numeric_limits<delay_t>::max();
+                bool has_crit = int(i) < num_arcs;
+                put(net_arcs, slack_ns(has_crit ? net_crit.arc_slack(ni, i) : unconstrained));
+                put(net_arcs, slack_ns(has_crit ? net_crit.arc_hold_slack(ni, i) : unconstrained));
+                put(net_arcs, has_crit ? net_crit.arc_criticality(ni, i) : 0.0f);
+                ++num_net_arcs;
+            }
+        }
+    }
+
+    void add_cell_arc(const CellInfo *ci, IdString from, IdString to, CellArcKind kind, const DelayInfo &delay)
+    {
+        put(cell_arcs, add_id(ci->name));
+        put(cell_arcs, add_id(from));
+        put(cell_arcs, add_id(to));
+        put(cell_arcs, uint32_t(kind));
+        put(cell_arcs, to_ns(delay.minDelay()));
+        put(cell_arcs, to_ns(delay.maxDelay()));
+        ++num_cell_arcs;
+    }
+
+    void write_cell_arcs()
+    {
+        std::vector<IdString> inputs, outputs;
+        for (auto &cell : ctx->cells) {
+            const CellInfo *ci = cell.second.get();
+            inputs.clear();
+            outputs.clear();
+            for (auto &port : ci->ports) {
+                if (port.second.net == nullptr)
+                    continue;
+                if (port.second.type == PORT_IN)
+                    inputs.push_back(port.first);
+                else if (port.second.type == PORT_OUT)
+                    outputs.push_back(port.first);
+            }
+            for (IdString from : inputs)
+                for (IdString to : outputs) {
+                    DelayInfo delay;
+                    if (ctx->getCellDelay(ci, from, to, delay))
+                        add_cell_arc(ci, from, to, CELL_ARC_COMB, delay);
+                }
+            for (auto &port : ci->ports) {
+                if (port.second.net == nullptr)
+                    continue;
+                int clocks = 0;
+                TimingPortClass cls = ctx->getPortTimingClass(ci, port.first, clocks);
+                for (int i = 0; i < clocks; i++) {
+                    TimingClockingInfo info = ctx->getPortClockingInfo(ci, port.first, i);
+                    if (cls == TMG_REGISTER_INPUT) {
+                        add_cell_arc(ci, info.clock_port, port.first, CELL_ARC_SETUP, info.setup);
+                        add_cell_arc(ci, info.clock_port, port.first, CELL_ARC_HOLD, info.hold);
+                    } else if (cls == TMG_REGISTER_OUTPUT) {
+                        add_cell_arc(ci, info.clock_port, port.first, CELL_ARC_CLOCK_TO_OUT, info.clockToQ);
+                    }
+                }
+            }
+        }
+    }
+
+    static void pad(std::string &buf)
+    {
+        while (buf.size() % 8 != 0)
+            buf += '\0';
+    }
+
+    void write_file(std::ostream &out)
+    {
+        std::string header(timing_db_magic, sizeof(timing_db_magic));
+        put(header, timing_db_version);
+        put(header, uint32_t(string_offsets.size()));
+        put(header, num_net_arcs);
+        put(header, num_cell_arcs);
+        std::string offsets;
+        offsets.append(reinterpret_cast<const char *>(string_offsets.data()), string_offsets.size() * sizeof(uint32_t));
+        pad(offsets);
+        pad(string_data);
+        pad(net_arcs);
+        uint64_t pos = header.size() + 4 * sizeof(uint64_t);
+        for (const std::string *section : {&offsets, &string_data, &net_arcs}) {
+            put(header, pos);
+            pos += section->size();
+        }
+        put(header, pos);
+        out << header << offsets << string_data << net_arcs << cell_arcs;
+    }
+};
+
+} // namespace
+
+bool write_timing_db(const std::string &filename, Context *ctx)
+{
+    try {
+        std::ofstream out(filename, std::ios::binary);
+        if (!out)
+            log_error("Failed to open timing database '%s' for writing.\n", filename.c_str());
+        TimingDbWriter writer(ctx);
+        writer.write_net_arcs();
+        writer.write_cell_arcs();
+        writer.write_file(out);
+        if (!out)
+            log_error("Failed to write timing database '%s'.\n", filename.c_str());
+        log_info("Wrote timing database with %d net arcs and %d cell arcs to '%s'.\n", int(writer.num_net_arcs),
+                 int(writer.num_cell_arcs), filename.c_str());
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
+NEXTPNR_NAMESPACE_END
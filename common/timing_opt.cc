@@ -35,93 +35,112 @@
 #include "timing.h"
 #include "util.h"
 
-namespace std {
-
-template <> struct hash<std::pair<NEXTPNR_NAMESPACE_PREFIX IdString, NEXTPNR_NAMESPACE_PREFIX IdString>>
-{
-    std::size_t operator()(
-            const std::pair<NEXTPNR_NAMESPACE_PREFIX IdString, NEXTPNR_NAMESPACE_PREFIX IdString> &idp) const noexcept
-    {
-        std::size_t seed = 0;
-        boost::hash_combine(seed, hash<NEXTPNR_NAMESPACE_PREFIX IdString>()(idp.first));
-        boost::hash_combine(seed, hash<NEXTPNR_NAMESPACE_PREFIX IdString>()(idp.second));
-        return seed;
-    }
-};
-
-template <> struct hash<std::pair<int, NEXTPNR_NAMESPACE_PREFIX BelId>>
-{
-    std::size_t operator()(const std::pair<int, NEXTPNR_NAMESPACE_PREFIX BelId> &idp) const noexcept
-    {
-        std::size_t seed = 0;
-        boost::hash_combine(seed, hash<int>()(idp.first));
-        boost::hash_combine(seed, hash<NEXTPNR_NAMESPACE_PREFIX BelId>()(idp.second));
-        return seed;
-    }
-};
-#ifndef ARCH_GENERIC
-template <> struct hash<std::pair<NEXTPNR_NAMESPACE_PREFIX IdString, NEXTPNR_NAMESPACE_PREFIX BelId>>
-{
-    std::size_t
-    operator()(const std::pair<NEXTPNR_NAMESPACE_PREFIX IdString, NEXTPNR_NAMESPACE_PREFIX BelId> &idp) const noexcept
-    {
-        std::size_t seed = 0;
-        boost::hash_combine(seed, hash<NEXTPNR_NAMESPACE_PREFIX IdString>()(idp.first));
-        boost::hash_combine(seed, hash<NEXTPNR_NAMESPACE_PREFIX BelId>()(idp.second));
-        return seed;
-    }
-};
-#endif
-} // namespace std
-
 NEXTPNR_NAMESPACE_BEGIN
 
 class TimingOptimiser
 {
   public:
-    TimingOptimiser(Context *ctx, TimingOptCfg cfg) : ctx(ctx), cfg(cfg){};
+    TimingOptimiser(Context *ctx, TimingOptCfg cfg) : ctx(ctx), cfg(cfg), tmg(ctx){};
     bool optimise()
     {
         log_info("Running timing-driven placement optimisation...\n");
         ctx->lock();
         if (ctx->verbose)
             timing_analysis(ctx, false, true, false, false);
+        // Cells are only swapped between bels of their own type, so the graph stays valid and only the nets of
+        // moved cells need re-timing between iterations
+        tmg.setup();
+        setup_ports();
+        delay_t best_slack = 0;
+        int stalled = 0;
         for (int i = 0; i < 30; i++) {
-            log_info("   Iteration %d...\n", i);
-            get_criticalities(ctx, &net_crit);
+            tmg.get_criticalities(&net_crit);
+            delay_t slack = worst_slack();
+            log_info("   Iteration %d, worst slack %.02f ns...\n", i, ctx->getDelayNS(slack));
+            // Stop once a few iterations in a row haven't improved the worst slack
+            if (i == 0 || slack > best_slack) {
+                best_slack = slack;
+                stalled = 0;
+            } else if (++stalled >= 3) {
+                log_info("   Worst slack has not improved for %d iterations, stopping.\n", stalled);
+                break;
+            }
             setup_delay_limits();
-            auto crit_paths = find_crit_paths(0.98, 50000);
+            auto crit_paths = cfg.worstPaths > 0 ? find_worst_paths() : find_crit_paths(0.98, 50000);
             for (auto &path : crit_paths)
                 optimise_path(path);
             if (ctx->verbose)
                 timing_analysis(ctx, false, true, false, false);
+            ctx->yield();
         }
         ctx->unlock();
         return true;
     }
 
   private:
-    void setup_delay_limits()
+    delay_t worst_slack() const
+    {
+        delay_t worst = std::numeric_limits<delay_t>::max();
+        for (auto &nc : net_crit.nets)
+            for (int a = nc.arc_begin; a < nc.arc_end; a++)
+                worst = std::min(worst, net_crit.slack.at(a));
+        return worst;
+    }
+
+    void mark_cell_dirty(const CellInfo *cell)
+    {
+        for (auto &port : cell->ports) {
+            if (port.second.net == nullptr)
+                continue;
+            tmg.mark_dirty(port.second.net);
+            net_delay_dirty.at(port.second.net->udata) = true;
+        }
+    }
+
+    // Index nets by udata, and give the users of each net consecutive port indices
+    void setup_ports()
     {
-        max_net_delay.clear();
+        nets_by_udata.clear();
+        net_user_start.clear();
+        int num_ports = 0;
         for (auto net : sorted(ctx->nets)) {
             NetInfo *ni = net.second;
-            for (auto usr : ni->users) {
-                max_net_delay[std::make_pair(usr.cell->name, usr.port)] = std::numeric_limits<delay_t>::max();
-            }
-            if (!net_crit.count(net.first))
+            ni->udata = nets_by_udata.size();
+            nets_by_udata.push_back(ni);
+            net_user_start.push_back(num_ports);
+            num_ports += ni->users.size();
+        }
+        net_user_start.push_back(num_ports);
+        port_delay.assign(num_ports, 0);
+        max_net_delay.assign(num_ports, std::numeric_limits<delay_t>::max());
+        net_delay_dirty.assign(nets_by_udata.size(), true);
+    }
+
+    delay_t port_delay_limit(const NetInfo *net, size_t user_idx) const
+    {
+        return max_net_delay.at(net_user_start.at(net->udata) + user_idx);
+    }
+
+    void setup_delay_limits()
+    {
+        for (size_t n = 0; n < nets_by_udata.size(); n++) {
+            NetInfo *ni = nets_by_udata.at(n);
+            int start = net_user_start.at(n), end = net_user_start.at(n + 1);
+            std::fill(max_net_delay.begin() + start, max_net_delay.begin() + end, std::numeric_limits<delay_t>::max());
+            if (!net_crit.has(ni))
                 continue;
-            auto &nc = net_crit.at(net.first);
-            if (nc.slack.empty())
+            auto &nc = net_crit.at(ni);
+            if (nc.max_path_length == 0)
                 continue;
-            for (size_t i = 0; i < ni->users.size(); i++) {
-                auto &usr = ni->users.at(i);
-                delay_t net_delay = ctx->getNetinfoRouteDelay(ni, usr);
-                if (nc.max_path_length != 0) {
-                    max_net_delay[std::make_pair(usr.cell->name, usr.port)] =
-                            net_delay + ((nc.slack.at(i) - nc.cd_worst_slack) / 10);
-                }
+            // Route delays only change for nets of cells that were moved
+            if (net_delay_dirty.at(n)) {
+                for (size_t i = 0; i < ni->users.size(); i++)
+                    port_delay.at(start + i) = ctx->getNetinfoRouteDelay(ni, ni->users.at(i));
+                net_delay_dirty.at(n) = false;
             }
+            for (size_t i = 0; i < ni->users.size(); i++)
+                max_net_delay.at(start + i) =
+                        port_delay.at(start + i) + ((net_crit.arc_slack(ni, i) - nc.cd_worst_slack) / 10);
         }
     }
 
@@ -137,22 +156,22 @@ class TimingOptimiser
             if (port.second.type == PORT_IN) {
                 if (net->driver.cell == nullptr || net->driver.cell->bel == BelId())
                     continue;
-                for (auto user : net->users) {
+                for (size_t i = 0; i < net->users.size(); i++) {
+                    auto &user = net->users.at(i);
                     if (user.cell == cell && user.port == port.first) {
-                        if (ctx->predictDelay(net, user) >
-                            1.1 * max_net_delay.at(std::make_pair(cell->name, port.first)))
+                        if (ctx->predictDelay(net, user) > 1.1 * port_delay_limit(net, i))
                             return false;
                     }
                 }
 
             } else if (port.second.type == PORT_OUT) {
-                for (auto user : net->users) {
+                for (size_t i = 0; i < net->users.size(); i++) {
+                    auto &user = net->users.at(i);
                     // This could get expensive for high-fanout nets??
                     BelId dstBel = user.cell->bel;
                     if (dstBel == BelId())
                         continue;
-                    if (ctx->predictDelay(net, user) >
-                        1.1 * max_net_delay.at(std::make_pair(user.cell->name, user.port))) {
+                    if (ctx->predictDelay(net, user) > 1.1 * port_delay_limit(net, i)) {
 
                         return false;
                     }
@@ -200,12 +219,23 @@ class TimingOptimiser
         return true;
     }
 
-    int find_neighbours(CellInfo *cell, IdString prev_cell, int d, bool allow_swap)
+    // Index of a candidate bel in bel_candidate_cells, adding it if new
+    int candidate_bel_index(BelId bel)
     {
+        auto ins = candidate_bel_idx.emplace(bel, int(bel_candidate_cells.size()));
+        if (ins.second)
+            bel_candidate_cells.emplace_back();
+        return ins.first->second;
+    }
+
+    // Find candidate bels for the cell at position pos in path_cells; prev is the position of the previous cell
+    int find_neighbours(int pos, int prev, int d, bool allow_swap)
+    {
+        CellInfo *cell = path_cells.at(pos);
         BelId curr = cell->bel;
         Loc curr_loc = ctx->getBelLocation(curr);
         int found_count = 0;
-        cell_neighbour_bels[cell->name] = std::unordered_set<BelId>{};
+        cell_neighbour_bels.at(pos).clear();
         for (int dy = -d; dy <= d; dy++) {
             for (int dx = -d; dx <= d; dx++) {
                 // Go through all the Bels at this location
@@ -238,13 +268,13 @@ class TimingOptimiser
                         try_bel = bound_bels_at_loc.at(try_idx);
                         bound_bels_at_loc.erase(bound_bels_at_loc.begin() + try_idx);
                     }
-                    if (bel_candidate_cells.count(try_bel) && !allow_swap) {
+                    auto fnd = candidate_bel_idx.find(try_bel);
+                    if (fnd != candidate_bel_idx.end() && !allow_swap) {
                         // Overlap is only allowed if it is with the previous cell (this is handled by removing those
                         // edges in the graph), or if allow_swap is true to deal with cases where overlap means few
                         // neighbours are identified
-                        if (bel_candidate_cells.at(try_bel).size() > 1 ||
-                            (bel_candidate_cells.at(try_bel).size() == 1 &&
-                             *(bel_candidate_cells.at(try_bel).begin()) != prev_cell))
+                        auto &cands = bel_candidate_cells.at(fnd->second);
+                        if (cands.size() > 1 || (cands.size() == 1 && cands.front() != prev))
                             continue;
                     }
                     // TODO: what else to check here?
@@ -253,18 +283,21 @@ class TimingOptimiser
                 }
 
                 if (candidate != BelId()) {
-                    cell_neighbour_bels[cell->name].insert(candidate);
-                    bel_candidate_cells[candidate].insert(cell->name);
+                    int bel_idx = candidate_bel_index(candidate);
+                    cell_neighbour_bels.at(pos).push_back(candidate);
+                    auto &cands = bel_candidate_cells.at(bel_idx);
+                    cands.push_back(pos);
                     // Work out if we need to delete any overlap
-                    std::vector<IdString> overlap;
-                    for (auto other : bel_candidate_cells[candidate])
-                        if (other != cell->name && other != prev_cell)
+                    std::vector<int> overlap;
+                    for (auto other : cands)
+                        if (other != pos && other != prev)
                             overlap.push_back(other);
                     if (overlap.size() > 0)
                         NPNR_ASSERT(allow_swap);
                     for (auto ov : overlap) {
-                        bel_candidate_cells[candidate].erase(ov);
-                        cell_neighbour_bels[ov].erase(candidate);
+                        cands.erase(std::find(cands.begin(), cands.end(), ov));
+                        auto &ov_bels = cell_neighbour_bels.at(ov);
+                        ov_bels.erase(std::remove(ov_bels.begin(), ov_bels.end(), candidate), ov_bels.end());
                     }
                 }
             }
@@ -283,12 +316,14 @@ class TimingOptimiser
         for (auto net : netnames) {
             if (crit_nets.size() >= max_count)
                 break;
-            if (!net_crit.count(net))
+            NetInfo *ni = ctx->nets.at(net).get();
+            if (!net_crit.has(ni))
                 continue;
-            auto crit_user = std::max_element(net_crit[net].criticality.begin(), net_crit[net].criticality.end());
+            auto &nc = net_crit.at(ni);
+            auto crit_user = std::max_element(net_crit.criticality.begin() + nc.arc_begin,
+                                              net_crit.criticality.begin() + nc.arc_end);
             if (*crit_user > crit_thresh)
-                crit_nets.push_back(
-                        std::make_pair(ctx->nets[net].get(), crit_user - net_crit[net].criticality.begin()));
+                crit_nets.push_back(std::make_pair(ni, crit_user - (net_crit.criticality.begin() + nc.arc_begin)));
         }
 
         auto port_user_index = [](CellInfo *cell, PortInfo &port) -> size_t {
@@ -325,7 +360,7 @@ class TimingOptimiser
                     NetInfo *pn = port.second.net;
                     if (pn == nullptr)
                         continue;
-                    if (!net_crit.count(pn->name) || net_crit.at(pn->name).criticality.empty())
+                    if (!net_crit.has(pn))
                         continue;
                     int ccount;
                     DelayInfo combDelay;
@@ -336,7 +371,7 @@ class TimingOptimiser
                     if (!is_path)
                         continue;
                     size_t user_idx = port_user_index(cell, port.second);
-                    float usr_crit = net_crit.at(pn->name).criticality.at(user_idx);
+                    float usr_crit = net_crit.arc_criticality(pn, user_idx);
                     if (used_ports.count(&(pn->users.at(user_idx))))
                         continue;
                     if (usr_crit >= max_crit) {
@@ -364,7 +399,7 @@ class TimingOptimiser
                     NetInfo *pn = port.second.net;
                     if (pn == nullptr)
                         continue;
-                    if (!net_crit.count(pn->name) || net_crit.at(pn->name).criticality.empty())
+                    if (!net_crit.has(pn))
                         continue;
                     int ccount;
                     DelayInfo combDelay;
@@ -374,12 +409,12 @@ class TimingOptimiser
                     bool is_path = ctx->getCellDelay(cell, fwd_cursor->port, port.first, combDelay);
                     if (!is_path)
                         continue;
-                    auto &crits = net_crit.at(pn->name).criticality;
-                    for (size_t i = 0; i < crits.size(); i++) {
+                    for (int i = 0; i < net_crit.num_arcs(pn); i++) {
                         if (used_ports.count(&(pn->users.at(i))))
                             continue;
-                        if (crits.at(i) >= max_crit) {
-                            max_crit = crits.at(i);
+                        float usr_crit = net_crit.arc_criticality(pn, i);
+                        if (usr_crit >= max_crit) {
+                            max_crit = usr_crit;
                             crit_sink = std::make_pair(pn, i);
                         }
                     }
@@ -400,10 +435,26 @@ class TimingOptimiser
         return crit_paths;
     }
 
+    // The cfg.worstPaths worst paths of the design, leaving out those that share a net user with a worse one
+    std::vector<std::vector<PortRef *>> find_worst_paths()
+    {
+        std::vector<TimingPath> paths;
+        tmg.get_worst_paths(cfg.worstPaths, &paths);
+        std::vector<std::vector<PortRef *>> crit_paths;
+        std::unordered_set<PortRef *> used_ports;
+        for (auto &path : paths) {
+            if (std::any_of(path.ports.begin(), path.ports.end(), [&](PortRef *p) { return used_ports.count(p); }))
+                continue;
+            used_ports.insert(path.ports.begin(), path.ports.end());
+            crit_paths.push_back(std::move(path.ports));
+        }
+        return crit_paths;
+    }
+
     void optimise_path(std::vector<PortRef *> &path)
     {
         path_cells.clear();
-        cell_neighbour_bels.clear();
+        candidate_bel_idx.clear();
         bel_candidate_cells.clear();
         if (ctx->debug)
             log_info("Optimising the following path: \n");
@@ -414,7 +465,7 @@ class TimingOptimiser
             auto front_cell = front_net->driver.cell;
             if (front_cell->belStrength <= STRENGTH_WEAK && cfg.cellTypes.count(front_cell->type) &&
                 front_cell->constr_parent == nullptr && front_cell->constr_children.empty()) {
-                path_cells.push_back(front_cell->name);
+                path_cells.push_back(front_cell);
             }
         }
 
@@ -422,21 +473,21 @@ class TimingOptimiser
             if (ctx->debug) {
                 float crit = 0;
                 NetInfo *pn = port->cell->ports.at(port->port).net;
-                if (net_crit.count(pn->name) && !net_crit.at(pn->name).criticality.empty())
+                if (net_crit.has(pn))
                     for (size_t i = 0; i < pn->users.size(); i++)
                         if (pn->users.at(i).cell == port->cell && pn->users.at(i).port == port->port)
-                            crit = net_crit.at(pn->name).criticality.at(i);
+                            crit = net_crit.arc_criticality(pn, i);
                 log_info("    %s.%s at %s crit %0.02f\n", port->cell->name.c_str(ctx), port->port.c_str(ctx),
                          ctx->getBelName(port->cell->bel).c_str(ctx), crit);
             }
-            if (std::find(path_cells.begin(), path_cells.end(), port->cell->name) != path_cells.end())
+            if (std::find(path_cells.begin(), path_cells.end(), port->cell) != path_cells.end())
                 continue;
             if (port->cell->belStrength > STRENGTH_WEAK || !cfg.cellTypes.count(port->cell->type) ||
                 port->cell->constr_parent != nullptr || !port->cell->constr_children.empty())
                 continue;
             if (ctx->debug)
                 log_info("        can move\n");
-            path_cells.push_back(port->cell->name);
+            path_cells.push_back(port->cell);
         }
 
         if (path_cells.size() < 2) {
@@ -462,39 +513,44 @@ class TimingOptimiser
             }
         }
 
-        IdString last_cell;
         const int d = 2; // FIXME: how to best determine d
-        for (auto cell : path_cells) {
+        int num_cells = int(path_cells.size());
+        cell_neighbour_bels.resize(num_cells);
+        for (int i = 0; i < num_cells; i++) {
             // FIXME: when should we allow swapping due to a lack of candidates
-            find_neighbours(ctx->cells[cell].get(), last_cell, d, false);
-            last_cell = cell;
+            find_neighbours(i, i - 1, d, false);
         }
 
         if (ctx->debug) {
-            for (auto cell : path_cells) {
-                log_info("Candidate neighbours for %s (%s):\n", cell.c_str(ctx),
-                         ctx->getBelName(ctx->cells[cell]->bel).c_str(ctx));
-                for (auto neigh : cell_neighbour_bels.at(cell)) {
+            for (int i = 0; i < num_cells; i++) {
+                log_info("Candidate neighbours for %s (%s):\n", path_cells.at(i)->name.c_str(ctx),
+                         ctx->getBelName(path_cells.at(i)->bel).c_str(ctx));
+                for (auto neigh : cell_neighbour_bels.at(i)) {
                     log_info("    %s\n", ctx->getBelName(neigh).c_str(ctx));
                 }
             }
         }
 
         // Actual BFS path optimisation algorithm
-        std::unordered_map<IdString, std::unordered_map<BelId, delay_t>> cumul_costs;
-        std::unordered_map<std::pair<IdString, BelId>, std::pair<IdString, BelId>> backtrace;
-        std::queue<std::pair<int, BelId>> visit;
-        std::unordered_set<std::pair<int, BelId>> to_visit;
+        // Search states are (position in path, index into that cell's neighbour bels); for each the lowest delay
+        // found so far and the neighbour index at the previous position it was reached from
+        const delay_t unreached = std::numeric_limits<delay_t>::max();
+        cumul_costs.resize(num_cells);
+        backtrace.resize(num_cells);
+        for (int i = 0; i < num_cells; i++) {
+            cumul_costs.at(i).assign(cell_neighbour_bels.at(i).size(), unreached);
+            backtrace.at(i).assign(cell_neighbour_bels.at(i).size(), -1);
+        }
+        std::queue<std::pair<int, int>> visit;
 
-        for (auto startbel : cell_neighbour_bels[path_cells.front()]) {
+        for (int k = 0; k < int(cell_neighbour_bels.front().size()); k++) {
             // Swap for legality check
-            CellInfo *cell = ctx->cells.at(path_cells.front()).get();
-            BelId origBel = cell_swap_bel(cell, startbel);
+            CellInfo *cell = path_cells.front();
+            BelId origBel = cell_swap_bel(cell, cell_neighbour_bels.front().at(k));
             std::vector<std::pair<CellInfo *, BelId>> move{std::make_pair(cell, origBel)};
             if (acceptable_move(move)) {
-                auto entry = std::make_pair(0, startbel);
-                visit.push(entry);
-                cumul_costs[path_cells.front()][startbel] = 0;
+                visit.push(std::make_pair(0, k));
+                cumul_costs.front().at(k) = 0;
             }
             // Swap back
             cell_swap_bel(cell, origBel);
@@ -503,34 +559,32 @@ class TimingOptimiser
         while (!visit.empty()) {
             auto entry = visit.front();
             visit.pop();
-            auto cellname = path_cells.at(entry.first);
-            if (entry.first == int(path_cells.size()) - 1)
+            if (entry.first == num_cells - 1)
                 continue;
             std::vector<std::pair<CellInfo *, BelId>> move;
             // Apply the entire backtrace for accurate legality and delay checks
             // This is probably pretty expensive (but also probably pales in comparison to the number of swaps
             // SA will make...)
-            std::vector<std::pair<IdString, BelId>> route_to_entry;
-            auto cursor = std::make_pair(cellname, entry.second);
-            route_to_entry.push_back(cursor);
-            while (backtrace.count(cursor)) {
-                cursor = backtrace.at(cursor);
+            std::vector<std::pair<int, int>> route_to_entry;
+            for (auto cursor = entry; cursor.second != -1;
+                 cursor = std::make_pair(cursor.first - 1, backtrace.at(cursor.first).at(cursor.second)))
                 route_to_entry.push_back(cursor);
-            }
             for (auto rt_entry : boost::adaptors::reverse(route_to_entry)) {
-                CellInfo *cell = ctx->cells.at(rt_entry.first).get();
-                BelId origBel = cell_swap_bel(cell, rt_entry.second);
+                CellInfo *cell = path_cells.at(rt_entry.first);
+                BelId origBel = cell_swap_bel(cell, cell_neighbour_bels.at(rt_entry.first).at(rt_entry.second));
                 move.push_back(std::make_pair(cell, origBel));
             }
 
             // Have a look at where we can travel from here
-            for (auto neighbour : cell_neighbour_bels.at(path_cells.at(entry.first + 1))) {
+            int next = entry.first + 1;
+            BelId entry_bel = cell_neighbour_bels.at(entry.first).at(entry.second);
+            for (int k = 0; k < int(cell_neighbour_bels.at(next).size()); k++) {
+                BelId neighbour = cell_neighbour_bels.at(next).at(k);
                 // Edges between overlapping bels are deleted
-                if (neighbour == entry.second)
+                if (neighbour == entry_bel)
                     continue;
                 // Experimentally swap the next path cell onto the neighbour bel we are trying
-                IdString ncname = path_cells.at(entry.first + 1);
-                CellInfo *next_cell = ctx->cells.at(ncname).get();
+                CellInfo *next_cell = path_cells.at(next);
                 BelId origBel = cell_swap_bel(next_cell, neighbour);
                 move.push_back(std::make_pair(next_cell, origBel));
 
@@ -551,14 +605,12 @@ class TimingOptimiser
 
                 // First, check if the move is actually worthwhile from a delay point of view before the expensive
                 // legality check
-                if (!cumul_costs.count(ncname) || !cumul_costs.at(ncname).count(neighbour) ||
-                    cumul_costs.at(ncname).at(neighbour) > total_delay) {
+                if (cumul_costs.at(next).at(k) == unreached || cumul_costs.at(next).at(k) > total_delay) {
                     // Now check that the swaps we have made to get here are legal and meet max delay requirements
                     if (acceptable_move(move)) {
-                        cumul_costs[ncname][neighbour] = total_delay;
-                        backtrace[std::make_pair(ncname, neighbour)] = std::make_pair(cellname, entry.second);
-                        if (!to_visit.count(std::make_pair(entry.first + 1, neighbour)))
-                            visit.push(std::make_pair(entry.first + 1, neighbour));
+                        cumul_costs.at(next).at(k) = total_delay;
+                        backtrace.at(next).at(k) = entry.second;
+                        visit.push(std::make_pair(next, k));
                     }
                 }
                 // Revert the experimental swap
@@ -574,30 +626,27 @@ class TimingOptimiser
         }
 
         // Did we find a solution??
-        if (cumul_costs.count(path_cells.back())) {
-            // Find the end position with the lowest total delay
-            auto &end_options = cumul_costs.at(path_cells.back());
-            auto lowest = std::min_element(end_options.begin(), end_options.end(),
-                                           [](const std::pair<BelId, delay_t> &a, const std::pair<BelId, delay_t> &b) {
-                                               return a.second < b.second;
-                                           });
-            NPNR_ASSERT(lowest != end_options.end());
-
-            std::vector<std::pair<IdString, BelId>> route_to_solution;
-            auto cursor = std::make_pair(path_cells.back(), lowest->first);
-            route_to_solution.push_back(cursor);
-            while (backtrace.count(cursor)) {
-                cursor = backtrace.at(cursor);
+        auto &end_options = cumul_costs.back();
+        auto lowest = std::min_element(end_options.begin(), end_options.end());
+        if (lowest != end_options.end() && *lowest != unreached) {
+            // Take the end position with the lowest total delay
+            std::vector<std::pair<int, int>> route_to_solution;
+            for (auto cursor = std::make_pair(num_cells - 1, int(lowest - end_options.begin())); cursor.second != -1;
+                 cursor = std::make_pair(cursor.first - 1, backtrace.at(cursor.first).at(cursor.second)))
                 route_to_solution.push_back(cursor);
-            }
             if (ctx->debug)
-                log_info("Found a solution with cost %.02f ns (existing path %.02f ns)\n",
-                         ctx->getDelayNS(lowest->second), ctx->getDelayNS(original_delay));
+                log_info("Found a solution with cost %.02f ns (existing path %.02f ns)\n", ctx->getDelayNS(*lowest),
+                         ctx->getDelayNS(original_delay));
             for (auto rt_entry : boost::adaptors::reverse(route_to_solution)) {
-                CellInfo *cell = ctx->cells.at(rt_entry.first).get();
-                cell_swap_bel(cell, rt_entry.second);
+                CellInfo *cell = path_cells.at(rt_entry.first);
+                BelId bel = cell_neighbour_bels.at(rt_entry.first).at(rt_entry.second);
+                CellInfo *other = ctx->getBoundBelCell(bel);
+                cell_swap_bel(cell, bel);
+                mark_cell_dirty(cell);
+                if (other != nullptr && other != cell)
+                    mark_cell_dirty(other);
                 if (ctx->debug)
-                    log_info("    %s at %s\n", rt_entry.first.c_str(ctx), ctx->getBelName(rt_entry.second).c_str(ctx));
+                    log_info("    %s at %s\n", cell->name.c_str(ctx), ctx->getBelName(bel).c_str(ctx));
             }
 
         } else {
@@ -608,16 +657,27 @@ class TimingOptimiser
             log_break();
     }
 
-    // Current candidate Bels for cells (linked in both direction>
-    std::vector<IdString> path_cells;
-    std::unordered_map<IdString, std::unordered_set<BelId>> cell_neighbour_bels;
-    std::unordered_map<BelId, std::unordered_set<IdString>> bel_candidate_cells;
-    // Map cell ports to net delay limit
-    std::unordered_map<std::pair<IdString, IdString>, delay_t> max_net_delay;
-    // Criticality data from timing analysis
+    // Cells on the path being optimised, and their candidate Bels (linked in both directions); cells are referred
+    // to by their position in path_cells and bels by their index in bel_candidate_cells. The vectors are reused
+    // between paths to avoid reallocating them.
+    std::vector<CellInfo *> path_cells;
+    std::vector<std::vector<BelId>> cell_neighbour_bels;
+    std::unordered_map<BelId, int> candidate_bel_idx;
+    std::vector<std::vector<int>> bel_candidate_cells;
+    // BFS state, indexed like cell_neighbour_bels
+    std::vector<std::vector<delay_t>> cumul_costs;
+    std::vector<std::vector<int>> backtrace;
+    // Nets by udata, and the first port index of each net's users; ports are indexed densely by net and user
+    std::vector<NetInfo *> nets_by_udata;
+    std::vector<int> net_user_start;
+    // Route delay and delay limit of each port. Route delays are cached until a cell on the net moves.
+    std::vector<delay_t> port_delay, max_net_delay;
+    std::vector<bool> net_delay_dirty;
+    // Criticality data from timing analysis, kept up to date incrementally
     NetCriticalityMap net_crit;
     Context *ctx;
     TimingOptCfg cfg;
+    TimingAnalyser tmg;
 };
 
 bool timing_opt(Context *ctx, TimingOptCfg cfg) { return TimingOptimiser(ctx, cfg).optimise(); }
@@ -24,12 +24,16 @@ NEXTPNR_NAMESPACE_BEGIN
 
 struct TimingOptCfg
 {
-    TimingOptCfg(Context *ctx) {}
+    TimingOptCfg(Context *ctx) { worstPaths = ctx->setting<int>("timingOpt/worstPaths", 0); }
 
     // The timing optimiser will *only* optimise cells of these types
     // Normally these would only be logic cells (or tiles if applicable), the algorithm makes little sense
     // for other cell types
     std::unordered_set<IdString> cellTypes;
+
+    // Optimise the paths found by get_worst_paths, this many of them, rather than those built by following the most
+    // critical arcs through the most critical nets (0)
+    int worstPaths;
 };
 
 extern bool timing_opt(Context *ctx, TimingOptCfg cfg);
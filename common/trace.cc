@@ -0,0 +1,189 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "trace.h"
+#include <chrono>
+#include <fstream>
+#include "log.h"
+
+#ifndef NO_TRACING
+
+NEXTPNR_NAMESPACE_BEGIN
+
+std::atomic<bool> trace_active(false);
+
+namespace {
+struct TraceEvent
+{
+    const char *name;
+    int64_t start, end;
+    std::string args;
+};
+
+struct ThreadTrace
+{
+    int tid;
+    std::string name;
+    // Set while a live thread is writing to this buffer
+    bool in_use = false;
+    std::vector<TraceEvent> events;
+};
+
+struct TraceState
+{
+    std::mutex mtx;
+    std::chrono::steady_clock::time_point epoch;
+    std::vector<std::unique_ptr<ThreadTrace>> threads;
+};
+
+TraceState &state()
+{
+    static TraceState s;
+    return s;
+}
+
+// Take a free buffer with this name, or a new one, for the calling thread
+ThreadTrace *acquire_buffer(const std::string &name)
+{
+    TraceState &s = state();
+    std::lock_guard<std::mutex> lock(s.mtx);
+    for (auto &t : s.threads) {
+        if (!t->in_use && t->name == name) {
+            t->in_use = true;
+            return t.get();
+        }
+    }
+    s.threads.emplace_back(new ThreadTrace());
+    ThreadTrace *t = s.threads.back().get();
+    t->tid = int(s.threads.size());
+    t->name = name;
+    t->in_use = true;
+    return t;
+}
+
+// The buffer of the calling thread, given back when the thread exits
+struct ThreadSlot
+{
+    ThreadTrace *buf = nullptr;
+    ~ThreadSlot()
+    {
+        if (buf == nullptr)
+            return;
+        std::lock_guard<std::mutex> lock(state().mtx);
+        buf->in_use = false;
+    }
+};
+
+thread_local ThreadSlot thread_slot;
+
+ThreadTrace *thread_buffer()
+{
+    if (thread_slot.buf == nullptr)
+        thread_slot.buf = acquire_buffer("");
+    return thread_slot.buf;
+}
+
+std::string json_escape(const std::string &str)
+{
+    std::string result;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            result += stringf("\\u%04x", c);
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+} // namespace
+
+void trace_enable()
+{
+    state().epoch = std::chrono::steady_clock::now();
+    trace_active = true;
+    trace_thread_name("main");
+}
+
+void trace_thread_name(const std::string &name)
+{
+    ThreadTrace *&buf = thread_slot.buf;
+    if (buf != nullptr && buf->name == name)
+        return;
+    if (buf != nullptr && buf->events.empty()) {
+        // Nothing recorded under the old name yet, so just rename the buffer
+        std::lock_guard<std::mutex> lock(state().mtx);
+        buf->name = name;
+        return;
+    }
+    if (buf != nullptr) {
+        std::lock_guard<std::mutex> lock(state().mtx);
+        buf->in_use = false;
+    }
+    buf = acquire_buffer(name);
+}
+
+int64_t TraceSpan::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - state().epoch)
+            .count();
+}
+
+void TraceSpan::arg(const char *key, const std::string &value)
+{
+    args += stringf("%s\"%s\": \"%s\"", args.empty() ? "" : ", ", key, json_escape(value).c_str());
+}
+
+void TraceSpan::arg(const char *key, int value)
+{
+    args += stringf("%s\"%s\": %d", args.empty() ? "" : ", ", key, value);
+}
+
+void TraceSpan::record() { thread_buffer()->events.push_back(TraceEvent{name, start, now(), std::move(args)}); }
+
+// Must only be called once the traced threads have finished
+bool trace_write(const std::string &filename)
+{
+    std::ofstream out(filename);
+    if (!out)
+        return false;
+    TraceState &s = state();
+    std::lock_guard<std::mutex> lock(s.mtx);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (auto &t : s.threads) {
+        if (t->events.empty())
+            continue;
+        out << (first ? "" : ",\n");
+        out << stringf("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                       "\"args\": {\"name\": \"%s\"}}",
+                       t->tid, json_escape(t->name.empty() ? stringf("thread %d", t->tid) : t->name).c_str());
+        first = false;
+        for (auto &ev : t->events)
+            out << stringf(",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+                           "\"args\": {%s}}",
+                           ev.name, t->tid, ev.start / 1000.0, (ev.end - ev.start) / 1000.0, ev.args.c_str());
+    }
+    out << "\n]}\n";
+    return bool(out);
+}
+
+NEXTPNR_NAMESPACE_END
+
+#endif
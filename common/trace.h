@@ -0,0 +1,95 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Event tracing (--trace), written in the Chrome trace format that chrome://tracing and Perfetto load. Spans are
+// opened with NPNR_TRACE_SCOPE and recorded on whichever thread they run on, each thread into its own buffer, so
+// they are cheap enough for per-net use; while tracing is off a span is a single flag check. Span names must be
+// string literals. The whole facility compiles to nothing when built with -DBUILD_TRACING=OFF.
+#ifndef NO_TRACING
+void trace_enable();
+bool trace_write(const std::string &filename);
+
+extern std::atomic<bool> trace_active;
+
+inline bool trace_enabled() { return trace_active.load(std::memory_order_relaxed); }
+
+// Name the calling thread in the trace. Threads that are given the same name once the previous one has exited share
+// a row, so the short-lived router and timing workers don't add a new row every iteration.
+void trace_thread_name(const std::string &name);
+
+class TraceSpan
+{
+  public:
+    explicit TraceSpan(const char *name) : name(trace_enabled() ? name : nullptr)
+    {
+        if (this->name != nullptr)
+            start = now();
+    }
+    ~TraceSpan()
+    {
+        if (name != nullptr)
+            record();
+    }
+    bool active() const { return name != nullptr; }
+    void arg(const char *key, const std::string &value);
+    void arg(const char *key, int value);
+
+  private:
+    static int64_t now();
+    void record();
+    const char *name;
+    int64_t start = 0;
+    // Preformatted JSON members of the "args" object
+    std::string args;
+};
+
+#define NPNR_TRACE_CONCAT2(a, b) a##b
+#define NPNR_TRACE_CONCAT(a, b) NPNR_TRACE_CONCAT2(a, b)
+#define NPNR_TRACE_SCOPE(name) TraceSpan NPNR_TRACE_CONCAT(trace_span_, __LINE__)(name)
+// The argument value is only evaluated while tracing
+#define NPNR_TRACE_SCOPE_ARG(name, key, value)                                                                         \
+    TraceSpan NPNR_TRACE_CONCAT(trace_span_, __LINE__)(name);                                                          \
+    if (NPNR_TRACE_CONCAT(trace_span_, __LINE__).active())                                                             \
+    NPNR_TRACE_CONCAT(trace_span_, __LINE__).arg(key, value)
+#define NPNR_TRACE_THREAD_NAME(name)                                                                                   \
+    do {                                                                                                               \
+        if (trace_enabled())                                                                                           \
+            trace_thread_name(name);                                                                                   \
+    } while (0)
+#else
+#define NPNR_TRACE_SCOPE(name)                                                                                         \
+    do {                                                                                                               \
+    } while (0)
+#define NPNR_TRACE_SCOPE_ARG(name, key, value)                                                                         \
+    do {                                                                                                               \
+    } while (0)
+#define NPNR_TRACE_THREAD_NAME(name)                                                                                   \
+    do {                                                                                                               \
+    } while (0)
+#endif
+
+NEXTPNR_NAMESPACE_END
+
+#endif
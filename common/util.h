@@ -61,6 +61,16 @@ std::string str_or_default(const std::unordered_map<KeyType, Property> &ct, cons
         return found->second.as_string();
 };
 
+template <typename KeyType, int N>
+std::string str_or_default(const small_dict<KeyType, Property, N> &ct, const KeyType &key, std::string def = "")
+{
+    auto found = ct.find(key);
+    if (found == ct.end())
+        return def;
+    else
+        return found->second.as_string();
+};
+
 // Get a value from a map-style container, converting to int, and returning
 // default if value is not found
 template <typename Container, typename KeyType> int int_or_default(const Container &ct, const KeyType &key, int def = 0)
@@ -86,6 +96,20 @@ int int_or_default(const std::unordered_map<KeyType, Property> &ct, const KeyTyp
     }
 };
 
+template <typename KeyType, int N>
+int int_or_default(const small_dict<KeyType, Property, N> &ct, const KeyType &key, int def = 0)
+{
+    auto found = ct.find(key);
+    if (found == ct.end())
+        return def;
+    else {
+        if (found->second.is_string)
+            return std::stoi(found->second.as_string());
+        else
+            return found->second.as_int64();
+    }
+};
+
 // As above, but convert to bool
 template <typename Container, typename KeyType>
 bool bool_or_default(const Container &ct, const KeyType &key, bool def = false)
@@ -102,6 +126,18 @@ template <typename K, typename V> std::map<K, V *> sorted(const std::unordered_m
     return retVal;
 };
 
+// Snapshot the netlist, so it can be iterated over while cells or nets are being added or removed. The container is
+// already deterministically ordered (by creation), so unlike the above this is just a flat copy of the pointers
+template <typename K, typename V>
+std::vector<std::pair<K, V *>> sorted(const indexed_dict<K, std::unique_ptr<V>> &orig)
+{
+    std::vector<std::pair<K, V *>> retVal;
+    retVal.reserve(orig.size());
+    for (auto &item : orig)
+        retVal.emplace_back(item.first, item.second.get());
+    return retVal;
+};
+
 // Wrap an unordered_set, and allow it to be iterated over sorted by key
 template <typename K> std::set<K> sorted(const std::unordered_set<K> &orig)
 {
@@ -133,6 +133,23 @@ Arch::Arch(ArchArgs args) : args(args)
         log_error("Unsupported package '%s' for '%s'.\n", args.package.c_str(), getChipName().c_str());
 
     bel_to_cell.resize(chip_info->height * chip_info->width * max_loc_bels, nullptr);
+
+    int num_locs = chip_info->height * chip_info->width, num_wires = 0, num_pips = 0;
+    loc_wire_start.resize(num_locs);
+    loc_pip_start.resize(num_locs);
+    for (int i = 0; i < num_locs; i++) {
+        const LocationTypePOD &loc = chip_info->locations[chip_info->location_type[i]];
+        loc_wire_start[i] = num_wires;
+        loc_pip_start[i] = num_pips;
+        num_wires += loc.num_wires;
+        num_pips += loc.num_pips;
+    }
+    wire_to_net.resize(num_wires, nullptr);
+    pip_to_net.resize(num_pips, nullptr);
+    wire_fanout.resize(num_wires, 0);
+    setupWireEstimates();
+    for (auto bel : getBels())
+        bels_by_type[getBelType(bel)].push_back(bel);
 }
 
 // -----------------------------------------------------------------------
@@ -450,41 +467,85 @@ BelId Arch::getBelByLocation(Loc loc) const
 
 // -----------------------------------------------------------------------
 
-delay_t Arch::estimateDelay(WireId src, WireId dst) const
+void Arch::setupWireEstimates()
 {
-    int num_uh = locInfo(dst)->wire_data[dst.index].num_uphill;
-    if (num_uh < 6) {
-        for (auto uh : getPipsUphill(dst)) {
-            if (getPipSrcWire(uh) == src)
-                return getPipDelay(uh).maxDelay();
+    wire_loc_offset.resize(chip_info->num_location_types);
+    for (int t = 0; t < chip_info->num_location_types; t++) {
+        const LocationTypePOD &loc = chip_info->locations[t];
+        auto &offsets = wire_loc_offset.at(t);
+        offsets.resize(loc.num_wires, Location(0, 0));
+        for (int i = 0; i < loc.num_wires; i++) {
+            const auto &wire = loc.wire_data[i];
+            if (wire.num_bel_pins > 0)
+                offsets[i] = Location(wire.bel_pins[0].rel_bel_loc);
+            else if (wire.num_downhill > 0)
+                offsets[i] = Location(wire.pips_downhill[0].rel_loc);
+            else if (wire.num_uphill > 0)
+                offsets[i] = Location(wire.pips_uphill[0].rel_loc);
         }
     }
 
-    auto est_location = [&](WireId w) -> std::pair<int, int> {
-        const auto &wire = locInfo(w)->wire_data[w.index];
-        if (w == gsrclk_wire) {
-            auto phys_wire = getPipSrcWire(*(getPipsUphill(w).begin()));
-            return std::make_pair(int(phys_wire.location.x), int(phys_wire.location.y));
-        } else if (wire.num_bel_pins > 0) {
-            return std::make_pair(w.location.x + wire.bel_pins[0].rel_bel_loc.x,
-                                  w.location.y + wire.bel_pins[0].rel_bel_loc.y);
-        } else if (wire.num_downhill > 0) {
-            return std::make_pair(w.location.x + wire.pips_downhill[0].rel_loc.x,
-                                  w.location.y + wire.pips_downhill[0].rel_loc.y);
-        } else if (wire.num_uphill > 0) {
-            return std::make_pair(w.location.x + wire.pips_uphill[0].rel_loc.x,
-                                  w.location.y + wire.pips_uphill[0].rel_loc.y);
-        } else {
-            return std::make_pair(int(w.location.x), int(w.location.y));
+    wire_uphill_start.clear();
+    wire_uphill.clear();
+    for (int y = 0; y < chip_info->height; y++) {
+        for (int x = 0; x < chip_info->width; x++) {
+            const LocationTypePOD &loc = chip_info->locations[chip_info->location_type[y * chip_info->width + x]];
+            for (int i = 0; i < loc.num_wires; i++) {
+                wire_uphill_start.push_back(int32_t(wire_uphill.size()));
+                const auto &wire = loc.wire_data[i];
+                if (wire.num_uphill >= 6)
+                    continue;
+                for (int j = 0; j < wire.num_uphill; j++) {
+                    PipId pip;
+                    pip.location = Location(x, y) + wire.pips_uphill[j].rel_loc;
+                    pip.index = wire.pips_uphill[j].index;
+                    const PipInfoPOD &pip_data = locInfo(pip)->pip_data[pip.index];
+                    DirectUphill uh;
+                    uh.src_idx = pip_data.src_idx;
+                    uh.rel_src = Location(wire.pips_uphill[j].rel_loc) + pip_data.rel_src_loc;
+                    uh.timing_class = pip_data.timing_class;
+                    wire_uphill.push_back(uh);
+                }
+                std::sort(wire_uphill.begin() + wire_uphill_start.back(), wire_uphill.end(),
+                          [](const DirectUphill &a, const DirectUphill &b) { return a.src_idx < b.src_idx; });
+            }
         }
-    };
+    }
+    wire_uphill_start.push_back(int32_t(wire_uphill.size()));
+}
+
+std::pair<int, int> Arch::estimateWireLocation(WireId wire) const
+{
+    if (wire == gsrclk_wire) {
+        auto phys_wire = getPipSrcWire(*(getPipsUphill(wire).begin()));
+        return std::make_pair(int(phys_wire.location.x), int(phys_wire.location.y));
+    }
+    const Location &offset =
+            wire_loc_offset[chip_info->location_type[wire.location.y * chip_info->width + wire.location.x]][wire.index];
+    return std::make_pair(wire.location.x + offset.x, wire.location.y + offset.y);
+}
 
-    auto src_loc = est_location(src);
+delay_t Arch::estimateDelay(WireId src, WireId dst) const
+{
+    // A pip directly from src, looked up in the sorted uphill pips of dst
+    int dst_idx = getWireFlatIndex(dst);
+    for (int i = wire_uphill_start[dst_idx], end = wire_uphill_start[dst_idx + 1]; i < end; i++) {
+        const auto &uh = wire_uphill[i];
+        if (uh.src_idx > src.index)
+            break;
+        if (uh.src_idx == src.index && dst.location + uh.rel_src == src.location) {
+            const auto &pip_class = speed_grade->pip_classes[uh.timing_class];
+            return pip_class.max_base_delay + wire_fanout[getWireFlatIndex(src)] * pip_class.max_fanout_adder;
+        }
+    }
+
+    auto src_loc = estimateWireLocation(src);
     std::pair<int, int> dst_loc;
-    if (wire_loc_overrides.count(dst)) {
-        dst_loc = wire_loc_overrides.at(dst);
+    auto dst_override = wire_loc_overrides.empty() ? wire_loc_overrides.end() : wire_loc_overrides.find(dst);
+    if (dst_override != wire_loc_overrides.end()) {
+        dst_loc = dst_override->second;
     } else {
-        dst_loc = est_location(dst);
+        dst_loc = estimateWireLocation(dst);
     }
 
     int dx = abs(src_loc.first - dst_loc.first), dy = abs(src_loc.second - dst_loc.second);
@@ -509,26 +570,7 @@ ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
         bb.y1 = std::max(bb.y1, y);
     };
 
-    auto est_location = [&](WireId w) -> std::pair<int, int> {
-        const auto &wire = locInfo(w)->wire_data[w.index];
-        if (w == gsrclk_wire) {
-            auto phys_wire = getPipSrcWire(*(getPipsUphill(w).begin()));
-            return std::make_pair(int(phys_wire.location.x), int(phys_wire.location.y));
-        } else if (wire.num_bel_pins > 0) {
-            return std::make_pair(w.location.x + wire.bel_pins[0].rel_bel_loc.x,
-                                  w.location.y + wire.bel_pins[0].rel_bel_loc.y);
-        } else if (wire.num_downhill > 0) {
-            return std::make_pair(w.location.x + wire.pips_downhill[0].rel_loc.x,
-                                  w.location.y + wire.pips_downhill[0].rel_loc.y);
-        } else if (wire.num_uphill > 0) {
-            return std::make_pair(w.location.x + wire.pips_uphill[0].rel_loc.x,
-                                  w.location.y + wire.pips_uphill[0].rel_loc.y);
-        } else {
-            return std::make_pair(int(w.location.x), int(w.location.y));
-        }
-    };
-
-    auto src_loc = est_location(src);
+    auto src_loc = estimateWireLocation(src);
     extend(src_loc.first, src_loc.second);
     if (wire_loc_overrides.count(src)) {
         extend(wire_loc_overrides.at(src).first, wire_loc_overrides.at(src).second);
@@ -538,7 +580,7 @@ ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
     if (wire_loc_overrides.count(dst)) {
         dst_loc = wire_loc_overrides.at(dst);
     } else {
-        dst_loc = est_location(dst);
+        dst_loc = estimateWireLocation(dst);
     }
     extend(dst_loc.first, dst_loc.second);
     return bb;
@@ -640,7 +682,8 @@ bool Arch::route()
 
 #if 0
     std::vector<std::pair<WireId, int>> fanout_vector;
-    std::copy(wire_fanout.begin(), wire_fanout.end(), std::back_inserter(fanout_vector));
+    for (auto wire : getWires())
+        fanout_vector.emplace_back(wire, wire_fanout[getWireFlatIndex(wire)]);
     std::sort(fanout_vector.begin(), fanout_vector.end(), [](const std::pair<WireId, int> &a, const std::pair<WireId, int> &b) {
         return a.second > b.second;
     });
@@ -649,17 +692,17 @@ bool Arch::route()
     log_break();
     PipId slowest_pip;
     delay_t slowest_pipdelay = 0;
-    for (auto pip : pip_to_net) {
-        if (pip.second) {
-            delay_t dly = getPipDelay(pip.first).maxDelay();
+    for (auto pip : getPips()) {
+        if (pip_to_net[getPipFlatIndex(pip)]) {
+            delay_t dly = getPipDelay(pip).maxDelay();
             if (dly > slowest_pipdelay) {
-                slowest_pip = pip.first;
+                slowest_pip = pip;
                 slowest_pipdelay = dly;
             }
         }
     }
     log_info("    slowest pip %s = %.02f ns\n", getPipName(slowest_pip).c_str(this), getDelayNS(slowest_pipdelay));
-    log_info("       fanout %d\n", wire_fanout[getPipSrcWire(slowest_pip)]);
+    log_info("       fanout %d\n", wire_fanout[getWireFlatIndex(getPipSrcWire(slowest_pip))]);
     log_info("       base %d adder %d\n", speed_grade->pip_classes[locInfo(slowest_pip)->pip_data[slowest_pip.index].timing_class].max_base_delay,
              speed_grade->pip_classes[locInfo(slowest_pip)->pip_data[slowest_pip.index].timing_class].max_fanout_adder);
 #endif
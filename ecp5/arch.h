@@ -486,9 +486,30 @@ struct Arch : BaseCtx
     mutable std::unordered_map<IdString, PipId> pip_by_name;
 
     std::vector<CellInfo *> bel_to_cell;
-    std::unordered_map<WireId, NetInfo *> wire_to_net;
-    std::unordered_map<PipId, NetInfo *> pip_to_net;
-    std::unordered_map<WireId, int> wire_fanout;
+    std::vector<NetInfo *> wire_to_net;
+    std::vector<NetInfo *> pip_to_net;
+    std::vector<int> wire_fanout;
+    // Bels of each type, for getBelsByType
+    std::unordered_map<IdString, std::vector<BelId>> bels_by_type;
+    // Index of the first wire and pip of each location in the flat arrays above
+    std::vector<int> loc_wire_start, loc_pip_start;
+
+    // Precomputed for estimateDelay and getRouteBoundingBox. wire_loc_offset holds, per location type, the offset of
+    // each wire's estimated location from its tile (that of its first bel pin, downhill or uphill pip). For wires with
+    // fewer than six uphill pips, wire_uphill[wire_uphill_start[i]] up to wire_uphill[wire_uphill_start[i + 1]] are
+    // the source wires and timing classes of the pips driving flat wire i, sorted by source wire index.
+    struct DirectUphill
+    {
+        int32_t src_idx;
+        // Location of the source wire, relative to the driven wire
+        Location rel_src;
+        int32_t timing_class;
+    };
+    std::vector<std::vector<Location>> wire_loc_offset;
+    std::vector<int32_t> wire_uphill_start;
+    std::vector<DirectUphill> wire_uphill;
+    void setupWireEstimates();
+    std::pair<int, int> estimateWireLocation(WireId wire) const;
 
     ArchArgs args;
     Arch(ArchArgs args);
@@ -532,6 +553,16 @@ struct Arch : BaseCtx
         return (bel.location.y * chip_info->width + bel.location.x) * max_loc_bels + bel.index;
     }
 
+    int getWireFlatIndex(WireId wire) const
+    {
+        return loc_wire_start[wire.location.y * chip_info->width + wire.location.x] + wire.index;
+    }
+
+    int getPipFlatIndex(PipId pip) const
+    {
+        return loc_pip_start[pip.location.y * chip_info->width + pip.location.x] + pip.index;
+    }
+
     void bindBel(BelId bel, CellInfo *cell, PlaceStrength strength)
     {
         NPNR_ASSERT(bel != BelId());
@@ -599,6 +630,13 @@ struct Arch : BaseCtx
         return range;
     }
 
+    const std::vector<BelId> &getBelsByType(IdString type) const
+    {
+        static const std::vector<BelId> no_bels;
+        auto fnd = bels_by_type.find(type);
+        return fnd == bels_by_type.end() ? no_bels : fnd->second;
+    }
+
     IdString getBelType(BelId bel) const
     {
         NPNR_ASSERT(bel != BelId());
@@ -657,46 +695,47 @@ struct Arch : BaseCtx
     void bindWire(WireId wire, NetInfo *net, PlaceStrength strength)
     {
         NPNR_ASSERT(wire != WireId());
-        NPNR_ASSERT(wire_to_net[wire] == nullptr);
-        wire_to_net[wire] = net;
+        int idx = getWireFlatIndex(wire);
+        NPNR_ASSERT(wire_to_net[idx] == nullptr);
+        wire_to_net[idx] = net;
         net->wires[wire].pip = PipId();
         net->wires[wire].strength = strength;
+        net->route_version++;
         refreshUiWire(wire);
     }
 
     void unbindWire(WireId wire)
     {
         NPNR_ASSERT(wire != WireId());
-        NPNR_ASSERT(wire_to_net[wire] != nullptr);
+        int idx = getWireFlatIndex(wire);
+        NPNR_ASSERT(wire_to_net[idx] != nullptr);
 
-        auto &net_wires = wire_to_net[wire]->wires;
+        auto &net_wires = wire_to_net[idx]->wires;
         auto it = net_wires.find(wire);
         NPNR_ASSERT(it != net_wires.end());
 
         auto pip = it->second.pip;
         if (pip != PipId()) {
-            wire_fanout[getPipSrcWire(pip)]--;
-            pip_to_net[pip] = nullptr;
+            wire_fanout[getWireFlatIndex(getPipSrcWire(pip))]--;
+            pip_to_net[getPipFlatIndex(pip)] = nullptr;
         }
 
         net_wires.erase(it);
-        wire_to_net[wire] = nullptr;
+        wire_to_net[idx]->route_version++;
+        wire_to_net[idx] = nullptr;
         refreshUiWire(wire);
     }
 
     bool checkWireAvail(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        return wire_to_net.find(wire) == wire_to_net.end() || wire_to_net.at(wire) == nullptr;
+        return wire_to_net[getWireFlatIndex(wire)] == nullptr;
     }
 
     NetInfo *getBoundWireNet(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        if (wire_to_net.find(wire) == wire_to_net.end())
-            return nullptr;
-        else
-            return wire_to_net.at(wire);
+        return wire_to_net[getWireFlatIndex(wire)];
     }
 
     WireId getConflictingWireWire(WireId wire) const { return wire; }
@@ -704,10 +743,7 @@ struct Arch : BaseCtx
     NetInfo *getConflictingWireNet(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        if (wire_to_net.find(wire) == wire_to_net.end())
-            return nullptr;
-        else
-            return wire_to_net.at(wire);
+        return wire_to_net[getWireFlatIndex(wire)];
     }
 
     DelayInfo getWireDelay(WireId wire) const
@@ -764,49 +800,52 @@ struct Arch : BaseCtx
     void bindPip(PipId pip, NetInfo *net, PlaceStrength strength)
     {
         NPNR_ASSERT(pip != PipId());
-        NPNR_ASSERT(pip_to_net[pip] == nullptr);
+        int idx = getPipFlatIndex(pip);
+        NPNR_ASSERT(pip_to_net[idx] == nullptr);
 
-        pip_to_net[pip] = net;
-        wire_fanout[getPipSrcWire(pip)]++;
+        pip_to_net[idx] = net;
+        wire_fanout[getWireFlatIndex(getPipSrcWire(pip))]++;
 
         WireId dst;
         dst.index = locInfo(pip)->pip_data[pip.index].dst_idx;
         dst.location = pip.location + locInfo(pip)->pip_data[pip.index].rel_dst_loc;
-        NPNR_ASSERT(wire_to_net[dst] == nullptr);
-        wire_to_net[dst] = net;
+        int dst_idx = getWireFlatIndex(dst);
+        NPNR_ASSERT(wire_to_net[dst_idx] == nullptr);
+        wire_to_net[dst_idx] = net;
         net->wires[dst].pip = pip;
         net->wires[dst].strength = strength;
+        net->route_version++;
     }
 
     void unbindPip(PipId pip)
     {
         NPNR_ASSERT(pip != PipId());
-        NPNR_ASSERT(pip_to_net[pip] != nullptr);
-        wire_fanout[getPipSrcWire(pip)]--;
+        int idx = getPipFlatIndex(pip);
+        NPNR_ASSERT(pip_to_net[idx] != nullptr);
+        wire_fanout[getWireFlatIndex(getPipSrcWire(pip))]--;
 
         WireId dst;
         dst.index = locInfo(pip)->pip_data[pip.index].dst_idx;
         dst.location = pip.location + locInfo(pip)->pip_data[pip.index].rel_dst_loc;
-        NPNR_ASSERT(wire_to_net[dst] != nullptr);
-        wire_to_net[dst] = nullptr;
-        pip_to_net[pip]->wires.erase(dst);
+        int dst_idx = getWireFlatIndex(dst);
+        NPNR_ASSERT(wire_to_net[dst_idx] != nullptr);
+        wire_to_net[dst_idx] = nullptr;
+        pip_to_net[idx]->wires.erase(dst);
+        pip_to_net[idx]->route_version++;
 
-        pip_to_net[pip] = nullptr;
+        pip_to_net[idx] = nullptr;
     }
 
     bool checkPipAvail(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        return pip_to_net.find(pip) == pip_to_net.end() || pip_to_net.at(pip) == nullptr;
+        return pip_to_net[getPipFlatIndex(pip)] == nullptr;
     }
 
     NetInfo *getBoundPipNet(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        if (pip_to_net.find(pip) == pip_to_net.end())
-            return nullptr;
-        else
-            return pip_to_net.at(pip);
+        return pip_to_net[getPipFlatIndex(pip)];
     }
 
     WireId getConflictingPipWire(PipId pip) const { return WireId(); }
@@ -814,10 +853,7 @@ struct Arch : BaseCtx
     NetInfo *getConflictingPipNet(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        if (pip_to_net.find(pip) == pip_to_net.end())
-            return nullptr;
-        else
-            return pip_to_net.at(pip);
+        return pip_to_net[getPipFlatIndex(pip)];
     }
 
     AllPipRange getPips() const
@@ -855,10 +891,7 @@ struct Arch : BaseCtx
     {
         DelayInfo delay;
         NPNR_ASSERT(pip != PipId());
-        int fanout = 0;
-        auto fnd_fanout = wire_fanout.find(getPipSrcWire(pip));
-        if (fnd_fanout != wire_fanout.end())
-            fanout = fnd_fanout->second;
+        int fanout = wire_fanout[getWireFlatIndex(getPipSrcWire(pip))];
         NPNR_ASSERT(locInfo(pip)->pip_data[pip.index].timing_class < speed_grade->num_pip_classes);
         delay.min_delay =
                 speed_grade->pip_classes[locInfo(pip)->pip_data[pip.index].timing_class].min_base_delay +
@@ -120,6 +120,7 @@ bool Arch::isValidBelForCell(CellInfo *cell, BelId bel) const
 void Arch::permute_luts()
 {
     NetCriticalityMap nc;
+    assign_net_udata(getCtx());
     get_criticalities(getCtx(), &nc);
 
     std::unordered_map<PortInfo *, size_t> port_to_user;
@@ -146,11 +147,10 @@ void Arch::permute_luts()
             }
             auto &port = ci->ports.at(port_names.at(i));
             float crit = 0;
-            if (port.net != nullptr && nc.count(port.net->name)) {
-                auto &n = nc.at(port.net->name);
+            if (port.net != nullptr) {
                 size_t usr = port_to_user.at(&port);
-                if (usr < n.criticality.size())
-                    crit = n.criticality.at(usr);
+                if (int(usr) < nc.num_arcs(port.net))
+                    crit = nc.arc_criticality(port.net, usr);
             }
             orig_nets.push_back(port.net);
             inputs.emplace_back(crit, i);
@@ -49,8 +49,8 @@ void arch_wrap_python()
     fn_wrapper_2a<Context, decltype(&Context::isValidBelForCell), &Context::isValidBelForCell, pass_through<bool>,
                   addr_and_unwrap<CellInfo>, conv_from_str<BelId>>::def_wrap(ctx_cls, "isValidBelForCell");
 
-    typedef std::unordered_map<IdString, std::unique_ptr<CellInfo>> CellMap;
-    typedef std::unordered_map<IdString, std::unique_ptr<NetInfo>> NetMap;
+    typedef indexed_dict<IdString, std::unique_ptr<CellInfo>> CellMap;
+    typedef indexed_dict<IdString, std::unique_ptr<NetInfo>> NetMap;
     typedef std::unordered_map<IdString, IdString> AliasMap;
     typedef std::unordered_map<IdString, HierarchicalCell> HierarchyMap;
 
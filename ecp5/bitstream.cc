@@ -25,6 +25,7 @@
 #include <queue>
 #include <regex>
 #include <streambuf>
+#include <thread>
 #include "config.h"
 #include "log.h"
 #include "pio.h"
@@ -497,12 +498,25 @@ void tieoff_dcu_ports(Context *ctx, ChipConfig &cc, CellInfo *ci)
     }
 }
 
-static void set_pip(Context *ctx, ChipConfig &cc, PipId pip)
+// A set pip as a routing arc of a tile, the tile given as its grid location index and its index among the tiles there
+struct PipArc
 {
-    std::string tile = ctx->getPipTilename(pip);
-    std::string source = get_trellis_wirename(ctx, pip.location, ctx->getPipSrcWire(pip));
-    std::string sink = get_trellis_wirename(ctx, pip.location, ctx->getPipDstWire(pip));
-    cc.tiles[tile].add_arc(sink, source);
+    int loc, tile;
+    std::string sink, source;
+};
+
+static void add_pip_arc(Context *ctx, std::vector<PipArc> &arcs, PipId pip)
+{
+    int loc = pip.location.y * ctx->chip_info->width + pip.location.x;
+    auto &tileloc = ctx->chip_info->tile_info[loc];
+    for (int i = 0; i < tileloc.num_tiles; i++) {
+        if (tileloc.tile_names[i].type_idx == ctx->locInfo(pip)->pip_data[pip.index].tile_type) {
+            arcs.push_back({loc, i, get_trellis_wirename(ctx, pip.location, ctx->getPipDstWire(pip)),
+                            get_trellis_wirename(ctx, pip.location, ctx->getPipSrcWire(pip))});
+            return;
+        }
+    }
+    NPNR_ASSERT_FALSE("failed to find Pip tile");
 }
 
 static std::vector<bool> parse_config_str(const Property &p, int length)
@@ -552,8 +566,7 @@ static std::vector<bool> parse_config_str(const Property &p, int length)
     return word;
 }
 
-std::string intstr_or_default(const std::unordered_map<IdString, Property> &ct, const IdString &key,
-                              std::string def = "0")
+template <typename Tdict> std::string intstr_or_default(const Tdict &ct, const IdString &key, std::string def = "0")
 {
     auto found = ct.find(key);
     if (found == ct.end())
@@ -631,21 +644,59 @@ void write_bitstream(Context *ctx, std::string base_config_file, std::string tex
             }
         }
     }
-    // Add all set, configurable pips to the config
-    for (auto pip : ctx->getPips()) {
-        if (ctx->getBoundPipNet(pip) != nullptr) {
-            if (ctx->getPipClass(pip) == 0) { // ignore fixed pips
+    // Add all set, configurable pips to the config. The arcs of each grid location are found by worker threads, then
+    // added to the tile configs in pip order
+    {
+        const ChipInfoPOD *chip = ctx->chip_info;
+        int num_locs = chip->width * chip->height;
+        std::vector<std::vector<PipArc>> loc_arcs(num_locs);
+        auto find_arcs = [&](int loc) {
+            int num_pips = chip->locations[chip->location_type[loc]].num_pips;
+            for (int i = 0; i < num_pips; i++) {
+                PipId pip;
+                pip.location.x = loc % chip->width;
+                pip.location.y = loc / chip->width;
+                pip.index = i;
+                if (ctx->getBoundPipNet(pip) == nullptr || ctx->getPipClass(pip) != 0) // ignore fixed pips
+                    continue;
                 std::string source = get_trellis_wirename(ctx, pip.location, ctx->getPipSrcWire(pip));
                 if (source.find("CLKI_PLL") != std::string::npos) {
                     // Special case - must set pip in all relevant tiles
                     for (auto equiv_pip : ctx->getPipsUphill(ctx->getPipDstWire(pip))) {
                         if (ctx->getPipSrcWire(equiv_pip) == ctx->getPipSrcWire(pip))
-                            set_pip(ctx, cc, equiv_pip);
+                            add_pip_arc(ctx, loc_arcs.at(loc), equiv_pip);
                     }
                 } else {
-                    set_pip(ctx, cc, pip);
+                    add_pip_arc(ctx, loc_arcs.at(loc), pip);
                 }
             }
+        };
+        int threads = std::max(1, ctx->settings.count(ctx->id("threads")) ? ctx->setting<int>("threads")
+                                                                          : int(std::thread::hardware_concurrency()));
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back([&, t]() {
+                for (int loc = t; loc < num_locs; loc += threads)
+                    find_arcs(loc);
+            });
+        for (int loc = 0; loc < num_locs; loc += threads)
+            find_arcs(loc);
+        for (auto &w : workers)
+            w.join();
+
+        // Tile configs by tile ID, tile_base[location] + the index of the tile at its location, so that the config of a
+        // tile is looked up by name only for its first arc
+        std::vector<int> tile_base(num_locs + 1, 0);
+        for (int loc = 0; loc < num_locs; loc++)
+            tile_base.at(loc + 1) = tile_base.at(loc) + chip->tile_info[loc].num_tiles;
+        std::vector<TileConfig *> tile_cfgs(tile_base.back(), nullptr);
+        for (auto &arcs : loc_arcs) {
+            for (auto &arc : arcs) {
+                TileConfig *&tc = tile_cfgs.at(tile_base.at(arc.loc) + arc.tile);
+                if (tc == nullptr)
+                    tc = &cc.tiles[chip->tile_info[arc.loc].tile_names[arc.tile].name.get()];
+                tc->carcs.push_back({std::move(arc.sink), std::move(arc.source)});
+            }
         }
     }
     // Find bank voltages
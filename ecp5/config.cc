@@ -139,7 +139,7 @@ inline bool skip_check_eof(std::istream &in)
 
 std::ostream &operator<<(std::ostream &out, const ConfigArc &arc)
 {
-    out << "arc: " << arc.sink << " " << arc.source << std::endl;
+    out << "arc: " << arc.sink << " " << arc.source << '\n';
     return out;
 }
 
@@ -152,7 +152,7 @@ std::istream &operator>>(std::istream &in, ConfigArc &arc)
 
 std::ostream &operator<<(std::ostream &out, const ConfigWord &cw)
 {
-    out << "word: " << cw.name << " " << to_string(cw.value) << std::endl;
+    out << "word: " << cw.name << " " << to_string(cw.value) << '\n';
     return out;
 }
 
@@ -165,7 +165,7 @@ std::istream &operator>>(std::istream &in, ConfigWord &cw)
 
 std::ostream &operator<<(std::ostream &out, const ConfigEnum &cw)
 {
-    out << "enum: " << cw.name << " " << cw.value << std::endl;
+    out << "enum: " << cw.name << " " << cw.value << '\n';
     return out;
 }
 
@@ -178,7 +178,7 @@ std::istream &operator>>(std::istream &in, ConfigEnum &ce)
 
 std::ostream &operator<<(std::ostream &out, const ConfigUnknown &cu)
 {
-    out << "unknown: " << to_string(ConfigBit{cu.frame, cu.bit, false}) << std::endl;
+    out << "unknown: " << to_string(ConfigBit{cu.frame, cu.bit, false}) << '\n';
     return out;
 }
 
@@ -264,38 +264,38 @@ bool TileConfig::empty() const { return carcs.empty() && cwords.empty() && cenum
 
 std::ostream &operator<<(std::ostream &out, const ChipConfig &cc)
 {
-    out << ".device " << cc.chip_name << std::endl << std::endl;
+    out << ".device " << cc.chip_name << "\n\n";
     for (const auto &meta : cc.metadata)
-        out << ".comment " << meta << std::endl;
-    out << std::endl;
+        out << ".comment " << meta << '\n';
+    out << '\n';
     for (const auto &tile : cc.tiles) {
         if (!tile.second.empty()) {
-            out << ".tile " << tile.first << std::endl;
+            out << ".tile " << tile.first << '\n';
             out << tile.second;
-            out << std::endl;
+            out << '\n';
         }
     }
     for (const auto &bram : cc.bram_data) {
-        out << ".bram_init " << bram.first << std::endl;
+        out << ".bram_init " << bram.first << '\n';
         std::ios_base::fmtflags f(out.flags());
         for (size_t i = 0; i < bram.second.size(); i++) {
             out << std::setw(3) << std::setfill('0') << std::hex << bram.second.at(i);
             if (i % 8 == 7)
-                out << std::endl;
+                out << '\n';
             else
                 out << " ";
         }
         out.flags(f);
-        out << std::endl;
+        out << '\n';
     }
     for (const auto &tg : cc.tilegroups) {
         out << ".tile_group";
         for (const auto &tile : tg.tiles) {
             out << " " << tile;
         }
-        out << std::endl;
+        out << '\n';
         out << tg.config;
-        out << std::endl;
+        out << '\n';
     }
     return out;
 }
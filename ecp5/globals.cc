@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <iomanip>
 #include <queue>
+#include <unordered_set>
 #include "cells.h"
 #include "log.h"
 #include "nextpnr.h"
@@ -160,11 +161,15 @@ class Ecp5GlobalRouter
             if (ctx->checkWireAvail(next)) {
                 for (auto pip : ctx->getPipsUphill(next)) {
                     WireId src = ctx->getPipSrcWire(pip);
+                    // Each wire is only searched from once, so the search stays local instead of revisiting wires
+                    // through every path leading to them
+                    if (src == userWire || backtrace.count(src))
+                        continue;
                     backtrace[src] = pip;
                     upstream.push(src);
                 }
             }
-            if (upstream.size() > 30000) {
+            if (upstream.empty() || backtrace.size() > 30000) {
                 log_error("failed to route HPBX%02d00 to %s.%s\n", global_index,
                           ctx->getBelName(user.cell->bel).c_str(ctx), user.port.c_str(ctx));
             }
@@ -216,29 +221,27 @@ class Ecp5GlobalRouter
                                             "G_" + get_quad_name(quad) + "PCLK" + std::to_string(network));
     }
 
-    bool simple_router(NetInfo *net, WireId src, WireId dst, bool allow_fail = false)
+    // Route from src to all of dsts with one breadth-first search, so that the routes form a tree that shares
+    // everything up to where they split
+    bool tree_router(NetInfo *net, WireId src, const std::vector<WireId> &dsts, bool allow_fail = false)
     {
         std::queue<WireId> visit;
         std::unordered_map<WireId, PipId> backtrace;
+        std::unordered_set<WireId> remaining(dsts.begin(), dsts.end());
         visit.push(src);
-        WireId cursor;
-        while (true) {
-
+        while (!remaining.empty()) {
             if (visit.empty() || visit.size() > 50000) {
                 if (allow_fail)
                     return false;
                 log_error("cannot route global from %s to %s.\n", ctx->getWireName(src).c_str(ctx),
-                          ctx->getWireName(dst).c_str(ctx));
+                          ctx->getWireName(*remaining.begin()).c_str(ctx));
             }
-            cursor = visit.front();
+            WireId cursor = visit.front();
             visit.pop();
             NetInfo *bound = ctx->getBoundWireNet(cursor);
-            if (bound == net) {
-            } else if (bound != nullptr) {
+            if (bound != nullptr && bound != net)
                 continue;
-            }
-            if (cursor == dst)
-                break;
+            remaining.erase(cursor);
             for (auto dh : ctx->getPipsDownhill(cursor)) {
                 WireId pipDst = ctx->getPipDstWire(dh);
                 if (backtrace.count(pipDst))
@@ -247,17 +250,20 @@ class Ecp5GlobalRouter
                 visit.push(pipDst);
             }
         }
-        while (true) {
-            auto fnd = backtrace.find(cursor);
-            if (fnd == backtrace.end())
-                break;
-            NetInfo *bound = ctx->getBoundWireNet(cursor);
-            if (bound != nullptr) {
-                NPNR_ASSERT(bound == net);
-                break;
+        for (auto dst : dsts) {
+            WireId cursor = dst;
+            while (true) {
+                auto fnd = backtrace.find(cursor);
+                if (fnd == backtrace.end())
+                    break;
+                NetInfo *bound = ctx->getBoundWireNet(cursor);
+                if (bound != nullptr) {
+                    NPNR_ASSERT(bound == net);
+                    break;
+                }
+                ctx->bindPip(fnd->second, net, STRENGTH_LOCKED);
+                cursor = ctx->getPipSrcWire(fnd->second);
             }
-            ctx->bindPip(fnd->second, net, STRENGTH_LOCKED);
-            cursor = ctx->getPipSrcWire(fnd->second);
         }
         if (ctx->getBoundWireNet(src) == nullptr)
             ctx->bindWire(src, net, STRENGTH_LOCKED);
@@ -269,14 +275,13 @@ class Ecp5GlobalRouter
         WireId glb_src;
         NPNR_ASSERT(net->driver.cell->type == id_DCCA);
         glb_src = ctx->getNetinfoSourceWire(net);
+        std::vector<WireId> glb_dsts;
         for (int quad = QUAD_UL; quad < QUAD_LR + 1; quad++) {
             WireId glb_dst = get_global_wire(GlobalQuadrant(quad), network);
             NPNR_ASSERT(glb_dst != WireId());
-            bool routed = simple_router(net, glb_src, glb_dst);
-            if (!routed)
-                return false;
+            glb_dsts.push_back(glb_dst);
         }
-        return true;
+        return tree_router(net, glb_src, glb_dsts);
     }
 
     // Get DCC wirelength based on source
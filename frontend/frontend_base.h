@@ -105,9 +105,11 @@
  *
  */
 
+#include <type_traits>
 #include "design_utils.h"
 #include "log.h"
 #include "nextpnr.h"
+#include "thread_pool.h"
 #include "util.h"
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -133,7 +135,10 @@ template <typename FrontendType> struct GenericFrontend
         m.prefix = "";
         m.path = top;
         ctx->top_module = top;
-        // Do the actual import, starting from the top level module
+        // Build the hierarchical names of all instances up front, then do the actual import, starting from the top
+        // level module
+        collect_instances("", top);
+        intern_instance_names();
         import_module(m, top.str(ctx), top.str(ctx), mod_refs.at(top));
     }
 
@@ -214,8 +219,11 @@ template <typename FrontendType> struct GenericFrontend
     // Create a unique name (guaranteed collision free) for a net or a cell; based on
     // a base name and suffix. __unique__i will be be appended with increasing i
     // if a collision is found until no collision
-    IdString unique_name(const std::string &base, const std::string &suffix, bool is_net)
+    IdString unique_name(const std::string &base, const std::string &suffix, bool is_net, IdString first = IdString())
     {
+        // The name without a __unique__ suffix, if interned already, is usually free
+        if (first != IdString() && !(is_net ? ctx->nets.count(first) : ctx->cells.count(first)))
+            return first;
         IdString name;
         int incr = 0;
         do {
@@ -230,6 +238,145 @@ template <typename FrontendType> struct GenericFrontend
         return name;
     }
 
+    // One bit of a port of a leaf cell
+    struct PortBitTemplate
+    {
+        std::string port, bit_name;
+        IdString port_id, bit_id;
+        // Signal number in the module, or -1 for a constant bit
+        int signal;
+        char constval;
+    };
+    struct CellTemplate
+    {
+        std::string name;
+        // cell_dat_t may be a reference type
+        typename std::remove_reference<cell_dat_t>::type *data;
+        bool is_submodule;
+        // Port bits of leaf cells, and their directions
+        std::vector<PortBitTemplate> port_bits;
+        std::unordered_map<IdString, PortType> port_dirs;
+    };
+    // What is the same for every instance of a module, worked out once per module type
+    struct ModuleTemplate
+    {
+        // The bits of netnames that aren't constant: signal number in the module and bit name, and the bit name as
+        // an IdString
+        std::vector<std::pair<int, std::string>> netname_bits;
+        std::vector<IdString> netname_ids;
+        std::vector<CellTemplate> cells;
+    };
+    std::unordered_map<IdString, ModuleTemplate> mod_templates;
+
+    const ModuleTemplate &get_template(IdString type)
+    {
+        auto fnd = mod_templates.find(type);
+        if (fnd != mod_templates.end())
+            return fnd->second;
+        ModuleTemplate &tmpl = mod_templates[type];
+        const mod_dat_t &data = mod_refs.at(type);
+        impl.foreach_netname(data, [&](const std::string &basename, const netname_dat_t &nn) {
+            bool upto = impl.is_array_upto(nn);
+            int offset = impl.get_array_offset(nn);
+            const auto &bits = impl.get_net_bits(nn);
+            int width = impl.get_vector_length(bits);
+            for (int i = 0; i < width; i++) {
+                if (impl.is_vector_bit_constant(bits, i))
+                    continue;
+                std::string bit_name = get_bit_name(basename, i, width, offset, upto);
+                tmpl.netname_ids.push_back(ctx->id(bit_name));
+                tmpl.netname_bits.emplace_back(impl.get_vector_bit_signal(bits, i), std::move(bit_name));
+            }
+        });
+        impl.foreach_cell(data, [&](const std::string &cellname, const cell_dat_t &cd) {
+            tmpl.cells.emplace_back();
+            CellTemplate &ct = tmpl.cells.back();
+            ct.name = cellname;
+            ct.data = &cd;
+            IdString cell_type = ctx->id(impl.get_cell_type(cd));
+            ct.is_submodule = mods.count(cell_type) && !mods.at(cell_type).is_box();
+            if (ct.is_submodule)
+                return;
+            impl.foreach_port_dir(cd, [&](const std::string &port, PortType dir) { ct.port_dirs[ctx->id(port)] = dir; });
+            impl.foreach_port_conn(cd, [&](const std::string &name, const bitvector_t &bits) {
+                IdString port_id = ctx->id(name);
+                int width = impl.get_vector_length(bits);
+                for (int i = 0; i < width; i++) {
+                    PortBitTemplate pb;
+                    pb.port = name;
+                    pb.port_id = port_id;
+                    pb.bit_name = get_bit_name(name, i, width);
+                    pb.bit_id = ctx->id(pb.bit_name);
+                    bool is_const = impl.is_vector_bit_constant(bits, i);
+                    pb.signal = is_const ? -1 : impl.get_vector_bit_signal(bits, i);
+                    pb.constval = is_const ? impl.get_vector_bit_constval(bits, i) : 0;
+                    ct.port_bits.push_back(std::move(pb));
+                }
+            });
+        });
+        return tmpl;
+    }
+
+    // The hierarchical names of one instance of a module: its prefix followed by each netname bit, and by each leaf
+    // cell name, in the order of the module template
+    struct InstanceNames
+    {
+        std::string prefix;
+        IdString type;
+        std::vector<IdString> netname_ids, cell_ids;
+    };
+    // All instances, in the order import_module visits them
+    std::vector<InstanceNames> instances;
+    size_t next_instance = 0;
+
+    void collect_instances(const std::string &prefix, IdString type)
+    {
+        instances.emplace_back();
+        instances.back().prefix = prefix;
+        instances.back().type = type;
+        const ModuleTemplate &tmpl = get_template(type);
+        for (auto &ct : tmpl.cells)
+            if (ct.is_submodule)
+                collect_instances(prefix + ct.name + ".", ctx->id(impl.get_cell_type(*ct.data)));
+    }
+
+    // Building the names is a large part of the work of importing a design with many instances, and doesn't depend
+    // on anything else, so it is done up front by the threads of the pool, a chunk of instances at a time. The names
+    // are interned in instance order on this thread, as IdString numbering decides the order of sorted() sets and
+    // maps and so must not depend on thread timing.
+    void intern_instance_names()
+    {
+        const size_t chunk = 4096;
+        std::vector<std::vector<std::string>> names;
+        for (size_t begin = 0; begin < instances.size(); begin += chunk) {
+            size_t end = std::min(instances.size(), begin + chunk);
+            names.resize(end - begin);
+            ctx->threadPool().parallel_for(end - begin, 16, [&](size_t i) {
+                const InstanceNames &inst = instances.at(begin + i);
+                const ModuleTemplate &tmpl = mod_templates.at(inst.type);
+                auto &buf = names.at(i);
+                buf.clear();
+                for (auto &bit : tmpl.netname_bits)
+                    buf.push_back(inst.prefix + bit.second);
+                for (auto &ct : tmpl.cells)
+                    if (!ct.is_submodule)
+                        buf.push_back(inst.prefix + ct.name);
+            });
+            for (size_t i = begin; i < end; i++) {
+                InstanceNames &inst = instances.at(i);
+                const ModuleTemplate &tmpl = mod_templates.at(inst.type);
+                auto name = names.at(i - begin).begin();
+                inst.netname_ids.reserve(tmpl.netname_bits.size());
+                for (size_t j = 0; j < tmpl.netname_bits.size(); j++)
+                    inst.netname_ids.push_back(ctx->id(*name++));
+                inst.cell_ids.resize(tmpl.cells.size());
+                for (size_t j = 0; j < tmpl.cells.size(); j++)
+                    if (!tmpl.cells.at(j).is_submodule)
+                        inst.cell_ids.at(j) = ctx->id(*name++);
+            }
+        }
+    }
+
     // A flat index of map; designed to cope with merging nets where pointers to nets would go stale
     // A net's udata points into this index
     std::vector<NetInfo *> net_flatindex;
@@ -254,8 +401,10 @@ template <typename FrontendType> struct GenericFrontend
             return index_to_net_flatindex.at(idx);
         }
         std::unordered_map<IdString, std::vector<int>> port_to_bus;
-        // All of the names given to a net
-        std::vector<std::vector<std::string>> net_names;
+        // All of the names given to a net, as indices into the netname bits of the template
+        std::vector<std::vector<int>> net_names;
+        const ModuleTemplate *tmpl = nullptr;
+        const InstanceNames *names = nullptr;
     };
 
     void import_module(HierModuleState &m, const std::string &name, const std::string &type, const mod_dat_t &data)
@@ -265,6 +414,9 @@ template <typename FrontendType> struct GenericFrontend
         ctx->hierarchy[m.path].type = ctx->id(type);
         ctx->hierarchy[m.path].parent = m.parent_path;
         ctx->hierarchy[m.path].fullpath = m.path;
+        m.names = &instances.at(next_instance++);
+        NPNR_ASSERT(m.names->prefix == m.prefix && m.names->type == ctx->id(type));
+        m.tmpl = &mod_templates.at(m.names->type);
 
         std::vector<NetInfo *> index_to_net;
         if (!m.is_toplevel) {
@@ -299,13 +451,16 @@ template <typename FrontendType> struct GenericFrontend
     //  - names with fewer $ are always prefered
     //  - between equal $ counts, fewer .s are prefered
     //  - ties are resolved alphabetically
-    bool prefer_netlabel(HierModuleState &m, const std::string &a, const std::string &b)
+    // (a and b are indices into the netname bits of the module template)
+    bool prefer_netlabel(HierModuleState &m, int a_idx, int b_idx)
     {
-        if (m.port_to_bus.count(ctx->id(a)))
+        if (m.port_to_bus.count(m.tmpl->netname_ids.at(a_idx)))
             return true;
-        if (m.port_to_bus.count(ctx->id(b)))
+        if (m.port_to_bus.count(m.tmpl->netname_ids.at(b_idx)))
             return false;
 
+        const std::string &a = m.tmpl->netname_bits.at(a_idx).second, &b = m.tmpl->netname_bits.at(b_idx).second;
+
         if (b.empty())
             return true;
         long a_dollars = std::count(a.begin(), a.end(), '$'), b_dollars = std::count(b.begin(), b.end(), '$');
@@ -329,16 +484,19 @@ template <typename FrontendType> struct GenericFrontend
             return net_flatindex.at(midx);
         } else {
             std::string name;
+            IdString first;
             if (idx < int(m.net_names.size()) && !m.net_names.at(idx).empty()) {
                 // Use the rule above to find the preferred name for a net
-                name = m.net_names.at(idx).at(0);
+                int best = m.net_names.at(idx).at(0);
                 for (size_t j = 1; j < m.net_names.at(idx).size(); j++)
-                    if (prefer_netlabel(m, m.net_names.at(idx).at(j), name))
-                        name = m.net_names.at(idx).at(j);
+                    if (prefer_netlabel(m, m.net_names.at(idx).at(j), best))
+                        best = m.net_names.at(idx).at(j);
+                name = m.tmpl->netname_bits.at(best).second;
+                first = m.names->netname_ids.at(best);
             } else {
                 name = "$frontend$" + std::to_string(idx);
             }
-            NetInfo *net = ctx->createNet(unique_name(m.prefix, name, true));
+            NetInfo *net = ctx->createNet(unique_name(m.prefix, name, true, first));
             // Add to the flat index of nets
             net->udata = int(net_flatindex.size());
             net_flatindex.push_back(net);
@@ -346,8 +504,8 @@ template <typename FrontendType> struct GenericFrontend
             midx = net->udata;
             // Create aliases for all possible names
             if (idx < int(m.net_names.size()) && !m.net_names.at(idx).empty()) {
-                for (const auto &name : m.net_names.at(idx)) {
-                    IdString name_id = ctx->id(name);
+                for (int name_idx : m.net_names.at(idx)) {
+                    IdString name_id = m.tmpl->netname_ids.at(name_idx);
                     net->aliases.push_back(name_id);
                     ctx->net_aliases[name_id] = net->name;
                 }
@@ -379,36 +537,26 @@ template <typename FrontendType> struct GenericFrontend
     // Import the netnames section of a module
     void import_module_netnames(HierModuleState &m, const mod_dat_t &data)
     {
-        impl.foreach_netname(data, [&](const std::string &basename, const netname_dat_t &nn) {
-            bool upto = impl.is_array_upto(nn);
-            int offset = impl.get_array_offset(nn);
-            const auto &bits = impl.get_net_bits(nn);
-            int width = impl.get_vector_length(bits);
-            for (int i = 0; i < width; i++) {
-                if (impl.is_vector_bit_constant(bits, i))
-                    continue;
-
-                std::string bit_name = get_bit_name(basename, i, width, offset, upto);
-
-                int net_bit = impl.get_vector_bit_signal(bits, i);
-                int mapped_bit = m.net_by_idx(net_bit);
-                if (mapped_bit == -1) {
-                    // Net doesn't exist yet. Add the name here to the list of candidate names so we have that for when
-                    // we create it later
-                    if (net_bit >= int(m.net_names.size()))
-                        m.net_names.resize(net_bit + 1);
-                    m.net_names.at(net_bit).push_back(bit_name);
-                } else {
-                    // Net already exists; add this name as an alias
-                    NetInfo *ni = net_flatindex.at(mapped_bit);
-                    IdString alias_name = ctx->id(m.prefix + bit_name);
-                    if (ctx->net_aliases.count(alias_name))
-                        continue; // don't add duplicate aliases
-                    ctx->net_aliases[alias_name] = ni->name;
-                    ni->aliases.push_back(alias_name);
-                }
+        const auto &bits = m.tmpl->netname_bits;
+        for (int k = 0; k < int(bits.size()); k++) {
+            int net_bit = bits.at(k).first;
+            int mapped_bit = m.net_by_idx(net_bit);
+            if (mapped_bit == -1) {
+                // Net doesn't exist yet. Add the name here to the list of candidate names so we have that for when
+                // we create it later
+                if (net_bit >= int(m.net_names.size()))
+                    m.net_names.resize(net_bit + 1);
+                m.net_names.at(net_bit).push_back(k);
+            } else {
+                // Net already exists; add this name as an alias
+                NetInfo *ni = net_flatindex.at(mapped_bit);
+                IdString alias_name = m.names->netname_ids.at(k);
+                if (ctx->net_aliases.count(alias_name))
+                    continue; // don't add duplicate aliases
+                ctx->net_aliases[alias_name] = ni->name;
+                ni->aliases.push_back(alias_name);
             }
-        });
+        }
     }
 
     void import_net_attrs(HierModuleState &m, const mod_dat_t &data)
@@ -441,48 +589,43 @@ template <typename FrontendType> struct GenericFrontend
     }
 
     // Import a leaf cell - (white|black)box
-    void import_leaf_cell(HierModuleState &m, const std::string &name, const cell_dat_t &cd)
+    void import_leaf_cell(HierModuleState &m, const CellTemplate &ct, IdString first)
     {
-        IdString inst_name = unique_name(m.prefix, name, false);
+        const std::string &name = ct.name;
+        const cell_dat_t &cd = *ct.data;
+        IdString inst_name = unique_name(m.prefix, name, false, first);
         ctx->hierarchy[m.path].leaf_cells_by_gname[inst_name] = ctx->id(name);
         ctx->hierarchy[m.path].leaf_cells[ctx->id(name)] = inst_name;
         CellInfo *ci = ctx->createCell(inst_name, ctx->id(impl.get_cell_type(cd)));
         ci->hierpath = m.path;
-        // Import port directions
-        std::unordered_map<IdString, PortType> port_dirs;
-        impl.foreach_port_dir(cd, [&](const std::string &port, PortType dir) { port_dirs[ctx->id(port)] = dir; });
-        // Import port connectivity
-        impl.foreach_port_conn(cd, [&](const std::string &name, const bitvector_t &bits) {
-            if (!port_dirs.count(ctx->id(name)))
-                log_error("Failed to get direction for port '%s' of cell '%s'\n", name.c_str(), inst_name.c_str(ctx));
-            PortType dir = port_dirs.at(ctx->id(name));
-            int width = impl.get_vector_length(bits);
-            for (int i = 0; i < width; i++) {
-                std::string port_bit_name = get_bit_name(name, i, width);
-                IdString port_bit_ids = ctx->id(port_bit_name);
-                // Create cell port
-                ci->ports[port_bit_ids].name = port_bit_ids;
-                ci->ports[port_bit_ids].type = dir;
-                // Resolve connectivity
-                NetInfo *net;
-                if (impl.is_vector_bit_constant(bits, i)) {
-                    // Create a constant driver if one is needed
-                    net = create_constant_net(m, inst_name.str(ctx) + "." + port_bit_name + "$const",
-                                              impl.get_vector_bit_constval(bits, i));
-                } else {
-                    // Otherwise, lookup (creating if needed) the net with this index
-                    net = create_or_get_net(m, impl.get_vector_bit_signal(bits, i));
-                }
-                NPNR_ASSERT(net != nullptr);
-
-                // Check for multiple drivers
-                if (dir == PORT_OUT && net->driver.cell != nullptr)
-                    log_error("Net '%s' is multiply driven by cell ports %s.%s and %s.%s\n", ctx->nameOf(net),
-                              ctx->nameOf(net->driver.cell), ctx->nameOf(net->driver.port), ctx->nameOf(inst_name),
-                              port_bit_name.c_str());
-                connect_port(ctx, net, ci, port_bit_ids);
+        // Import port connectivity, with the port directions and bit names from the template
+        for (auto &pb : ct.port_bits) {
+            auto dir_fnd = ct.port_dirs.find(pb.port_id);
+            if (dir_fnd == ct.port_dirs.end())
+                log_error("Failed to get direction for port '%s' of cell '%s'\n", pb.port.c_str(),
+                          inst_name.c_str(ctx));
+            PortType dir = dir_fnd->second;
+            // Create cell port
+            ci->ports[pb.bit_id].name = pb.bit_id;
+            ci->ports[pb.bit_id].type = dir;
+            // Resolve connectivity
+            NetInfo *net;
+            if (pb.signal == -1) {
+                // Create a constant driver if one is needed
+                net = create_constant_net(m, inst_name.str(ctx) + "." + pb.bit_name + "$const", pb.constval);
+            } else {
+                // Otherwise, lookup (creating if needed) the net with this index
+                net = create_or_get_net(m, pb.signal);
             }
-        });
+            NPNR_ASSERT(net != nullptr);
+
+            // Check for multiple drivers
+            if (dir == PORT_OUT && net->driver.cell != nullptr)
+                log_error("Net '%s' is multiply driven by cell ports %s.%s and %s.%s\n", ctx->nameOf(net),
+                          ctx->nameOf(net->driver.cell), ctx->nameOf(net->driver.port), ctx->nameOf(inst_name),
+                          pb.bit_name.c_str());
+            connect_port(ctx, net, ci, pb.bit_id);
+        }
         // Import attributes and parameters
         impl.foreach_attr(cd,
                           [&](const std::string &name, const Property &value) { ci->attrs[ctx->id(name)] = value; });
@@ -532,16 +675,16 @@ template <typename FrontendType> struct GenericFrontend
     // Import the cells section of a module
     void import_module_cells(HierModuleState &m, const mod_dat_t &data)
     {
-        impl.foreach_cell(data, [&](const std::string &cellname, const cell_dat_t &cd) {
-            IdString type = ctx->id(impl.get_cell_type(cd));
-            if (mods.count(type) && !mods.at(type).is_box()) {
+        for (size_t j = 0; j < m.tmpl->cells.size(); j++) {
+            const CellTemplate &ct = m.tmpl->cells.at(j);
+            if (ct.is_submodule) {
                 // Module type is known; and not boxed. Import as a submodule by flattening hierarchy
-                import_submodule_cell(m, cellname, cd);
+                import_submodule_cell(m, ct.name, *ct.data);
             } else {
                 // Module type is unknown or boxes. Import as a leaf cell (nextpnr CellInfo)
-                import_leaf_cell(m, cellname, cd);
+                import_leaf_cell(m, ct, m.names->cell_ids.at(j));
             }
-        });
+        }
     }
 
     // Create a top level input/output buffer
@@ -677,7 +820,9 @@ template <typename FrontendType> struct GenericFrontend
         }
         // Combine users
         for (auto &usr : mergee->users) {
-            usr.cell->ports[usr.port].net = base;
+            auto &port = usr.cell->ports[usr.port];
+            port.net = base;
+            port.user_idx = int(base->users.size());
             base->users.push_back(usr);
         }
         // Point aliases to the new net
@@ -19,58 +19,570 @@
 
 #include "json_frontend.h"
 #include "frontend_base.h"
-#include "json11.hpp"
 #include "log.h"
+#include "mem_account.h"
 #include "nextpnr.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <streambuf>
 
 NEXTPNR_NAMESPACE_BEGIN
 
-using namespace json11;
+namespace {
+
+// Compact document produced by the streaming parser below. Yosys netlists can be several GB, so rather than
+// holding the file text and a tree of reference counted values, every value is a small fixed size node in one
+// vector, strings are deduplicated (keys such as "bits" or "src" repeat millions of times) and bit vectors are
+// packed into a shared int32 pool.
+struct JsonNode
+{
+    enum Type : uint8_t
+    {
+        JNULL,
+        JBOOL,
+        JNUMBER,
+        JSTRING,
+        JARRAY,
+        JOBJECT,
+        // An array consisting only of signal numbers and single character constants
+        JBITS,
+    };
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    Type type = JNULL;
+    // Index of the key in the string table, for object members
+    uint32_t key = NONE;
+    // Next sibling in the parent array/object
+    uint32_t next = NONE;
+    // String index, number index, bool value, first child or offset into the bit pool depending on type
+    uint32_t first = NONE;
+    // Number of children or bits
+    uint32_t size = 0;
+};
+
+struct JsonDocument
+{
+    std::vector<JsonNode> nodes;
+    std::vector<double> numbers;
+    // Signal numbers are stored as-is, constant bits c as -(c + 1)
+    std::vector<int32_t> bits;
+    std::unordered_map<std::string, uint32_t> string_index;
+    std::vector<const std::string *> strings;
+
+    const std::string &str(uint32_t idx) const { return *strings.at(idx); }
+
+    uint32_t strid(const std::string &s)
+    {
+        auto found = string_index.find(s);
+        if (found != string_index.end())
+            return found->second;
+        uint32_t idx = uint32_t(strings.size());
+        auto ins = string_index.emplace(s, idx);
+        strings.push_back(&(ins.first->first));
+        return idx;
+    }
+
+    uint32_t lookup_strid(const std::string &s) const
+    {
+        auto found = string_index.find(s);
+        return found == string_index.end() ? JsonNode::NONE : found->second;
+    }
+};
+
+// Reads JSON directly from the stream in fixed size chunks, without first copying the whole file into memory
+struct JsonStreamParser
+{
+    JsonStreamParser(std::istream &in, const std::string &filename, JsonDocument &doc)
+            : sb(in.rdbuf()), filename(filename), doc(doc){};
+
+    std::streambuf *sb;
+    const std::string &filename;
+    JsonDocument &doc;
+
+    static const size_t buf_size = 1 << 20;
+    std::vector<char> buf = std::vector<char>(buf_size);
+    size_t buf_pos = 0, buf_len = 0;
+    bool at_eof = false;
+    int line = 1;
+
+    // Reused between calls to avoid reallocation
+    std::string tok;
+    std::vector<uint32_t> sort_scratch;
+
+    NPNR_NORETURN void error(const char *msg)
+    {
+        log_error("Failed to parse JSON file '%s': %s on line %d.\n", filename.c_str(), msg, line);
+    }
+
+    bool fill()
+    {
+        if (at_eof)
+            return false;
+        buf_len = size_t(sb->sgetn(buf.data(), std::streamsize(buf_size)));
+        buf_pos = 0;
+        if (buf_len == 0)
+            at_eof = true;
+        return buf_len != 0;
+    }
+
+    // Returns -1 at end of file
+    int peek()
+    {
+        if (buf_pos == buf_len && !fill())
+            return -1;
+        return (unsigned char)buf[buf_pos];
+    }
+
+    int get()
+    {
+        int c = peek();
+        if (c != -1) {
+            ++buf_pos;
+            if (c == '\n')
+                ++line;
+        }
+        return c;
+    }
+
+    void expect(char c)
+    {
+        if (get() != c) {
+            std::string msg = stringf("expected '%c'", c);
+            error(msg.c_str());
+        }
+    }
+
+    // Skip whitespace and comments, returning the next significant character without consuming it
+    int skip_ws()
+    {
+        while (true) {
+            int c = peek();
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                get();
+            } else if (c == '/') {
+                get();
+                int c2 = get();
+                if (c2 == '/') {
+                    while ((c2 = get()) != -1 && c2 != '\n')
+                        ;
+                } else if (c2 == '*') {
+                    int prev = 0;
+                    while ((c2 = get()) != -1 && !(prev == '*' && c2 == '/'))
+                        prev = c2;
+                    if (c2 == -1)
+                        error("unterminated comment");
+                } else {
+                    error("malformed comment");
+                }
+            } else {
+                return c;
+            }
+        }
+    }
+
+    void append_utf8(std::string &out, uint32_t cp)
+    {
+        if (cp < 0x80) {
+            out.push_back(char(cp));
+        } else if (cp < 0x800) {
+            out.push_back(char(0xC0 | (cp >> 6)));
+            out.push_back(char(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            out.push_back(char(0xE0 | (cp >> 12)));
+            out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(char(0x80 | (cp & 0x3F)));
+        } else {
+            out.push_back(char(0xF0 | (cp >> 18)));
+            out.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(char(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    uint32_t parse_hex4()
+    {
+        uint32_t cp = 0;
+        for (int i = 0; i < 4; i++) {
+            int c = get();
+            cp <<= 4;
+            if (c >= '0' && c <= '9')
+                cp |= uint32_t(c - '0');
+            else if (c >= 'a' && c <= 'f')
+                cp |= uint32_t(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                cp |= uint32_t(c - 'A' + 10);
+            else
+                error("invalid \\u escape");
+        }
+        return cp;
+    }
+
+    // Parse a string into tok, the opening quote must be next
+    void parse_string()
+    {
+        expect('"');
+        tok.clear();
+        while (true) {
+            // Fast path: copy runs of plain characters straight out of the buffer
+            size_t start = buf_pos;
+            while (buf_pos < buf_len && buf[buf_pos] != '"' && buf[buf_pos] != '\\' && buf[buf_pos] != '\n')
+                ++buf_pos;
+            tok.append(buf.data() + start, buf_pos - start);
+            int c = get();
+            if (c == -1)
+                error("unterminated string");
+            if (c == '"')
+                return;
+            if (c != '\\') {
+                tok.push_back(char(c));
+                continue;
+            }
+            c = get();
+            switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                tok.push_back(char(c));
+                break;
+            case 'b':
+                tok.push_back('\b');
+                break;
+            case 'f':
+                tok.push_back('\f');
+                break;
+            case 'n':
+                tok.push_back('\n');
+                break;
+            case 'r':
+                tok.push_back('\r');
+                break;
+            case 't':
+                tok.push_back('\t');
+                break;
+            case 'u': {
+                uint32_t cp = parse_hex4();
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    if (get() != '\\' || get() != 'u')
+                        error("unpaired surrogate in \\u escape");
+                    uint32_t lo = parse_hex4();
+                    if (lo < 0xDC00 || lo > 0xDFFF)
+                        error("unpaired surrogate in \\u escape");
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                append_utf8(tok, cp);
+                break;
+            }
+            default:
+                error("invalid escape sequence");
+            }
+        }
+    }
+
+    double parse_number()
+    {
+        tok.clear();
+        int c;
+        while ((c = peek()) != -1 && (std::isdigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+            tok.push_back(char(get()));
+        char *end = nullptr;
+        double val = std::strtod(tok.c_str(), &end);
+        if (tok.empty() || end != tok.c_str() + tok.size())
+            error("invalid number");
+        return val;
+    }
+
+    void parse_literal(const char *lit)
+    {
+        for (const char *p = lit; *p; p++)
+            if (get() != *p)
+                error("invalid literal");
+    }
+
+    uint32_t new_node(JsonNode::Type type)
+    {
+        if (doc.nodes.size() >= JsonNode::NONE)
+            error("too many values");
+        doc.nodes.emplace_back();
+        doc.nodes.back().type = type;
+        return uint32_t(doc.nodes.size() - 1);
+    }
+
+    // Parse one value, returning its node index
+    uint32_t parse_value()
+    {
+        int c = skip_ws();
+        if (c == '{')
+            return parse_object();
+        if (c == '[')
+            return parse_array();
+        if (c == '"') {
+            parse_string();
+            uint32_t n = new_node(JsonNode::JSTRING);
+            doc.nodes[n].first = doc.strid(tok);
+            return n;
+        }
+        if (c == '-' || std::isdigit(c)) {
+            double val = parse_number();
+            uint32_t n = new_node(JsonNode::JNUMBER);
+            doc.nodes[n].first = uint32_t(doc.numbers.size());
+            doc.numbers.push_back(val);
+            return n;
+        }
+        if (c == 't' || c == 'f') {
+            parse_literal(c == 't' ? "true" : "false");
+            uint32_t n = new_node(JsonNode::JBOOL);
+            doc.nodes[n].first = (c == 't');
+            return n;
+        }
+        if (c == 'n') {
+            parse_literal("null");
+            return new_node(JsonNode::JNULL);
+        }
+        error(c == -1 ? "unexpected end of file" : "unexpected character");
+    }
+
+    // Append a child to an array/object node, maintaining the sibling list
+    void link_child(uint32_t parent, uint32_t &last, uint32_t child)
+    {
+        if (last == JsonNode::NONE)
+            doc.nodes[parent].first = child;
+        else
+            doc.nodes[last].next = child;
+        last = child;
+        ++doc.nodes[parent].size;
+    }
+
+    uint32_t parse_array()
+    {
+        expect('[');
+        // Bit vectors are by far the most common arrays, so they are parsed straight into the packed bit pool,
+        // falling back to a generic array if a non-bit element is found
+        uint32_t n = new_node(JsonNode::JBITS);
+        size_t bits_start = doc.bits.size();
+        doc.nodes[n].first = uint32_t(bits_start);
+        uint32_t last = JsonNode::NONE;
+        bool packed = true;
+        int c = skip_ws();
+        if (c == ']') {
+            get();
+            return n;
+        }
+        while (true) {
+            c = skip_ws();
+            bool elem_packed = false;
+            if (packed && c == '"') {
+                parse_string();
+                if (tok.size() == 1) {
+                    doc.bits.push_back(-int32_t((unsigned char)tok[0]) - 1);
+                    elem_packed = true;
+                } else {
+                    unpack_bits(n, bits_start, last);
+                    packed = false;
+                    uint32_t s = new_node(JsonNode::JSTRING);
+                    doc.nodes[s].first = doc.strid(tok);
+                    link_child(n, last, s);
+                    elem_packed = true;
+                }
+            } else if (packed && (c == '-' || std::isdigit(c))) {
+                double val = parse_number();
+                if (val >= 0 && val <= 0x7FFFFFFF && double(int32_t(val)) == val) {
+                    doc.bits.push_back(int32_t(val));
+                } else {
+                    unpack_bits(n, bits_start, last);
+                    packed = false;
+                    uint32_t v = new_node(JsonNode::JNUMBER);
+                    doc.nodes[v].first = uint32_t(doc.numbers.size());
+                    doc.numbers.push_back(val);
+                    link_child(n, last, v);
+                }
+                elem_packed = true;
+            }
+            if (!elem_packed) {
+                if (packed) {
+                    unpack_bits(n, bits_start, last);
+                    packed = false;
+                }
+                link_child(n, last, parse_value());
+            }
+            c = skip_ws();
+            get();
+            if (c == ']')
+                break;
+            if (c != ',')
+                error("expected ',' or ']'");
+        }
+        if (packed)
+            doc.nodes[n].size = uint32_t(doc.bits.size() - bits_start);
+        return n;
+    }
+
+    // Convert a partially parsed bit vector into a generic array
+    void unpack_bits(uint32_t n, size_t bits_start, uint32_t &last)
+    {
+        doc.nodes[n].type = JsonNode::JARRAY;
+        doc.nodes[n].first = JsonNode::NONE;
+        doc.nodes[n].size = 0;
+        for (size_t i = bits_start; i < doc.bits.size(); i++) {
+            int32_t b = doc.bits.at(i);
+            uint32_t v;
+            if (b >= 0) {
+                v = new_node(JsonNode::JNUMBER);
+                doc.nodes[v].first = uint32_t(doc.numbers.size());
+                doc.numbers.push_back(b);
+            } else {
+                v = new_node(JsonNode::JSTRING);
+                doc.nodes[v].first = doc.strid(std::string(1, char(-(b + 1))));
+            }
+            link_child(n, last, v);
+        }
+        doc.bits.resize(bits_start);
+    }
+
+    uint32_t parse_object()
+    {
+        expect('{');
+        uint32_t n = new_node(JsonNode::JOBJECT);
+        uint32_t last = JsonNode::NONE;
+        int c = skip_ws();
+        if (c == '}') {
+            get();
+            return n;
+        }
+        while (true) {
+            if (skip_ws() != '"')
+                error("expected object key");
+            parse_string();
+            uint32_t key = doc.strid(tok);
+            if (skip_ws() != ':')
+                error("expected ':'");
+            get();
+            uint32_t v = parse_value();
+            doc.nodes[v].key = key;
+            link_child(n, last, v);
+            c = skip_ws();
+            get();
+            if (c == '}')
+                break;
+            if (c != ',')
+                error("expected ',' or '}'");
+        }
+        sort_members(n);
+        return n;
+    }
+
+    // Objects are iterated in key order with the last of any duplicate keys winning, matching the behaviour of the
+    // previous std::map based parser so that cell and net creation order (and hence results) are unchanged
+    void sort_members(uint32_t n)
+    {
+        auto &nodes = doc.nodes;
+        sort_scratch.clear();
+        bool sorted = true;
+        for (uint32_t i = nodes[n].first; i != JsonNode::NONE; i = nodes[i].next) {
+            if (!sort_scratch.empty() && !(doc.str(nodes[sort_scratch.back()].key) < doc.str(nodes[i].key)))
+                sorted = false;
+            sort_scratch.push_back(i);
+        }
+        if (sorted)
+            return;
+        std::stable_sort(sort_scratch.begin(), sort_scratch.end(),
+                         [&](uint32_t a, uint32_t b) { return doc.str(nodes[a].key) < doc.str(nodes[b].key); });
+        uint32_t last = JsonNode::NONE;
+        nodes[n].first = JsonNode::NONE;
+        nodes[n].size = 0;
+        for (size_t i = 0; i < sort_scratch.size(); i++) {
+            uint32_t child = sort_scratch.at(i);
+            if (i + 1 < sort_scratch.size() && nodes[sort_scratch.at(i + 1)].key == nodes[child].key)
+                continue;
+            nodes[child].next = JsonNode::NONE;
+            link_child(n, last, child);
+        }
+    }
+
+    uint32_t parse_document()
+    {
+        uint32_t root = parse_value();
+        if (skip_ws() != -1)
+            error("unexpected trailing content");
+        return root;
+    }
+};
 
 struct JsonFrontendImpl
 {
     // See specification in frontend_base.h
-    JsonFrontendImpl(Json &root) : root(root){};
-    Json &root;
-    typedef const Json &ModuleDataType;
-    typedef const Json &ModulePortDataType;
-    typedef const Json &CellDataType;
-    typedef const Json &NetnameDataType;
-    typedef const Json::array &BitVectorDataType;
+    JsonFrontendImpl(const JsonDocument &doc, const JsonNode &root) : doc(doc), root(root)
+    {
+        key_ports = doc.lookup_strid("ports");
+        key_cells = doc.lookup_strid("cells");
+        key_netnames = doc.lookup_strid("netnames");
+        key_direction = doc.lookup_strid("direction");
+        key_offset = doc.lookup_strid("offset");
+        key_upto = doc.lookup_strid("upto");
+        key_bits = doc.lookup_strid("bits");
+        key_type = doc.lookup_strid("type");
+        key_attributes = doc.lookup_strid("attributes");
+        key_parameters = doc.lookup_strid("parameters");
+        key_settings = doc.lookup_strid("settings");
+        key_port_directions = doc.lookup_strid("port_directions");
+        key_connections = doc.lookup_strid("connections");
+    };
+    const JsonDocument &doc;
+    const JsonNode &root;
+    typedef const JsonNode &ModuleDataType;
+    typedef const JsonNode &ModulePortDataType;
+    typedef const JsonNode &CellDataType;
+    typedef const JsonNode &NetnameDataType;
+    typedef const JsonNode &BitVectorDataType;
 
-    template <typename TFunc> void foreach_module(TFunc Func) const
+    uint32_t key_ports, key_cells, key_netnames, key_direction, key_offset, key_upto, key_bits, key_type,
+            key_attributes, key_parameters, key_settings, key_port_directions, key_connections;
+
+    const JsonNode *member(const JsonNode &obj, uint32_t key) const
     {
-        for (const auto &mod : root.object_items())
-            Func(mod.first, mod.second);
+        if (obj.type != JsonNode::JOBJECT || key == JsonNode::NONE)
+            return nullptr;
+        for (uint32_t i = obj.first; i != JsonNode::NONE; i = doc.nodes[i].next)
+            if (doc.nodes[i].key == key)
+                return &doc.nodes[i];
+        return nullptr;
     }
 
-    template <typename TFunc> void foreach_port(ModuleDataType &mod, TFunc Func) const
+    template <typename TFunc> void foreach_member(const JsonNode *obj, TFunc Func) const
     {
-        const auto &ports = mod["ports"];
-        if (ports.is_null())
+        if (obj == nullptr || obj->type != JsonNode::JOBJECT)
             return;
-        for (const auto &port : ports.object_items())
-            Func(port.first, port.second);
+        for (uint32_t i = obj->first; i != JsonNode::NONE; i = doc.nodes[i].next)
+            Func(doc.str(doc.nodes[i].key), doc.nodes[i]);
+    }
+
+    const std::string &string_value(const JsonNode *val) const
+    {
+        static const std::string empty;
+        return (val != nullptr && val->type == JsonNode::JSTRING) ? doc.str(val->first) : empty;
+    }
+
+    int int_value(const JsonNode *val) const
+    {
+        return (val != nullptr && val->type == JsonNode::JNUMBER) ? int(doc.numbers.at(val->first)) : 0;
+    }
+
+    template <typename TFunc> void foreach_module(TFunc Func) const { foreach_member(&root, Func); }
+
+    template <typename TFunc> void foreach_port(ModuleDataType &mod, TFunc Func) const
+    {
+        foreach_member(member(mod, key_ports), Func);
     }
 
     template <typename TFunc> void foreach_cell(ModuleDataType &mod, TFunc Func) const
     {
-        const auto &cells = mod["cells"];
-        if (cells.is_null())
-            return;
-        for (const auto &cell : cells.object_items())
-            Func(cell.first, cell.second);
+        foreach_member(member(mod, key_cells), Func);
     }
 
     template <typename TFunc> void foreach_netname(ModuleDataType &mod, TFunc Func) const
     {
-        const auto &netnames = mod["netnames"];
-        if (netnames.is_null())
-            return;
-        for (const auto &netname : netnames.object_items())
-            Func(netname.first, netname.second);
+        foreach_member(member(mod, key_netnames), Func);
     }
 
     PortType lookup_portdir(const std::string &dir) const
@@ -85,119 +597,121 @@ struct JsonFrontendImpl
             NPNR_ASSERT_FALSE("invalid json port direction");
     }
 
-    PortType get_port_dir(ModulePortDataType &port) const { return lookup_portdir(port["direction"].string_value()); }
-
-    int get_array_offset(const Json &obj) const
+    PortType get_port_dir(ModulePortDataType &port) const
     {
-        auto offset = obj["offset"];
-        return offset.is_null() ? 0 : offset.int_value();
+        return lookup_portdir(string_value(member(port, key_direction)));
     }
 
-    bool is_array_upto(const Json &obj) const
+    int get_array_offset(const JsonNode &obj) const { return int_value(member(obj, key_offset)); }
+
+    bool is_array_upto(const JsonNode &obj) const { return bool(int_value(member(obj, key_upto))); }
+
+    BitVectorDataType &get_bits(const JsonNode *val) const
     {
-        auto upto = obj["upto"];
-        return upto.is_null() ? false : bool(upto.int_value());
+        if (val == nullptr || val->type != JsonNode::JBITS)
+            log_error("Expected a bit vector in the JSON file.\n");
+        return *val;
     }
 
-    BitVectorDataType &get_port_bits(ModulePortDataType &port) const { return port["bits"].array_items(); }
+    BitVectorDataType &get_port_bits(ModulePortDataType &port) const { return get_bits(member(port, key_bits)); }
 
-    const std::string &get_cell_type(CellDataType &cell) const { return cell["type"].string_value(); }
+    const std::string &get_cell_type(CellDataType &cell) const { return string_value(member(cell, key_type)); }
 
-    Property parse_property(const Json &val) const
+    Property parse_property(const JsonNode &val) const
     {
-        if (val.is_number()) {
-            if (val.int_value() != val.number_value())
+        if (val.type == JsonNode::JNUMBER) {
+            double num = doc.numbers.at(val.first);
+            if (int(num) != num)
                 log_error("Found an out-of-range integer parameter in the JSON file.\n"
                           "Please regenerate the input file with an up-to-date version of yosys.\n");
-            return Property(val.int_value(), 32);
+            return Property(int(num), 32);
         } else {
-            return Property::from_string(val.string_value());
+            return Property::from_string(string_value(&val));
         }
     }
 
-    template <typename TFunc> void foreach_attr(const Json &obj, TFunc Func) const
+    template <typename TFunc> void foreach_attr(const JsonNode &obj, TFunc Func) const
     {
-        const auto &attrs = obj["attributes"];
-        if (attrs.is_null())
-            return;
-        for (const auto &attr : attrs.object_items()) {
-            Func(attr.first, parse_property(attr.second));
-        }
+        foreach_member(member(obj, key_attributes),
+                       [&](const std::string &name, const JsonNode &val) { Func(name, parse_property(val)); });
     }
 
-    template <typename TFunc> void foreach_param(const Json &obj, TFunc Func) const
+    template <typename TFunc> void foreach_param(const JsonNode &obj, TFunc Func) const
     {
-        const auto &params = obj["parameters"];
-        if (params.is_null())
-            return;
-        for (const auto &param : params.object_items()) {
-            Func(param.first, parse_property(param.second));
-        }
+        foreach_member(member(obj, key_parameters),
+                       [&](const std::string &name, const JsonNode &val) { Func(name, parse_property(val)); });
     }
 
-    template <typename TFunc> void foreach_setting(const Json &obj, TFunc Func) const
+    template <typename TFunc> void foreach_setting(const JsonNode &obj, TFunc Func) const
     {
-        const auto &settings = obj["settings"];
-        if (settings.is_null())
-            return;
-        for (const auto &setting : settings.object_items()) {
-            Func(setting.first, parse_property(setting.second));
-        }
+        foreach_member(member(obj, key_settings),
+                       [&](const std::string &name, const JsonNode &val) { Func(name, parse_property(val)); });
     }
 
     template <typename TFunc> void foreach_port_dir(CellDataType &cell, TFunc Func) const
     {
-        for (const auto &pdir : cell["port_directions"].object_items())
-            Func(pdir.first, lookup_portdir(pdir.second.string_value()));
+        foreach_member(member(cell, key_port_directions), [&](const std::string &name, const JsonNode &val) {
+            Func(name, lookup_portdir(string_value(&val)));
+        });
     }
 
     template <typename TFunc> void foreach_port_conn(CellDataType &cell, TFunc Func) const
     {
-        for (const auto &pconn : cell["connections"].object_items())
-            Func(pconn.first, pconn.second.array_items());
+        foreach_member(member(cell, key_connections),
+                       [&](const std::string &name, const JsonNode &val) { Func(name, get_bits(&val)); });
     }
 
-    BitVectorDataType &get_net_bits(NetnameDataType &net) const { return net["bits"].array_items(); }
+    BitVectorDataType &get_net_bits(NetnameDataType &net) const { return get_bits(member(net, key_bits)); }
 
-    int get_vector_length(BitVectorDataType &bits) const { return int(bits.size()); }
+    int get_vector_length(BitVectorDataType &bits) const { return int(bits.size); }
 
     bool is_vector_bit_constant(BitVectorDataType &bits, int i) const
     {
-        NPNR_ASSERT(i < int(bits.size()));
-        return bits[i].is_string();
+        NPNR_ASSERT(i < int(bits.size));
+        return doc.bits.at(bits.first + i) < 0;
     }
 
     char get_vector_bit_constval(BitVectorDataType &bits, int i) const
     {
-        auto s = bits.at(i).string_value();
-        NPNR_ASSERT(s.size() == 1);
-        return s.at(0);
+        int32_t b = doc.bits.at(bits.first + i);
+        NPNR_ASSERT(b < 0);
+        return char(-(b + 1));
     }
 
     int get_vector_bit_signal(BitVectorDataType &bits, int i) const
     {
-        NPNR_ASSERT(bits.at(i).is_number());
-        return bits.at(i).int_value();
+        int32_t b = doc.bits.at(bits.first + i);
+        NPNR_ASSERT(b >= 0);
+        return b;
     }
 };
 
+} // namespace
+
 bool parse_json(std::istream &in, const std::string &filename, Context *ctx)
 {
-    Json root;
-    {
-        if (!in)
-            log_error("Failed to open JSON file '%s'.\n", filename.c_str());
-        std::string json_str((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-        std::string error;
-        root = Json::parse(json_str, error, JsonParse::COMMENTS);
-        if (root.is_null())
-            log_error("Failed to parse JSON file '%s': %s.\n", filename.c_str(), error.c_str());
-        root = root["modules"];
-        if (root.is_null())
-            log_error("JSON file '%s' doesn't look like a netlist (doesn't contain \"modules\" key)\n",
-                      filename.c_str());
-    }
-    GenericFrontend<JsonFrontendImpl>(ctx, JsonFrontendImpl(root))();
+    if (!in)
+        log_error("Failed to open JSON file '%s'.\n", filename.c_str());
+    JsonDocument doc;
+    uint32_t root = JsonStreamParser(in, filename, doc).parse_document();
+    MemAccount mem("json");
+    if (mem_account_enabled()) {
+        size_t bytes = mem_usage(doc.nodes) + mem_usage(doc.numbers) + mem_usage(doc.bits) +
+                       mem_usage(doc.string_index) + mem_usage(doc.strings);
+        for (auto &str : doc.string_index)
+            bytes += str.first.capacity();
+        mem.update(bytes);
+    }
+    const JsonNode *modules = nullptr;
+    uint32_t key_modules = doc.lookup_strid("modules");
+    if (doc.nodes.at(root).type == JsonNode::JOBJECT) {
+        for (uint32_t i = doc.nodes.at(root).first; i != JsonNode::NONE; i = doc.nodes.at(i).next)
+            if (doc.nodes.at(i).key == key_modules)
+                modules = &doc.nodes.at(i);
+    }
+    if (modules == nullptr)
+        log_error("JSON file '%s' doesn't look like a netlist (doesn't contain \"modules\" key)\n", filename.c_str());
+    GenericFrontend<JsonFrontendImpl>(ctx, JsonFrontendImpl(doc, *modules))();
     return true;
 }
 
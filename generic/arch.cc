@@ -17,8 +17,11 @@
  *
  */
 
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <math.h>
+#include <string.h>
 #include "nextpnr.h"
 #include "placer1.h"
 #include "placer_heap.h"
@@ -28,56 +31,64 @@
 
 NEXTPNR_NAMESPACE_BEGIN
 
-WireInfo &Arch::wire_info(IdString wire)
+WireId Arch::wire_id(IdString wire) const
 {
-    auto w = wires.find(wire);
-    if (w == wires.end())
+    auto w = wire_by_name.find(wire);
+    if (w == wire_by_name.end())
         NPNR_ASSERT_FALSE_STR("no wire named " + wire.str(this));
     return w->second;
 }
 
-PipInfo &Arch::pip_info(IdString pip)
+PipId Arch::pip_id(IdString pip) const
 {
-    auto p = pips.find(pip);
-    if (p == pips.end())
+    PipId p = getPipByName(pip);
+    if (p == PipId())
         NPNR_ASSERT_FALSE_STR("no pip named " + pip.str(this));
-    return p->second;
+    return p;
 }
 
-BelInfo &Arch::bel_info(IdString bel)
+BelId Arch::bel_id(IdString bel) const
 {
-    auto b = bels.find(bel);
-    if (b == bels.end())
+    auto b = bel_by_name.find(bel);
+    if (b == bel_by_name.end())
         NPNR_ASSERT_FALSE_STR("no bel named " + bel.str(this));
     return b->second;
 }
 
 void Arch::addWire(IdString name, IdString type, int x, int y)
 {
-    NPNR_ASSERT(wires.count(name) == 0);
-    WireInfo &wi = wires[name];
+    NPNR_ASSERT(wire_by_name.count(name) == 0);
+    WireId wire;
+    wire.index = int32_t(wires.size());
+    wires.emplace_back();
+    WireInfo &wi = wires.back();
     wi.name = name;
     wi.type = type;
     wi.x = x;
     wi.y = y;
 
-    wire_ids.push_back(name);
+    wire_by_name[name] = wire;
+    wire_ids.push_back(wire);
 }
 
 void Arch::addPip(IdString name, IdString type, IdString srcWire, IdString dstWire, DelayInfo delay, Loc loc)
 {
-    NPNR_ASSERT(pips.count(name) == 0);
-    PipInfo &pi = pips[name];
+    NPNR_ASSERT(pip_by_name.count(name) == 0);
+    PipId pip;
+    pip.index = int32_t(pips.size());
+    pips.emplace_back();
+    PipInfo &pi = pips.back();
     pi.name = name;
     pi.type = type;
-    pi.srcWire = srcWire;
-    pi.dstWire = dstWire;
+    pi.srcWire = wire_id(srcWire);
+    pi.dstWire = wire_id(dstWire);
     pi.delay = delay;
     pi.loc = loc;
 
-    wire_info(srcWire).downhill.push_back(name);
-    wire_info(dstWire).uphill.push_back(name);
-    pip_ids.push_back(name);
+    wires[pi.srcWire.index].downhill.push_back(pip);
+    wires[pi.dstWire.index].uphill.push_back(pip);
+    pip_by_name[name] = pip;
+    pip_ids.push_back(pip);
 
     if (int(tilePipDimZ.size()) <= loc.x)
         tilePipDimZ.resize(loc.x + 1);
@@ -92,23 +103,170 @@ void Arch::addPip(IdString name, IdString type, IdString srcWire, IdString dstWi
 
 void Arch::addAlias(IdString name, IdString type, IdString srcWire, IdString dstWire, DelayInfo delay)
 {
-    NPNR_ASSERT(pips.count(name) == 0);
-    PipInfo &pi = pips[name];
+    NPNR_ASSERT(pip_by_name.count(name) == 0);
+    PipId pip;
+    pip.index = int32_t(pips.size());
+    pips.emplace_back();
+    PipInfo &pi = pips.back();
     pi.name = name;
     pi.type = type;
-    pi.srcWire = srcWire;
-    pi.dstWire = dstWire;
+    pi.srcWire = wire_id(srcWire);
+    pi.dstWire = wire_id(dstWire);
     pi.delay = delay;
 
-    wire_info(srcWire).aliases.push_back(name);
-    pip_ids.push_back(name);
+    wires[pi.srcWire.index].aliases.push_back(pip);
+    pip_by_name[name] = pip;
+    pip_ids.push_back(pip);
+}
+
+void Arch::addWires(const std::vector<IdString> &names, IdString type, const int32_t *x, const int32_t *y)
+{
+    wires.reserve(wires.size() + names.size());
+    wire_ids.reserve(wire_ids.size() + names.size());
+    for (size_t i = 0; i < names.size(); i++)
+        addWire(names[i], type, x[i], y[i]);
+}
+
+void Arch::addPips(IdString type, const int32_t *src, const int32_t *dst, const float *delay, size_t count)
+{
+    pips.reserve(pips.size() + count);
+    pip_ids.reserve(pip_ids.size() + count);
+    for (size_t i = 0; i < count; i++) {
+        if (src[i] < 0 || src[i] >= int32_t(wires.size()) || dst[i] < 0 || dst[i] >= int32_t(wires.size()))
+            log_error("pip %d of a bulk add connects wire %d to wire %d, but only %d wires exist\n", int(i), src[i],
+                      dst[i], int(wires.size()));
+        PipId pip;
+        pip.index = int32_t(pips.size());
+        pips.emplace_back();
+        PipInfo &pi = pips.back();
+        pi.type = type;
+        pi.srcWire.index = src[i];
+        pi.dstWire.index = dst[i];
+        pi.delay.delay = delay[i];
+        // Bulk pips are placed with their destination wire
+        const WireInfo &dst_wire = wires[dst[i]];
+        pi.loc = Loc(dst_wire.x, dst_wire.y, 0);
+
+        wires[src[i]].downhill.push_back(pip);
+        wires[dst[i]].uphill.push_back(pip);
+        pip_ids.push_back(pip);
+
+        if (int(tilePipDimZ.size()) <= pi.loc.x)
+            tilePipDimZ.resize(pi.loc.x + 1);
+        if (int(tilePipDimZ[pi.loc.x].size()) <= pi.loc.y)
+            tilePipDimZ[pi.loc.x].resize(pi.loc.y + 1);
+        gridDimX = std::max(gridDimX, pi.loc.x + 1);
+        gridDimY = std::max(gridDimY, pi.loc.y + 1);
+        tilePipDimZ[pi.loc.x][pi.loc.y] = std::max(tilePipDimZ[pi.loc.x][pi.loc.y], 1);
+    }
+}
+
+namespace {
+// Binary graph file layout, all fields little endian
+const char graph_magic[8] = {'N', 'P', 'N', 'R', 'G', 'R', 'P', 'H'};
+const uint32_t graph_version = 1;
+
+struct GraphHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_wires;
+    uint32_t num_pips;
+    uint32_t strtab_size;
+};
+
+struct GraphWire
+{
+    uint32_t name, type;
+    int32_t x, y;
+};
+
+struct GraphPip
+{
+    int32_t src, dst;
+    uint32_t type;
+    float delay;
+};
+} // namespace
+
+void Arch::loadGraph(const std::string &filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        log_error("Failed to open graph file '%s'\n", filename.c_str());
+    std::vector<char> buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    GraphHeader hdr;
+    if (buf.size() < sizeof(hdr))
+        log_error("Graph file '%s' is truncated\n", filename.c_str());
+    memcpy(&hdr, buf.data(), sizeof(hdr));
+    if (memcmp(hdr.magic, graph_magic, sizeof(graph_magic)) != 0)
+        log_error("'%s' is not a nextpnr graph file\n", filename.c_str());
+    if (hdr.version != graph_version)
+        log_error("Graph file '%s' has version %u, expected %u\n", filename.c_str(), hdr.version, graph_version);
+    size_t strtab_start = sizeof(hdr);
+    size_t wires_start = strtab_start + hdr.strtab_size;
+    size_t pips_start = wires_start + size_t(hdr.num_wires) * sizeof(GraphWire);
+    if (buf.size() != pips_start + size_t(hdr.num_pips) * sizeof(GraphPip))
+        log_error("Graph file '%s' has the wrong size for %u wires and %u pips\n", filename.c_str(), hdr.num_wires,
+                  hdr.num_pips);
+
+    // Strings are only turned into IdStrings once per string table entry
+    std::unordered_map<uint32_t, IdString> strings;
+    auto get_string = [&](uint32_t offset) -> IdString {
+        auto fnd = strings.find(offset);
+        if (fnd != strings.end())
+            return fnd->second;
+        const char *start = buf.data() + strtab_start;
+        if (offset >= hdr.strtab_size || memchr(start + offset, 0, hdr.strtab_size - offset) == nullptr)
+            log_error("Graph file '%s' has a bad string table offset %u\n", filename.c_str(), offset);
+        IdString str = id(start + offset);
+        strings[offset] = str;
+        return str;
+    };
+
+    int32_t wire_base = int32_t(wires.size());
+    wires.reserve(wires.size() + hdr.num_wires);
+    wire_ids.reserve(wire_ids.size() + hdr.num_wires);
+    for (uint32_t i = 0; i < hdr.num_wires; i++) {
+        GraphWire gw;
+        memcpy(&gw, buf.data() + wires_start + i * sizeof(GraphWire), sizeof(gw));
+        addWire(get_string(gw.name), get_string(gw.type), gw.x, gw.y);
+    }
+
+    // Wire indices in the file are relative to its first wire. Runs of pips with the same type are added together
+    std::vector<int32_t> src, dst;
+    std::vector<float> delay;
+    uint32_t run_type = 0;
+    auto flush = [&]() {
+        addPips(get_string(run_type), src.data(), dst.data(), delay.data(), src.size());
+        src.clear();
+        dst.clear();
+        delay.clear();
+    };
+    for (uint32_t i = 0; i < hdr.num_pips; i++) {
+        GraphPip gp;
+        memcpy(&gp, buf.data() + pips_start + i * sizeof(GraphPip), sizeof(gp));
+        if (!src.empty() && gp.type != run_type)
+            flush();
+        run_type = gp.type;
+        src.push_back(gp.src + wire_base);
+        dst.push_back(gp.dst + wire_base);
+        delay.push_back(gp.delay);
+    }
+    if (!src.empty())
+        flush();
+    log_info("Loaded %u wires and %u pips from '%s'\n", hdr.num_wires, hdr.num_pips, filename.c_str());
 }
 
 void Arch::addBel(IdString name, IdString type, Loc loc, bool gb)
 {
-    NPNR_ASSERT(bels.count(name) == 0);
+    NPNR_ASSERT(bel_by_name.count(name) == 0);
     NPNR_ASSERT(bel_by_loc.count(loc) == 0);
-    BelInfo &bi = bels[name];
+    BelId bel;
+    bel.index = int32_t(bels.size());
+    bels.emplace_back();
+    BelInfo &bi = bels.back();
     bi.name = name;
     bi.type = type;
     bi.x = loc.x;
@@ -116,8 +274,10 @@ void Arch::addBel(IdString name, IdString type, Loc loc, bool gb)
     bi.z = loc.z;
     bi.gb = gb;
 
-    bel_ids.push_back(name);
-    bel_by_loc[loc] = name;
+    bel_by_name[name] = bel;
+    bel_ids.push_back(bel);
+    bel_by_loc[loc] = bel;
+    bels_by_type[type].push_back(bel);
 
     if (int(bels_by_tile.size()) <= loc.x)
         bels_by_tile.resize(loc.x + 1);
@@ -125,7 +285,7 @@ void Arch::addBel(IdString name, IdString type, Loc loc, bool gb)
     if (int(bels_by_tile[loc.x].size()) <= loc.y)
         bels_by_tile[loc.x].resize(loc.y + 1);
 
-    bels_by_tile[loc.x][loc.y].push_back(name);
+    bels_by_tile[loc.x][loc.y].push_back(bel);
 
     if (int(tileBelDimZ.size()) <= loc.x)
         tileBelDimZ.resize(loc.x + 1);
@@ -143,11 +303,11 @@ void Arch::addBelInput(IdString bel, IdString name, IdString wire)
     NPNR_ASSERT(bel_info(bel).pins.count(name) == 0);
     PinInfo &pi = bel_info(bel).pins[name];
     pi.name = name;
-    pi.wire = wire;
+    pi.wire = wire_id(wire);
     pi.type = PORT_IN;
 
-    wire_info(wire).downhill_bel_pins.push_back(BelPin{bel, name});
-    wire_info(wire).bel_pins.push_back(BelPin{bel, name});
+    wire_info(wire).downhill_bel_pins.push_back(BelPin{bel_id(bel), name});
+    wire_info(wire).bel_pins.push_back(BelPin{bel_id(bel), name});
 }
 
 void Arch::addBelOutput(IdString bel, IdString name, IdString wire)
@@ -155,11 +315,11 @@ void Arch::addBelOutput(IdString bel, IdString name, IdString wire)
     NPNR_ASSERT(bel_info(bel).pins.count(name) == 0);
     PinInfo &pi = bel_info(bel).pins[name];
     pi.name = name;
-    pi.wire = wire;
+    pi.wire = wire_id(wire);
     pi.type = PORT_OUT;
 
-    wire_info(wire).uphill_bel_pin = BelPin{bel, name};
-    wire_info(wire).bel_pins.push_back(BelPin{bel, name});
+    wire_info(wire).uphill_bel_pin = BelPin{bel_id(bel), name};
+    wire_info(wire).bel_pins.push_back(BelPin{bel_id(bel), name});
 }
 
 void Arch::addBelInout(IdString bel, IdString name, IdString wire)
@@ -167,18 +327,18 @@ void Arch::addBelInout(IdString bel, IdString name, IdString wire)
     NPNR_ASSERT(bel_info(bel).pins.count(name) == 0);
     PinInfo &pi = bel_info(bel).pins[name];
     pi.name = name;
-    pi.wire = wire;
+    pi.wire = wire_id(wire);
     pi.type = PORT_INOUT;
 
-    wire_info(wire).downhill_bel_pins.push_back(BelPin{bel, name});
-    wire_info(wire).bel_pins.push_back(BelPin{bel, name});
+    wire_info(wire).downhill_bel_pins.push_back(BelPin{bel_id(bel), name});
+    wire_info(wire).bel_pins.push_back(BelPin{bel_id(bel), name});
 }
 
-void Arch::addGroupBel(IdString group, IdString bel) { groups[group].bels.push_back(bel); }
+void Arch::addGroupBel(IdString group, IdString bel) { groups[group].bels.push_back(bel_id(bel)); }
 
-void Arch::addGroupWire(IdString group, IdString wire) { groups[group].wires.push_back(wire); }
+void Arch::addGroupWire(IdString group, IdString wire) { groups[group].wires.push_back(wire_id(wire)); }
 
-void Arch::addGroupPip(IdString group, IdString pip) { groups[group].pips.push_back(pip); }
+void Arch::addGroupPip(IdString group, IdString pip) { groups[group].pips.push_back(pip_id(pip)); }
 
 void Arch::addGroupGroup(IdString group, IdString grp) { groups[group].groups.push_back(grp); }
 
@@ -188,22 +348,22 @@ void Arch::addDecalGraphic(DecalId decal, const GraphicElement &graphic)
     refreshUi();
 }
 
-void Arch::setWireDecal(WireId wire, DecalXY decalxy)
+void Arch::setWireDecal(IdString wire, DecalXY decalxy)
 {
     wire_info(wire).decalxy = decalxy;
-    refreshUiWire(wire);
+    refreshUiWire(wire_id(wire));
 }
 
-void Arch::setPipDecal(PipId pip, DecalXY decalxy)
+void Arch::setPipDecal(IdString pip, DecalXY decalxy)
 {
     pip_info(pip).decalxy = decalxy;
-    refreshUiPip(pip);
+    refreshUiPip(pip_id(pip));
 }
 
-void Arch::setBelDecal(BelId bel, DecalXY decalxy)
+void Arch::setBelDecal(IdString bel, DecalXY decalxy)
 {
     bel_info(bel).decalxy = decalxy;
-    refreshUiBel(bel);
+    refreshUiBel(bel_id(bel));
 }
 
 void Arch::setGroupDecal(GroupId group, DecalXY decalxy)
@@ -272,16 +432,17 @@ void IdString::initialize_arch(const BaseCtx *ctx) {}
 
 BelId Arch::getBelByName(IdString name) const
 {
-    if (bels.count(name))
-        return name;
+    auto it = bel_by_name.find(name);
+    if (it != bel_by_name.end())
+        return it->second;
     return BelId();
 }
 
-IdString Arch::getBelName(BelId bel) const { return bel; }
+IdString Arch::getBelName(BelId bel) const { return bels.at(bel.index).name; }
 
 Loc Arch::getBelLocation(BelId bel) const
 {
-    auto &info = bels.at(bel);
+    auto &info = bels.at(bel.index);
     return Loc(info.x, info.y, info.z);
 }
 
@@ -295,7 +456,7 @@ BelId Arch::getBelByLocation(Loc loc) const
 
 const std::vector<BelId> &Arch::getBelsByTile(int x, int y) const { return bels_by_tile.at(x).at(y); }
 
-bool Arch::getBelGlobalBuf(BelId bel) const { return bels.at(bel).gb; }
+bool Arch::getBelGlobalBuf(BelId bel) const { return bels.at(bel.index).gb; }
 
 uint32_t Arch::getBelChecksum(BelId bel) const
 {
@@ -305,7 +466,7 @@ uint32_t Arch::getBelChecksum(BelId bel) const
 
 void Arch::bindBel(BelId bel, CellInfo *cell, PlaceStrength strength)
 {
-    bels.at(bel).bound_cell = cell;
+    bels.at(bel.index).bound_cell = cell;
     cell->bel = bel;
     cell->belStrength = strength;
     refreshUiBel(bel);
@@ -313,38 +474,45 @@ void Arch::bindBel(BelId bel, CellInfo *cell, PlaceStrength strength)
 
 void Arch::unbindBel(BelId bel)
 {
-    bels.at(bel).bound_cell->bel = BelId();
-    bels.at(bel).bound_cell->belStrength = STRENGTH_NONE;
-    bels.at(bel).bound_cell = nullptr;
+    bels.at(bel.index).bound_cell->bel = BelId();
+    bels.at(bel.index).bound_cell->belStrength = STRENGTH_NONE;
+    bels.at(bel.index).bound_cell = nullptr;
     refreshUiBel(bel);
 }
 
-bool Arch::checkBelAvail(BelId bel) const { return bels.at(bel).bound_cell == nullptr; }
+bool Arch::checkBelAvail(BelId bel) const { return bels.at(bel.index).bound_cell == nullptr; }
 
-CellInfo *Arch::getBoundBelCell(BelId bel) const { return bels.at(bel).bound_cell; }
+CellInfo *Arch::getBoundBelCell(BelId bel) const { return bels.at(bel.index).bound_cell; }
 
-CellInfo *Arch::getConflictingBelCell(BelId bel) const { return bels.at(bel).bound_cell; }
+CellInfo *Arch::getConflictingBelCell(BelId bel) const { return bels.at(bel.index).bound_cell; }
 
 const std::vector<BelId> &Arch::getBels() const { return bel_ids; }
 
-IdString Arch::getBelType(BelId bel) const { return bels.at(bel).type; }
+const std::vector<BelId> &Arch::getBelsByType(IdString type) const
+{
+    static const std::vector<BelId> no_bels;
+    auto fnd = bels_by_type.find(type);
+    return fnd == bels_by_type.end() ? no_bels : fnd->second;
+}
+
+IdString Arch::getBelType(BelId bel) const { return bels.at(bel.index).type; }
 
-const std::map<IdString, std::string> &Arch::getBelAttrs(BelId bel) const { return bels.at(bel).attrs; }
+const std::map<IdString, std::string> &Arch::getBelAttrs(BelId bel) const { return bels.at(bel.index).attrs; }
 
 WireId Arch::getBelPinWire(BelId bel, IdString pin) const
 {
-    const auto &bdata = bels.at(bel);
+    const auto &bdata = bels.at(bel.index);
     if (!bdata.pins.count(pin))
-        log_error("bel '%s' has no pin '%s'\n", bel.c_str(this), pin.c_str(this));
+        log_error("bel '%s' has no pin '%s'\n", bdata.name.c_str(this), pin.c_str(this));
     return bdata.pins.at(pin).wire;
 }
 
-PortType Arch::getBelPinType(BelId bel, IdString pin) const { return bels.at(bel).pins.at(pin).type; }
+PortType Arch::getBelPinType(BelId bel, IdString pin) const { return bels.at(bel.index).pins.at(pin).type; }
 
 std::vector<IdString> Arch::getBelPins(BelId bel) const
 {
     std::vector<IdString> ret;
-    for (auto &it : bels.at(bel).pins)
+    for (auto &it : bels.at(bel.index).pins)
         ret.push_back(it.first);
     return ret;
 }
@@ -353,16 +521,17 @@ std::vector<IdString> Arch::getBelPins(BelId bel) const
 
 WireId Arch::getWireByName(IdString name) const
 {
-    if (wires.count(name))
-        return name;
+    auto it = wire_by_name.find(name);
+    if (it != wire_by_name.end())
+        return it->second;
     return WireId();
 }
 
-IdString Arch::getWireName(WireId wire) const { return wire; }
+IdString Arch::getWireName(WireId wire) const { return wires.at(wire.index).name; }
 
-IdString Arch::getWireType(WireId wire) const { return wires.at(wire).type; }
+IdString Arch::getWireType(WireId wire) const { return wires.at(wire.index).type; }
 
-const std::map<IdString, std::string> &Arch::getWireAttrs(WireId wire) const { return wires.at(wire).attrs; }
+const std::map<IdString, std::string> &Arch::getWireAttrs(WireId wire) const { return wires.at(wire.index).attrs; }
 
 uint32_t Arch::getWireChecksum(WireId wire) const
 {
@@ -372,34 +541,36 @@ uint32_t Arch::getWireChecksum(WireId wire) const
 
 void Arch::bindWire(WireId wire, NetInfo *net, PlaceStrength strength)
 {
-    wires.at(wire).bound_net = net;
+    wires.at(wire.index).bound_net = net;
     net->wires[wire].pip = PipId();
     net->wires[wire].strength = strength;
+    net->route_version++;
     refreshUiWire(wire);
 }
 
 void Arch::unbindWire(WireId wire)
 {
-    auto &net_wires = wires.at(wire).bound_net->wires;
+    auto &net_wires = wires.at(wire.index).bound_net->wires;
 
     auto pip = net_wires.at(wire).pip;
     if (pip != PipId()) {
-        pips.at(pip).bound_net = nullptr;
+        pips.at(pip.index).bound_net = nullptr;
         refreshUiPip(pip);
     }
 
     net_wires.erase(wire);
-    wires.at(wire).bound_net = nullptr;
+    wires.at(wire.index).bound_net->route_version++;
+    wires.at(wire.index).bound_net = nullptr;
     refreshUiWire(wire);
 }
 
-bool Arch::checkWireAvail(WireId wire) const { return wires.at(wire).bound_net == nullptr; }
+bool Arch::checkWireAvail(WireId wire) const { return wires.at(wire.index).bound_net == nullptr; }
 
-NetInfo *Arch::getBoundWireNet(WireId wire) const { return wires.at(wire).bound_net; }
+NetInfo *Arch::getBoundWireNet(WireId wire) const { return wires.at(wire.index).bound_net; }
 
-NetInfo *Arch::getConflictingWireNet(WireId wire) const { return wires.at(wire).bound_net; }
+NetInfo *Arch::getConflictingWireNet(WireId wire) const { return wires.at(wire.index).bound_net; }
 
-const std::vector<BelPin> &Arch::getWireBelPins(WireId wire) const { return wires.at(wire).bel_pins; }
+const std::vector<BelPin> &Arch::getWireBelPins(WireId wire) const { return wires.at(wire.index).bel_pins; }
 
 const std::vector<WireId> &Arch::getWires() const { return wire_ids; }
 
@@ -407,16 +578,32 @@ const std::vector<WireId> &Arch::getWires() const { return wire_ids; }
 
 PipId Arch::getPipByName(IdString name) const
 {
-    if (pips.count(name))
-        return name;
+    auto it = pip_by_name.find(name);
+    if (it != pip_by_name.end())
+        return it->second;
+    // Names made up for bulk added pips
+    const std::string &str = name.str(this);
+    if (str.size() > 4 && str.size() <= 13 && str.compare(0, 4, "$pip") == 0 &&
+        str.find_first_not_of("0123456789", 4) == std::string::npos) {
+        PipId pip;
+        pip.index = std::stoi(str.substr(4));
+        if (pip.index < int32_t(pips.size()) && pips[pip.index].name == IdString())
+            return pip;
+    }
     return PipId();
 }
 
-IdString Arch::getPipName(PipId pip) const { return pip; }
+IdString Arch::getPipName(PipId pip) const
+{
+    const PipInfo &pi = pips.at(pip.index);
+    if (pi.name == IdString())
+        return id("$pip" + std::to_string(pip.index));
+    return pi.name;
+}
 
-IdString Arch::getPipType(PipId pip) const { return pips.at(pip).type; }
+IdString Arch::getPipType(PipId pip) const { return pips.at(pip.index).type; }
 
-const std::map<IdString, std::string> &Arch::getPipAttrs(PipId pip) const { return pips.at(pip).attrs; }
+const std::map<IdString, std::string> &Arch::getPipAttrs(PipId pip) const { return pips.at(pip.index).attrs; }
 
 uint32_t Arch::getPipChecksum(PipId wire) const
 {
@@ -426,48 +613,54 @@ uint32_t Arch::getPipChecksum(PipId wire) const
 
 void Arch::bindPip(PipId pip, NetInfo *net, PlaceStrength strength)
 {
-    WireId wire = pips.at(pip).dstWire;
-    pips.at(pip).bound_net = net;
-    wires.at(wire).bound_net = net;
+    WireId wire = pips.at(pip.index).dstWire;
+    pips.at(pip.index).bound_net = net;
+    wires.at(wire.index).bound_net = net;
     net->wires[wire].pip = pip;
     net->wires[wire].strength = strength;
+    net->route_version++;
     refreshUiPip(pip);
     refreshUiWire(wire);
 }
 
 void Arch::unbindPip(PipId pip)
 {
-    WireId wire = pips.at(pip).dstWire;
-    wires.at(wire).bound_net->wires.erase(wire);
-    pips.at(pip).bound_net = nullptr;
-    wires.at(wire).bound_net = nullptr;
+    WireId wire = pips.at(pip.index).dstWire;
+    wires.at(wire.index).bound_net->wires.erase(wire);
+    wires.at(wire.index).bound_net->route_version++;
+    pips.at(pip.index).bound_net = nullptr;
+    wires.at(wire.index).bound_net = nullptr;
     refreshUiPip(pip);
     refreshUiWire(wire);
 }
 
-bool Arch::checkPipAvail(PipId pip) const { return pips.at(pip).bound_net == nullptr; }
+bool Arch::checkPipAvail(PipId pip) const { return pips.at(pip.index).bound_net == nullptr; }
 
-NetInfo *Arch::getBoundPipNet(PipId pip) const { return pips.at(pip).bound_net; }
+NetInfo *Arch::getBoundPipNet(PipId pip) const { return pips.at(pip.index).bound_net; }
 
-NetInfo *Arch::getConflictingPipNet(PipId pip) const { return pips.at(pip).bound_net; }
+NetInfo *Arch::getConflictingPipNet(PipId pip) const { return pips.at(pip.index).bound_net; }
 
-WireId Arch::getConflictingPipWire(PipId pip) const { return pips.at(pip).bound_net ? pips.at(pip).dstWire : WireId(); }
+WireId Arch::getConflictingPipWire(PipId pip) const
+{
+    const PipInfo &pi = pips.at(pip.index);
+    return pi.bound_net ? pi.dstWire : WireId();
+}
 
 const std::vector<PipId> &Arch::getPips() const { return pip_ids; }
 
-Loc Arch::getPipLocation(PipId pip) const { return pips.at(pip).loc; }
+Loc Arch::getPipLocation(PipId pip) const { return pips.at(pip.index).loc; }
 
-WireId Arch::getPipSrcWire(PipId pip) const { return pips.at(pip).srcWire; }
+WireId Arch::getPipSrcWire(PipId pip) const { return pips.at(pip.index).srcWire; }
 
-WireId Arch::getPipDstWire(PipId pip) const { return pips.at(pip).dstWire; }
+WireId Arch::getPipDstWire(PipId pip) const { return pips.at(pip.index).dstWire; }
 
-DelayInfo Arch::getPipDelay(PipId pip) const { return pips.at(pip).delay; }
+DelayInfo Arch::getPipDelay(PipId pip) const { return pips.at(pip.index).delay; }
 
-const std::vector<PipId> &Arch::getPipsDownhill(WireId wire) const { return wires.at(wire).downhill; }
+const std::vector<PipId> &Arch::getPipsDownhill(WireId wire) const { return wires.at(wire.index).downhill; }
 
-const std::vector<PipId> &Arch::getPipsUphill(WireId wire) const { return wires.at(wire).uphill; }
+const std::vector<PipId> &Arch::getPipsUphill(WireId wire) const { return wires.at(wire.index).uphill; }
 
-const std::vector<PipId> &Arch::getWireAliases(WireId wire) const { return wires.at(wire).aliases; }
+const std::vector<PipId> &Arch::getWireAliases(WireId wire) const { return wires.at(wire.index).aliases; }
 
 // ---------------------------------------------------------------
 
@@ -495,8 +688,8 @@ const std::vector<GroupId> &Arch::getGroupGroups(GroupId group) const { return g
 
 delay_t Arch::estimateDelay(WireId src, WireId dst) const
 {
-    const WireInfo &s = wires.at(src);
-    const WireInfo &d = wires.at(dst);
+    const WireInfo &s = wires.at(src.index);
+    const WireInfo &d = wires.at(dst.index);
     int dx = abs(s.x - d.x);
     int dy = abs(s.y - d.y);
     return (dx + dy) * args.delayScale + args.delayOffset;
@@ -519,10 +712,10 @@ ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
 {
     ArcBounds bb;
 
-    int src_x = wires.at(src).x;
-    int src_y = wires.at(src).y;
-    int dst_x = wires.at(dst).x;
-    int dst_y = wires.at(dst).y;
+    int src_x = wires.at(src.index).x;
+    int src_y = wires.at(src.index).y;
+    int dst_x = wires.at(dst.index).x;
+    int dst_y = wires.at(dst.index).y;
 
     bb.x0 = src_x;
     bb.y0 = src_y;
@@ -604,11 +797,11 @@ const std::vector<GraphicElement> &Arch::getDecalGraphics(DecalId decal) const
     return decal_graphics.at(decal);
 }
 
-DecalXY Arch::getBelDecal(BelId bel) const { return bels.at(bel).decalxy; }
+DecalXY Arch::getBelDecal(BelId bel) const { return bels.at(bel.index).decalxy; }
 
-DecalXY Arch::getWireDecal(WireId wire) const { return wires.at(wire).decalxy; }
+DecalXY Arch::getWireDecal(WireId wire) const { return wires.at(wire.index).decalxy; }
 
-DecalXY Arch::getPipDecal(PipId pip) const { return pips.at(pip).decalxy; }
+DecalXY Arch::getPipDecal(PipId pip) const { return pips.at(pip.index).decalxy; }
 
 DecalXY Arch::getGroupDecal(GroupId group) const { return groups.at(group).decalxy; }
 
@@ -117,20 +117,31 @@ struct Arch : BaseCtx
 {
     std::string chipName;
 
-    std::unordered_map<IdString, WireInfo> wires;
-    std::unordered_map<IdString, PipInfo> pips;
-    std::unordered_map<IdString, BelInfo> bels;
+    // Indexed by WireId/PipId/BelId::index
+    std::vector<WireInfo> wires;
+    std::vector<PipInfo> pips;
+    std::vector<BelInfo> bels;
     std::unordered_map<GroupId, GroupInfo> groups;
 
+    std::unordered_map<IdString, WireId> wire_by_name;
+    std::unordered_map<IdString, PipId> pip_by_name;
+    std::unordered_map<IdString, BelId> bel_by_name;
+
     // These functions include useful errors if not found
-    WireInfo &wire_info(IdString wire);
-    PipInfo &pip_info(IdString wire);
-    BelInfo &bel_info(IdString wire);
+    WireId wire_id(IdString wire) const;
+    PipId pip_id(IdString pip) const;
+    BelId bel_id(IdString bel) const;
+    WireInfo &wire_info(IdString wire) { return wires[wire_id(wire).index]; }
+    PipInfo &pip_info(IdString pip) { return pips[pip_id(pip).index]; }
+    BelInfo &bel_info(IdString bel) { return bels[bel_id(bel).index]; }
 
-    std::vector<IdString> bel_ids, wire_ids, pip_ids;
+    std::vector<BelId> bel_ids;
+    std::vector<WireId> wire_ids;
+    std::vector<PipId> pip_ids;
 
     std::unordered_map<Loc, BelId> bel_by_loc;
     std::vector<std::vector<std::vector<BelId>>> bels_by_tile;
+    std::unordered_map<IdString, std::vector<BelId>> bels_by_type;
 
     std::unordered_map<DecalId, std::vector<GraphicElement>> decal_graphics;
 
@@ -144,6 +155,13 @@ struct Arch : BaseCtx
     void addPip(IdString name, IdString type, IdString srcWire, IdString dstWire, DelayInfo delay, Loc loc);
     void addAlias(IdString name, IdString type, IdString srcWire, IdString dstWire, DelayInfo delay);
 
+    // Bulk construction for large devices. Wires are numbered from 0 in the order they are added, and pips added in
+    // bulk refer to them by that index. Bulk pips have no stored name, getPipName makes up "$pip<index>" instead
+    void addWires(const std::vector<IdString> &names, IdString type, const int32_t *x, const int32_t *y);
+    void addPips(IdString type, const int32_t *src, const int32_t *dst, const float *delay, size_t count);
+    // Add the wires and pips from a binary graph file, see docs/generic.md for the format
+    void loadGraph(const std::string &filename);
+
     void addBel(IdString name, IdString type, Loc loc, bool gb);
     void addBelInput(IdString bel, IdString name, IdString wire);
     void addBelOutput(IdString bel, IdString name, IdString wire);
@@ -155,9 +173,9 @@ struct Arch : BaseCtx
     void addGroupGroup(IdString group, IdString grp);
 
     void addDecalGraphic(DecalId decal, const GraphicElement &graphic);
-    void setWireDecal(WireId wire, DecalXY decalxy);
-    void setPipDecal(PipId pip, DecalXY decalxy);
-    void setBelDecal(BelId bel, DecalXY decalxy);
+    void setWireDecal(IdString wire, DecalXY decalxy);
+    void setPipDecal(IdString pip, DecalXY decalxy);
+    void setBelDecal(IdString bel, DecalXY decalxy);
     void setGroupDecal(GroupId group, DecalXY decalxy);
 
     void setWireAttr(IdString wire, IdString key, const std::string &value);
@@ -202,6 +220,7 @@ struct Arch : BaseCtx
     CellInfo *getBoundBelCell(BelId bel) const;
     CellInfo *getConflictingBelCell(BelId bel) const;
     const std::vector<BelId> &getBels() const;
+    const std::vector<BelId> &getBelsByType(IdString type) const;
     IdString getBelType(BelId bel) const;
     const std::map<IdString, std::string> &getBelAttrs(BelId bel) const;
     WireId getBelPinWire(BelId bel, IdString pin) const;
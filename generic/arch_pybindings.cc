@@ -20,7 +20,9 @@
 
 #ifndef NO_PYTHON
 
+#include <string.h>
 #include "arch_pybindings.h"
+#include "log.h"
 #include "nextpnr.h"
 #include "pybindings.h"
 #include "pywrappers.h"
@@ -35,6 +37,77 @@ template <> struct string_converter<const IdString &>
 };
 } // namespace PythonConversion
 
+namespace {
+template <typename T, typename S> void append_buffer(std::vector<T> &out, const Py_buffer &view)
+{
+    const S *data = reinterpret_cast<const S *>(view.buf);
+    size_t count = view.len / sizeof(S);
+    out.reserve(count);
+    for (size_t i = 0; i < count; i++)
+        out.push_back(T(data[i]));
+}
+
+// Read a numpy array, or anything else supporting the buffer protocol, as a vector of numbers. Other iterables are
+// read element by element
+template <typename T> std::vector<T> numbers_from_python(object obj)
+{
+    std::vector<T> ret;
+    Py_buffer view;
+    if (!PyObject_CheckBuffer(obj.ptr()) ||
+        PyObject_GetBuffer(obj.ptr(), &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0) {
+        PyErr_Clear();
+        ret.insert(ret.end(), stl_input_iterator<T>(obj), stl_input_iterator<T>());
+        return ret;
+    }
+    // Native or little endian formats only, skip the byte order character
+    const char *fmt = view.format;
+    if (*fmt == '@' || *fmt == '=' || *fmt == '<')
+        fmt++;
+    bool is_signed = (strchr("bhilq", *fmt) != nullptr);
+    bool is_unsigned = (strchr("BHILQ", *fmt) != nullptr);
+    bool ok = true;
+    if (*fmt == 'f' && view.itemsize == 4)
+        append_buffer<T, float>(ret, view);
+    else if (*fmt == 'd' && view.itemsize == 8)
+        append_buffer<T, double>(ret, view);
+    else if ((is_signed || is_unsigned) && view.itemsize == 1)
+        is_signed ? append_buffer<T, int8_t>(ret, view) : append_buffer<T, uint8_t>(ret, view);
+    else if ((is_signed || is_unsigned) && view.itemsize == 2)
+        is_signed ? append_buffer<T, int16_t>(ret, view) : append_buffer<T, uint16_t>(ret, view);
+    else if ((is_signed || is_unsigned) && view.itemsize == 4)
+        is_signed ? append_buffer<T, int32_t>(ret, view) : append_buffer<T, uint32_t>(ret, view);
+    else if ((is_signed || is_unsigned) && view.itemsize == 8)
+        is_signed ? append_buffer<T, int64_t>(ret, view) : append_buffer<T, uint64_t>(ret, view);
+    else
+        ok = false;
+    std::string format = view.format;
+    PyBuffer_Release(&view);
+    if (!ok)
+        log_error("unsupported array format '%s'\n", format.c_str());
+    return ret;
+}
+
+void add_wires(Context &ctx, object names, std::string type, object x, object y)
+{
+    std::vector<IdString> wire_names;
+    for (stl_input_iterator<std::string> it(names), end; it != end; ++it)
+        wire_names.push_back(ctx.id(*it));
+    std::vector<int32_t> wire_x = numbers_from_python<int32_t>(x), wire_y = numbers_from_python<int32_t>(y);
+    if (wire_x.size() != wire_names.size() || wire_y.size() != wire_names.size())
+        log_error("addWires needs as many x and y coordinates as wire names\n");
+    ctx.addWires(wire_names, ctx.id(type), wire_x.data(), wire_y.data());
+}
+
+void add_pips(Context &ctx, object src, object dst, object delay, std::string type)
+{
+    std::vector<int32_t> pip_src = numbers_from_python<int32_t>(src), pip_dst = numbers_from_python<int32_t>(dst);
+    std::vector<float> pip_delay = numbers_from_python<float>(delay);
+    if (pip_dst.size() != pip_src.size() || pip_delay.size() != pip_src.size())
+        log_error("addPips needs the same number of source wires, destination wires and delays\n");
+    ctx.addPips(ctx.id(type), pip_src.data(), pip_dst.data(), pip_delay.data(), pip_src.size());
+}
+} // namespace
+
 void arch_wrap_python()
 {
     using namespace PythonConversion;
@@ -55,7 +128,9 @@ void arch_wrap_python()
                            .def("place", &Context::place)
                            .def("route", &Context::route);
 
-    class_<BelPin>("BelPin").def_readwrite("bel", &BelPin::bel).def_readwrite("pin", &BelPin::pin);
+    auto belpin_cls = class_<ContextualWrapper<BelPin>>("BelPin", no_init);
+    readonly_wrapper<BelPin, decltype(&BelPin::bel), &BelPin::bel, conv_to_str<BelId>>::def_wrap(belpin_cls, "bel");
+    readonly_wrapper<BelPin, decltype(&BelPin::pin), &BelPin::pin, conv_to_str<IdString>>::def_wrap(belpin_cls, "pin");
 
     class_<DelayInfo>("DelayInfo").def("maxDelay", &DelayInfo::maxDelay).def("minDelay", &DelayInfo::minDelay);
 
@@ -139,8 +214,8 @@ void arch_wrap_python()
     fn_wrapper_3a<Context, decltype(&Context::constructDecalXY), &Context::constructDecalXY, wrap_context<DecalXY>,
                   conv_from_str<DecalId>, pass_through<float>, pass_through<float>>::def_wrap(ctx_cls, "DecalXY");
 
-    typedef std::unordered_map<IdString, std::unique_ptr<CellInfo>> CellMap;
-    typedef std::unordered_map<IdString, std::unique_ptr<NetInfo>> NetMap;
+    typedef indexed_dict<IdString, std::unique_ptr<CellInfo>> CellMap;
+    typedef indexed_dict<IdString, std::unique_ptr<NetInfo>> NetMap;
     typedef std::unordered_map<IdString, HierarchicalCell> HierarchyMap;
 
     readonly_wrapper<Context, decltype(&Context::cells), &Context::cells, wrap_context<CellMap &>>::def_wrap(ctx_cls,
@@ -165,6 +240,11 @@ void arch_wrap_python()
                     pass_through<DelayInfo>>::def_wrap(ctx_cls, "addAlias",
                                                        (arg("name"), "type", "srcWire", "dstWire", "delay"));
 
+    ctx_cls.def("addWires", add_wires, (arg("names"), "type", "x", "y"));
+    ctx_cls.def("addPips", add_pips, (arg("src"), "dst", "delay", arg("type") = ""));
+    fn_wrapper_1a_v<Context, decltype(&Context::loadGraph), &Context::loadGraph,
+                    pass_through<std::string>>::def_wrap(ctx_cls, "loadGraph", arg("filename"));
+
     fn_wrapper_4a_v<Context, decltype(&Context::addBel), &Context::addBel, conv_from_str<IdString>,
                     conv_from_str<IdString>, pass_through<Loc>, pass_through<bool>>::def_wrap(ctx_cls, "addBel",
                                                                                               (arg("name"), "type",
@@ -234,6 +314,10 @@ void arch_wrap_python()
     WRAP_MAP_UPTR(NetMap, "IdNetMap");
     WRAP_MAP(HierarchyMap, wrap_context<HierarchicalCell &>, "HierarchyMap");
     WRAP_VECTOR(const std::vector<IdString>, conv_to_str<IdString>);
+    WRAP_VECTOR(const std::vector<BelId>, conv_to_str<BelId>);
+    WRAP_VECTOR(const std::vector<WireId>, conv_to_str<WireId>);
+    WRAP_VECTOR(const std::vector<PipId>, conv_to_str<PipId>);
+    WRAP_VECTOR(const std::vector<BelPin>, wrap_context<BelPin>);
 }
 
 NEXTPNR_NAMESPACE_END
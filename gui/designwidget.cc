@@ -87,6 +87,7 @@ DesignWidget::DesignWidget(QWidget *parent) : QWidget(parent), ctx(nullptr)
     searchEdit->addAction(QIcon(":/icons/resources/zoom.png"), QLineEdit::LeadingPosition);
     searchEdit->setPlaceholderText("Search...");
     connect(searchEdit, &QLineEdit::returnPressed, this, &DesignWidget::onSearchInserted);
+    connect(searchEdit, &QLineEdit::textEdited, this, &DesignWidget::onSearchEdited);
 
     actionFirst = new QAction("", this);
     actionFirst->setIcon(QIcon(":/icons/resources/resultset_first.png"));
@@ -1039,6 +1040,15 @@ void DesignWidget::onSearchInserted()
                                                                    QItemSelectionModel::ClearAndSelect);
 }
 
+// Search as the user types, Return then steps through the results
+void DesignWidget::onSearchEdited(const QString &text)
+{
+    if (ctx == nullptr || text.isEmpty())
+        return;
+    currentSearch = QString();
+    onSearchInserted();
+}
+
 void DesignWidget::onHoverIndexChanged(int num, QModelIndex index)
 {
     if (index.isValid()) {
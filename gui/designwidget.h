@@ -87,6 +87,7 @@ class DesignWidget : public QWidget
     void onItemDoubleClicked(QTreeWidgetItem *item, int column);
     void onDoubleClicked(const QModelIndex &index);
     void onSearchInserted();
+    void onSearchEdited(const QString &text);
     void onHoverIndexChanged(int num, QModelIndex index);
     void onHoverPropertyChanged(QtBrowserItem *item);
   public Q_SLOTS:
@@ -34,9 +34,75 @@
 #include "fpgaviewwidget.h"
 #include "log.h"
 #include "mainwindow.h"
+#include "thread_pool.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
+namespace {
+// Fetch the decals of elements that changed since the last render, and mark
+// the chunks holding them for re-rendering. Returns whether anything changed.
+template <typename Id, typename Chunk, typename GetDecal>
+bool refreshDecals(std::unordered_set<Id> &changed, const std::unordered_map<Id, size_t> &index,
+                   std::vector<DecalXY> &decals, std::vector<Chunk> &chunks, size_t chunkSize, GetDecal getDecal)
+{
+    bool any = false;
+    for (auto id : changed) {
+        auto found = index.find(id);
+        if (found == index.end())
+            continue;
+        decals[found->second] = getDecal(id);
+        chunks[found->second / chunkSize].dirty = true;
+        any = true;
+    }
+    changed.clear();
+    return any;
+}
+
+// Set whether a decal is drawn as bound, for architectures with decals that depend on it.
+template <typename D> auto setDecalActive(D &decal, bool active, int) -> decltype(decal.active = active, void())
+{
+    decal.active = active;
+}
+template <typename D> void setDecalActive(D &, bool, long) {}
+
+// The bels, wires and pips in use in a design snapshot.
+struct BoundObjects
+{
+    std::unordered_set<BelId> bels;
+    std::unordered_set<WireId> wires;
+    std::unordered_set<PipId> pips;
+
+    explicit BoundObjects(const DesignSnapshot *snapshot)
+    {
+        if (snapshot == nullptr)
+            return;
+        for (auto &cb : snapshot->cell_bels)
+            bels.insert(cb.second);
+        for (auto &nw : snapshot->net_wires) {
+            for (auto &wp : nw.second) {
+                wires.insert(wp.first);
+                if (wp.second != PipId())
+                    pips.insert(wp.second);
+            }
+        }
+    }
+};
+
+// The objects bound in only one of two sets.
+template <typename Id>
+std::unordered_set<Id> boundDifference(const std::unordered_set<Id> &a, const std::unordered_set<Id> &b)
+{
+    std::unordered_set<Id> result;
+    for (auto id : a)
+        if (!b.count(id))
+            result.insert(id);
+    for (auto id : b)
+        if (!a.count(id))
+            result.insert(id);
+    return result;
+}
+} // namespace
+
 FPGAViewWidget::FPGAViewWidget(QWidget *parent)
         : QOpenGLWidget(parent), movieSaving(false), ctx_(nullptr), paintTimer_(this), lineShader_(this), zoom_(10.0f),
           rendererArgs_(new FPGAViewWidget::RendererArgs), rendererData_(new FPGAViewWidget::RendererData)
@@ -61,6 +127,8 @@ FPGAViewWidget::FPGAViewWidget(QWidget *parent)
     rendererArgs_->changed = false;
     rendererArgs_->gridChanged = false;
     rendererArgs_->zoomOutbound = true;
+    rendererArgs_->lod = LOD_FULL;
+    rendererArgs_->lodChanged = false;
 
     connect(&paintTimer_, SIGNAL(timeout()), this, SLOT(update()));
     paintTimer_.start(1000 / 20); // paint GL 20 times per second
@@ -234,7 +302,7 @@ void FPGAViewWidget::renderArchDecal(LineShaderData out[GraphicElement::STYLE_MA
     }
 }
 
-void FPGAViewWidget::populateQuadTree(RendererData *data, const DecalXY &decal, const PickedElement &element)
+void FPGAViewWidget::getPickBoxes(const DecalXY &decal, std::vector<PickQuadTree::BoundingBox> &out)
 {
     float x = decal.x;
     float y = decal.y;
@@ -244,10 +312,9 @@ void FPGAViewWidget::populateQuadTree(RendererData *data, const DecalXY &decal,
             continue;
         }
 
-        bool res = true;
         if (el.type == GraphicElement::TYPE_BOX) {
             // Boxes are bounded by themselves.
-            res = data->qt->insert(PickQuadTree::BoundingBox(x + el.x1, y + el.y1, x + el.x2, y + el.y2), element);
+            out.push_back(PickQuadTree::BoundingBox(x + el.x1, y + el.y1, x + el.x2, y + el.y2));
         }
 
         if (el.type == GraphicElement::TYPE_LINE || el.type == GraphicElement::TYPE_ARROW) {
@@ -266,15 +333,76 @@ void FPGAViewWidget::populateQuadTree(RendererData *data, const DecalXY &decal,
             x1 += 0.01;
             y1 += 0.01;
 
-            res = data->qt->insert(PickQuadTree::BoundingBox(x0, y0, x1, y1), element);
+            out.push_back(PickQuadTree::BoundingBox(x0, y0, x1, y1));
         }
+    }
+}
 
-        if (!res) {
-            NPNR_ASSERT_FALSE("populateQuadTree: could not insert element");
+void FPGAViewWidget::populateQuadTree(RendererData *data)
+{
+    // Enlarge the bounding box slightly for the picking - when we insert
+    // elements into it, we enlarge their bounding boxes slightly, so
+    // we need to give ourselves some sagery margin here.
+    auto bb = data->bbGlobal;
+    bb.setX0(bb.x0() - 1);
+    bb.setY0(bb.y0() - 1);
+    bb.setX1(bb.x1() + 1);
+    bb.setY1(bb.y1() + 1);
+    data->qt = std::unique_ptr<PickQuadTree>(new PickQuadTree(bb));
+
+    // Work out the boxes of each chunk in parallel, then insert them in a
+    // fixed order so that picking doesn't depend on thread timing.
+    const auto &cache = decalCache_;
+    size_t numChunks = cache.chunks.size();
+    std::vector<std::vector<PickQuadTree::BoundingBox>> boxes(numChunks);
+    std::vector<std::vector<size_t>> owners(numChunks);
+    ctx_->threadPool().parallel_for(numChunks, 1, [&](size_t chunk) {
+        size_t end = std::min(cache.decals.size(), (chunk + 1) * decalChunkSize_);
+        for (size_t i = chunk * decalChunkSize_; i < end; i++) {
+            getPickBoxes(cache.decals[i], boxes[chunk]);
+            owners[chunk].resize(boxes[chunk].size(), i);
+        }
+    });
+    for (size_t chunk = 0; chunk < numChunks; chunk++) {
+        for (size_t i = 0; i < boxes[chunk].size(); i++) {
+            if (!data->qt->insert(boxes[chunk][i], cache.elements[owners[chunk][i]])) {
+                NPNR_ASSERT_FALSE("populateQuadTree: could not insert element");
+            }
         }
     }
 }
 
+void FPGAViewWidget::renderDecalChunks(void)
+{
+    std::vector<size_t> dirty;
+    for (size_t chunk = 0; chunk < decalCache_.chunks.size(); chunk++)
+        if (decalCache_.chunks[chunk].dirty)
+            dirty.push_back(chunk);
+
+    ctx_->threadPool().parallel_for(dirty.size(), 1, [&](size_t i) {
+        DecalChunk &chunk = decalCache_.chunks[dirty[i]];
+        LineShaderData gfx[GraphicElement::STYLE_MAX];
+        chunk.bb.clear();
+        size_t end = std::min(decalCache_.decals.size(), (dirty[i] + 1) * decalChunkSize_);
+        for (size_t j = dirty[i] * decalChunkSize_; j < end; j++)
+            renderArchDecal(gfx, chunk.bb, decalCache_.decals[j]);
+        for (int style = 0; style < GraphicElement::STYLE_HIGHLIGHTED0; style++)
+            chunk.gfx[style] = std::make_shared<const LineShaderData>(std::move(gfx[style]));
+        chunk.dirty = false;
+    });
+    for (size_t chunk : dirty)
+        decalCache_.chunks[chunk].version = ++decalCache_.lastVersion;
+}
+
+FPGAViewWidget::LevelOfDetail FPGAViewWidget::lodForZoom(float zoom) const
+{
+    if (zoom >= lodTilesZoom_)
+        return LOD_TILES;
+    if (zoom >= lodBelsZoom_)
+        return LOD_BELS;
+    return LOD_FULL;
+}
+
 QMatrix4x4 FPGAViewWidget::getProjection(void)
 {
     QMatrix4x4 matrix;
@@ -301,6 +429,17 @@ void FPGAViewWidget::paintGL()
     float thick11Px = mouseToWorldDimensions(1.1, 0).x();
     float thick2Px = mouseToWorldDimensions(2, 0).x();
 
+    {
+        // Have the renderer switch detail level once zoomed across a tier.
+        LevelOfDetail lod = lodForZoom(zoom_);
+        QMutexLocker lock(&rendererArgsLock_);
+        if (lod != rendererArgs_->lod) {
+            rendererArgs_->lod = lod;
+            rendererArgs_->lodChanged = true;
+            pokeRenderer();
+        }
+    }
+
     {
         QMutexLocker locker(&rendererDataLock_);
         // Must be called from a thread holding the OpenGL context
@@ -329,17 +468,7 @@ void FPGAViewWidget::paintGL()
         if (movieCounter == currentFrameSkip) {
             QMutexLocker lock(&rendererArgsLock_);
             movieCounter = 0;
-            QImage image = grabFramebuffer();
-            if (!movieSkipSame || movieLastImage != image) {
-                currentMovieFrame++;
-
-                QString number = QString("movie_%1.png").arg(currentMovieFrame, 5, 10, QChar('0'));
-
-                QFileInfo fileName = QFileInfo(QDir(movieDir), number);
-                QImageWriter imageWriter(fileName.absoluteFilePath(), "png");
-                imageWriter.write(image);
-                movieLastImage = image;
-            }
+            movieWriter_->push(grabFramebuffer());
         } else {
             movieCounter++;
         }
@@ -367,6 +496,11 @@ void FPGAViewWidget::enableDisableDecals(bool bels, bool wires, bool pips, bool
     displayWire_ = wires;
     displayPip_ = pips;
     displayGroup_ = groups;
+    {
+        QMutexLocker lock(&rendererArgsLock_);
+        rendererArgs_->lodChanged = true;
+    }
+    pokeRenderer();
 }
 
 void FPGAViewWidget::renderLines(void)
@@ -374,76 +508,14 @@ void FPGAViewWidget::renderLines(void)
     if (ctx_ == nullptr)
         return;
 
-    // Data from Context needed to render all decals.
-    std::vector<std::pair<DecalXY, BelId>> belDecals;
-    std::vector<std::pair<DecalXY, WireId>> wireDecals;
-    std::vector<std::pair<DecalXY, PipId>> pipDecals;
-    std::vector<std::pair<DecalXY, GroupId>> groupDecals;
-    bool decalsChanged = false;
-    {
-        // Take the UI/Normal mutex on the Context, copy over all we need as
-        // fast as we can.
-        std::lock_guard<std::mutex> lock_ui(ctx_->ui_mutex);
-        std::lock_guard<std::mutex> lock(ctx_->mutex);
-
-        // For now, collapse any decal changes into change of all decals.
-        // TODO(q3k): fix this
-        if (ctx_->allUiReload) {
-            ctx_->allUiReload = false;
-            decalsChanged = true;
-        }
-        if (ctx_->frameUiReload) {
-            ctx_->frameUiReload = false;
-            decalsChanged = true;
-        }
-        if (ctx_->belUiReload.size() > 0) {
-            ctx_->belUiReload.clear();
-            decalsChanged = true;
-        }
-        if (ctx_->wireUiReload.size() > 0) {
-            ctx_->wireUiReload.clear();
-            decalsChanged = true;
-        }
-        if (ctx_->pipUiReload.size() > 0) {
-            ctx_->pipUiReload.clear();
-            decalsChanged = true;
-        }
-        if (ctx_->groupUiReload.size() > 0) {
-            ctx_->groupUiReload.clear();
-            decalsChanged = true;
-        }
-
-        // Local copy of decals, taken as fast as possible to not block the P&R.
-        if (decalsChanged) {
-            if (displayBel_) {
-                for (auto bel : ctx_->getBels()) {
-                    belDecals.push_back({ctx_->getBelDecal(bel), bel});
-                }
-            }
-            if (displayWire_) {
-                for (auto wire : ctx_->getWires()) {
-                    wireDecals.push_back({ctx_->getWireDecal(wire), wire});
-                }
-            }
-            if (displayPip_) {
-                for (auto pip : ctx_->getPips()) {
-                    pipDecals.push_back({ctx_->getPipDecal(pip), pip});
-                }
-            }
-            if (displayGroup_) {
-                for (auto group : ctx_->getGroups()) {
-                    groupDecals.push_back({ctx_->getGroupDecal(group), group});
-                }
-            }
-        }
-    }
-
     // Arguments from the main UI thread on what we should render.
     std::vector<DecalXY> selectedDecals;
     DecalXY hoveredDecal;
     std::vector<DecalXY> highlightedDecals[8];
     bool highlightedOrSelectedChanged;
     bool gridChanged;
+    LevelOfDetail lod;
+    bool lodChanged;
     {
         // Take the renderer arguments lock, copy over all we need.
         QMutexLocker lock(&rendererArgsLock_);
@@ -456,8 +528,103 @@ void FPGAViewWidget::renderLines(void)
 
         highlightedOrSelectedChanged = rendererArgs_->changed;
         gridChanged = rendererArgs_->gridChanged;
+        lod = rendererArgs_->lod;
+        lodChanged = rendererArgs_->lodChanged;
         rendererArgs_->changed = false;
         rendererArgs_->gridChanged = false;
+        rendererArgs_->lodChanged = false;
+    }
+
+    auto &cache = decalCache_;
+    bool decalsChanged = false;
+    // The design is read from snapshots published by the thread running P&R, so the Context locks are only needed
+    // to reload all decals.
+    std::shared_ptr<const DesignSnapshot> snapshot = ctx_->getSnapshot();
+    // Whether decals were added or moved, rather than only changing style.
+    bool fullReload = lodChanged || !cache.valid || (snapshot != nullptr && snapshot->ui_reload);
+    if (fullReload) {
+        // Take the UI/Normal mutex on the Context, copy over all we need as
+        // fast as we can.
+        std::lock_guard<std::mutex> lock_ui(ctx_->ui_mutex);
+        std::lock_guard<std::mutex> lock(ctx_->mutex);
+
+        ctx_->allUiReload = false;
+        ctx_->frameUiReload = false;
+        ctx_->groupUiReload.clear();
+        // The decals below are of the design as it is now, so the snapshot they're diffed against for later
+        // updates must be too.
+        cache.snapshot = ctx_->publishSnapshot();
+        // Local copy of decals, taken as fast as possible to not block the P&R.
+        cache.decals.clear();
+        cache.elements.clear();
+        cache.belIndex.clear();
+        cache.wireIndex.clear();
+        cache.pipIndex.clear();
+        cache.groupIndex.clear();
+        if (displayBel_ && lod <= LOD_BELS) {
+            for (auto bel : ctx_->getBels()) {
+                DecalXY decal = ctx_->getBelDecal(bel);
+                cache.belIndex[bel] = cache.decals.size();
+                cache.decals.push_back(decal);
+                cache.elements.push_back(PickedElement::fromBel(bel, decal.x, decal.y));
+            }
+        }
+        if (displayWire_ && lod == LOD_FULL) {
+            for (auto wire : ctx_->getWires()) {
+                DecalXY decal = ctx_->getWireDecal(wire);
+                cache.wireIndex[wire] = cache.decals.size();
+                cache.decals.push_back(decal);
+                cache.elements.push_back(PickedElement::fromWire(wire, decal.x, decal.y));
+            }
+        }
+        if (displayPip_ && lod == LOD_FULL) {
+            for (auto pip : ctx_->getPips()) {
+                DecalXY decal = ctx_->getPipDecal(pip);
+                cache.pipIndex[pip] = cache.decals.size();
+                cache.decals.push_back(decal);
+                cache.elements.push_back(PickedElement::fromPip(pip, decal.x, decal.y));
+            }
+        }
+        if (displayGroup_) {
+            for (auto group : ctx_->getGroups()) {
+                DecalXY decal = ctx_->getGroupDecal(group);
+                cache.groupIndex[group] = cache.decals.size();
+                cache.decals.push_back(decal);
+                cache.elements.push_back(PickedElement::fromGroup(group, decal.x, decal.y));
+            }
+        }
+        cache.chunks.clear();
+        cache.chunks.resize((cache.decals.size() + decalChunkSize_ - 1) / decalChunkSize_);
+        for (auto &chunk : cache.chunks)
+            chunk.dirty = true;
+        cache.valid = true;
+        decalsChanged = true;
+    } else if (snapshot != nullptr && snapshot != cache.snapshot) {
+        // Only the chunks holding decals of objects bound or unbound since the last snapshot need to be rendered
+        // again. Nothing but whether they are bound changes about them.
+        BoundObjects before(cache.snapshot.get()), after(snapshot.get());
+        auto belsChanged = boundDifference(before.bels, after.bels);
+        auto wiresChanged = boundDifference(before.wires, after.wires);
+        auto pipsChanged = boundDifference(before.pips, after.pips);
+        decalsChanged |= refreshDecals(belsChanged, cache.belIndex, cache.decals, cache.chunks, decalChunkSize_,
+                                       [&](BelId bel) {
+                                           DecalXY decal = cache.decals.at(cache.belIndex.at(bel));
+                                           setDecalActive(decal.decal, after.bels.count(bel) != 0, 0);
+                                           return decal;
+                                       });
+        decalsChanged |= refreshDecals(wiresChanged, cache.wireIndex, cache.decals, cache.chunks, decalChunkSize_,
+                                       [&](WireId wire) {
+                                           DecalXY decal = cache.decals.at(cache.wireIndex.at(wire));
+                                           setDecalActive(decal.decal, after.wires.count(wire) != 0, 0);
+                                           return decal;
+                                       });
+        decalsChanged |= refreshDecals(pipsChanged, cache.pipIndex, cache.decals, cache.chunks, decalChunkSize_,
+                                       [&](PipId pip) {
+                                           DecalXY decal = cache.decals.at(cache.pipIndex.at(pip));
+                                           setDecalActive(decal.decal, after.pips.count(pip) != 0, 0);
+                                           return decal;
+                                       });
+        cache.snapshot = snapshot;
     }
 
     // Render decals if necessary.
@@ -466,69 +633,44 @@ void FPGAViewWidget::renderLines(void)
         {
             QMutexLocker locker(&rendererDataLock_);
             for (int i = 0; i < GraphicElement::STYLE_HIGHLIGHTED0; i++)
-                last_render[i] = rendererData_->gfxByStyle[(enum GraphicElement::style_t)i].last_render;
+                last_render[i] = rendererData_->gfxByStyle[i].last_render;
         }
 
+        renderDecalChunks();
+
         auto data = std::unique_ptr<FPGAViewWidget::RendererData>(new FPGAViewWidget::RendererData);
-        // Reset bounding box.
+        // Reset bounding box, it always covers at least the grid.
         data->bbGlobal.clear();
-
-        // Draw Bels.
-        if (displayBel_) {
-            for (auto const &decal : belDecals) {
-                renderArchDecal(data->gfxByStyle, data->bbGlobal, decal.first);
-            }
-        }
-        // Draw Wires.
-        if (displayWire_) {
-            for (auto const &decal : wireDecals) {
-                renderArchDecal(data->gfxByStyle, data->bbGlobal, decal.first);
-            }
+        data->bbGlobal.setX0(0);
+        data->bbGlobal.setY0(0);
+        data->bbGlobal.setX1(ctx_->getGridDimX());
+        data->bbGlobal.setY1(ctx_->getGridDimY());
+
+        // Join up the chunks. Only the chunks are shared, so that the
+        // shader uploads no more than those rendered again.
+        for (int i = 0; i < GraphicElement::STYLE_HIGHLIGHTED0; i++) {
+            data->gfxByStyle[i].chunks.reserve(cache.chunks.size());
+            data->gfxByStyle[i].versions.reserve(cache.chunks.size());
         }
-        // Draw Pips.
-        if (displayPip_) {
-            for (auto const &decal : pipDecals) {
-                renderArchDecal(data->gfxByStyle, data->bbGlobal, decal.first);
-            }
-        }
-        // Draw Groups.
-        if (displayGroup_) {
-            for (auto const &decal : groupDecals) {
-                renderArchDecal(data->gfxByStyle, data->bbGlobal, decal.first);
+        for (auto &chunk : cache.chunks) {
+            for (int i = 0; i < GraphicElement::STYLE_HIGHLIGHTED0; i++) {
+                data->gfxByStyle[i].chunks.push_back(chunk.gfx[i]);
+                data->gfxByStyle[i].versions.push_back(chunk.version);
             }
+            data->bbGlobal.setX0(std::min(data->bbGlobal.x0(), chunk.bb.x0()));
+            data->bbGlobal.setY0(std::min(data->bbGlobal.y0(), chunk.bb.y0()));
+            data->bbGlobal.setX1(std::max(data->bbGlobal.x1(), chunk.bb.x1()));
+            data->bbGlobal.setY1(std::max(data->bbGlobal.y1(), chunk.bb.y1()));
         }
 
         // Bounding box should be calculated by now.
         NPNR_ASSERT(data->bbGlobal.w() != 0);
         NPNR_ASSERT(data->bbGlobal.h() != 0);
 
-        // Enlarge the bounding box slightly for the picking - when we insert
-        // elements into it, we enlarge their bounding boxes slightly, so
-        // we need to give ourselves some sagery margin here.
-        auto bb = data->bbGlobal;
-        bb.setX0(bb.x0() - 1);
-        bb.setY0(bb.y0() - 1);
-        bb.setX1(bb.x1() + 1);
-        bb.setY1(bb.y1() + 1);
-
-        // Populate picking quadtree.
-        data->qt = std::unique_ptr<PickQuadTree>(new PickQuadTree(bb));
-        for (auto const &decal : belDecals) {
-            populateQuadTree(data.get(), decal.first,
-                             PickedElement::fromBel(decal.second, decal.first.x, decal.first.y));
-        }
-        for (auto const &decal : wireDecals) {
-            populateQuadTree(data.get(), decal.first,
-                             PickedElement::fromWire(decal.second, decal.first.x, decal.first.y));
-        }
-        for (auto const &decal : pipDecals) {
-            populateQuadTree(data.get(), decal.first,
-                             PickedElement::fromPip(decal.second, decal.first.x, decal.first.y));
-        }
-        for (auto const &decal : groupDecals) {
-            populateQuadTree(data.get(), decal.first,
-                             PickedElement::fromGroup(decal.second, decal.first.x, decal.first.y));
-        }
+        // Populate picking quadtree. Changes of style alone don't move
+        // anything, so the current one is kept for those.
+        if (fullReload)
+            populateQuadTree(data.get());
 
         // Swap over.
         {
@@ -543,8 +685,10 @@ void FPGAViewWidget::renderLines(void)
                 for (int i = 0; i < 8; i++)
                     data->gfxHighlighted[i] = rendererData_->gfxHighlighted[i];
             }
+            if (!fullReload)
+                data->qt = std::move(rendererData_->qt);
             for (int i = 0; i < GraphicElement::STYLE_HIGHLIGHTED0; i++)
-                data->gfxByStyle[(enum GraphicElement::style_t)i].last_render = ++last_render[i];
+                data->gfxByStyle[i].last_render = ++last_render[i];
             rendererData_ = std::move(data);
         }
     }
@@ -604,11 +748,10 @@ void FPGAViewWidget::renderLines(void)
 
 void FPGAViewWidget::movieStart(QString dir, long frameSkip, bool skipSame)
 {
+    movieStop();
     QMutexLocker locker(&rendererArgsLock_);
-    movieLastImage = QImage();
-    movieSkipSame = skipSame;
-    movieDir = dir;
-    currentMovieFrame = 0;
+    movieWriter_ = std::unique_ptr<MovieWriter>(new MovieWriter(this, dir, skipSame));
+    movieWriter_->start();
     movieCounter = 0;
     currentFrameSkip = frameSkip;
     movieSaving = true;
@@ -616,8 +759,65 @@ void FPGAViewWidget::movieStart(QString dir, long frameSkip, bool skipSame)
 
 void FPGAViewWidget::movieStop()
 {
-    QMutexLocker locker(&rendererArgsLock_);
-    movieSaving = false;
+    std::unique_ptr<MovieWriter> writer;
+    {
+        QMutexLocker locker(&rendererArgsLock_);
+        movieSaving = false;
+        writer = std::move(movieWriter_);
+    }
+    if (writer == nullptr)
+        return;
+    writer->finish();
+    if (writer->framesDropped() > 0)
+        log_warning("Movie writer could not keep up: %ld frames written, %ld dropped.\n", writer->framesWritten(),
+                    writer->framesDropped());
+}
+
+void MovieWriter::run(void)
+{
+    for (;;) {
+        QImage image;
+        {
+            QMutexLocker locker(&mutex_);
+            while (queue_.empty() && !finish_)
+                condition_.wait(&mutex_);
+            if (queue_.empty())
+                return;
+            image = queue_.front();
+            queue_.pop_front();
+        }
+
+        if (skipSame_ && image == lastImage_)
+            continue;
+        currentFrame_++;
+        QString number = QString("movie_%1.png").arg(currentFrame_, 5, 10, QChar('0'));
+        QFileInfo fileName = QFileInfo(QDir(dir_), number);
+        QImageWriter imageWriter(fileName.absoluteFilePath(), "png");
+        imageWriter.write(image);
+        lastImage_ = image;
+    }
+}
+
+bool MovieWriter::push(QImage image)
+{
+    QMutexLocker locker(&mutex_);
+    if (finish_ || queue_.size() >= maxQueued_) {
+        dropped_++;
+        return false;
+    }
+    queue_.push_back(std::move(image));
+    condition_.wakeOne();
+    return true;
+}
+
+void MovieWriter::finish()
+{
+    {
+        QMutexLocker locker(&mutex_);
+        finish_ = true;
+        condition_.wakeOne();
+    }
+    wait();
 }
 
 void FPGAViewWidget::onSelectedArchItem(std::vector<DecalXY> decals, bool keep)
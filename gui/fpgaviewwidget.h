@@ -32,6 +32,9 @@
 #include <QTimer>
 #include <QWaitCondition>
 #include <boost/optional.hpp>
+#include <deque>
+#include <unordered_map>
+#include <vector>
 
 #include "designwidget.h"
 #include "lineshader.h"
@@ -89,6 +92,45 @@ class PeriodicRunner : public QThread
     void poke(void) { condition_.wakeOne(); }
 };
 
+// Writes the frames of a movie from its own thread, so that the render path only grabs the framebuffer. Frames
+// that are the same as the last one written are skipped if asked to; if the queue is full, new frames are dropped
+// rather than holding up rendering (and so the placer or router being shown).
+class MovieWriter : public QThread
+{
+    Q_OBJECT
+  private:
+    QMutex mutex_;
+    QWaitCondition condition_;
+    bool finish_;
+    std::deque<QImage> queue_;
+    const size_t maxQueued_ = 8;
+
+    QString dir_;
+    bool skipSame_;
+    QImage lastImage_;
+    long currentFrame_;
+    long dropped_;
+
+  public:
+    MovieWriter(QObject *parent, QString dir, bool skipSame)
+            : QThread(parent), finish_(false), dir_(dir), skipSame_(skipSame), currentFrame_(0), dropped_(0)
+    {
+    }
+
+    void run(void) override;
+
+    // Queue a frame; returns false if it was dropped
+    bool push(QImage image);
+
+    // Write out the frames still queued and stop the thread
+    void finish();
+
+    long framesWritten() const { return currentFrame_; }
+    long framesDropped() const { return dropped_; }
+
+    ~MovieWriter() { finish(); }
+};
+
 class FPGAViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
 {
     Q_OBJECT
@@ -128,18 +170,27 @@ class FPGAViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
     void clickedPip(PipId pip, bool add);
 
   private:
-    QString movieDir;
-    long currentMovieFrame;
     long currentFrameSkip;
     long movieCounter;
     bool movieSaving;
-    bool movieSkipSame;
-    QImage movieLastImage;
+    std::unique_ptr<MovieWriter> movieWriter_;
     const float zoomNear_ = 0.05f; // do not zoom closer than this
     float zoomFar_ = 10.0f;        // do not zoom further than this
     const float zoomLvl1_ = 1.0f;
     const float zoomLvl2_ = 5.0f;
 
+    // Level of detail tiers. Wires and pips are only generated and drawn
+    // when zoomed in closer than lodBelsZoom_, bels closer than
+    // lodTilesZoom_, and further out only groups (tile frames) and the grid.
+    enum LevelOfDetail
+    {
+        LOD_FULL,
+        LOD_BELS,
+        LOD_TILES
+    };
+    const float lodBelsZoom_ = 25.0f;
+    const float lodTilesZoom_ = 100.0f;
+
     struct PickedElement
     {
         ElementType type;
@@ -266,6 +317,10 @@ class FPGAViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
         bool changed;
         // Whether to render grid or skip it.
         bool gridChanged;
+        // Level of detail to render decals at, and whether it (or the
+        // displayed decal types) changed.
+        LevelOfDetail lod;
+        bool lodChanged;
 
         // Flags for rendering.
         bool zoomOutbound;
@@ -280,7 +335,7 @@ class FPGAViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
     struct RendererData
     {
         LineShaderData gfxGrid;
-        LineShaderData gfxByStyle[GraphicElement::STYLE_MAX];
+        LineShaderChunks gfxByStyle[GraphicElement::STYLE_HIGHLIGHTED0];
         LineShaderData gfxSelected;
         LineShaderData gfxHovered;
         LineShaderData gfxHighlighted[8];
@@ -294,6 +349,37 @@ class FPGAViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
     std::unique_ptr<RendererData> rendererData_;
     QMutex rendererDataLock_;
 
+    // Decals rendered in chunks of this many, so that a change to some
+    // bel or wire only has to re-render its chunk.
+    static const size_t decalChunkSize_ = 4096;
+
+    struct DecalChunk
+    {
+        // Shared with RendererData, and replaced rather than modified when
+        // the chunk is rendered again, with a new version.
+        std::shared_ptr<const LineShaderData> gfx[GraphicElement::STYLE_HIGHLIGHTED0];
+        uint64_t version = 0;
+        PickQuadTree::BoundingBox bb;
+        bool dirty;
+    };
+
+    // Decals last rendered, kept between renders so that a bind only
+    // updates what it changed. Only used by the render thread.
+    struct DecalCache
+    {
+        std::vector<DecalXY> decals;
+        std::vector<PickedElement> elements;
+        std::unordered_map<BelId, size_t> belIndex;
+        std::unordered_map<WireId, size_t> wireIndex;
+        std::unordered_map<PipId, size_t> pipIndex;
+        std::unordered_map<GroupId, size_t> groupIndex;
+        std::vector<DecalChunk> chunks;
+        uint64_t lastVersion = 0;
+        bool valid = false;
+        // The design snapshot the decals are of
+        std::shared_ptr<const DesignSnapshot> snapshot;
+    } decalCache_;
+
     void clampZoom();
     void zoomToBB(const PickQuadTree::BoundingBox &bb, float margin, bool clamp);
     void zoom(int level);
@@ -303,7 +389,10 @@ class FPGAViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
     void renderDecal(LineShaderData &out, PickQuadTree::BoundingBox &bb, const DecalXY &decal);
     void renderArchDecal(LineShaderData out[GraphicElement::STYLE_MAX], PickQuadTree::BoundingBox &bb,
                          const DecalXY &decal);
-    void populateQuadTree(RendererData *data, const DecalXY &decal, const PickedElement &element);
+    void getPickBoxes(const DecalXY &decal, std::vector<PickQuadTree::BoundingBox> &out);
+    void renderDecalChunks(void);
+    void populateQuadTree(RendererData *data);
+    LevelOfDetail lodForZoom(float zoom) const;
     boost::optional<PickedElement> pickElement(float worldx, float worldy);
     QVector4D mouseToWorldCoordinates(int x, int y);
     QVector4D mouseToWorldDimensions(float x, float y);
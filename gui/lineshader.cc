@@ -18,6 +18,7 @@
  */
 
 #include "lineshader.h"
+#include <algorithm>
 #include "log.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -229,6 +230,146 @@ void LineShader::update_vbos(enum GraphicElement::style_t style, const LineShade
     buffers_[style].index.allocate(&line.indices[0], sizeof(GLuint) * line.indices.size());
 }
 
+namespace {
+
+// Room given to a chunk when the buffers are laid out: half as much again
+// as it has, so that decals changing style rarely make it outgrow it.
+// Index ranges stay whole triangles.
+int vertexCapacity(size_t used) { return int(used + used / 2) + 32; }
+int indexCapacity(size_t used) { return int(used + (used / 6) * 3) + 48; }
+
+} // namespace
+
+void LineShader::update_vbos(enum GraphicElement::style_t style, const LineShaderChunks &lines)
+{
+    Buffers &buf = buffers_[style];
+    if (buf.last_vbo_update == lines.last_render)
+        return;
+    buf.last_vbo_update = lines.last_render;
+
+    size_t count = lines.chunks.size();
+    int vertexEnd = 0, indexEnd = 0;
+    for (auto &slot : buf.slots) {
+        vertexEnd = std::max(vertexEnd, slot.first_vertex + slot.vertex_capacity);
+        indexEnd = std::max(indexEnd, slot.first_index + slot.index_capacity);
+    }
+
+    // Chunks that outgrew their slot move to the end of the buffers, if
+    // there is room left there; otherwise everything is laid out again.
+    bool relayout = buf.slots.size() != count;
+    std::vector<size_t> outgrown;
+    int moveVertices = 0, moveIndices = 0;
+    for (size_t i = 0; i < count && !relayout; i++) {
+        auto &slot = buf.slots[i];
+        auto &line = *lines.chunks[i];
+        if (slot.version == lines.versions[i])
+            continue;
+        if (int(line.vertices.size()) > slot.vertex_capacity || int(line.indices.size()) > slot.index_capacity) {
+            outgrown.push_back(i);
+            moveVertices += vertexCapacity(line.vertices.size());
+            moveIndices += indexCapacity(line.indices.size());
+        }
+    }
+    if (vertexEnd + moveVertices > buf.vertex_capacity || indexEnd + moveIndices > buf.index_capacity)
+        relayout = true;
+
+    if (relayout) {
+        buf.slots.resize(count);
+        int vertices = 0, indices = 0;
+        for (size_t i = 0; i < count; i++) {
+            auto &slot = buf.slots[i];
+            auto &line = *lines.chunks[i];
+            slot.first_vertex = vertices;
+            slot.vertex_capacity = vertexCapacity(line.vertices.size());
+            slot.first_index = indices;
+            slot.index_capacity = indexCapacity(line.indices.size());
+            slot.version = lines.versions[i];
+            vertices += slot.vertex_capacity;
+            indices += slot.index_capacity;
+        }
+        buf.indices = indices;
+        // Leave as much room again at the end for chunks that outgrow their slot.
+        buf.vertex_capacity = vertices + vertices / 2;
+        buf.index_capacity = indices + (indices / 6) * 3;
+        if (indices == 0)
+            return;
+
+        std::vector<Vertex2DPOD> position(buf.vertex_capacity, Vertex2DPOD(0, 0));
+        std::vector<Vertex2DPOD> normal(buf.vertex_capacity, Vertex2DPOD(0, 0));
+        std::vector<GLfloat> miter(buf.vertex_capacity, 1.0f);
+        // Unused indices are degenerate triangles, which draw nothing.
+        std::vector<GLuint> index(buf.index_capacity, 0);
+        for (size_t i = 0; i < count; i++) {
+            auto &slot = buf.slots[i];
+            auto &line = *lines.chunks[i];
+            std::copy(line.vertices.begin(), line.vertices.end(), position.begin() + slot.first_vertex);
+            std::copy(line.normals.begin(), line.normals.end(), normal.begin() + slot.first_vertex);
+            std::copy(line.miters.begin(), line.miters.end(), miter.begin() + slot.first_vertex);
+            for (size_t j = 0; j < line.indices.size(); j++)
+                index[slot.first_index + j] = line.indices[j] + slot.first_vertex;
+        }
+
+        buf.position.bind();
+        buf.position.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        buf.position.allocate(position.data(), sizeof(Vertex2DPOD) * position.size());
+
+        buf.normal.bind();
+        buf.normal.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        buf.normal.allocate(normal.data(), sizeof(Vertex2DPOD) * normal.size());
+
+        buf.miter.bind();
+        buf.miter.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        buf.miter.allocate(miter.data(), sizeof(GLfloat) * miter.size());
+
+        buf.index.bind();
+        buf.index.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        buf.index.allocate(index.data(), sizeof(GLuint) * index.size());
+        return;
+    }
+
+    std::vector<GLuint> index;
+    for (size_t i : outgrown) {
+        auto &slot = buf.slots[i];
+        auto &line = *lines.chunks[i];
+        // What the chunk leaves behind draws nothing from now on.
+        index.assign(slot.index_capacity, 0);
+        buf.index.bind();
+        buf.index.write(slot.first_index * sizeof(GLuint), index.data(), sizeof(GLuint) * index.size());
+        slot.first_vertex = vertexEnd;
+        slot.vertex_capacity = vertexCapacity(line.vertices.size());
+        slot.first_index = indexEnd;
+        slot.index_capacity = indexCapacity(line.indices.size());
+        vertexEnd += slot.vertex_capacity;
+        indexEnd += slot.index_capacity;
+    }
+    buf.indices = indexEnd;
+
+    // Sub-range updates of the chunks that changed.
+    for (size_t i = 0; i < count; i++) {
+        auto &slot = buf.slots[i];
+        auto &line = *lines.chunks[i];
+        if (slot.version == lines.versions[i])
+            continue;
+        slot.version = lines.versions[i];
+        if (!line.vertices.empty()) {
+            buf.position.bind();
+            buf.position.write(slot.first_vertex * sizeof(Vertex2DPOD), line.vertices.data(),
+                               sizeof(Vertex2DPOD) * line.vertices.size());
+            buf.normal.bind();
+            buf.normal.write(slot.first_vertex * sizeof(Vertex2DPOD), line.normals.data(),
+                             sizeof(Vertex2DPOD) * line.normals.size());
+            buf.miter.bind();
+            buf.miter.write(slot.first_vertex * sizeof(GLfloat), line.miters.data(),
+                            sizeof(GLfloat) * line.miters.size());
+        }
+        index.assign(slot.index_capacity, 0);
+        for (size_t j = 0; j < line.indices.size(); j++)
+            index[j] = line.indices[j] + slot.first_vertex;
+        buf.index.bind();
+        buf.index.write(slot.first_index * sizeof(GLuint), index.data(), sizeof(GLuint) * index.size());
+    }
+}
+
 void LineShader::draw(enum GraphicElement::style_t style, const QColor &color, float thickness,
                       const QMatrix4x4 &projection)
 {
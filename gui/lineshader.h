@@ -26,6 +26,7 @@
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLWidget>
 #include <array>
+#include <memory>
 
 #include "log.h"
 #include "nextpnr.h"
@@ -60,6 +61,30 @@ struct LineShaderData
         miters.clear();
         indices.clear();
     }
+
+    // Append lines built separately, eg. on another thread.
+    void append(const LineShaderData &other)
+    {
+        GLuint offset = vertices.size();
+        vertices.insert(vertices.end(), other.vertices.begin(), other.vertices.end());
+        normals.insert(normals.end(), other.normals.begin(), other.normals.end());
+        miters.insert(miters.end(), other.miters.begin(), other.miters.end());
+        indices.reserve(indices.size() + other.indices.size());
+        for (auto index : other.indices)
+            indices.push_back(index + offset);
+    }
+};
+
+// LineShaderChunks is a set of lines built in chunks that change
+// independently, such as the decals of a range of bels, wires and pips.
+// A chunk is never modified once built: one that changes is replaced, and
+// given a new version, so that only it has to be uploaded to the GPU again.
+struct LineShaderChunks
+{
+    std::vector<std::shared_ptr<const LineShaderData>> chunks;
+    std::vector<uint64_t> versions;
+
+    int last_render = 0;
 };
 
 // PolyLine is a set of segments defined by points, that can be built to a
@@ -154,6 +179,19 @@ class LineShader
         int indices = 0;
 
         int last_vbo_update = 0;
+
+        // For chunked lines, the range of the buffers holding each chunk,
+        // and the version of it there. Indices past the end of a chunk's
+        // lines are degenerate triangles.
+        struct Slot
+        {
+            int first_vertex, vertex_capacity;
+            int first_index, index_capacity;
+            uint64_t version;
+        };
+        std::vector<Slot> slots;
+        // Allocated size of the buffers, in vertices and indices.
+        int vertex_capacity = 0, index_capacity = 0;
     };
     std::array<Buffers, GraphicElement::STYLE_MAX> buffers_;
 
@@ -195,6 +233,12 @@ class LineShader
 
     void update_vbos(enum GraphicElement::style_t style, const LineShaderData &line);
 
+    // Update the buffers of a style from chunked lines. Only chunks with a
+    // new version are uploaded, into the room left for them, or at the end
+    // of the buffers once they outgrow it. The buffers are laid out again
+    // only when they are full, or the number of chunks changed.
+    void update_vbos(enum GraphicElement::style_t style, const LineShaderChunks &lines);
+
     // Render a LineShaderData with a given M/V/P transformation.
     void draw(enum GraphicElement::style_t style, const QColor &color, float thickness, const QMatrix4x4 &projection);
 };
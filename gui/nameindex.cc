@@ -0,0 +1,124 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "nameindex.h"
+#include <algorithm>
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace TreeModel {
+
+NameIndex::Entry NameIndex::split(const std::string &name) const
+{
+    auto lookup = [](const std::unordered_map<std::string, int32_t> &ids, const std::string &str) -> int32_t {
+        auto fnd = ids.find(str);
+        return (fnd == ids.end()) ? -1 : fnd->second;
+    };
+    Entry entry;
+    size_t slash = name.rfind('/');
+    if (slash == std::string::npos) {
+        entry.prefix = -1;
+        entry.suffix = lookup(suffix_ids_, name);
+    } else {
+        entry.prefix = lookup(prefix_ids_, name.substr(0, slash));
+        entry.suffix = lookup(suffix_ids_, name.substr(slash + 1));
+    }
+    return entry;
+}
+
+std::pair<int, int> NameIndex::position(size_t entry) const
+{
+    auto list = std::upper_bound(list_start_.begin(), list_start_.end(), entry) - list_start_.begin() - 1;
+    return std::make_pair(int(list), int(entry - list_start_.at(list)));
+}
+
+void NameIndex::addList(const std::vector<std::string> &names)
+{
+    auto intern = [](std::vector<std::string> &strs, std::unordered_map<std::string, int32_t> &ids,
+                     const std::string &str) {
+        auto fnd = ids.emplace(str, int32_t(strs.size()));
+        if (fnd.second)
+            strs.push_back(str);
+        return fnd.first->second;
+    };
+    list_start_.push_back(entries_.size());
+    for (const auto &name : names) {
+        Entry entry;
+        size_t slash = name.rfind('/');
+        if (slash == std::string::npos) {
+            entry.prefix = -1;
+            entry.suffix = intern(suffixes_, suffix_ids_, name);
+        } else {
+            entry.prefix = intern(prefixes_, prefix_ids_, name.substr(0, slash));
+            entry.suffix = intern(suffixes_, suffix_ids_, name.substr(slash + 1));
+        }
+        entries_.push_back(entry);
+    }
+}
+
+void NameIndex::search(const std::string &text, std::function<bool(int, int)> func) const
+{
+    // Find the matching parts first, there being far fewer of them than
+    // names. Text without a '/' must be within one of the parts; text with
+    // one may also span the last '/' of the name.
+    size_t slash = text.rfind('/');
+    std::vector<char> prefix_match(prefixes_.size()), suffix_match(suffixes_.size());
+    for (size_t i = 0; i < prefixes_.size(); i++) {
+        const auto &prefix = prefixes_.at(i);
+        if (prefix.find(text) != std::string::npos) {
+            prefix_match.at(i) = 2;
+        } else if (slash != std::string::npos && prefix.size() >= slash &&
+                   prefix.compare(prefix.size() - slash, slash, text, 0, slash) == 0) {
+            // Ends with the text before its last '/'
+            prefix_match.at(i) = 1;
+        }
+    }
+    for (size_t i = 0; i < suffixes_.size(); i++) {
+        const auto &suffix = suffixes_.at(i);
+        if (slash == std::string::npos)
+            suffix_match.at(i) = (suffix.find(text) != std::string::npos) ? 2 : 0;
+        else
+            suffix_match.at(i) = (suffix.compare(0, text.size() - slash - 1, text, slash + 1) == 0) ? 1 : 0;
+    }
+
+    for (size_t i = 0; i < entries_.size(); i++) {
+        const auto &entry = entries_[i];
+        int pm = (entry.prefix == -1) ? 0 : prefix_match[entry.prefix];
+        int sm = suffix_match[entry.suffix];
+        bool match = (pm == 2 || sm == 2 || (pm == 1 && sm == 1));
+        if (match) {
+            auto pos = position(i);
+            if (!func(pos.first, pos.second))
+                return;
+        }
+    }
+}
+
+boost::optional<std::pair<int, int>> NameIndex::find(const std::string &name) const
+{
+    Entry key = split(name);
+    if (key.suffix == -1 || (key.prefix == -1 && name.find('/') != std::string::npos))
+        return boost::none;
+    for (size_t i = 0; i < entries_.size(); i++)
+        if (entries_[i].prefix == key.prefix && entries_[i].suffix == key.suffix)
+            return position(i);
+    return boost::none;
+}
+
+} // namespace TreeModel
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,72 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include <boost/optional.hpp>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace TreeModel {
+
+// NameIndex is a substring search index over the names of the elements in an
+// ElementXYRoot, so that searching doesn't need to create an Item for every
+// element. Names are split at their last '/' into a tile and a local part,
+// which are interned separately, as the same local names repeat in every tile
+// of a type. Each element then only stores the pair of ids.
+class NameIndex
+{
+  private:
+    struct Entry
+    {
+        // Tile part, or -1 for names without a '/', and local part.
+        int32_t prefix, suffix;
+    };
+    std::vector<std::string> prefixes_, suffixes_;
+    std::unordered_map<std::string, int32_t> prefix_ids_, suffix_ids_;
+    // Entries of all lists, in order, and where each list starts.
+    std::vector<Entry> entries_;
+    std::vector<size_t> list_start_;
+
+    // Ids of the parts of a name, -1 for parts not in the index.
+    Entry split(const std::string &name) const;
+    std::pair<int, int> position(size_t entry) const;
+
+  public:
+    // Add the names of the next list's elements.
+    void addList(const std::vector<std::string> &names);
+
+    // Call func(list, element) for each name containing text, in the order
+    // they were added, until it returns false.
+    void search(const std::string &text, std::function<bool(int, int)> func) const;
+
+    // Find the list and element of the given name.
+    boost::optional<std::pair<int, int>> find(const std::string &name) const;
+};
+
+} // namespace TreeModel
+
+NEXTPNR_NAMESPACE_END
+
+#endif // NAMEINDEX_H
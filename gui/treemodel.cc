@@ -19,6 +19,7 @@
  */
 
 #include "treemodel.h"
+#include <algorithm>
 #include "log.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -150,7 +151,25 @@ void IdStringList::search(QList<Item *> &results, QString text, int limit)
     }
 }
 
-Model::Model(QObject *parent) : QAbstractItemModel(parent), root_(new Item("Elements", nullptr)) {}
+Model::Model(QObject *parent)
+        : QAbstractItemModel(parent), root_(new Item("Elements", nullptr)), indexTimer_(new QTimer(this))
+{
+    connect(indexTimer_, &QTimer::timeout, [this]() {
+        if (ctx_ == nullptr) {
+            indexTimer_->stop();
+            return;
+        }
+        // Don't hold up the GUI waiting for the context, try again later
+        std::unique_lock<std::mutex> lock_ui(ctx_->ui_mutex, std::try_to_lock);
+        if (!lock_ui.owns_lock())
+            return;
+        std::unique_lock<std::mutex> lock(ctx_->mutex, std::try_to_lock);
+        if (!lock.owns_lock())
+            return;
+        if (!root_->indexMore())
+            indexTimer_->stop();
+    });
+}
 
 Model::~Model() {}
 
@@ -160,6 +179,7 @@ void Model::loadData(Context *ctx, std::unique_ptr<Item> data)
     ctx_ = ctx;
     root_ = std::move(data);
     endResetModel();
+    indexTimer_->start(0);
 }
 
 void Model::updateElements(std::vector<IdString> elements)
@@ -22,8 +22,12 @@
 #define TREEMODEL_H
 
 #include <QAbstractItemModel>
+#include <QTimer>
 #include <boost/optional.hpp>
+#include <functional>
+#include <string>
 
+#include "nameindex.h"
 #include "nextpnr.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -106,6 +110,10 @@ class Item
     virtual void search(QList<Item *> &results, QString text, int limit) {}
     virtual void updateElements(Context *ctx, std::vector<IdString> elements) {}
 
+    // Background indexing for search. Indexes some more elements, returning
+    // whether there are any left to index.
+    virtual bool indexMore() { return false; }
+
     virtual ~Item()
     {
         if (parent_ != nullptr) {
@@ -223,6 +231,21 @@ template <typename ElementT> class ElementList : public Item
 
     virtual void fetchMore() override { fetchMore(100); }
 
+    // Child for the element at the given position, loading elements up to it.
+    Item *childAt(int element)
+    {
+        if (element >= children_.size())
+            fetchMore(element + 1 - children_.size());
+        return children_.at(element);
+    }
+
+    // Names of all our elements, in order, without loading them.
+    void elementNames(std::vector<std::string> &names) const
+    {
+        for (auto elem : *elements())
+            names.push_back(getter_(ctx_, elem).str(ctx_));
+    }
+
     // getById finds a child for the given IdString.
     virtual boost::optional<Item *> getById(IdString id) override
     {
@@ -280,6 +303,10 @@ template <typename ElementT> class ElementXYRoot : public Item
     ElementGetter getter_;
     // Type of children that he list creates in X->Y->...
     ElementType child_type_;
+    // Search index over the names of all elements, and the number of
+    // ElementLists added to it so far.
+    NameIndex index_;
+    size_t indexed_lists_ = 0;
 
   public:
     ElementXYRoot(Context *ctx, ElementMap map, ElementGetter getter, ElementType type)
@@ -318,28 +345,44 @@ template <typename ElementT> class ElementXYRoot : public Item
         }
     }
 
+    // Index the names of ElementLists, a few thousand elements at a time.
+    virtual bool indexMore() override
+    {
+        size_t budget = 20000;
+        std::vector<std::string> names;
+        while (indexed_lists_ < managed_lists_.size() && budget > 0) {
+            names.clear();
+            managed_lists_.at(indexed_lists_++)->elementNames(names);
+            index_.addList(names);
+            budget -= std::min(budget, names.size());
+        }
+        return indexed_lists_ < managed_lists_.size();
+    }
+
     // getById finds a child for the given IdString.
     virtual boost::optional<Item *> getById(IdString id) override
     {
-        // For now, scan linearly all ElementLists.
-        // TODO(q3k) fix this once we have tree API from arch
-        for (auto &l : managed_lists_) {
-            auto res = l->getById(id);
-            if (res) {
-                return res;
-            }
-        }
-        return boost::none;
+        // Finish indexing if needed, then only load the list up to the
+        // element.
+        while (indexMore())
+            ;
+        auto pos = index_.find(id.str(ctx_));
+        if (!pos)
+            return boost::none;
+        return managed_lists_.at(pos->first)->childAt(pos->second);
     }
 
     // Find children that contain the given text.
     virtual void search(QList<Item *> &results, QString text, int limit) override
     {
-        for (auto &l : managed_lists_) {
+        while (indexMore())
+            ;
+        index_.search(text.toStdString(), [&](int list, int element) {
             if (limit != -1 && results.size() > limit)
-                return;
-            l->search(results, text, limit);
-        }
+                return false;
+            results.push_back(managed_lists_.at(list)->childAt(element));
+            return true;
+        });
     }
 };
 
@@ -382,6 +425,8 @@ class Model : public QAbstractItemModel
   private:
     // Tree elements that we manage the memory for.
     std::unique_ptr<Item> root_;
+    // Runs root_->indexMore() while the GUI is idle, until the index is done.
+    QTimer *indexTimer_;
 };
 
 }; // namespace TreeModel
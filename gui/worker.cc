@@ -22,6 +22,7 @@
 #include "design_utils.h"
 #include "log.h"
 #include "timing.h"
+#include "trace.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -55,6 +56,8 @@ void Worker::newContext(Context *ctx_) { ctx = ctx_; }
 void Worker::pack()
 {
     Q_EMIT taskStarted();
+    NPNR_TRACE_THREAD_NAME("gui worker");
+    NPNR_TRACE_SCOPE("gui pack");
     try {
         bool res = ctx->pack();
         print_utilisation(ctx);
@@ -67,6 +70,8 @@ void Worker::pack()
 void Worker::budget(double freq)
 {
     Q_EMIT taskStarted();
+    NPNR_TRACE_THREAD_NAME("gui worker");
+    NPNR_TRACE_SCOPE("gui budget");
     try {
         ctx->settings[ctx->id("target_freq")] = std::to_string(freq);
         assign_budget(ctx);
@@ -79,6 +84,8 @@ void Worker::budget(double freq)
 void Worker::place(bool timing_driven)
 {
     Q_EMIT taskStarted();
+    NPNR_TRACE_THREAD_NAME("gui worker");
+    NPNR_TRACE_SCOPE("gui place");
     try {
         ctx->settings[ctx->id("timing_driven")] = std::to_string(timing_driven);
         Q_EMIT place_finished(ctx->place());
@@ -90,6 +97,8 @@ void Worker::place(bool timing_driven)
 void Worker::route()
 {
     Q_EMIT taskStarted();
+    NPNR_TRACE_THREAD_NAME("gui worker");
+    NPNR_TRACE_SCOPE("gui route");
     try {
         Q_EMIT route_finished(ctx->route());
     } catch (WorkerInterruptionRequested) {
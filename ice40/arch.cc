@@ -129,6 +129,8 @@ Arch::Arch(ArchArgs args) : args(args)
     wire_to_net.resize(chip_info->num_wires);
     pip_to_net.resize(chip_info->num_pips);
     switches_locked.resize(chip_info->num_switches);
+    for (auto bel : getBels())
+        bels_by_type[getBelType(bel)].push_back(bel);
 }
 
 // -----------------------------------------------------------------------
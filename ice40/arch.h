@@ -424,6 +424,8 @@ struct Arch : BaseCtx
     std::vector<NetInfo *> wire_to_net;
     std::vector<NetInfo *> pip_to_net;
     std::vector<WireId> switches_locked;
+    // Bels of each type, for getBelsByType
+    std::unordered_map<IdString, std::vector<BelId>> bels_by_type;
 
     ArchArgs args;
     Arch(ArchArgs args);
@@ -502,6 +504,13 @@ struct Arch : BaseCtx
         return range;
     }
 
+    const std::vector<BelId> &getBelsByType(IdString type) const
+    {
+        static const std::vector<BelId> no_bels;
+        auto fnd = bels_by_type.find(type);
+        return fnd == bels_by_type.end() ? no_bels : fnd->second;
+    }
+
     Loc getBelLocation(BelId bel) const
     {
         NPNR_ASSERT(bel != BelId());
@@ -553,6 +562,7 @@ struct Arch : BaseCtx
         wire_to_net[wire.index] = net;
         net->wires[wire].pip = PipId();
         net->wires[wire].strength = strength;
+        net->route_version++;
         refreshUiWire(wire);
     }
 
@@ -572,6 +582,7 @@ struct Arch : BaseCtx
         }
 
         net_wires.erase(it);
+        wire_to_net[wire.index]->route_version++;
         wire_to_net[wire.index] = nullptr;
         refreshUiWire(wire);
     }
@@ -644,6 +655,7 @@ struct Arch : BaseCtx
         wire_to_net[dst.index] = net;
         net->wires[dst].pip = pip;
         net->wires[dst].strength = strength;
+        net->route_version++;
         refreshUiPip(pip);
         refreshUiWire(dst);
     }
@@ -659,6 +671,7 @@ struct Arch : BaseCtx
         NPNR_ASSERT(wire_to_net[dst.index] != nullptr);
         wire_to_net[dst.index] = nullptr;
         pip_to_net[pip.index]->wires.erase(dst);
+        pip_to_net[pip.index]->route_version++;
 
         pip_to_net[pip.index] = nullptr;
         switches_locked[chip_info->pip_data[pip.index].switch_index] = WireId();
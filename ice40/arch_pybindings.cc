@@ -57,8 +57,8 @@ void arch_wrap_python()
                            .def("place", &Context::place)
                            .def("route", &Context::route);
 
-    typedef std::unordered_map<IdString, std::unique_ptr<CellInfo>> CellMap;
-    typedef std::unordered_map<IdString, std::unique_ptr<NetInfo>> NetMap;
+    typedef indexed_dict<IdString, std::unique_ptr<CellInfo>> CellMap;
+    typedef indexed_dict<IdString, std::unique_ptr<NetInfo>> NetMap;
     typedef std::unordered_map<IdString, HierarchicalCell> HierarchyMap;
     typedef std::unordered_map<IdString, IdString> AliasMap;
 
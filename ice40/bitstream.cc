@@ -20,9 +20,13 @@
  */
 #include "bitstream.h"
 #include <cctype>
+#include <exception>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include "cells.h"
 #include "log.h"
+#include "lut_table.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -32,14 +36,57 @@ inline TileType tile_at(const Context *ctx, int x, int y)
     return ctx->chip_info->tile_grid[y * ctx->chip_info->width + x];
 }
 
-const ConfigEntryPOD &find_config(const TileInfoPOD &tile, const std::string &name)
+// The config entries of a non-routing tile type by name, indexed once so that setting a bit doesn't search the
+// entry list of the tile
+struct TileConfigIndex
 {
-    for (int i = 0; i < tile.num_config_entries; i++) {
-        if (std::string(tile.entries[i].name.get()) == name) {
-            return tile.entries[i];
-        }
+    std::unordered_map<std::string, const ConfigEntryPOD *> entries;
+};
+
+typedef std::vector<TileConfigIndex> tileconfigs_t;
+
+static tileconfigs_t index_tile_configs(const BitstreamInfoPOD &bi)
+{
+    tileconfigs_t tile_configs(TILE_IPCON + 1);
+    for (int t = 0; t <= int(TILE_IPCON); t++) {
+        const TileInfoPOD &tile = bi.tiles_nonrouting[t];
+        for (int i = 0; i < tile.num_config_entries; i++)
+            tile_configs.at(t).entries.emplace(tile.entries[i].name.get(), &tile.entries[i]);
     }
-    NPNR_ASSERT_FALSE_STR("unable to find config bit " + name);
+    return tile_configs;
+}
+
+const ConfigEntryPOD &find_config(const TileConfigIndex &tile, const std::string &name)
+{
+    auto found = tile.entries.find(name);
+    if (found == tile.entries.end())
+        NPNR_ASSERT_FALSE_STR("unable to find config bit " + name);
+    return *found->second;
+}
+
+// Run fn(i) for every i in [0, n) on up to threads threads, thread t taking i = t, t + threads, ... An exception
+// thrown by any call (a failed assertion or log_error) is rethrown on the calling thread once all threads are done.
+template <typename Tfunc> static void parallel_stride(int threads, int n, Tfunc fn)
+{
+    threads = std::max(1, std::min(threads, n));
+    std::vector<std::exception_ptr> errors(threads);
+    auto run = [&](int t) {
+        try {
+            for (int i = t; i < n; i += threads)
+                fn(i);
+        } catch (...) {
+            errors.at(t) = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+        workers.emplace_back(run, t);
+    run(0);
+    for (auto &w : workers)
+        w.join();
+    for (auto &e : errors)
+        if (e)
+            std::rethrow_exception(e);
 }
 
 std::tuple<int8_t, int8_t, int8_t> get_ieren(const BitstreamInfoPOD &bi, int8_t x, int8_t y, int8_t z)
@@ -54,7 +101,7 @@ std::tuple<int8_t, int8_t, int8_t> get_ieren(const BitstreamInfoPOD &bi, int8_t
     return std::make_tuple(-1, -1, -1);
 };
 
-bool get_config(const TileInfoPOD &ti, std::vector<std::vector<int8_t>> &tile_cfg, const std::string &name,
+bool get_config(const TileConfigIndex &ti, std::vector<std::vector<int8_t>> &tile_cfg, const std::string &name,
                 int index = -1)
 {
     const ConfigEntryPOD &cfg = find_config(ti, name);
@@ -68,8 +115,8 @@ bool get_config(const TileInfoPOD &ti, std::vector<std::vector<int8_t>> &tile_cf
     return false;
 }
 
-void set_config(const TileInfoPOD &ti, std::vector<std::vector<int8_t>> &tile_cfg, const std::string &name, bool value,
-                int index = -1)
+void set_config(const TileConfigIndex &ti, std::vector<std::vector<int8_t>> &tile_cfg, const std::string &name,
+                bool value, int index = -1)
 {
     const ConfigEntryPOD &cfg = find_config(ti, name);
     if (index == -1) {
@@ -89,7 +136,7 @@ void set_config(const TileInfoPOD &ti, std::vector<std::vector<int8_t>> &tile_cf
 
 // Set an IE_{EN,REN} logical bit in a tile config. Logical means enabled.
 // On {HX,LP}1K devices these bits are active low, so we need to invert them.
-void set_ie_bit_logical(const Context *ctx, const TileInfoPOD &ti, std::vector<std::vector<int8_t>> &tile_cfg,
+void set_ie_bit_logical(const Context *ctx, const TileConfigIndex &ti, std::vector<std::vector<int8_t>> &tile_cfg,
                         const std::string &name, bool value)
 {
     if (ctx->args.type == ArchArgs::LP1K || ctx->args.type == ArchArgs::HX1K) {
@@ -133,15 +180,13 @@ static const BelConfigPOD &get_ec_config(const ChipInfoPOD *chip, BelId bel)
 
 typedef std::vector<std::vector<std::vector<std::vector<int8_t>>>> chipconfig_t;
 
-static void set_ec_cbit(chipconfig_t &config, const Context *ctx, const BelConfigPOD &cell_cbits, std::string name,
-                        bool value, std::string prefix)
+static void set_ec_cbit(chipconfig_t &config, const Context *ctx, const tileconfigs_t &tile_configs,
+                        const BelConfigPOD &cell_cbits, std::string name, bool value, std::string prefix)
 {
-    const ChipInfoPOD *chip = ctx->chip_info;
-
     for (int i = 0; i < cell_cbits.num_entries; i++) {
         const auto &cbit = cell_cbits.entries[i];
         if (cbit.entry_name.get() == name) {
-            const auto &ti = chip->bits_info->tiles_nonrouting[tile_at(ctx, cbit.x, cbit.y)];
+            const TileConfigIndex &ti = tile_configs.at(tile_at(ctx, cbit.x, cbit.y));
             set_config(ti, config.at(cbit.y).at(cbit.x), prefix + cbit.cbit_name.get(), value);
             return;
         }
@@ -149,7 +194,7 @@ static void set_ec_cbit(chipconfig_t &config, const Context *ctx, const BelConfi
     NPNR_ASSERT_FALSE_STR("failed to config extra cell config bit " + name);
 }
 
-void configure_extra_cell(chipconfig_t &config, const Context *ctx, CellInfo *cell,
+void configure_extra_cell(chipconfig_t &config, const Context *ctx, const tileconfigs_t &tile_configs, CellInfo *cell,
                           const std::vector<std::pair<std::string, int>> &params, bool string_style, std::string prefix)
 {
     const ChipInfoPOD *chip = ctx->chip_info;
@@ -191,10 +236,10 @@ void configure_extra_cell(chipconfig_t &config, const Context *ctx, CellInfo *ce
 
         value.resize(p.second);
         if (p.second == 1) {
-            set_ec_cbit(config, ctx, bc, p.first, value.at(0), prefix);
+            set_ec_cbit(config, ctx, tile_configs, bc, p.first, value.at(0), prefix);
         } else {
             for (int i = 0; i < p.second; i++) {
-                set_ec_cbit(config, ctx, bc, p.first + "_" + std::to_string(i), value.at(i), prefix);
+                set_ec_cbit(config, ctx, tile_configs, bc, p.first + "_" + std::to_string(i), value.at(i), prefix);
             }
         }
     }
@@ -247,20 +292,11 @@ static BelPin get_one_bel_pin(const Context *ctx, WireId wire)
 // Permute LUT init value given map (LUT input -> ext input)
 unsigned permute_lut(unsigned orig_init, const std::unordered_map<int, int> &input_permute)
 {
-    unsigned new_init = 0;
-
-    for (int i = 0; i < 16; i++) {
-        int permute_address = 0;
-        for (int j = 0; j < 4; j++) {
-            if ((i >> j) & 0x1)
-                permute_address |= (1 << input_permute.at(j));
-        }
-        if ((orig_init >> i) & 0x1) {
-            new_init |= (1 << permute_address);
-        }
-    }
-
-    return new_init;
+    // Ext input input_permute[i] drives LUT input i
+    std::array<uint8_t, 6> ext_to_lut = {{0, 0, 0, 0, 0, 0}};
+    for (int i = 0; i < 4; i++)
+        ext_to_lut.at(input_permute.at(i)) |= (1 << i);
+    return unsigned(LutTable(orig_init & 0xFFFF).remap(ext_to_lut).bits & 0xFFFF);
 }
 
 void write_asc(const Context *ctx, std::ostream &out)
@@ -273,6 +309,11 @@ void write_asc(const Context *ctx, std::ostream &out)
     // [y][x][row][col]
     const ChipInfoPOD &ci = *ctx->chip_info;
     const BitstreamInfoPOD &bi = *ci.bits_info;
+    const tileconfigs_t tile_configs = index_tile_configs(bi);
+    // Once routing is done the config bits of different tiles, and of different pips, are independent of each
+    // other, so the pips, the per-tile bits and the text of the tiles are handled by worker threads
+    int threads = std::max(1, ctx->settings.count(ctx->id("threads")) ? ctx->setting<int>("threads")
+                                                                      : int(std::thread::hardware_concurrency()));
     chipconfig_t config;
     config.resize(ci.height);
     for (int y = 0; y < ci.height; y++) {
@@ -310,15 +351,20 @@ void write_asc(const Context *ctx, std::ostream &out)
     default:
         NPNR_ASSERT_FALSE("unsupported device type\n");
     }
-    // Set pips
-    for (auto pip : ctx->getPips()) {
-        if (ctx->pip_to_net[pip.index] != nullptr) {
+    // Set pips, a chunk of pips at a time
+    const int chunk_pips = 4096;
+    parallel_stride(threads, (ci.num_pips + chunk_pips - 1) / chunk_pips, [&](int chunk) {
+        for (int pip_idx = chunk * chunk_pips; pip_idx < std::min(ci.num_pips, (chunk + 1) * chunk_pips); pip_idx++) {
+            PipId pip;
+            pip.index = pip_idx;
+            if (ctx->pip_to_net[pip.index] == nullptr)
+                continue;
             const PipInfoPOD &pi = ci.pip_data[pip.index];
             const SwitchInfoPOD &swi = bi.switches[pi.switch_index];
             int sw_bel_idx = swi.bel;
             if (sw_bel_idx >= 0) {
                 const BelInfoPOD &beli = ci.bel_data[sw_bel_idx];
-                const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_LOGIC];
+                const TileConfigIndex &ti = tile_configs.at(TILE_LOGIC);
                 BelId sw_bel;
                 sw_bel.index = sw_bel_idx;
                 NPNR_ASSERT(ctx->getBelType(sw_bel) == id_ICESTORM_LC);
@@ -372,7 +418,7 @@ void write_asc(const Context *ctx, std::ostream &out)
                 }
             }
         }
-    }
+    });
 
     // Scan for PLL and collects the affected SB_IOs
     std::unordered_set<Loc> sb_io_used_by_pll_out;
@@ -425,7 +471,7 @@ void write_asc(const Context *ctx, std::ostream &out)
         if (cell.second->type == ctx->id("ICESTORM_LC")) {
             const BelInfoPOD &beli = ci.bel_data[bel.index];
             int x = beli.x, y = beli.y, z = beli.z;
-            const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_LOGIC];
+            const TileConfigIndex &ti = tile_configs.at(TILE_LOGIC);
             unsigned lut_init = get_param_or_def(ctx, cell.second.get(), ctx->id("LUT_INIT"));
             bool neg_clk = get_param_or_def(ctx, cell.second.get(), ctx->id("NEG_CLK"));
             bool dff_enable = get_param_or_def(ctx, cell.second.get(), ctx->id("DFF_ENABLE"));
@@ -500,7 +546,7 @@ void write_asc(const Context *ctx, std::ostream &out)
         } else if (cell.second->type == ctx->id("SB_IO")) {
             const BelInfoPOD &beli = ci.bel_data[bel.index];
             int x = beli.x, y = beli.y, z = beli.z;
-            const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_IO];
+            const TileConfigIndex &ti = tile_configs.at(TILE_IO);
             unsigned pin_type = get_param_or_def(ctx, cell.second.get(), ctx->id("PIN_TYPE"));
             bool neg_trigger = get_param_or_def(ctx, cell.second.get(), ctx->id("NEG_TRIGGER"));
             bool pullup = get_param_or_def(ctx, cell.second.get(), ctx->id("PULLUP"));
@@ -601,8 +647,8 @@ void write_asc(const Context *ctx, std::ostream &out)
         } else if (cell.second->type == ctx->id("ICESTORM_RAM")) {
             const BelInfoPOD &beli = ci.bel_data[bel.index];
             int x = beli.x, y = beli.y;
-            const TileInfoPOD &ti_ramt = bi.tiles_nonrouting[TILE_RAMT];
-            const TileInfoPOD &ti_ramb = bi.tiles_nonrouting[TILE_RAMB];
+            const TileConfigIndex &ti_ramt = tile_configs.at(TILE_RAMT);
+            const TileConfigIndex &ti_ramb = tile_configs.at(TILE_RAMB);
             if (!(ctx->args.type == ArchArgs::LP1K || ctx->args.type == ArchArgs::HX1K)) {
                 set_config(ti_ramb, config.at(y).at(x), "RamConfig.PowerUp", true);
             }
@@ -618,18 +664,22 @@ void write_asc(const Context *ctx, std::ostream &out)
             set_config(ti_ramt, config.at(y + 1).at(x), "RamConfig.CBIT_2", read_mode & 0x1);
             set_config(ti_ramt, config.at(y + 1).at(x), "RamConfig.CBIT_3", read_mode & 0x2);
         } else if (cell.second->type == ctx->id("SB_LED_DRV_CUR")) {
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "LED_DRV_CUR_EN", true,
-                        "IpConfig.");
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "LED_DRV_CUR_EN",
+                        true, "IpConfig.");
         } else if (cell.second->type == ctx->id("SB_RGB_DRV")) {
             const std::vector<std::pair<std::string, int>> rgb_params = {
                     {"RGB0_CURRENT", 6}, {"RGB1_CURRENT", 6}, {"RGB2_CURRENT", 6}};
-            configure_extra_cell(config, ctx, cell.second.get(), rgb_params, true, std::string("IpConfig."));
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "RGB_DRV_EN", true, "IpConfig.");
+            configure_extra_cell(config, ctx, tile_configs, cell.second.get(), rgb_params, true,
+                                 std::string("IpConfig."));
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "RGB_DRV_EN", true,
+                        "IpConfig.");
         } else if (cell.second->type == ctx->id("SB_RGBA_DRV")) {
             const std::vector<std::pair<std::string, int>> rgba_params = {
                     {"CURRENT_MODE", 1}, {"RGB0_CURRENT", 6}, {"RGB1_CURRENT", 6}, {"RGB2_CURRENT", 6}};
-            configure_extra_cell(config, ctx, cell.second.get(), rgba_params, true, std::string("IpConfig."));
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "RGBA_DRV_EN", true, "IpConfig.");
+            configure_extra_cell(config, ctx, tile_configs, cell.second.get(), rgba_params, true,
+                                 std::string("IpConfig."));
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "RGBA_DRV_EN", true,
+                        "IpConfig.");
         } else if (cell.second->type == ctx->id("SB_WARMBOOT") || cell.second->type == ctx->id("ICESTORM_LFOSC") ||
                    cell.second->type == ctx->id("SB_LEDDA_IP")) {
             // No config needed
@@ -638,29 +688,29 @@ void write_asc(const Context *ctx, std::ostream &out)
                               cell.second->attrs[ctx->id("SDA_INPUT_DELAYED")].as_bool();
             bool sda_out_dly = !cell.second->attrs.count(ctx->id("SDA_OUTPUT_DELAYED")) ||
                                cell.second->attrs[ctx->id("SDA_OUTPUT_DELAYED")].as_bool();
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "SDA_INPUT_DELAYED", sda_in_dly,
-                        "IpConfig.");
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "SDA_OUTPUT_DELAYED", sda_out_dly,
-                        "IpConfig.");
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "I2C_ENABLE_0", true,
-                        "IpConfig.");
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "I2C_ENABLE_1", true,
-                        "IpConfig.");
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "SDA_INPUT_DELAYED",
+                        sda_in_dly, "IpConfig.");
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel),
+                        "SDA_OUTPUT_DELAYED", sda_out_dly, "IpConfig.");
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "I2C_ENABLE_0",
+                        true, "IpConfig.");
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "I2C_ENABLE_1",
+                        true, "IpConfig.");
         } else if (cell.second->type == ctx->id("SB_SPI")) {
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "SPI_ENABLE_0", true,
-                        "IpConfig.");
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "SPI_ENABLE_1", true,
-                        "IpConfig.");
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "SPI_ENABLE_2", true,
-                        "IpConfig.");
-            set_ec_cbit(config, ctx, get_ec_config(ctx->chip_info, cell.second->bel), "SPI_ENABLE_3", true,
-                        "IpConfig.");
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "SPI_ENABLE_0",
+                        true, "IpConfig.");
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "SPI_ENABLE_1",
+                        true, "IpConfig.");
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "SPI_ENABLE_2",
+                        true, "IpConfig.");
+            set_ec_cbit(config, ctx, tile_configs, get_ec_config(ctx->chip_info, cell.second->bel), "SPI_ENABLE_3",
+                        true, "IpConfig.");
         } else if (cell.second->type == ctx->id("ICESTORM_SPRAM")) {
             const BelInfoPOD &beli = ci.bel_data[bel.index];
             int x = beli.x, y = beli.y, z = beli.z;
             NPNR_ASSERT(ctx->args.type == ArchArgs::UP5K);
             if (x == 0 && y == 0) {
-                const TileInfoPOD &ti_ipcon = bi.tiles_nonrouting[TILE_IPCON];
+                const TileConfigIndex &ti_ipcon = tile_configs.at(TILE_IPCON);
                 if (z == 1) {
                     set_config(ti_ipcon, config.at(1).at(0), "IpConfig.CBIT_0", true);
                 } else if (z == 2) {
@@ -669,7 +719,7 @@ void write_asc(const Context *ctx, std::ostream &out)
                     NPNR_ASSERT(false);
                 }
             } else if (x == 25 && y == 0) {
-                const TileInfoPOD &ti_ipcon = bi.tiles_nonrouting[TILE_IPCON];
+                const TileConfigIndex &ti_ipcon = tile_configs.at(TILE_IPCON);
                 if (z == 3) {
                     set_config(ti_ipcon, config.at(1).at(25), "IpConfig.CBIT_0", true);
                 } else if (z == 4) {
@@ -698,12 +748,14 @@ void write_asc(const Context *ctx, std::ostream &out)
                                                                            {"MODE_8x8", 1},
                                                                            {"A_SIGNED", 1},
                                                                            {"B_SIGNED", 1}};
-            configure_extra_cell(config, ctx, cell.second.get(), mac16_params, false, std::string("IpConfig."));
+            configure_extra_cell(config, ctx, tile_configs, cell.second.get(), mac16_params, false,
+                                 std::string("IpConfig."));
         } else if (cell.second->type == ctx->id("ICESTORM_HFOSC")) {
             std::vector<std::pair<std::string, int>> hfosc_params = {{"CLKHF_DIV", 2}};
             if (ctx->args.type != ArchArgs::U4K)
                 hfosc_params.push_back(std::pair<std::string, int>("TRIM_EN", 1));
-            configure_extra_cell(config, ctx, cell.second.get(), hfosc_params, true, std::string("IpConfig."));
+            configure_extra_cell(config, ctx, tile_configs, cell.second.get(), hfosc_params, true,
+                                 std::string("IpConfig."));
 
         } else if (cell.second->type == ctx->id("ICESTORM_PLL")) {
             const std::vector<std::pair<std::string, int>> pll_params = {{"DELAY_ADJMODE_FB", 1},
@@ -720,12 +772,12 @@ void write_asc(const Context *ctx, std::ostream &out)
                                                                          {"PLLTYPE", 3},
                                                                          {"SHIFTREG_DIV_MODE", 1},
                                                                          {"TEST_MODE", 1}};
-            configure_extra_cell(config, ctx, cell.second.get(), pll_params, false, std::string("PLL."));
+            configure_extra_cell(config, ctx, tile_configs, cell.second.get(), pll_params, false, std::string("PLL."));
 
             // Configure the SB_IOs that the clock outputs are going through.
             for (auto &io_bel_loc : sb_io_used_by_pll_out) {
                 // Write config.
-                const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_IO];
+                const TileConfigIndex &ti = tile_configs.at(TILE_IO);
 
                 // PINTYPE[1:0] == "01" passes the PLL through to the fabric.
                 set_config(ti, config.at(io_bel_loc.y).at(io_bel_loc.x),
@@ -741,7 +793,7 @@ void write_asc(const Context *ctx, std::ostream &out)
     // Set config bits in unused IO and RAM
     for (auto bel : ctx->getBels()) {
         if (ctx->bel_to_cell[bel.index] == nullptr && ctx->getBelType(bel) == id_SB_IO) {
-            const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_IO];
+            const TileConfigIndex &ti = tile_configs.at(TILE_IO);
             const BelInfoPOD &beli = ci.bel_data[bel.index];
             int x = beli.x, y = beli.y, z = beli.z;
             if (sb_io_used_by_pll_out.count(Loc(x, y, z))) {
@@ -770,18 +822,18 @@ void write_asc(const Context *ctx, std::ostream &out)
         } else if (ctx->bel_to_cell[bel.index] == nullptr && ctx->getBelType(bel) == id_ICESTORM_RAM) {
             const BelInfoPOD &beli = ci.bel_data[bel.index];
             int x = beli.x, y = beli.y;
-            const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_RAMB];
+            const TileConfigIndex &ti = tile_configs.at(TILE_RAMB);
             if ((ctx->args.type == ArchArgs::LP1K || ctx->args.type == ArchArgs::HX1K)) {
                 set_config(ti, config.at(y).at(x), "RamConfig.PowerUp", true);
             }
         }
     }
 
-    // Set other config bits
-    for (int y = 0; y < ci.height; y++) {
+    // Set other config bits, a row of tiles at a time
+    parallel_stride(threads, ci.height, [&](int y) {
         for (int x = 0; x < ci.width; x++) {
             TileType tile = tile_at(ctx, x, y);
-            const TileInfoPOD &ti = bi.tiles_nonrouting[tile];
+            const TileConfigIndex &ti = tile_configs.at(tile);
 
             // set all ColBufCtrl bits (FIXME)
             bool setColBufCtrl = true;
@@ -836,28 +888,28 @@ void write_asc(const Context *ctx, std::ostream &out)
                 }
             }
         }
-    }
+    });
 
-    // Write config out
-    for (int y = 0; y < ci.height; y++) {
+    // Write config out; the text of each row of tiles is built by the worker threads, then written in order
+    std::vector<std::string> row_text(ci.height);
+    parallel_stride(threads, ci.height, [&](int y) {
+        std::string &buf = row_text.at(y);
         for (int x = 0; x < ci.width; x++) {
             TileType tile = tile_at(ctx, x, y);
             if (tile == TILE_NONE)
                 continue;
-            out << tagTileType(tile);
-            out << " " << x << " " << y << std::endl;
-            for (auto row : config.at(y).at(x)) {
-                for (auto col : row) {
-                    if (col == 1)
-                        out << "1";
-                    else
-                        out << "0";
-                }
-                out << std::endl;
+            buf += tagTileType(tile);
+            buf += " " + std::to_string(x) + " " + std::to_string(y) + "\n";
+            for (auto &row : config.at(y).at(x)) {
+                for (auto col : row)
+                    buf += (col == 1) ? '1' : '0';
+                buf += '\n';
             }
-            out << std::endl;
+            buf += '\n';
         }
-    }
+    });
+    for (auto &text : row_text)
+        out << text;
 
     // Write RAM init data
     for (auto &cell : ctx->cells) {
@@ -870,8 +922,8 @@ void write_asc(const Context *ctx, std::ostream &out)
                     std::vector<bool> bits(256);
                     Property init = get_or_default(cell.second->params, ctx->id(std::string("INIT_") + get_hexdigit(w)),
                                                    Property(0, 256));
-                    for (size_t i = 0; i < init.str.size(); i++) {
-                        bool val = (init.str.at(i) == Property::State::S1);
+                    for (int i = 0; i < init.width; i++) {
+                        bool val = (init.bit(i) == Property::State::S1);
                         bits.at(i) = val;
                     }
                     for (int i = bits.size() - 4; i >= 0; i -= 4) {
@@ -989,6 +1041,7 @@ bool read_asc(Context *ctx, std::istream &in)
         // [y][x][row][col]
         const ChipInfoPOD &ci = *ctx->chip_info;
         const BitstreamInfoPOD &bi = *ci.bits_info;
+        const tileconfigs_t tile_configs = index_tile_configs(bi);
         chipconfig_t config;
         config.resize(ci.height);
         for (int y = 0; y < ci.height; y++) {
@@ -1024,7 +1077,7 @@ bool read_asc(Context *ctx, std::istream &in)
         }
         for (auto bel : ctx->getBels()) {
             if (ctx->getBelType(bel) == id_ICESTORM_LC) {
-                const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_LOGIC];
+                const TileConfigIndex &ti = tile_configs.at(TILE_LOGIC);
                 const BelInfoPOD &beli = ci.bel_data[bel.index];
                 int x = beli.x, y = beli.y, z = beli.z;
                 std::vector<bool> lc(20, false);
@@ -1047,7 +1100,7 @@ bool read_asc(Context *ctx, std::istream &in)
                 }
             }
             if (ctx->getBelType(bel) == id_SB_IO) {
-                const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_IO];
+                const TileConfigIndex &ti = tile_configs.at(TILE_IO);
                 const BelInfoPOD &beli = ci.bel_data[bel.index];
                 int x = beli.x, y = beli.y, z = beli.z;
                 bool isUsed = false;
@@ -18,6 +18,7 @@
  */
 
 #include "jsonwrite.h"
+#include <algorithm>
 #include <assert.h>
 #include <fstream>
 #include <iostream>
@@ -25,6 +26,7 @@
 #include <log.h>
 #include <map>
 #include <string>
+#include <thread>
 #include "nextpnr.h"
 #include "version.h"
 
@@ -32,31 +34,48 @@ NEXTPNR_NAMESPACE_BEGIN
 
 namespace JsonWriter {
 
-std::string get_string(std::string str)
+// Append a quoted string to out; the same buffers are appended to throughout, so that writing a name doesn't
+// allocate a new string
+void append_string(std::string &out, const char *str)
 {
-    std::string newstr = "\"";
-    for (char c : str) {
-        if (c == '\\')
-            newstr += c;
-        newstr += c;
+    out += '"';
+    for (const char *c = str; *c != '\0'; c++) {
+        if (*c == '\\')
+            out += *c;
+        out += *c;
     }
-    return newstr + "\"";
+    out += '"';
 }
 
-std::string get_name(IdString name, Context *ctx) { return get_string(name.c_str(ctx)); }
+std::string get_string(std::string str)
+{
+    std::string newstr;
+    append_string(newstr, str.c_str());
+    return newstr;
+}
 
-void write_parameters(std::ostream &f, Context *ctx, const std::unordered_map<IdString, Property> &parameters,
-                      bool for_module = false)
+template <typename Tdict>
+void append_parameters(std::string &out, Context *ctx, const Tdict &parameters, bool for_module = false)
 {
     bool first = true;
     for (auto &param : parameters) {
-        f << stringf("%s\n", first ? "" : ",");
-        f << stringf("        %s%s: ", for_module ? "" : "    ", get_name(param.first, ctx).c_str());
-        f << get_string(param.second.to_string());
+        out += first ? "\n" : ",\n";
+        out += for_module ? "        " : "            ";
+        append_string(out, param.first.c_str(ctx));
+        out += ": ";
+        append_string(out, param.second.to_string().c_str());
         first = false;
     }
 }
 
+template <typename Tdict>
+void write_parameters(std::ostream &f, Context *ctx, const Tdict &parameters, bool for_module = false)
+{
+    std::string buf;
+    append_parameters(buf, ctx, parameters, for_module);
+    f << buf;
+}
+
 struct PortGroup
 {
     std::string name;
@@ -64,8 +83,7 @@ struct PortGroup
     PortType dir;
 };
 
-std::vector<PortGroup> group_ports(Context *ctx, const std::unordered_map<IdString, PortInfo> &ports,
-                                   bool is_cell = false)
+template <typename Tdict> std::vector<PortGroup> group_ports(Context *ctx, const Tdict &ports, bool is_cell = false)
 {
     std::vector<PortGroup> groups;
     std::unordered_map<std::string, size_t> base_to_group;
@@ -95,29 +113,164 @@ std::vector<PortGroup> group_ports(Context *ctx, const std::unordered_map<IdStri
     return groups;
 }
 
-std::string format_port_bits(const PortGroup &port, int &dummy_idx)
+// Single disconnected ports are written without any bits
+bool is_unconnected(const PortGroup &port) { return port.bits.size() == 1 && port.bits.at(0) == -1; }
+
+// Number of placeholder bits that format_port_bits numbers for a group of ports
+int count_dummy_bits(const std::vector<PortGroup> &groups)
+{
+    int count = 0;
+    for (auto &port : groups)
+        if (!is_unconnected(port))
+            count += int(std::count(port.bits.begin(), port.bits.end(), -1));
+    return count;
+}
+
+void append_port_bits(std::string &out, const PortGroup &port, int &dummy_idx)
 {
-    std::stringstream s;
-    s << "[ ";
+    out += "[ ";
     bool first = true;
-    if (port.bits.size() != 1 || port.bits.at(0) != -1) // skip single disconnected ports
+    if (!is_unconnected(port))
         for (auto bit : port.bits) {
             if (!first)
-                s << ", ";
-            if (bit == -1)
-                s << (++dummy_idx);
-            else
-                s << bit;
+                out += ", ";
+            out += std::to_string(bit == -1 ? ++dummy_idx : bit);
             first = false;
         }
-    s << " ]";
-    return s.str();
+    out += " ]";
 }
 
+std::string format_port_bits(const PortGroup &port, int &dummy_idx)
+{
+    std::string s;
+    append_port_bits(s, port, dummy_idx);
+    return s;
+}
+
+void append_cell(std::string &out, Context *ctx, const CellInfo *c, const std::vector<PortGroup> &cell_ports,
+                 bool first, int &dummy_idx)
+{
+    out += first ? "\n" : ",\n";
+    out += "        ";
+    append_string(out, c->name.c_str(ctx));
+    out += ": {\n";
+    out += c->name.c_str(ctx)[0] == '$' ? "          \"hide_name\": 1,\n" : "          \"hide_name\": 0,\n";
+    out += "          \"type\": ";
+    append_string(out, c->type.c_str(ctx));
+    out += ",\n";
+    out += "          \"parameters\": {";
+    append_parameters(out, ctx, c->params);
+    out += "\n          },\n";
+    out += "          \"attributes\": {";
+    append_parameters(out, ctx, c->attrs);
+    out += "\n          },\n";
+    out += "          \"port_directions\": {";
+    bool first2 = true;
+    for (auto &pg : cell_ports) {
+        out += first2 ? "\n" : ",\n";
+        out += "            ";
+        append_string(out, pg.name.c_str());
+        out += (pg.dir == PORT_IN) ? ": \"input\"" : (pg.dir == PORT_OUT) ? ": \"output\"" : ": \"inout\"";
+        first2 = false;
+    }
+    out += "\n          },\n";
+    out += "          \"connections\": {";
+    first2 = true;
+    for (auto &pg : cell_ports) {
+        out += first2 ? "\n" : ",\n";
+        out += "            ";
+        append_string(out, pg.name.c_str());
+        out += ": ";
+        append_port_bits(out, pg, dummy_idx);
+        first2 = false;
+    }
+    out += "\n          }\n";
+    out += "        }";
+}
+
+void append_net(std::string &out, Context *ctx, int index, const NetInfo *w, bool first)
+{
+    out += first ? "\n" : ",\n";
+    out += "        ";
+    append_string(out, w->name.c_str(ctx));
+    out += ": {\n";
+    out += w->name.c_str(ctx)[0] == '$' ? "          \"hide_name\": 1,\n" : "          \"hide_name\": 0,\n";
+    out += "          \"bits\": [ " + std::to_string(index) + " ] ,\n";
+    out += "          \"attributes\": {";
+    append_parameters(out, ctx, w->attrs);
+    out += "\n          }\n";
+    out += "        }";
+}
+
+// Cells and nets are converted by worker threads, a batch of chunks at a time; each chunk goes into a buffer of its
+// own, and the buffers are written out in order once the batch is done, so the output doesn't depend on the
+// thread count
+struct ChunkWriter
+{
+    static const int chunk_items = 256;
+    int threads;
+    std::vector<std::string> bufs;
+
+    explicit ChunkWriter(Context *ctx)
+    {
+        threads = std::max(1, ctx->settings.count(ctx->id("threads"))
+                                      ? ctx->setting<int>("threads")
+                                      : std::max<int>(1, std::thread::hardware_concurrency()));
+        bufs.resize(threads * 4);
+    }
+
+    // Run func(chunk, begin, end) for the chunks of a batch, on all threads
+    template <typename Tf> void run_batch(int batch, int batch_chunks, int count, Tf func)
+    {
+        auto worker = [&](int t) {
+            for (int c = t; c < batch_chunks; c += threads) {
+                int begin = batch + c * chunk_items;
+                func(c, begin, std::min(count, begin + chunk_items));
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int t = 1; t < std::min(threads, batch_chunks); t++)
+            workers.emplace_back(worker, t);
+        worker(0);
+        for (auto &w : workers)
+            w.join();
+    }
+
+    // Write count items; the dummy_bits(i) placeholder bits of each item are numbered in item order, starting
+    // after dummy_idx, as if the items were written one by one
+    template <typename Tcount, typename Tappend>
+    void write(std::ostream &f, int count, int &dummy_idx, Tcount dummy_bits, Tappend append_item)
+    {
+        std::vector<int> chunk_dummies(bufs.size());
+        for (int batch = 0; batch < count; batch += chunk_items * int(bufs.size())) {
+            int batch_chunks = std::min<int>(int(bufs.size()), (count - batch + chunk_items - 1) / chunk_items);
+            run_batch(batch, batch_chunks, count, [&](int c, int begin, int end) {
+                chunk_dummies.at(c) = 0;
+                for (int i = begin; i < end; i++)
+                    chunk_dummies.at(c) += dummy_bits(i);
+            });
+            std::vector<int> chunk_start(batch_chunks);
+            for (int c = 0; c < batch_chunks; c++) {
+                chunk_start.at(c) = dummy_idx;
+                dummy_idx += chunk_dummies.at(c);
+            }
+            run_batch(batch, batch_chunks, count, [&](int c, int begin, int end) {
+                auto &buf = bufs.at(c);
+                buf.clear();
+                int chunk_dummy = chunk_start.at(c);
+                for (int i = begin; i < end; i++)
+                    append_item(buf, i, chunk_dummy);
+            });
+            for (int c = 0; c < batch_chunks; c++)
+                f << bufs.at(c);
+        }
+    }
+};
+
 void write_module(std::ostream &f, Context *ctx)
 {
     auto val = ctx->attrs.find(ctx->id("module"));
-    int dummy_idx = int(ctx->idstring_idx_to_str->size()) + 1000;
+    int dummy_idx = ctx->idstring_db->size() + 1000;
     if (val != ctx->attrs.end())
         f << stringf("    %s: {\n", get_string(val->second.as_string()).c_str());
     else
@@ -144,60 +297,33 @@ void write_module(std::ostream &f, Context *ctx)
     }
     f << stringf("\n      },\n");
 
-    f << stringf("      \"cells\": {");
-    first = true;
-    for (auto &pair : ctx->cells) {
-        auto &c = pair.second;
-        auto cell_ports = group_ports(ctx, c->ports, true);
-        f << stringf("%s\n", first ? "" : ",");
-        f << stringf("        %s: {\n", get_name(c->name, ctx).c_str());
-        f << stringf("          \"hide_name\": %s,\n", c->name.c_str(ctx)[0] == '$' ? "1" : "0");
-        f << stringf("          \"type\": %s,\n", get_name(c->type, ctx).c_str());
-        f << stringf("          \"parameters\": {");
-        write_parameters(f, ctx, c->params);
-        f << stringf("\n          },\n");
-        f << stringf("          \"attributes\": {");
-        write_parameters(f, ctx, c->attrs);
-        f << stringf("\n          },\n");
-        f << stringf("          \"port_directions\": {");
-        bool first2 = true;
-        for (auto &pg : cell_ports) {
-            std::string direction = (pg.dir == PORT_IN) ? "input" : (pg.dir == PORT_OUT) ? "output" : "inout";
-            f << stringf("%s\n", first2 ? "" : ",");
-            f << stringf("            %s: \"%s\"", get_string(pg.name).c_str(), direction.c_str());
-            first2 = false;
-        }
-        f << stringf("\n          },\n");
-        f << stringf("          \"connections\": {");
-        first2 = true;
-        for (auto &pg : cell_ports) {
-            f << stringf("%s\n", first2 ? "" : ",");
-            f << stringf("            %s: %s", get_string(pg.name).c_str(), format_port_bits(pg, dummy_idx).c_str());
-            first2 = false;
-        }
-        f << stringf("\n          }\n");
-
-        f << stringf("        }");
-        first = false;
-    }
+    ChunkWriter writer(ctx);
 
+    f << stringf("      \"cells\": {");
+    std::vector<const CellInfo *> cells;
+    for (auto &pair : ctx->cells)
+        cells.push_back(pair.second.get());
+    // The port groups of a batch are kept between counting and writing its placeholder bits
+    std::vector<std::vector<PortGroup>> cell_ports(cells.size());
+    writer.write(
+            f, int(cells.size()), dummy_idx,
+            [&](int i) {
+                cell_ports.at(i) = group_ports(ctx, cells.at(i)->ports, true);
+                return count_dummy_bits(cell_ports.at(i));
+            },
+            [&](std::string &buf, int i, int &chunk_dummy) {
+                append_cell(buf, ctx, cells.at(i), cell_ports.at(i), i == 0, chunk_dummy);
+                std::vector<PortGroup>().swap(cell_ports.at(i));
+            });
     f << stringf("\n      },\n");
 
     f << stringf("      \"netnames\": {");
-    first = true;
-    for (auto &pair : ctx->nets) {
-        auto &w = pair.second;
-        f << stringf("%s\n", first ? "" : ",");
-        f << stringf("        %s: {\n", get_name(w->name, ctx).c_str());
-        f << stringf("          \"hide_name\": %s,\n", w->name.c_str(ctx)[0] == '$' ? "1" : "0");
-        f << stringf("          \"bits\": [ %d ] ,\n", pair.first.index);
-        f << stringf("          \"attributes\": {");
-        write_parameters(f, ctx, w->attrs);
-        f << stringf("\n          }\n");
-        f << stringf("        }");
-        first = false;
-    }
-
+    std::vector<std::pair<int, const NetInfo *>> nets;
+    for (auto &pair : ctx->nets)
+        nets.emplace_back(pair.first.index, pair.second.get());
+    writer.write(
+            f, int(nets.size()), dummy_idx, [](int) { return 0; },
+            [&](std::string &buf, int i, int &) { append_net(buf, ctx, nets.at(i).first, nets.at(i).second, i == 0); });
     f << stringf("\n      }\n");
     f << stringf("    }");
 }
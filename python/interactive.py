@@ -1,5 +1,8 @@
 # Pass this file to one of the Python script arguments (e.g. --pre-place interactive.py)
 # to drop to a command-line interactive Python session in the middle of place and route 
+#
+# After routing, ctx.reroute(["net", ...], {"router2/bbMargin/x": 6}) rips up and routes the given nets again in the
+# background; it returns a job with done(), cancel() and wait(). Leave the design alone until done() is true.
 
 import code
 print("Press Ctrl+D to finish interactive session")
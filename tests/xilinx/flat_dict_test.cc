@@ -0,0 +1,277 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+// The live keys of a flat_dict in insertion order, with the values in a std::map. Reclaiming dead slots keeps the
+// order, so erasing a key only removes it from the list.
+struct Reference
+{
+    std::vector<int> order;
+    std::map<int, int> values;
+
+    void set(int key, int value)
+    {
+        if (!values.count(key))
+            order.push_back(key);
+        values[key] = value;
+    }
+
+    size_t erase(int key)
+    {
+        order.erase(std::remove(order.begin(), order.end(), key), order.end());
+        return values.erase(key);
+    }
+};
+
+void check_same(const flat_dict<int, int> &d, const Reference &ref)
+{
+    ASSERT_EQ(d.size(), ref.values.size());
+    ASSERT_EQ(d.empty(), ref.values.empty());
+    for (auto &entry : ref.values) {
+        ASSERT_EQ(d.count(entry.first), size_t(1)) << entry.first;
+        ASSERT_EQ(d.at(entry.first), entry.second) << entry.first;
+    }
+    auto it = d.begin();
+    for (int key : ref.order) {
+        ASSERT_TRUE(it != d.end());
+        ASSERT_EQ(it->first, key);
+        ++it;
+    }
+    ASSERT_TRUE(it == d.end());
+}
+
+// Counts the values alive, to catch entries leaked or destroyed twice when the array is moved
+struct Counted
+{
+    static int alive;
+    int value;
+    Counted(int value = 0) : value(value) { alive++; }
+    Counted(const Counted &other) : value(other.value) { alive++; }
+    Counted(Counted &&other) : value(other.value) { alive++; }
+    Counted &operator=(const Counted &other) = default;
+    ~Counted() { alive--; }
+};
+int Counted::alive = 0;
+
+} // namespace
+
+TEST(FlatDictTest, randomOperations)
+{
+    // Small key ranges stay below the index threshold; larger ones cross it both ways
+    for (int keys : {5, 12, 40, 1000}) {
+        flat_dict<int, int> d;
+        Reference ref;
+        std::mt19937 rng(keys);
+        for (int i = 0; i < 5000; i++) {
+            int key = int(rng() % keys);
+            switch (rng() % 8) {
+            case 0:
+            case 1:
+            case 2:
+                d[key] = i;
+                ref.set(key, i);
+                break;
+            case 3: {
+                auto ins = d.emplace(key, i);
+                ASSERT_EQ(ins.second, ref.values.count(key) == 0);
+                if (ins.second)
+                    ref.set(key, i);
+                ASSERT_EQ(ins.first->second, ref.values.at(key));
+                break;
+            }
+            case 4:
+            case 5:
+            case 6:
+                ASSERT_EQ(d.erase(key), ref.erase(key));
+                break;
+            case 7:
+                ASSERT_EQ(d.count(key), ref.values.count(key));
+                break;
+            }
+            if (keys <= 40 || i % 100 == 0)
+                check_same(d, ref);
+        }
+        check_same(d, ref);
+    }
+}
+
+TEST(FlatDictTest, eraseDoesNotMove)
+{
+    // Erasing leaves a dead slot and moves nothing, so references to the other entries stay valid
+    flat_dict<int, int> d;
+    for (int i = 0; i < 20; i++)
+        d[i] = i;
+    std::vector<int *> refs;
+    for (int i = 0; i < 20; i++)
+        refs.push_back(&d.at(i));
+    for (int i = 0; i < 20; i += 3)
+        d.erase(i);
+    for (int i = 0; i < 20; i++) {
+        if (i % 3 != 0) {
+            ASSERT_EQ(refs[i], &d.at(i));
+        }
+    }
+}
+
+TEST(FlatDictTest, growthMovesEntries)
+{
+    // Inserting into a full array moves every entry to a new one; the values must come through intact, in order
+    flat_dict<int, Counted> d;
+    for (int i = 0; i < 4; i++)
+        d.emplace(i, i);
+    const Counted *before = &d.at(0);
+    size_t heap_before = d.heap_size();
+    d.emplace(4, 4);
+    ASSERT_NE(before, &d.at(0));
+    ASSERT_GT(d.heap_size(), heap_before);
+    for (int i = 5; i < 100; i++)
+        d.emplace(i, i);
+    ASSERT_EQ(Counted::alive, 100);
+    int expected = 0;
+    for (auto &entry : d) {
+        ASSERT_EQ(entry.first, expected);
+        ASSERT_EQ(entry.second.value, expected);
+        expected++;
+    }
+    d.clear();
+    ASSERT_EQ(Counted::alive, 0);
+}
+
+TEST(FlatDictTest, reserveAvoidsGrowth)
+{
+    // Up to the reserved size, inserting doesn't move the entries (the hash index is there from the 9th on)
+    flat_dict<int, int> d;
+    d.reserve(64);
+    for (int i = 0; i < 9; i++)
+        d[i] = i;
+    const int *first = &d.at(0);
+    size_t heap = d.heap_size();
+    for (int i = 9; i < 64; i++)
+        d[i] = i;
+    ASSERT_EQ(first, &d.at(0));
+    ASSERT_EQ(d.heap_size(), heap);
+}
+
+TEST(FlatDictTest, reclaimDeadSlots)
+{
+    // With at least half the array dead when it fills up, the dead slots are reclaimed in place instead of growing
+    flat_dict<int, Counted> d;
+    Reference ref;
+    for (int i = 0; i < 16; i++) {
+        d.emplace(i, i);
+        ref.set(i, i);
+    }
+    size_t heap = d.heap_size();
+    for (int round = 0; round < 20; round++) {
+        // Erase all but the first four, then refill the array with new keys
+        int kept = 0;
+        for (auto it = d.begin(); it != d.end();) {
+            if (kept++ >= 4) {
+                ref.erase(it->first);
+                it = d.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (int i = 0; int(d.size()) < 16; i++) {
+            int key = 1000 * (round + 1) + i;
+            d.emplace(key, key);
+            ref.set(key, key);
+        }
+        ASSERT_EQ(d.heap_size(), heap) << round;
+        ASSERT_EQ(Counted::alive, 16);
+        ASSERT_EQ(d.size(), ref.values.size());
+        auto it = d.begin();
+        for (int key : ref.order) {
+            ASSERT_EQ(it->first, key);
+            ASSERT_EQ(it->second.value, key);
+            ++it;
+        }
+    }
+    // With most of the array live, it grows instead
+    for (int i = 0; i < 4; i++)
+        d.erase(d.begin()->first);
+    for (int i = 0; i < 16; i++)
+        d.emplace(5000 + i, i);
+    ASSERT_GT(d.heap_size(), heap);
+    d.clear();
+    ASSERT_EQ(Counted::alive, 0);
+}
+
+TEST(FlatDictTest, hashIndex)
+{
+    // Lookups give the same answers on both sides of the index threshold, including after the index is dropped
+    // again when a reallocation finds few enough live entries
+    flat_dict<int, int> d;
+    Reference ref;
+    for (int i = 0; i < 30; i++) {
+        d[i * 7] = i;
+        ref.set(i * 7, i);
+        check_same(d, ref);
+        for (int key = 0; key < 220; key++)
+            ASSERT_EQ(d.count(key), ref.values.count(key)) << key;
+    }
+    for (int i = 0; i < 27; i++) {
+        ASSERT_EQ(d.erase(i * 7), ref.erase(i * 7));
+        check_same(d, ref);
+    }
+    for (int i = 0; i < 40; i++) {
+        d[1000 + i] = i;
+        ref.set(1000 + i, i);
+        check_same(d, ref);
+    }
+    ASSERT_THROW(d.at(0), std::out_of_range);
+}
+
+TEST(FlatDictTest, copyAndMove)
+{
+    {
+        flat_dict<int, Counted> a;
+        for (int i = 0; i < 20; i++)
+            a.emplace(i, i);
+        a.erase(3);
+        flat_dict<int, Counted> b(a);
+        ASSERT_EQ(b.size(), size_t(19));
+        ASSERT_EQ(Counted::alive, 38);
+        flat_dict<int, Counted> c(std::move(a));
+        ASSERT_TRUE(a.empty());
+        ASSERT_TRUE(a.begin() == a.end());
+        ASSERT_EQ(Counted::alive, 38);
+        a.emplace(1, 100);
+        ASSERT_EQ(a.at(1).value, 100);
+        c = b;
+        ASSERT_EQ(Counted::alive, 1 + 19 + 19);
+        b = std::move(a);
+        ASSERT_EQ(b.size(), size_t(1));
+        ASSERT_EQ(Counted::alive, 1 + 19);
+        ASSERT_EQ(c.count(3), size_t(0));
+        ASSERT_EQ(c.at(19).value, 19);
+    }
+    ASSERT_EQ(Counted::alive, 0);
+}
@@ -0,0 +1,190 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+// Check a dict against the std::map holding the same entries, through lookups and iteration
+void check_same(const dict<int, int> &d, const std::map<int, int> &m)
+{
+    ASSERT_EQ(d.size(), m.size());
+    for (auto &entry : m) {
+        ASSERT_EQ(d.count(entry.first), 1) << entry.first;
+        ASSERT_EQ(d.at(entry.first), entry.second) << entry.first;
+    }
+    size_t seen = 0;
+    for (auto &entry : d) {
+        auto fnd = m.find(entry.first);
+        ASSERT_TRUE(fnd != m.end()) << entry.first;
+        ASSERT_EQ(entry.second, fnd->second) << entry.first;
+        ++seen;
+    }
+    ASSERT_EQ(seen, m.size());
+}
+
+} // namespace
+
+TEST(HashlibTest, insertLookup)
+{
+    dict<int, int> d;
+    std::map<int, int> m;
+    std::mt19937 rng(1);
+    for (int i = 0; i < 20000; i++) {
+        int key = int(rng() % 50000);
+        d[key] = i;
+        m[key] = i;
+    }
+    check_same(d, m);
+    for (int key = 50000; key < 51000; key++)
+        ASSERT_EQ(d.count(key), 0);
+}
+
+TEST(HashlibTest, insertKeepsOrder)
+{
+    // Entries stay in insertion order, which dict iterates backwards
+    dict<int, int> d;
+    for (int i = 0; i < 1000; i++)
+        d[(i * 7919) % 1000] = i;
+    int expected = 999;
+    for (auto &entry : d) {
+        ASSERT_EQ(entry.second, expected);
+        --expected;
+    }
+}
+
+TEST(HashlibTest, erase)
+{
+    dict<int, int> d;
+    std::map<int, int> m;
+    for (int i = 0; i < 5000; i++) {
+        d[i] = -i;
+        m[i] = -i;
+    }
+    // By key, including keys that aren't there
+    for (int i = 0; i < 5000; i += 3) {
+        ASSERT_EQ(d.erase(i), 1);
+        m.erase(i);
+    }
+    ASSERT_EQ(d.erase(3), 0);
+    ASSERT_EQ(d.erase(100000), 0);
+    check_same(d, m);
+    // By iterator
+    for (auto it = d.begin(); it != d.end();) {
+        if (it->first % 2 == 0) {
+            m.erase(it->first);
+            it = d.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    check_same(d, m);
+    // Down to empty and filled again
+    for (auto &entry : m)
+        ASSERT_EQ(d.erase(entry.first), 1);
+    m.clear();
+    ASSERT_TRUE(d.empty());
+    d[42] = 1;
+    m[42] = 1;
+    check_same(d, m);
+}
+
+TEST(HashlibTest, rehash)
+{
+    // Growth from empty, copies and a reserve larger than the contents all rebuild the index
+    dict<int, int> d;
+    std::map<int, int> m;
+    for (int i = 0; i < 100000; i++) {
+        d[i * 31] = i;
+        m[i * 31] = i;
+    }
+    check_same(d, m);
+    dict<int, int> copy(d);
+    check_same(copy, m);
+    copy.reserve(1000000);
+    check_same(copy, m);
+    dict<int, int> moved(std::move(copy));
+    check_same(moved, m);
+    dict<int, int> assigned;
+    assigned = d;
+    check_same(assigned, m);
+}
+
+TEST(HashlibTest, tombstoneReuse)
+{
+    // Keep a constant number of keys while replacing them, so that deleted slots have to be reused or cleared out
+    // for the index not to fill up
+    dict<int, int> d;
+    std::map<int, int> m;
+    std::mt19937 rng(2);
+    std::vector<int> live;
+    int next_key = 0;
+    for (int i = 0; i < 2000; i++) {
+        d[next_key] = i;
+        m[next_key] = i;
+        live.push_back(next_key++);
+    }
+    for (int round = 0; round < 200000; round++) {
+        size_t victim = rng() % live.size();
+        ASSERT_EQ(d.erase(live.at(victim)), 1);
+        m.erase(live.at(victim));
+        live.at(victim) = next_key;
+        d[next_key] = round;
+        m[next_key] = round;
+        ++next_key;
+        if (round % 20000 == 0)
+            check_same(d, m);
+    }
+    check_same(d, m);
+}
+
+TEST(HashlibTest, pool)
+{
+    pool<int> p;
+    std::set<int> s;
+    std::mt19937 rng(3);
+    for (int i = 0; i < 50000; i++) {
+        int key = int(rng() % 10000);
+        if (rng() % 3 == 0) {
+            ASSERT_EQ(p.erase(key), int(s.erase(key)));
+        } else {
+            ASSERT_EQ(p.insert(key).second, s.insert(key).second);
+        }
+    }
+    ASSERT_EQ(p.size(), s.size());
+    for (int key = 0; key < 10000; key++)
+        ASSERT_EQ(p.count(key), int(s.count(key))) << key;
+}
+
+TEST(HashlibTest, heterogeneousLookup)
+{
+    dict<std::string, int> d;
+    d["alpha"] = 1;
+    d["beta"] = 2;
+    const char *key = "beta";
+    ASSERT_EQ(d.count(key), 1);
+    ASSERT_EQ(d.at(key), 2);
+    ASSERT_EQ(d.count("gamma"), 0);
+}
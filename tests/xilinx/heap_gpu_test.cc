@@ -0,0 +1,211 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+#include "placer_heap_gpu.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+// A matrix in compressed row storage, as the placer hands it to the device
+struct SparseMatrix
+{
+    int n = 0;
+    std::vector<int> row_ptr{0}, cols;
+    std::vector<double> vals;
+
+    std::vector<double> multiply(const std::vector<double> &x) const
+    {
+        std::vector<double> y(n, 0);
+        for (int i = 0; i < n; i++)
+            for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+                y[i] += vals[k] * x.at(cols[k]);
+        return y;
+    }
+};
+
+// The system of a HeAP placement of n cells: random two-pin springs between cells, and an anchor on each cell,
+// which makes it symmetric and positive definite
+SparseMatrix spring_system(int n, double anchor, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<std::map<int, double>> rows(n);
+    for (int i = 0; i < n; i++)
+        rows[i][i] += anchor * (1 + rng() % 4);
+    for (int s = 0; s < 3 * n; s++) {
+        int a = rng() % n, b = rng() % n;
+        if (a == b)
+            continue;
+        double w = 1.0 / (1 + rng() % 8);
+        rows[a][a] += w;
+        rows[b][b] += w;
+        rows[a][b] -= w;
+        rows[b][a] -= w;
+    }
+    SparseMatrix m;
+    m.n = n;
+    for (auto &row : rows) {
+        for (auto &entry : row) {
+            m.cols.push_back(entry.first);
+            m.vals.push_back(entry.second);
+        }
+        m.row_ptr.push_back(int(m.cols.size()));
+    }
+    return m;
+}
+
+std::vector<double> random_vector(int n, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> coord(0, 100);
+    std::vector<double> x(n);
+    for (auto &v : x)
+        v = coord(rng);
+    return x;
+}
+
+double relative_residual(const SparseMatrix &m, const std::vector<double> &x, const std::vector<double> &b)
+{
+    std::vector<double> ax = m.multiply(x);
+    double r2 = 0, b2 = 0;
+    for (int i = 0; i < m.n; i++) {
+        r2 += (ax[i] - b[i]) * (ax[i] - b[i]);
+        b2 += b[i] * b[i];
+    }
+    return std::sqrt(r2 / b2);
+}
+
+// Whether there is a device to test. Without one the tests pass, unless NEXTPNR_REQUIRE_OPENCL is set, as in the
+// OpenCL CI build, where that is a failure.
+bool have_device()
+{
+    std::string error;
+    if (HeapGpuSolver::available(error))
+        return true;
+    if (std::getenv("NEXTPNR_REQUIRE_OPENCL") != nullptr)
+        ADD_FAILURE() << "no OpenCL device: " << error;
+    else
+        std::printf("Skipping the device path: %s\n", error.c_str());
+    return false;
+}
+
+// Solve for a known solution from a zero start, and check both the residual and the solution
+void check_solve(HeapGpuSolver &solver, const SparseMatrix &m, bool jacobi, unsigned seed)
+{
+    std::vector<double> expected = random_vector(m.n, seed);
+    std::vector<double> b = m.multiply(expected);
+    std::vector<double> x(m.n, 0);
+    ASSERT_TRUE(solver.solve(b.data(), x.data(), 1e-10, 4 * m.n, jacobi));
+    ASSERT_LE(relative_residual(m, x, b), 1e-8);
+    for (int i = 0; i < m.n; i++)
+        ASSERT_NEAR(x[i], expected[i], 1e-3) << i;
+}
+
+} // namespace
+
+TEST(HeapGpuSolverTest, solve)
+{
+    if (!have_device())
+        return;
+    SparseMatrix m = spring_system(500, 0.01, 1);
+    for (bool jacobi : {false, true}) {
+        HeapGpuSolver solver;
+        solver.set_matrix(m.n, m.row_ptr.data(), m.cols.data(), m.vals.data(), true);
+        check_solve(solver, m, jacobi, 2);
+    }
+}
+
+TEST(HeapGpuSolverTest, changedValues)
+{
+    // Between placer iterations only the values change, and only those are uploaded again
+    if (!have_device())
+        return;
+    HeapGpuSolver solver;
+    SparseMatrix m = spring_system(300, 0.01, 3);
+    solver.set_matrix(m.n, m.row_ptr.data(), m.cols.data(), m.vals.data(), true);
+    check_solve(solver, m, true, 4);
+    for (auto &v : m.vals)
+        v *= 1.5;
+    for (int i = 0; i < m.n; i++)
+        for (int k = m.row_ptr[i]; k < m.row_ptr[i + 1]; k++)
+            if (m.cols[k] == i)
+                m.vals[k] += 0.5;
+    solver.set_matrix(m.n, m.row_ptr.data(), m.cols.data(), m.vals.data(), false);
+    check_solve(solver, m, true, 5);
+}
+
+TEST(HeapGpuSolverTest, changedSize)
+{
+    // A different size or number of entries must replace the device buffers, whatever pattern_changed says
+    if (!have_device())
+        return;
+    HeapGpuSolver solver;
+    // The last two have the same size, but other springs and so most likely a different number of entries
+    unsigned seed = 12;
+    for (int n : {100, 400, 50, 50}) {
+        SparseMatrix m = spring_system(n, 0.1, seed++);
+        solver.set_matrix(m.n, m.row_ptr.data(), m.cols.data(), m.vals.data(), false);
+        check_solve(solver, m, true, seed++);
+    }
+}
+
+TEST(HeapGpuSolverTest, iterationLimit)
+{
+    // A solve cut short by max_iters still succeeds, with a solution no worse than the start
+    if (!have_device())
+        return;
+    HeapGpuSolver solver;
+    SparseMatrix m = spring_system(500, 0.001, 6);
+    solver.set_matrix(m.n, m.row_ptr.data(), m.cols.data(), m.vals.data(), true);
+    std::vector<double> b = m.multiply(random_vector(m.n, 7));
+    std::vector<double> x(m.n, 0);
+    ASSERT_TRUE(solver.solve(b.data(), x.data(), 1e-12, 2, false));
+    ASSERT_LT(relative_residual(m, x, b), 1.0);
+}
+
+TEST(HeapGpuSolverTest, concurrentSolvers)
+{
+    // The placer solves for x and y at the same time, each solver with its own command queue
+    if (!have_device())
+        return;
+    SparseMatrix mx = spring_system(400, 0.01, 8), my = spring_system(400, 0.01, 9);
+    HeapGpuSolver sx, sy;
+    sx.set_matrix(mx.n, mx.row_ptr.data(), mx.cols.data(), mx.vals.data(), true);
+    sy.set_matrix(my.n, my.row_ptr.data(), my.cols.data(), my.vals.data(), true);
+    std::vector<double> ex = random_vector(mx.n, 10), ey = random_vector(my.n, 11);
+    std::vector<double> bx = mx.multiply(ex), by = my.multiply(ey);
+    for (int i = 0; i < 4; i++) {
+        std::vector<double> x(mx.n, 0), y(my.n, 0);
+        bool ok_x = false, ok_y = false;
+        std::thread tx([&]() { ok_x = sx.solve(bx.data(), x.data(), 1e-10, 4 * mx.n, true); });
+        std::thread ty([&]() { ok_y = sy.solve(by.data(), y.data(), 1e-10, 4 * my.n, true); });
+        tx.join();
+        ty.join();
+        ASSERT_TRUE(ok_x);
+        ASSERT_TRUE(ok_y);
+        ASSERT_LE(relative_residual(mx, x, bx), 1e-8);
+        ASSERT_LE(relative_residual(my, y, by), 1e-8);
+    }
+}
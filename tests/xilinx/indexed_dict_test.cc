@@ -0,0 +1,247 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+// The entries of an indexed_dict, kept as the std::map of each key to its value and insertion index. Iterating the
+// dict must give them in order of that index.
+struct Reference
+{
+    std::map<int, std::pair<int, int>> entries;
+    int next_index = 0;
+
+    void set(int key, int value)
+    {
+        auto fnd = entries.find(key);
+        if (fnd != entries.end())
+            fnd->second.first = value;
+        else
+            entries[key] = std::make_pair(value, next_index++);
+    }
+
+    // compact() numbers the live entries from 0 in their order
+    void compact()
+    {
+        std::map<int, int> by_index;
+        for (auto &entry : entries)
+            by_index[entry.second.second] = entry.first;
+        next_index = 0;
+        for (auto &entry : by_index)
+            entries.at(entry.second).second = next_index++;
+    }
+};
+
+void check_same(const indexed_dict<int, int> &d, const Reference &ref)
+{
+    ASSERT_EQ(d.size(), ref.entries.size());
+    ASSERT_EQ(d.empty(), ref.entries.empty());
+    for (auto &entry : ref.entries) {
+        ASSERT_EQ(d.count(entry.first), size_t(1)) << entry.first;
+        ASSERT_EQ(d.at(entry.first), entry.second.first) << entry.first;
+        ASSERT_EQ(d.find(entry.first).index(), entry.second.second) << entry.first;
+    }
+    std::map<int, int> by_index;
+    for (auto &entry : ref.entries)
+        by_index[entry.second.second] = entry.first;
+    auto expected = by_index.begin();
+    for (auto it = d.begin(); it != d.end(); ++it, ++expected) {
+        ASSERT_TRUE(expected != by_index.end());
+        ASSERT_EQ(it.index(), expected->first);
+        ASSERT_EQ(it->first, expected->second);
+    }
+    ASSERT_TRUE(expected == by_index.end());
+}
+
+} // namespace
+
+TEST(IndexedDictTest, randomOperations)
+{
+    indexed_dict<int, int> d;
+    Reference ref;
+    std::mt19937 rng(1);
+    for (int i = 0; i < 20000; i++) {
+        int key = int(rng() % 500);
+        switch (rng() % 8) {
+        case 0:
+        case 1:
+        case 2:
+            d[key] = i;
+            ref.set(key, i);
+            break;
+        case 3: {
+            auto ins = d.emplace(key, int(i));
+            ASSERT_EQ(ins.second, ref.entries.count(key) == 0);
+            if (ins.second)
+                ref.set(key, i);
+            ASSERT_EQ(ins.first->second, ref.entries.at(key).first);
+            break;
+        }
+        case 4:
+        case 5:
+        case 6:
+            ASSERT_EQ(d.erase(key), ref.entries.erase(key));
+            break;
+        case 7:
+            if (rng() % 50 == 0) {
+                d.compact();
+                ref.compact();
+            }
+            break;
+        }
+        if (i % 1000 == 0)
+            check_same(d, ref);
+    }
+    check_same(d, ref);
+    d.compact();
+    ref.compact();
+    check_same(d, ref);
+}
+
+TEST(IndexedDictTest, tombstones)
+{
+    // Erasing leaves a tombstone: the other entries keep their index, and a key inserted again goes to the end
+    indexed_dict<int, int> d;
+    Reference ref;
+    for (int i = 0; i < 10; i++) {
+        d[i] = i * 10;
+        ref.set(i, i * 10);
+    }
+    for (int key : {0, 3, 4, 9}) {
+        d.erase(key);
+        ref.entries.erase(key);
+    }
+    check_same(d, ref);
+    ASSERT_EQ(d.begin().index(), 1);
+    d[3] = 33;
+    ref.set(3, 33);
+    check_same(d, ref);
+    ASSERT_EQ(d.find(3).index(), 10);
+    ASSERT_TRUE(d.find(0) == d.end());
+    ASSERT_THROW(d.at(0), std::out_of_range);
+}
+
+TEST(IndexedDictTest, tombstoneReleasesValue)
+{
+    // The value of an erased entry is destroyed at once, not when the tombstone is dropped
+    indexed_dict<int, std::shared_ptr<int>> d;
+    std::shared_ptr<int> value(new int(1));
+    d.emplace(1, std::shared_ptr<int>(value));
+    d.emplace(2, std::shared_ptr<int>(new int(2)));
+    ASSERT_EQ(value.use_count(), 2);
+    d.erase(1);
+    ASSERT_EQ(value.use_count(), 1);
+    ASSERT_EQ(*d.at(2), 2);
+}
+
+TEST(IndexedDictTest, referencesStable)
+{
+    // Neither inserting nor erasing other entries moves an entry
+    indexed_dict<int, int> d;
+    std::vector<int *> refs;
+    for (int i = 0; i < 100; i++)
+        refs.push_back(&d[i]);
+    for (int i = 0; i < 100; i += 2)
+        d.erase(i);
+    for (int i = 100; i < 10000; i++)
+        d[i] = i;
+    for (int i = 1; i < 100; i += 2) {
+        ASSERT_EQ(refs[i], &d.at(i));
+        *refs[i] = -i;
+    }
+    for (int i = 1; i < 100; i += 2)
+        ASSERT_EQ(d.at(i), -i);
+}
+
+TEST(IndexedDictTest, eraseWhileIterating)
+{
+    indexed_dict<int, int> d;
+    Reference ref;
+    for (int i = 0; i < 100; i++) {
+        d[i] = i;
+        ref.set(i, i);
+    }
+    for (auto it = d.begin(); it != d.end();) {
+        if (it->first % 3 == 0) {
+            ref.entries.erase(it->first);
+            it = d.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    check_same(d, ref);
+}
+
+TEST(IndexedDictTest, compact)
+{
+    indexed_dict<int, int> d;
+    Reference ref;
+    // Nothing to drop
+    for (int i = 0; i < 50; i++) {
+        d[i * 2] = i;
+        ref.set(i * 2, i);
+    }
+    d.compact();
+    check_same(d, ref);
+    // Entries are renumbered in order, and new ones go after them
+    for (int i = 0; i < 100; i += 6) {
+        d.erase(i);
+        ref.entries.erase(i);
+    }
+    d.compact();
+    ref.compact();
+    check_same(d, ref);
+    ASSERT_EQ(d.begin().index(), 0);
+    d[1] = 1;
+    ref.set(1, 1);
+    check_same(d, ref);
+    ASSERT_EQ(d.find(1).index(), int(d.size()) - 1);
+    // All tombstones
+    for (int i = 0; i < 100; i++) {
+        d.erase(i);
+        ref.entries.erase(i);
+    }
+    d.compact();
+    ref.compact();
+    check_same(d, ref);
+    ASSERT_TRUE(d.begin() == d.end());
+    d[5] = 5;
+    ASSERT_EQ(d.find(5).index(), 0);
+}
+
+TEST(IndexedDictTest, clear)
+{
+    indexed_dict<int, int> d;
+    for (int i = 0; i < 20; i++)
+        d[i] = i;
+    d.erase(3);
+    d.clear();
+    ASSERT_TRUE(d.empty());
+    ASSERT_TRUE(d.begin() == d.end());
+    d[7] = 7;
+    ASSERT_EQ(d.find(7).index(), 0);
+}
@@ -0,0 +1,168 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "nameindex.h"
+
+USING_NEXTPNR_NAMESPACE
+
+using TreeModel::NameIndex;
+
+namespace {
+
+// Lists of element names like those of the tiles of a device: the same local names in every tile of a type, some
+// names with more than one '/' and some without any
+std::vector<std::vector<std::string>> device_names()
+{
+    std::vector<std::vector<std::string>> lists;
+    const char *locals[] = {"A1", "A2", "AQ", "SLICE_X0Y0", "LOGIC_OUTS0", "LOGIC_OUTS12", "IMUX_L3"};
+    for (int y = 0; y < 6; y++) {
+        for (int x = 0; x < 4; x++) {
+            std::vector<std::string> names;
+            std::string tile = (x % 2 ? "INT_R_X" : "CLBLL_L_X") + std::to_string(x) + "Y" + std::to_string(y);
+            for (auto local : locals)
+                names.push_back(tile + "/" + local);
+            names.push_back("SITE_" + std::to_string(x) + "/" + tile + "/AMUX");
+            lists.push_back(names);
+        }
+    }
+    lists.push_back({"VCC", "GND", "GLOBAL/CLK0", "GLOBAL/CLK1"});
+    return lists;
+}
+
+// The (list, element) positions of the names containing text, by plain substring search
+std::vector<std::pair<int, int>> reference_search(const std::vector<std::vector<std::string>> &lists,
+                                                  const std::string &text)
+{
+    std::vector<std::pair<int, int>> found;
+    for (int l = 0; l < int(lists.size()); l++)
+        for (int e = 0; e < int(lists[l].size()); e++)
+            if (lists[l][e].find(text) != std::string::npos)
+                found.emplace_back(l, e);
+    return found;
+}
+
+std::vector<std::pair<int, int>> index_search(const NameIndex &index, const std::string &text)
+{
+    std::vector<std::pair<int, int>> found;
+    index.search(text, [&](int list, int element) {
+        found.emplace_back(list, element);
+        return true;
+    });
+    return found;
+}
+
+NameIndex build_index(const std::vector<std::vector<std::string>> &lists)
+{
+    NameIndex index;
+    for (auto &names : lists)
+        index.addList(names);
+    return index;
+}
+
+} // namespace
+
+TEST(NameIndexTest, substringWithinParts)
+{
+    auto lists = device_names();
+    NameIndex index = build_index(lists);
+    for (const char *text : {"A1", "LOGIC_OUTS1", "X3Y5", "INT_R", "CLBLL", "AMUX", "SITE_2", "VCC", "CLK", "Q", "_"})
+        ASSERT_EQ(index_search(index, text), reference_search(lists, text)) << text;
+}
+
+TEST(NameIndexTest, substringSpanningSlash)
+{
+    // Text with a '/' may fall within the tile part, or end in the tile part and start the local part
+    auto lists = device_names();
+    NameIndex index = build_index(lists);
+    for (const char *text : {"Y2/A", "X1Y0/LOGIC", "Y0/", "/A", "/", "2/INT", "_2/CLBLL_L_X2Y3/AM", "L/CLK",
+                             "X3Y5/IMUX_L3", "Y2/Q", "X0Y0/SLICE_X0Y0"})
+        ASSERT_EQ(index_search(index, text), reference_search(lists, text)) << text;
+}
+
+TEST(NameIndexTest, randomSubstrings)
+{
+    // Random substrings of the names, falling within, before, after and across their slashes
+    auto lists = device_names();
+    NameIndex index = build_index(lists);
+    std::mt19937 rng(1);
+    for (int i = 0; i < 200; i++) {
+        auto &names = lists.at(rng() % lists.size());
+        const std::string &name = names.at(rng() % names.size());
+        size_t start = rng() % name.size();
+        size_t len = 1 + rng() % (name.size() - start);
+        std::string text = name.substr(start, len);
+        ASSERT_EQ(index_search(index, text), reference_search(lists, text)) << text;
+    }
+}
+
+TEST(NameIndexTest, noMatch)
+{
+    auto lists = device_names();
+    NameIndex index = build_index(lists);
+    for (const char *text : {"X9Y9", "A1/", "Q/", "INT_R_X1Y0/A3", "//"})
+        ASSERT_TRUE(index_search(index, text).empty()) << text;
+}
+
+TEST(NameIndexTest, stopEarly)
+{
+    auto lists = device_names();
+    NameIndex index = build_index(lists);
+    std::vector<std::pair<int, int>> found;
+    index.search("A", [&](int list, int element) {
+        found.emplace_back(list, element);
+        return found.size() < 3;
+    });
+    auto all = reference_search(lists, "A");
+    all.resize(3);
+    ASSERT_EQ(found, all);
+}
+
+TEST(NameIndexTest, find)
+{
+    auto lists = device_names();
+    NameIndex index = build_index(lists);
+    for (int l = 0; l < int(lists.size()); l++) {
+        for (int e = 0; e < int(lists[l].size()); e++) {
+            auto pos = index.find(lists[l][e]);
+            ASSERT_TRUE(bool(pos)) << lists[l][e];
+            ASSERT_EQ(*pos, std::make_pair(l, e)) << lists[l][e];
+        }
+    }
+    // Known parts in a combination that doesn't exist, and unknown parts
+    ASSERT_FALSE(bool(index.find("INT_R_X1Y0/VCC")));
+    ASSERT_FALSE(bool(index.find("NOWHERE/A1")));
+    ASSERT_FALSE(bool(index.find("A1")));
+    ASSERT_FALSE(bool(index.find("")));
+}
+
+TEST(NameIndexTest, emptyLists)
+{
+    // Empty lists take no elements but still count as lists
+    NameIndex index;
+    index.addList({});
+    index.addList({"T/A"});
+    index.addList({});
+    index.addList({"T/B", "A"});
+    std::vector<std::pair<int, int>> expected{{1, 0}, {3, 1}};
+    ASSERT_EQ(index_search(index, "A"), expected);
+    ASSERT_EQ(*index.find("T/B"), std::make_pair(3, 0));
+}
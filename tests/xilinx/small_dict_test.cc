@@ -0,0 +1,292 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+// The slots of a small_dict as a plain vector, each empty (-1) or holding a key, with the values in a std::map. A new
+// key takes the first empty slot, and iteration is in slot order.
+struct Reference
+{
+    std::vector<int> slots;
+    std::map<int, int> values;
+
+    void set(int key, int value)
+    {
+        if (!values.count(key)) {
+            auto fnd = std::find(slots.begin(), slots.end(), -1);
+            if (fnd != slots.end())
+                *fnd = key;
+            else
+                slots.push_back(key);
+        }
+        values[key] = value;
+    }
+
+    size_t erase(int key)
+    {
+        auto fnd = std::find(slots.begin(), slots.end(), key);
+        if (fnd != slots.end())
+            *fnd = -1;
+        return values.erase(key);
+    }
+};
+
+template <int N> void check_same(const small_dict<int, int, N> &d, const Reference &ref)
+{
+    ASSERT_EQ(d.size(), ref.values.size());
+    ASSERT_EQ(d.empty(), ref.values.empty());
+    for (auto &entry : ref.values) {
+        ASSERT_EQ(d.count(entry.first), size_t(1)) << entry.first;
+        ASSERT_EQ(d.at(entry.first), entry.second) << entry.first;
+        ASSERT_EQ(d.find(entry.first)->second, entry.second) << entry.first;
+    }
+    auto it = d.begin();
+    for (int key : ref.slots) {
+        if (key == -1)
+            continue;
+        ASSERT_TRUE(it != d.end());
+        ASSERT_EQ(it->first, key);
+        ++it;
+    }
+    ASSERT_TRUE(it == d.end());
+}
+
+template <int N> void random_operations(unsigned seed, int keys)
+{
+    small_dict<int, int, N> d;
+    Reference ref;
+    std::mt19937 rng(seed);
+    for (int i = 0; i < 5000; i++) {
+        int key = int(rng() % keys);
+        switch (rng() % 10) {
+        case 0:
+        case 1:
+        case 2:
+            d[key] = i;
+            ref.set(key, i);
+            break;
+        case 3: {
+            auto ins = d.emplace(key, i);
+            ASSERT_EQ(ins.second, ref.values.count(key) == 0);
+            if (ins.second)
+                ref.set(key, i);
+            ASSERT_EQ(ins.first->second, ref.values.at(key));
+            break;
+        }
+        case 4:
+        case 5:
+            ASSERT_EQ(d.erase(key), ref.erase(key));
+            break;
+        case 6:
+            ASSERT_EQ(d.count(key), ref.values.count(key));
+            break;
+        default:
+            // Grow past the index threshold and shrink back, now and then
+            if (rng() % 200 == 0) {
+                d.clear();
+                ref = Reference();
+            }
+            break;
+        }
+        check_same(d, ref);
+    }
+}
+
+// Counts the values alive, to catch entries leaked or destroyed twice
+struct Counted
+{
+    static int alive;
+    int value;
+    Counted(int value = 0) : value(value) { alive++; }
+    Counted(const Counted &other) : value(other.value) { alive++; }
+    Counted(Counted &&other) : value(other.value) { alive++; }
+    Counted &operator=(const Counted &other) = default;
+    ~Counted() { alive--; }
+};
+int Counted::alive = 0;
+
+} // namespace
+
+TEST(SmallDictTest, randomOperations)
+{
+    // Few keys stay inline and below the index threshold; more spill into blocks and get an index
+    random_operations<8>(1, 6);
+    random_operations<8>(2, 40);
+    random_operations<2>(3, 12);
+    random_operations<4>(4, 100);
+}
+
+TEST(SmallDictTest, slotReuse)
+{
+    // The first free slot is reused, so a new key takes the place of an erased one
+    small_dict<int, int, 4> d;
+    Reference ref;
+    for (int i = 0; i < 10; i++) {
+        d[i] = i;
+        ref.set(i, i);
+    }
+    for (int key : {1, 6, 8}) {
+        d.erase(key);
+        ref.erase(key);
+    }
+    for (int key : {20, 21, 22, 23}) {
+        d[key] = key;
+        ref.set(key, key);
+        check_same(d, ref);
+    }
+    ASSERT_EQ(std::next(d.begin())->first, 20);
+}
+
+TEST(SmallDictTest, hashIndex)
+{
+    // Lookups give the same answers on both sides of the switch to the hash index, which stays once built
+    small_dict<int, int> d;
+    Reference ref;
+    for (int i = 0; i < 40; i++) {
+        d[i * 3] = i;
+        ref.set(i * 3, i);
+        check_same(d, ref);
+        for (int key = 0; key < 120; key++)
+            ASSERT_EQ(d.count(key), ref.values.count(key)) << key;
+    }
+    for (int i = 0; i < 40; i += 2) {
+        ASSERT_EQ(d.erase(i * 3), size_t(1));
+        ref.erase(i * 3);
+        check_same(d, ref);
+    }
+    for (int i = 0; i < 40; i++) {
+        ASSERT_EQ(d.erase(i * 3), ref.erase(i * 3));
+        check_same(d, ref);
+    }
+    ASSERT_TRUE(d.find(3) == d.end());
+    ASSERT_THROW(d.at(3), std::out_of_range);
+    d[3] = 1;
+    ASSERT_EQ(d.at(3), 1);
+}
+
+TEST(SmallDictTest, referencesStable)
+{
+    // Entries never move when others are added or erased, inline or in blocks
+    small_dict<int, std::string, 4> d;
+    std::vector<std::string *> refs;
+    for (int i = 0; i < 50; i++)
+        refs.push_back(&(d[i] = std::to_string(i)));
+    for (int i = 0; i < 50; i += 2)
+        d.erase(i);
+    for (int i = 50; i < 200; i++)
+        d[i] = std::to_string(i);
+    for (int i = 1; i < 50; i += 2) {
+        ASSERT_EQ(refs[i], &d.at(i));
+        ASSERT_EQ(*refs[i], std::to_string(i));
+    }
+}
+
+TEST(SmallDictTest, moveSteals)
+{
+    // Moving takes the entries, blocks and index, and leaves the source empty and usable
+    for (int count : {3, 8, 12, 30}) {
+        small_dict<int, Counted, 8> a;
+        for (int i = 0; i < count; i++)
+            a.emplace(i, i * 10);
+        a.erase(1);
+        // Block slots don't move, so references to them stay valid
+        const Counted *in_block = (count > 8) ? &a.at(count - 1) : nullptr;
+        small_dict<int, Counted, 8> b(std::move(a));
+        ASSERT_TRUE(a.empty());
+        ASSERT_TRUE(a.begin() == a.end());
+        ASSERT_EQ(int(b.size()), count - 1);
+        ASSERT_EQ(Counted::alive, count - 1);
+        for (int i = 0; i < count; i++) {
+            ASSERT_EQ(b.count(i), size_t(i != 1)) << i;
+            if (i != 1) {
+                ASSERT_EQ(b.at(i).value, i * 10);
+            }
+        }
+        if (in_block != nullptr) {
+            ASSERT_EQ(in_block, &b.at(count - 1));
+        }
+        a.emplace(100, 1000);
+        ASSERT_EQ(a.size(), size_t(1));
+        ASSERT_EQ(a.at(100).value, 1000);
+        // Move assignment drops what was there
+        b = std::move(a);
+        ASSERT_EQ(b.size(), size_t(1));
+        ASSERT_EQ(b.at(100).value, 1000);
+        ASSERT_EQ(Counted::alive, 1);
+    }
+    ASSERT_EQ(Counted::alive, 0);
+}
+
+TEST(SmallDictTest, copySwapInit)
+{
+    {
+        small_dict<int, Counted, 4> a{{1, Counted(10)}, {2, Counted(20)}, {3, Counted(30)}};
+        ASSERT_EQ(a.size(), size_t(3));
+        ASSERT_EQ(a.at(2).value, 20);
+        for (int i = 4; i < 30; i++)
+            a.emplace(i, i * 10);
+        small_dict<int, Counted, 4> b(a), c;
+        ASSERT_EQ(Counted::alive, 2 * 29);
+        c = b;
+        c.erase(5);
+        ASSERT_EQ(b.size(), size_t(29));
+        ASSERT_EQ(c.size(), size_t(28));
+        for (int i = 1; i < 30; i++)
+            ASSERT_EQ(b.at(i).value, a.at(i).value);
+        small_dict<int, Counted, 4> d{{7, Counted(70)}};
+        d.swap(c);
+        ASSERT_EQ(d.size(), size_t(28));
+        ASSERT_EQ(c.size(), size_t(1));
+        ASSERT_EQ(c.at(7).value, 70);
+        ASSERT_EQ(d.count(5), size_t(0));
+        ASSERT_EQ(d.at(6).value, 60);
+    }
+    ASSERT_EQ(Counted::alive, 0);
+}
+
+TEST(SmallDictTest, eraseWhileIterating)
+{
+    small_dict<int, int, 4> d;
+    Reference ref;
+    for (int i = 0; i < 30; i++) {
+        d[i] = i;
+        ref.set(i, i);
+    }
+    for (auto it = d.begin(); it != d.end();) {
+        if (it->first % 3 == 0) {
+            ref.erase(it->first);
+            it = d.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    check_same(d, ref);
+}
@@ -0,0 +1,227 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "thread_pool.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+// Sum of 0 to n - 1, split into tasks that start and wait for their own subtasks down to a depth
+long nested_sum(ThreadPool &pool, long begin, long end, int depth)
+{
+    if (depth == 0 || end - begin < 2) {
+        long sum = 0;
+        for (long i = begin; i < end; i++)
+            sum += i;
+        return sum;
+    }
+    long mid = (begin + end) / 2, lo = 0, hi = 0;
+    ThreadPool::TaskGroup group(pool);
+    group.run([&]() { lo = nested_sum(pool, begin, mid, depth - 1); });
+    group.run([&]() { hi = nested_sum(pool, mid, end, depth - 1); });
+    group.wait();
+    return lo + hi;
+}
+
+} // namespace
+
+TEST(ThreadPoolTest, parallelForCoverage)
+{
+    // Every item is run exactly once, whatever the pool size, grain and thread limit
+    for (int size : {1, 2, 4, 7}) {
+        ThreadPool pool(size);
+        ASSERT_EQ(pool.size(), size);
+        for (size_t count : {0, 1, 5, 64, 1000}) {
+            for (size_t grain : {1, 3, 100}) {
+                for (int max_threads : {0, 1, 3}) {
+                    std::vector<std::atomic<int>> calls(count);
+                    for (auto &c : calls)
+                        c = 0;
+                    pool.parallel_for(count, grain, [&](size_t i) { calls.at(i)++; }, max_threads);
+                    for (size_t i = 0; i < count; i++)
+                        ASSERT_EQ(calls[i].load(), 1) << size << " " << count << " " << grain << " " << i;
+                }
+            }
+        }
+    }
+}
+
+TEST(ThreadPoolTest, threadsFor)
+{
+    ThreadPool pool(4);
+    ASSERT_EQ(pool.threads_for(0, 1), 1);
+    ASSERT_EQ(pool.threads_for(3, 1), 3);
+    ASSERT_EQ(pool.threads_for(100, 1), 4);
+    ASSERT_EQ(pool.threads_for(100, 40), 2);
+    ASSERT_EQ(pool.threads_for(100, 1000), 1);
+    ASSERT_EQ(pool.threads_for(100, 0), 4);
+    ASSERT_EQ(pool.threads_for(100, 1, 2), 2);
+    ASSERT_EQ(pool.threads_for(100, 1, 16), 4);
+}
+
+TEST(ThreadPoolTest, parallelForThreadLimit)
+{
+    // No more threads run items at once than threads_for allows
+    ThreadPool pool(6);
+    for (int max_threads : {1, 2, 4, 0}) {
+        std::atomic<int> active(0), peak(0);
+        std::mutex mutex;
+        std::set<std::thread::id> ids;
+        pool.parallel_for(200, 1, [&](size_t) {
+            int now = ++active;
+            int prev = peak.load();
+            while (now > prev && !peak.compare_exchange_weak(prev, now)) {
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ids.insert(std::this_thread::get_id());
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            --active;
+        }, max_threads);
+        ASSERT_LE(peak.load(), pool.threads_for(200, 1, max_threads)) << max_threads;
+        ASSERT_LE(int(ids.size()), pool.threads_for(200, 1, max_threads)) << max_threads;
+    }
+}
+
+TEST(ThreadPoolTest, nestedTaskGroups)
+{
+    // Tasks waiting for their own tasks run queued ones meanwhile, so deep nesting doesn't deadlock even with fewer
+    // threads than waiting tasks
+    for (int size : {1, 2, 4}) {
+        ThreadPool pool(size);
+        ASSERT_EQ(nested_sum(pool, 0, 100000, 10), 100000L * 99999L / 2) << size;
+    }
+}
+
+TEST(ThreadPoolTest, nestedParallelFor)
+{
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> calls(50 * 40);
+    for (auto &c : calls)
+        c = 0;
+    pool.parallel_for(50, 1, [&](size_t i) {
+        pool.parallel_for(40, 1, [&](size_t j) { calls.at(i * 40 + j)++; });
+    });
+    for (auto &c : calls)
+        ASSERT_EQ(c.load(), 1);
+}
+
+TEST(ThreadPoolTest, taskGroupException)
+{
+    // wait() passes on the exception of a task, but only after all the tasks of the group have finished
+    ThreadPool pool(4);
+    std::atomic<int> finished(0);
+    ThreadPool::TaskGroup group(pool);
+    for (int i = 0; i < 20; i++) {
+        group.run([&, i]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            if (i == 5)
+                throw std::runtime_error("task 5");
+            ++finished;
+        });
+    }
+    try {
+        group.wait();
+        FAIL() << "expected an exception";
+    } catch (const std::runtime_error &e) {
+        ASSERT_STREQ(e.what(), "task 5");
+    }
+    ASSERT_EQ(finished.load(), 19);
+    // The error is only passed on once, and the group can be used again
+    group.wait();
+    group.run([&]() { ++finished; });
+    group.wait();
+    ASSERT_EQ(finished.load(), 20);
+}
+
+TEST(ThreadPoolTest, nestedException)
+{
+    // An exception from a nested group is passed up through the task that waits for it
+    ThreadPool pool(3);
+    ThreadPool::TaskGroup outer(pool);
+    outer.run([&]() {
+        ThreadPool::TaskGroup inner(pool);
+        inner.run([]() { throw std::logic_error("inner"); });
+        inner.wait();
+    });
+    ASSERT_THROW(outer.wait(), std::logic_error);
+}
+
+TEST(ThreadPoolTest, parallelForException)
+{
+    // An exception stops further items being handed out, and is passed on once the running items are done
+    for (int size : {1, 4}) {
+        ThreadPool pool(size);
+        std::atomic<int> calls(0);
+        ASSERT_THROW(pool.parallel_for(10000, 1, [&](size_t i) {
+            ++calls;
+            if (i == 10)
+                throw std::runtime_error("item 10");
+        }), std::runtime_error);
+        ASSERT_LT(calls.load(), 10000);
+        // The pool still works afterwards
+        std::atomic<int> after(0);
+        pool.parallel_for(100, 1, [&](size_t) { ++after; });
+        ASSERT_EQ(after.load(), 100);
+    }
+}
+
+TEST(ThreadPoolTest, taskGroupDestructorWaits)
+{
+    // A group going out of scope without wait() still finishes its tasks, and drops their errors
+    ThreadPool pool(4);
+    std::atomic<int> finished(0);
+    {
+        ThreadPool::TaskGroup group(pool);
+        for (int i = 0; i < 50; i++) {
+            group.run([&, i]() {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                ++finished;
+                if (i == 0)
+                    throw std::runtime_error("dropped");
+            });
+        }
+    }
+    ASSERT_EQ(finished.load(), 50);
+}
+
+TEST(ThreadPoolTest, outsideThreads)
+{
+    // Several threads outside the pool may use it at once, sharing its queue for outside tasks
+    ThreadPool pool(4);
+    std::vector<long> sums(4, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&, t]() { sums[t] = nested_sum(pool, 0, 20000 * (t + 1), 6); });
+    for (auto &th : threads)
+        th.join();
+    for (int t = 0; t < 4; t++) {
+        long n = 20000 * (t + 1);
+        ASSERT_EQ(sums[t], n * (n - 1) / 2);
+    }
+}
@@ -0,0 +1,190 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+#include "router2_wavefront.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+// Problems of random graphs, each vertex with a few fan-in edges from the same problem. Costs are whole numbers, so
+// that the sums along different paths of equal cost are exactly equal whatever order they are found in.
+WavefrontGraph random_graph(int problems, int max_vertices, unsigned seed)
+{
+    WavefrontGraph g;
+    std::mt19937 rng(seed);
+    for (int p = 0; p < problems; p++) {
+        int begin = g.vertex_count();
+        int n = 1 + rng() % max_vertices;
+        for (int i = 0; i < n; i++) {
+            int fanin = (i == 0) ? 0 : rng() % 4;
+            for (int e = 0; e < fanin; e++)
+                g.add_edge(begin + rng() % n, float(1 + rng() % 10));
+            g.end_vertex();
+        }
+        g.end_problem(begin + rng() % n);
+    }
+    return g;
+}
+
+// Distances by Dijkstra's algorithm over the fan-out of each vertex
+std::vector<float> reference_dist(const WavefrontGraph &g)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<std::vector<std::pair<int, float>>> fanout(g.vertex_count());
+    for (int v = 0; v < g.vertex_count(); v++)
+        for (int e = g.in_begin[v]; e < g.in_begin[v + 1]; e++)
+            fanout.at(g.in_src[e]).emplace_back(v, g.in_cost[e]);
+    std::vector<float> dist(g.vertex_count(), inf);
+    typedef std::pair<float, int> QueuedVertex;
+    std::priority_queue<QueuedVertex, std::vector<QueuedVertex>, std::greater<QueuedVertex>> queue;
+    for (int src : g.problem_source) {
+        dist[src] = 0;
+        queue.emplace(0, src);
+    }
+    while (!queue.empty()) {
+        QueuedVertex top = queue.top();
+        queue.pop();
+        if (top.first > dist[top.second])
+            continue;
+        for (auto &out : fanout[top.second]) {
+            float d = top.first + out.second;
+            if (d < dist[out.first]) {
+                dist[out.first] = d;
+                queue.emplace(d, out.first);
+            }
+        }
+    }
+    return dist;
+}
+
+// The distances must be those of the reference, and each reached vertex other than a source must be reached through
+// a fan-in edge that accounts for its distance
+void check_results(const WavefrontGraph &g, const std::vector<float> &expected)
+{
+    ASSERT_EQ(g.dist, expected);
+    ASSERT_EQ(int(g.pred.size()), g.vertex_count());
+    std::vector<bool> is_source(g.vertex_count(), false);
+    for (int src : g.problem_source)
+        is_source.at(src) = true;
+    for (int v = 0; v < g.vertex_count(); v++) {
+        int e = g.pred[v];
+        if (is_source[v] || g.dist[v] == std::numeric_limits<float>::infinity()) {
+            ASSERT_EQ(e, -1) << v;
+            continue;
+        }
+        ASSERT_GE(e, g.in_begin[v]) << v;
+        ASSERT_LT(e, g.in_begin[v + 1]) << v;
+        ASSERT_EQ(g.dist[v], g.dist[g.in_src[e]] + g.in_cost[e]) << v;
+    }
+}
+
+// The OpenCL backend, or null if there is no device. Without a device the test passes, unless
+// NEXTPNR_REQUIRE_OPENCL is set, as in the OpenCL CI build, where that is a failure.
+std::unique_ptr<WavefrontBackend> device_backend()
+{
+    std::string error;
+    auto backend = WavefrontBackend::create(nullptr, true, error);
+    if (backend == nullptr) {
+        if (std::getenv("NEXTPNR_REQUIRE_OPENCL") != nullptr)
+            ADD_FAILURE() << "no OpenCL device: " << error;
+        else
+            std::printf("Skipping the device path: %s\n", error.c_str());
+    }
+    return backend;
+}
+
+} // namespace
+
+TEST(WavefrontTest, cpuMatchesDijkstra)
+{
+    std::string error;
+    auto backend = WavefrontBackend::create(nullptr, false, error);
+    ASSERT_TRUE(backend != nullptr);
+    for (unsigned seed = 1; seed <= 20; seed++) {
+        WavefrontGraph g = random_graph(10, 40, seed);
+        ASSERT_TRUE(backend->solve(g));
+        check_results(g, reference_dist(g));
+        ASSERT_GE(g.rounds, 1);
+    }
+}
+
+TEST(WavefrontTest, cpuChain)
+{
+    // A chain of n vertices takes n - 1 rounds to reach the end, and one more to see that nothing changes
+    WavefrontGraph g;
+    const int n = 10;
+    g.end_vertex();
+    for (int i = 1; i < n; i++) {
+        g.add_edge(i - 1, 2);
+        g.end_vertex();
+    }
+    g.end_problem(0);
+    std::string error;
+    auto backend = WavefrontBackend::create(nullptr, false, error);
+    ASSERT_TRUE(backend->solve(g));
+    check_results(g, reference_dist(g));
+    ASSERT_EQ(g.dist.back(), 2 * (n - 1));
+    ASSERT_EQ(g.rounds, n);
+}
+
+TEST(WavefrontTest, cpuResolve)
+{
+    // Solving a graph again after clearing it must not keep anything of the previous batch
+    std::string error;
+    auto backend = WavefrontBackend::create(nullptr, false, error);
+    WavefrontGraph g = random_graph(8, 30, 3);
+    ASSERT_TRUE(backend->solve(g));
+    g.clear();
+    ASSERT_EQ(g.vertex_count(), 0);
+    ASSERT_EQ(g.problem_count(), 0);
+    WavefrontGraph h = random_graph(5, 20, 4);
+    g.problem_begin = h.problem_begin;
+    g.problem_source = h.problem_source;
+    g.in_begin = h.in_begin;
+    g.in_src = h.in_src;
+    g.in_cost = h.in_cost;
+    ASSERT_TRUE(backend->solve(g));
+    check_results(g, reference_dist(g));
+}
+
+TEST(WavefrontTest, deviceMatchesCpu)
+{
+    // The device runs the same rounds as the CPU backend, so it must find the same distances and edges
+    auto device = device_backend();
+    if (device == nullptr)
+        return;
+    std::string error;
+    auto cpu = WavefrontBackend::create(nullptr, false, error);
+    for (unsigned seed = 1; seed <= 20; seed++) {
+        WavefrontGraph on_device = random_graph(50, 60, seed), on_cpu = on_device;
+        ASSERT_TRUE(device->solve(on_device)) << device->name();
+        ASSERT_TRUE(cpu->solve(on_cpu));
+        check_results(on_device, reference_dist(on_device));
+        ASSERT_EQ(on_device.pred, on_cpu.pred);
+        ASSERT_EQ(on_device.rounds, on_cpu.rounds);
+    }
+}
@@ -21,15 +21,19 @@
 #include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/reversed.hpp>
+#include <chrono>
 #include <cmath>
 #include <cstring>
+#include <functional>
 #include <queue>
 #include "log.h"
+#include "mem_account.h"
 #include "nextpnr.h"
 #include "placer1.h"
 #include "placer_heap.h"
 #include "router1.h"
 #include "router2.h"
+#include "thread_pool.h"
 #include "timing.h"
 #include "util.h"
 
@@ -53,11 +57,12 @@ static std::pair<std::string, std::string> split_identifier_name_dot(const std::
 
 void IdString::initialize_arch(const BaseCtx *ctx)
 {
-#define X(t) initialize_add(ctx, #t, ID_##t);
-
+    static const char *const constids[] = {
+#define X(t) #t,
 #include "constids.inc"
-
 #undef X
+    };
+    initialize_add_static(ctx, std::vector<const char *>(std::begin(constids), std::end(constids)), 1);
 }
 
 // -----------------------------------------------------------------------
@@ -67,19 +72,26 @@ static const ChipInfoPOD *get_chip_info(const RelPtr<ChipInfoPOD> *ptr) { return
 Arch::Arch(ArchArgs args) : args(args)
 {
     try {
-        blob_file.open(args.chipdb);
-        if (args.chipdb.empty() || !blob_file.is_open())
+        if (args.chipdb.empty() || !blob_file.open(args.chipdb, args.chipdb_load))
             log_error("Unable to read chipdb %s\n", args.chipdb.c_str());
         const char *blob = reinterpret_cast<const char *>(blob_file.data());
         chip_info = get_chip_info(reinterpret_cast<const RelPtr<ChipInfoPOD> *>(blob));
     } catch (...) {
         log_error("Unable to read chipdb %s\n", args.chipdb.c_str());
     }
-
-    for (int i = 0; i < chip_info->extra_constids->bba_id_count; i++) {
-        // log_info("%s %d\n", chip_info->extra_constids->bba_ids[i].get(), int(idstring_idx_to_str->size()));
-        IdString::initialize_add(this, chip_info->extra_constids->bba_ids[i].get(),
-                                 i + chip_info->extra_constids->known_id_count);
+    if (chip_info->version < 1 || chip_info->version > 3)
+        log_error("Chipdb %s has unsupported version %d\n", args.chipdb.c_str(), chip_info->version);
+
+    // The chipdb strings are used in place, rather than copied into the IdString database
+    std::vector<const char *> bba_ids(chip_info->extra_constids->bba_id_count);
+    for (int i = 0; i < chip_info->extra_constids->bba_id_count; i++)
+        bba_ids[i] = chip_info->extra_constids->bba_ids[i].get();
+    IdString::initialize_add_static(this, std::move(bba_ids), chip_info->extra_constids->known_id_count);
+
+    if (!args.chipdb_cache.empty()) {
+        std::string key = std::string(chip_info->name.get()) + ";" + chip_info->generator.get() + ";" +
+                          chipdb_content_key(blob_file.data(), blob_file.size());
+        chipdb_cache.open(args.chipdb_cache, key);
     }
 
     if (std::string(chip_info->name.get()).find("xc7") == 0)
@@ -88,10 +100,39 @@ Arch::Arch(ArchArgs args) : args(args)
         xc7 = false;
 
     tileStatus.resize(chip_info->num_tiles);
+    tile_bel_start.resize(chip_info->num_tiles + 1);
+    tile_site_start.resize(chip_info->num_tiles + 1);
+    int num_bels = 0, num_sites = 0;
     for (int i = 0; i < chip_info->num_tiles; i++) {
-        tileStatus[i].boundcells.resize(chip_info->tile_types[chip_info->tile_insts[i].type].num_bels);
-        tileStatus[i].sitevariant.resize(chip_info->tile_insts[i].num_sites);
+        tile_bel_start[i] = num_bels;
+        tile_site_start[i] = num_sites;
+        num_bels += chip_info->tile_types[chip_info->tile_insts[i].type].num_bels;
+        num_sites += chip_info->tile_insts[i].num_sites;
     }
+    tile_bel_start[chip_info->num_tiles] = num_bels;
+    tile_site_start[chip_info->num_tiles] = num_sites;
+    bel_to_cell.resize(num_bels, nullptr);
+    site_variant.resize(num_sites, 0);
+
+    setup_wire_index();
+    setup_bel_pin_index();
+    setup_bel_type_index();
+    setup_intent_info();
+    setup_delay_table();
+    setupCellInfoIds();
+    setup_clock_regions();
+    setup_slrs();
+
+    tile_type_names.resize(chip_info->num_tiletypes);
+    tile_type_names_once.reset(new std::once_flag[chip_info->num_tiletypes]);
+    gnd_glbl = id("PSEUDO_GND_WIRE_GLBL");
+    gnd_row = id("PSEUDO_GND_WIRE_ROW");
+    vcc_glbl = id("PSEUDO_VCC_WIRE_GLBL");
+    vcc_row = id("PSEUDO_VCC_WIRE_ROW");
+
+    tile_wire_bindings.resize(chip_info->num_tiles);
+    tile_pip_bindings.resize(chip_info->num_tiles);
+    node_wire_bindings.resize((chip_info->num_nodes >> node_binding_page_bits) + 1);
 
     if (xc7)
         setup_pip_blacklist();
@@ -109,31 +150,79 @@ IdString Arch::archArgsToId(ArchArgs args) const { return IdString(); }
 
 void Arch::setup_byname() const
 {
-    if (tile_by_name.empty()) {
+    // Version 3 chipdbs are searched directly
+    if (chip_info->version >= 3)
+        return;
+    std::call_once(byname_once, [&]() {
         for (int i = 0; i < chip_info->num_tiles; i++) {
-            tile_by_name[chip_info->tile_insts[i].name.get()] = i;
+            auto &tile = chip_info->tile_insts[i];
+            tile_by_name[tile.name.get()] = i;
+            for (int j = 0; j < tile.num_sites; j++) {
+                auto &site = tile.site_insts[j];
+                site_by_name[site.name.get()] = std::make_pair(i, j);
+                if (site.pin[0] != '\0' && site.pin[0] != '.')
+                    pin_to_site[site.pin.get()] = site.name.get();
+            }
         }
+    });
+}
+
+int Arch::findTileByName(const std::string &name) const
+{
+    if (chip_info->version >= 3) {
+        const int32_t *begin = chip_info->tiles_by_name.get(), *end = begin + chip_info->num_tiles;
+        auto found = std::lower_bound(begin, end, name, [&](int32_t tile, const std::string &key) {
+            return std::strcmp(chip_info->tile_insts[tile].name.get(), key.c_str()) < 0;
+        });
+        return (found != end && name == chip_info->tile_insts[*found].name.get()) ? *found : -1;
     }
+    setup_byname();
+    auto found = tile_by_name.find(name);
+    return found != tile_by_name.end() ? found->second : -1;
+}
 
-    if (site_by_name.empty()) {
-        for (int i = 0; i < chip_info->num_tiles; i++) {
-            auto &tile = chip_info->tile_insts[i];
-            for (int j = 0; j < tile.num_sites; j++)
-                site_by_name[tile.site_insts[j].name.get()] = std::make_pair(i, j);
-        }
+namespace {
+// Binary search of a name index of sites, sorted by the site name or package pin given by get_name
+template <typename Tf>
+const SiteRefPOD *find_site_ref(const ChipInfoPOD *chip, const SiteRefPOD *begin, int count, const std::string &key,
+                                Tf get_name)
+{
+    const SiteRefPOD *end = begin + count;
+    auto found = std::lower_bound(begin, end, key, [&](const SiteRefPOD &ref, const std::string &k) {
+        return std::strcmp(get_name(chip->tile_insts[ref.tile].site_insts[ref.site]), k.c_str()) < 0;
+    });
+    if (found == end || key != get_name(chip->tile_insts[found->tile].site_insts[found->site]))
+        return nullptr;
+    return found;
+}
+} // namespace
+
+bool Arch::findSiteByName(const std::string &name, int &tile, int &site) const
+{
+    if (chip_info->version >= 3) {
+        const SiteRefPOD *found = find_site_ref(chip_info, chip_info->sites_by_name.get(), chip_info->num_sites, name,
+                                                [](const SiteInstInfoPOD &si) { return si.name.get(); });
+        if (found == nullptr)
+            return false;
+        tile = found->tile;
+        site = found->site;
+        return true;
     }
+    setup_byname();
+    auto found = site_by_name.find(name);
+    if (found == site_by_name.end())
+        return false;
+    std::tie(tile, site) = found->second;
+    return true;
 }
 
 BelId Arch::getBelByName(IdString name) const
 {
     BelId ret;
 
-    setup_byname();
-
     auto split = split_identifier_name(name.str(this));
-    if (site_by_name.count(split.first)) {
-        int tile, site;
-        std::tie(tile, site) = site_by_name.at(split.first);
+    int tile, site;
+    if (findSiteByName(split.first, tile, site)) {
         auto &tile_info = chip_info->tile_types[chip_info->tile_insts[tile].type];
         IdString belname = id(split.second);
         for (int i = 0; i < tile_info.num_bels; i++) {
@@ -144,7 +233,9 @@ BelId Arch::getBelByName(IdString name) const
             }
         }
     } else {
-        int tile = tile_by_name.at(split.first);
+        tile = findTileByName(split.first);
+        if (tile == -1)
+            return ret;
         auto &tile_info = chip_info->tile_types[chip_info->tile_insts[tile].type];
         IdString belname = id(split.second);
         for (int i = 0; i < tile_info.num_bels; i++) {
@@ -176,82 +267,475 @@ BelRange Arch::getBelsByTile(int x, int y) const
     return br;
 }
 
-WireId Arch::getBelPinWire(BelId bel, IdString pin) const
+void Arch::setup_bel_type_index()
 {
-    WireId ret;
+    auto &idx = bel_type_index;
+    idx.chip = chip_info;
+    for (int tt = 0; tt < chip_info->num_tiletypes; tt++) {
+        auto &td = chip_info->tile_types[tt];
+        for (int i = 0; i < td.num_bels; i++)
+            idx.type_idx.emplace(IdString(td.bel_data[i].type), int32_t(idx.type_idx.size()));
+    }
+    idx.num_types = int32_t(idx.type_idx.size());
+
+    // Bels of each tile type grouped by type, and which types each tile type has
+    std::vector<std::vector<int32_t>> tile_type_types(chip_info->num_tiletypes);
+    std::vector<std::vector<int32_t>> type_bels(idx.num_types);
+    idx.bel_start.reserve(size_t(chip_info->num_tiletypes) * idx.num_types + 1);
+    for (int tt = 0; tt < chip_info->num_tiletypes; tt++) {
+        auto &td = chip_info->tile_types[tt];
+        for (auto &bels : type_bels)
+            bels.clear();
+        for (int i = 0; i < td.num_bels; i++)
+            type_bels.at(idx.type_idx.at(IdString(td.bel_data[i].type))).push_back(i);
+        for (int32_t t = 0; t < idx.num_types; t++) {
+            idx.bel_start.push_back(int32_t(idx.bel_index.size()));
+            if (type_bels.at(t).empty())
+                continue;
+            tile_type_types.at(tt).push_back(t);
+            idx.bel_index.insert(idx.bel_index.end(), type_bels.at(t).begin(), type_bels.at(t).end());
+        }
+    }
+    idx.bel_start.push_back(int32_t(idx.bel_index.size()));
+
+    // Tiles with bels of each type, counted first so that they can be placed directly
+    idx.tile_start.assign(idx.num_types + 1, 0);
+    for (int tile = 0; tile < chip_info->num_tiles; tile++)
+        for (int32_t t : tile_type_types.at(chip_info->tile_insts[tile].type))
+            idx.tile_start.at(t + 1)++;
+    for (int32_t t = 0; t < idx.num_types; t++)
+        idx.tile_start.at(t + 1) += idx.tile_start.at(t);
+    idx.tiles.resize(idx.tile_start.back());
+    std::vector<int32_t> cursor(idx.tile_start.begin(), idx.tile_start.end() - 1);
+    for (int tile = 0; tile < chip_info->num_tiles; tile++)
+        for (int32_t t : tile_type_types.at(chip_info->tile_insts[tile].type))
+            idx.tiles.at(cursor.at(t)++) = tile;
+}
 
-    NPNR_ASSERT(bel != BelId());
+BelTypeRange Arch::getBelsByType(IdString type) const
+{
+    BelTypeRange range;
+    range.b.idx = range.e.idx = &bel_type_index;
+    auto fnd = bel_type_index.type_idx.find(type);
+    if (fnd == bel_type_index.type_idx.end()) {
+        range.b.type = range.e.type = 0;
+        range.b.cursor_tile = range.e.cursor_tile = 0;
+        return range;
+    }
+    range.b.type = range.e.type = fnd->second;
+    range.b.cursor_tile = bel_type_index.tile_start.at(fnd->second);
+    range.b.enter_tile();
+    range.e.cursor_tile = bel_type_index.tile_start.at(fnd->second + 1);
+    range.e.enter_tile();
+    return range;
+}
 
-    int num_bel_wires = locInfo(bel).bel_data[bel.index].num_bel_wires;
-    const BelWirePOD *bel_wires = locInfo(bel).bel_data[bel.index].bel_wires.get();
-    for (int i = 0; i < num_bel_wires; i++)
-        if (bel_wires[i].port == pin.index) {
-#if 0
-            WireId tmp;
-            tmp.tile = bel.tile;
-            tmp.index = bel_wires[i].wire_index;
-            log_info("%s\n", getWireName(tmp).c_str(this));
-#endif
-            return canonicalWireId(chip_info, bel.tile, bel_wires[i].wire_index);
+namespace {
+// Bels with at most this many pins are searched linearly
+const int bel_pin_index_threshold = 8;
+} // namespace
+
+void Arch::setup_bel_pin_index()
+{
+    tile_type_bel_pins.resize(chip_info->num_tiletypes);
+    for (int type = 0; type < chip_info->num_tiletypes; type++) {
+        auto &td = chip_info->tile_types[type];
+        auto &idx = tile_type_bel_pins.at(type);
+        idx.start.reserve(td.num_bels + 1);
+        for (int i = 0; i < td.num_bels; i++) {
+            auto &bd = td.bel_data[i];
+            idx.start.push_back(int32_t(idx.pins.size()));
+            if (bd.num_bel_wires <= bel_pin_index_threshold)
+                continue;
+            for (int j = 0; j < bd.num_bel_wires; j++)
+                idx.pins.emplace_back(int32_t(bd.bel_wires[j].port), j);
+            // Stable, so that of duplicate ports the first is found as by a linear search
+            std::stable_sort(idx.pins.begin() + idx.start.back(), idx.pins.end(),
+                             [](const std::pair<int32_t, int32_t> &a, const std::pair<int32_t, int32_t> &b) {
+                                 return a.first < b.first;
+                             });
         }
+        idx.start.push_back(int32_t(idx.pins.size()));
+    }
+}
 
-    return ret;
+int Arch::findBelPin(BelId bel, IdString pin) const
+{
+    auto &bd = locInfo(bel).bel_data[bel.index];
+    if (bd.num_bel_wires <= bel_pin_index_threshold) {
+        for (int i = 0; i < bd.num_bel_wires; i++)
+            if (bd.bel_wires[i].port == pin.index)
+                return i;
+        return -1;
+    }
+    auto &idx = tile_type_bel_pins.at(chip_info->tile_insts[bel.tile].type);
+    auto b = idx.pins.begin() + idx.start.at(bel.index), e = idx.pins.begin() + idx.start.at(bel.index + 1);
+    auto found = std::lower_bound(b, e, std::make_pair(pin.index, -1));
+    if (found == e || found->first != pin.index)
+        return -1;
+    return found->second;
 }
 
-PortType Arch::getBelPinType(BelId bel, IdString pin) const
+WireId Arch::getBelPinWire(BelId bel, IdString pin) const
 {
     NPNR_ASSERT(bel != BelId());
+    int i = findBelPin(bel, pin);
+    if (i == -1)
+        return WireId();
+    return canonicalWireId(chip_info, bel.tile, locInfo(bel).bel_data[bel.index].bel_wires[i].wire_index);
+}
 
-    int num_bel_wires = locInfo(bel).bel_data[bel.index].num_bel_wires;
-    const BelWirePOD *bel_wires = locInfo(bel).bel_data[bel.index].bel_wires.get();
+PortType Arch::getBelPinType(BelId bel, IdString pin) const
+{
+    NPNR_ASSERT(bel != BelId());
+    int i = findBelPin(bel, pin);
+    if (i == -1)
+        return PORT_INOUT;
+    return PortType(locInfo(bel).bel_data[bel.index].bel_wires[i].type);
+}
 
-    for (int i = 0; i < num_bel_wires; i++)
-        if (bel_wires[i].port == pin.index)
-            return PortType(bel_wires[i].type);
+// -----------------------------------------------------------------------
 
-    return PORT_INOUT;
+const Arch::TileTypeNameIndex &Arch::getTileTypeNameIndex(int type) const
+{
+    auto &idx = tile_type_names.at(type);
+    std::call_once(tile_type_names_once[type], [&]() {
+        idx.reset(new TileTypeNameIndex);
+        auto &td = chip_info->tile_types[type];
+        idx->wires.reserve(td.num_wires);
+        for (int i = 0; i < td.num_wires; i++)
+            idx->wires.push_back({td.wire_data[i].site, td.wire_data[i].name, 0, i});
+        idx->pips.reserve(td.num_pips);
+        for (int i = 0; i < td.num_pips; i++) {
+            auto &pd = td.pip_data[i];
+            if (pd.site == -1)
+                idx->pips.push_back({-1, pd.src_index, pd.dst_index, i});
+            else
+                idx->pips.push_back({pd.site, pd.bel, pd.extra_data, i});
+        }
+        std::sort(idx->wires.begin(), idx->wires.end());
+        std::sort(idx->pips.begin(), idx->pips.end());
+    });
+    return *idx;
 }
 
-// -----------------------------------------------------------------------
+int32_t Arch::findNameIndex(const std::vector<NameIndexEntry> &entries, int32_t a, int32_t b, int32_t c)
+{
+    // Entries with equal keys are ordered by index, so this finds the first match like a linear search would
+    auto found = std::lower_bound(entries.begin(), entries.end(), NameIndexEntry{a, b, c, -1});
+    if (found == entries.end() || found->a != a || found->b != b || found->c != c)
+        return -1;
+    return found->index;
+}
 
 WireId Arch::getWireByName(IdString name) const
 {
-    if (wire_by_name_cache.count(name))
-        return wire_by_name_cache.at(name);
     WireId ret;
-    setup_byname();
 
     const std::string &s = name.str(this);
-    if (s.substr(0, 9) == "SITEWIRE/") {
-        auto sp2 = split_identifier_name(s.substr(9));
-        int tile, site;
-        std::tie(tile, site) = site_by_name.at(sp2.first);
-        auto &tile_info = chip_info->tile_types[chip_info->tile_insts[tile].type];
-        IdString wirename = id(sp2.second);
-        for (int i = 0; i < tile_info.num_wires; i++) {
-            if (tile_info.wire_data[i].site == site && tile_info.wire_data[i].name == wirename.index) {
-                ret.tile = tile;
-                ret.index = i;
-                break;
+    int tile, site = -1;
+    std::pair<std::string, std::string> sp;
+    if (s.compare(0, 9, "SITEWIRE/") == 0) {
+        sp = split_identifier_name(s.substr(9));
+        if (!findSiteByName(sp.first, tile, site))
+            return ret;
+    } else {
+        sp = split_identifier_name(s);
+        tile = findTileByName(sp.first);
+        if (tile == -1)
+            return ret;
+    }
+    auto &idx = getTileTypeNameIndex(chip_info->tile_insts[tile].type);
+    int32_t wire = findNameIndex(idx.wires, site, id(sp.second).index, 0);
+    if (wire != -1)
+        ret = canonicalWireId(chip_info, tile, wire);
+    return ret;
+}
+
+void Arch::appendWireName(std::string &out, WireId wire) const
+{
+    NPNR_ASSERT(wire != WireId());
+    if (wire.tile != -1 && locInfo(wire).wire_data[wire.index].site != -1) {
+        out += "SITEWIRE/";
+        out += chip_info->tile_insts[wire.tile].site_insts[locInfo(wire).wire_data[wire.index].site].name.get();
+        out += '/';
+        out += IdString(locInfo(wire).wire_data[wire.index].name).str(this);
+    } else {
+        out += chip_info->tile_insts[wire.tile == -1 ? nodeTileWire(chip_info, wire.index, 0).tile : wire.tile]
+                       .name.get();
+        out += '/';
+        out += IdString(wireInfo(wire).name).str(this);
+    }
+}
+
+void Arch::setup_wire_index()
+{
+    tile_wire_index_base.resize(chip_info->num_tiles);
+    int32_t base = chip_info->num_nodes;
+    for (int i = 0; i < chip_info->num_tiles; i++) {
+        tile_wire_index_base[i] = base;
+        base += chip_info->tile_types[chip_info->tile_insts[i].type].num_wires;
+    }
+    wire_index_count = base;
+}
+
+WireId Arch::getWireByIndex(int32_t idx) const
+{
+    WireId wire;
+    if (idx < chip_info->num_nodes) {
+        wire.tile = -1;
+        wire.index = idx;
+        return wire;
+    }
+    int tile = int(std::upper_bound(tile_wire_index_base.begin(), tile_wire_index_base.end(), idx) -
+                   tile_wire_index_base.begin()) -
+               1;
+    int index = idx - tile_wire_index_base[tile];
+    auto &ti = chip_info->tile_insts[tile];
+    if (index < ti.num_tile_wires && ti.tile_wire_to_node[index] != -1)
+        return wire;
+    wire.tile = tile;
+    wire.index = index;
+    return wire;
+}
+
+void Arch::setup_pip_cache()
+{
+    if (!downhill_cache_start.empty())
+        return;
+    auto cstart = std::chrono::high_resolution_clock::now();
+    int threads = getCtx()->threadPool().size();
+    int32_t count = wire_index_count;
+
+    // Run func over all dense wire indices, in contiguous chunks per thread
+    auto for_all_wires = [&](std::function<void(int32_t, WireId)> func) {
+        int32_t chunk = (count + threads - 1) / threads;
+        getCtx()->threadPool().parallel_for(threads, 1, [&](size_t i) {
+            for (int32_t idx = int32_t(i) * chunk; idx < std::min(count, int32_t(i + 1) * chunk); idx++) {
+                WireId wire = getWireByIndex(idx);
+                if (wire != WireId())
+                    func(idx, wire);
             }
+        });
+    };
+
+    std::vector<int32_t> dh_start(count + 1, 0), uh_start(count + 1, 0);
+    for_all_wires([&](int32_t idx, WireId wire) {
+        for (auto pip : getPipsDownhill(wire)) {
+            (void)pip;
+            ++dh_start[idx + 1];
         }
-    } else {
-        auto sp = split_identifier_name(s);
-        int tile = tile_by_name.at(sp.first);
-        auto &tile_info = chip_info->tile_types[chip_info->tile_insts[tile].type];
-        IdString wirename = id(sp.second);
-        for (int i = 0; i < tile_info.num_wires; i++) {
-            if (tile_info.wire_data[i].site == -1 && tile_info.wire_data[i].name == wirename.index) {
-                ret.tile = tile;
-                ret.index = i;
-                break;
+        for (auto pip : getPipsUphill(wire)) {
+            (void)pip;
+            ++uh_start[idx + 1];
+        }
+    });
+    for (int32_t idx = 0; idx < count; idx++) {
+        dh_start[idx + 1] += dh_start[idx];
+        uh_start[idx + 1] += uh_start[idx];
+    }
+    std::vector<PipId> dh_pips(dh_start[count]), uh_pips(uh_start[count]);
+    for_all_wires([&](int32_t idx, WireId wire) {
+        int32_t i = dh_start[idx];
+        for (auto pip : getPipsDownhill(wire))
+            dh_pips[i++] = pip;
+        i = uh_start[idx];
+        for (auto pip : getPipsUphill(wire))
+            uh_pips[i++] = pip;
+    });
+
+    downhill_cache.swap(dh_pips);
+    uphill_cache.swap(uh_pips);
+    downhill_cache_start.swap(dh_start);
+    uphill_cache_start.swap(uh_start);
+    if (mem_account_enabled())
+        mem_account_add("pip cache", pip_cache_memory());
+    log_info("Built pip cache with %d downhill and %d uphill entries (%.1f MiB) in %.02fs\n",
+             int(downhill_cache.size()), int(uphill_cache.size()),
+             ((downhill_cache.size() + uphill_cache.size()) * sizeof(PipId) + 2 * (count + 1) * sizeof(int32_t)) /
+                     (1024.0 * 1024.0),
+             std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - cstart).count());
+}
+
+size_t Arch::pip_cache_memory() const
+{
+    return mem_usage(downhill_cache_start) + mem_usage(uphill_cache_start) + mem_usage(downhill_cache) +
+           mem_usage(uphill_cache);
+}
+
+void Arch::free_pip_cache()
+{
+    if (mem_account_enabled() && !downhill_cache_start.empty())
+        mem_account_add("pip cache", -int64_t(pip_cache_memory()));
+    std::vector<int32_t>().swap(downhill_cache_start);
+    std::vector<int32_t>().swap(uphill_cache_start);
+    std::vector<PipId>().swap(downhill_cache);
+    std::vector<PipId>().swap(uphill_cache);
+}
+
+void Arch::setup_intent_info()
+{
+    // Intents are IdStrings, all of them known to the chipdb
+    intent_info.resize(chip_info->extra_constids->known_id_count + chip_info->extra_constids->bba_id_count);
+    auto set = [&](std::initializer_list<ConstIds> intents, uint8_t flags) {
+        for (auto intent : intents) {
+            if (size_t(intent) >= intent_info.size())
+                intent_info.resize(intent + 1);
+            intent_info.at(intent).flags |= flags;
+        }
+    };
+    set({ID_NODE_GLOBAL_LEAF, ID_NODE_GLOBAL_HDISTR, ID_NODE_GLOBAL_VDISTR, ID_NODE_GLOBAL_HROUTE,
+         ID_NODE_GLOBAL_VROUTE, ID_NODE_GLOBAL_BUFG},
+        INTENT_GLOBAL);
+    set({ID_NODE_LOCAL, ID_NODE_HLONG, ID_NODE_VLONG, ID_NODE_VQUAD, ID_NODE_HQUAD}, INTENT_LOCAL);
+    set({ID_NODE_LAGUNA_DATA}, INTENT_LAGUNA);
+    set({ID_PSEUDO_GND, ID_PSEUDO_VCC}, INTENT_PSEUDO_CONST);
+    set({ID_NODE_DOUBLE, ID_NODE_HLONG, ID_NODE_HQUAD, ID_NODE_VLONG, ID_NODE_VQUAD, ID_NODE_SINGLE,
+         ID_NODE_CLE_OUTPUT, ID_NODE_OPTDELAY, ID_BENTQUAD, ID_DOUBLE, ID_HLONG, ID_HQUAD, ID_OPTDELAY, ID_SINGLE,
+         ID_VLONG, ID_VLONG12, ID_VQUAD, ID_PINBOUNCE},
+        INTENT_GENERAL);
+    set({ID_NODE_PINFEED, ID_PSEUDO_VCC, ID_PSEUDO_GND, ID_INTENT_DEFAULT, ID_NODE_DEDICATED, ID_NODE_OPTDELAY},
+        INTENT_NO_LOC);
+    set({ID_PINFEED, ID_INPUT}, INTENT_NO_SINK_LOC);
+    set({ID_NODE_OUTPUT, ID_NODE_INT_INTERFACE}, INTENT_NO_SOURCE_LOC);
+    intent_info.at(ID_NODE_PINFEED).delay_class = DELAY_CLASS_PINFEED;
+    intent_info.at(ID_NODE_LOCAL).delay_class = DELAY_CLASS_LOCAL;
+    intent_info.at(ID_NODE_PINBOUNCE).delay_class = DELAY_CLASS_LOCAL;
+    intent_info.at(ID_NODE_CLE_OUTPUT).delay_class = DELAY_CLASS_CLE_OUTPUT;
+}
+
+void Arch::setup_delay_table()
+{
+    int width = chip_info->width, height = chip_info->height;
+    delay_table.resize(DELAY_CLASS_COUNT * width * height);
+    for (int cls = 0; cls < DELAY_CLASS_COUNT; cls++) {
+        for (int dy = 0; dy < height; dy++) {
+            for (int dx = 0; dx < width; dx++) {
+                delay_t base = 30 * std::min(dx, 18) + 10 * std::max(dx - 18, 0) + 60 * std::min(dy, 6) +
+                               20 * std::max(dy - 6, 0) + 300;
+                if (xc7)
+                    base = (base * 3) / 2;
+                if (cls == DELAY_CLASS_PINFEED && dx == 0 && dy == 0)
+                    base -= 200;
+                else if (cls == DELAY_CLASS_LOCAL && dx == 0 && dy == 0)
+                    base -= 100;
+                else if (cls == DELAY_CLASS_CLE_OUTPUT)
+                    base -= 80;
+                delay_table[(cls * height + dy) * width + dx] = base;
             }
         }
     }
+}
 
-    wire_by_name_cache[name] = ret;
+void Arch::setup_delay_model()
+{
+    // Beyond a dozen tiles or so the fit of the model is as good as a table
+    const int radius = 12, samples = 4;
+    const char *data;
+    size_t size;
+    if (chipdb_cache.get("xilinx/delayModel", data, size) && delay_model.load(getCtx(), data, size, radius, samples)) {
+        log_info("Loaded placement delay model from the chipdb cache.\n");
+        return;
+    }
+    delay_model.build(getCtx(), radius, samples);
+    if (chipdb_cache.enabled())
+        chipdb_cache.put("xilinx/delayModel", delay_model.save());
+}
 
-    return ret;
+void Arch::setup_clock_regions()
+{
+    // The chipdb has no clock regions, but on 7-series they can be found from the tile grid: a row of HCLK tiles runs
+    // through the middle of each row of regions, and the column of CLK_HROW tiles (the clock spine) splits the rows
+    // into two regions each. Each region distributes 12 clocks, over the BUFH/HCLK lines of its HCLK row.
+    // UltraScale regions are split by column in ways that can't be seen from the tile types alone, so are not
+    // tracked.
+    if (!xc7)
+        return;
+    int width = chip_info->width;
+    std::vector<int> rows, spine;
+    for (int tile = 0; tile < chip_info->num_tiles; tile++) {
+        std::string type = IdString(chip_info->tile_types[chip_info->tile_insts[tile].type].type).str(this);
+        if (boost::starts_with(type, "HCLK"))
+            rows.push_back(tile / width);
+        else if (boost::starts_with(type, "CLK_HROW"))
+            spine.push_back(tile % width);
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    std::sort(spine.begin(), spine.end());
+    spine.erase(std::unique(spine.begin(), spine.end()), spine.end());
+    if (rows.empty() || spine.empty())
+        return;
+    int cols = int(spine.size()) + 1;
+    tile_clock_region.resize(chip_info->num_tiles);
+    for (int tile = 0; tile < chip_info->num_tiles; tile++) {
+        int x = tile % width, y = tile / width;
+        // Rows of tiles belong to the nearest HCLK row, the spine column to the region left of it
+        int row = 0;
+        while (row + 1 < int(rows.size()) && 2 * y > rows[row] + rows[row + 1])
+            ++row;
+        int col = int(std::lower_bound(spine.begin(), spine.end(), x) - spine.begin());
+        tile_clock_region[tile] = row * cols + col;
+    }
+    clock_regions.reset(new ClockRegionStatus[rows.size() * cols]);
+    max_region_clocks = 12;
+}
+
+void Arch::setup_slrs()
+{
+    // The chipdb has no SLRs either, but each Laguna data node (an SLL) runs from the top of one SLR to the bottom of
+    // the next, so the nodes crossing the same boundary all overlap around it. Nodes within a single row are the
+    // Laguna tiles' own wires and are ignored.
+    if (xc7)
+        return;
+    int width = chip_info->width;
+    std::vector<std::pair<int, int>> spans;
+    for (int node = 0; node < chip_info->num_nodes; node++) {
+        auto &nd = chip_info->nodes[node];
+        if (nd.intent != ID_NODE_LAGUNA_DATA || nd.num_tile_wires == 0)
+            continue;
+        int y0 = std::numeric_limits<int>::max(), y1 = -1;
+        for (int i = 0; i < nd.num_tile_wires; i++) {
+            int y = nodeTileWire(chip_info, node, i).tile / width;
+            y0 = std::min(y0, y);
+            y1 = std::max(y1, y);
+        }
+        if (y1 > y0)
+            spans.emplace_back(y0, y1);
+    }
+    std::sort(spans.begin(), spans.end());
+    // Merge overlapping spans into one boundary each, between the highest start and the lowest end of the group
+    size_t i = 0;
+    while (i < spans.size()) {
+        int lo = spans[i].first, hi = spans[i].second, group_end = spans[i].second;
+        for (++i; i < spans.size() && spans[i].first <= group_end; ++i) {
+            lo = std::max(lo, spans[i].first);
+            hi = std::min(hi, spans[i].second);
+            group_end = std::max(group_end, spans[i].second);
+        }
+        slr_boundaries.push_back((lo + hi + 1) / 2);
+    }
+    if (!slr_boundaries.empty())
+        log_info("Found %d SLRs.\n", int(slr_boundaries.size()) + 1);
+}
+
+void Arch::updateClockRegion(BelId bel, const CellInfo *cell, int delta)
+{
+    if (tile_clock_region.empty() || tile_clock_region[bel.tile] < 0)
+        return;
+    auto &cr = clock_regions[tile_clock_region[bel.tile]];
+    std::lock_guard<std::mutex> lock(cr.mtx);
+    for (const NetInfo *clk : cell->global_clocks) {
+        int &count = cr.users[clk];
+        count += delta;
+        NPNR_ASSERT(count >= 0);
+        if (count == delta && delta > 0) {
+            ++cr.distinct;
+        } else if (count == 0) {
+            cr.users.erase(clk);
+            --cr.distinct;
+        }
+    }
 }
 
 IdString Arch::getWireType(WireId wire) const { return IdString(wireIntent(wire)); }
@@ -264,68 +748,173 @@ std::vector<std::pair<IdString, std::string>> Arch::getWireAttrs(WireId wire) co
 
 PipId Arch::getPipByName(IdString name) const
 {
-    if (pip_by_name_cache.count(name))
-        return pip_by_name_cache.at(name);
     PipId ret;
-    setup_byname();
 
     const std::string &s = name.str(this);
-    if (s.substr(0, 8) == "SITEPIP/") {
+    int tile, pip;
+    if (s.compare(0, 8, "SITEPIP/") == 0) {
         auto sp2 = split_identifier_name(s.substr(8));
-        int tile, site;
-        std::tie(tile, site) = site_by_name.at(sp2.first);
-        auto &tile_info = chip_info->tile_types[chip_info->tile_insts[tile].type];
+        int site;
+        if (!findSiteByName(sp2.first, tile, site))
+            return ret;
         auto sp3 = split_identifier_name(sp2.second);
-        IdString belname = id(sp3.first), pinname = id(sp3.second);
-        for (int i = 0; i < tile_info.num_pips; i++) {
-            if (tile_info.pip_data[i].site == site && tile_info.pip_data[i].bel == belname.index &&
-                tile_info.pip_data[i].extra_data == pinname.index) {
-                ret.tile = tile;
-                ret.index = i;
-                break;
-            }
-        }
+        auto &idx = getTileTypeNameIndex(chip_info->tile_insts[tile].type);
+        pip = findNameIndex(idx.pips, site, id(sp3.first).index, id(sp3.second).index);
     } else {
         auto sp = split_identifier_name(s);
-        int tile = tile_by_name.at(sp.first);
-        auto &tile_info = chip_info->tile_types[chip_info->tile_insts[tile].type];
-
+        tile = findTileByName(sp.first);
+        if (tile == -1)
+            return ret;
         auto spn = split_identifier_name_dot(sp.second);
-        int fromwire = std::stoi(spn.first), towire = std::stoi(spn.second);
+        auto &idx = getTileTypeNameIndex(chip_info->tile_insts[tile].type);
+        pip = findNameIndex(idx.pips, -1, std::stoi(spn.first), std::stoi(spn.second));
+    }
+    if (pip != -1) {
+        ret.tile = tile;
+        ret.index = pip;
+    }
+    return ret;
+}
 
-        for (int i = 0; i < tile_info.num_pips; i++) {
-            if (tile_info.pip_data[i].site == -1 && tile_info.pip_data[i].src_index == fromwire &&
-                tile_info.pip_data[i].dst_index == towire) {
-                ret.tile = tile;
-                ret.index = i;
-                break;
+// The structured name checks below mirror getBelByName, getWireByName and getPipByName, but compare the name
+// components against the lookup tables directly rather than building and parsing name strings
+
+void Arch::archcheckTileTypeNames(int begin, int end, std::vector<std::string> &failures) const
+{
+    for (int type = begin; type < end; type++) {
+        auto &td = chip_info->tile_types[type];
+        // Objects are named after the first tile of the type, if the type is used at all
+        int tile = 0;
+        while (tile < chip_info->num_tiles && chip_info->tile_insts[tile].type != type)
+            tile++;
+        if (tile == chip_info->num_tiles)
+            continue;
+        auto &idx = getTileTypeNameIndex(type);
+        for (int i = 0; i < td.num_bels; i++) {
+            auto &bd = td.bel_data[i];
+            int j = 0;
+            while (j < td.num_bels &&
+                   !(td.bel_data[j].name == bd.name && (bd.site == -1 || td.bel_data[j].site == bd.site)))
+                j++;
+            if (j != i) {
+                BelId bel;
+                bel.tile = tile;
+                bel.index = i;
+                failures.push_back(stringf("bel %s of tile type %s does not look up by name (found index %d)",
+                                           getBelName(bel).c_str(this), IdString(td.type).c_str(this), j));
+            }
+        }
+        for (int i = 0; i < td.num_wires; i++) {
+            auto &wd = td.wire_data[i];
+            int32_t found = findNameIndex(idx.wires, wd.site, wd.name, 0);
+            if (found != i)
+                failures.push_back(stringf("wire %d (%s) of tile type %s does not look up by name (found index %d)",
+                                           i, IdString(wd.name).c_str(this), IdString(td.type).c_str(this), found));
+        }
+        for (int i = 0; i < td.num_pips; i++) {
+            auto &pd = td.pip_data[i];
+            int32_t found;
+            if (pd.site != -1 && pd.flags == PIP_SITE_INTERNAL && pd.bel != -1)
+                found = findNameIndex(idx.pips, pd.site, pd.bel, td.wire_data[pd.src_index].name);
+            else
+                found = findNameIndex(idx.pips, -1, pd.src_index, pd.dst_index);
+            if (found != i) {
+                PipId pip;
+                pip.tile = tile;
+                pip.index = i;
+                std::string name;
+                appendPipName(name, pip);
+                failures.push_back(stringf("pip %d (%s) of tile type %s does not look up by name (found index %d)",
+                                           i, name.c_str(), IdString(td.type).c_str(this), found));
             }
         }
     }
+}
 
-    pip_by_name_cache[name] = ret;
+void Arch::archcheckTileNames(int begin, int end, std::vector<std::string> &failures) const
+{
+    for (int tile = begin; tile < end; tile++) {
+        auto &ti = chip_info->tile_insts[tile];
+        if (findTileByName(ti.name.get()) != tile)
+            failures.push_back(stringf("tile %s does not look up by name", ti.name.get()));
+        // getBelByName tries site names first, so a tile name that is also a site name hides the tile's own bels
+        auto &td = chip_info->tile_types[ti.type];
+        int found_tile, found_site;
+        for (int i = 0; i < td.num_bels; i++) {
+            if (td.bel_data[i].site == -1 && findSiteByName(ti.name.get(), found_tile, found_site)) {
+                failures.push_back(stringf("tile %s has the same name as a site", ti.name.get()));
+                break;
+            }
+        }
+        for (int site = 0; site < ti.num_sites; site++) {
+            auto &si = ti.site_insts[site];
+            if (!findSiteByName(si.name.get(), found_tile, found_site) || found_tile != tile || found_site != site)
+                failures.push_back(stringf("site %s does not look up by name", si.name.get()));
+            if (chip_info->version >= 3 && si.pin[0] != '\0' && si.pin[0] != '.' &&
+                getPackagePinSite(si.pin.get()) != si.name.get())
+                failures.push_back(stringf("package pin %s does not look up its site", si.pin.get()));
+        }
+    }
+}
 
-    return ret;
+void Arch::archcheckNodeNames(int begin, int end, std::vector<std::string> &failures) const
+{
+    int last_type = -1;
+    const TileTypeNameIndex *idx = nullptr;
+    for (int node = begin; node < end; node++) {
+        TileWireRefPOD wr = nodeTileWire(chip_info, node, 0);
+        int type = chip_info->tile_insts[wr.tile].type;
+        if (type != last_type) {
+            idx = &getTileTypeNameIndex(type);
+            last_type = type;
+        }
+        int32_t found = findNameIndex(idx->wires, -1, chip_info->tile_types[type].wire_data[wr.index].name, 0);
+        WireId wire;
+        wire.tile = -1;
+        wire.index = node;
+        if (found == -1 || canonicalWireId(chip_info, wr.tile, found) != wire)
+            failures.push_back(stringf("node wire %s does not look up by name", getWireName(wire).c_str(this)));
+    }
 }
 
-IdString Arch::getPipName(PipId pip) const
+void Arch::appendPipName(std::string &out, PipId pip) const
 {
     NPNR_ASSERT(pip != PipId());
-    if (locInfo(pip).pip_data[pip.index].site != -1 && locInfo(pip).pip_data[pip.index].flags == PIP_SITE_INTERNAL &&
-        locInfo(pip).pip_data[pip.index].bel != -1) {
-        return id(std::string("SITEPIP/") +
-                  chip_info->tile_insts[pip.tile].site_insts[locInfo(pip).pip_data[pip.index].site].name.get() +
-                  std::string("/") + IdString(locInfo(pip).pip_data[pip.index].bel).str(this) + "/" +
-                  IdString(locInfo(pip).wire_data[locInfo(pip).pip_data[pip.index].src_index].name).str(this));
+    auto &pd = locInfo(pip).pip_data[pip.index];
+    if (pd.site != -1 && pd.flags == PIP_SITE_INTERNAL && pd.bel != -1) {
+        out += "SITEPIP/";
+        out += chip_info->tile_insts[pip.tile].site_insts[pd.site].name.get();
+        out += '/';
+        out += IdString(pd.bel).str(this);
+        out += '/';
+        out += IdString(locInfo(pip).wire_data[pd.src_index].name).str(this);
     } else {
-        return id(std::string(chip_info->tile_insts[pip.tile].name.get()) + "/" +
-                  std::to_string(locInfo(pip).pip_data[pip.index].src_index) + "." +
-                  std::to_string(locInfo(pip).pip_data[pip.index].dst_index));
+        out += chip_info->tile_insts[pip.tile].name.get();
+        out += '/';
+        out += std::to_string(pd.src_index);
+        out += '.';
+        out += std::to_string(pd.dst_index);
     }
 }
 
 void Arch::setup_pip_blacklist()
 {
+    // Kept in the chipdb cache as the tile type index followed by the number of pips and the pip indices, for each type
+    std::vector<int32_t> cached;
+    blacklist_pips.clear();
+    blacklist_pips.resize(chip_info->num_tiletypes);
+    auto blacklist_pip = [&](int type, int index) {
+        auto &type_blacklist = blacklist_pips.at(type);
+        if (type_blacklist.empty())
+            type_blacklist.resize(chip_info->tile_types[type].num_pips, false);
+        type_blacklist.at(index) = true;
+    };
+    if (chipdb_cache.get_vector("xilinx/pipBlacklistByType", cached)) {
+        for (size_t i = 0; i + 1 < cached.size(); i += 2 + cached[i + 1])
+            for (int32_t j = 0; j < cached[i + 1]; j++)
+                blacklist_pip(cached[i], cached.at(i + 2 + j));
+        return;
+    }
     for (int i = 0; i < chip_info->num_tiletypes; i++) {
         auto &td = chip_info->tile_types[i];
         std::string type = IdString(td.type).str(this);
@@ -334,11 +923,11 @@ void Arch::setup_pip_blacklist()
                 auto &pd = td.pip_data[j];
                 std::string dest_name = IdString(td.wire_data[pd.dst_index].name).str(this);
                 if (dest_name.find("FREQ_REF") != std::string::npos)
-                    blacklist_pips[td.type].insert(j);
+                    blacklist_pip(i, j);
             }
         } else if (boost::starts_with(type, "CMT_TOP_L_LOWER")) {
             for (int j = 0; j < td.num_pips; j++) {
-                blacklist_pips[td.type].insert(j);
+                blacklist_pip(i, j);
             }
         } else if (boost::starts_with(type, "CLK_HROW_TOP")) {
             for (int j = 0; j < td.num_pips; j++) {
@@ -348,7 +937,7 @@ void Arch::setup_pip_blacklist()
 
                 if (dest_name.find("CK_BUFG_CASCO") != std::string::npos &&
                     src_name.find("CK_BUFG_CASCIN") != std::string::npos)
-                    blacklist_pips[td.type].insert(j);
+                    blacklist_pip(i, j);
             }
         } else if (boost::starts_with(type, "HCLK_IOI3")) {
             for (int j = 0; j < td.num_pips; j++) {
@@ -358,7 +947,7 @@ void Arch::setup_pip_blacklist()
 
                 if (dest_name.find("RCLK_BEFORE_DIV") != std::string::npos &&
                     src_name.find("IMUX") != std::string::npos)
-                    blacklist_pips[td.type].insert(j);
+                    blacklist_pip(i, j);
             }
         } else if (type.find("IOI3") != std::string::npos) {
             for (int j = 0; j < td.num_pips; j++) {
@@ -367,11 +956,11 @@ void Arch::setup_pip_blacklist()
                 std::string src_name = IdString(td.wire_data[pd.src_index].name).str(this);
 
                 if (dest_name.find("CLKB") != std::string::npos && src_name.find("IMUX22") != std::string::npos)
-                    blacklist_pips[td.type].insert(j);
+                    blacklist_pip(i, j);
                 if (dest_name.find("OCLKB") != std::string::npos && src_name.find("IOI_OCLK_") != std::string::npos)
-                    blacklist_pips[td.type].insert(j);
+                    blacklist_pip(i, j);
                 if (dest_name.find("OCLKM") != std::string::npos && src_name.find("IMUX31") != std::string::npos)
-                    blacklist_pips[td.type].insert(j);
+                    blacklist_pip(i, j);
             }
         } else if (boost::starts_with(type, "CMT_TOP_R")) {
             for (int j = 0; j < td.num_pips; j++) {
@@ -380,11 +969,28 @@ void Arch::setup_pip_blacklist()
                 std::string src_name = IdString(td.wire_data[pd.src_index].name).str(this);
 
                 if (dest_name.find("PLLOUT_CLK_FREQ_BB_REBUFOUT") != std::string::npos)
-                    blacklist_pips[td.type].insert(j);
+                    blacklist_pip(i, j);
                 if (dest_name.find("MMCM_CLK_FREQ_BB") != std::string::npos)
-                    blacklist_pips[td.type].insert(j);
+                    blacklist_pip(i, j);
+            }
+        }
+    }
+    if (chipdb_cache.enabled()) {
+        for (int type = 0; type < int(blacklist_pips.size()); type++) {
+            auto &type_blacklist = blacklist_pips.at(type);
+            if (type_blacklist.empty())
+                continue;
+            cached.push_back(type);
+            size_t count_pos = cached.size();
+            cached.push_back(0);
+            for (int j = 0; j < int(type_blacklist.size()); j++) {
+                if (!type_blacklist.at(j))
+                    continue;
+                cached.push_back(j);
+                ++cached.at(count_pos);
             }
         }
+        chipdb_cache.put_vector("xilinx/pipBlacklistByType", cached);
     }
 }
 
@@ -436,16 +1042,15 @@ delay_t Arch::estimateDelay(WireId src, WireId dst, bool debug) const
     if (src == dst)
         return 0;
     int src_x, src_y, dst_x, dst_y;
-    int src_intent = wireIntent(src), dst_intent = wireIntent(dst);
-    // if (src_intent == ID_PSEUDO_GND || dst_intent == ID_PSEUDO_VCC)
-    //    return 500;
-    int dst_tile = dst.tile == -1 ? chip_info->nodes[dst.index].tile_wires[0].tile : dst.tile;
-    int src_tile = src.tile == -1 ? chip_info->nodes[src.index].tile_wires[0].tile : src.tile;
-
-    if (sink_locs.count(dst)) {
-        dst_x = sink_locs.at(dst).x;
-        dst_y = sink_locs.at(dst).y;
-        if (src_tile == dst_tile || (sink_locs.count(src) && (sink_locs.at(dst) == sink_locs.at(src)))) {
+    const IntentInfo &src_class = intentInfo(wireIntent(src));
+    int dst_tile = dst.tile == -1 ? nodeTileWire(chip_info, dst.index, 0).tile : dst.tile;
+    int src_tile = src.tile == -1 ? nodeTileWire(chip_info, src.index, 0).tile : src.tile;
+
+    int dst_sink_tile = getSinkLocTile(dst);
+    if (dst_sink_tile != -1) {
+        dst_x = dst_sink_tile % chip_info->width;
+        dst_y = dst_sink_tile / chip_info->width;
+        if (src_tile == dst_tile || getSinkLocTile(src) == dst_sink_tile) {
             return 1000;
         }
     } else if (dst.tile != -1 && chip_info->tile_insts[dst.tile].num_sites > 0) {
@@ -463,13 +1068,7 @@ delay_t Arch::estimateDelay(WireId src, WireId dst, bool debug) const
     }
 
     if (src.tile == -1) {
-        if (src_intent == ID_PSEUDO_GND || src_intent == ID_PSEUDO_VCC) {
-            if (gnd_glbl == IdString()) {
-                gnd_glbl = id("PSEUDO_GND_WIRE_GLBL");
-                gnd_row = id("PSEUDO_GND_WIRE_ROW");
-                vcc_glbl = id("PSEUDO_VCC_WIRE_GLBL");
-                vcc_row = id("PSEUDO_VCC_WIRE_ROW");
-            }
+        if (src_class.flags & INTENT_PSEUDO_CONST) {
             if (debug)
                 log_info("%s %d %d\n", IdString(wireInfo(src).name).c_str(this), wireInfo(src).name, gnd_glbl.index);
             if (wireInfo(src).name == gnd_glbl.index || wireInfo(src).name == vcc_glbl.index)
@@ -485,9 +1084,10 @@ delay_t Arch::estimateDelay(WireId src, WireId dst, bool debug) const
             src_y = -1;
             for (int i = 0; i < std::min(200, src_n.num_tile_wires); i++) {
                 // Approximate the nearest location to dest
-                int ti = src_n.tile_wires[i].tile;
-                auto &tw = chip_info->tile_types[chip_info->tile_insts[ti].type].wire_data[src_n.tile_wires[i].index];
-                if (tw.num_downhill == 0 && src_intent != ID_NODE_PINFEED)
+                TileWireRefPOD wr = nodeTileWire(chip_info, src.index, i);
+                int ti = wr.tile;
+                auto &tw = chip_info->tile_types[chip_info->tile_insts[ti].type].wire_data[wr.index];
+                if (tw.num_downhill == 0 && src_class.delay_class != DELAY_CLASS_PINFEED)
                     continue;
                 int tix = ti % chip_info->width, tiy = ti / chip_info->width;
                 if (src_x == -1 || std::abs(tix - dst_x) < std::abs(src_x - dst_x))
@@ -496,8 +1096,8 @@ delay_t Arch::estimateDelay(WireId src, WireId dst, bool debug) const
                     src_y = tiy;
             }
             if (src_x == -1) {
-                src_x = chip_info->nodes[src.index].tile_wires[0].tile % chip_info->width;
-                src_y = chip_info->nodes[src.index].tile_wires[0].tile / chip_info->width;
+                src_x = nodeTileWire(chip_info, src.index, 0).tile % chip_info->width;
+                src_y = nodeTileWire(chip_info, src.index, 0).tile / chip_info->width;
             }
         }
 
@@ -516,39 +1116,18 @@ delay_t Arch::estimateDelay(WireId src, WireId dst, bool debug) const
     }
     if (debug)
         log_info("    src (%d, %d) dst (%d, %d)\n", src_x, src_y, dst_x, dst_y);
-    /*
-        delay_t base = 150 * std::min(std::abs(dst_x - src_x), 30) + 40 * std::max(std::abs(dst_x - src_x) - 30, 0)
-                +  150 * std::min(std::abs(dst_y - src_y), 10) + 60 * std::max(std::abs(dst_y - src_y)  - 10, 0)
-                + 500;
-        auto &srci = wireInfo(src);*/
-    /*
-    if (srci.intent == ID_NODE_HLONG || srci.intent == ID_NODE_VLONG)
-        base -= 180;
-    if (srci.intent == ID_NODE_HQUAD || srci.intent == ID_NODE_VQUAD || srci.intent == ID_NODE_DOUBLE)
-        base -= 120;
-    */
-    delay_t base = 30 * std::min(std::abs(dst_x - src_x), 18) + 10 * std::max(std::abs(dst_x - src_x) - 18, 0) +
-                   60 * std::min(std::abs(dst_y - src_y), 6) + 20 * std::max(std::abs(dst_y - src_y) - 6, 0) + 300;
-
-    if (xc7)
-        base = (base * 3) / 2;
-
-    if (sink_locs.count(dst))
+    delay_t base = lookupDelayTable(src_class.delay_class, dst_x - src_x, dst_y - src_y);
+    if (dst_sink_tile != -1)
         base += 1000;
-    if (src_intent == ID_NODE_PINFEED && dst_x == src_x && dst_y == src_y)
-        base -= 200;
-    else if ((src_intent == ID_NODE_LOCAL || src_intent == ID_NODE_PINBOUNCE) && dst_x == src_x && dst_y == src_y)
-        base -= 100;
-    if (src_intent == ID_NODE_CLE_OUTPUT)
-        base -= 80;
+    base += slrCrossings(src_y, dst_y) * slr_crossing_delay;
 
     return base;
 }
 
 ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
 {
-    int dst_tile = dst.tile == -1 ? chip_info->nodes[dst.index].tile_wires[0].tile : dst.tile;
-    int src_tile = src.tile == -1 ? chip_info->nodes[src.index].tile_wires[0].tile : src.tile;
+    int dst_tile = dst.tile == -1 ? nodeTileWire(chip_info, dst.index, 0).tile : dst.tile;
+    int src_tile = src.tile == -1 ? nodeTileWire(chip_info, src.index, 0).tile : src.tile;
 
     int x0, x1, y0, y1;
     x0 = src_tile % chip_info->width;
@@ -567,8 +1146,9 @@ ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
     if (source_locs.count(src))
         expand(source_locs.at(src).x, source_locs.at(src).y);
 
-    if (sink_locs.count(dst)) {
-        expand(sink_locs.at(dst).x, sink_locs.at(dst).y);
+    int dst_sink_tile = getSinkLocTile(dst);
+    if (dst_sink_tile != -1) {
+        expand(dst_sink_tile % chip_info->width, dst_sink_tile / chip_info->width);
     } else if (dst.tile != -1 && chip_info->tile_insts[dst.tile].num_sites > 0) {
         auto &site = chip_info->tile_insts[dst.tile].site_insts[wireInfo(dst).site != -1 ? wireInfo(dst).site : 0];
         if (site.inter_x != -1) {
@@ -587,8 +1167,7 @@ ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
 
 delay_t Arch::getBoundingBoxCost(WireId src, WireId dst, int distance) const
 {
-    int src_intent = wireIntent(src);
-    if (src.tile == -1 && (src_intent == ID_PSEUDO_GND || src_intent == ID_PSEUDO_VCC))
+    if (src.tile == -1 && (intentInfo(wireIntent(src)).flags & INTENT_PSEUDO_CONST))
         return 0;
     if (distance < 5)
         return 0;
@@ -620,13 +1199,12 @@ delay_t Arch::predictDelay(const NetInfo *net_info, const PortRef &sink) const
             return 700; // penalize FF2 as it makes routing harder
         else
             return 150;
+    } else if (!delay_model.empty()) {
+        return delay_model.predict(net_info->driver.cell->bel, sink.cell->bel) +
+               slrCrossings(src_y, dst_y) * slr_crossing_delay;
     } else {
-        delay_t base = 30 * std::min(std::abs(dst_x - src_x), 18) + 10 * std::max(std::abs(dst_x - src_x) - 18, 0) +
-                       60 * std::min(std::abs(dst_y - src_y), 6) + 20 * std::max(std::abs(dst_y - src_y) - 6, 0) + 300;
-
-        if (xc7)
-            base = (base * 3) / 2;
-        return base;
+        return lookupDelayTable(DELAY_CLASS_OTHER, dst_x - src_x, dst_y - src_y) +
+               slrCrossings(src_y, dst_y) * slr_crossing_delay;
     }
 }
 
@@ -638,6 +1216,9 @@ bool Arch::place()
 {
     std::string placer = str_or_default(settings, id("placer"), defaultPlacer);
 
+    if (getCtx()->setting<bool>("xilinx/delayModel", false) && delay_model.empty())
+        setup_delay_model();
+
     if (placer == "heap") {
         PlacerHeapCfg cfg(getCtx());
         cfg.criticalityExponent = 7;
@@ -645,6 +1226,12 @@ bool Arch::place()
         cfg.ioBufTypes.insert(id("IOB_OUTBUF"));
         cfg.ioBufTypes.insert(id_PSEUDO_GND);
         cfg.ioBufTypes.insert(id_PSEUDO_VCC);
+        cfg.hardBlockTypes.insert(id_RAMB18E1_RAMB18E1);
+        cfg.hardBlockTypes.insert(id_RAMB36E1_RAMB36E1);
+        cfg.hardBlockTypes.insert(id("DSP48E1_DSP48E1"));
+        cfg.hardBlockTypes.insert(id_RAMB18E2_RAMB18E2);
+        cfg.hardBlockTypes.insert(id_RAMB36E2_RAMB36E2);
+        cfg.hardBlockTypes.insert(id_BEL_URAM288);
         cfg.alpha = 0.08;
         cfg.beta = 0.4;
         cfg.placeAllAtOnce = true;
@@ -733,14 +1320,129 @@ void Arch::routeClock()
 {
     log_info("Routing global clocks...\n");
     // Special pass for faster routing of global clock psuedo-net
-    for (auto net : sorted(nets)) {
-        NetInfo *ni = net.second;
+    // Search state is reused between arcs, as high fanout clocks have many thousands of them. The arcs of a net must
+    // be routed in order, as each one can reuse the routing of those before it.
+    std::vector<WireId> visit;
+    std::unordered_map<WireId, PipId> backtrace;
+    // General routing is never used for dedicated clock routing
+    auto is_general_routing = [&](WireId wire) { return (intentInfo(wireIntent(wire)).flags & INTENT_GENERAL) != 0; };
+    auto is_clock_network = [&](WireId wire) { return (intentInfo(wireIntent(wire)).flags & INTENT_GLOBAL) != 0; };
+
+    // Search uphill from a wire over dedicated routing, until reaching the routing of the net so far, and bind the
+    // route found. With lenient set, general routing may be used as well.
+    auto route_to_tree = [&](NetInfo *ni, WireId start, bool lenient) {
+        visit.clear();
+        backtrace.clear();
+        WireId dest = WireId();
+        visit.push_back(start);
+        for (size_t head = 0; head < visit.size(); head++) {
+            WireId curr = visit.at(head);
+            if (getBoundWireNet(curr) == ni) {
+                dest = curr;
+                break;
+            }
+            for (auto uh : getPipsUphill(curr)) {
+                if (!checkPipAvail(uh))
+                    continue;
+                WireId src = getPipSrcWire(uh);
+                if (backtrace.count(src))
+                    continue;
+                if (!lenient && is_general_routing(src))
+                    continue;
+                if (!checkWireAvail(src) && getBoundWireNet(src) != ni)
+                    continue;
+                backtrace[src] = uh;
+                visit.push_back(src);
+            }
+        }
+        if (dest == WireId())
+            return false;
+        while (backtrace.count(dest)) {
+            auto uh = backtrace[dest];
+            dest = getPipDstWire(uh);
+            if (getCtx()->debug)
+                log_info("            bind pip %s --> %s\n", nameOfPip(uh), nameOfWire(dest));
+            bindWire(dest, ni, STRENGTH_LOCKED);
+            bindPip(uh, ni, STRENGTH_LOCKED);
+        }
+        return true;
+    };
+
+    auto route_arc = [&](NetInfo *ni, PortRef &usr) {
+        WireId sink = getCtx()->getNetinfoSinkWire(ni, usr);
+        if (getCtx()->debug)
+            log_info("        routing arc to %s.%s (wire %s):\n", usr.cell->name.c_str(this), usr.port.c_str(this),
+                     nameOfWire(sink));
+        if (route_to_tree(ni, sink, false))
+            return;
+        log_info("            failed to find a route using dedicated resources.\n");
+        // Due to some missing pips, currently special case more lenient solution
+        if (ni->users.size() == 1 && ni->users.front().cell->type == id("PLLE2_ADV_PLLE2_ADV") &&
+            ni->users.front().port == id("CLKIN1"))
+            route_to_tree(ni, sink, true);
+    };
+
+    // High fanout clocks are routed as a tree: a short search from each sink over local wires finds the clock
+    // network wire (usually a leaf) that it can be reached from, and only these entry wires are routed through the
+    // spine, row and leaf hierarchy, once each. The sinks of a clock region all share this routing, where a search
+    // from every sink would go over the clock network again until it meets the routing of the sinks before it.
+    const size_t tree_min_users = 16, local_search_limit = 512;
+    std::unordered_map<WireId, PipId> local_back;
+    std::vector<WireId> local_visit;
+    auto find_entry = [&](NetInfo *ni, WireId sink, std::vector<PipId> &path) {
+        local_visit.clear();
+        local_back.clear();
+        local_visit.push_back(sink);
+        for (size_t head = 0; head < local_visit.size() && head < local_search_limit; head++) {
+            WireId curr = local_visit.at(head);
+            if (getBoundWireNet(curr) == ni || (head > 0 && is_clock_network(curr))) {
+                path.clear();
+                for (WireId cursor = curr; local_back.count(cursor);) {
+                    PipId uh = local_back.at(cursor);
+                    path.push_back(uh);
+                    cursor = getPipDstWire(uh);
+                }
+                return curr;
+            }
+            for (auto uh : getPipsUphill(curr)) {
+                if (!checkPipAvail(uh))
+                    continue;
+                WireId src = getPipSrcWire(uh);
+                if (local_back.count(src) || src == sink || is_general_routing(src))
+                    continue;
+                if (!checkWireAvail(src) && getBoundWireNet(src) != ni)
+                    continue;
+                local_back[src] = uh;
+                local_visit.push_back(src);
+            }
+        }
+        return WireId();
+    };
+    // Bind a local route, given from the entry wire towards the sink, as far as it isn't shared with another sink
+    auto bind_local = [&](NetInfo *ni, const std::vector<PipId> &path) {
+        for (auto uh : path) {
+            WireId dst = getPipDstWire(uh);
+            if (getBoundWireNet(dst) == ni)
+                continue;
+            if (!checkWireAvail(dst) || !checkPipAvail(uh))
+                return false;
+        }
+        for (auto uh : path) {
+            WireId dst = getPipDstWire(uh);
+            if (getBoundWireNet(dst) == ni)
+                continue;
+            bindWire(dst, ni, STRENGTH_LOCKED);
+            bindPip(uh, ni, STRENGTH_LOCKED);
+        }
+        return true;
+    };
+
+    for (auto &net : nets) {
+        NetInfo *ni = net.second.get();
         if (ni->driver.cell == nullptr)
             continue;
         bool is_global = false;
-        if ((ni->driver.cell->type == id_BUFGCTRL || ni->driver.cell->type == id_BUFCE_BUFG_PS ||
-             ni->driver.cell->type == id_BUFCE_BUFCE || ni->driver.cell->type == id_BUFGCE_DIV_BUFGCE_DIV) &&
-            ni->driver.port == id("O"))
+        if (isBufgNet(ni))
             is_global = true;
         else if (ni->driver.cell->type == id("PLLE2_ADV_PLLE2_ADV") && ni->users.size() == 1 &&
                  (ni->users.front().cell->type == id_BUFGCTRL || ni->users.front().cell->type == id_BUFCE_BUFCE ||
@@ -753,84 +1455,38 @@ void Arch::routeClock()
             continue;
         log_info("    routing clock '%s'\n", ni->name.c_str(this));
         bindWire(getCtx()->getNetinfoSourceWire(ni), ni, STRENGTH_LOCKED);
-        for (auto &usr : ni->users) {
-            std::queue<WireId> visit;
-            std::unordered_map<WireId, PipId> backtrace;
-            WireId dest = WireId();
-            if (getCtx()->debug)
-                log_info("        routing arc to %s.%s (wire %s):\n", usr.cell->name.c_str(this), usr.port.c_str(this),
-                         nameOfWire(getCtx()->getNetinfoSinkWire(ni, usr)));
-            visit.push(getCtx()->getNetinfoSinkWire(ni, usr));
-            while (!visit.empty()) {
-                WireId curr = visit.front();
-                visit.pop();
-                if (getBoundWireNet(curr) == ni) {
-                    dest = curr;
-                    break;
-                }
-                for (auto uh : getPipsUphill(curr)) {
-                    if (!checkPipAvail(uh))
-                        continue;
-                    WireId src = getPipSrcWire(uh);
-                    if (backtrace.count(src))
-                        continue;
-                    int intent = wireIntent(src);
-                    if (intent == ID_NODE_DOUBLE || intent == ID_NODE_HLONG || intent == ID_NODE_HQUAD ||
-                        intent == ID_NODE_VLONG || intent == ID_NODE_VQUAD || intent == ID_NODE_SINGLE ||
-                        intent == ID_NODE_CLE_OUTPUT || intent == ID_NODE_OPTDELAY || intent == ID_BENTQUAD ||
-                        intent == ID_DOUBLE || intent == ID_HLONG || intent == ID_HQUAD || intent == ID_OPTDELAY ||
-                        intent == ID_SINGLE || intent == ID_VLONG || intent == ID_VLONG12 || intent == ID_VQUAD ||
-                        intent == ID_PINBOUNCE)
-                        continue;
-                    if (!checkWireAvail(src) && getBoundWireNet(src) != ni)
-                        continue;
-                    backtrace[src] = uh;
-                    visit.push(src);
-                }
-            }
-            if (dest == WireId()) {
-                log_info("            failed to find a route using dedicated resources.\n");
-                if (ni->users.size() == 1 && ni->users.front().cell->type == id("PLLE2_ADV_PLLE2_ADV") &&
-                    ni->users.front().port == id("CLKIN1")) {
-                    // Due to some missing pips, currently special case more lenient solution
-                    std::queue<WireId> empty;
-                    std::swap(visit, empty);
-                    backtrace.clear();
-                    visit.push(getCtx()->getNetinfoSinkWire(ni, usr));
-                    while (!visit.empty()) {
-                        WireId curr = visit.front();
-                        visit.pop();
-                        if (getBoundWireNet(curr) == ni) {
-                            dest = curr;
-                            break;
-                        }
-                        for (auto uh : getPipsUphill(curr)) {
-                            if (!checkPipAvail(uh))
-                                continue;
-                            WireId src = getPipSrcWire(uh);
-                            if (backtrace.count(src))
-                                continue;
-                            if (!checkWireAvail(src) && getBoundWireNet(src) != ni)
-                                continue;
-                            backtrace[src] = uh;
-                            visit.push(src);
-                        }
-                    }
-                    if (dest == WireId())
-                        continue;
-                } else {
-                    continue;
-                }
-            }
-            while (backtrace.count(dest)) {
-                auto uh = backtrace[dest];
-                dest = getPipDstWire(uh);
-                if (getCtx()->debug)
-                    log_info("            bind pip %s --> %s\n", nameOfPip(uh), nameOfWire(dest));
-                bindWire(dest, ni, STRENGTH_LOCKED);
-                bindPip(uh, ni, STRENGTH_LOCKED);
+        if (ni->users.size() < tree_min_users) {
+            for (auto &usr : ni->users)
+                route_arc(ni, usr);
+            continue;
+        }
+
+        // Local routes of all sinks, from the entry wire towards the sink, and the distinct entry wires in order
+        std::vector<std::vector<PipId>> paths(ni->users.size());
+        std::vector<WireId> user_entry(ni->users.size());
+        std::vector<WireId> entries;
+        std::unordered_map<WireId, bool> entry_routed;
+        for (size_t i = 0; i < ni->users.size(); i++) {
+            WireId entry = find_entry(ni, getCtx()->getNetinfoSinkWire(ni, ni->users.at(i)), paths.at(i));
+            user_entry.at(i) = entry;
+            if (entry != WireId() && entry_routed.emplace(entry, false).second)
+                entries.push_back(entry);
+        }
+        for (auto entry : entries)
+            entry_routed.at(entry) = (getBoundWireNet(entry) == ni) || route_to_tree(ni, entry, false);
+
+        int tree_sinks = 0;
+        for (size_t i = 0; i < ni->users.size(); i++) {
+            WireId entry = user_entry.at(i);
+            if (entry != WireId() && entry_routed.at(entry) && bind_local(ni, paths.at(i))) {
+                ++tree_sinks;
+                continue;
             }
+            // Not reachable through a shared entry wire, so search from this sink alone
+            route_arc(ni, ni->users.at(i));
         }
+        log_info("        %d sinks routed through %d clock network entry wires, %d routed individually\n", tree_sinks,
+                 int(entries.size()), int(ni->users.size()) - tree_sinks);
     }
 #if 0
     for (auto net : sorted(nets)) {
@@ -870,110 +1526,128 @@ void Arch::routeClock()
 
 void Arch::findSourceSinkLocations()
 {
-    // Use a backwards BFS to find the real location of sinks, on a best-effort basis
-#if 1
-    for (auto net : sorted(nets)) {
-        NetInfo *ni = net.second;
+    // Use a backwards BFS to find the real location of sinks (and a forwards one for sources), on a best-effort
+    // basis. The searches only read the routing graph, so they run in parallel and the results are then applied in
+    // the same order as a serial pass would, keeping the outcome independent of thread count.
+    if (sink_loc_tile.empty())
+        sink_loc_tile.resize(getWireIndexCount(), -1);
+
+    std::vector<WireId> sinks, sources;
+    std::unordered_set<WireId> seen_sinks, seen_sources;
+    for (auto &net : nets) {
+        NetInfo *ni = net.second.get();
         for (auto &usr : ni->users) {
             BelId bel = usr.cell->bel;
             if (bel == BelId() || isLogicTile(bel) || (xc7 && isBRAMTile(bel)))
                 continue; // don't need to do this for logic bels, which are always next to their INT
             WireId sink = getCtx()->getNetinfoSinkWire(ni, usr);
-            if (sink == WireId() || sink_locs.count(sink))
+            if (sink == WireId() || getSinkLocTile(sink) != -1 || !seen_sinks.insert(sink).second)
                 continue;
-            std::queue<WireId> visit;
-            std::unordered_map<WireId, WireId> backtrace;
-            int iter = 0;
-            // as this is a best-effort optimisation to slightly improve routing,
-            // don't spend too long with a nice low iteration limit
-            const int iter_max = 500;
-            visit.push(sink);
-            while (!visit.empty() && iter < iter_max) {
-                ++iter;
-                WireId cursor = visit.front();
-                visit.pop();
-                if (wireInfo(cursor).site == -1) {
-                    int intent = wireIntent(cursor);
-                    if (intent != ID_NODE_PINFEED && intent != ID_PSEUDO_VCC && intent != ID_PSEUDO_GND &&
-                        intent != ID_INTENT_DEFAULT && intent != ID_NODE_DEDICATED && intent != ID_NODE_OPTDELAY &&
-                        intent != ID_PINFEED && intent != ID_INPUT) {
-                        int tile = cursor.tile == -1 ? chip_info->nodes[cursor.index].tile_wires[0].tile : cursor.tile;
-                        sink_locs[sink] = Loc(tile % chip_info->width, tile / chip_info->width, 0);
-                        if (getCtx()->debug) {
-                            log_info("%s <---- %s\n", nameOfWire(sink), nameOfWire(cursor));
-                        }
-
-                        while (backtrace.count(cursor)) {
-                            cursor = backtrace.at(cursor);
-                            if (!sink_locs.count(cursor)) {
-                                sink_locs[cursor] = Loc(tile % chip_info->width, tile / chip_info->width, 0);
-                            }
-                        }
-
-                        break;
-                    }
-                }
-                for (auto pip : getPipsUphill(cursor)) {
-                    WireId src = getPipSrcWire(pip);
-                    if (!backtrace.count(src)) {
-                        backtrace[src] = cursor;
-                        visit.push(getPipSrcWire(pip));
-                    }
-                }
-            }
+            sinks.push_back(sink);
         }
-
         auto &drv = ni->driver;
         if (drv.cell != nullptr) {
             BelId bel = drv.cell->bel;
             if (bel == BelId() || isLogicTile(bel))
-                continue; // don't need to do this for logic bels, which are always next to their INT
+                continue;
             WireId source = getCtx()->getNetinfoSourceWire(ni);
-            if (source == WireId() || source_locs.count(source))
+            if (source == WireId() || source_locs.count(source) || !seen_sources.insert(source).second)
                 continue;
-            std::queue<WireId> visit;
-            std::unordered_map<WireId, WireId> backtrace;
-            int iter = 0;
-            // as this is a best-effort optimisation to slightly improve routing,
-            // don't spend too long with a nice low iteration limit
-            const int iter_max = 500;
-            visit.push(source);
-            while (!visit.empty() && iter < iter_max) {
-                ++iter;
-                WireId cursor = visit.front();
-                visit.pop();
-                if (wireInfo(cursor).site == -1) {
-                    int intent = wireIntent(cursor);
-                    if (intent != ID_NODE_PINFEED && intent != ID_PSEUDO_VCC && intent != ID_PSEUDO_GND &&
-                        intent != ID_INTENT_DEFAULT && intent != ID_NODE_DEDICATED && intent != ID_NODE_OPTDELAY &&
-                        intent != ID_NODE_OUTPUT && intent != ID_NODE_INT_INTERFACE) {
-                        int tile = cursor.tile == -1 ? chip_info->nodes[cursor.index].tile_wires[0].tile : cursor.tile;
-                        source_locs[source] = Loc(tile % chip_info->width, tile / chip_info->width, 0);
-                        if (getCtx()->debug) {
-                            log_info("%s ----> %s\n", nameOfWire(source), nameOfWire(cursor));
-                        }
-
-                        while (backtrace.count(cursor)) {
-                            cursor = backtrace.at(cursor);
-                            if (!source_locs.count(cursor)) {
-                                source_locs[cursor] = Loc(tile % chip_info->width, tile / chip_info->width, 0);
-                            }
-                        }
-
-                        break;
+            sources.push_back(source);
+        }
+    }
+
+    struct SearchScratch
+    {
+        std::vector<WireId> visit;
+        std::unordered_map<WireId, WireId> backtrace;
+    };
+    struct SearchResult
+    {
+        int tile = -1;
+        // Wires between the one that was found and the start, which share its location
+        std::vector<WireId> path;
+    };
+
+    auto search = [&](WireId start, bool is_sink, SearchScratch &scratch, SearchResult &result) {
+        scratch.visit.clear();
+        scratch.backtrace.clear();
+        scratch.visit.push_back(start);
+        scratch.backtrace.emplace(start, WireId());
+        // as this is a best-effort optimisation to slightly improve routing,
+        // don't spend too long with a nice low iteration limit
+        const int iter_max = 500;
+        for (size_t head = 0; head < scratch.visit.size() && int(head) < iter_max; head++) {
+            WireId cursor = scratch.visit.at(head);
+            if (wireInfo(cursor).site == -1) {
+                uint8_t excluded = INTENT_NO_LOC | (is_sink ? INTENT_NO_SINK_LOC : INTENT_NO_SOURCE_LOC);
+                bool found = (intentInfo(wireIntent(cursor)).flags & excluded) == 0;
+                if (found) {
+                    result.tile = cursor.tile == -1 ? nodeTileWire(chip_info, cursor.index, 0).tile : cursor.tile;
+                    if (getCtx()->debug)
+                        log_info(is_sink ? "%s <---- %s\n" : "%s ----> %s\n", nameOfWire(start), nameOfWire(cursor));
+                    while (true) {
+                        cursor = scratch.backtrace.at(cursor);
+                        if (cursor == WireId())
+                            break;
+                        result.path.push_back(cursor);
                     }
+                    return;
                 }
+            }
+            if (is_sink) {
+                for (auto pip : getPipsUphill(cursor)) {
+                    WireId src = getPipSrcWire(pip);
+                    if (scratch.backtrace.emplace(src, cursor).second)
+                        scratch.visit.push_back(src);
+                }
+            } else {
                 for (auto pip : getPipsDownhill(cursor)) {
                     WireId dst = getPipDstWire(pip);
-                    if (!backtrace.count(dst)) {
-                        backtrace[dst] = cursor;
-                        visit.push(getPipDstWire(pip));
-                    }
+                    if (scratch.backtrace.emplace(dst, cursor).second)
+                        scratch.visit.push_back(dst);
                 }
             }
         }
+    };
+
+    std::vector<SearchResult> sink_results(sinks.size()), source_results(sources.size());
+    size_t total = sinks.size() + sources.size();
+    // Searched in blocks of items, each with its own scratch space
+    const size_t block = 64;
+    getCtx()->threadPool().parallel_for(
+            (total + block - 1) / block, 1,
+            [&](size_t b) {
+                SearchScratch scratch;
+                for (size_t i = b * block; i < std::min(total, (b + 1) * block); i++) {
+                    if (i < sinks.size())
+                        search(sinks.at(i), true, scratch, sink_results.at(i));
+                    else
+                        search(sources.at(i - sinks.size()), false, scratch, source_results.at(i - sinks.size()));
+                }
+            },
+            getCtx()->debug ? 1 : 0);
+
+    for (size_t i = 0; i < sinks.size(); i++) {
+        auto &res = sink_results.at(i);
+        // Skip sinks that already got a location from the path of an earlier sink
+        if (res.tile == -1 || sink_loc_tile[getWireIndex(sinks.at(i))] != -1)
+            continue;
+        sink_loc_tile[getWireIndex(sinks.at(i))] = res.tile;
+        for (auto wire : res.path)
+            if (sink_loc_tile[getWireIndex(wire)] == -1)
+                sink_loc_tile[getWireIndex(wire)] = res.tile;
+    }
+    for (size_t i = 0; i < sources.size(); i++) {
+        auto &res = source_results.at(i);
+        if (res.tile == -1 || source_locs.count(sources.at(i)))
+            continue;
+        Loc loc(res.tile % chip_info->width, res.tile / chip_info->width, 0);
+        source_locs[sources.at(i)] = loc;
+        for (auto wire : res.path)
+            if (!source_locs.count(wire))
+                source_locs[wire] = loc;
     }
-#endif
 }
 
 bool Arch::route()
@@ -984,6 +1658,8 @@ bool Arch::route()
         routeVcc();
     routeClock();
     findSourceSinkLocations();
+    if (getCtx()->setting<bool>("xilinx/pipCache", false))
+        setup_pip_cache();
 
     bool result;
     if (router == "router1") {
@@ -1000,23 +1676,58 @@ bool Arch::route()
         log_error("Xilinx architecture does not support router '%s'\n", router.c_str());
     }
     fixupRouting();
+    free_pip_cache();
     getCtx()->settings[getCtx()->id("route")] = 1;
     archInfoToAttributes();
     return result;
 }
 
+std::shared_ptr<Router2Job> Arch::reroute(const std::vector<IdString> &net_names,
+                                          const std::unordered_map<std::string, std::string> &options)
+{
+    for (IdString name : net_names)
+        if (!nets.count(name))
+            log_error("Net '%s' to reroute doesn't exist.\n", name.c_str(this));
+    // Only the locations of sources not seen before are found
+    findSourceSinkLocations();
+
+    // The options only apply to the configuration of this run, so the settings are put back as they were
+    std::unordered_map<IdString, Property> saved;
+    std::vector<IdString> added;
+    for (auto &opt : options) {
+        IdString key = id(opt.first);
+        auto found = settings.find(key);
+        if (found != settings.end())
+            saved[key] = found->second;
+        else
+            added.push_back(key);
+        settings[key] = opt.second;
+    }
+    auto cfg = Router2Cfg(getCtx());
+    // Same defaults as route
+    if (!options.count("router2/bbMargin/x"))
+        cfg.bb_margin_x = 4;
+    if (!options.count("router2/bbMargin/y"))
+        cfg.bb_margin_y = 4;
+    if (!options.count("router2/bwdMaxIter"))
+        cfg.backwards_max_iter = 200;
+    cfg.only_nets = net_names;
+    for (auto &s : saved)
+        settings[s.first] = s.second;
+    for (IdString key : added)
+        settings.erase(key);
+    return std::make_shared<Router2Job>(getCtx(), cfg, [this](bool) { archInfoToAttributes(); });
+}
+
 std::string Arch::getPackagePinSite(const std::string &pin) const
 {
-    if (pin_to_site.empty()) {
-        for (int t = 0; t < chip_info->num_tiles; t++) {
-            auto &tile = chip_info->tile_insts[t];
-            for (int s = 0; s < tile.num_sites; s++) {
-                auto &site = tile.site_insts[s];
-                if (site.pin[0] != '\0' && site.pin[0] != '.')
-                    pin_to_site[site.pin.get()] = site.name.get();
-            }
-        }
+    if (chip_info->version >= 3) {
+        const SiteRefPOD *found =
+                find_site_ref(chip_info, chip_info->sites_by_package_pin.get(), chip_info->num_package_pins, pin,
+                              [](const SiteInstInfoPOD &si) { return si.pin.get(); });
+        return found != nullptr ? chip_info->tile_insts[found->tile].site_insts[found->site].name.get() : "";
     }
+    setup_byname();
     auto site_iter = pin_to_site.find(pin);
     return site_iter != pin_to_site.end() ? site_iter->second : "";
 }
@@ -1153,49 +1864,39 @@ DecalXY Arch::getGroupDecal(GroupId pip) const { return {}; };
 
 bool Arch::getCellDelay(const CellInfo *cell, IdString fromPort, IdString toPort, DelayInfo &delay) const
 {
-    int tt_id = -1, inst_id = -1;
-    if (cell->bel != BelId()) {
-        tt_id = locInfo(cell->bel).timing_index;
-        inst_id = locInfo(cell->bel).bel_data[cell->bel.index].timing_inst;
+    bool is_mux =
+            cell->type == id_F7MUX || cell->type == id_F8MUX || cell->type == id_F9MUX || cell->type == id("SELMUX2_1");
+    if (xc7 && cell->bel != BelId() && (cell->type == id_SLICE_LUTX || cell->type == id_CARRY4 || is_mux)) {
+        if (cell->timing_bel != cell->bel || cell->timing_type != cell->type)
+            xc7_update_cell_timing(cell);
+        if (cell->timing_has_inst) {
+            if (cell->type == id_SLICE_LUTX) {
+                if (fromPort == id_CLK)
+                    return false;
+                if (cell->timing_is_lut5 && fromPort == id_A6)
+                    fromPort = id_A5;
+                if (cell->timing_is_lut5 && toPort == id_O6)
+                    toPort = id_O5;
+            }
+            return xc7_cell_timing_lookup(cell, fromPort, toPort, delay);
+        }
     }
 
     if (cell->type == id_SLICE_LUTX) {
-        if (xc7 && inst_id != -1) {
-            int z = locInfo(cell->bel).bel_data[cell->bel.index].z;
-            IdString tiletype = getBelTileType(cell->bel);
-            bool is_lut5 = (z & 0xF) == BEL_5LUT;
-            bool is_slicem = (tiletype == id_CLBLM_L || tiletype == ID_CLBLM_R) && (z < 64);
-            IdString variant = is_slicem ? (is_lut5 ? id("LUT_OR_MEM5LRAM") : id("LUT_OR_MEM6LRAM"))
-                                         : (is_lut5 ? id("LUT5") : id("LUT6"));
-
-            if (fromPort == id_CLK)
-                return false;
-            return xc7_cell_timing_lookup(tt_id, inst_id, variant, (is_lut5 && fromPort == id_A6) ? id_A5 : fromPort,
-                                          (is_lut5 && toPort == id_O6) ? id_O5 : toPort, delay);
-        }
-
         if (fromPort == id_A1 || fromPort == id_A2 || fromPort == id_A3 || fromPort == id_A4 || fromPort == id_A5 ||
             fromPort == id_A6) {
             if (toPort == id_O5 || toPort == id_O6) {
-                delay.delay = 200; // FIXME
+                delay.min_delay = delay.max_delay = 200; // FIXME
                 return true;
             }
         }
-    } else if (cell->type == id_CARRY4) {
-        if (xc7 && inst_id != -1) {
-            return xc7_cell_timing_lookup(tt_id, inst_id, id("CARRY4"), fromPort, toPort, delay);
-        }
-    } else if (cell->type == id_F7MUX || cell->type == id_F8MUX || cell->type == id_F9MUX ||
-               cell->type == id("SELMUX2_1")) {
-        if (xc7 && inst_id != -1) {
-            return xc7_cell_timing_lookup(tt_id, inst_id, cell->type, fromPort, toPort, delay);
-        }
-        delay.delay = 100;
+    } else if (is_mux) {
+        delay.min_delay = delay.max_delay = 100;
         return true;
     } else if (cell->type == id_BUFGCTRL) {
         if (fromPort == id("I0") || fromPort == id("I1"))
             if (toPort == id("O")) {
-                delay.delay = 200; // FIXME
+                delay.min_delay = delay.max_delay = 200; // FIXME
                 return true;
             }
     }
@@ -1313,27 +2014,72 @@ boost::optional<const Tres &> db_binary_search(const Tres *list, int count, Tget
 }
 } // namespace
 
-bool Arch::xc7_cell_timing_lookup(int tt_id, int inst_id, IdString variant, IdString from_port, IdString to_port,
-                                  DelayInfo &delay) const
+void Arch::xc7_update_cell_timing(const CellInfo *cell) const
 {
-    if (tt_id == -1 || inst_id == -1)
-        return false;
+    cell->timing_bel = cell->bel;
+    cell->timing_type = cell->type;
+    cell->timing_has_inst = false;
+    cell->timing_is_lut5 = false;
+    cell->timing_data = nullptr;
+    cell->timing_arcs.clear();
+
+    int tt_id = locInfo(cell->bel).timing_index;
+    int inst_id = locInfo(cell->bel).bel_data[cell->bel.index].timing_inst;
+    if (inst_id == -1)
+        return;
+    cell->timing_has_inst = true;
+    if (tt_id == -1)
+        return;
+
+    IdString variant = cell->type;
+    if (cell->type == id_SLICE_LUTX) {
+        int z = locInfo(cell->bel).bel_data[cell->bel.index].z;
+        IdString tiletype = getBelTileType(cell->bel);
+        bool is_slicem = (tiletype == id_CLBLM_L || tiletype == ID_CLBLM_R) && (z < 64);
+        cell->timing_is_lut5 = (z & 0xF) == BEL_5LUT;
+        variant = is_slicem ? (cell->timing_is_lut5 ? id("LUT_OR_MEM5LRAM") : id("LUT_OR_MEM6LRAM"))
+                            : (cell->timing_is_lut5 ? id("LUT5") : id("LUT6"));
+    }
+
     const InstanceTimingPOD &inst = chip_info->timing_data->tile_cell_timings[tt_id].instances[inst_id];
     auto found_var = db_binary_search(
             inst.celltypes.get(), inst.num_celltypes, [](const CellTimingPOD &ct) { return ct.variant_name; },
             variant.index);
-    if (!found_var)
-        return false;
+    if (found_var)
+        cell->timing_data = &*found_var;
+}
 
-    const CellTimingPOD &ct = *found_var;
-    auto found_delay = db_binary_search(
-            ct.delays.get(), ct.num_delays,
-            [](const CellPropDelayPOD &ct) { return std::make_pair(ct.to_port, ct.from_port); },
-            std::make_pair(to_port.index, from_port.index));
-    if (!found_delay)
-        return false;
-    delay.delay = found_delay->max_delay;
-    return true;
+bool Arch::xc7_cell_timing_lookup(const CellInfo *cell, IdString from_port, IdString to_port, DelayInfo &delay) const
+{
+    for (const auto &arc : cell->timing_arcs) {
+        if (arc.from_port == from_port && arc.to_port == to_port) {
+            if (arc.found) {
+                delay.min_delay = arc.min_delay;
+                delay.max_delay = arc.max_delay;
+            }
+            return arc.found;
+        }
+    }
+
+    CellDelayArc arc{from_port, to_port, 0, 0, false};
+    if (cell->timing_data != nullptr) {
+        const CellTimingPOD &ct = *cell->timing_data;
+        auto found_delay = db_binary_search(
+                ct.delays.get(), ct.num_delays,
+                [](const CellPropDelayPOD &ct) { return std::make_pair(ct.to_port, ct.from_port); },
+                std::make_pair(to_port.index, from_port.index));
+        if (found_delay) {
+            arc.min_delay = found_delay->min_delay;
+            arc.max_delay = found_delay->max_delay;
+            arc.found = true;
+        }
+    }
+    cell->timing_arcs.push_back(arc);
+    if (arc.found) {
+        delay.min_delay = arc.min_delay;
+        delay.max_delay = arc.max_delay;
+    }
+    return arc.found;
 }
 
 #ifdef WITH_HEAP
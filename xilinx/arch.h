@@ -27,6 +27,10 @@
 
 #include <iostream>
 
+#include "chipdb_cache.h"
+#include "chipdb_file.h"
+#include "delay_model.h"
+
 NEXTPNR_NAMESPACE_BEGIN
 
 /**** Everything in this section must be kept in sync with chipdb.py ****/
@@ -187,6 +191,9 @@ NPNR_PACKED_STRUCT(struct TileWireRefPOD {
     int32_t index;
 });
 
+// In version 2 chipdbs, and version 3 ones with CHIP_NODE_ORIGINS set, nodes of the same shape share one tile wire
+// list, with tile indices relative to the node's origin tile (ChipInfoPOD::node_origins). Use nodeTileWire() rather
+// than reading tile_wires directly.
 NPNR_PACKED_STRUCT(struct NodeInfoPOD {
     int32_t num_tile_wires;
     int32_t intent;
@@ -217,6 +224,11 @@ NPNR_PACKED_STRUCT(struct SiteInstInfoPOD {
     int32_t inter_x, inter_y;
 });
 
+NPNR_PACKED_STRUCT(struct SiteRefPOD {
+    int32_t tile;
+    int32_t site;
+});
+
 NPNR_PACKED_STRUCT(struct TileInstInfoPOD {
     RelPtr<char> name;
     int32_t type;
@@ -319,8 +331,26 @@ NPNR_PACKED_STRUCT(struct ChipInfoPOD {
 
     int32_t num_speed_grades;
     RelPtr<TimingDataPOD> timing_data;
+
+    // Only present from version 2: the tile index added to every tile in a node's shared tile wire list. In version 3
+    // it is only valid if flags has CHIP_NODE_ORIGINS set.
+    RelPtr<int32_t> node_origins;
+
+    // Only present from version 3: name indices, sorted by name in strcmp order so that tiles, sites and package
+    // pins can be looked up by binary search straight over the chipdb
+    int32_t flags;
+    RelPtr<int32_t> tiles_by_name;
+    int32_t num_sites;
+    RelPtr<SiteRefPOD> sites_by_name;
+    int32_t num_package_pins;
+    RelPtr<SiteRefPOD> sites_by_package_pin;
 });
 
+enum ChipInfoFlags
+{
+    CHIP_NODE_ORIGINS = 1
+};
+
 /************************ End of chipdb section. ************************/
 
 struct BelIterator
@@ -372,8 +402,83 @@ struct BelRange
     BelIterator end() const { return e; }
 };
 
+// Bels of each type, for getBelsByType. Bel types are numbered densely; the bels of type t in tiles of tile type tt
+// are bel_index[bel_start[tt * num_types + t]] to bel_index[bel_start[tt * num_types + t + 1]], and the tiles with any
+// are tiles[tile_start[t]] to tiles[tile_start[t + 1]].
+struct BelTypeIndex
+{
+    const ChipInfoPOD *chip = nullptr;
+    std::unordered_map<IdString, int32_t> type_idx;
+    int32_t num_types = 0;
+    std::vector<int32_t> bel_start, bel_index;
+    std::vector<int32_t> tile_start, tiles;
+
+    int32_t bel_range(int32_t tile, int32_t type) const { return chip->tile_insts[tile].type * num_types + type; }
+};
+
+struct BelTypeIterator
+{
+    const BelTypeIndex *idx;
+    int32_t type;
+    // Position in idx->tiles, and in idx->bel_index for the current tile
+    int32_t cursor_tile, cursor_bel = 0, bel_end = 0;
+
+    // Start at the first bel of the tile at cursor_tile, if there is one
+    void enter_tile()
+    {
+        cursor_bel = bel_end = 0;
+        if (cursor_tile < idx->tile_start[type + 1]) {
+            int32_t range = idx->bel_range(idx->tiles[cursor_tile], type);
+            cursor_bel = idx->bel_start[range];
+            bel_end = idx->bel_start[range + 1];
+        }
+    }
+
+    BelTypeIterator operator++()
+    {
+        if (++cursor_bel == bel_end) {
+            cursor_tile++;
+            enter_tile();
+        }
+        return *this;
+    }
+
+    bool operator!=(const BelTypeIterator &other) const
+    {
+        return cursor_tile != other.cursor_tile || cursor_bel != other.cursor_bel;
+    }
+
+    bool operator==(const BelTypeIterator &other) const
+    {
+        return cursor_tile == other.cursor_tile && cursor_bel == other.cursor_bel;
+    }
+
+    BelId operator*() const
+    {
+        BelId ret;
+        ret.tile = idx->tiles[cursor_tile];
+        ret.index = idx->bel_index[cursor_bel];
+        return ret;
+    }
+};
+
+struct BelTypeRange
+{
+    BelTypeIterator b, e;
+    BelTypeIterator begin() const { return b; }
+    BelTypeIterator end() const { return e; }
+};
+
 // -----------------------------------------------------------------------
 
+inline TileWireRefPOD nodeTileWire(const ChipInfoPOD *chip, int32_t node, int32_t i)
+{
+    TileWireRefPOD wr = chip->nodes[node].tile_wires[i];
+    if (chip->version == 2 || (chip->version >= 3 && (chip->flags & CHIP_NODE_ORIGINS)))
+        wr.tile += chip->node_origins[node];
+    return wr;
+}
+
 // Iterate over TileWires for a wire (will be more than one if nodal)
 struct TileWireIterator
 {
@@ -389,7 +494,7 @@ struct TileWireIterator
     {
         if (baseWire.tile == -1) {
             WireId tw;
-            const auto &node_wire = chip->nodes[baseWire.index].tile_wires[cursor];
+            TileWireRefPOD node_wire = nodeTileWire(chip, baseWire.index, cursor);
             tw.tile = node_wire.tile;
             tw.index = node_wire.index;
             return tw;
@@ -549,9 +654,15 @@ struct UphillPipIterator
     const ChipInfoPOD *chip;
     TileWireIterator twi, twi_end;
     int cursor = -1;
+    // Position in the flat pip cache, if built (see Arch::setup_pip_cache)
+    const PipId *cached = nullptr;
 
     void operator++()
     {
+        if (cached != nullptr) {
+            ++cached;
+            return;
+        }
         cursor++;
         while (true) {
             if (!(twi != twi_end))
@@ -564,10 +675,17 @@ struct UphillPipIterator
             cursor = 0;
         }
     }
-    bool operator!=(const UphillPipIterator &other) const { return twi != other.twi || cursor != other.cursor; }
+    bool operator!=(const UphillPipIterator &other) const
+    {
+        if (cached != nullptr)
+            return cached != other.cached;
+        return twi != other.twi || cursor != other.cursor;
+    }
 
     PipId operator*() const
     {
+        if (cached != nullptr)
+            return *cached;
         PipId ret;
         WireId w = *twi;
         ret.tile = w.tile;
@@ -588,9 +706,15 @@ struct DownhillPipIterator
     const ChipInfoPOD *chip;
     TileWireIterator twi, twi_end;
     int cursor = -1;
+    // Position in the flat pip cache, if built (see Arch::setup_pip_cache)
+    const PipId *cached = nullptr;
 
     void operator++()
     {
+        if (cached != nullptr) {
+            ++cached;
+            return;
+        }
         cursor++;
         while (true) {
             if (!(twi != twi_end))
@@ -603,10 +727,17 @@ struct DownhillPipIterator
             cursor = 0;
         }
     }
-    bool operator!=(const DownhillPipIterator &other) const { return twi != other.twi || cursor != other.cursor; }
+    bool operator!=(const DownhillPipIterator &other) const
+    {
+        if (cached != nullptr)
+            return cached != other.cached;
+        return twi != other.twi || cursor != other.cursor;
+    }
 
     PipId operator*() const
     {
+        if (cached != nullptr)
+            return *cached;
         PipId ret;
         WireId w = *twi;
         ret.tile = w.tile;
@@ -662,22 +793,84 @@ struct BelPinRange
     BelPinIterator end() const { return e; }
 };
 
+class Router2Job;
+
 struct ArchArgs
 {
     std::string chipdb;
+    // File to cache tables derived from the chipdb in, if not empty
+    std::string chipdb_cache;
+    ChipdbLoadMode chipdb_load = ChipdbLoadMode::MMAP;
 };
 
+// The const methods may be called from several threads at once, while nothing is bound or unbound; the tables they
+// fill in lazily are built under std::call_once
 struct Arch : BaseCtx
 {
-    boost::iostreams::mapped_file_source blob_file;
+    ChipdbFile blob_file;
     const ChipInfoPOD *chip_info;
+    ChipdbCache chipdb_cache;
 
+    // Name lookup tables for chipdbs before version 3, which have no name indices, built once by setup_byname()
     mutable std::unordered_map<std::string, int> tile_by_name;
     mutable std::unordered_map<std::string, std::pair<int, int>> site_by_name;
 
-    dict<WireId, NetInfo *> wire_to_net;
-    dict<PipId, NetInfo *> pip_to_net;
-    dict<WireId, std::pair<int, int>> driving_pip_loc;
+    // Dense binding store. Tile wires and pips use per-tile arrays, node wires fixed size pages of node indices;
+    // each array is only allocated on the first bind that touches it
+    struct WireBinding
+    {
+        NetInfo *net = nullptr;
+        // Tile of the last pip bound driving this wire, or -1
+        int32_t driving_pip_tile = -1;
+    };
+    static const int node_binding_page_bits = 12;
+    std::vector<std::vector<WireBinding>> tile_wire_bindings, node_wire_bindings;
+    std::vector<std::vector<NetInfo *>> tile_pip_bindings;
+
+    const WireBinding *getWireBinding(WireId wire) const
+    {
+        const auto &page = wire.tile == -1 ? node_wire_bindings[wire.index >> node_binding_page_bits]
+                                           : tile_wire_bindings[wire.tile];
+        if (page.empty())
+            return nullptr;
+        return &page[wire.tile == -1 ? (wire.index & ((1 << node_binding_page_bits) - 1)) : wire.index];
+    }
+
+    WireBinding &wireBinding(WireId wire)
+    {
+        if (wire.tile == -1) {
+            auto &page = node_wire_bindings[wire.index >> node_binding_page_bits];
+            if (page.empty())
+                page.resize(1 << node_binding_page_bits);
+            return page[wire.index & ((1 << node_binding_page_bits) - 1)];
+        } else {
+            auto &tile = tile_wire_bindings[wire.tile];
+            if (tile.empty())
+                tile.resize(chip_info->tile_types[chip_info->tile_insts[wire.tile].type].num_wires);
+            return tile[wire.index];
+        }
+    }
+
+    NetInfo *getPipBinding(PipId pip) const
+    {
+        const auto &tile = tile_pip_bindings[pip.tile];
+        return tile.empty() ? nullptr : tile[pip.index];
+    }
+
+    NetInfo *&pipBinding(PipId pip)
+    {
+        auto &tile = tile_pip_bindings[pip.tile];
+        if (tile.empty())
+            tile.resize(chip_info->tile_types[chip_info->tile_insts[pip.tile].type].num_pips);
+        return tile[pip.index];
+    }
+
+    NetInfo *getWireNet(WireId wire) const
+    {
+        const WireBinding *b = getWireBinding(wire);
+        return b == nullptr ? nullptr : b->net;
+    }
+
     dict<WireId, NetInfo *> reserved_wires;
 
     struct LogicTileStatus
@@ -694,6 +887,11 @@ struct Arch : BaseCtx
         {
             bool valid = true, dirty = true;
         } halfs[8];
+        // FFs bound in each half-tile, as a bit per FF ((z % 4) * 2 + k), and their interned control sets and CEs
+        uint8_t ff_used[2] = {0, 0}, ff_latch[2] = {0, 0};
+        int ff_ctrl_set[16], ff_ce[16];
+        // Result of the last whole-tile check, only recomputed (for the dirty sections) after a change
+        bool tile_valid = true, tile_dirty = true;
     };
 
     struct BRAMTileStatus
@@ -701,12 +899,11 @@ struct Arch : BaseCtx
         CellInfo *cells[12] = {nullptr};
     };
 
+    // Per-tile placement state, only allocated for logic and BRAM tiles once a bel in them is first bound
     struct TileStatus
     {
         LogicTileStatus *lts = nullptr;
         BRAMTileStatus *bts = nullptr;
-        std::vector<CellInfo *> boundcells;
-        std::vector<int> sitevariant;
 
         ~TileStatus()
         {
@@ -717,6 +914,54 @@ struct Arch : BaseCtx
 
     std::vector<TileStatus> tileStatus;
 
+    // Bound cell of every bel and the variant of every site in use, for all tiles in one array each. The bels and
+    // sites of tile i start at tile_bel_start[i] and tile_site_start[i]; both have an extra entry for the end.
+    std::vector<CellInfo *> bel_to_cell;
+    std::vector<int> site_variant;
+    std::vector<int> tile_bel_start, tile_site_start;
+
+    int getBelFlatIndex(BelId bel) const { return tile_bel_start[bel.tile] + bel.index; }
+
+    // Clock regions, see setup_clock_regions: the region of each tile (empty if the device has none we know of), and
+    // per region the number of bound cells using each global clock net, updated by bindBel and unbindBel. Regions
+    // may be updated from several threads at once by the parallel legaliser.
+    struct ClockRegionStatus
+    {
+        std::mutex mtx;
+        std::unordered_map<const NetInfo *, int> users;
+        std::atomic<int> distinct{0};
+    };
+    std::vector<int> tile_clock_region;
+    std::unique_ptr<ClockRegionStatus[]> clock_regions;
+    int max_region_clocks = 0;
+    void setup_clock_regions();
+    void updateClockRegion(BelId bel, const CellInfo *cell, int delta);
+    // False if the cell at bel uses a global clock and its clock region has more of them than it can distribute
+    bool clockRegionValid(BelId bel) const
+    {
+        if (tile_clock_region.empty() || tile_clock_region[bel.tile] < 0 ||
+            clock_regions[tile_clock_region[bel.tile]].distinct <= max_region_clocks)
+            return true;
+        const CellInfo *cell = getBoundBelCell(bel);
+        return cell == nullptr || cell->global_clocks.empty();
+    }
+    // SLRs of multi-die (SSI) devices, see setup_slrs: the first tile row of every SLR after the first one, in row
+    // order; empty for single-die devices. Crossing between SLRs costs slr_crossing_delay, over the Laguna wires.
+    std::vector<int> slr_boundaries;
+    static const delay_t slr_crossing_delay = 5000;
+    void setup_slrs();
+    int getSlr(int y) const
+    {
+        return int(std::upper_bound(slr_boundaries.begin(), slr_boundaries.end(), y) - slr_boundaries.begin());
+    }
+    int slrCrossings(int y0, int y1) const { return std::abs(getSlr(y0) - getSlr(y1)); }
+    bool isBufgNet(const NetInfo *ni) const
+    {
+        return ni != nullptr && ni->driver.cell != nullptr && ni->driver.port == cell_info_ids.bufg_o &&
+               (ni->driver.cell->type == id_BUFGCTRL || ni->driver.cell->type == id_BUFCE_BUFG_PS ||
+                ni->driver.cell->type == id_BUFCE_BUFCE || ni->driver.cell->type == id_BUFGCE_DIV_BUFGCE_DIV);
+    }
+
     ArchArgs args;
     Arch(ArchArgs args);
 
@@ -738,6 +983,11 @@ struct Arch : BaseCtx
     // -------------------------------------------------
 
     void setup_byname() const;
+    mutable std::once_flag byname_once;
+    // Tile index by name, or -1 if there is no such tile
+    int findTileByName(const std::string &name) const;
+    // Tile and site index of a site by name; false if there is no such site
+    bool findSiteByName(const std::string &name, int &tile, int &site) const;
 
     BelId getBelByName(IdString name) const;
 
@@ -764,6 +1014,7 @@ struct Arch : BaseCtx
         if (tts.lts == nullptr)
             tts.lts = new LogicTileStatus();
         auto &ts = *(tts.lts);
+        ts.tile_dirty = true;
         if ((z == (((xc7 ? 3 : 7) << 4) | BEL_6LUT)) || (z == (((xc7 ? 3 : 7) << 4) | BEL_5LUT))) {
             if ((cell != nullptr && cell->lutInfo.is_memory) ||
                 (ts.cells[z] != nullptr && ts.cells[z]->lutInfo.is_memory)) {
@@ -786,10 +1037,21 @@ struct Arch : BaseCtx
         // determine which sections to mark as dirty
         switch (z & 0xF) {
         case BEL_FF:
-        case BEL_FF2:
-            ts.halfs[(z >> 4) / 4].dirty = true;
-            if ((((z >> 4) / 4) == 0) && xc7)
+        case BEL_FF2: {
+            int half = (z >> 4) / 4, slot = ((z >> 4) % 4) * 2 + ((z & 0xF) - BEL_FF);
+            ts.ff_used[half] &= ~(1 << slot);
+            ts.ff_latch[half] &= ~(1 << slot);
+            if (cell != nullptr) {
+                ts.ff_used[half] |= (1 << slot);
+                if (cell->ffInfo.is_latch)
+                    ts.ff_latch[half] |= (1 << slot);
+                ts.ff_ctrl_set[half * 8 + slot] = cell->ffInfo.ctrl_set;
+                ts.ff_ce[half * 8 + slot] = cell->ffInfo.ce_id;
+            }
+            ts.halfs[half].dirty = true;
+            if (half == 0 && xc7)
                 ts.eights[3].dirty = true;
+        }
         /* fall-through */
         case BEL_6LUT:
         case BEL_5LUT:
@@ -837,13 +1099,14 @@ struct Arch : BaseCtx
     void bindBel(BelId bel, CellInfo *cell, PlaceStrength strength)
     {
         NPNR_ASSERT(bel != BelId());
-        NPNR_ASSERT(tileStatus[bel.tile].boundcells[bel.index] == nullptr);
+        CellInfo *&bound = bel_to_cell[getBelFlatIndex(bel)];
+        NPNR_ASSERT(bound == nullptr);
 
-        tileStatus[bel.tile].boundcells[bel.index] = cell;
+        bound = cell;
         auto &bd = locInfo(bel).bel_data[bel.index];
         int site = bd.site;
-        if (site >= 0 && site < int(tileStatus[bel.tile].sitevariant.size()))
-            tileStatus[bel.tile].sitevariant.at(site) = bd.site_variant;
+        if (site >= 0 && site < tile_site_start[bel.tile + 1] - tile_site_start[bel.tile])
+            site_variant[tile_site_start[bel.tile] + site] = bd.site_variant;
         cell->bel = bel;
         cell->belStrength = strength;
         refreshUiBel(bel);
@@ -852,15 +1115,20 @@ struct Arch : BaseCtx
             updateLogicBel(bel, cell);
         else if (isBRAMTile(bel))
             updateBramBel(bel, cell);
+        if (!cell->global_clocks.empty())
+            updateClockRegion(bel, cell, 1);
     }
 
     void unbindBel(BelId bel)
     {
         NPNR_ASSERT(bel != BelId());
-        NPNR_ASSERT(tileStatus[bel.tile].boundcells[bel.index] != nullptr);
-        tileStatus[bel.tile].boundcells[bel.index]->bel = BelId();
-        tileStatus[bel.tile].boundcells[bel.index]->belStrength = STRENGTH_NONE;
-        tileStatus[bel.tile].boundcells[bel.index] = nullptr;
+        CellInfo *&bound = bel_to_cell[getBelFlatIndex(bel)];
+        NPNR_ASSERT(bound != nullptr);
+        if (!bound->global_clocks.empty())
+            updateClockRegion(bel, bound, -1);
+        bound->bel = BelId();
+        bound->belStrength = STRENGTH_NONE;
+        bound = nullptr;
         refreshUiBel(bel);
 
         if (isLogicTile(bel))
@@ -884,19 +1152,19 @@ struct Arch : BaseCtx
         if (usp_bel_hard_unavail(bel))
             return false;
         NPNR_ASSERT(bel != BelId());
-        return tileStatus[bel.tile].boundcells[bel.index] == nullptr;
+        return bel_to_cell[getBelFlatIndex(bel)] == nullptr;
     }
 
     CellInfo *getBoundBelCell(BelId bel) const
     {
         NPNR_ASSERT(bel != BelId());
-        return tileStatus[bel.tile].boundcells[bel.index];
+        return bel_to_cell[getBelFlatIndex(bel)];
     }
 
     CellInfo *getConflictingBelCell(BelId bel) const
     {
         NPNR_ASSERT(bel != BelId());
-        return tileStatus[bel.tile].boundcells[bel.index];
+        return bel_to_cell[getBelFlatIndex(bel)];
     }
 
     BelRange getBels() const
@@ -912,6 +1180,11 @@ struct Arch : BaseCtx
         return range;
     }
 
+    BelTypeIndex bel_type_index;
+    void setup_bel_type_index();
+    // All bels of a type, by tile
+    BelTypeRange getBelsByType(IdString type) const;
+
     Loc getBelLocation(BelId bel) const
     {
         NPNR_ASSERT(bel != BelId());
@@ -946,38 +1219,98 @@ struct Arch : BaseCtx
     PortType getBelPinType(BelId bel, IdString pin) const;
     std::vector<IdString> getBelPins(BelId bel) const;
 
+    // Bel pins of each tile type sorted by port constid, for bels with too many pins to search linearly. The pins
+    // of bel i are pins[start[i]] to pins[start[i + 1]], as (port, index into bel_wires)
+    struct TileTypeBelPins
+    {
+        std::vector<int32_t> start;
+        std::vector<std::pair<int32_t, int32_t>> pins;
+    };
+    std::vector<TileTypeBelPins> tile_type_bel_pins;
+    void setup_bel_pin_index();
+    // Index into bel_wires of a pin of a bel, or -1
+    int findBelPin(BelId bel, IdString pin) const;
+
     bool isBelLocked(BelId bel) const;
 
     // -------------------------------------------------
 
-    mutable std::unordered_map<IdString, WireId> wire_by_name_cache;
+    // Sorted name keys of the wires and pips of a tile type, for reverse name lookups. Wires are keyed by
+    // (site, name), site pips by (site, bel, pin) and tile pips by (-1, src wire, dst wire).
+    struct NameIndexEntry
+    {
+        int32_t a, b, c, index;
+        bool operator<(const NameIndexEntry &other) const
+        {
+            return std::tie(a, b, c, index) < std::tie(other.a, other.b, other.c, other.index);
+        }
+    };
+    struct TileTypeNameIndex
+    {
+        std::vector<NameIndexEntry> wires, pips;
+    };
+    // Built the first time each tile type is looked up, under the once flag of the type
+    mutable std::vector<std::unique_ptr<TileTypeNameIndex>> tile_type_names;
+    std::unique_ptr<std::once_flag[]> tile_type_names_once;
+    const TileTypeNameIndex &getTileTypeNameIndex(int type) const;
+    static int32_t findNameIndex(const std::vector<NameIndexEntry> &entries, int32_t a, int32_t b, int32_t c);
+
+    // Name checks for the parallel archcheck, over a range of tile types, tiles or nodes; each appends one line per
+    // object whose name would not look up to the same object again. Safe to call from several threads.
+    void archcheckTileTypeNames(int begin, int end, std::vector<std::string> &failures) const;
+    void archcheckTileNames(int begin, int end, std::vector<std::string> &failures) const;
+    void archcheckNodeNames(int begin, int end, std::vector<std::string> &failures) const;
+
+    // Dense wire numbering, for algorithms that want flat per-wire arrays rather than hash maps.
+    // Nodes come first, followed by the wires of each tile in tile order; tile wires that are
+    // part of a node are never returned by getWires() and leave a hole in the numbering.
+    std::vector<int32_t> tile_wire_index_base;
+    int32_t wire_index_count;
+
+    void setup_wire_index();
+
+    int32_t getWireIndex(WireId wire) const
+    {
+        NPNR_ASSERT(wire != WireId());
+        return wire.tile == -1 ? wire.index : tile_wire_index_base[wire.tile] + wire.index;
+    }
+
+    int32_t getWireIndexCount() const { return wire_index_count; }
+
+    // The wire with a dense index, or WireId() for the holes left by tile wires that are part of a node. Unlike
+    // getWires(), ranges of indices can be walked independently, e.g. to visit all wires from several threads.
+    WireId getWireByIndex(int32_t idx) const;
+
+    // Optional flat routing graph: the downhill and uphill pips of every wire in CSR form, indexed by
+    // getWireIndex, so that router expansion is a linear scan rather than a walk over the tile wires of a node.
+    // Built before routing if the xilinx/pipCache setting is enabled, and freed again afterwards.
+    std::vector<int32_t> downhill_cache_start, uphill_cache_start;
+    std::vector<PipId> downhill_cache, uphill_cache;
+
+    void setup_pip_cache();
+    void free_pip_cache();
+    size_t pip_cache_memory() const;
 
     WireId getWireByName(IdString name) const;
 
     const TileWireInfoPOD &wireInfo(WireId wire) const
     {
         if (wire.tile == -1) {
-            const TileWireRefPOD &wr = chip_info->nodes[wire.index].tile_wires[0];
+            TileWireRefPOD wr = nodeTileWire(chip_info, wire.index, 0);
             return chip_info->tile_types[chip_info->tile_insts[wr.tile].type].wire_data[wr.index];
         } else {
             return locInfo(wire).wire_data[wire.index];
         }
     }
 
+    // Append the name of a wire to a string, without creating an IdString for it
+    void appendWireName(std::string &out, WireId wire) const;
+
     IdString getWireName(WireId wire) const
     {
-        NPNR_ASSERT(wire != WireId());
-        if (wire.tile != -1 && locInfo(wire).wire_data[wire.index].site != -1) {
-            return id(std::string("SITEWIRE/") +
-                      chip_info->tile_insts[wire.tile].site_insts[locInfo(wire).wire_data[wire.index].site].name.get() +
-                      std::string("/") + IdString(locInfo(wire).wire_data[wire.index].name).str(this));
-        } else {
-            return id(std::string(chip_info
-                                          ->tile_insts[wire.tile == -1 ? chip_info->nodes[wire.index].tile_wires[0].tile
-                                                                       : wire.tile]
-                                          .name.get()) +
-                      "/" + IdString(wireInfo(wire).name).c_str(this));
-        }
+        std::string name;
+        appendWireName(name, wire);
+        return id(name);
     }
 
     IdString getWireType(WireId wire) const;
@@ -988,37 +1321,40 @@ struct Arch : BaseCtx
     void bindWire(WireId wire, NetInfo *net, PlaceStrength strength)
     {
         NPNR_ASSERT(wire != WireId());
-        NPNR_ASSERT(wire_to_net[wire] == nullptr);
-        wire_to_net[wire] = net;
+        NetInfo *&bound = wireBinding(wire).net;
+        NPNR_ASSERT(bound == nullptr);
+        bound = net;
         net->wires[wire].pip = PipId();
         net->wires[wire].strength = strength;
+        net->route_version++;
         refreshUiWire(wire);
     }
 
     void unbindWire(WireId wire)
     {
         NPNR_ASSERT(wire != WireId());
-        NPNR_ASSERT(wire_to_net[wire] != nullptr);
+        NetInfo *&bound = wireBinding(wire).net;
+        NPNR_ASSERT(bound != nullptr);
 
-        auto &net_wires = wire_to_net[wire]->wires;
+        auto &net_wires = bound->wires;
         auto it = net_wires.find(wire);
         NPNR_ASSERT(it != net_wires.end());
 
         auto pip = it->second.pip;
         if (pip != PipId()) {
-            pip_to_net[pip] = nullptr;
+            pipBinding(pip) = nullptr;
         }
 
         net_wires.erase(it);
-        wire_to_net[wire] = nullptr;
+        bound->route_version++;
+        bound = nullptr;
         refreshUiWire(wire);
     }
 
     bool checkWireAvail(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        auto w2n = wire_to_net.find(wire);
-        return w2n == wire_to_net.end() || w2n->second == nullptr;
+        return getWireNet(wire) == nullptr;
     }
 
     NetInfo *getReservedWireNet(WireId wire) const
@@ -1031,8 +1367,7 @@ struct Arch : BaseCtx
     NetInfo *getBoundWireNet(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        auto w2n = wire_to_net.find(wire);
-        return w2n == wire_to_net.end() ? nullptr : w2n->second;
+        return getWireNet(wire);
     }
 
     WireId getConflictingWireWire(WireId wire) const { return wire; }
@@ -1040,14 +1375,12 @@ struct Arch : BaseCtx
     NetInfo *getConflictingWireNet(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        auto w2n = wire_to_net.find(wire);
-        return w2n == wire_to_net.end() ? nullptr : w2n->second;
+        return getWireNet(wire);
     }
 
     DelayInfo getWireDelay(WireId wire) const
     {
         DelayInfo delay;
-        delay.delay = 0;
         return delay;
     }
 
@@ -1099,24 +1432,25 @@ struct Arch : BaseCtx
 
     // -------------------------------------------------
 
-    mutable std::unordered_map<IdString, PipId> pip_by_name_cache;
-
     PipId getPipByName(IdString name) const;
 
     void bindPip(PipId pip, NetInfo *net, PlaceStrength strength)
     {
         NPNR_ASSERT(pip != PipId());
-        NPNR_ASSERT(pip_to_net[pip] == nullptr);
+        NetInfo *&bound_pip = pipBinding(pip);
+        NPNR_ASSERT(bound_pip == nullptr);
 
         WireId dst = canonicalWireId(chip_info, pip.tile, locInfo(pip).pip_data[pip.index].dst_index);
-        NPNR_ASSERT(wire_to_net[dst] == nullptr || wire_to_net[dst] == net);
+        WireBinding &dst_binding = wireBinding(dst);
+        NPNR_ASSERT(dst_binding.net == nullptr || dst_binding.net == net);
 
-        pip_to_net[pip] = net;
-        driving_pip_loc[dst] = std::make_pair(pip.tile % chip_info->width, pip.tile / chip_info->width);
+        bound_pip = net;
+        dst_binding.driving_pip_tile = pip.tile;
 
-        wire_to_net[dst] = net;
+        dst_binding.net = net;
         net->wires[dst].pip = pip;
         net->wires[dst].strength = strength;
+        net->route_version++;
         refreshUiPip(pip);
         refreshUiWire(dst);
     }
@@ -1124,25 +1458,32 @@ struct Arch : BaseCtx
     void unbindPip(PipId pip)
     {
         NPNR_ASSERT(pip != PipId());
-        NPNR_ASSERT(pip_to_net[pip] != nullptr);
+        NetInfo *&bound_pip = pipBinding(pip);
+        NPNR_ASSERT(bound_pip != nullptr);
 
         WireId dst = canonicalWireId(chip_info, pip.tile, locInfo(pip).pip_data[pip.index].dst_index);
-        NPNR_ASSERT(wire_to_net[dst] != nullptr);
-        wire_to_net[dst] = nullptr;
-        pip_to_net[pip]->wires.erase(dst);
+        WireBinding &dst_binding = wireBinding(dst);
+        NPNR_ASSERT(dst_binding.net != nullptr);
+        dst_binding.net = nullptr;
+        bound_pip->wires.erase(dst);
+        bound_pip->route_version++;
 
-        pip_to_net[pip] = nullptr;
+        bound_pip = nullptr;
         refreshUiPip(pip);
         refreshUiWire(dst);
     }
 
-    dict<int, pool<int>> blacklist_pips;
+    // Pips that must never be used, as one bit per pip of each tile type index; types without any have an empty vector
+    std::vector<std::vector<bool>> blacklist_pips;
     void setup_pip_blacklist();
 
     bool usp_pip_hard_unavail(PipId pip) const
     {
-        if (blacklist_pips.count(locInfo(pip).type) && blacklist_pips.at(locInfo(pip).type).count(pip.index))
-            return true;
+        if (!blacklist_pips.empty()) {
+            auto &type_blacklist = blacklist_pips[chip_info->tile_insts[pip.tile].type];
+            if (!type_blacklist.empty() && type_blacklist[pip.index])
+                return true;
+        }
         if (locInfo(pip).pip_data[pip.index].flags == PIP_SITE_ENTRY) {
             WireId dst = getPipDstWire(pip);
             if (dst.tile != -1) {
@@ -1162,8 +1503,8 @@ struct Arch : BaseCtx
             auto &pd = locInfo(pip).pip_data[pip.index];
             if (pd.bel == ID_TRIBUF)
                 return true;
-            if (pd.site >= 0 && pd.site <= int(tileStatus[pip.tile].sitevariant.size()))
-                if (pd.site_variant > 0 && pd.site_variant != tileStatus[pip.tile].sitevariant.at(pd.site))
+            if (pd.site >= 0 && pd.site < tile_site_start[pip.tile + 1] - tile_site_start[pip.tile])
+                if (pd.site_variant > 0 && pd.site_variant != site_variant[tile_site_start[pip.tile] + pd.site])
                     return true;
         } else if (locInfo(pip).pip_data[pip.index].flags == PIP_LUT_PERMUTATION) {
             LogicTileStatus *lts = tileStatus[pip.tile].lts;
@@ -1174,6 +1515,8 @@ struct Arch : BaseCtx
             if (((locInfo(pip).pip_data[pip.index].extra_data >> 4) & 0xF) ==
                 (locInfo(pip).pip_data[pip.index].extra_data & 0xF))
                 return false; // from==to, always valid
+            if (lut_permutations_fixed)
+                return true;
 
             const CellInfo *lut6 = lts->cells[(eight << 4) | BEL_6LUT];
             if (lut6 != nullptr && (lut6->lutInfo.is_memory || lut6->lutInfo.is_srl))
@@ -1210,14 +1553,13 @@ struct Arch : BaseCtx
         NPNR_ASSERT(pip != PipId());
         if (usp_pip_hard_unavail(pip))
             return false;
-        return pip_to_net.find(pip) == pip_to_net.end() || pip_to_net.at(pip) == nullptr;
+        return getPipBinding(pip) == nullptr;
     }
 
     NetInfo *getBoundPipNet(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        auto p2n = pip_to_net.find(pip);
-        return p2n == pip_to_net.end() ? nullptr : p2n->second;
+        return getPipBinding(pip);
     }
 
     WireId getConflictingPipWire(PipId pip) const
@@ -1232,8 +1574,7 @@ struct Arch : BaseCtx
         if (usp_pip_hard_unavail(pip))
             return nullptr;
         NPNR_ASSERT(pip != PipId());
-        auto p2n = pip_to_net.find(pip);
-        return p2n == pip_to_net.end() ? nullptr : p2n->second;
+        return getPipBinding(pip);
     }
 
     AllPipRange getPips() const
@@ -1258,7 +1599,15 @@ struct Arch : BaseCtx
         return loc;
     }
 
-    IdString getPipName(PipId pip) const;
+    // Append the name of a pip to a string, without creating an IdString for it
+    void appendPipName(std::string &out, PipId pip) const;
+
+    IdString getPipName(PipId pip) const
+    {
+        std::string name;
+        appendPipName(name, pip);
+        return id(name);
+    }
 
     IdString getPipType(PipId pip) const;
     std::vector<std::pair<IdString, std::string>> getPipAttrs(PipId pip) const;
@@ -1370,51 +1719,50 @@ struct Arch : BaseCtx
         DelayInfo delay;
         NPNR_ASSERT(pip != PipId());
         if (locInfo(pip).pip_data[pip.index].flags == PIP_TILE_ROUTING) {
-            int src_intent = wireIntent(getPipSrcWire(pip)), dst_intent = wireIntent(getPipDstWire(pip));
-            if (src_intent == ID_NODE_GLOBAL_VDISTR || src_intent == ID_NODE_GLOBAL_HROUTE ||
-                src_intent == ID_NODE_GLOBAL_VROUTE || src_intent == ID_NODE_GLOBAL_HDISTR ||
-                src_intent == ID_NODE_GLOBAL_LEAF || src_intent == ID_NODE_GLOBAL_BUFG) {
-
-                if (dst_intent == ID_NODE_LOCAL || dst_intent == ID_NODE_HLONG || dst_intent == ID_NODE_VLONG ||
-                    dst_intent == ID_NODE_VQUAD || dst_intent == ID_NODE_HQUAD) {
+            uint8_t src_class = intentInfo(wireIntent(getPipSrcWire(pip))).flags;
+            uint8_t dst_class = intentInfo(wireIntent(getPipDstWire(pip))).flags;
+            if (src_class & INTENT_GLOBAL) {
+                if (dst_class & INTENT_LOCAL) {
                     // Assign a high penalty from global to local
-                    delay.delay = 250;
+                    delay.min_delay = delay.max_delay = 250;
                 } else {
-                    delay.delay = 100;
+                    delay.min_delay = delay.max_delay = 100;
                 }
-            } else if (dst_intent == ID_NODE_LAGUNA_DATA) {
-                delay.delay = 5000;
+            } else if (dst_class & INTENT_LAGUNA) {
+                delay.min_delay = delay.max_delay = slr_crossing_delay;
             } else {
                 const delay_t pip_epsilon = 35;
                 auto &pip_data = locInfo(pip).pip_data[pip.index];
                 auto &pip_timing = chip_info->timing_data->pip_timing_classes[pip_data.timing_class];
                 int src_len = 1;
-                auto found_srcloc = driving_pip_loc.find(getPipSrcWire(pip));
-                if (found_srcloc != driving_pip_loc.end()) {
-                    src_len =
-                            std::max(1, std::abs(found_srcloc->second.first - (pip.tile % chip_info->width)) +
-                                                std::abs(found_srcloc->second.second - (pip.tile / chip_info->width)));
+                const WireBinding *src_binding = getWireBinding(getPipSrcWire(pip));
+                if (src_binding != nullptr && src_binding->driving_pip_tile != -1) {
+                    int drv_tile = src_binding->driving_pip_tile;
+                    src_len = std::max(1, std::abs(drv_tile % chip_info->width - (pip.tile % chip_info->width)) +
+                                                  std::abs(drv_tile / chip_info->width - (pip.tile / chip_info->width)));
                 }
                 auto &src_timing =
                         chip_info->timing_data
                                 ->wire_timing_classes[locInfo(pip).wire_data[pip_data.src_index].timing_class];
-                delay_t pip_delay =
-                        pip_timing.max_delay + delay_t((float(src_len * src_timing.resistance + pip_timing.resistance) *
-                                                        pip_timing.capacitance) /
-                                                       1e9);
+                // The RC terms are the same for both corners
+                delay_t rc_delay = delay_t(
+                        (float(src_len * src_timing.resistance + pip_timing.resistance) * pip_timing.capacitance) /
+                        1e9);
                 if (!pip_timing.is_buffered) {
                     auto &dst_timing =
                             chip_info->timing_data
                                     ->wire_timing_classes[locInfo(pip).wire_data[pip_data.dst_index].timing_class];
-                    pip_delay += delay_t(
+                    rc_delay += delay_t(
                             (float(src_timing.resistance + pip_timing.resistance) * dst_timing.capacitance) / 1e9);
                 }
-                delay.delay = std::max(pip_delay, pip_epsilon);
+                delay.max_delay = std::max<delay_t>(pip_timing.max_delay + rc_delay, pip_epsilon);
+                delay.min_delay = std::max<delay_t>(std::min(pip_timing.min_delay, pip_timing.max_delay) + rc_delay,
+                                                    pip_epsilon);
             }
         } else if (locInfo(pip).pip_data[pip.index].flags == PIP_LUT_ROUTETHRU) {
-            delay.delay = 300;
+            delay.min_delay = delay.max_delay = 300;
         } else
-            delay.delay = 25;
+            delay.min_delay = delay.max_delay = 25;
         return delay;
     }
 
@@ -1422,6 +1770,12 @@ struct Arch : BaseCtx
     {
         DownhillPipRange range;
         NPNR_ASSERT(wire != WireId());
+        if (!downhill_cache_start.empty()) {
+            int32_t idx = getWireIndex(wire);
+            range.b.cached = downhill_cache.data() + downhill_cache_start[idx];
+            range.e.cached = downhill_cache.data() + downhill_cache_start[idx + 1];
+            return range;
+        }
         TileWireRange twr = getTileWireRange(wire);
         range.b.chip = chip_info;
         range.b.twi = twr.b;
@@ -1439,6 +1793,12 @@ struct Arch : BaseCtx
     {
         UphillPipRange range;
         NPNR_ASSERT(wire != WireId());
+        if (!uphill_cache_start.empty()) {
+            int32_t idx = getWireIndex(wire);
+            range.b.cached = uphill_cache.data() + uphill_cache_start[idx];
+            range.e.cached = uphill_cache.data() + uphill_cache_start[idx + 1];
+            return range;
+        }
         TileWireRange twr = getTileWireRange(wire);
         range.b.chip = chip_info;
         range.b.twi = twr.b;
@@ -1473,7 +1833,7 @@ struct Arch : BaseCtx
     std::vector<GroupId> getGroupGroups(GroupId group) const { return {}; }
 
     // -------------------------------------------------
-    mutable IdString gnd_glbl, gnd_row, vcc_glbl, vcc_row;
+    IdString gnd_glbl, gnd_row, vcc_glbl, vcc_row;
     delay_t estimateDelay(WireId src, WireId dst, bool debug = false) const;
     delay_t predictDelay(const NetInfo *net_info, const PortRef &sink) const;
     ArcBounds getRouteBoundingBox(WireId src, WireId dst) const;
@@ -1485,7 +1845,7 @@ struct Arch : BaseCtx
     DelayInfo getDelayFromNS(float ns) const
     {
         DelayInfo del;
-        del.delay = delay_t(ns * 1000);
+        del.min_delay = del.max_delay = delay_t(ns * 1000);
         return del;
     }
     uint32_t getDelayChecksum(delay_t v) const { return v; }
@@ -1496,6 +1856,10 @@ struct Arch : BaseCtx
     bool pack();
     bool place();
     bool route();
+    // Rip up and route again the given nets of a routed design in the background, keeping the routing of the rest.
+    // Options override router2 settings of the same name (e.g. "router2/bbMargin/x") for this run.
+    std::shared_ptr<Router2Job> reroute(const std::vector<IdString> &net_names,
+                                        const std::unordered_map<std::string, std::string> &options);
     // -------------------------------------------------
 
     std::vector<GraphicElement> getDecalGraphics(DecalId decal) const;
@@ -1520,8 +1884,10 @@ struct Arch : BaseCtx
     // Perform placement validity checks, returning false on failure (all
     // implemented in arch_place.cc)
 
-    bool xc7_cell_timing_lookup(int tt_id, int inst_id, IdString variant, IdString from_port, IdString to_port,
-                                DelayInfo &delay) const;
+    // Resolve the chipdb timing of a cell at its current bel, see ArchCellInfo::timing_bel
+    void xc7_update_cell_timing(const CellInfo *cell) const;
+    // Look up a delay arc of a cell, after xc7_update_cell_timing
+    bool xc7_cell_timing_lookup(const CellInfo *cell, IdString from_port, IdString to_port, DelayInfo &delay) const;
 
     // Whether or not a given cell can be placed at a given Bel
     // This is not intended for Bel type checks, but finer-grained constraints
@@ -1582,17 +1948,95 @@ struct Arch : BaseCtx
     // netlist modifications, and validity checks
     void assignArchInfo();
     void assignCellInfo(CellInfo *cell);
+    // The part of assignCellInfo that only reads and writes the cell itself, so can run for many cells at once
+    void fillCellInfo(CellInfo *cell);
+    // Names looked up for every cell by fillCellInfo that aren't constids, resolved once
+    struct CellInfoIds
+    {
+        IdString is_c_inverted, is_clk_inverted, is_r_inverted, is_s_inverted, is_clr_inverted, is_pre_inverted;
+        IdString x_ff_as_latch, x_ffsync, x_lut_as_srl, x_lut_as_dram;
+        IdString selmux2_1, cyinit, bufg_o;
+        IdString carry_o[8], carry_co[8], carry_x[8];
+    } cell_info_ids;
+    void setupCellInfoIds();
+    // Intern an FF's control set (clock, set/reset, xc7 CE, inversion and mode flags) and CE net, by name, into the
+    // ffInfo ids; done once per FF as the arch info is assigned after packing
+    void assignFFControlSet(CellInfo *cell);
+    std::map<std::tuple<IdString, IdString, IdString, int>, int> ff_ctrl_set_ids;
+    std::unordered_map<IdString, int> ff_ce_ids;
 
     void fixupPlacement();
     void fixupRouting();
+    // Set once fixupRouting has turned the bound LUT permutation pips into cell pin swaps, after which only the
+    // identity permutation pips may be used
+    bool lut_permutations_fixed = false;
 
     void routeVcc();
     void routeClock();
     void findSourceSinkLocations();
-    std::unordered_map<WireId, Loc> sink_locs, source_locs;
+    // Real (INT) tile of sink wires found by findSourceSinkLocations, indexed by getWireIndex, or -1.
+    // Empty until findSourceSinkLocations has run.
+    std::vector<int32_t> sink_loc_tile;
+    std::unordered_map<WireId, Loc> source_locs;
+
+    int32_t getSinkLocTile(WireId wire) const
+    {
+        return sink_loc_tile.empty() ? -1 : sink_loc_tile[getWireIndex(wire)];
+    }
+
+    // Precomputed estimateDelay cost by source wire class and |dx|, |dy|, see setup_delay_table
+    enum DelayWireClass
+    {
+        DELAY_CLASS_OTHER,
+        DELAY_CLASS_PINFEED,
+        DELAY_CLASS_LOCAL,
+        DELAY_CLASS_CLE_OUTPUT,
+        DELAY_CLASS_COUNT
+    };
+    std::vector<delay_t> delay_table;
+
+    // Classification of the wire intents that the delay estimates and location search distinguish, indexed by
+    // intent, so that each takes one table lookup rather than a chain of comparisons
+    enum IntentClass : uint8_t
+    {
+        INTENT_GLOBAL = 1,          // dedicated clock routing
+        INTENT_LOCAL = 2,           // local, long and quad wires, penalised when driven from clock routing
+        INTENT_LAGUNA = 4,          // Laguna (SLR crossing) data wires
+        INTENT_PSEUDO_CONST = 8,    // pseudo GND and VCC wires
+        INTENT_GENERAL = 16,        // general interconnect, never used for dedicated clock routing
+        INTENT_NO_LOC = 32,         // never a source or sink location for findSourceSinkLocations
+        INTENT_NO_SINK_LOC = 64,    // not a sink location
+        INTENT_NO_SOURCE_LOC = 128, // not a source location
+    };
+    struct IntentInfo
+    {
+        uint8_t flags = 0;
+        // DelayWireClass of wires with this intent, for estimateDelay
+        uint8_t delay_class = DELAY_CLASS_OTHER;
+    };
+    std::vector<IntentInfo> intent_info;
+    IntentInfo no_intent_info;
+
+    void setup_intent_info();
+    const IntentInfo &intentInfo(int32_t intent) const
+    {
+        return (intent >= 0 && intent < int32_t(intent_info.size())) ? intent_info[intent] : no_intent_info;
+    }
+
+    void setup_delay_table();
+    // Fitted model for predictDelay, if enabled with xilinx/delayModel; see setup_delay_model
+    DelayModel delay_model;
+    void setup_delay_model();
+    delay_t lookupDelayTable(int cls, int dx, int dy) const
+    {
+        dx = std::min(std::abs(dx), chip_info->width - 1);
+        dy = std::min(std::abs(dy), chip_info->height - 1);
+        return delay_table[(cls * chip_info->height + dy) * chip_info->width + dx];
+    }
     // -------------------------------------------------
 
     void parseXdc(std::istream &file);
+    // Package pin to site name, for chipdbs before version 3, built once by setup_byname()
     mutable std::unordered_map<std::string, std::string> pin_to_site;
     std::string getPackagePinSite(const std::string &pin) const;
     std::string getBelPackagePin(BelId bel) const;
@@ -1623,6 +2067,9 @@ struct Arch : BaseCtx
     }
     // -------------------------------------------------
     void writeFasm(const std::string &filename);
+    void writeFasmBinary(const std::string &filename);
+    void writeFasmPatch(const std::string &filename, const std::string &previous);
+    void writePhysNetlist(const std::string &filename);
 };
 
 NEXTPNR_NAMESPACE_END
@@ -22,6 +22,7 @@
 #include "design_utils.h"
 #include "log.h"
 #include "nextpnr.h"
+#include "thread_pool.h"
 #include "timing.h"
 #include "util.h"
 NEXTPNR_NAMESPACE_BEGIN
@@ -253,41 +254,22 @@ bool Arch::xcu_logic_tile_valid(IdString tileType, LogicTileStatus &lts) const
     // Check half-tiles
     for (int i = 0; i < 2; i++) {
         if (lts.halfs[i].dirty) {
+            lts.halfs[i].dirty = false;
             lts.halfs[i].valid = false;
-            bool found_ff[2] = {false, false};
-            NetInfo *clk = nullptr, *sr = nullptr, *ce[2] = {nullptr};
-            bool clkinv = false, srinv = false, islatch = false;
-            for (int z = 4 * i; z < 4 * (i + 1); z++) {
-                for (int k = 0; k < 2; k++) {
-                    CellInfo *ff = lts.cells[z << 4 | (BEL_FF + k)];
-                    if (ff == nullptr)
-                        continue;
-                    if (found_ff[0] || found_ff[1]) {
-                        if (ff->ffInfo.clk != clk)
-                            return false;
-                        if (ff->ffInfo.sr != sr)
-                            return false;
-                        if (ff->ffInfo.is_clkinv != clkinv)
-                            return false;
-                        if (ff->ffInfo.is_srinv != srinv)
-                            return false;
-                        if (ff->ffInfo.is_latch != islatch)
-                            return false;
-                    } else {
-                        clk = ff->ffInfo.clk;
-                        sr = ff->ffInfo.sr;
-                        clkinv = ff->ffInfo.is_clkinv;
-                        srinv = ff->ffInfo.is_srinv;
-                        islatch = ff->ffInfo.is_latch;
-                    }
-                    if (found_ff[k]) {
-                        if (ff->ffInfo.ce != ce[k])
-                            return false;
-                    } else {
-                        ce[k] = ff->ffInfo.ce;
-                    }
-                    found_ff[k] = true;
-                }
+            // All FFs share a control set, and each row of FFs a CE
+            int ctrl_set = -1, ce[2] = {-1, -1};
+            for (int slot = 0; slot < 8; slot++) {
+                if (!(lts.ff_used[i] & (1 << slot)))
+                    continue;
+                int k = slot & 1;
+                if (ctrl_set == -1)
+                    ctrl_set = lts.ff_ctrl_set[i * 8 + slot];
+                else if (lts.ff_ctrl_set[i * 8 + slot] != ctrl_set)
+                    return false;
+                if (ce[k] == -1)
+                    ce[k] = lts.ff_ce[i * 8 + slot];
+                else if (lts.ff_ce[i * 8 + slot] != ce[k])
+                    return false;
             }
             lts.halfs[i].valid = true;
         } else if (!lts.halfs[i].valid) {
@@ -520,8 +502,8 @@ bool Arch::xc7_logic_tile_valid(IdString tileType, LogicTileStatus &lts) const
     // Check half-tiles
     for (int i = 0; i < 2; i++) {
         if (lts.halfs[i].dirty) {
+            lts.halfs[i].dirty = false;
             lts.halfs[i].valid = false;
-            bool found_ff[2] = {false, false};
             if (i == 0 && wclk == nullptr) {
                 // Need to check wclk too
                 for (int z = 4 * i; z < 4 * (i + 1); z++) {
@@ -538,42 +520,20 @@ bool Arch::xc7_logic_tile_valid(IdString tileType, LogicTileStatus &lts) const
                     }
                 }
             }
-            NetInfo *clk = nullptr, *sr = nullptr, *ce = nullptr;
-            bool clkinv = false, srinv = false, islatch = false, ffsync = false;
-            for (int z = 4 * i; z < 4 * (i + 1); z++) {
-                for (int k = 0; k < 2; k++) {
-                    CellInfo *ff = lts.cells[z << 4 | (BEL_FF + k)];
-                    if (ff == nullptr)
-                        continue;
-                    if (ff->ffInfo.is_latch && k == 1)
+            // Latches can only use the first FF of each pair; all FFs share a control set, which includes CE
+            if (lts.ff_latch[i] & 0xAA)
+                return false;
+            int ctrl_set = -1;
+            for (int slot = 0; slot < 8; slot++) {
+                if (!(lts.ff_used[i] & (1 << slot)))
+                    continue;
+                if (ctrl_set == -1) {
+                    ctrl_set = lts.ff_ctrl_set[i * 8 + slot];
+                    CellInfo *ff = lts.cells[(4 * i + slot / 2) << 4 | (BEL_FF + (slot & 1))];
+                    if (i == 0 && wclk != nullptr && ff->ffInfo.clk != wclk)
                         return false;
-                    if (found_ff[0] || found_ff[1]) {
-                        if (ff->ffInfo.clk != clk)
-                            return false;
-                        if (ff->ffInfo.sr != sr)
-                            return false;
-                        if (ff->ffInfo.ce != ce)
-                            return false;
-                        if (ff->ffInfo.is_clkinv != clkinv)
-                            return false;
-                        if (ff->ffInfo.is_srinv != srinv)
-                            return false;
-                        if (ff->ffInfo.is_latch != islatch)
-                            return false;
-                        if (ff->ffInfo.ffsync != ffsync)
-                            return false;
-                    } else {
-                        clk = ff->ffInfo.clk;
-                        if (i == 0 && wclk != nullptr && clk != wclk)
-                            return false;
-                        sr = ff->ffInfo.sr;
-                        ce = ff->ffInfo.ce;
-                        clkinv = ff->ffInfo.is_clkinv;
-                        srinv = ff->ffInfo.is_srinv;
-                        islatch = ff->ffInfo.is_latch;
-                        ffsync = ff->ffInfo.ffsync;
-                    }
-                    found_ff[k] = true;
+                } else if (lts.ff_ctrl_set[i * 8 + slot] != ctrl_set) {
+                    return false;
                 }
             }
             lts.halfs[i].valid = true;
@@ -586,16 +546,20 @@ bool Arch::xc7_logic_tile_valid(IdString tileType, LogicTileStatus &lts) const
 
 bool Arch::isBelLocationValid(BelId bel) const
 {
+    if (!clockRegionValid(bel))
+        return false;
     IdString belTileType = getBelTileType(bel);
     if (isLogicTile(bel)) {
         // Logic Tile
         if (!tileStatus[bel.tile].lts)
             return true;
         LogicTileStatus &lts = *(tileStatus[bel.tile].lts);
-        if (xc7)
-            return xc7_logic_tile_valid(belTileType, lts);
-        else
-            return xcu_logic_tile_valid(belTileType, lts);
+        // Nothing bound or unbound in the tile since the last check
+        if (!lts.tile_dirty)
+            return lts.tile_valid;
+        lts.tile_valid = xc7 ? xc7_logic_tile_valid(belTileType, lts) : xcu_logic_tile_valid(belTileType, lts);
+        lts.tile_dirty = false;
+        return lts.tile_valid;
     } else if (belTileType == id_BRAM || belTileType == id_BRAM_L || belTileType == id_BRAM_R) {
         if (!tileStatus[bel.tile].bts)
             return true;
@@ -635,97 +599,118 @@ bool Arch::isValidBelForCell(CellInfo *cell, BelId bel) const
     return true;
 }
 
+namespace {
+// The inputs of a LUT5/LUT6 pair once post-placement legalisation has shared them out: the distinct input nets of the
+// pair in name order, each with the logical inputs of either LUT it drives as a mask. These are worked out for all
+// pairs in parallel; they are then applied in tile order, as connecting ports changes the user lists of nets that
+// are shared between tiles.
+struct LutPairInputs
+{
+    CellInfo *lut5, *lut6;
+    int count = 0;
+    NetInfo *nets[12];
+    uint8_t lut5_mask[12], lut6_mask[12];
+
+    LutPairInputs(CellInfo *lut5, CellInfo *lut6) : lut5(lut5), lut6(lut6) {}
+
+    void add(CellInfo *lut, uint8_t *masks)
+    {
+        for (int i = 0; i < lut->lutInfo.input_count; i++) {
+            NetInfo *net = lut->lutInfo.input_sigs[i];
+            if (net == nullptr)
+                continue;
+            int k = std::find(nets, nets + count, net) - nets;
+            if (k == count) {
+                nets[count] = net;
+                lut5_mask[count] = lut6_mask[count] = 0;
+                count++;
+            }
+            masks[k] |= (1 << i);
+        }
+    }
+
+    void find()
+    {
+        add(lut5, lut5_mask);
+        if (lut6 != nullptr)
+            add(lut6, lut6_mask);
+        // Insertion sort by net name, keeping the masks alongside
+        for (int i = 1; i < count; i++)
+            for (int j = i; j > 0 && nets[j]->name < nets[j - 1]->name; j--) {
+                std::swap(nets[j], nets[j - 1]);
+                std::swap(lut5_mask[j], lut5_mask[j - 1]);
+                std::swap(lut6_mask[j], lut6_mask[j - 1]);
+            }
+    }
+};
+} // namespace
+
 void Arch::fixupPlacement()
 {
     log_info("Running post-placement legalisation...\n");
+    // Fixup LUT connectivity - applies whenever a LUT5 is used
+    std::vector<LutPairInputs> lut_pairs;
     for (auto &ts : tileStatus) {
         if (ts.lts == nullptr)
             continue;
         auto &lt = *(ts.lts);
-        for (int z = 0; z < 8; z++) {
-            // Fixup LUT connectivity - applies whenever a LUT5 is used
-            CellInfo *lut5 = lt.cells[z << 4 | BEL_5LUT];
-            if (lut5 == nullptr)
-                continue;
-            std::unordered_map<IdString, std::vector<int>> lut5Inputs, lut6Inputs;
-            for (int i = 0; i < lut5->lutInfo.input_count; i++)
-                if (lut5->lutInfo.input_sigs[i])
-                    lut5Inputs[lut5->lutInfo.input_sigs[i]->name].push_back(i);
-            CellInfo *lut6 = lt.cells[z << 4 | BEL_6LUT];
-            if (lut6) {
-                for (int i = 0; i < lut6->lutInfo.input_count; i++)
-                    if (lut6->lutInfo.input_sigs[i])
-                        lut6Inputs[lut6->lutInfo.input_sigs[i]->name].push_back(i);
-            }
-            if (lut5->lutInfo.is_memory || lut5->lutInfo.is_srl) {
-                if (lut6) {
-                    if (!lut6->ports.count(id_A6)) {
-                        lut6->ports[id_A6].name = id_A6;
-                        lut6->ports[id_A6].type = PORT_IN;
-                    }
-                    connect_port(getCtx(), nets[id("$PACKER_VCC_NET")].get(), lut6, id_A6);
-                }
-                continue;
-            }
-            std::set<IdString> uniqueInputs;
-            for (auto i5 : lut5Inputs)
-                uniqueInputs.insert(i5.first);
-            for (auto i6 : lut6Inputs)
-                uniqueInputs.insert(i6.first);
+        for (int z = 0; z < 8; z++)
+            if (lt.cells[z << 4 | BEL_5LUT] != nullptr)
+                lut_pairs.emplace_back(lt.cells[z << 4 | BEL_5LUT], lt.cells[z << 4 | BEL_6LUT]);
+    }
+    getCtx()->threadPool().parallel_for(
+            lut_pairs.size(), 256, [&](size_t i) { lut_pairs.at(i).find(); }, getCtx()->debug ? 1 : 0);
+
+    IdString ports[6] = {id_A1, id_A2, id_A3, id_A4, id_A5, id_A6};
+    IdString orig_port_attrs[6];
+    for (int i = 0; i < 6; i++)
+        orig_port_attrs[i] = id("X_ORIG_PORT_" + ports[i].str(this));
+    auto orig_inputs = [](uint8_t mask) {
+        std::string inputs;
+        for (int i = 0; i < 6; i++)
+            if (mask & (1 << i))
+                inputs += (inputs.empty() ? "I" : " I") + std::to_string(i);
+        return inputs;
+    };
+    auto connect_input = [&](CellInfo *lut, int index, NetInfo *net, uint8_t mask) {
+        if (!lut->ports.count(ports[index])) {
+            lut->ports[ports[index]].name = ports[index];
+            lut->ports[ports[index]].type = PORT_IN;
+        }
+        connect_port(getCtx(), net, lut, ports[index]);
+        lut->attrs[orig_port_attrs[index]] = orig_inputs(mask);
+    };
+    IdString vcc_net = id("$PACKER_VCC_NET");
+    for (auto &pair : lut_pairs) {
+        CellInfo *lut5 = pair.lut5, *lut6 = pair.lut6;
+        if (!lut5->lutInfo.is_memory && !lut5->lutInfo.is_srl) {
+            NPNR_ASSERT(pair.count <= 6);
             // Disconnect LUT inputs, and re-connect them to not overlap
-            IdString ports[6] = {id_A1, id_A2, id_A3, id_A4, id_A5, id_A6};
-            for (auto p : ports) {
-                disconnect_port(getCtx(), lut5, p);
-                lut5->attrs.erase(id("X_ORIG_PORT_" + p.str(this)));
+            for (int i = 0; i < 6; i++) {
+                disconnect_port(getCtx(), lut5, ports[i]);
+                lut5->attrs.erase(orig_port_attrs[i]);
                 if (lut6) {
-                    lut6->attrs.erase(id("X_ORIG_PORT_" + p.str(this)));
-                    disconnect_port(getCtx(), lut6, p);
+                    lut6->attrs.erase(orig_port_attrs[i]);
+                    disconnect_port(getCtx(), lut6, ports[i]);
                 }
             }
-            int index = 0;
-            for (auto i : uniqueInputs) {
-                if (lut5Inputs.count(i)) {
-                    if (!lut5->ports.count(ports[index])) {
-                        lut5->ports[ports[index]].name = ports[index];
-                        lut5->ports[ports[index]].type = PORT_IN;
-                    }
-                    connect_port(getCtx(), nets.at(i).get(), lut5, ports[index]);
-                    lut5->attrs[id("X_ORIG_PORT_" + ports[index].str(this))] = std::string("");
-                    bool first = true;
-                    for (auto inp : lut5Inputs[i]) {
-                        lut5->attrs[id("X_ORIG_PORT_" + ports[index].str(this))].str +=
-                                (first ? "I" : " I") + std::to_string(inp);
-                        first = false;
-                    }
-                }
-                if (lut6 && lut6Inputs.count(i)) {
-                    if (!lut6->ports.count(ports[index])) {
-                        lut6->ports[ports[index]].name = ports[index];
-                        lut6->ports[ports[index]].type = PORT_IN;
-                    }
-                    connect_port(getCtx(), nets.at(i).get(), lut6, ports[index]);
-
-                    lut6->attrs[id("X_ORIG_PORT_" + ports[index].str(this))] = std::string("");
-                    bool first = true;
-                    for (auto inp : lut6Inputs[i]) {
-                        lut6->attrs[id("X_ORIG_PORT_" + ports[index].str(this))].str +=
-                                (first ? "I" : " I") + std::to_string(inp);
-                        first = false;
-                    }
-                }
-                ++index;
+            for (int index = 0; index < pair.count; index++) {
+                if (pair.lut5_mask[index] != 0)
+                    connect_input(lut5, index, pair.nets[index], pair.lut5_mask[index]);
+                if (lut6 && pair.lut6_mask[index] != 0)
+                    connect_input(lut6, index, pair.nets[index], pair.lut6_mask[index]);
             }
             rename_port(getCtx(), lut5, id_O6, id_O5);
             lut5->attrs.erase(id("X_ORIG_PORT_O6"));
             lut5->attrs[id("X_ORIG_PORT_O5")] = std::string("O");
+        }
 
-            if (lut6) {
-                if (!lut6->ports.count(id_A6)) {
-                    lut6->ports[id_A6].name = id_A6;
-                    lut6->ports[id_A6].type = PORT_IN;
-                }
-                connect_port(getCtx(), nets[id("$PACKER_VCC_NET")].get(), lut6, id_A6);
+        if (lut6) {
+            if (!lut6->ports.count(id_A6)) {
+                lut6->ports[id_A6].name = id_A6;
+                lut6->ports[id_A6].type = PORT_IN;
             }
+            connect_port(getCtx(), nets[vcc_net].get(), lut6, id_A6);
         }
     }
     for (auto cell : sorted(cells)) {
@@ -925,108 +910,112 @@ void Arch::fixupRouting()
      * then specifying the permutation as a new physical-to-logical mapping using X_ORIG_PORT. This keeps RapidWright
      * and Vivado happy, preserving the original logical netlist
      */
-    std::unordered_map<int, std::vector<int>> used_perm_pips; // tile -> [extra_data] for LUT perm pips
-
-    for (auto net : sorted(nets)) {
-        NetInfo *ni = net.second;
-        for (auto &wire : ni->wires) {
-            PipId pip = wire.second.pip;
-            if (pip == PipId())
-                continue;
-            auto &pd = locInfo(pip).pip_data[pip.index];
-            if (pd.flags != PIP_LUT_PERMUTATION)
-                continue;
-            used_perm_pips[pip.tile].push_back(pd.extra_data);
+    struct TilePermPips
+    {
+        int tile;
+        bool used = false;
+        // For each eighth, the logical inputs each physical input is permuted to, as a mask
+        uint8_t to[8][6] = {};
+    };
+    std::vector<TilePermPips> perm_tiles;
+    for (int tile = 0; tile < int(tileStatus.size()); tile++)
+        if (tileStatus[tile].lts != nullptr && !tile_pip_bindings[tile].empty()) {
+            perm_tiles.emplace_back();
+            perm_tiles.back().tile = tile;
         }
-    }
+    // Every tile only has its own LUT permutation pips, so the bound ones can be found tile by tile
+    getCtx()->threadPool().parallel_for(
+            perm_tiles.size(), 64,
+            [&](size_t i) {
+                auto &pt = perm_tiles.at(i);
+                auto &bindings = tile_pip_bindings[pt.tile];
+                auto &td = chip_info->tile_types[chip_info->tile_insts[pt.tile].type];
+                for (int j = 0; j < td.num_pips; j++) {
+                    auto &pd = td.pip_data[j];
+                    if (pd.flags != PIP_LUT_PERMUTATION || bindings[j] == nullptr)
+                        continue;
+                    pt.used = true;
+                    pt.to[(pd.extra_data >> 8) & 0xF][(pd.extra_data >> 4) & 0xF] |= (1 << (pd.extra_data & 0xF));
+                }
+            },
+            getCtx()->debug ? 1 : 0);
 
-    for (size_t ti = 0; ti < tileStatus.size(); ti++) {
-        if (!used_perm_pips.count(int(ti)))
-            continue;
-        auto &ts = tileStatus.at(ti);
-        if (ts.lts == nullptr)
+    IdString ports[6] = {id_A1, id_A2, id_A3, id_A4, id_A5, id_A6};
+    IdString orig_port_attrs[6];
+    for (int i = 0; i < 6; i++)
+        orig_port_attrs[i] = id("X_ORIG_PORT_" + ports[i].str(this));
+    for (auto &pt : perm_tiles) {
+        if (!pt.used)
             continue;
-
-        auto &lt = *(ts.lts);
+        auto &lt = *(tileStatus.at(pt.tile).lts);
         for (int z = 0; z < 8; z++) {
             CellInfo *lut5 = lt.cells[z << 4 | BEL_5LUT];
             CellInfo *lut6 = lt.cells[z << 4 | BEL_6LUT];
             if (lut5 == nullptr && lut6 == nullptr)
                 continue;
-            auto &pp = used_perm_pips.at(ti);
             // from -> to
-            std::unordered_map<IdString, std::vector<IdString>> new_connections;
-            IdString ports[6] = {id_A1, id_A2, id_A3, id_A4, id_A5, id_A6};
-            for (auto pip : pp) {
-                if (((pip >> 8) & 0xF) != z)
-                    continue;
-                new_connections[ports[(pip >> 4) & 0xF]].push_back(ports[pip & 0xF]);
-            }
-            std::unordered_map<IdString, NetInfo *> orig_nets;
-            std::unordered_map<IdString, std::string> orig_ports_l6, orig_ports_l5;
+            const uint8_t *new_connections = pt.to[z];
+            NetInfo *orig_nets[6];
+            std::string orig_ports_l6[6], orig_ports_l5[6];
             for (int i = 0; i < 6; i++) {
                 NetInfo *l6net = lut6 ? get_net_or_empty(lut6, ports[i]) : nullptr;
                 NetInfo *l5net = lut5 ? get_net_or_empty(lut5, ports[i]) : nullptr;
-                orig_nets[ports[i]] = (l6net ? l6net : l5net);
+                orig_nets[i] = (l6net ? l6net : l5net);
                 if (lut6)
-                    orig_ports_l6[ports[i]] = str_or_default(lut6->attrs, id("X_ORIG_PORT_" + ports[i].str(this)));
+                    orig_ports_l6[i] = str_or_default(lut6->attrs, orig_port_attrs[i]);
                 if (lut5)
-                    orig_ports_l5[ports[i]] = str_or_default(lut5->attrs, id("X_ORIG_PORT_" + ports[i].str(this)));
+                    orig_ports_l5[i] = str_or_default(lut5->attrs, orig_port_attrs[i]);
             }
-            for (auto &nc : new_connections) {
+            for (int i = 0; i < 6; i++) {
+                if (new_connections[i] == 0)
+                    continue;
                 if (lut6)
-                    disconnect_port(getCtx(), lut6, nc.first);
+                    disconnect_port(getCtx(), lut6, ports[i]);
                 if (lut5)
-                    disconnect_port(getCtx(), lut5, nc.first);
-                for (auto &dst : nc.second) {
+                    disconnect_port(getCtx(), lut5, ports[i]);
+                for (int dst = 0; dst < 6; dst++) {
+                    if (!(new_connections[i] & (1 << dst)))
+                        continue;
                     if (lut6)
-                        disconnect_port(getCtx(), lut6, dst);
+                        disconnect_port(getCtx(), lut6, ports[dst]);
                     if (lut5)
-                        disconnect_port(getCtx(), lut5, dst);
+                        disconnect_port(getCtx(), lut5, ports[dst]);
                 }
             }
             for (int i = 0; i < 6; i++) {
                 if (lut6)
-                    lut6->attrs.erase(id("X_ORIG_PORT_" + ports[i].str(this)));
+                    lut6->attrs.erase(orig_port_attrs[i]);
                 if (lut5)
-                    lut5->attrs.erase(id("X_ORIG_PORT_" + ports[i].str(this)));
+                    lut5->attrs.erase(orig_port_attrs[i]);
             }
-            for (int i = 0; i < 6; i++) {
+            auto connect_permuted = [&](CellInfo *lut, int i, const std::string *orig_ports) {
                 auto p = ports[i];
-                if (!new_connections.count(p) || new_connections.at(p).empty())
-                    continue;
-                if (lut6) {
-                    if (!lut6->ports.count(p)) {
-                        lut6->ports[p].name = p;
-                        lut6->ports[p].type = PORT_IN;
-                    }
-                    connect_port(getCtx(), orig_nets[new_connections.at(p).front()], lut6, p);
-                    lut6->attrs[id("X_ORIG_PORT_" + p.str(this))] = std::string("");
-                    auto &orig_attr = lut6->attrs[id("X_ORIG_PORT_" + p.str(this))].str;
-                    bool first = true;
-                    for (auto &nc : new_connections.at(p)) {
-                        orig_attr += orig_ports_l6[nc] + (first ? "" : " ");
-                        first = false;
-                    }
-                    if (orig_attr.empty())
-                        lut6->attrs.erase(id("X_ORIG_PORT_" + p.str(this)));
+                if (!lut->ports.count(p)) {
+                    lut->ports[p].name = p;
+                    lut->ports[p].type = PORT_IN;
                 }
-                if (lut5) {
-                    if (!lut5->ports.count(p)) {
-                        lut5->ports[p].name = p;
-                        lut5->ports[p].type = PORT_IN;
-                    }
-                    connect_port(getCtx(), orig_nets[new_connections.at(p).front()], lut5, p);
-                    lut5->attrs[id("X_ORIG_PORT_" + p.str(this))] = std::string("");
-                    auto &orig_attr = lut5->attrs[id("X_ORIG_PORT_" + p.str(this))].str;
-                    bool first = true;
-                    for (auto &nc : new_connections.at(p)) {
-                        orig_attr += orig_ports_l5[nc] + (first ? "" : " ");
-                        first = false;
-                    }
-                    if (orig_attr.empty())
-                        lut5->attrs.erase(id("X_ORIG_PORT_" + p.str(this)));
+                int front = 0;
+                while (!(new_connections[i] & (1 << front)))
+                    front++;
+                connect_port(getCtx(), orig_nets[front], lut, p);
+                std::string orig_attr;
+                bool first = true;
+                for (int dst = 0; dst < 6; dst++) {
+                    if (!(new_connections[i] & (1 << dst)))
+                        continue;
+                    orig_attr += orig_ports[dst] + (first ? "" : " ");
+                    first = false;
                 }
+                if (!orig_attr.empty())
+                    lut->attrs[orig_port_attrs[i]] = orig_attr;
+            };
+            for (int i = 0; i < 6; i++) {
+                if (new_connections[i] == 0)
+                    continue;
+                if (lut6)
+                    connect_permuted(lut6, i, orig_ports_l6);
+                if (lut5)
+                    connect_permuted(lut5, i, orig_ports_l5);
             }
         }
     }
@@ -1106,6 +1095,7 @@ void Arch::fixupRouting()
             ci->params[id("OSERDES_T_BYPASS")] = std::string("TRUE");
         }
     }
+    lut_permutations_fixed = true;
 }
 
 NEXTPNR_NAMESPACE_END
@@ -22,9 +22,46 @@
 #include "arch_pybindings.h"
 #include "nextpnr.h"
 #include "pybindings.h"
+#include "router2.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
+namespace {
+// ctx.reroute(nets, options): a list of net names, and a dict of router2 settings (e.g. "router2/bbMargin/x") to
+// values, written as they would be on the command line
+std::shared_ptr<Router2Job> reroute(Context &ctx, list nets, boost::python::dict options)
+{
+    std::vector<IdString> names;
+    for (int i = 0; i < len(nets); i++) {
+        std::string name = extract<std::string>(nets[i]);
+        names.push_back(ctx.id(name));
+    }
+    std::unordered_map<std::string, std::string> opts;
+    list items = options.items();
+    for (int i = 0; i < len(items); i++) {
+        std::string key = extract<std::string>(items[i][0]);
+        std::string value = extract<std::string>(str(items[i][1]));
+        opts[key] = value;
+    }
+    return ctx.reroute(names, opts);
+}
+
+// Releases the interpreter for its lifetime, including when leaving by an exception
+struct ReleaseInterpreter
+{
+    PyThreadState *state;
+    ReleaseInterpreter() : state(PyEval_SaveThread()) {}
+    ~ReleaseInterpreter() { PyEval_RestoreThread(state); }
+};
+
+// The router thread never calls into Python, so the interpreter is released while waiting for it
+bool reroute_wait(Router2Job &job)
+{
+    ReleaseInterpreter release;
+    return job.wait();
+}
+} // namespace
+
 void arch_wrap_python()
 {
     using namespace PythonConversion;
@@ -43,13 +80,20 @@ void arch_wrap_python()
                            .def("checksum", &Context::checksum)
                            .def("pack", &Context::pack)
                            .def("place", &Context::place)
-                           .def("route", &Context::route);
+                           .def("route", &Context::route)
+                           .def("reroute", &reroute,
+                                (arg("self"), arg("nets"), arg("options") = boost::python::dict()));
+
+    class_<Router2Job, std::shared_ptr<Router2Job>, boost::noncopyable>("RerouteJob", no_init)
+            .def("done", &Router2Job::done)
+            .def("cancel", &Router2Job::cancel)
+            .def("wait", &reroute_wait);
 
     fn_wrapper_2a<Context, decltype(&Context::isValidBelForCell), &Context::isValidBelForCell, pass_through<bool>,
                   addr_and_unwrap<CellInfo>, conv_from_str<BelId>>::def_wrap(ctx_cls, "isValidBelForCell");
 
-    typedef std::unordered_map<IdString, std::unique_ptr<CellInfo>> CellMap;
-    typedef std::unordered_map<IdString, std::unique_ptr<NetInfo>> NetMap;
+    typedef indexed_dict<IdString, std::unique_ptr<CellInfo>> CellMap;
+    typedef indexed_dict<IdString, std::unique_ptr<NetInfo>> NetMap;
     typedef std::unordered_map<IdString, IdString> AliasMap;
     typedef std::unordered_map<IdString, HierarchicalCell> HierarchyMap;
 
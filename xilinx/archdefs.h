@@ -27,21 +27,23 @@ typedef int delay_t;
 
 struct DelayInfo
 {
-    delay_t delay = 0;
+    // Fast and slow corner delays
+    delay_t min_delay = 0, max_delay = 0;
 
-    delay_t minRaiseDelay() const { return delay; }
-    delay_t maxRaiseDelay() const { return delay; }
+    delay_t minRaiseDelay() const { return min_delay; }
+    delay_t maxRaiseDelay() const { return max_delay; }
 
-    delay_t minFallDelay() const { return delay; }
-    delay_t maxFallDelay() const { return delay; }
+    delay_t minFallDelay() const { return min_delay; }
+    delay_t maxFallDelay() const { return max_delay; }
 
-    delay_t minDelay() const { return delay; }
-    delay_t maxDelay() const { return delay; }
+    delay_t minDelay() const { return min_delay; }
+    delay_t maxDelay() const { return max_delay; }
 
     DelayInfo operator+(const DelayInfo &other) const
     {
         DelayInfo ret;
-        ret.delay = this->delay + other.delay;
+        ret.min_delay = this->min_delay + other.min_delay;
+        ret.max_delay = this->max_delay + other.max_delay;
         return ret;
     }
 };
@@ -160,9 +162,28 @@ struct ArchNetInfo
 };
 
 struct NetInfo;
+struct CellTimingPOD;
+
+// A cell delay arc looked up by Arch::getCellDelay
+struct CellDelayArc
+{
+    IdString from_port, to_port;
+    delay_t min_delay, max_delay;
+    bool found;
+};
 
 struct ArchCellInfo
 {
+    // The chipdb timing of the cell at timing_bel and the arcs looked up in it so far, resolved by
+    // Arch::getCellDelay the first time that is called after the cell moves; updating this is not thread safe
+    mutable BelId timing_bel;
+    mutable IdString timing_type;
+    mutable bool timing_has_inst = false, timing_is_lut5 = false;
+    mutable const CellTimingPOD *timing_data = nullptr;
+    mutable std::vector<CellDelayArc> timing_arcs;
+    // The distinct BUFG driven nets on input ports, counted against the clock region the cell is placed in
+    std::vector<NetInfo *> global_clocks;
+
     union
     {
         struct
@@ -180,6 +201,8 @@ struct ArchCellInfo
             bool is_latch, is_clkinv, is_srinv, ffsync;
             bool is_paired;
             NetInfo *clk, *sr, *ce, *d;
+            // Interned by assignCellInfo, so FFs can be compared by control set without looking at their nets
+            int ctrl_set, ce_id;
         } ffInfo;
         struct
         {
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+# Compare the runtime and quality of results of two nextpnr-xilinx builds over the benchmark suite of
+# xilinx_benchmark.py. Each design is run with both builds for every seed, alternating which one goes first from one
+# seed to the next so that drift in the machine's load or temperature affects both alike, and for each metric the
+# mean of each build is printed with the difference of the candidate from the baseline and its 95% confidence
+# interval (Welch's t-test). Differences whose interval doesn't include zero are marked with a '*'.
+#
+# Results can also be compared without running anything, from two results files written by xilinx_benchmark.py or by
+# an earlier run of this script (--baseline-results, --candidate-results).
+import argparse, copy, json, math, os, sys
+from os import path
+
+sys.path.insert(0, path.dirname(path.abspath(__file__)))
+import xilinx_benchmark
+
+# Two-sided 95% quantiles of Student's t distribution by degrees of freedom, the normal quantile beyond the table
+t975_table = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145,
+              2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048,
+              2.045, 2.042]
+
+
+def t975(df):
+    if df < 1:
+        return t975_table[0]
+    if df >= len(t975_table):
+        return 1.960 + (t975_table[-1] - 1.960) * len(t975_table) / df
+    lo = int(df)
+    frac = df - lo
+    hi = min(lo + 1, len(t975_table))
+    return t975_table[lo - 1] + frac * (t975_table[hi - 1] - t975_table[lo - 1])
+
+
+def mean_var(xs):
+    m = sum(xs) / len(xs)
+    v = sum((x - m) ** 2 for x in xs) / (len(xs) - 1) if len(xs) > 1 else 0.0
+    return m, v
+
+
+def compare_samples(base, cand):
+    """Means of both samples, the difference of the candidate from the baseline and the half-width of its 95%
+    confidence interval (None with fewer than two samples of either)"""
+    mb, vb = mean_var(base)
+    mc, vc = mean_var(cand)
+    diff = mc - mb
+    if len(base) < 2 or len(cand) < 2:
+        return mb, mc, diff, None
+    sb, sc = vb / len(base), vc / len(cand)
+    se = math.sqrt(sb + sc)
+    if se == 0:
+        return mb, mc, diff, 0.0
+    # Welch-Satterthwaite degrees of freedom
+    df = (sb + sc) ** 2 / ((sb ** 2 / (len(base) - 1) if sb > 0 else 0) + (sc ** 2 / (len(cand) - 1) if sc > 0 else 0))
+    return mb, mc, diff, t975(df) * se
+
+
+def run_metrics(res):
+    """The metrics of one successful run by name; lower is better for all but fmax"""
+    m = {"total time (s)": res["wall_time"], "peak RSS (MiB)": res["peak_rss_kb"] / 1024.0,
+         "router iterations": res["router_iterations"]}
+    for phase, t in res["phases"].items():
+        m["{} time (s)".format(phase)] = t
+    if res.get("routed_wires") is not None:
+        m["routed wires"] = res["routed_wires"]
+    for clock, f in res["fmax"].items():
+        m["fmax {} (MHz)".format(clock)] = f
+    return m
+
+
+def collect(results):
+    """Samples of each metric, by design and metric name, and the number of failed runs of each design"""
+    samples, failed = {}, {}
+    for res in results:
+        if res["returncode"] != 0:
+            failed[res["design"]] = failed.get(res["design"], 0) + 1
+            continue
+        for name, value in run_metrics(res).items():
+            samples.setdefault(res["design"], {}).setdefault(name, []).append(value)
+    return samples, failed
+
+
+def compare(base_results, cand_results):
+    base, base_failed = collect(base_results)
+    cand, cand_failed = collect(cand_results)
+    report = {}
+    # Ratios of the candidate to the baseline mean of each metric over all designs, for the geometric mean
+    ratios = {}
+    for design in sorted(set(base) | set(cand) | set(base_failed) | set(cand_failed)):
+        print("{} (failed runs: baseline {}, candidate {})".format(design, base_failed.get(design, 0),
+                                                                   cand_failed.get(design, 0)))
+        rows = {}
+        bm, cm = base.get(design, {}), cand.get(design, {})
+        for metric in sorted(set(bm) & set(cm)):
+            mb, mc, diff, ci = compare_samples(bm[metric], cm[metric])
+            rel = 100.0 * diff / mb if mb != 0 else None
+            rel_ci = 100.0 * ci / abs(mb) if (ci is not None and mb != 0) else None
+            significant = ci is not None and abs(diff) > ci
+            rows[metric] = {"baseline": mb, "candidate": mc, "diff": diff, "ci95": ci, "rel": rel, "rel_ci95": rel_ci,
+                            "significant": significant, "samples": [len(bm[metric]), len(cm[metric])]}
+            if mb > 0 and mc > 0:
+                ratios.setdefault(metric, []).append(mc / mb)
+            print("    {:28s} {:>12.4g} {:>12.4g}  {}{}".format(
+                metric, mb, mc, "{:+.1f}%".format(rel) if rel is not None else "{:+.4g}".format(diff),
+                (" +/- {:.1f}%".format(rel_ci) if rel_ci is not None else
+                 " +/- {:.4g}".format(ci) if ci is not None else "") + (" *" if significant else "")))
+        report[design] = {"failed": [base_failed.get(design, 0), cand_failed.get(design, 0)], "metrics": rows}
+    geomean = {}
+    if ratios:
+        print("Geometric mean of candidate / baseline over all designs:")
+    for metric, rs in sorted(ratios.items()):
+        geomean[metric] = math.exp(sum(math.log(r) for r in rs) / len(rs))
+        print("    {:28s} {:.3f} ({} designs)".format(metric, geomean[metric], len(rs)))
+    return {"designs": report, "geomean_ratio": geomean}
+
+
+def load_runs(filename, label):
+    """The runs in a results file of xilinx_benchmark.py, or those of one build in a file written by this script"""
+    with open(filename) as f:
+        data = json.load(f)
+    return data[label] if isinstance(data, dict) else data
+
+
+def run_builds(args):
+    """Run the suite with both builds, returning the results of each"""
+    builds = [("baseline", args.baseline), ("candidate", args.candidate)]
+    results = {label: [] for label, _ in builds}
+    for label, _ in builds:
+        os.makedirs(path.join(args.work_dir, label), exist_ok=True)
+    for name, device, opts, sources, xdc in xilinx_benchmark.benchmark_designs(args.work_dir):
+        if args.designs and name not in args.designs:
+            continue
+        if not path.exists(path.join(args.chipdb_dir, device + ".bin")):
+            print("Skipping {}: no chipdb for {}".format(name, device))
+            continue
+        json_file = xilinx_benchmark.synthesise(name, opts, sources, args.work_dir)
+        for seed in range(1, args.seeds + 1):
+            for label, binary in (builds if seed % 2 else builds[::-1]):
+                run_args = copy.copy(args)
+                run_args.nextpnr = binary
+                res = xilinx_benchmark.run_nextpnr(run_args, name, device, json_file, xdc, seed,
+                                                   path.join(args.work_dir, label))
+                results[label].append(res)
+                print("{:10s} seed {} {:9s}: {} in {:.1f}s".format(name, seed, label,
+                                                                    "ok" if res["returncode"] == 0 else "FAILED",
+                                                                    res["wall_time"]))
+    return results["baseline"], results["candidate"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare the runtime and QoR of two nextpnr-xilinx builds")
+    parser.add_argument("--baseline", help="baseline nextpnr-xilinx binary")
+    parser.add_argument("--candidate", help="candidate nextpnr-xilinx binary")
+    parser.add_argument("--baseline-results", help="compare this results file instead of running the baseline")
+    parser.add_argument("--candidate-results", help="compare this results file instead of running the candidate")
+    parser.add_argument("--chipdb-dir", default=path.join(xilinx_benchmark.examples, ".."),
+                        help="directory containing the <device>.bin chip databases")
+    parser.add_argument("--work-dir", default="xilinx_compare", help="directory for synthesised designs and logs")
+    parser.add_argument("--results", default="xilinx_compare_results.json",
+                        help="JSON file to write the runs of both builds and the comparison to")
+    parser.add_argument("--designs", nargs="*", help="only run these designs")
+    parser.add_argument("--seeds", type=int, default=5, help="number of seeds to run for each design and build")
+    parser.add_argument("--threads", type=int, help="passed on to nextpnr")
+    parser.add_argument("extra", nargs=argparse.REMAINDER, help="extra arguments for nextpnr, after --")
+    args = parser.parse_args()
+    if args.extra[:1] == ["--"]:
+        args.extra = args.extra[1:]
+
+    if args.baseline_results or args.candidate_results:
+        if not (args.baseline_results and args.candidate_results):
+            parser.error("--baseline-results and --candidate-results must be given together")
+        base = load_runs(args.baseline_results, "baseline")
+        cand = load_runs(args.candidate_results, "candidate")
+    else:
+        if not (args.baseline and args.candidate):
+            parser.error("--baseline and --candidate binaries are needed, or two results files")
+        os.makedirs(args.work_dir, exist_ok=True)
+        base, cand = run_builds(args)
+
+    comparison = compare(base, cand)
+    with open(args.results, "w") as f:
+        json.dump({"baseline": base, "candidate": cand, "comparison": comparison}, f, indent=2)
+    failed = sum(1 for res in base + cand if res["returncode"] != 0)
+    print("{}/{} runs passed, comparison written to {}".format(len(base) + len(cand) - failed, len(base) + len(cand),
+                                                               args.results))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
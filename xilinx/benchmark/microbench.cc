@@ -0,0 +1,336 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/*
+ * Microbenchmarks of the Arch API calls the placers and routers make most, against a real chipdb:
+ *
+ *     nextpnr-xilinx-microbench --chipdb <device>.bin [--gtest_filter=...]
+ *
+ * Each benchmark calls one function over a fixed sample of bels, wires or pips of the empty device, repeating until
+ * at least min_time has passed, and prints the mean time per call. The result is also recorded as the ns_per_op
+ * property, for --gtest_output=json.
+ *
+ * The HashlibMicrobench benchmarks of dict don't need a chipdb, and are all that is run without one.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+std::string chipdb;
+const double min_time = 0.2;
+const size_t max_samples = 100000;
+
+class Microbench : public ::testing::Test
+{
+  protected:
+    // Run func, which does ops calls each time, until min_time has passed; print and record the time per call
+    template <typename F> void measure(size_t ops, F func)
+    {
+        ASSERT_GT(ops, size_t(0));
+        size_t total_ops = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        do {
+            func();
+            total_ops += ops;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < min_time);
+        double ns = elapsed * 1e9 / total_ops;
+        printf("%-40s %10.2f ns/op\n", ::testing::UnitTest::GetInstance()->current_test_info()->name(), ns);
+        RecordProperty("ns_per_op", std::to_string(ns));
+    }
+};
+
+class ArchMicrobench : public Microbench
+{
+  protected:
+    static Context *ctx;
+    static std::vector<BelId> bels;
+    static std::vector<WireId> wires;
+    static std::vector<PipId> pips;
+
+    // Every n-th object of range, so that the sample is spread over the whole device
+    template <typename R, typename T> static void sample(R range, std::vector<T> &out)
+    {
+        size_t count = 0;
+        for (auto obj : range) {
+            (void)obj;
+            ++count;
+        }
+        size_t step = std::max<size_t>(1, count / max_samples), i = 0;
+        for (auto obj : range)
+            if (i++ % step == 0)
+                out.push_back(obj);
+    }
+
+    static void SetUpTestCase()
+    {
+        ArchArgs args;
+        args.chipdb = chipdb;
+        ctx = new Context(args);
+        sample(ctx->getBels(), bels);
+        sample(ctx->getWires(), wires);
+        sample(ctx->getPips(), pips);
+        printf("sampled %d bels, %d wires, %d pips\n", int(bels.size()), int(wires.size()), int(pips.size()));
+    }
+
+    static void TearDownTestCase()
+    {
+        delete ctx;
+        ctx = nullptr;
+    }
+};
+
+Context *ArchMicrobench::ctx = nullptr;
+std::vector<BelId> ArchMicrobench::bels;
+std::vector<WireId> ArchMicrobench::wires;
+std::vector<PipId> ArchMicrobench::pips;
+
+// Stops the compiler from dropping calls whose results aren't otherwise used
+volatile int64_t sink;
+
+TEST_F(ArchMicrobench, getPipDelay)
+{
+    measure(pips.size(), [&]() {
+        delay_t sum = 0;
+        for (auto pip : pips)
+            sum += ctx->getPipDelay(pip).maxDelay();
+        sink = sum;
+    });
+}
+
+TEST_F(ArchMicrobench, estimateDelay)
+{
+    measure(wires.size(), [&]() {
+        delay_t sum = 0;
+        // Pairs a quarter of the sample apart, so mostly between distant tiles
+        for (size_t i = 0; i < wires.size(); i++)
+            sum += ctx->estimateDelay(wires[i], wires[(i + wires.size() / 4) % wires.size()]);
+        sink = sum;
+    });
+}
+
+TEST_F(ArchMicrobench, getPipsDownhill)
+{
+    size_t pip_count = 0;
+    for (auto wire : wires)
+        for (auto pip : ctx->getPipsDownhill(wire)) {
+            (void)pip;
+            ++pip_count;
+        }
+    printf("%d downhill pips per wire on average\n", int(pip_count / wires.size()));
+    // Per wire visited, including all of its pips
+    measure(wires.size(), [&]() {
+        int64_t sum = 0;
+        for (auto wire : wires)
+            for (auto pip : ctx->getPipsDownhill(wire))
+                sum += pip.index;
+        sink = sum;
+    });
+}
+
+TEST_F(ArchMicrobench, getBelPinWire)
+{
+    std::vector<std::pair<BelId, IdString>> bel_pins;
+    for (auto bel : bels)
+        for (auto pin : ctx->getBelPins(bel))
+            bel_pins.emplace_back(bel, pin);
+    measure(bel_pins.size(), [&]() {
+        int64_t sum = 0;
+        for (auto &bp : bel_pins)
+            sum += ctx->getBelPinWire(bp.first, bp.second).index;
+        sink = sum;
+    });
+}
+
+TEST_F(ArchMicrobench, isBelLocationValid)
+{
+    measure(bels.size(), [&]() {
+        int64_t sum = 0;
+        for (auto bel : bels)
+            sum += ctx->isBelLocationValid(bel);
+        sink = sum;
+    });
+}
+
+TEST_F(ArchMicrobench, bindUnbindPip)
+{
+    NetInfo *net = ctx->createNet(ctx->id("$microbench$net"));
+    std::vector<PipId> avail;
+    for (auto pip : pips)
+        if (ctx->checkPipAvail(pip) && ctx->checkWireAvail(ctx->getPipDstWire(pip)))
+            avail.push_back(pip);
+    // A bind and an unbind per op
+    measure(avail.size(), [&]() {
+        for (auto pip : avail) {
+            ctx->bindPip(pip, net, STRENGTH_WEAK);
+            ctx->unbindPip(pip);
+        }
+    });
+    ctx->nets.erase(net->name);
+}
+
+TEST_F(ArchMicrobench, idLookup)
+{
+    std::vector<std::string> names;
+    for (auto wire : wires)
+        names.push_back(ctx->getWireName(wire).str(ctx));
+    measure(names.size(), [&]() {
+        int64_t sum = 0;
+        for (auto &name : names)
+            sum += ctx->id(name).index;
+        sink = sum;
+    });
+}
+
+TEST_F(ArchMicrobench, idIntern)
+{
+    // New strings each round, so every call adds one
+    int round = 0;
+    const size_t count = 10000;
+    measure(count, [&]() {
+        int64_t sum = 0;
+        for (size_t i = 0; i < count; i++)
+            sum += ctx->id("$microbench$" + std::to_string(round) + "$" + std::to_string(i)).index;
+        ++round;
+        sink = sum;
+    });
+}
+
+TEST_F(ArchMicrobench, getWireName)
+{
+    measure(wires.size(), [&]() {
+        int64_t sum = 0;
+        for (auto wire : wires)
+            sum += ctx->getWireName(wire).index;
+        sink = sum;
+    });
+}
+
+// dict<WireId, int> with random keys, at sizes from fitting in the cache to far outside it
+class HashlibMicrobench : public Microbench, public ::testing::WithParamInterface<int>
+{
+  protected:
+    std::vector<WireId> keys, missing;
+
+    void SetUp() override
+    {
+        std::mt19937 rng(1);
+        int n = GetParam();
+        for (int i = 0; i < n; i++) {
+            WireId w, m;
+            w.tile = int(rng() % 200000);
+            w.index = int(rng() % 4096);
+            m.tile = w.tile + 200000;
+            m.index = w.index;
+            keys.push_back(w);
+            missing.push_back(m);
+        }
+    }
+
+    dict<WireId, int> filled()
+    {
+        dict<WireId, int> d;
+        for (size_t i = 0; i < keys.size(); i++)
+            d[keys[i]] = int(i);
+        return d;
+    }
+};
+
+TEST_P(HashlibMicrobench, insert)
+{
+    measure(keys.size(), [&]() {
+        dict<WireId, int> d;
+        for (size_t i = 0; i < keys.size(); i++)
+            d[keys[i]] = int(i);
+        sink = d.size();
+    });
+}
+
+TEST_P(HashlibMicrobench, reservedInsert)
+{
+    measure(keys.size(), [&]() {
+        dict<WireId, int> d;
+        d.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            d[keys[i]] = int(i);
+        sink = d.size();
+    });
+}
+
+TEST_P(HashlibMicrobench, lookupHit)
+{
+    auto d = filled();
+    measure(keys.size(), [&]() {
+        int64_t sum = 0;
+        for (auto &k : keys)
+            sum += d.count(k);
+        sink = sum;
+    });
+}
+
+TEST_P(HashlibMicrobench, lookupMiss)
+{
+    auto d = filled();
+    measure(missing.size(), [&]() {
+        int64_t sum = 0;
+        for (auto &k : missing)
+            sum += d.count(k);
+        sink = sum;
+    });
+}
+
+TEST_P(HashlibMicrobench, erase)
+{
+    // Includes filling the dict each time, which the insert benchmark gives on its own
+    measure(keys.size(), [&]() {
+        auto d = filled();
+        int64_t sum = 0;
+        for (auto &k : keys)
+            sum += d.erase(k);
+        sink = sum;
+    });
+}
+
+INSTANTIATE_TEST_CASE_P(Sizes, HashlibMicrobench, ::testing::Values(30000, 300000, 3000000));
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--chipdb") && i + 1 < argc)
+            chipdb = argv[++i];
+    }
+    if (chipdb.empty()) {
+        printf("No --chipdb given, only running the hashlib benchmarks.\n");
+        ::testing::GTEST_FLAG(filter) = "*HashlibMicrobench*";
+    }
+    return RUN_ALL_TESTS();
+}
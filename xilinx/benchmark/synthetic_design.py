@@ -0,0 +1,275 @@
+#!/usr/bin/env python3
+# Generator of synthetic netlists of Xilinx primitives, written as Yosys JSON, for measuring how the placers and
+# routers scale with design size. No synthesis is needed, so even designs of a million cells only take a minute.
+#
+# The design is a row of logic elements (a LUT and an FDRE, optionally with their LUT output on a CARRY4/CARRY8) and
+# some RAMB36 and DSP48 blocks. Connections follow Rent's rule: the elements are the leaves of a binary tree in row
+# order, and each input pin picks the tree level at which its driver is, such that a block of n elements has about
+# k * n^rent pins connected outside it (k being the pins per element). Within the chosen sibling block a driver is
+# picked by weight, and with a fanout skew above zero the weights are Pareto distributed, giving a heavy tailed
+# fanout distribution. A LUT input takes the LUT output of an earlier element if that keeps the logic depth within
+# the limit, otherwise its FF output, so there are no combinational loops.
+import argparse, json, random, sys
+from bisect import bisect_right
+
+# Per architecture: carry primitive and its width, block RAM and DSP primitives with the ports used
+archs = {
+    "xc7": {
+        "carry": ("CARRY4", 4),
+        "bram": ("RAMB36E1", "DIADI", "DOADO"),
+        "dsp": "DSP48E1",
+    },
+    "xcup": {
+        "carry": ("CARRY8", 8),
+        "bram": ("RAMB36E2", "DINADIN", "DOUTADOUT"),
+        "dsp": "DSP48E2",
+    },
+}
+
+lut_inputs = ["I0", "I1", "I2", "I3", "I4", "I5"]
+
+
+# Cells are written out as they are made, so that large designs don't have to be held in memory
+class Netlist:
+    def __init__(self, f):
+        self.f = f
+        self.next_bit = 2
+        self.first = True
+
+    def bit(self):
+        b = self.next_bit
+        self.next_bit += 1
+        return b
+
+    def begin(self, ports):
+        self.f.write('{\n  "creator": "nextpnr-xilinx synthetic_design.py",\n  "modules": {\n    "top": {\n')
+        self.f.write('      "attributes": {"top": "00000000000000000000000000000001"},\n')
+        self.f.write('      "ports": ' + json.dumps(ports) + ',\n      "cells": {')
+
+    def cell(self, name, type, params, dirs, conns):
+        self.f.write('{}\n        {}: {}'.format(
+            "" if self.first else ",", json.dumps(name),
+            json.dumps({"hide_name": 0, "type": type, "parameters": params, "attributes": {},
+                        "port_directions": dirs, "connections": conns})))
+        self.first = False
+
+    def end(self, netnames):
+        self.f.write('\n      },\n      "netnames": ' + json.dumps(netnames) + '\n    }\n  }\n}\n')
+
+
+def param_bits(value, width):
+    return format(value, "0{}b".format(width))
+
+
+def generate(f, arch="xc7", elements=10000, rent=0.65, fanout_skew=0.0, max_depth=6, comb_prob=0.5,
+             carry_fraction=0.1, carry_length=16, bram_per_k=2.0, dsp_per_k=2.0, ce_nets=16, outputs=8, seed=1):
+    """Write a synthetic design of the given number of logic elements to f; returns a dict of cell counts"""
+    rng = random.Random(seed)
+    a = archs[arch]
+    nl = Netlist(f)
+    n = elements
+
+    clk_pad, clk_ibuf, clk = nl.bit(), nl.bit(), nl.bit()
+    out_pads = [nl.bit() for _ in range(outputs)]
+    ports = {"clk": {"direction": "input", "bits": [clk_pad]}}
+    if outputs > 0:
+        ports["out"] = {"direction": "output", "bits": out_pads}
+    nl.begin(ports)
+    nl.cell("clk_ibuf", "IBUF", {}, {"I": "input", "O": "output"}, {"I": [clk_pad], "O": [clk_ibuf]})
+    nl.cell("clk_bufg", "BUFG", {}, {"I": "input", "O": "output"}, {"I": [clk_ibuf], "O": [clk]})
+
+    # Each element has a comb output (the LUT, or the carry output it feeds) and an FF output
+    lut_out = [nl.bit() for _ in range(n)]
+    ff_out = [nl.bit() for _ in range(n)]
+    depth = [0] * n
+    in_chain = [False] * n
+
+    # Driver weights, as prefix sums for picking by weight within a range of elements
+    prefix = [0.0]
+    for _ in range(n):
+        w = rng.paretovariate(1.0 / fanout_skew) if fanout_skew > 0 else 1.0
+        prefix.append(prefix[-1] + w)
+
+    # Probability that a pin is driven from outside its block at each level, k * (2^L)^rent / (k * 2^L)
+    levels = max(1, (n - 1).bit_length())
+    leave = [2.0 ** (-level * (1.0 - rent)) for level in range(levels + 1)]
+
+    # Level L with probability leave[L] - leave[L + 1], the top level also taking the rest
+    def pick_level():
+        r = rng.random()
+        for level in range(levels - 1, 0, -1):
+            if r < leave[level]:
+                return level
+        return 0
+
+    def pick_driver(i):
+        for _ in range(8):
+            level = pick_level()
+            lo = ((i >> (level + 1)) << (level + 1)) + ((((i >> level) & 1) ^ 1) << level)
+            hi = min(lo + (1 << level), n)
+            if lo < hi:
+                return bisect_right(prefix, prefix[lo] + rng.random() * (prefix[hi] - prefix[lo])) - 1
+        return rng.randrange(n)
+
+    # Hard blocks hang off an element; LUT inputs picking that element may take one of their outputs instead
+    hard_outputs = {}
+    counts = {"LUT": 0, "FDRE": 0, "carry": 0, "bram": 0, "dsp": 0}
+
+    def add_hard(kind, i):
+        name = "{}_{}".format(kind, counts[kind])
+        if kind == "bram":
+            # 2K x 18 on both ports, which uses address bits 14:4; RAMB36E1 has a cascade address bit on top
+            type, din, dout = a["bram"]
+            addr_top = ["1"] if arch == "xc7" else []
+            addr_a = ["1"] * 4 + [pick_driver_ff(i) for _ in range(11)] + addr_top
+            addr_b = ["1"] * 4 + [pick_driver_ff(i) for _ in range(11)] + addr_top
+            data = [pick_driver_ff(i) for _ in range(16)]
+            out = [nl.bit() for _ in range(16)]
+            conns = {"CLKARDCLK": [clk], "CLKBWRCLK": [clk], "ENARDEN": ["1"], "ENBWREN": ["1"],
+                     "ADDRARDADDR": addr_a, "ADDRBWRADDR": addr_b, din: data, dout: out,
+                     "WEA": [pick_driver_ff(i)] * 2 + ["0"] * 2, "WEBWE": ["0"] * 8}
+            dirs = {p: "input" for p in conns}
+            dirs[dout] = "output"
+            params = {"READ_WIDTH_A": param_bits(18, 32), "WRITE_WIDTH_A": param_bits(18, 32),
+                      "READ_WIDTH_B": param_bits(18, 32), "WRITE_WIDTH_B": param_bits(18, 32)}
+        else:
+            type = a["dsp"]
+            conns = {"CLK": [clk], "A": [pick_driver_ff(i) for _ in range(25)] + ["0"] * 5,
+                     "B": [pick_driver_ff(i) for _ in range(18)], "P": [nl.bit() for _ in range(48)]}
+            for ce in ["CEA2", "CEB2", "CEM", "CEP"]:
+                conns[ce] = ["1"]
+            for rst in ["RSTA", "RSTB", "RSTM", "RSTP"]:
+                conns[rst] = ["0"]
+            dirs = {p: "input" for p in conns}
+            dirs["P"] = "output"
+            out = conns["P"]
+            params = {}
+        nl.cell(name, type, params, dirs, conns)
+        hard_outputs.setdefault(i, []).extend(out)
+        counts[kind] += 1
+
+    def pick_driver_ff(i):
+        return ff_out[pick_driver(i)]
+
+    # Carry chains are runs of whole carry cells over consecutive elements
+    carry_type, carry_width = a["carry"]
+    chain_len = max(1, carry_length // carry_width)
+    i = 0
+    chains = []
+    while i + chain_len * carry_width <= n:
+        if rng.random() < carry_fraction:
+            chains.append(i)
+            for j in range(chain_len * carry_width):
+                in_chain[i + j] = True
+            i += chain_len * carry_width
+        else:
+            i += carry_width
+
+    hard_sites = []
+    for kind, per_k in (("bram", bram_per_k), ("dsp", dsp_per_k)):
+        for _ in range(int(n * per_k / 1000)):
+            hard_sites.append((kind, rng.randrange(n)))
+    for kind, i in hard_sites:
+        add_hard(kind, i)
+    hard_next = {i: 0 for i in hard_outputs}
+
+    # Clock enables: a few high fanout nets, used in Zipf proportions
+    ce_drivers = [ff_out[rng.randrange(n)] for _ in range(ce_nets)]
+    ce_weights = [1.0 / (k + 1) for k in range(ce_nets)]
+
+    lut_sizes = [1, 2, 3, 4, 5, 6]
+    lut_size_weights = [1, 2, 3, 4, 4, 8]
+    lut_in = [None] * n
+    for i in range(n):
+        k = rng.choices(lut_sizes, lut_size_weights)[0]
+        ins = []
+        d = 0
+        for _ in range(k):
+            j = pick_driver(i)
+            if j in hard_outputs and rng.random() < 0.5:
+                outs = hard_outputs[j]
+                ins.append(outs[hard_next[j] % len(outs)])
+                hard_next[j] += 1
+            elif j < i and not in_chain[j] and depth[j] < max_depth and rng.random() < comb_prob:
+                ins.append(lut_out[j])
+                d = max(d, depth[j])
+            else:
+                ins.append(ff_out[j])
+        depth[i] = d + 1
+        lut_in[i] = ins
+        init = rng.getrandbits(1 << k)
+        nl.cell("lut_{}".format(i), "LUT{}".format(k), {"INIT": param_bits(init, 1 << k)},
+                dict([(p, "input") for p in lut_inputs[:k]] + [("O", "output")]),
+                dict([(p, [b]) for p, b in zip(lut_inputs[:k], ins)] + [("O", [lut_out[i]])]))
+        counts["LUT"] += 1
+
+    # The carry outputs replace the LUT outputs as the FF inputs of chain elements
+    ff_d = list(lut_out)
+    for start in chains:
+        ci = "0"
+        for c in range(chain_len):
+            base = start + c * carry_width
+            s = [lut_out[base + j] for j in range(carry_width)]
+            di = [lut_in[base + j][0] for j in range(carry_width)]
+            o = [nl.bit() for _ in range(carry_width)]
+            co = [nl.bit() for _ in range(carry_width)]
+            conns = {"CI": [ci], "DI": di, "S": s, "O": o, "CO": co}
+            if carry_type == "CARRY4":
+                conns["CYINIT"] = ["0"]
+                params = {}
+            else:
+                conns["CI_TOP"] = ["0"]
+                params = {"CARRY_TYPE": "SINGLE_CY8"}
+            dirs = {p: "input" for p in conns}
+            dirs["O"] = dirs["CO"] = "output"
+            nl.cell("carry_{}".format(base), carry_type, params, dirs, conns)
+            for j in range(carry_width):
+                ff_d[base + j] = o[j]
+            ci = co[-1]
+            counts["carry"] += 1
+
+    for i in range(n):
+        ce = rng.choices(ce_drivers, ce_weights)[0] if ce_nets > 0 else "1"
+        nl.cell("ff_{}".format(i), "FDRE", {"INIT": "0"},
+                {"C": "input", "CE": "input", "R": "input", "D": "input", "Q": "output"},
+                {"C": [clk], "CE": [ce], "R": ["0"], "D": [ff_d[i]], "Q": [ff_out[i]]})
+        counts["FDRE"] += 1
+
+    for k, pad in enumerate(out_pads):
+        nl.cell("out_obuf_{}".format(k), "OBUF", {}, {"I": "input", "O": "output"},
+                {"I": [ff_out[rng.randrange(n)]], "O": [pad]})
+    nl.end({"clk": {"hide_name": 0, "bits": [clk], "attributes": {}}})
+    return counts
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a synthetic Xilinx netlist as Yosys JSON")
+    parser.add_argument("output", help="JSON file to write")
+    parser.add_argument("--arch", choices=sorted(archs.keys()), default="xc7", help="primitive family")
+    parser.add_argument("--elements", type=int, default=10000, help="number of LUT and FF pairs")
+    parser.add_argument("--rent", type=float, default=0.65, help="Rent exponent of the connections")
+    parser.add_argument("--fanout-skew", type=float, default=0.0,
+                        help="spread of the driver weights (0 for uniform; around 0.5 gives a heavy tail)")
+    parser.add_argument("--max-depth", type=int, default=6, help="maximum LUTs between FFs")
+    parser.add_argument("--comb-prob", type=float, default=0.5,
+                        help="probability of taking a LUT output rather than an FF output, where allowed")
+    parser.add_argument("--carry-fraction", type=float, default=0.1,
+                        help="probability of starting a carry chain at each carry cell position")
+    parser.add_argument("--carry-length", type=int, default=16, help="carry chain length, in bits")
+    parser.add_argument("--bram-per-k", type=float, default=2.0, help="RAMB36 blocks per 1000 elements")
+    parser.add_argument("--dsp-per-k", type=float, default=2.0, help="DSP blocks per 1000 elements")
+    parser.add_argument("--ce-nets", type=int, default=16, help="number of FF clock enable nets (0 for none)")
+    parser.add_argument("--outputs", type=int, default=8, help="number of output pins")
+    parser.add_argument("--seed", type=int, default=1, help="random seed")
+    args = parser.parse_args()
+    with open(args.output, "w") as f:
+        counts = generate(f, arch=args.arch, elements=args.elements, rent=args.rent, fanout_skew=args.fanout_skew,
+                          max_depth=args.max_depth, comb_prob=args.comb_prob, carry_fraction=args.carry_fraction,
+                          carry_length=args.carry_length, bram_per_k=args.bram_per_k, dsp_per_k=args.dsp_per_k,
+                          ce_nets=args.ce_nets, outputs=args.outputs, seed=args.seed)
+    print(", ".join("{} {}".format(v, k) for k, v in counts.items()))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+# End-to-end benchmark of the Xilinx flow: synthesises each design with Yosys (once, cached in the work directory),
+# runs nextpnr-xilinx on it and writes the wall time of each flow phase, peak RSS, router2 iterations, routed wire
+# count, fmax and the --perf-report of each run to a JSON results file. compare_builds.py runs the same designs with
+# two builds and compares them. Designs are the examples from xilinx/examples, plus synthetic designs of increasing
+# size.
+#
+# With --scaling, it instead runs netlists from synthetic_design.py of each of --scaling-sizes elements, and also
+# writes the time of each phase against the design size, with the exponent of a power law fitted to it.
+import argparse, json, math, os, re, sys, time
+from os import path
+import subprocess
+
+sys.path.insert(0, path.dirname(path.abspath(__file__)))
+import synthetic_design
+
+examples = path.join(path.dirname(path.abspath(__file__)), "..", "examples")
+
+# name: (device chipdb, yosys synth_xilinx options, sources, xdc)
+designs = {
+    "blinky": ("xczu2cg", "-nobram", ["blinky/blinky.v"], None),
+    "attosoc": ("xczu2cg", "-nobram", ["attosoc/attosoc_top.v", "attosoc/attosoc.v"], None),
+    "arty-a35": ("xc7a35t", "-nowidelut -abc9 -arch xc7", ["attosoc/attosoc.v", "arty-a35/attosoc_top.v"],
+                 "arty-a35/arty.xdc"),
+    "zcu104": ("xczu7ev", "-arch xcup -nobram", ["attosoc/attosoc.v", "zcu104/blinky.v"], "zcu104/zcu104.xdc"),
+}
+
+# Synthetic designs: this many lanes of LFSR feeding an accumulator, each lane also mixing in its neighbour
+synthetic_sizes = [16, 64, 256]
+
+# Log lines marking the start of each phase; a phase ends where the next one seen starts
+phase_markers = [
+    ("pack", re.compile(r"Packing ")),
+    ("place", re.compile(r"Device utilisation")),
+    ("route", re.compile(r"Routing Vcc|Routing global clocks|Router2|Setting up routing")),
+    ("write", re.compile(r"Router2 time|Routing complete")),
+]
+router_iter_re = re.compile(r"iter=(\d+) wires=(\d+)")
+fmax_re = re.compile(r"Max frequency for clock +'([^']+)': ([0-9.]+) MHz")
+
+
+def synthetic_verilog(lanes):
+    v = ["module top(input clk_i, output [7:0] led);"]
+    v.append("    wire clk;")
+    v.append("    BUFGCTRL #(.IS_CE1_INVERTED(1'b1), .IS_IGNORE0_INVERTED(1'b1), .IS_IGNORE1_INVERTED(1'b1),")
+    v.append("        .IS_S1_INVERTED(1'b1)) bufg_i (.I0(clk_i), .CE0(1'b1), .CE1(1'b1), .IGNORE0(1'b1),")
+    v.append("        .IGNORE1(1'b1), .S0(1'b1), .S1(1'b1), .O(clk));")
+    for i in range(lanes):
+        v.append("    reg [31:0] lfsr{0} = 32'd{1};".format(i, i + 1))
+        v.append("    reg [31:0] acc{0} = 32'd0;".format(i))
+    for i in range(lanes):
+        n = (i + 1) % lanes
+        v.append("    always @(posedge clk) begin")
+        v.append("        lfsr{0} <= {{lfsr{0}[30:0], lfsr{0}[31] ^ lfsr{0}[21] ^ lfsr{0}[1] ^ lfsr{0}[0]}};".format(i))
+        v.append("        acc{0} <= acc{0} + (lfsr{0} ^ {{acc{1}[15:0], acc{1}[31:16]}});".format(i, n))
+        v.append("    end")
+    v.append("    assign led = {};".format(" ^ ".join("acc{}[31:24]".format(i) for i in range(lanes))))
+    v.append("endmodule")
+    return "\n".join(v) + "\n"
+
+
+def synthesise(name, opts, sources, workdir):
+    json_file = path.join(workdir, name + ".json")
+    if not path.exists(json_file):
+        subprocess.run(["yosys", "-ql", path.join(workdir, name + "_yosys.log"), "-p",
+                        "synth_xilinx -flatten {} -top top; write_json {}".format(opts, json_file)] + sources,
+                       check=True)
+    return json_file
+
+
+def run_nextpnr(args, name, device, json_file, xdc, seed, workdir):
+    cmd = [args.nextpnr, "--chipdb", path.join(args.chipdb_dir, device + ".bin"), "--json", json_file,
+           "--seed", str(seed)]
+    # The write phase is FASM for xc7, which is what a real flow would use, and the routed JSON otherwise
+    if device.startswith("xc7"):
+        cmd += ["--fasm", path.join(workdir, "{}_s{}.fasm".format(name, seed))]
+    else:
+        cmd += ["--write", path.join(workdir, "{}_s{}_routed.json".format(name, seed))]
+    if xdc is not None:
+        cmd += ["--xdc", xdc]
+    if args.threads is not None:
+        cmd += ["--threads", str(args.threads)]
+    perf_file = path.join(workdir, "{}_s{}_perf.json".format(name, seed))
+    cmd += ["--perf-report", perf_file]
+    cmd += args.extra
+    result = {"design": name, "device": device, "seed": seed}
+    log_file = path.join(workdir, "{}_s{}.log".format(name, seed))
+    phases = {}
+    current, current_start = "load", time.monotonic()
+    router_iters = 0
+    routed_wires = None
+    fmax = {}
+    start = time.monotonic()
+    with open(log_file, "w") as log:
+        proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+        for line in proc.stdout:
+            log.write(line)
+            now = time.monotonic()
+            for phase, marker in phase_markers:
+                if phase not in phases and phase != current and marker.search(line):
+                    phases[current] = now - current_start
+                    current, current_start = phase, now
+                    break
+            m = router_iter_re.search(line)
+            if m:
+                router_iters = max(router_iters, int(m.group(1)))
+                # The wires in use after the last iteration, a measure of the routed wirelength
+                routed_wires = int(m.group(2))
+            m = fmax_re.search(line)
+            if m:
+                fmax[m.group(1)] = float(m.group(2))
+        _, status, rusage = os.wait4(proc.pid, 0)
+    end = time.monotonic()
+    phases[current] = end - current_start
+    result["returncode"] = os.waitstatus_to_exitcode(status) if hasattr(os, "waitstatus_to_exitcode") else status
+    result["wall_time"] = end - start
+    result["phases"] = phases
+    # ru_maxrss is in KiB on Linux
+    result["peak_rss_kb"] = rusage.ru_maxrss
+    result["router_iterations"] = router_iters
+    result["routed_wires"] = routed_wires
+    result["fmax"] = fmax
+    # nextpnr's own per-phase report, with CPU time and memory growth as well as wall time
+    if path.exists(perf_file):
+        with open(perf_file) as f:
+            result["perf_report"] = json.load(f)
+    return result
+
+
+def benchmark_designs(work_dir):
+    """The designs of the benchmark suite, as (name, device, yosys options, sources, xdc) of each"""
+    todo = []
+    for name, (device, opts, sources, xdc) in sorted(designs.items()):
+        todo.append((name, device, opts, [path.join(examples, s) for s in sources],
+                     path.join(examples, xdc) if xdc is not None else None))
+    for lanes in synthetic_sizes:
+        name = "synth{}".format(lanes)
+        vfile = path.join(work_dir, name + ".v")
+        with open(vfile, "w") as f:
+            f.write(synthetic_verilog(lanes))
+        todo.append((name, "xczu2cg", "-nobram", [vfile], None))
+    return todo
+
+
+def scaling_designs(args):
+    """Generate the synthetic netlists of each size, returning (name, device, json file) of each"""
+    arch = "xc7" if args.scaling_device.startswith("xc7") else "xcup"
+    todo = []
+    for size in args.scaling_sizes:
+        name = "scale{}".format(size)
+        json_file = path.join(args.work_dir, "{}_{}.json".format(name, arch))
+        if not path.exists(json_file):
+            with open(json_file, "w") as f:
+                synthetic_design.generate(f, arch=arch, elements=size, rent=args.rent)
+        todo.append((name, args.scaling_device, json_file))
+    return todo
+
+
+def fit_scaling(results):
+    """Per phase, the time of each run by design size and the exponent b of time = a * size^b fitted to them"""
+    by_phase = {}
+    for res in results:
+        if res["returncode"] != 0:
+            continue
+        for phase, t in res["phases"].items():
+            by_phase.setdefault(phase, []).append((res["elements"], t))
+        by_phase.setdefault("total", []).append((res["elements"], res["wall_time"]))
+    scaling = {}
+    for phase, points in sorted(by_phase.items()):
+        logs = [(math.log(n), math.log(t)) for n, t in points if t > 0]
+        exponent = None
+        if len(set(x for x, _ in logs)) >= 2:
+            mx = sum(x for x, _ in logs) / len(logs)
+            my = sum(y for _, y in logs) / len(logs)
+            exponent = sum((x - mx) * (y - my) for x, y in logs) / sum((x - mx) ** 2 for x, _ in logs)
+        scaling[phase] = {"points": sorted(points), "exponent": exponent}
+    return scaling
+
+
+def run_scaling(args):
+    if not path.exists(path.join(args.chipdb_dir, args.scaling_device + ".bin")):
+        print("No chipdb for {}".format(args.scaling_device))
+        return 1
+    results = []
+    failed = 0
+    for name, device, json_file in scaling_designs(args):
+        for seed in range(1, args.seeds + 1):
+            res = run_nextpnr(args, name, device, json_file, None, seed, args.work_dir)
+            res["elements"] = int(name[len("scale"):])
+            results.append(res)
+            if res["returncode"] != 0:
+                failed += 1
+            print("{:12s} seed {}: {} in {:.1f}s ({}), peak RSS {:.0f} MiB".format(
+                name, seed, "ok" if res["returncode"] == 0 else "FAILED", res["wall_time"],
+                ", ".join("{} {:.1f}s".format(p, t) for p, t in res["phases"].items()), res["peak_rss_kb"] / 1024))
+
+    scaling = fit_scaling(results)
+    for phase, s in scaling.items():
+        if s["exponent"] is not None:
+            print("{:8s} time ~ size^{:.2f}".format(phase, s["exponent"]))
+    with open(args.results, "w") as f:
+        json.dump(results, f, indent=2)
+    with open(args.scaling_results, "w") as f:
+        json.dump(scaling, f, indent=2)
+    print("{}/{} runs passed, scaling written to {}".format(len(results) - failed, len(results),
+                                                            args.scaling_results))
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the nextpnr-xilinx flow")
+    parser.add_argument("--nextpnr", default="./nextpnr-xilinx", help="nextpnr-xilinx binary")
+    parser.add_argument("--chipdb-dir", default=path.join(examples, ".."),
+                        help="directory containing the <device>.bin chip databases")
+    parser.add_argument("--work-dir", default="xilinx_bench", help="directory for synthesised designs and logs")
+    parser.add_argument("--results", default="xilinx_bench_results.json", help="JSON results file to write")
+    parser.add_argument("--designs", nargs="*", help="only run these designs")
+    parser.add_argument("--seeds", type=int, default=1, help="number of seeds to run for each design")
+    parser.add_argument("--threads", type=int, help="passed on to nextpnr")
+    parser.add_argument("--scaling", action="store_true", help="run synthetic designs of increasing size instead")
+    parser.add_argument("--scaling-sizes", type=int, nargs="*", default=[2000, 5000, 10000, 20000, 50000, 100000],
+                        help="numbers of LUT and FF pairs of the scaling designs")
+    parser.add_argument("--scaling-device", default="xczu7ev", help="device for the scaling designs")
+    parser.add_argument("--rent", type=float, default=0.65, help="Rent exponent of the scaling designs")
+    parser.add_argument("--scaling-results", default="xilinx_bench_scaling.json",
+                        help="JSON file to write the scaling of each phase to")
+    parser.add_argument("extra", nargs=argparse.REMAINDER, help="extra arguments for nextpnr, after --")
+    args = parser.parse_args()
+    if args.extra[:1] == ["--"]:
+        args.extra = args.extra[1:]
+
+    os.makedirs(args.work_dir, exist_ok=True)
+    if args.scaling:
+        return run_scaling(args)
+    results = []
+    failed = 0
+    for name, device, opts, sources, xdc in benchmark_designs(args.work_dir):
+        if args.designs and name not in args.designs:
+            continue
+        if not path.exists(path.join(args.chipdb_dir, device + ".bin")):
+            print("Skipping {}: no chipdb for {}".format(name, device))
+            continue
+        json_file = synthesise(name, opts, sources, args.work_dir)
+        for seed in range(1, args.seeds + 1):
+            res = run_nextpnr(args, name, device, json_file, xdc, seed, args.work_dir)
+            results.append(res)
+            if res["returncode"] != 0:
+                failed += 1
+            print("{:10s} seed {}: {} in {:.1f}s, peak RSS {:.0f} MiB, {} router iterations, fmax {}".format(
+                name, seed, "ok" if res["returncode"] == 0 else "FAILED", res["wall_time"], res["peak_rss_kb"] / 1024,
+                res["router_iterations"], ", ".join("{} {:.1f} MHz".format(c, f) for c, f in res["fmax"].items())))
+
+    with open(args.results, "w") as f:
+        json.dump(results, f, indent=2)
+    print("{}/{} runs passed, results written to {}".format(len(results) - failed, len(results), args.results))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -23,3 +23,23 @@ if (DEFINED RAPIDWRIGHT_PATH)
 endif()
 
 
+
+# End-to-end benchmark of the examples and some synthetic designs, writing bench_results.json in the build directory
+set(XILINX_BENCH_CHIPDB_DIR "${CMAKE_CURRENT_SOURCE_DIR}/xilinx" CACHE PATH "Directory of chip databases for the bench target")
+add_custom_target(bench
+	COMMAND ${PYTHON_EXECUTABLE} ${CMAKE_CURRENT_SOURCE_DIR}/xilinx/benchmark/xilinx_benchmark.py
+		--nextpnr $<TARGET_FILE:nextpnr-xilinx> --chipdb-dir ${XILINX_BENCH_CHIPDB_DIR}
+		--work-dir ${CMAKE_CURRENT_BINARY_DIR}/bench --results ${CMAKE_CURRENT_BINARY_DIR}/bench_results.json
+	DEPENDS nextpnr-xilinx
+	USES_TERMINAL)
+
+# Run time of each phase against design size, on generated designs, writing bench_scaling.json in the build directory
+set(XILINX_BENCH_SCALING_DEVICE "xczu7ev" CACHE STRING "Device for the bench-scaling target")
+add_custom_target(bench-scaling
+	COMMAND ${PYTHON_EXECUTABLE} ${CMAKE_CURRENT_SOURCE_DIR}/xilinx/benchmark/xilinx_benchmark.py --scaling
+		--nextpnr $<TARGET_FILE:nextpnr-xilinx> --chipdb-dir ${XILINX_BENCH_CHIPDB_DIR}
+		--scaling-device ${XILINX_BENCH_SCALING_DEVICE} --work-dir ${CMAKE_CURRENT_BINARY_DIR}/bench
+		--results ${CMAKE_CURRENT_BINARY_DIR}/bench_scaling_runs.json
+		--scaling-results ${CMAKE_CURRENT_BINARY_DIR}/bench_scaling.json
+	DEPENDS nextpnr-xilinx
+	USES_TERMINAL)
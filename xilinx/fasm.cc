@@ -17,12 +17,16 @@
  *
  */
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <fstream>
+#include <sstream>
 #include "log.h"
+#include "lut_table.h"
 #include "nextpnr.h"
 #include "pins.h"
+#include "thread_pool.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -31,34 +35,53 @@ struct FasmBackend
 {
     Context *ctx;
     std::ostream &out;
-    std::vector<std::string> fasm_ctx;
-    std::unordered_map<int, std::vector<PipId>> pips_by_tile;
-
-    std::unordered_map<IdString, std::unordered_set<IdString>> invertible_pins;
-
-    FasmBackend(Context *ctx, std::ostream &out) : ctx(ctx), out(out){};
-
-    void push(const std::string &x) { fasm_ctx.push_back(x); }
+    // Current feature prefix, kept as one string with the length before each push so it can be popped
+    std::string fasm_prefix;
+    std::vector<size_t> fasm_prefix_lens;
+    // Lookup tables; a worker backend writing part of the output in parallel shares those of its parent
+    std::unordered_map<int, std::vector<PipId>> own_pips_by_tile, &pips_by_tile;
+    std::unordered_map<IdString, std::unordered_set<IdString>> own_invertible_pins, &invertible_pins;
+    // Warnings from a worker, logged in order once its output is merged
+    bool is_worker = false;
+    std::vector<std::string> warnings;
+
+    FasmBackend(Context *ctx, std::ostream &out)
+            : ctx(ctx), out(out), pips_by_tile(own_pips_by_tile), invertible_pins(own_invertible_pins),
+              pp_features(own_pp_features), pp_index(own_pp_index){};
+
+    FasmBackend(FasmBackend &parent, std::ostream &out)
+            : ctx(parent.ctx), out(out), pips_by_tile(parent.pips_by_tile), invertible_pins(parent.invertible_pins),
+              is_worker(true), pp_features(parent.pp_features), pp_index(parent.pp_index){};
+
+    void push(const std::string &x)
+    {
+        fasm_prefix_lens.push_back(fasm_prefix.size());
+        fasm_prefix += x;
+        fasm_prefix += '.';
+    }
 
-    void pop() { fasm_ctx.pop_back(); }
+    void pop()
+    {
+        fasm_prefix.resize(fasm_prefix_lens.back());
+        fasm_prefix_lens.pop_back();
+    }
 
     void pop(int N)
     {
         for (int i = 0; i < N; i++)
-            fasm_ctx.pop_back();
+            pop();
     }
     bool last_was_blank = true;
     void blank()
     {
         if (!last_was_blank)
-            out << std::endl;
+            out << '\n';
         last_was_blank = true;
     }
 
     void write_prefix()
     {
-        for (auto &x : fasm_ctx)
-            out << x << ".";
+        out << fasm_prefix;
         last_was_blank = false;
     }
 
@@ -66,7 +89,7 @@ struct FasmBackend
     {
         if (value) {
             write_prefix();
-            out << name << std::endl;
+            out << name << '\n';
         }
     }
 
@@ -76,15 +99,18 @@ struct FasmBackend
         out << name << " = " << int(value.size()) << "'b";
         for (auto bit : boost::adaptors::reverse(value))
             out << ((bit ^ invert) ? '1' : '0');
-        out << std::endl;
+        out << '\n';
     }
 
     void write_int_vector(const std::string &name, uint64_t value, int width, bool invert = false)
     {
-        std::vector<bool> bits(width, false);
-        for (int i = 0; i < width; i++)
-            bits[i] = (value & (1ULL << i)) != 0;
-        write_vector(name, bits, invert);
+        write_prefix();
+        out << name << " = " << width << "'b";
+        for (int i = width - 1; i >= 0; i--) {
+            bool bit = (value >> i) & 1;
+            out << ((bit ^ invert) ? '1' : '0');
+        }
+        out << '\n';
     }
 
     struct PseudoPipKey
@@ -110,13 +136,17 @@ struct FasmBackend
         }
     };
 
-    std::unordered_map<PseudoPipKey, std::vector<std::string>, PseudoPipKey::Hash> pp_config;
+    // The config bits set by each pseudo pip, and for each tile type with pseudo pips the index into pp_features of
+    // each of its pips (or -1), so that writing a pip is a direct lookup
+    std::vector<std::vector<std::string>> own_pp_features, &pp_features;
+    std::vector<std::vector<int32_t>> own_pp_index, &pp_index;
     void get_pseudo_pip_data()
     {
         /*
          * Create the mapping from pseudo pip tile type, source wire, and dest wire, to
          * the config bits set when that pseudo pip is used
          */
+        std::unordered_map<PseudoPipKey, std::vector<std::string>, PseudoPipKey::Hash> pp_config;
         for (std::string s : {"L", "R"})
             for (std::string s2 : {"", "_TBYTESRC", "_TBYTETERM", "_SING"})
                 for (std::string i :
@@ -184,12 +214,81 @@ struct FasmBackend
                            ctx->id("INT_INTERFACE_LOGIC_OUTS_" + s + "_B" + ii)}];
             }
         }
+
+        // Resolve the keys to the pips of the tile types that have any
+        std::unordered_set<IdString> pp_tile_types;
+        for (auto &entry : pp_config)
+            pp_tile_types.insert(entry.first.tileType);
+        std::unordered_map<PseudoPipKey, int32_t, PseudoPipKey::Hash> feature_index;
+        pp_index.resize(ctx->chip_info->num_tiletypes);
+        for (int type = 0; type < ctx->chip_info->num_tiletypes; type++) {
+            auto &td = ctx->chip_info->tile_types[type];
+            if (!pp_tile_types.count(IdString(td.type)))
+                continue;
+            pp_index.at(type).assign(td.num_pips, -1);
+            for (int i = 0; i < td.num_pips; i++) {
+                auto &pd = td.pip_data[i];
+                if (pd.flags != PIP_TILE_ROUTING)
+                    continue;
+                auto fnd = pp_config.find({IdString(td.type), IdString(td.wire_data[pd.dst_index].name),
+                                           IdString(td.wire_data[pd.src_index].name)});
+                if (fnd == pp_config.end())
+                    continue;
+                auto inserted = feature_index.emplace(fnd->first, int32_t(pp_features.size()));
+                if (inserted.second)
+                    pp_features.push_back(fnd->second);
+                pp_index.at(type).at(i) = inserted.first->second;
+            }
+        }
     }
 
-    void write_pip(PipId pip, NetInfo *net)
+    void warning(const std::string &msg)
     {
-        pips_by_tile[pip.tile].push_back(pip);
+        if (is_worker)
+            warnings.push_back(msg);
+        else
+            log_warning("%s", msg.c_str());
+    }
 
+    // Write func(backend, item) for each item, on worker threads into separate buffers that are then written out
+    // in item order. Each item is followed by blank(), so the output is the same as writing them in turn.
+    template <typename T, typename Tf> void write_parallel(const std::vector<T> &items, Tf func)
+    {
+        if (ctx->threadPool().threads_for(items.size(), 1) <= 1) {
+            for (auto &item : items) {
+                func(*this, item);
+                blank();
+            }
+            return;
+        }
+        struct ItemResult
+        {
+            std::string text;
+            std::vector<std::string> warnings;
+        };
+        std::vector<ItemResult> results(items.size());
+        ctx->threadPool().parallel_for(
+                items.size(), 1,
+                [&](size_t i) {
+                    std::ostringstream buf;
+                    FasmBackend be(*this, buf);
+                    func(be, items.at(i));
+                    results.at(i).text = buf.str();
+                    results.at(i).warnings = std::move(be.warnings);
+                });
+        for (auto &r : results) {
+            for (auto &w : r.warnings)
+                log_warning("%s", w.c_str());
+            if (!r.text.empty()) {
+                out << r.text;
+                last_was_blank = false;
+            }
+            blank();
+        }
+    }
+
+    void write_pip(PipId pip, NetInfo *net)
+    {
         auto dst_intent = ctx->wireIntent(ctx->getPipDstWire(pip));
         if (dst_intent == ID_PSEUDO_GND || dst_intent == ID_PSEUDO_VCC)
             return;
@@ -198,13 +297,11 @@ struct FasmBackend
         if (pd.flags != PIP_TILE_ROUTING)
             return;
 
-        IdString src = IdString(ctx->locInfo(pip).wire_data[pd.src_index].name);
-        IdString dst = IdString(ctx->locInfo(pip).wire_data[pd.dst_index].name);
-
-        PseudoPipKey ppk{IdString(ctx->locInfo(pip).type), dst, src};
+        auto &pp_type_index = pp_index.at(ctx->chip_info->tile_insts[pip.tile].type);
+        int32_t pp_idx = pp_type_index.empty() ? -1 : pp_type_index.at(pip.index);
 
-        if (pp_config.count(ppk)) {
-            auto &pp = pp_config.at(ppk);
+        if (pp_idx != -1) {
+            auto &pp = pp_features.at(pp_idx);
             std::string tile_name = get_tile_name(pip.tile);
             for (auto c : pp) {
                 if (boost::starts_with(tile_name, "RIOI3_SING") || boost::starts_with(tile_name, "LIOI3_SING")) {
@@ -216,16 +313,16 @@ struct FasmBackend
                             c.replace(y0pos, 2, "Y1");
                     }
                 }
-                out << tile_name << "." << c << std::endl;
+                out << tile_name << "." << c << '\n';
             }
             if (!pp.empty())
                 last_was_blank = false;
         } else {
 
             if (pd.extra_data == 1)
-                log_warning("Unprocessed route-thru %s.%s.%s\n!", get_tile_name(pip.tile).c_str(),
-                            IdString(ctx->locInfo(pip).wire_data[pd.dst_index].name).c_str(ctx),
-                            IdString(ctx->locInfo(pip).wire_data[pd.src_index].name).c_str(ctx));
+                warning(stringf("Unprocessed route-thru %s.%s.%s\n!", get_tile_name(pip.tile).c_str(),
+                                IdString(ctx->locInfo(pip).wire_data[pd.dst_index].name).c_str(ctx),
+                                IdString(ctx->locInfo(pip).wire_data[pd.src_index].name).c_str(ctx)));
 
             std::string tile_name = get_tile_name(pip.tile);
             std::string dst_name = IdString(ctx->locInfo(pip).wire_data[pd.dst_index].name).str(ctx);
@@ -266,7 +363,7 @@ struct FasmBackend
 
             out << tile_name << ".";
             out << dst_name << ".";
-            out << src_name << std::endl;
+            out << src_name << '\n';
 
             if (tile_name.find("IOI3") != std::string::npos && boost::starts_with(dst_name, "IOI_OCLK_")) {
                 dst_name.insert(dst_name.find("OCLK") + 4, 1, 'M');
@@ -277,7 +374,7 @@ struct FasmBackend
                 if (ctx->getBoundWireNet(w) == nullptr) {
                     out << tile_name << ".";
                     out << dst_name << ".";
-                    out << src_name << std::endl;
+                    out << src_name << '\n';
                 }
             }
 
@@ -315,50 +412,35 @@ struct FasmBackend
     }
 
     // Process LUT initialisation
-    std::vector<bool> get_lut_init(CellInfo *lut6, CellInfo *lut5)
+    uint64_t get_lut_init(CellInfo *lut6, CellInfo *lut5)
     {
-        std::vector<bool> bits(64, false);
-
-        std::vector<IdString> phys_inputs;
-        for (int i = 1; i <= 6; i++)
-            phys_inputs.push_back(ctx->id("A" + std::to_string(i)));
-
+        LutTable tables[2];
         for (int i = 0; i < 2; i++) {
             CellInfo *lut = (i == 1) ? lut5 : lut6;
             if (lut == nullptr)
                 continue;
             auto lut_inputs = get_inputs(lut);
-            std::unordered_map<int, std::vector<std::string>> phys_to_log;
             std::unordered_map<std::string, int> log_to_bit;
             for (int j = 0; j < int(lut_inputs.size()); j++)
                 log_to_bit[lut_inputs[j].str(ctx)] = j;
+            // Get the LUT physical to logical mapping, as the logical inputs each physical input drives
+            std::array<uint8_t, 6> phys_to_log = {{0, 0, 0, 0, 0, 0}};
             for (int j = 0; j < 6; j++) {
-                // Get the LUT physical to logical mapping
-                phys_to_log[j];
-                if (!lut->attrs.count(ctx->id("X_ORIG_PORT_" + phys_inputs[j].str(ctx))))
+                auto orig = lut->attrs.find(ctx->id("X_ORIG_PORT_A" + std::to_string(j + 1)));
+                if (orig == lut->attrs.end())
                     continue;
-                std::string orig = lut->attrs.at(ctx->id("X_ORIG_PORT_" + phys_inputs[j].str(ctx))).as_string();
-                boost::split(phys_to_log[j], orig, boost::is_any_of(" "));
-            }
-            int lbound = 0, ubound = 64;
-            // Fracturable LUTs
-            if (lut5 && lut6) {
-                lbound = (i == 1) ? 0 : 32;
-                ubound = (i == 1) ? 32 : 64;
-            }
-            Property init = get_or_default(lut->params, ctx->id("INIT"), Property()).extract(0, 64);
-            for (int j = lbound; j < ubound; j++) {
-                int log_index = 0;
-                for (int k = 0; k < 6; k++) {
-                    if ((j & (1 << k)) == 0)
-                        continue;
-                    for (auto &p2l : phys_to_log[k])
-                        log_index |= (1 << log_to_bit[p2l]);
-                }
-                bits[j] = (init.str.at(log_index) == Property::S1);
+                std::vector<std::string> log_ports;
+                boost::split(log_ports, orig->second.as_string(), boost::is_any_of(" "));
+                for (auto &p2l : log_ports)
+                    phys_to_log[j] |= (1 << log_to_bit[p2l]);
             }
+            LutTable init = LutTable::from_init(get_or_default(lut->params, ctx->id("INIT"), Property()));
+            tables[i] = init.remap(phys_to_log);
         }
-        return bits;
+        // Fracturable LUTs
+        if (lut5 && lut6)
+            return LutTable::fracture(tables[1], tables[0]).bits;
+        return (lut6 ? tables[0] : tables[1]).bits;
     };
 
     // Return the name for a half-logic-tile
@@ -402,7 +484,7 @@ struct FasmBackend
                 out << belname;
                 if (!skip_pinname)
                     out << "." << pinname;
-                out << std::endl;
+                out << '\n';
             }
         }
     }
@@ -533,7 +615,7 @@ struct FasmBackend
             if (lut6 != nullptr || lut5 != nullptr) {
                 std::string lutname = std::string("") + ("ABCD"[i]) + std::string("LUT");
                 push(lutname);
-                write_vector("INIT[63:0]", get_lut_init(lut6, lut5));
+                write_int_vector("INIT[63:0]", get_lut_init(lut6, lut5), 64);
 
                 // Write LUT mode config
                 bool is_small = false, is_ram = false, is_srl = false;
@@ -607,28 +689,34 @@ struct FasmBackend
             if (ctx->isLogicTile(cell.second->bel))
                 used_logic_tiles.insert(cell.second->bel.tile);
         }
-        for (int tile : used_logic_tiles) {
-            write_luts_config(tile, 0);
-            write_luts_config(tile, 1);
-            write_ffs_config(tile, 0);
-            write_ffs_config(tile, 1);
-            write_carry_config(tile, 0);
-            write_carry_config(tile, 1);
-            blank();
-        }
+        write_parallel(std::vector<int>(used_logic_tiles.begin(), used_logic_tiles.end()),
+                       [](FasmBackend &be, int tile) {
+                           be.write_luts_config(tile, 0);
+                           be.write_luts_config(tile, 1);
+                           be.write_ffs_config(tile, 0);
+                           be.write_ffs_config(tile, 1);
+                           be.write_carry_config(tile, 0);
+                           be.write_carry_config(tile, 1);
+                       });
     }
 
     void write_routing()
     {
         get_pseudo_pip_data();
+        std::vector<NetInfo *> nets;
         for (auto net : sorted(ctx->nets)) {
             NetInfo *ni = net.second;
+            for (auto &w : ni->wires)
+                if (w.second.pip != PipId())
+                    pips_by_tile[w.second.pip.tile].push_back(w.second.pip);
+            nets.push_back(ni);
+        }
+        write_parallel(nets, [](FasmBackend &be, NetInfo *ni) {
             for (auto &w : ni->wires) {
                 if (w.second.pip != PipId())
-                    write_pip(w.second.pip, ni);
+                    be.write_pip(w.second.pip, ni);
             }
-            blank();
-        }
+        });
     }
 
     struct BankIoConfig
@@ -833,7 +921,7 @@ struct FasmBackend
         std::vector<std::string> wires;
         if (!pips_by_tile.count(tile))
             return wires;
-        for (auto pip : pips_by_tile[tile]) {
+        for (auto pip : pips_by_tile.at(tile)) {
             auto &pd = ctx->locInfo(pip).pip_data[pip.index];
             int wire_index = is_source ? pd.src_index : pd.dst_index;
             std::string wire = IdString(ctx->locInfo(pip).wire_data[wire_index].name).str(ctx);
@@ -973,11 +1061,8 @@ struct FasmBackend
                         if (ci->params.count(param)) {
                             auto &init0 = ci->params.at(param);
                             has_init = true;
-                            for (int k = half; k < 256; k += 2) {
-                                if (k >= int(init0.str.size()))
-                                    break;
-                                init_data[j * 128 + (k / 2)] = init0.str[k] == Property::S1;
-                            }
+                            for (int k = half; k < std::min(256, init0.width); k += 2)
+                                init_data[j * 128 + (k / 2)] = (init0.word(k / 64) >> (k % 64)) & 1;
                         }
                     }
                 } else {
@@ -985,11 +1070,8 @@ struct FasmBackend
                     if (ci->params.count(param)) {
                         auto &init = ci->params.at(param);
                         has_init = true;
-                        for (int k = 0; k < 256; k++) {
-                            if (k >= int(init.str.size()))
-                                break;
-                            init_data[k] = init.str[k] == Property::S1;
-                        }
+                        for (int k = 0; k < std::min(256, init.width); k++)
+                            init_data[k] = (init.word(k / 64) >> (k % 64)) & 1;
                     }
                 }
                 if (has_init)
@@ -1011,9 +1093,11 @@ struct FasmBackend
             write_bram_width(ci, "WRITE_WIDTH_B", is_36, half == 1);
             write_bit("DOA_REG", bool_or_default(ci->params, ctx->id("DOA_REG"), false));
             write_bit("DOB_REG", bool_or_default(ci->params, ctx->id("DOB_REG"), false));
-            for (auto &invpin : invertible_pins[ctx->id(ci->attrs[ctx->id("X_ORIG_TYPE")].as_string())])
-                write_bit("ZINV_" + invpin.str(ctx),
-                          !bool_or_default(ci->params, ctx->id("IS_" + invpin.str(ctx) + "_INVERTED"), false));
+            auto invpins = invertible_pins.find(ctx->id(str_or_default(ci->attrs, ctx->id("X_ORIG_TYPE"), "")));
+            if (invpins != invertible_pins.end())
+                for (auto &invpin : invpins->second)
+                    write_bit("ZINV_" + invpin.str(ctx),
+                              !bool_or_default(ci->params, ctx->id("IS_" + invpin.str(ctx) + "_INVERTED"), false));
             for (auto wrmode : {"WRITE_MODE_A", "WRITE_MODE_B"}) {
                 std::string mode = str_or_default(ci->params, ctx->id(wrmode), "WRITE_FIRST");
                 if (mode != "WRITE_FIRST")
@@ -1039,26 +1123,27 @@ struct FasmBackend
     void write_bram()
     {
         auto tt = ctx->getTilesAndTypes();
-        std::string name, type;
+        std::vector<int> bram_tiles;
         for (int tile = 0; tile < int(tt.size()); tile++) {
-            std::tie(name, type) = tt.at(tile);
-            if (type == "BRAM_L" || type == "BRAM_R") {
-                CellInfo *l = nullptr, *u = nullptr;
-                auto bts = ctx->tileStatus[tile].bts;
-                if (bts != nullptr) {
-                    if (bts->cells[BEL_RAM36] != nullptr) {
-                        l = bts->cells[BEL_RAM36];
-                        u = bts->cells[BEL_RAM36];
-                    } else {
-                        l = bts->cells[BEL_RAM18_L];
-                        u = bts->cells[BEL_RAM18_U];
-                    }
+            const std::string &type = tt.at(tile).second;
+            if (type == "BRAM_L" || type == "BRAM_R")
+                bram_tiles.push_back(tile);
+        }
+        write_parallel(bram_tiles, [](FasmBackend &be, int tile) {
+            CellInfo *l = nullptr, *u = nullptr;
+            auto bts = be.ctx->tileStatus[tile].bts;
+            if (bts != nullptr) {
+                if (bts->cells[BEL_RAM36] != nullptr) {
+                    l = bts->cells[BEL_RAM36];
+                    u = bts->cells[BEL_RAM36];
+                } else {
+                    l = bts->cells[BEL_RAM18_L];
+                    u = bts->cells[BEL_RAM18_U];
                 }
-                write_bram_half(tile, 0, l);
-                write_bram_half(tile, 1, u);
-                blank();
             }
-        }
+            be.write_bram_half(tile, 0, l);
+            be.write_bram_half(tile, 1, u);
+        });
     }
 
     double float_or_default(CellInfo *ci, const std::string &name, double def)
@@ -1224,4 +1309,159 @@ void Arch::writeFasm(const std::string &filename)
     be.write_fasm();
 }
 
+namespace {
+// Split FASM text into the features of each tile, as the lines starting with its name, with the tiles in order of
+// their first feature. Blank lines and comments are dropped.
+void split_fasm_tiles(std::istream &in, std::vector<std::string> &tile_order,
+                      std::unordered_map<std::string, std::vector<std::string>> &tile_features)
+{
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line.front() == '#')
+            continue;
+        size_t dot = line.find('.');
+        NPNR_ASSERT(dot != std::string::npos);
+        std::string tile = line.substr(0, dot);
+        auto ins = tile_features.emplace(tile, std::vector<std::string>());
+        if (ins.second)
+            tile_order.push_back(tile);
+        ins.first->second.push_back(line);
+    }
+}
+} // namespace
+
+// FASM patch against the FASM of an earlier run, for partial bitstream tools. Only the tiles whose features differ
+// are written, each as a "# tile <name>" comment followed by the complete new features of the tile, so a tool
+// clears the tile and sets them. Tiles no longer used have the comment alone. The patch is valid FASM on its own.
+void Arch::writeFasmPatch(const std::string &filename, const std::string &previous)
+{
+    std::ifstream prev_in(previous);
+    if (!prev_in)
+        log_error("failed to open file %s for reading (%s)\n", previous.c_str(), strerror(errno));
+    std::vector<std::string> prev_order, curr_order;
+    std::unordered_map<std::string, std::vector<std::string>> prev_features, curr_features;
+    split_fasm_tiles(prev_in, prev_order, prev_features);
+
+    std::ostringstream text;
+    FasmBackend be(getCtx(), text);
+    be.write_fasm();
+    std::istringstream curr_in(text.str());
+    split_fasm_tiles(curr_in, curr_order, curr_features);
+
+    // Features within a tile are compared as sets, as the order they are written in may change between runs
+    auto same_features = [](std::vector<std::string> a, std::vector<std::string> b) {
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        return a == b;
+    };
+
+    std::ofstream out(filename);
+    if (!out)
+        log_error("failed to open file %s for writing (%s)\n", filename.c_str(), strerror(errno));
+    int changed = 0, removed = 0;
+    for (auto &tile : curr_order) {
+        auto &features = curr_features.at(tile);
+        auto fnd = prev_features.find(tile);
+        if (fnd != prev_features.end() && same_features(fnd->second, features))
+            continue;
+        out << "# tile " << tile << '\n';
+        for (auto &f : features)
+            out << f << '\n';
+        out << '\n';
+        ++changed;
+    }
+    for (auto &tile : prev_order) {
+        if (curr_features.count(tile))
+            continue;
+        out << "# tile " << tile << "\n\n";
+        ++removed;
+    }
+    log_info("Wrote FASM patch for %d changed and %d cleared tiles, of %d in use.\n", changed, removed,
+             int(curr_order.size()));
+}
+
+namespace {
+void write_u32(std::ostream &out, uint32_t x)
+{
+    char b[4] = {char(x & 0xFF), char((x >> 8) & 0xFF), char((x >> 16) & 0xFF), char((x >> 24) & 0xFF)};
+    out.write(b, 4);
+}
+} // namespace
+
+// Binary FASM, so the bitstream step can read features without parsing text. All integers are little endian u32.
+//   "NPFASMB1"
+//   string count, then for each string: length, bytes (tile names and features, each stored once)
+//   feature count, then for each feature: tile string, feature string, value width, value
+// A width of 0 is a single set bit with no value bytes; otherwise the value is (width + 7) / 8 bytes, with bit i
+// of the vector in bit (i % 8) of byte (i / 8). Features are in the same order as in the text output.
+void Arch::writeFasmBinary(const std::string &filename)
+{
+    std::ostringstream text;
+    FasmBackend be(getCtx(), text);
+    be.write_fasm();
+
+    std::unordered_map<std::string, uint32_t> string_idx;
+    std::vector<const std::string *> strings;
+    auto get_string = [&](const std::string &str) {
+        auto ins = string_idx.emplace(str, uint32_t(strings.size()));
+        if (ins.second)
+            strings.push_back(&ins.first->first);
+        return ins.first->second;
+    };
+    struct Feature
+    {
+        uint32_t tile, feature, width;
+        std::vector<uint8_t> value;
+    };
+    std::vector<Feature> features;
+
+    std::istringstream in(text.str());
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        Feature f;
+        std::string name = line;
+        f.width = 0;
+        size_t eq = line.find(" = ");
+        if (eq != std::string::npos) {
+            name = line.substr(0, eq);
+            std::string val = line.substr(eq + 3);
+            size_t b = val.find("'b");
+            NPNR_ASSERT(b != std::string::npos);
+            f.width = std::stoi(val.substr(0, b));
+            std::string bits = val.substr(b + 2);
+            NPNR_ASSERT(int(bits.size()) == int(f.width));
+            f.value.resize((f.width + 7) / 8);
+            for (uint32_t i = 0; i < f.width; i++)
+                if (bits.at(f.width - 1 - i) == '1')
+                    f.value[i / 8] |= (1 << (i % 8));
+        }
+        size_t dot = name.find('.');
+        NPNR_ASSERT(dot != std::string::npos);
+        f.tile = get_string(name.substr(0, dot));
+        f.feature = get_string(name.substr(dot + 1));
+        features.push_back(std::move(f));
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out)
+        log_error("failed to open file %s for writing (%s)\n", filename.c_str(), strerror(errno));
+    out.write("NPFASMB1", 8);
+    write_u32(out, strings.size());
+    for (auto str : strings) {
+        write_u32(out, str->size());
+        out.write(str->data(), str->size());
+    }
+    write_u32(out, features.size());
+    for (auto &f : features) {
+        write_u32(out, f.tile);
+        write_u32(out, f.feature);
+        write_u32(out, f.width);
+        if (!f.value.empty())
+            out.write(reinterpret_cast<const char *>(f.value.data()), f.value.size());
+    }
+    log_info("Wrote %d FASM features (%d distinct names).\n", int(features.size()), int(strings.size()));
+}
+
 NEXTPNR_NAMESPACE_END
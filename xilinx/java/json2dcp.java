@@ -9,13 +9,18 @@ import com.xilinx.rapidwright.edif.*;
 import com.xilinx.rapidwright.util.RapidWright;
 import org.python.antlr.ast.Str;
 
+import java.io.BufferedReader;
+import java.io.FileInputStream;
 import java.io.FileNotFoundException;
 import java.io.FileReader;
+import java.io.IOException;
+import java.io.InputStreamReader;
 import java.math.BigInteger;
 import java.util.ArrayList;
 import java.util.HashMap;
 import java.util.HashSet;
 import java.util.Map;
+import java.util.zip.GZIPInputStream;
 
 public class json2dcp {
 
@@ -271,14 +276,44 @@ public class json2dcp {
         return c;
    }
 
+    // Read the routing of each net from a physical netlist written by nextpnr with --phys-netlist, in the same
+    // wire;pip;strength form as the ROUTING attribute
+    public static HashMap<String, String> readPhysRouting(String filename) {
+        HashMap<String, String> routing = new HashMap<>();
+        try (BufferedReader r = new BufferedReader(new InputStreamReader(new GZIPInputStream(new FileInputStream(filename))))) {
+            String line;
+            String net = null;
+            StringBuilder sb = new StringBuilder();
+            while ((line = r.readLine()) != null) {
+                if (line.startsWith("net ")) {
+                    if (net != null)
+                        routing.put(net, sb.toString());
+                    net = line.substring(line.indexOf(' ', 4) + 1);
+                    sb.setLength(0);
+                } else if (net != null && !line.isEmpty() && Character.isDigit(line.charAt(0))) {
+                    String[] sp = line.split(" ");
+                    sb.append(sp[1]).append(';').append(sp[2].equals("-") ? "" : sp[2]).append(';').append(sp[3]).append(';');
+                }
+            }
+            if (net != null)
+                routing.put(net, sb.toString());
+        } catch (IOException e) {
+            throw new RuntimeException(e);
+        }
+        return routing;
+    }
+
     public static void main(String[] args) throws FileNotFoundException {
 
         if (args.length < 3) {
-            System.err.println("Usage: json2dcp <device> <design.json> <design.dcp>");
+            System.err.println("Usage: json2dcp <device> <design.json> <design.dcp> [design.phys.gz]");
             System.err.println("   e.g json2dcp xczu2cg-sbva484-1-e top_routed.json top_routed.dcp");
+            System.err.println("   the routing is read from the physical netlist if given, rather than from the JSON");
             System.exit(1);
         }
 
+        HashMap<String, String> physRouting = (args.length > 3) ? readPhysRouting(args[3]) : null;
+
         NextpnrDesign ndes = new NextpnrDesign();
         ndes.Import(new JsonParser().parse(new FileReader(args[1])).getAsJsonObject());
 
@@ -457,7 +492,7 @@ public class json2dcp {
                 }
             }
 
-            String[] routing = nn.attrs.get("ROUTING").split(";");
+            String[] routing = (physRouting != null ? physRouting.getOrDefault(nn.name, "") : nn.attrs.get("ROUTING")).split(";");
             for (int i = 0; i < (routing.length-2); i+=3) {
                 String wire = routing[i];
                 String pip = routing[i+1];
@@ -24,6 +24,7 @@
 #include "design_utils.h"
 #include "jsonwrite.h"
 #include "log.h"
+#include "perf_report.h"
 #include "timing.h"
 
 USING_NEXTPNR_NAMESPACE
@@ -39,6 +40,7 @@ class UspCommandHandler : public CommandHandler
     void customAfterLoad(Context *ctx) override;
 
   protected:
+    bool canReuseContext(const Context *ctx) override;
     po::options_description getArchOptions() override;
 };
 
@@ -50,6 +52,24 @@ po::options_description UspCommandHandler::getArchOptions()
     specific.add_options()("chipdb", po::value<std::string>(), "name of chip database binary");
     specific.add_options()("xdc", po::value<std::vector<std::string>>(), "XDC-style constraints file");
     specific.add_options()("fasm", po::value<std::string>(), "fasm bitstream file to write");
+    specific.add_options()("fasm-patch", po::value<std::string>(),
+                           "FASM patch file to write, with only the tiles that differ from --fasm-previous");
+    specific.add_options()("fasm-previous", po::value<std::string>(),
+                           "FASM file of an earlier run, that --fasm-patch is written against");
+    specific.add_options()("fasm-binary", po::value<std::string>(),
+                           "fasm features file to write, in a compact binary encoding");
+    specific.add_options()("phys-netlist", po::value<std::string>(),
+                           "gzip compressed placement and routing to write, for loading with json2dcp");
+    specific.add_options()("pip-cache", "build a flat pip adjacency cache before routing (faster, uses more memory)");
+    specific.add_options()("cluster-slices", "group connected LUTs and FFs into half-slice clusters before placement");
+    specific.add_options()("delay-model", "predict placement delays with a model fitted to routes on the empty device, "
+                                          "kept in the chipdb cache if there is one");
+    specific.add_options()("chipdb-cache", po::value<std::string>()->implicit_value(""),
+                           "cache tables derived from the chipdb in this file, by default <chipdb>.cache, so that "
+                           "later runs against the same chipdb start faster");
+    specific.add_options()("chipdb-load", po::value<std::string>(),
+                           "how to load the chipdb: mmap (default), prefetch (mmap and read ahead in the background), "
+                           "populate (read it all in up front) or hugepage (copy into huge page backed memory)");
 
     return specific;
 }
@@ -58,8 +78,26 @@ void UspCommandHandler::customBitstream(Context *ctx)
 {
     if (vm.count("fasm")) {
         std::string filename = vm["fasm"].as<std::string>();
+        PerfScope scope("fasm");
         ctx->writeFasm(filename);
     }
+    if (vm.count("fasm-binary")) {
+        std::string filename = vm["fasm-binary"].as<std::string>();
+        PerfScope scope("fasm binary");
+        ctx->writeFasmBinary(filename);
+    }
+    if (vm.count("fasm-patch")) {
+        if (!vm.count("fasm-previous"))
+            log_error("--fasm-patch requires --fasm-previous\n");
+        std::string filename = vm["fasm-patch"].as<std::string>();
+        PerfScope scope("fasm patch");
+        ctx->writeFasmPatch(filename, vm["fasm-previous"].as<std::string>());
+    }
+    if (vm.count("phys-netlist")) {
+        std::string filename = vm["phys-netlist"].as<std::string>();
+        PerfScope scope("physical netlist");
+        ctx->writePhysNetlist(filename);
+    }
 }
 
 std::unique_ptr<Context> UspCommandHandler::createContext(std::unordered_map<std::string, Property> &values)
@@ -69,11 +107,33 @@ std::unique_ptr<Context> UspCommandHandler::createContext(std::unordered_map<std
         log_error("chip database binary must be provided\n");
     }
     chipArgs.chipdb = vm["chipdb"].as<std::string>();
+    if (vm.count("chipdb-cache")) {
+        chipArgs.chipdb_cache = vm["chipdb-cache"].as<std::string>();
+        if (chipArgs.chipdb_cache.empty())
+            chipArgs.chipdb_cache = chipArgs.chipdb + ".cache";
+    }
+    if (vm.count("chipdb-load")) {
+        std::string mode = vm["chipdb-load"].as<std::string>();
+        if (!parse_chipdb_load_mode(mode, chipArgs.chipdb_load))
+            log_error("unknown chipdb load mode '%s'\n", mode.c_str());
+    }
     return std::unique_ptr<Context>(new Context(chipArgs));
 }
 
+bool UspCommandHandler::canReuseContext(const Context *ctx)
+{
+    // The load mode and derived table cache only matter while loading, so any context for the same chipdb will do
+    return !vm.count("chipdb") || vm["chipdb"].as<std::string>() == ctx->args.chipdb;
+}
+
 void UspCommandHandler::customAfterLoad(Context *ctx)
 {
+    if (vm.count("pip-cache"))
+        ctx->settings[ctx->id("xilinx/pipCache")] = true;
+    if (vm.count("cluster-slices"))
+        ctx->settings[ctx->id("xilinx/clusterSlices")] = true;
+    if (vm.count("delay-model"))
+        ctx->settings[ctx->id("xilinx/delayModel")] = true;
     if (vm.count("xdc")) {
         std::vector<std::string> files = vm["xdc"].as<std::vector<std::string>>();
         for (const auto &filename : files) {
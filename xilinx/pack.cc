@@ -20,6 +20,7 @@
 #include "pack.h"
 #include <algorithm>
 #include <boost/optional.hpp>
+#include <functional>
 #include <iterator>
 #include <queue>
 #include <unordered_set>
@@ -28,7 +29,9 @@
 #include "design_utils.h"
 #include "log.h"
 #include "nextpnr.h"
+#include "perf_report.h"
 #include "pins.h"
+#include "thread_pool.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -43,17 +46,65 @@ void XilinxPacker::flush_cells()
     }
     for (auto &ncell : new_cells) {
         NPNR_ASSERT(!ctx->cells.count(ncell->name));
+        index_cell(ncell.get());
         ctx->cells[ncell->name] = std::move(ncell);
     }
     packed_cells.clear();
     new_cells.clear();
 }
 
+void XilinxPacker::index_cell(const CellInfo *ci)
+{
+    if (cells_by_type_valid)
+        cells_by_type[ci->type].push_back(ci->name);
+}
+
+void XilinxPacker::set_cell_type(CellInfo *ci, IdString type)
+{
+    ci->type = type;
+    index_cell(ci);
+}
+
+std::vector<CellInfo *> XilinxPacker::cells_of_types(const std::vector<IdString> &types)
+{
+    if (!cells_by_type_valid) {
+        cells_by_type.clear();
+        for (auto &cell : ctx->cells)
+            cells_by_type[cell.second->type].push_back(cell.first);
+        cells_by_type_valid = true;
+    }
+    std::vector<std::pair<int, CellInfo *>> found;
+    for (auto type : types) {
+        auto fnd = cells_by_type.find(type);
+        if (fnd == cells_by_type.end())
+            continue;
+        // Drop the entries of cells that have since been removed or changed type
+        auto &names = fnd->second;
+        size_t kept = 0;
+        for (auto name : names) {
+            auto cell = ctx->cells.find(name);
+            if (cell == ctx->cells.end() || cell->second->type != type)
+                continue;
+            names[kept++] = name;
+            found.emplace_back(cell.index(), cell->second.get());
+        }
+        names.resize(kept);
+    }
+    // A cell can be listed more than once if it went back to a type it had before
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    std::vector<CellInfo *> result;
+    result.reserve(found.size());
+    for (auto &entry : found)
+        result.push_back(entry.second);
+    return result;
+}
+
 void XilinxPacker::xform_cell(const std::unordered_map<IdString, XFormRule> &rules, CellInfo *ci)
 {
     auto &rule = rules.at(ci->type);
     ci->attrs[ctx->id("X_ORIG_TYPE")] = ci->type.str(ctx);
-    ci->type = rule.new_type;
+    set_cell_type(ci, rule.new_type);
     std::vector<IdString> orig_port_names;
     for (auto &port : ci->ports)
         orig_port_names.push_back(port.first);
@@ -101,18 +152,141 @@ void XilinxPacker::xform_cell(const std::unordered_map<IdString, XFormRule> &rul
         ci->params[param.first] = param.second;
 }
 
+void XilinxPacker::run_parallel(size_t count, const std::function<void(size_t)> &func)
+{
+    ctx->threadPool().parallel_for(count, 256, func, ctx->debug ? 1 : 0);
+}
+
 void XilinxPacker::generic_xform(const std::unordered_map<IdString, XFormRule> &rules, bool print_summary)
 {
     std::map<std::string, int> cell_count;
     std::map<std::string, int> new_types;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
-        if (rules.count(ci->type)) {
-            cell_count[ci->type.str(ctx)]++;
-            xform_cell(rules, ci);
-            new_types[ci->type.str(ctx)]++;
+    std::vector<CellInfo *> cells = cells_of_types(rules);
+
+    // Intern the new port names, and the attributes recording the original ones, up front: once per cell type and
+    // port rather than per cell, and in netlist order, so that the new IdStrings are numbered the same whatever the
+    // thread count. Split ports are left to xform_cell
+    std::unordered_map<IdString, std::unordered_map<IdString, IdString>> new_port_names;
+    std::unordered_map<IdString, IdString> orig_port_attrs;
+    IdString id_X_ORIG_TYPE = ctx->id("X_ORIG_TYPE");
+    for (auto ci : cells) {
+        auto &rule = rules.at(ci->type);
+        auto &names = new_port_names[ci->type];
+        for (auto &port : ci->ports) {
+            if (names.count(port.first) || rule.port_multixform.count(port.first))
+                continue;
+            IdString new_name;
+            if (rule.port_xform.count(port.first)) {
+                new_name = rule.port_xform.at(port.first);
+            } else {
+                std::string stripped_name;
+                for (auto c : port.first.str(ctx))
+                    if (c != '[' && c != ']')
+                        stripped_name += c;
+                new_name = ctx->id(stripped_name);
+            }
+            names[port.first] = new_name;
+            if (!orig_port_attrs.count(new_name))
+                orig_port_attrs[new_name] = ctx->id("X_ORIG_PORT_" + new_name.str(ctx));
         }
     }
+
+    // Rewrite each cell on its own; only the port names on the cell side change here. Cells where a port is split,
+    // or where the new port names collide with each other or with existing ports, depend on the order the ports are
+    // processed in and are transformed serially by xform_cell afterwards instead
+    struct PortRename
+    {
+        NetInfo *net;
+        IdString old_name, new_name;
+    };
+    struct CellResult
+    {
+        bool serial = false;
+        std::vector<PortRename> renamed;
+    };
+    std::vector<CellResult> results(cells.size());
+    run_parallel(cells.size(), [&](size_t i) {
+        CellInfo *ci = cells.at(i);
+        CellResult &res = results.at(i);
+        auto &rule = rules.at(ci->type);
+        auto &names = new_port_names.at(ci->type);
+        decltype(ci->ports) new_ports;
+        for (auto &port : ci->ports) {
+            if (rule.port_multixform.count(port.first)) {
+                res.serial = true;
+                return;
+            }
+            IdString new_name = names.at(port.first);
+            if (new_ports.count(new_name) || (new_name != port.first && ci->ports.count(new_name))) {
+                res.serial = true;
+                return;
+            }
+            PortInfo &pi = new_ports[new_name];
+            pi = port.second;
+            pi.name = new_name;
+            if (new_name != port.first && pi.net != nullptr)
+                res.renamed.push_back(PortRename{pi.net, port.first, new_name});
+        }
+        ci->attrs[id_X_ORIG_TYPE] = ci->type.str(ctx);
+        for (auto &port : ci->ports)
+            ci->attrs[orig_port_attrs.at(names.at(port.first))] = port.first.str(ctx);
+        ci->ports.swap(new_ports);
+
+        std::vector<IdString> xform_params;
+        for (auto &param : ci->params)
+            if (rule.param_xform.count(param.first))
+                xform_params.push_back(param.first);
+        for (auto param : xform_params)
+            ci->params[rule.param_xform.at(param)] = ci->params[param];
+        for (auto &attr : rule.set_attrs)
+            ci->attrs[attr.first] = attr.second;
+        for (auto &param : rule.set_params)
+            ci->params[param.first] = param.second;
+    });
+
+    // Then update the net side, once per net rather than once per renamed port, which also runs in parallel as
+    // each net is only touched by one thread
+    std::vector<NetInfo *> touched_nets;
+    std::unordered_map<NetInfo *, std::unordered_map<const CellInfo *, std::vector<std::pair<IdString, IdString>>>>
+            net_renames;
+    for (size_t i = 0; i < cells.size(); i++) {
+        for (auto &rn : results.at(i).renamed) {
+            auto &renames = net_renames[rn.net];
+            if (renames.empty())
+                touched_nets.push_back(rn.net);
+            renames[cells.at(i)].emplace_back(rn.old_name, rn.new_name);
+        }
+    }
+    run_parallel(touched_nets.size(), [&](size_t i) {
+        NetInfo *ni = touched_nets.at(i);
+        auto &renames = net_renames.at(ni);
+        auto update = [&](PortRef &ref) {
+            auto fnd = renames.find(ref.cell);
+            if (fnd == renames.end())
+                return;
+            for (auto &rn : fnd->second) {
+                if (rn.first == ref.port) {
+                    ref.port = rn.second;
+                    return;
+                }
+            }
+        };
+        if (ni->driver.cell != nullptr)
+            update(ni->driver);
+        for (auto &usr : ni->users)
+            update(usr);
+    });
+
+    for (size_t i = 0; i < cells.size(); i++) {
+        CellInfo *ci = cells.at(i);
+        cell_count[ci->type.str(ctx)]++;
+        if (results.at(i).serial)
+            xform_cell(rules, ci);
+        else
+            set_cell_type(ci, rules.at(ci->type).new_type);
+        new_types[ci->type.str(ctx)]++;
+    }
+
     if (print_summary) {
         for (auto &nt : new_types) {
             log_info("    Created %d %s cells from:\n", nt.second, nt.first.c_str());
@@ -165,17 +339,24 @@ std::unique_ptr<CellInfo> XilinxPacker::feed_through_muxf(NetInfo *net, IdString
 
 IdString XilinxPacker::int_name(IdString base, const std::string &postfix, bool is_hierarchy)
 {
-    return ctx->id(base.str(ctx) + (is_hierarchy ? "$subcell$" : "$intcell$") + postfix);
+    // Built in a buffer kept between calls, as the packer creates one of these names for most cells it inserts
+    name_buf.assign(base.c_str(ctx));
+    name_buf += is_hierarchy ? "$subcell$" : "$intcell$";
+    name_buf += postfix;
+    return ctx->id(name_buf);
 }
 
 NetInfo *XilinxPacker::create_internal_net(IdString base, const std::string &postfix, bool is_hierarchy)
 {
+    name_buf.assign(base.c_str(ctx));
+    name_buf += is_hierarchy ? "$subnet$" : "$intnet$";
+    name_buf += postfix;
+    IdString name = ctx->id(name_buf);
     std::unique_ptr<NetInfo> net{new NetInfo};
-    IdString name = ctx->id(base.str(ctx) + (is_hierarchy ? "$subnet$" : "$intnet$") + postfix);
     net->name = name;
-    NPNR_ASSERT(!ctx->nets.count(name));
-    ctx->nets[name] = std::move(net);
-    return ctx->nets.at(name).get();
+    auto ins = ctx->nets.emplace(name, std::move(net));
+    NPNR_ASSERT(ins.second);
+    return ins.first->second.get();
 }
 
 void XilinxPacker::pack_luts()
@@ -239,8 +420,7 @@ void XilinxPacker::pack_ffs()
 void XilinxPacker::pack_lutffs()
 {
     int pairs = 0;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({id_SLICE_FFX})) {
         if (ci->constr_parent != nullptr || !ci->constr_children.empty())
             continue;
         if (ci->type != id_SLICE_FFX)
@@ -261,6 +441,135 @@ void XilinxPacker::pack_lutffs()
     log_info("Constrained %d LUTFF pairs.\n", pairs);
 }
 
+void XC7Packer::cluster_slices()
+{
+    if (!bool_or_default(ctx->settings, ctx->id("xilinx/clusterSlices"), false))
+        return;
+    // Needed for LUT modes and interned FF control sets
+    ctx->assignArchInfo();
+
+    // A unit is a free LUT in the 6LUT position, optionally with the FF it drives as created by pack_lutffs
+    struct SliceUnit
+    {
+        CellInfo *lut, *ff;
+        int cluster;
+    };
+    std::vector<SliceUnit> units;
+    std::unordered_map<IdString, int> cell2unit;
+    for (auto ci : cells_of_types({id_SLICE_LUTX})) {
+        if (ci->constr_parent != nullptr || is_constrained(ci) || ci->constr_children.size() > 1)
+            continue;
+        if (ci->lutInfo.is_memory || ci->lutInfo.is_srl)
+            continue;
+        CellInfo *ff = nullptr;
+        if (!ci->constr_children.empty()) {
+            ff = ci->constr_children.front();
+            if (ff->type != id_SLICE_FFX || ff->constr_z != (BEL_FF - BEL_6LUT) || !ff->constr_children.empty())
+                continue;
+        }
+        // LUTs only driving a carry take the extra only_drives_carry placement route once constrained
+        NetInfo *o6 = get_net_or_empty(ci, id_O6);
+        if (o6 != nullptr && o6->users.size() == 1 && o6->users.at(0).cell->type == id_CARRY4)
+            continue;
+        cell2unit[ci->name] = int(units.size());
+        if (ff != nullptr)
+            cell2unit[ff->name] = int(units.size());
+        units.push_back(SliceUnit{ci, ff, -1});
+    }
+
+    // Nets with a higher fanout than this say little about which cells belong together
+    const int max_fanout = 16;
+    const int cluster_size = 4;
+    std::vector<float> score(units.size(), 0);
+    std::vector<int> touched;
+    // Add the affinity of every unit connected to cell; arcs driven by or driving cell weigh double, as they are the
+    // ones that become a timing path between cluster members
+    auto add_affinity = [&](CellInfo *cell) {
+        for (auto &port : cell->ports) {
+            NetInfo *ni = port.second.net;
+            if (ni == nullptr || ni->users.empty() || int(ni->users.size()) > max_fanout)
+                continue;
+            // Control nets are shared by the whole half-slice anyway
+            if (cell->type == id_SLICE_FFX && port.first != id_D && port.first != id_Q)
+                continue;
+            float w = 1.0f / ni->users.size();
+            auto visit = [&](CellInfo *other, bool direct) {
+                if (other == nullptr || other == cell)
+                    return;
+                auto fnd = cell2unit.find(other->name);
+                if (fnd == cell2unit.end() || units.at(fnd->second).cluster != -1)
+                    return;
+                if (score.at(fnd->second) == 0)
+                    touched.push_back(fnd->second);
+                score.at(fnd->second) += direct ? 2 * w : w;
+            };
+            bool is_driver = ni->driver.cell == cell;
+            visit(ni->driver.cell, true);
+            for (auto &usr : ni->users)
+                visit(usr.cell, is_driver);
+        }
+    };
+
+    int clusters = 0, clustered_luts = 0;
+    for (int seed = 0; seed < int(units.size()); seed++) {
+        if (units.at(seed).cluster != -1)
+            continue;
+        std::vector<int> members{seed};
+        units.at(seed).cluster = seed;
+        int ctrl_set = units.at(seed).ff ? units.at(seed).ff->ffInfo.ctrl_set : -1;
+        while (int(members.size()) < cluster_size) {
+            for (int t : touched)
+                score.at(t) = 0;
+            touched.clear();
+            for (int m : members) {
+                add_affinity(units.at(m).lut);
+                if (units.at(m).ff != nullptr)
+                    add_affinity(units.at(m).ff);
+            }
+            int best = -1;
+            for (int t : touched) {
+                const SliceUnit &cand = units.at(t);
+                // All FFs in a half-slice must share a control set
+                if (cand.ff != nullptr && ctrl_set != -1 && cand.ff->ffInfo.ctrl_set != ctrl_set)
+                    continue;
+                if (best == -1 || score.at(t) > score.at(best) || (score.at(t) == score.at(best) && t < best))
+                    best = t;
+            }
+            if (best == -1)
+                break;
+            units.at(best).cluster = seed;
+            if (units.at(best).ff != nullptr)
+                ctrl_set = units.at(best).ff->ffInfo.ctrl_set;
+            members.push_back(best);
+        }
+        for (int t : touched)
+            score.at(t) = 0;
+        touched.clear();
+        if (members.size() == 1)
+            continue;
+
+        // Constrain all cells directly to the seed LUT, one eight per member
+        CellInfo *root = units.at(seed).lut;
+        for (int k = 1; k < int(members.size()); k++) {
+            SliceUnit &u = units.at(members.at(k));
+            u.lut->constr_children.clear();
+            u.lut->constr_parent = root;
+            u.lut->constr_x = 0;
+            u.lut->constr_y = 0;
+            u.lut->constr_z = (k << 4);
+            root->constr_children.push_back(u.lut);
+            if (u.ff != nullptr) {
+                u.ff->constr_parent = root;
+                u.ff->constr_z = (k << 4) + (BEL_FF - BEL_6LUT);
+                root->constr_children.push_back(u.ff);
+            }
+        }
+        ++clusters;
+        clustered_luts += int(members.size());
+    }
+    log_info("Formed %d slice clusters from %d LUTs.\n", clusters, clustered_luts);
+}
+
 bool XilinxPacker::is_constrained(const CellInfo *cell)
 {
     return cell->constr_x != cell->UNCONSTR || cell->constr_y != cell->UNCONSTR || cell->constr_z != cell->UNCONSTR;
@@ -417,8 +726,7 @@ void XilinxPacker::pack_srls()
     // FIXME: Q31 support
     generic_xform(srl_rules, true);
     // Fixup SRL inputs
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({id_SLICE_LUTX})) {
         if (ci->type != id_SLICE_LUTX)
             continue;
         std::string orig_type = str_or_default(ci->attrs, ctx->id("X_ORIG_TYPE"));
@@ -474,8 +782,10 @@ void XilinxPacker::pack_constants()
         vcc_net->driver.port = id_Y;
         vcc_cell->ports.at(id_Y).net = vcc_net.get();
 
+        index_cell(gnd_cell.get());
         ctx->cells[gnd_cell->name] = std::move(gnd_cell);
         ctx->nets[gnd_net->name] = std::move(gnd_net);
+        index_cell(vcc_cell.get());
         ctx->cells[vcc_cell->name] = std::move(vcc_cell);
         ctx->nets[vcc_net->name] = std::move(vcc_net);
     }
@@ -485,14 +795,13 @@ void XilinxPacker::pack_constants()
 
     std::vector<std::tuple<CellInfo *, IdString, bool>> const_ports;
 
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types(tied_pins)) {
         if (!tied_pins.count(ci->type))
             continue;
         auto &tp = tied_pins.at(ci->type);
         for (auto port : tp) {
-            if (cell.second->ports.count(port.first) && cell.second->ports.at(port.first).net != nullptr &&
-                cell.second->ports.at(port.first).net->driver.cell != nullptr)
+            if (ci->ports.count(port.first) && ci->ports.at(port.first).net != nullptr &&
+                ci->ports.at(port.first).net->driver.cell != nullptr)
                 continue;
             const_ports.emplace_back(ci, port.first, port.second);
         }
@@ -552,11 +861,12 @@ void XilinxPacker::pack_constants()
 
 void XilinxPacker::rename_net(IdString old, IdString newname)
 {
-    std::unique_ptr<NetInfo> ni;
-    std::swap(ni, ctx->nets[old]);
-    ctx->nets.erase(old);
+    auto fnd = ctx->nets.find(old);
+    NPNR_ASSERT(fnd != ctx->nets.end());
+    std::unique_ptr<NetInfo> ni = std::move(fnd->second);
+    ctx->nets.erase(fnd);
     ni->name = newname;
-    ctx->nets[newname] = std::move(ni);
+    ctx->nets.emplace(newname, std::move(ni));
 }
 
 void XilinxPacker::tie_port(CellInfo *ci, const std::string &port, bool value, bool inv)
@@ -650,8 +960,7 @@ void USPacker::pack_bram()
         bram_rules[ctx->id("RAMB36E2")].port_multixform[ctx->id(std::string("WEBWE[" + std::to_string(i) + "]"))] = {};
 
     // Process SDP BRAM first
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("RAMB18E2"), ctx->id("RAMB36E2")})) {
         if ((ci->type == ctx->id("RAMB18E2") &&
              int_or_default(ci->params, ctx->id(std::string("WRITE_WIDTH_B")), 0) == 36) ||
             (ci->type == ctx->id("RAMB36E2") &&
@@ -660,8 +969,7 @@ void USPacker::pack_bram()
     }
 
     // Rewrite byte enables according to data width
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("RAMB18E2"), ctx->id("RAMB36E2")})) {
         if (ci->type == ctx->id("RAMB18E2") || ci->type == ctx->id("RAMB36E2")) {
             for (char port : {'A', 'B'}) {
                 int write_width = int_or_default(ci->params, ctx->id(std::string("WRITE_WIDTH_") + port), 18);
@@ -691,8 +999,7 @@ void USPacker::pack_bram()
     generic_xform(bram_rules, false);
 
     // These pins have no logical mapping, so must be tied after transformation
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({id_RAMB18E2_RAMB18E2})) {
         if (ci->type == id_RAMB18E2_RAMB18E2) {
             for (int i = 2; i < 4; i++) {
                 IdString port = ctx->id("WEA" + std::to_string(i));
@@ -765,8 +1072,7 @@ void XC7Packer::pack_bram()
         bram_rules[ctx->id("RAMB36E1")].port_multixform[ctx->id(std::string("WEBWE[" + std::to_string(i) + "]"))] = {};
 
     // Process SDP BRAM first
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("RAMB18E1"), ctx->id("RAMB36E1")})) {
         if ((ci->type == ctx->id("RAMB18E1") &&
              int_or_default(ci->params, ctx->id(std::string("WRITE_WIDTH_B")), 0) == 36) ||
             (ci->type == ctx->id("RAMB36E1") &&
@@ -775,8 +1081,7 @@ void XC7Packer::pack_bram()
     }
 
     // Rewrite byte enables according to data width
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("RAMB18E1"), ctx->id("RAMB36E1")})) {
         if (ci->type == ctx->id("RAMB18E1") || ci->type == ctx->id("RAMB36E1")) {
             for (char port : {'A', 'B'}) {
                 int write_width = int_or_default(ci->params, ctx->id(std::string("WRITE_WIDTH_") + port), 18);
@@ -806,8 +1111,7 @@ void XC7Packer::pack_bram()
     generic_xform(bram_rules, false);
 
     // These pins have no logical mapping, so must be tied after transformation
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({id_RAMB18E1_RAMB18E1, id_RAMB36E1_RAMB36E1})) {
         if (ci->type == id_RAMB18E1_RAMB18E1) {
             int wwa = int_or_default(ci->params, ctx->id("WRITE_WIDTH_A"), 0);
             for (int i = ((wwa == 0) ? 0 : 2); i < 4; i++) {
@@ -902,62 +1206,76 @@ void USPacker::pack_uram()
 void XilinxPacker::pack_inverters()
 {
     // FIXME: fold where possible
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("INV")})) {
         if (ci->type == ctx->id("INV")) {
             ci->params[ctx->id("INIT")] = Property(1, 2);
             rename_port(ctx, ci, ctx->id("I"), ctx->id("I0"));
-            ci->type = ctx->id("LUT1");
+            set_cell_type(ci, ctx->id("LUT1"));
         }
     }
 }
 
+// Each packer pass is timed separately in the performance report
+#define PACK_PASS(pass)                                                                                                \
+    do {                                                                                                               \
+        PerfScope pass_scope(#pass);                                                                                   \
+        packer.pass();                                                                                                 \
+    } while (0)
+
 bool Arch::pack()
 {
     if (xc7) {
         XC7Packer packer;
         packer.ctx = getCtx();
-        packer.pack_constants();
-        packer.pack_inverters();
-        packer.pack_io();
+        PACK_PASS(pack_constants);
+        PACK_PASS(pack_inverters);
+        PACK_PASS(pack_io);
         // packer.prepare_iologic();
-        packer.prepare_clocking();
-        packer.pack_constants();
-        packer.pack_iologic();
-        packer.pack_idelayctrl();
-        packer.pack_clocking();
-        packer.pack_muxfs();
-        packer.pack_carries();
-        packer.pack_srls();
-        packer.pack_luts();
-        packer.pack_dram();
-        packer.pack_bram();
-        packer.pack_dsps();
-        packer.pack_ffs();
-        packer.finalise_muxfs();
-        packer.pack_lutffs();
+        PACK_PASS(prepare_clocking);
+        PACK_PASS(pack_constants);
+        PACK_PASS(pack_iologic);
+        PACK_PASS(pack_idelayctrl);
+        PACK_PASS(pack_clocking);
+        PACK_PASS(pack_muxfs);
+        PACK_PASS(pack_carries);
+        PACK_PASS(pack_srls);
+        PACK_PASS(pack_luts);
+        PACK_PASS(pack_dram);
+        PACK_PASS(pack_bram);
+        PACK_PASS(pack_dsps);
+        PACK_PASS(pack_ffs);
+        PACK_PASS(finalise_muxfs);
+        PACK_PASS(pack_lutffs);
+        PACK_PASS(cluster_slices);
     } else {
         USPacker packer;
         packer.ctx = getCtx();
-        packer.pack_constants();
-        packer.pack_inverters();
-        packer.pack_io();
-        packer.prepare_iologic();
-        packer.prepare_clocking();
-        packer.pack_constants();
-        packer.pack_iologic();
-        packer.pack_idelayctrl();
-        packer.pack_clocking();
-        packer.pack_muxfs();
-        packer.pack_carries();
-        packer.pack_luts();
-        packer.pack_dram();
-        packer.pack_bram();
-        packer.pack_uram();
-        packer.pack_dsps();
-        packer.pack_ffs();
-        packer.finalise_muxfs();
-        packer.pack_lutffs();
+        PACK_PASS(pack_constants);
+        PACK_PASS(pack_inverters);
+        PACK_PASS(pack_io);
+        PACK_PASS(prepare_iologic);
+        PACK_PASS(prepare_clocking);
+        PACK_PASS(pack_constants);
+        PACK_PASS(pack_iologic);
+        PACK_PASS(pack_idelayctrl);
+        PACK_PASS(pack_clocking);
+        PACK_PASS(pack_muxfs);
+        PACK_PASS(pack_carries);
+        PACK_PASS(pack_luts);
+        PACK_PASS(pack_dram);
+        PACK_PASS(pack_bram);
+        PACK_PASS(pack_uram);
+        PACK_PASS(pack_dsps);
+        PACK_PASS(pack_ffs);
+        PACK_PASS(finalise_muxfs);
+        PACK_PASS(pack_lutffs);
+    }
+
+    // Attributes that only pass information from one packer pass to another
+    IdString iob_site_type = id("X_IOB_SITE_TYPE"), io_bel = id("X_IO_BEL");
+    for (auto &cell : cells) {
+        cell.second->attrs.erase(iob_site_type);
+        cell.second->attrs.erase(io_bel);
     }
 
     assignArchInfo();
@@ -966,8 +1284,56 @@ bool Arch::pack()
     return true;
 }
 
+#undef PACK_PASS
+
+void Arch::setupCellInfoIds()
+{
+    auto &ids = cell_info_ids;
+    ids.is_c_inverted = id("IS_C_INVERTED");
+    ids.is_clk_inverted = id("IS_CLK_INVERTED");
+    ids.is_r_inverted = id("IS_R_INVERTED");
+    ids.is_s_inverted = id("IS_S_INVERTED");
+    ids.is_clr_inverted = id("IS_CLR_INVERTED");
+    ids.is_pre_inverted = id("IS_PRE_INVERTED");
+    ids.x_ff_as_latch = id("X_FF_AS_LATCH");
+    ids.x_ffsync = id("X_FFSYNC");
+    ids.x_lut_as_srl = id("X_LUT_AS_SRL");
+    ids.x_lut_as_dram = id("X_LUT_AS_DRAM");
+    ids.selmux2_1 = id("SELMUX2_1");
+    ids.cyinit = id("CYINIT");
+    ids.bufg_o = id("O");
+    for (int i = 0; i < 8; i++) {
+        ids.carry_o[i] = id("O" + std::to_string(i));
+        ids.carry_co[i] = id("CO" + std::to_string(i));
+        ids.carry_x[i] = id(std::string(1, 'A' + i) + "X");
+    }
+}
+
 void Arch::assignCellInfo(CellInfo *cell)
 {
+    // The clocks of a placed cell are counted in its clock region, so must be recounted if they change
+    if (cell->bel != BelId() && !cell->global_clocks.empty())
+        updateClockRegion(cell->bel, cell, -1);
+    fillCellInfo(cell);
+    if (cell->bel != BelId() && !cell->global_clocks.empty())
+        updateClockRegion(cell->bel, cell, 1);
+    if (cell->type == id_SLICE_FFX)
+        assignFFControlSet(cell);
+}
+
+void Arch::fillCellInfo(CellInfo *cell)
+{
+    auto &ids = cell_info_ids;
+    // Timing is resolved again on the next getCellDelay
+    cell->timing_bel = BelId();
+    cell->global_clocks.clear();
+    if (!tile_clock_region.empty()) {
+        for (auto &port : cell->ports)
+            if (port.second.type == PORT_IN && isBufgNet(port.second.net) &&
+                std::find(cell->global_clocks.begin(), cell->global_clocks.end(), port.second.net) ==
+                        cell->global_clocks.end())
+                cell->global_clocks.push_back(port.second.net);
+    }
     if (cell->type == id_SLICE_LUTX) {
         cell->lutInfo.input_count = 0;
         for (IdString a : {id_A1, id_A2, id_A3, id_A4, id_A5, id_A6}) {
@@ -987,8 +1353,8 @@ void Arch::assignCellInfo(CellInfo *cell)
         cell->lutInfo.di2_net = get_net_or_empty(cell, id_DI2);
         cell->lutInfo.wclk = get_net_or_empty(cell, id_CLK);
         cell->lutInfo.memory_group = 0; // fixme
-        cell->lutInfo.is_srl = cell->attrs.count(id("X_LUT_AS_SRL"));
-        cell->lutInfo.is_memory = cell->attrs.count(id("X_LUT_AS_DRAM"));
+        cell->lutInfo.is_srl = cell->attrs.count(ids.x_lut_as_srl);
+        cell->lutInfo.is_memory = cell->attrs.count(ids.x_lut_as_dram);
         cell->lutInfo.only_drives_carry = false;
         if (xc7) {
             if (cell->constr_parent != nullptr && cell->lutInfo.output_count > 0 &&
@@ -1011,37 +1377,78 @@ void Arch::assignCellInfo(CellInfo *cell)
         cell->ffInfo.clk = get_net_or_empty(cell, xc7 ? id_CK : id_CLK);
         cell->ffInfo.ce = get_net_or_empty(cell, id_CE);
         cell->ffInfo.sr = get_net_or_empty(cell, id_SR);
-        cell->ffInfo.is_clkinv = bool_or_default(cell->params, id("IS_CLK_INVERTED"), false);
-        cell->ffInfo.is_srinv = bool_or_default(cell->params, id("IS_R_INVERTED"), false) ||
-                                bool_or_default(cell->params, id("IS_S_INVERTED"), false) ||
-                                bool_or_default(cell->params, id("IS_CLR_INVERTED"), false) ||
-                                bool_or_default(cell->params, id("IS_PRE_INVERTED"), false);
-        cell->ffInfo.is_latch = cell->attrs.count(id("X_FF_AS_LATCH"));
-        cell->ffInfo.ffsync = cell->attrs.count(id("X_FFSYNC"));
+        cell->ffInfo.is_clkinv = bool_or_default(cell->params, ids.is_c_inverted, false) ||
+                                 bool_or_default(cell->params, ids.is_clk_inverted, false);
+        cell->ffInfo.is_srinv = bool_or_default(cell->params, ids.is_r_inverted, false) ||
+                                bool_or_default(cell->params, ids.is_s_inverted, false) ||
+                                bool_or_default(cell->params, ids.is_clr_inverted, false) ||
+                                bool_or_default(cell->params, ids.is_pre_inverted, false);
+        cell->ffInfo.is_latch = cell->attrs.count(ids.x_ff_as_latch);
+        cell->ffInfo.ffsync = cell->attrs.count(ids.x_ffsync);
     } else if (cell->type == id_F7MUX || cell->type == id_F8MUX || cell->type == id_F9MUX ||
-               cell->type == id("SELMUX2_1")) {
+               cell->type == ids.selmux2_1) {
         cell->muxInfo.sel = get_net_or_empty(cell, id_S0);
         cell->muxInfo.out = get_net_or_empty(cell, id_OUT);
     } else if (cell->type == id_CARRY8) {
         for (int i = 0; i < 8; i++) {
-            cell->carryInfo.out_sigs[i] = get_net_or_empty(cell, id("O" + std::to_string(i)));
-            cell->carryInfo.cout_sigs[i] = get_net_or_empty(cell, id("CO" + std::to_string(i)));
-            cell->carryInfo.x_sigs[i] = get_net_or_empty(cell, id(std::string(1, 'A' + i) + "X"));
+            cell->carryInfo.out_sigs[i] = get_net_or_empty(cell, ids.carry_o[i]);
+            cell->carryInfo.cout_sigs[i] = get_net_or_empty(cell, ids.carry_co[i]);
+            cell->carryInfo.x_sigs[i] = get_net_or_empty(cell, ids.carry_x[i]);
         }
     } else if (cell->type == id_CARRY4) {
         for (int i = 0; i < 4; i++) {
-            cell->carryInfo.out_sigs[i] = get_net_or_empty(cell, id("O" + std::to_string(i)));
-            cell->carryInfo.cout_sigs[i] = get_net_or_empty(cell, id("CO" + std::to_string(i)));
+            cell->carryInfo.out_sigs[i] = get_net_or_empty(cell, ids.carry_o[i]);
+            cell->carryInfo.cout_sigs[i] = get_net_or_empty(cell, ids.carry_co[i]);
             cell->carryInfo.x_sigs[i] = nullptr;
         }
-        cell->carryInfo.x_sigs[0] = get_net_or_empty(cell, id("CYINIT"));
+        cell->carryInfo.x_sigs[0] = get_net_or_empty(cell, ids.cyinit);
     }
 }
 
+void Arch::assignFFControlSet(CellInfo *cell)
+{
+    auto net_name = [](NetInfo *ni) { return ni == nullptr ? IdString() : ni->name; };
+    // A half-tile shares CE between all its FFs on xc7, and between the FFs of each row on UltraScale+
+    int flags = int(cell->ffInfo.is_clkinv) | int(cell->ffInfo.is_srinv) << 1 | int(cell->ffInfo.is_latch) << 2 |
+                int(xc7 && cell->ffInfo.ffsync) << 3;
+    auto ctrl_set = std::make_tuple(net_name(cell->ffInfo.clk), net_name(cell->ffInfo.sr),
+                                    xc7 ? net_name(cell->ffInfo.ce) : IdString(), flags);
+    auto cs_found = ff_ctrl_set_ids.emplace(ctrl_set, int(ff_ctrl_set_ids.size()));
+    cell->ffInfo.ctrl_set = cs_found.first->second;
+    auto ce_found = ff_ce_ids.emplace(net_name(cell->ffInfo.ce), int(ff_ce_ids.size()));
+    cell->ffInfo.ce_id = ce_found.first->second;
+}
+
 void Arch::assignArchInfo()
 {
+    // Renumber control sets from scratch, so sets whose nets have since been removed or renamed don't linger
+    ff_ctrl_set_ids.clear();
+    ff_ce_ids.clear();
+    std::vector<CellInfo *> cell_list;
     for (auto cell : sorted(cells)) {
-        assignCellInfo(cell.second);
+        cell_list.push_back(cell.second);
+        // The clocks of placed cells are counted again below, as they may have changed
+        if (cell.second->bel != BelId() && !cell.second->global_clocks.empty())
+            updateClockRegion(cell.second->bel, cell.second, -1);
+    }
+    // The info of each cell only depends on the cell itself, so is filled in in parallel
+    const size_t block = 256;
+    getCtx()->threadPool().parallel_for(
+            (cell_list.size() + block - 1) / block, 4096 / block,
+            [&](size_t b) {
+                for (size_t i = b * block; i < std::min(cell_list.size(), (b + 1) * block); i++)
+                    fillCellInfo(cell_list.at(i));
+            },
+            getCtx()->debug ? 1 : 0);
+    // Control sets are numbered, and tile status updated, in cell name order as before
+    for (auto cell : cell_list) {
+        if (cell->type == id_SLICE_FFX)
+            assignFFControlSet(cell);
+        // Cells already placed (e.g. when reloading a design) need the tile status summary updating too
+        if (cell->bel != BelId() && isLogicTile(cell->bel))
+            updateLogicBel(cell->bel, cell);
+        if (cell->bel != BelId() && !cell->global_clocks.empty())
+            updateClockRegion(cell->bel, cell, 1);
     }
 }
 
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <boost/optional.hpp>
+#include <functional>
 #include <iterator>
 #include <queue>
 #include <unordered_set>
@@ -103,6 +104,27 @@ struct XilinxPacker
     // General helper functions
     void flush_cells();
 
+    // Names of the cells of each type, so that passes only visit the cells they work on rather than scanning the
+    // whole netlist. Built on first use; entries are checked against the netlist when read, so only new cells
+    // (flush_cells) and type changes (set_cell_type) need to be recorded
+    std::unordered_map<IdString, std::vector<IdString>> cells_by_type;
+    bool cells_by_type_valid = false;
+    void index_cell(const CellInfo *ci);
+    void set_cell_type(CellInfo *ci, IdString type);
+    // Snapshot of the cells currently of any of the given types, in netlist order
+    std::vector<CellInfo *> cells_of_types(const std::vector<IdString> &types);
+    template <typename T> std::vector<CellInfo *> cells_of_types(const std::unordered_map<IdString, T> &by_type)
+    {
+        std::vector<IdString> types;
+        for (auto &entry : by_type)
+            types.push_back(entry.first);
+        return cells_of_types(types);
+    }
+
+    // Run func for every index up to count, on several threads if there are enough items. func must only read the
+    // netlist
+    void run_parallel(size_t count, const std::function<void(size_t)> &func);
+
     void xform_cell(const std::unordered_map<IdString, XFormRule> &rules, CellInfo *ci);
     void generic_xform(const std::unordered_map<IdString, XFormRule> &rules, bool print_summary = false);
 
@@ -112,6 +134,8 @@ struct XilinxPacker
     IdString int_name(IdString base, const std::string &postfix, bool is_hierarchy = true);
     NetInfo *create_internal_net(IdString base, const std::string &postfix, bool is_hierarchy = true);
     void rename_net(IdString old, IdString newname);
+    // Scratch buffer for building internal names
+    std::string name_buf;
 
     void tie_port(CellInfo *ci, const std::string &port, bool value, bool inv = false);
 
@@ -239,6 +263,9 @@ struct XC7Packer : public XilinxPacker
 
     // DSP
     void pack_dsps();
+
+    // Optional: group connected LUTFF pairs into half-slice clusters before placement
+    void cluster_slices();
 };
 
 NEXTPNR_NAMESPACE_END
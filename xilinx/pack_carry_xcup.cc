@@ -70,32 +70,31 @@ void USPacker::pack_carries()
 {
     log_info("Packing carries..\n");
     split_carry4s();
-    std::vector<CellInfo *> root_muxcys;
-    // Find MUXCYs
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
-        if (ci->type != ctx->id("MUXCY"))
-            continue;
+    // Find root MUXCYs
+    std::vector<CellInfo *> muxcys = cells_of_types({ctx->id("MUXCY")});
+    std::vector<char> is_root(muxcys.size(), 0);
+    run_parallel(muxcys.size(), [&](size_t i) {
+        CellInfo *ci = muxcys.at(i);
         NetInfo *ci_net = get_net_or_empty(ci, ctx->id("CI"));
-        if (ci_net == nullptr || ci_net->driver.cell == nullptr || ci_net->driver.cell->type != ctx->id("MUXCY") ||
-            has_illegal_fanout(ci_net)) {
-            root_muxcys.push_back(ci);
-        }
-    }
-
-    // Create chains from root MUXCYs
-    std::unordered_set<IdString> processed_muxcys;
-    std::vector<CarryGroup> groups;
-    int muxcy_count = 0, xorcy_count = 0;
-    for (auto root : root_muxcys) {
-        CarryGroup group;
+        is_root.at(i) = (ci_net == nullptr || ci_net->driver.cell == nullptr ||
+                         ci_net->driver.cell->type != ctx->id("MUXCY") || has_illegal_fanout(ci_net));
+    });
+    std::vector<CellInfo *> root_muxcys;
+    for (size_t i = 0; i < muxcys.size(); i++)
+        if (is_root.at(i))
+            root_muxcys.push_back(muxcys.at(i));
 
-        CellInfo *muxcy = root;
+    // Follow the chains from root MUXCYs. This only reads the netlist, so all chains are followed at once; the ends
+    // of the chains are then fixed up in order
+    std::vector<CarryGroup> groups(root_muxcys.size());
+    std::vector<NetInfo *> chain_ends(root_muxcys.size(), nullptr);
+    run_parallel(root_muxcys.size(), [&](size_t i) {
+        CarryGroup &group = groups.at(i);
+        CellInfo *muxcy = root_muxcys.at(i);
         NetInfo *mux_ci = nullptr;
         while (true) {
 
             group.muxcys.push_back(muxcy);
-            ++muxcy_count;
             mux_ci = get_net_or_empty(muxcy, ctx->id("CI"));
             NetInfo *mux_s = get_net_or_empty(muxcy, ctx->id("S"));
             group.xorcys.push_back(nullptr);
@@ -106,7 +105,6 @@ void USPacker::pack_carries()
                         NetInfo *xor_ci = get_net_or_empty(xorcy, ctx->id("CI"));
                         if (xor_ci == mux_ci) {
                             group.xorcys.back() = xorcy;
-                            ++xorcy_count;
                             break;
                         }
                     }
@@ -128,6 +126,19 @@ void USPacker::pack_carries()
             if (muxcy == nullptr)
                 break;
         }
+        chain_ends.at(i) = mux_ci;
+    });
+    int muxcy_count = 0, xorcy_count = 0;
+    for (auto &group : groups) {
+        muxcy_count += int(group.muxcys.size());
+        for (auto xorcy : group.xorcys)
+            if (xorcy != nullptr)
+                ++xorcy_count;
+    }
+
+    for (size_t i = 0; i < groups.size(); i++) {
+        CarryGroup &group = groups.at(i);
+        NetInfo *mux_ci = chain_ends.at(i);
         if (mux_ci != nullptr) {
             if (mux_ci->users.size() == 1 && mux_ci->users.at(0).cell->type == ctx->id("XORCY") &&
                 mux_ci->users.at(0).port == ctx->id("CI")) {
@@ -170,8 +181,6 @@ void USPacker::pack_carries()
                 new_cells.push_back(std::move(dummy_muxcy));
             }
         }
-
-        groups.push_back(group);
     }
     flush_cells();
 
@@ -369,8 +378,7 @@ void USPacker::pack_carries()
     c8_init_rules[ctx->id("CARRY8")].port_xform[ctx->id("CI")] = ctx->id("AX");
     c8_init_rules[ctx->id("CARRY8")].set_params.emplace_back(ctx->id("CARRY_TYPE"), Property("SINGLE_CY8"));
 
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("CARRY8")})) {
         if (ci->type != ctx->id("CARRY8"))
             continue;
         if (ci->constr_parent == nullptr)
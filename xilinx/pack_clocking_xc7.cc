@@ -43,16 +43,16 @@ void XC7Packer::prepare_clocking()
         CellInfo *ci = cell.second;
         if (upgrade.count(ci->type)) {
             IdString new_type = upgrade.at(ci->type);
-            ci->type = new_type;
+            set_cell_type(ci, new_type);
         } else if (ci->type == ctx->id("BUFG")) {
-            ci->type = ctx->id("BUFGCTRL");
+            set_cell_type(ci, ctx->id("BUFGCTRL"));
             rename_port(ctx, ci, ctx->id("I"), ctx->id("I0"));
             tie_port(ci, "CE0", true, true);
             tie_port(ci, "S0", true, true);
             tie_port(ci, "S1", false, true);
             tie_port(ci, "IGNORE0", true, true);
         } else if (ci->type == ctx->id("BUFGCE")) {
-            ci->type = ctx->id("BUFGCTRL");
+            set_cell_type(ci, ctx->id("BUFGCTRL"));
             rename_port(ctx, ci, ctx->id("I"), ctx->id("I0"));
             rename_port(ctx, ci, ctx->id("CE"), ctx->id("CE0"));
             tie_port(ci, "S0", true, true);
@@ -77,8 +77,7 @@ void XC7Packer::pack_plls()
     pll_rules[ctx->id("MMCME2_ADV")].new_type = ctx->id("MMCME2_ADV_MMCME2_ADV");
     pll_rules[ctx->id("PLLE2_ADV")].new_type = ctx->id("PLLE2_ADV_PLLE2_ADV");
     generic_xform(pll_rules);
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({id_MMCM_MMCM_TOP, id_PLL_PLL_TOP})) {
         // Preplace PLLs to make use of dedicated/short routing paths
         if (ci->type == id_MMCM_MMCM_TOP || ci->type == id_PLL_PLL_TOP)
             try_preplace(ci, ctx->id("CLKIN1"));
@@ -114,15 +113,13 @@ void XC7Packer::pack_gbs()
     generic_xform(gb_rules);
 
     // Make sure prerequisites are set up first
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("PS7_PS7")})) {
         if (ci->type == ctx->id("PS7_PS7"))
             preplace_unique(ci);
     }
 
     // Preplace global buffers to make use of dedicated/short routing
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({id_BUFGCTRL, ctx->id("BUFG_BUFG")})) {
         if (ci->type == id_BUFGCTRL)
             try_preplace(ci, ctx->id("I0"));
         if (ci->type == ctx->id("BUFG_BUFG"))
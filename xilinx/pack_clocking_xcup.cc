@@ -108,7 +108,7 @@ void USPacker::prepare_clocking()
         CellInfo *ci = cell.second;
         if (upgrade.count(ci->type)) {
             IdString new_type = upgrade.at(ci->type);
-            ci->type = new_type;
+            set_cell_type(ci, new_type);
         }
         if (ci->attrs.count(ctx->id("BEL")))
             used_bels.insert(ctx->getBelByName(ctx->id(ci->attrs.at(ctx->id("BEL")).as_string())));
@@ -128,8 +128,7 @@ void USPacker::pack_plls()
     pll_rules[ctx->id("MMCME4_ADV")].new_type = id_MMCM_MMCM_TOP;
     pll_rules[ctx->id("PLLE4_ADV")].new_type = id_PLL_PLL_TOP;
     generic_xform(pll_rules);
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({id_MMCM_MMCM_TOP, id_PLL_PLL_TOP})) {
         // Preplace PLLs to make use of dedicated/short routing paths
         if (ci->type == id_MMCM_MMCM_TOP || ci->type == id_PLL_PLL_TOP)
             try_preplace(ci, ctx->id("CLKIN1"));
@@ -165,8 +164,7 @@ void USPacker::pack_gbs()
     gb_rules[ctx->id("BUFGCE")].new_type = id_BUFCE_BUFCE;
 
     // Make sure prerequisites are set up first
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("PSS_ALTO_CORE")})) {
         if (ci->type == ctx->id("PSS_ALTO_CORE"))
             preplace_unique(ci);
     }
@@ -174,8 +172,7 @@ void USPacker::pack_gbs()
     generic_xform(gb_rules);
 
     // Preplace global buffers to make use of dedicated/short routing
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({id_BUFGCTRL, id_BUFCE_BUFG_PS, id_BUFGCE_DIV_BUFGCE_DIV, id_BUFCE_BUFCE})) {
         if (ci->type == id_BUFGCTRL)
             try_preplace(ci, ctx->id("I0"));
         if (ci->type == id_BUFCE_BUFG_PS || ci->type == id_BUFGCE_DIV_BUFGCE_DIV || ci->type == id_BUFCE_BUFCE)
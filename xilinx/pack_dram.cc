@@ -196,8 +196,7 @@ void XilinxPacker::pack_dram()
 
     // Optimise DRAM with tied-low inputs, to more efficiently routeable tied-high inputs
     int inverted_ports = 0;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types(dram_types)) {
         auto dt_iter = dram_types.find(ci->type);
         if (dt_iter == dram_types.end())
             continue;
@@ -226,18 +225,16 @@ void XilinxPacker::pack_dram()
             ++inverted_ports;
             if (ci->params.count(ctx->id("INIT"))) {
                 Property &init = ci->params[ctx->id("INIT")];
-                for (int j = 0; j < int(init.str.size()); j++) {
+                for (int j = 0; j < init.width; j++) {
                     if (j & (1 << i))
-                        init.str[j] = init.str[j & ~(1 << i)];
+                        init.set_bit(j, init.bit(j & ~(1 << i)));
                 }
-                init.update_intval();
             }
         }
     }
     log_info("   Transformed %d tied-low DRAM address inputs to be tied-high\n", inverted_ports);
 
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types(dram_types)) {
         auto dt_iter = dram_types.find(ci->type);
         if (dt_iter == dram_types.end())
             continue;
@@ -424,10 +421,9 @@ void XilinxPacker::pack_dram()
         }
     }
     // Whole-SLICE DRAM
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("RAM64M"), ctx->id("RAM32M")})) {
         if (ci->type == ctx->id("RAM64M") || ci->type == ctx->id("RAM32M")) {
-            bool is_64 = (cell.second->type == ctx->id("RAM64M"));
+            bool is_64 = (ci->type == ctx->id("RAM64M"));
             int abits = is_64 ? 6 : 5;
             int dbits = is_64 ? 1 : 2;
             DRAMControlSet dcs;
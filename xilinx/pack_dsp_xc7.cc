@@ -28,8 +28,7 @@ void XC7Packer::pack_dsps()
     dsp_rules[ctx->id("DSP48E1")].new_type = ctx->id("DSP48E1_DSP48E1");
     generic_xform(dsp_rules, true);
 
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("DSP48E1_DSP48E1")})) {
         if (ci->type == ctx->id("DSP48E1_DSP48E1")) {
             // DRC
             NetInfo *clk = get_net_or_empty(ci, id_CLK);
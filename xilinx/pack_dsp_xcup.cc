@@ -29,8 +29,7 @@ void USPacker::pack_dsps()
             ctx->id("DSP_PREADD_DATA"), ctx->id("DSP_PREADD"), ctx->id("DSP_A_B_DATA"), ctx->id("DSP_MULTIPLIER"),
             ctx->id("DSP_C_DATA"),      ctx->id("DSP_M_DATA"), ctx->id("DSP_ALU"),      ctx->id("DSP_OUTPUT")};
 
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("DSP48E2")})) {
         if (ci->type != ctx->id("DSP48E2"))
             continue;
 
@@ -50,7 +49,7 @@ void USPacker::pack_dsps()
          * DSP primitives in UltraScale+ (but not xc7) are complex "macros" that expand to more than one BEL
          * we must track the mapping here for useful import on the other side; and preservation of parameters
          */
-        std::unordered_map<IdString, PortInfo> orig_ports = ci->ports;
+        auto orig_ports = ci->ports;
         std::vector<CellInfo *> subcells;
 
         for (auto ctype : dsp_subcell_names) {
@@ -74,7 +74,7 @@ void XC7Packer::decompose_iob(CellInfo *xil_iob, bool is_hr, const std::string &
      * To avoid various nasty bugs (such as auto-transformation by Vivado of dedicated INV primitives to LUT1s), we
      * have to maintain this hierarchy so it can be re-built during DCP conversion in RapidWright
      */
-    std::unordered_map<IdString, PortInfo> orig_ports = xil_iob->ports;
+    auto orig_ports = xil_iob->ports;
     std::vector<CellInfo *> subcells;
 
     if (is_se_ibuf || is_se_iobuf) {
@@ -243,8 +243,7 @@ void XC7Packer::pack_io()
     get_top_level_pins(ctx, toplevel_ports);
     // Insert PAD cells on top level IO, and IO buffers where one doesn't exist already
     std::vector<std::pair<CellInfo *, PortRef>> pad_and_buf;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("$nextpnr_ibuf"), ctx->id("$nextpnr_iobuf"), ctx->id("$nextpnr_obuf")})) {
         if (ci->type == ctx->id("$nextpnr_ibuf") || ci->type == ctx->id("$nextpnr_iobuf") ||
             ci->type == ctx->id("$nextpnr_obuf"))
             pad_and_buf.push_back(insert_pad_and_buf(ci));
@@ -344,7 +343,7 @@ void XC7Packer::pack_io()
         if (!ci->attrs.count(ctx->id("X_IOB_SITE_TYPE")))
             continue;
         type.replace(0, 5, ci->attrs.at(ctx->id("X_IOB_SITE_TYPE")).as_string());
-        ci->type = ctx->id(type);
+        set_cell_type(ci, ctx->id(type));
     }
 }
 
@@ -470,8 +469,7 @@ void XC7Packer::pack_iologic()
         return outbuf;
     };
 
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("IDELAYE2")})) {
         if (ci->type == ctx->id("IDELAYE2")) {
             NetInfo *d = get_net_or_empty(ci, ctx->id("IDATAIN"));
             if (d == nullptr || d->driver.cell == nullptr)
@@ -491,8 +489,7 @@ void XC7Packer::pack_iologic()
         // FIXME: ODELAY
     }
 
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("OSERDESE2"), ctx->id("ISERDESE2")})) {
         if (ci->type == ctx->id("OSERDESE2")) {
             NetInfo *q = get_net_or_empty(ci, ctx->id("OQ"));
             if (q == nullptr || q->users.empty())
@@ -550,8 +547,7 @@ void XC7Packer::pack_iologic()
 void XC7Packer::pack_idelayctrl()
 {
     CellInfo *idelayctrl = nullptr;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("IDELAYCTRL")})) {
         if (ci->type == ctx->id("IDELAYCTRL")) {
             if (idelayctrl != nullptr)
                 log_error("Found more than one IDELAYCTRL cell!\n");
@@ -561,8 +557,7 @@ void XC7Packer::pack_idelayctrl()
     if (idelayctrl == nullptr)
         return;
     std::set<std::string> ioctrl_sites;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("IDELAYE2_IDELAYE2"), ctx->id("ODELAYE2_ODELAYE2")})) {
         if (ci->type == ctx->id("IDELAYE2_IDELAYE2") || ci->type == ctx->id("ODELAYE2_ODELAYE2")) {
             if (!ci->attrs.count(ctx->id("BEL")))
                 continue;
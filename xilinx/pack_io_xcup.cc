@@ -139,7 +139,7 @@ void USPacker::decompose_iob(CellInfo *xil_iob, const std::string &iostandard)
      * To avoid various nasty bugs (such as auto-transformation by Vivado of dedicated INV primitives to LUT1s), we
      * have to maintain this hierarchy so it can be re-built during DCP conversion in RapidWright
      */
-    std::unordered_map<IdString, PortInfo> orig_ports = xil_iob->ports;
+    auto orig_ports = xil_iob->ports;
     std::vector<CellInfo *> subcells;
 
     auto diffinbuf_site = [&](std::string site_p) {
@@ -465,8 +465,7 @@ void USPacker::pack_io()
     get_top_level_pins(ctx, toplevel_ports);
     // Insert PAD cells on top level IO, and IO buffers where one doesn't exist already
     std::vector<std::pair<CellInfo *, PortRef>> pad_and_buf;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("$nextpnr_ibuf"), ctx->id("$nextpnr_iobuf"), ctx->id("$nextpnr_obuf")})) {
         if (ci->type == ctx->id("$nextpnr_ibuf") || ci->type == ctx->id("$nextpnr_iobuf") ||
             ci->type == ctx->id("$nextpnr_obuf"))
             pad_and_buf.push_back(insert_pad_and_buf(ci));
@@ -577,11 +576,10 @@ std::string USPacker::get_ioctrl_site(const std::string &iol_bel)
 
 void USPacker::prepare_iologic()
 {
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("ODDRE1")})) {
         // ODDRE1 must be transformed to an OSERDESE3
         if (ci->type == ctx->id("ODDRE1")) {
-            ci->type = ctx->id("OSERDESE3");
+            set_cell_type(ci, ctx->id("OSERDESE3"));
             ci->params[ctx->id("ODDR_MODE")] = std::string("TRUE");
             rename_port(ctx, ci, ctx->id("C"), ctx->id("CLK"));
             rename_port(ctx, ci, ctx->id("SR"), ctx->id("RST"));
@@ -623,8 +621,7 @@ void USPacker::pack_iologic()
 
     std::unordered_map<IdString, BelId> iodelay_to_io;
 
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("IDELAYE3"), ctx->id("ODELAYE3")})) {
         if (ci->type == ctx->id("IDELAYE3")) {
             NetInfo *d = get_net_or_empty(ci, ctx->id("IDATAIN"));
             if (d == nullptr || d->driver.cell == nullptr)
@@ -671,8 +668,7 @@ void USPacker::pack_iologic()
         }
     }
 
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("IDDRE1"), ctx->id("ISERDESE3"), ctx->id("OSERDESE3")})) {
         if (ci->type == ctx->id("IDDRE1") || ci->type == ctx->id("ISERDESE3")) {
             NetInfo *d = get_net_or_empty(ci, ctx->id("D"));
             if (d == nullptr || d->driver.cell == nullptr)
@@ -745,8 +741,7 @@ void USPacker::pack_iologic()
 void USPacker::pack_idelayctrl()
 {
     CellInfo *idelayctrl = nullptr;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("IDELAYCTRL")})) {
         if (ci->type == ctx->id("IDELAYCTRL")) {
             if (idelayctrl != nullptr)
                 log_error("Found more than one IDELAYCTRL cell!\n");
@@ -756,8 +751,7 @@ void USPacker::pack_idelayctrl()
     if (idelayctrl == nullptr)
         return;
     std::set<std::string> ioctrl_sites;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto ci : cells_of_types({ctx->id("IDELAYE3"), ctx->id("ODELAYE3")})) {
         if (ci->type == ctx->id("IDELAYE3") || ci->type == ctx->id("ODELAYE3")) {
             if (!ci->attrs.count(ctx->id("BEL")))
                 continue;
@@ -0,0 +1,118 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <fstream>
+#include "log.h"
+#include "nextpnr.h"
+#include "thread_pool.h"
+#include "util.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+// The routing of a net as a tree from its source wires, each line being the depth in the tree, the wire, the pip
+// driving it (or '-') and the binding strength, with names as in the ROUTING attribute of the JSON output
+std::string net_route_tree(const Context *ctx, const NetInfo *ni)
+{
+    std::unordered_map<WireId, std::vector<WireId>> children;
+    std::vector<WireId> roots;
+    for (auto &w : ni->wires) {
+        if (w.second.pip == PipId()) {
+            roots.push_back(w.first);
+            continue;
+        }
+        WireId parent = ctx->getPipSrcWire(w.second.pip);
+        if (ni->wires.count(parent))
+            children[parent].push_back(w.first);
+        else
+            roots.push_back(w.first);
+    }
+    std::string out;
+    std::vector<std::pair<WireId, int>> stack;
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it)
+        stack.emplace_back(*it, 0);
+    while (!stack.empty()) {
+        WireId wire = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        auto &pm = ni->wires.at(wire);
+        out += std::to_string(depth);
+        out += ' ';
+        ctx->appendWireName(out, wire);
+        out += ' ';
+        if (pm.pip != PipId())
+            ctx->appendPipName(out, pm.pip);
+        else
+            out += '-';
+        out += ' ';
+        out += std::to_string(int(pm.strength));
+        out += '\n';
+        auto fnd = children.find(wire);
+        if (fnd == children.end())
+            continue;
+        for (auto it = fnd->second.rbegin(); it != fnd->second.rend(); ++it)
+            stack.emplace_back(*it, depth + 1);
+    }
+    return out;
+}
+} // namespace
+
+// Physical netlist: the placement and routing of the design, gzip compressed, for loading into RapidWright with
+// json2dcp without going through the routing attributes of the JSON netlist. Lines are:
+//   "nextpnr-xilinx-physnet 1" <device>
+//   "cell" <strength> <site>/<bel> <cell name>, for each placed cell
+//   "net" <routed wire count> <net name>, followed by the route tree of the net (see net_route_tree)
+// Names are last on their line, as they may contain spaces. Cells and nets are in name order.
+void Arch::writePhysNetlist(const std::string &filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+        log_error("failed to open file %s for writing (%s)\n", filename.c_str(), strerror(errno));
+    boost::iostreams::filtering_ostream out;
+    out.push(boost::iostreams::gzip_compressor());
+    out.push(file);
+
+    out << "nextpnr-xilinx-physnet 1 " << chip_info->name.get() << "\n";
+    for (auto cell : sorted(cells)) {
+        CellInfo *ci = cell.second;
+        if (ci->bel == BelId())
+            continue;
+        out << "cell " << int(ci->belStrength) << " " << getBelName(ci->bel).str(this) << " " << ci->name.str(this)
+            << "\n";
+    }
+
+    // The route trees are built on worker threads, then written out in order
+    std::vector<NetInfo *> nets;
+    for (auto net : sorted(this->nets))
+        nets.push_back(net.second);
+    std::vector<std::string> trees(nets.size());
+    getCtx()->threadPool().parallel_for(nets.size(), 256,
+                                        [&](size_t i) { trees.at(i) = net_route_tree(getCtx(), nets.at(i)); });
+
+    for (size_t i = 0; i < nets.size(); i++) {
+        out << "net " << nets.at(i)->wires.size() << " " << nets.at(i)->name.str(this) << "\n";
+        out << trees.at(i);
+        std::string().swap(trees.at(i));
+    }
+    out.reset();
+    if (!file)
+        log_error("failed to write physical netlist %s\n", filename.c_str());
+}
+
+NEXTPNR_NAMESPACE_END
@@ -21,344 +21,398 @@
 
 NEXTPNR_NAMESPACE_BEGIN
 
-void get_invertible_pins(Context *ctx, std::unordered_map<IdString, std::unordered_set<IdString>> &invertible_pins)
+namespace {
+// List of pins that have an IS_x_INVERTED attributed, so we can optimise tie-zero to tie-one for these pins, as (cell
+// type, pin, UltraScale only). See scripts/invertible_pins.py
+struct InvertiblePin
 {
-    // List of pins that have an IS_x_INVERTED attributed, so we can optimise tie-zero to tie-one for these pins
-    // See scripts/invertible_pins.py
+    const char *cell, *pin;
+    bool xcup_only;
+};
 
+const InvertiblePin invertible_pin_table[] = {
     // Common and xcup
-    invertible_pins[ctx->id("BUFGCTRL")].insert(ctx->id("CE0"));
-    invertible_pins[ctx->id("BUFGCTRL")].insert(ctx->id("CE1"));
-    invertible_pins[ctx->id("BUFGCTRL")].insert(ctx->id("S0"));
-    invertible_pins[ctx->id("BUFGCTRL")].insert(ctx->id("S1"));
-    invertible_pins[ctx->id("BUFGCTRL")].insert(ctx->id("IGNORE0"));
-    invertible_pins[ctx->id("BUFGCTRL")].insert(ctx->id("IGNORE1"));
-    invertible_pins[ctx->id("BUFHCE")].insert(ctx->id("CE"));
-    invertible_pins[ctx->id("FDRE")].insert(ctx->id("C"));
-    if (!ctx->xc7)
-        invertible_pins[ctx->id("FDRE")].insert(ctx->id("R"));
-    invertible_pins[ctx->id("FDSE")].insert(ctx->id("C"));
-    if (!ctx->xc7)
-        invertible_pins[ctx->id("FDSE")].insert(ctx->id("S"));
-    invertible_pins[ctx->id("FDCE")].insert(ctx->id("C"));
-    if (!ctx->xc7)
-        invertible_pins[ctx->id("FDCE")].insert(ctx->id("CLR"));
-    invertible_pins[ctx->id("FDPE")].insert(ctx->id("C"));
-    if (!ctx->xc7)
-        invertible_pins[ctx->id("FDPE")].insert(ctx->id("PRE"));
-    invertible_pins[ctx->id("SRL16E")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("SRLC32E")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("BUFGCE")].insert(ctx->id("CE"));
-    invertible_pins[ctx->id("BUFGCE")].insert(ctx->id("I"));
-    invertible_pins[ctx->id("BUFGCE_DIV")].insert(ctx->id("CE"));
-    invertible_pins[ctx->id("BUFGCE_DIV")].insert(ctx->id("CLR"));
-    invertible_pins[ctx->id("BUFGCE_DIV")].insert(ctx->id("I"));
-    invertible_pins[ctx->id("CFGLUT5")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("ALUMODE[0]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("ALUMODE[1]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("ALUMODE[2]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("ALUMODE[3]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("CARRYIN"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("INMODE[0]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("INMODE[1]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("INMODE[2]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("INMODE[3]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("INMODE[4]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("OPMODE[0]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("OPMODE[1]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("OPMODE[2]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("OPMODE[3]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("OPMODE[4]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("OPMODE[5]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("OPMODE[6]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("OPMODE[7]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("OPMODE[8]"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTALLCARRYIN"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTALUMODE"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTA"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTB"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTCTRL"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTC"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTD"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTINMODE"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTM"));
-    invertible_pins[ctx->id("DSP48E2")].insert(ctx->id("RSTP"));
-    invertible_pins[ctx->id("FIFO18E2")].insert(ctx->id("RDCLK"));
-    invertible_pins[ctx->id("FIFO18E2")].insert(ctx->id("RDEN"));
-    invertible_pins[ctx->id("FIFO18E2")].insert(ctx->id("RSTREG"));
-    invertible_pins[ctx->id("FIFO18E2")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("FIFO18E2")].insert(ctx->id("WRCLK"));
-    invertible_pins[ctx->id("FIFO18E2")].insert(ctx->id("WREN"));
-    invertible_pins[ctx->id("FIFO36E2")].insert(ctx->id("RDCLK"));
-    invertible_pins[ctx->id("FIFO36E2")].insert(ctx->id("RDEN"));
-    invertible_pins[ctx->id("FIFO36E2")].insert(ctx->id("RSTREG"));
-    invertible_pins[ctx->id("FIFO36E2")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("FIFO36E2")].insert(ctx->id("WRCLK"));
-    invertible_pins[ctx->id("FIFO36E2")].insert(ctx->id("WREN"));
-    invertible_pins[ctx->id("HARD_SYNC")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("IDDRE1")].insert(ctx->id("CB"));
-    invertible_pins[ctx->id("IDDRE1")].insert(ctx->id("C"));
-    invertible_pins[ctx->id("IDELAYE3")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("IDELAYE3")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("ISERDESE3")].insert(ctx->id("CLK_B"));
-    invertible_pins[ctx->id("ISERDESE3")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("ISERDESE3")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("LDCE")].insert(ctx->id("CLR"));
-    invertible_pins[ctx->id("LDCE")].insert(ctx->id("G"));
-    invertible_pins[ctx->id("LDPE")].insert(ctx->id("G"));
-    invertible_pins[ctx->id("LDPE")].insert(ctx->id("PRE"));
-    invertible_pins[ctx->id("MMCME3_ADV")].insert(ctx->id("CLKFBIN"));
-    invertible_pins[ctx->id("MMCME3_ADV")].insert(ctx->id("CLKIN1"));
-    invertible_pins[ctx->id("MMCME3_ADV")].insert(ctx->id("CLKIN2"));
-    invertible_pins[ctx->id("MMCME3_ADV")].insert(ctx->id("CLKINSEL"));
-    invertible_pins[ctx->id("MMCME3_ADV")].insert(ctx->id("PSEN"));
-    invertible_pins[ctx->id("MMCME3_ADV")].insert(ctx->id("PSINCDEC"));
-    invertible_pins[ctx->id("MMCME3_ADV")].insert(ctx->id("PWRDWN"));
-    invertible_pins[ctx->id("MMCME3_ADV")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("MMCME3_BASE")].insert(ctx->id("CLKFBIN"));
-    invertible_pins[ctx->id("MMCME3_BASE")].insert(ctx->id("CLKIN1"));
-    invertible_pins[ctx->id("MMCME3_BASE")].insert(ctx->id("PWRDWN"));
-    invertible_pins[ctx->id("MMCME3_BASE")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("MMCME4_ADV")].insert(ctx->id("CLKFBIN"));
-    invertible_pins[ctx->id("MMCME4_ADV")].insert(ctx->id("CLKIN1"));
-    invertible_pins[ctx->id("MMCME4_ADV")].insert(ctx->id("CLKIN2"));
-    invertible_pins[ctx->id("MMCME4_ADV")].insert(ctx->id("CLKINSEL"));
-    invertible_pins[ctx->id("MMCME4_ADV")].insert(ctx->id("PSEN"));
-    invertible_pins[ctx->id("MMCME4_ADV")].insert(ctx->id("PSINCDEC"));
-    invertible_pins[ctx->id("MMCME4_ADV")].insert(ctx->id("PWRDWN"));
-    invertible_pins[ctx->id("MMCME4_ADV")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("ODDRE1")].insert(ctx->id("C"));
-    // invertible_pins[ctx->id("ODDRE1")].insert(ctx->id("D1"));
-    // invertible_pins[ctx->id("ODDRE1")].insert(ctx->id("D2"));
-    invertible_pins[ctx->id("ODELAYE3")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("ODELAYE3")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("OR2L")].insert(ctx->id("SRI"));
-    invertible_pins[ctx->id("OSERDESE3")].insert(ctx->id("CLKDIV"));
-    invertible_pins[ctx->id("OSERDESE3")].insert(ctx->id("CLK"));
-    // invertible_pins[ctx->id("OSERDESE3")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("PLLE3_ADV")].insert(ctx->id("CLKFBIN"));
-    invertible_pins[ctx->id("PLLE3_ADV")].insert(ctx->id("CLKIN"));
-    invertible_pins[ctx->id("PLLE3_ADV")].insert(ctx->id("PWRDWN"));
-    invertible_pins[ctx->id("PLLE3_ADV")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("PLLE3_BASE")].insert(ctx->id("CLKFBIN"));
-    invertible_pins[ctx->id("PLLE3_BASE")].insert(ctx->id("CLKIN"));
-    invertible_pins[ctx->id("PLLE3_BASE")].insert(ctx->id("PWRDWN"));
-    invertible_pins[ctx->id("PLLE3_BASE")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("PLLE4_ADV")].insert(ctx->id("CLKFBIN"));
-    invertible_pins[ctx->id("PLLE4_ADV")].insert(ctx->id("CLKIN"));
-    invertible_pins[ctx->id("PLLE4_ADV")].insert(ctx->id("PWRDWN"));
-    invertible_pins[ctx->id("PLLE4_ADV")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("RAM128X1D")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM128X1S")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM256X1D")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM256X1S")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM32M")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM32M16")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM32X1D")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM32X1S")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM32X2S")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM512X1S")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM64M")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM64M8")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM64X1D")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM64X1S")].insert(ctx->id("WCLK"));
-    invertible_pins[ctx->id("RAM64X8SW")].insert(ctx->id("WCLK"));
-    // invertible_pins[ctx->id("RAMB18E2")].insert(ctx->id("CLKARDCLK"));
-    // invertible_pins[ctx->id("RAMB18E2")].insert(ctx->id("CLKBWRCLK"));
-    invertible_pins[ctx->id("RAMB18E2")].insert(ctx->id("ENARDEN"));
-    invertible_pins[ctx->id("RAMB18E2")].insert(ctx->id("ENBWREN"));
-    invertible_pins[ctx->id("RAMB18E2")].insert(ctx->id("RSTRAMARSTRAM"));
-    invertible_pins[ctx->id("RAMB18E2")].insert(ctx->id("RSTRAMB"));
-    invertible_pins[ctx->id("RAMB18E2")].insert(ctx->id("RSTREGARSTREG"));
-    invertible_pins[ctx->id("RAMB18E2")].insert(ctx->id("RSTREGB"));
-    // invertible_pins[ctx->id("RAMB36E2")].insert(ctx->id("CLKARDCLK"));
-    // invertible_pins[ctx->id("RAMB36E2")].insert(ctx->id("CLKBWRCLK"));
-    invertible_pins[ctx->id("RAMB36E2")].insert(ctx->id("ENARDEN"));
-    invertible_pins[ctx->id("RAMB36E2")].insert(ctx->id("ENBWREN"));
-    invertible_pins[ctx->id("RAMB36E2")].insert(ctx->id("RSTRAMARSTRAM"));
-    invertible_pins[ctx->id("RAMB36E2")].insert(ctx->id("RSTRAMB"));
-    invertible_pins[ctx->id("RAMB36E2")].insert(ctx->id("RSTREGARSTREG"));
-    invertible_pins[ctx->id("RAMB36E2")].insert(ctx->id("RSTREGB"));
-    invertible_pins[ctx->id("RX_BITSLICE")].insert(ctx->id("CLK_EXT"));
-    invertible_pins[ctx->id("RX_BITSLICE")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("RX_BITSLICE")].insert(ctx->id("RST_DLY_EXT"));
-    invertible_pins[ctx->id("RX_BITSLICE")].insert(ctx->id("RST_DLY"));
-    invertible_pins[ctx->id("RX_BITSLICE")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("RXTX_BITSLICE")].insert(ctx->id("RX_CLK"));
-    invertible_pins[ctx->id("RXTX_BITSLICE")].insert(ctx->id("RX_RST_DLY"));
-    invertible_pins[ctx->id("RXTX_BITSLICE")].insert(ctx->id("RX_RST"));
-    invertible_pins[ctx->id("RXTX_BITSLICE")].insert(ctx->id("TX_CLK"));
-    invertible_pins[ctx->id("RXTX_BITSLICE")].insert(ctx->id("TX_RST_DLY"));
-    invertible_pins[ctx->id("RXTX_BITSLICE")].insert(ctx->id("TX_RST"));
-    invertible_pins[ctx->id("SYSMONE1")].insert(ctx->id("CONVSTCLK"));
-    invertible_pins[ctx->id("SYSMONE1")].insert(ctx->id("DCLK"));
-    invertible_pins[ctx->id("SYSMONE4")].insert(ctx->id("CONVSTCLK"));
-    invertible_pins[ctx->id("SYSMONE4")].insert(ctx->id("DCLK"));
-    invertible_pins[ctx->id("TX_BITSLICE")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("TX_BITSLICE")].insert(ctx->id("RST_DLY"));
-    invertible_pins[ctx->id("TX_BITSLICE")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("TX_BITSLICE_TRI")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("TX_BITSLICE_TRI")].insert(ctx->id("RST_DLY"));
-    invertible_pins[ctx->id("TX_BITSLICE_TRI")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("URAM288")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("URAM288")].insert(ctx->id("EN_A"));
-    invertible_pins[ctx->id("URAM288")].insert(ctx->id("EN_B"));
-    invertible_pins[ctx->id("URAM288")].insert(ctx->id("RDB_WR_A"));
-    invertible_pins[ctx->id("URAM288")].insert(ctx->id("RDB_WR_B"));
-    invertible_pins[ctx->id("URAM288")].insert(ctx->id("RST_A"));
-    invertible_pins[ctx->id("URAM288")].insert(ctx->id("RST_B"));
-    invertible_pins[ctx->id("URAM288_BASE")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("URAM288_BASE")].insert(ctx->id("EN_A"));
-    invertible_pins[ctx->id("URAM288_BASE")].insert(ctx->id("EN_B"));
-    invertible_pins[ctx->id("URAM288_BASE")].insert(ctx->id("RDB_WR_A"));
-    invertible_pins[ctx->id("URAM288_BASE")].insert(ctx->id("RDB_WR_B"));
-    invertible_pins[ctx->id("URAM288_BASE")].insert(ctx->id("RST_A"));
-    invertible_pins[ctx->id("URAM288_BASE")].insert(ctx->id("RST_B"));
+    {"BUFGCTRL", "CE0", false},
+    {"BUFGCTRL", "CE1", false},
+    {"BUFGCTRL", "S0", false},
+    {"BUFGCTRL", "S1", false},
+    {"BUFGCTRL", "IGNORE0", false},
+    {"BUFGCTRL", "IGNORE1", false},
+    {"BUFHCE", "CE", false},
+    {"FDRE", "C", false},
+    {"FDRE", "R", true},
+    {"FDSE", "C", false},
+    {"FDSE", "S", true},
+    {"FDCE", "C", false},
+    {"FDCE", "CLR", true},
+    {"FDPE", "C", false},
+    {"FDPE", "PRE", true},
+    {"SRL16E", "CLK", false},
+    {"SRLC32E", "CLK", false},
+    {"BUFGCE", "CE", false},
+    {"BUFGCE", "I", false},
+    {"BUFGCE_DIV", "CE", false},
+    {"BUFGCE_DIV", "CLR", false},
+    {"BUFGCE_DIV", "I", false},
+    {"CFGLUT5", "CLK", false},
+    {"DSP48E2", "ALUMODE[0]", false},
+    {"DSP48E2", "ALUMODE[1]", false},
+    {"DSP48E2", "ALUMODE[2]", false},
+    {"DSP48E2", "ALUMODE[3]", false},
+    {"DSP48E2", "CARRYIN", false},
+    {"DSP48E2", "CLK", false},
+    {"DSP48E2", "INMODE[0]", false},
+    {"DSP48E2", "INMODE[1]", false},
+    {"DSP48E2", "INMODE[2]", false},
+    {"DSP48E2", "INMODE[3]", false},
+    {"DSP48E2", "INMODE[4]", false},
+    {"DSP48E2", "OPMODE[0]", false},
+    {"DSP48E2", "OPMODE[1]", false},
+    {"DSP48E2", "OPMODE[2]", false},
+    {"DSP48E2", "OPMODE[3]", false},
+    {"DSP48E2", "OPMODE[4]", false},
+    {"DSP48E2", "OPMODE[5]", false},
+    {"DSP48E2", "OPMODE[6]", false},
+    {"DSP48E2", "OPMODE[7]", false},
+    {"DSP48E2", "OPMODE[8]", false},
+    {"DSP48E2", "RSTALLCARRYIN", false},
+    {"DSP48E2", "RSTALUMODE", false},
+    {"DSP48E2", "RSTA", false},
+    {"DSP48E2", "RSTB", false},
+    {"DSP48E2", "RSTCTRL", false},
+    {"DSP48E2", "RSTC", false},
+    {"DSP48E2", "RSTD", false},
+    {"DSP48E2", "RSTINMODE", false},
+    {"DSP48E2", "RSTM", false},
+    {"DSP48E2", "RSTP", false},
+    {"FIFO18E2", "RDCLK", false},
+    {"FIFO18E2", "RDEN", false},
+    {"FIFO18E2", "RSTREG", false},
+    {"FIFO18E2", "RST", false},
+    {"FIFO18E2", "WRCLK", false},
+    {"FIFO18E2", "WREN", false},
+    {"FIFO36E2", "RDCLK", false},
+    {"FIFO36E2", "RDEN", false},
+    {"FIFO36E2", "RSTREG", false},
+    {"FIFO36E2", "RST", false},
+    {"FIFO36E2", "WRCLK", false},
+    {"FIFO36E2", "WREN", false},
+    {"HARD_SYNC", "CLK", false},
+    {"IDDRE1", "CB", false},
+    {"IDDRE1", "C", false},
+    {"IDELAYE3", "CLK", false},
+    {"IDELAYE3", "RST", false},
+    {"ISERDESE3", "CLK_B", false},
+    {"ISERDESE3", "CLK", false},
+    {"ISERDESE3", "RST", false},
+    {"LDCE", "CLR", false},
+    {"LDCE", "G", false},
+    {"LDPE", "G", false},
+    {"LDPE", "PRE", false},
+    {"MMCME3_ADV", "CLKFBIN", false},
+    {"MMCME3_ADV", "CLKIN1", false},
+    {"MMCME3_ADV", "CLKIN2", false},
+    {"MMCME3_ADV", "CLKINSEL", false},
+    {"MMCME3_ADV", "PSEN", false},
+    {"MMCME3_ADV", "PSINCDEC", false},
+    {"MMCME3_ADV", "PWRDWN", false},
+    {"MMCME3_ADV", "RST", false},
+    {"MMCME3_BASE", "CLKFBIN", false},
+    {"MMCME3_BASE", "CLKIN1", false},
+    {"MMCME3_BASE", "PWRDWN", false},
+    {"MMCME3_BASE", "RST", false},
+    {"MMCME4_ADV", "CLKFBIN", false},
+    {"MMCME4_ADV", "CLKIN1", false},
+    {"MMCME4_ADV", "CLKIN2", false},
+    {"MMCME4_ADV", "CLKINSEL", false},
+    {"MMCME4_ADV", "PSEN", false},
+    {"MMCME4_ADV", "PSINCDEC", false},
+    {"MMCME4_ADV", "PWRDWN", false},
+    {"MMCME4_ADV", "RST", false},
+    {"ODDRE1", "C", false},
+    // {"ODDRE1", "D1", false},
+    // {"ODDRE1", "D2", false},
+    {"ODELAYE3", "CLK", false},
+    {"ODELAYE3", "RST", false},
+    {"OR2L", "SRI", false},
+    {"OSERDESE3", "CLKDIV", false},
+    {"OSERDESE3", "CLK", false},
+    // {"OSERDESE3", "RST", false},
+    {"PLLE3_ADV", "CLKFBIN", false},
+    {"PLLE3_ADV", "CLKIN", false},
+    {"PLLE3_ADV", "PWRDWN", false},
+    {"PLLE3_ADV", "RST", false},
+    {"PLLE3_BASE", "CLKFBIN", false},
+    {"PLLE3_BASE", "CLKIN", false},
+    {"PLLE3_BASE", "PWRDWN", false},
+    {"PLLE3_BASE", "RST", false},
+    {"PLLE4_ADV", "CLKFBIN", false},
+    {"PLLE4_ADV", "CLKIN", false},
+    {"PLLE4_ADV", "PWRDWN", false},
+    {"PLLE4_ADV", "RST", false},
+    {"RAM128X1D", "WCLK", false},
+    {"RAM128X1S", "WCLK", false},
+    {"RAM256X1D", "WCLK", false},
+    {"RAM256X1S", "WCLK", false},
+    {"RAM32M", "WCLK", false},
+    {"RAM32M16", "WCLK", false},
+    {"RAM32X1D", "WCLK", false},
+    {"RAM32X1S", "WCLK", false},
+    {"RAM32X2S", "WCLK", false},
+    {"RAM512X1S", "WCLK", false},
+    {"RAM64M", "WCLK", false},
+    {"RAM64M8", "WCLK", false},
+    {"RAM64X1D", "WCLK", false},
+    {"RAM64X1S", "WCLK", false},
+    {"RAM64X8SW", "WCLK", false},
+    // {"RAMB18E2", "CLKARDCLK", false},
+    // {"RAMB18E2", "CLKBWRCLK", false},
+    {"RAMB18E2", "ENARDEN", false},
+    {"RAMB18E2", "ENBWREN", false},
+    {"RAMB18E2", "RSTRAMARSTRAM", false},
+    {"RAMB18E2", "RSTRAMB", false},
+    {"RAMB18E2", "RSTREGARSTREG", false},
+    {"RAMB18E2", "RSTREGB", false},
+    // {"RAMB36E2", "CLKARDCLK", false},
+    // {"RAMB36E2", "CLKBWRCLK", false},
+    {"RAMB36E2", "ENARDEN", false},
+    {"RAMB36E2", "ENBWREN", false},
+    {"RAMB36E2", "RSTRAMARSTRAM", false},
+    {"RAMB36E2", "RSTRAMB", false},
+    {"RAMB36E2", "RSTREGARSTREG", false},
+    {"RAMB36E2", "RSTREGB", false},
+    {"RX_BITSLICE", "CLK_EXT", false},
+    {"RX_BITSLICE", "CLK", false},
+    {"RX_BITSLICE", "RST_DLY_EXT", false},
+    {"RX_BITSLICE", "RST_DLY", false},
+    {"RX_BITSLICE", "RST", false},
+    {"RXTX_BITSLICE", "RX_CLK", false},
+    {"RXTX_BITSLICE", "RX_RST_DLY", false},
+    {"RXTX_BITSLICE", "RX_RST", false},
+    {"RXTX_BITSLICE", "TX_CLK", false},
+    {"RXTX_BITSLICE", "TX_RST_DLY", false},
+    {"RXTX_BITSLICE", "TX_RST", false},
+    {"SYSMONE1", "CONVSTCLK", false},
+    {"SYSMONE1", "DCLK", false},
+    {"SYSMONE4", "CONVSTCLK", false},
+    {"SYSMONE4", "DCLK", false},
+    {"TX_BITSLICE", "CLK", false},
+    {"TX_BITSLICE", "RST_DLY", false},
+    {"TX_BITSLICE", "RST", false},
+    {"TX_BITSLICE_TRI", "CLK", false},
+    {"TX_BITSLICE_TRI", "RST_DLY", false},
+    {"TX_BITSLICE_TRI", "RST", false},
+    {"URAM288", "CLK", false},
+    {"URAM288", "EN_A", false},
+    {"URAM288", "EN_B", false},
+    {"URAM288", "RDB_WR_A", false},
+    {"URAM288", "RDB_WR_B", false},
+    {"URAM288", "RST_A", false},
+    {"URAM288", "RST_B", false},
+    {"URAM288_BASE", "CLK", false},
+    {"URAM288_BASE", "EN_A", false},
+    {"URAM288_BASE", "EN_B", false},
+    {"URAM288_BASE", "RDB_WR_A", false},
+    {"URAM288_BASE", "RDB_WR_B", false},
+    {"URAM288_BASE", "RST_A", false},
+    {"URAM288_BASE", "RST_B", false},
 
     // xc7
-    invertible_pins[ctx->id("RAMB18E1")].insert(ctx->id("CLKARDCLK"));
-    invertible_pins[ctx->id("RAMB18E1")].insert(ctx->id("CLKBWRCLK"));
-    invertible_pins[ctx->id("RAMB18E1")].insert(ctx->id("ENARDEN"));
-    invertible_pins[ctx->id("RAMB18E1")].insert(ctx->id("ENBWREN"));
-    invertible_pins[ctx->id("RAMB18E1")].insert(ctx->id("RSTRAMARSTRAM"));
-    invertible_pins[ctx->id("RAMB18E1")].insert(ctx->id("RSTRAMB"));
-    invertible_pins[ctx->id("RAMB18E1")].insert(ctx->id("RSTREGARSTREG"));
-    invertible_pins[ctx->id("RAMB18E1")].insert(ctx->id("RSTREGB"));
-    invertible_pins[ctx->id("RAMB36E1")].insert(ctx->id("CLKARDCLK"));
-    invertible_pins[ctx->id("RAMB36E1")].insert(ctx->id("CLKBWRCLK"));
-    invertible_pins[ctx->id("RAMB36E1")].insert(ctx->id("ENARDEN"));
-    invertible_pins[ctx->id("RAMB36E1")].insert(ctx->id("ENBWREN"));
-    invertible_pins[ctx->id("RAMB36E1")].insert(ctx->id("RSTRAMARSTRAM"));
-    invertible_pins[ctx->id("RAMB36E1")].insert(ctx->id("RSTRAMB"));
-    invertible_pins[ctx->id("RAMB36E1")].insert(ctx->id("RSTREGARSTREG"));
-    invertible_pins[ctx->id("RAMB36E1")].insert(ctx->id("RSTREGB"));
-    invertible_pins[ctx->id("BUFMRCE")].insert(ctx->id("CE"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("ALUMODE[0]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("ALUMODE[1]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("ALUMODE[2]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("ALUMODE[3]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("CARRYIN"));
-    // invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("CLK"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("INMODE[0]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("INMODE[1]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("INMODE[2]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("INMODE[3]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("INMODE[4]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("OPMODE[0]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("OPMODE[1]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("OPMODE[2]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("OPMODE[3]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("OPMODE[4]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("OPMODE[5]"));
-    invertible_pins[ctx->id("DSP48E1")].insert(ctx->id("OPMODE[6]"));
-    invertible_pins[ctx->id("FIFO18E1")].insert(ctx->id("RDCLK"));
-    invertible_pins[ctx->id("FIFO18E1")].insert(ctx->id("RDEN"));
-    invertible_pins[ctx->id("FIFO18E1")].insert(ctx->id("RSTREG"));
-    invertible_pins[ctx->id("FIFO18E1")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("FIFO18E1")].insert(ctx->id("WRCLK"));
-    invertible_pins[ctx->id("FIFO18E1")].insert(ctx->id("WREN"));
-    invertible_pins[ctx->id("FIFO36E1")].insert(ctx->id("RDCLK"));
-    invertible_pins[ctx->id("FIFO36E1")].insert(ctx->id("RDEN"));
-    invertible_pins[ctx->id("FIFO36E1")].insert(ctx->id("RSTREG"));
-    invertible_pins[ctx->id("FIFO36E1")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("FIFO36E1")].insert(ctx->id("WRCLK"));
-    invertible_pins[ctx->id("FIFO36E1")].insert(ctx->id("WREN"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("CLKRSVD0"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("CLKRSVD1"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("CPLLLOCKDETCLK"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("DMONITORCLK"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("DRPCLK"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("GTGREFCLK"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("RXUSRCLK2"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("RXUSRCLK"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("SIGVALIDCLK"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("TXPHDLYTSTCLK"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("TXUSRCLK2"));
-    invertible_pins[ctx->id("GTHE2_CHANNEL")].insert(ctx->id("TXUSRCLK"));
-    invertible_pins[ctx->id("GTHE2_COMMON")].insert(ctx->id("DRPCLK"));
-    invertible_pins[ctx->id("GTHE2_COMMON")].insert(ctx->id("GTGREFCLK"));
-    invertible_pins[ctx->id("GTHE2_COMMON")].insert(ctx->id("QPLLLOCKDETCLK"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("CLKRSVD0"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("CLKRSVD1"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("DMONITORCLK"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("DRPCLK"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("RXUSRCLK2"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("RXUSRCLK"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("SIGVALIDCLK"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("TXPHDLYTSTCLK"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("TXUSRCLK2"));
-    invertible_pins[ctx->id("GTPE2_CHANNEL")].insert(ctx->id("TXUSRCLK"));
-    invertible_pins[ctx->id("GTPE2_COMMON")].insert(ctx->id("DRPCLK"));
-    invertible_pins[ctx->id("GTPE2_COMMON")].insert(ctx->id("GTGREFCLK0"));
-    invertible_pins[ctx->id("GTPE2_COMMON")].insert(ctx->id("GTGREFCLK1"));
-    invertible_pins[ctx->id("GTPE2_COMMON")].insert(ctx->id("PLL0LOCKDETCLK"));
-    invertible_pins[ctx->id("GTPE2_COMMON")].insert(ctx->id("PLL1LOCKDETCLK"));
-    invertible_pins[ctx->id("GTXE2_CHANNEL")].insert(ctx->id("CPLLLOCKDETCLK"));
-    invertible_pins[ctx->id("GTXE2_CHANNEL")].insert(ctx->id("DRPCLK"));
-    invertible_pins[ctx->id("GTXE2_CHANNEL")].insert(ctx->id("GTGREFCLK"));
-    invertible_pins[ctx->id("GTXE2_CHANNEL")].insert(ctx->id("RXUSRCLK2"));
-    invertible_pins[ctx->id("GTXE2_CHANNEL")].insert(ctx->id("RXUSRCLK"));
-    invertible_pins[ctx->id("GTXE2_CHANNEL")].insert(ctx->id("TXPHDLYTSTCLK"));
-    invertible_pins[ctx->id("GTXE2_CHANNEL")].insert(ctx->id("TXUSRCLK2"));
-    invertible_pins[ctx->id("GTXE2_CHANNEL")].insert(ctx->id("TXUSRCLK"));
-    invertible_pins[ctx->id("GTXE2_COMMON")].insert(ctx->id("DRPCLK"));
-    invertible_pins[ctx->id("GTXE2_COMMON")].insert(ctx->id("GTGREFCLK"));
-    invertible_pins[ctx->id("GTXE2_COMMON")].insert(ctx->id("QPLLLOCKDETCLK"));
-    invertible_pins[ctx->id("IDDR")].insert(ctx->id("C"));
-    // invertible_pins[ctx->id("IDDR")].insert(ctx->id("D"));
-    invertible_pins[ctx->id("IDDR_2CLK")].insert(ctx->id("CB"));
-    invertible_pins[ctx->id("IDDR_2CLK")].insert(ctx->id("C"));
-    // invertible_pins[ctx->id("IDDR_2CLK")].insert(ctx->id("D"));
-    invertible_pins[ctx->id("IDELAYE2")].insert(ctx->id("C"));
-    // invertible_pins[ctx->id("IDELAYE2")].insert(ctx->id("DATAIN"));
-    invertible_pins[ctx->id("IDELAYE2")].insert(ctx->id("IDATAIN"));
-    invertible_pins[ctx->id("ISERDESE2")].insert(ctx->id("CLKB"));
-    invertible_pins[ctx->id("ISERDESE2")].insert(ctx->id("CLKDIVP"));
-    invertible_pins[ctx->id("ISERDESE2")].insert(ctx->id("CLKDIV"));
-    invertible_pins[ctx->id("ISERDESE2")].insert(ctx->id("CLK"));
-    // invertible_pins[ctx->id("ISERDESE2")].insert(ctx->id("D"));
-    invertible_pins[ctx->id("ISERDESE2")].insert(ctx->id("OCLKB"));
-    invertible_pins[ctx->id("ISERDESE2")].insert(ctx->id("OCLK"));
-    // invertible_pins[ctx->id("LDCE")].insert(ctx->id("CLR"));
-    invertible_pins[ctx->id("LDCE")].insert(ctx->id("G"));
-    invertible_pins[ctx->id("LDPE")].insert(ctx->id("G"));
-    // invertible_pins[ctx->id("LDPE")].insert(ctx->id("PRE"));
-    invertible_pins[ctx->id("MMCME2_ADV")].insert(ctx->id("CLKINSEL"));
-    invertible_pins[ctx->id("MMCME2_ADV")].insert(ctx->id("PSEN"));
-    invertible_pins[ctx->id("MMCME2_ADV")].insert(ctx->id("PSINCDEC"));
-    invertible_pins[ctx->id("MMCME2_ADV")].insert(ctx->id("PWRDWN"));
-    invertible_pins[ctx->id("MMCME2_ADV")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("ODDR")].insert(ctx->id("C"));
-    // invertible_pins[ctx->id("ODDR")].insert(ctx->id("D1"));
-    // invertible_pins[ctx->id("ODDR")].insert(ctx->id("D2"));
-    invertible_pins[ctx->id("ODELAYE2")].insert(ctx->id("C"));
-    // invertible_pins[ctx->id("ODELAYE2")].insert(ctx->id("ODATAIN"));
-    invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("CLKDIV"));
-    invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("CLK"));
-    // invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("D1"));
-    // invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("D2"));
-    // invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("D3"));
-    // invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("D4"));
-    // invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("D5"));
-    // invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("D6"));
-    // invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("D7"));
-    // invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("D8"));
-    invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("T1"));
-    invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("T2"));
-    invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("T3"));
-    invertible_pins[ctx->id("OSERDESE2")].insert(ctx->id("T4"));
-    invertible_pins[ctx->id("PHASER_IN")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("PHASER_IN_PHY")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("PHASER_OUT")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("PHASER_OUT_PHY")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("PHASER_REF")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("PHASER_REF")].insert(ctx->id("PWRDWN"));
-    invertible_pins[ctx->id("PLLE2_ADV")].insert(ctx->id("CLKINSEL"));
-    invertible_pins[ctx->id("PLLE2_ADV")].insert(ctx->id("PWRDWN"));
-    invertible_pins[ctx->id("PLLE2_ADV")].insert(ctx->id("RST"));
-    invertible_pins[ctx->id("XADC")].insert(ctx->id("CONVSTCLK"));
-    invertible_pins[ctx->id("XADC")].insert(ctx->id("DCLK"));
+    {"RAMB18E1", "CLKARDCLK", false},
+    {"RAMB18E1", "CLKBWRCLK", false},
+    {"RAMB18E1", "ENARDEN", false},
+    {"RAMB18E1", "ENBWREN", false},
+    {"RAMB18E1", "RSTRAMARSTRAM", false},
+    {"RAMB18E1", "RSTRAMB", false},
+    {"RAMB18E1", "RSTREGARSTREG", false},
+    {"RAMB18E1", "RSTREGB", false},
+    {"RAMB36E1", "CLKARDCLK", false},
+    {"RAMB36E1", "CLKBWRCLK", false},
+    {"RAMB36E1", "ENARDEN", false},
+    {"RAMB36E1", "ENBWREN", false},
+    {"RAMB36E1", "RSTRAMARSTRAM", false},
+    {"RAMB36E1", "RSTRAMB", false},
+    {"RAMB36E1", "RSTREGARSTREG", false},
+    {"RAMB36E1", "RSTREGB", false},
+    {"BUFMRCE", "CE", false},
+    {"DSP48E1", "ALUMODE[0]", false},
+    {"DSP48E1", "ALUMODE[1]", false},
+    {"DSP48E1", "ALUMODE[2]", false},
+    {"DSP48E1", "ALUMODE[3]", false},
+    {"DSP48E1", "CARRYIN", false},
+    // {"DSP48E1", "CLK", false},
+    {"DSP48E1", "INMODE[0]", false},
+    {"DSP48E1", "INMODE[1]", false},
+    {"DSP48E1", "INMODE[2]", false},
+    {"DSP48E1", "INMODE[3]", false},
+    {"DSP48E1", "INMODE[4]", false},
+    {"DSP48E1", "OPMODE[0]", false},
+    {"DSP48E1", "OPMODE[1]", false},
+    {"DSP48E1", "OPMODE[2]", false},
+    {"DSP48E1", "OPMODE[3]", false},
+    {"DSP48E1", "OPMODE[4]", false},
+    {"DSP48E1", "OPMODE[5]", false},
+    {"DSP48E1", "OPMODE[6]", false},
+    {"FIFO18E1", "RDCLK", false},
+    {"FIFO18E1", "RDEN", false},
+    {"FIFO18E1", "RSTREG", false},
+    {"FIFO18E1", "RST", false},
+    {"FIFO18E1", "WRCLK", false},
+    {"FIFO18E1", "WREN", false},
+    {"FIFO36E1", "RDCLK", false},
+    {"FIFO36E1", "RDEN", false},
+    {"FIFO36E1", "RSTREG", false},
+    {"FIFO36E1", "RST", false},
+    {"FIFO36E1", "WRCLK", false},
+    {"FIFO36E1", "WREN", false},
+    {"GTHE2_CHANNEL", "CLKRSVD0", false},
+    {"GTHE2_CHANNEL", "CLKRSVD1", false},
+    {"GTHE2_CHANNEL", "CPLLLOCKDETCLK", false},
+    {"GTHE2_CHANNEL", "DMONITORCLK", false},
+    {"GTHE2_CHANNEL", "DRPCLK", false},
+    {"GTHE2_CHANNEL", "GTGREFCLK", false},
+    {"GTHE2_CHANNEL", "RXUSRCLK2", false},
+    {"GTHE2_CHANNEL", "RXUSRCLK", false},
+    {"GTHE2_CHANNEL", "SIGVALIDCLK", false},
+    {"GTHE2_CHANNEL", "TXPHDLYTSTCLK", false},
+    {"GTHE2_CHANNEL", "TXUSRCLK2", false},
+    {"GTHE2_CHANNEL", "TXUSRCLK", false},
+    {"GTHE2_COMMON", "DRPCLK", false},
+    {"GTHE2_COMMON", "GTGREFCLK", false},
+    {"GTHE2_COMMON", "QPLLLOCKDETCLK", false},
+    {"GTPE2_CHANNEL", "CLKRSVD0", false},
+    {"GTPE2_CHANNEL", "CLKRSVD1", false},
+    {"GTPE2_CHANNEL", "DMONITORCLK", false},
+    {"GTPE2_CHANNEL", "DRPCLK", false},
+    {"GTPE2_CHANNEL", "RXUSRCLK2", false},
+    {"GTPE2_CHANNEL", "RXUSRCLK", false},
+    {"GTPE2_CHANNEL", "SIGVALIDCLK", false},
+    {"GTPE2_CHANNEL", "TXPHDLYTSTCLK", false},
+    {"GTPE2_CHANNEL", "TXUSRCLK2", false},
+    {"GTPE2_CHANNEL", "TXUSRCLK", false},
+    {"GTPE2_COMMON", "DRPCLK", false},
+    {"GTPE2_COMMON", "GTGREFCLK0", false},
+    {"GTPE2_COMMON", "GTGREFCLK1", false},
+    {"GTPE2_COMMON", "PLL0LOCKDETCLK", false},
+    {"GTPE2_COMMON", "PLL1LOCKDETCLK", false},
+    {"GTXE2_CHANNEL", "CPLLLOCKDETCLK", false},
+    {"GTXE2_CHANNEL", "DRPCLK", false},
+    {"GTXE2_CHANNEL", "GTGREFCLK", false},
+    {"GTXE2_CHANNEL", "RXUSRCLK2", false},
+    {"GTXE2_CHANNEL", "RXUSRCLK", false},
+    {"GTXE2_CHANNEL", "TXPHDLYTSTCLK", false},
+    {"GTXE2_CHANNEL", "TXUSRCLK2", false},
+    {"GTXE2_CHANNEL", "TXUSRCLK", false},
+    {"GTXE2_COMMON", "DRPCLK", false},
+    {"GTXE2_COMMON", "GTGREFCLK", false},
+    {"GTXE2_COMMON", "QPLLLOCKDETCLK", false},
+    {"IDDR", "C", false},
+    // {"IDDR", "D", false},
+    {"IDDR_2CLK", "CB", false},
+    {"IDDR_2CLK", "C", false},
+    // {"IDDR_2CLK", "D", false},
+    {"IDELAYE2", "C", false},
+    // {"IDELAYE2", "DATAIN", false},
+    {"IDELAYE2", "IDATAIN", false},
+    {"ISERDESE2", "CLKB", false},
+    {"ISERDESE2", "CLKDIVP", false},
+    {"ISERDESE2", "CLKDIV", false},
+    {"ISERDESE2", "CLK", false},
+    // {"ISERDESE2", "D", false},
+    {"ISERDESE2", "OCLKB", false},
+    {"ISERDESE2", "OCLK", false},
+    // {"LDCE", "CLR", false},
+    {"LDCE", "G", false},
+    {"LDPE", "G", false},
+    // {"LDPE", "PRE", false},
+    {"MMCME2_ADV", "CLKINSEL", false},
+    {"MMCME2_ADV", "PSEN", false},
+    {"MMCME2_ADV", "PSINCDEC", false},
+    {"MMCME2_ADV", "PWRDWN", false},
+    {"MMCME2_ADV", "RST", false},
+    {"ODDR", "C", false},
+    // {"ODDR", "D1", false},
+    // {"ODDR", "D2", false},
+    {"ODELAYE2", "C", false},
+    // {"ODELAYE2", "ODATAIN", false},
+    {"OSERDESE2", "CLKDIV", false},
+    {"OSERDESE2", "CLK", false},
+    // {"OSERDESE2", "D1", false},
+    // {"OSERDESE2", "D2", false},
+    // {"OSERDESE2", "D3", false},
+    // {"OSERDESE2", "D4", false},
+    // {"OSERDESE2", "D5", false},
+    // {"OSERDESE2", "D6", false},
+    // {"OSERDESE2", "D7", false},
+    // {"OSERDESE2", "D8", false},
+    {"OSERDESE2", "T1", false},
+    {"OSERDESE2", "T2", false},
+    {"OSERDESE2", "T3", false},
+    {"OSERDESE2", "T4", false},
+    {"PHASER_IN", "RST", false},
+    {"PHASER_IN_PHY", "RST", false},
+    {"PHASER_OUT", "RST", false},
+    {"PHASER_OUT_PHY", "RST", false},
+    {"PHASER_REF", "RST", false},
+    {"PHASER_REF", "PWRDWN", false},
+    {"PLLE2_ADV", "CLKINSEL", false},
+    {"PLLE2_ADV", "PWRDWN", false},
+    {"PLLE2_ADV", "RST", false},
+    {"XADC", "CONVSTCLK", false},
+    {"XADC", "DCLK", false},
+};
+
+// Pins that are to be directly connected to a top level IO pin (only), as (cell type, first pin, second pin or null)
+struct TopLevelPins
+{
+    const char *cell, *pin, *pin2;
+};
+
+const TopLevelPins top_level_pin_table[] = {
+    {"IBUF", "I", nullptr},
+    {"IBUF_ANALOG", "I", nullptr},
+    {"IBUF_IBUFDISABLE", "I", nullptr},
+    {"IBUF_INTERMDISABLE", "I", nullptr},
+    {"IBUFE3", "I", nullptr},
+
+    {"IBUFDS", "I", "IB"},
+    {"IBUFDS_DIFF_OUT", "I", "IB"},
+    {"IBUFDS_DIFF_OUT_IBUFDISABLE", "I", "IB"},
+    {"IBUFDS_DIFF_OUT_INTERMDISABLE", "I", "IB"},
+    {"IBUFDS_GTE3", "I", "IB"},
+    {"IBUFDS_GTE4", "I", "IB"},
+    {"IBUFDS_INTERMDISABLE", "I", "IB"},
+    {"IBUFDSE3", "I", "IB"},
+
+    {"IOBUF", "IO", nullptr},
+    {"IOBUF_DCIEN", "IO", nullptr},
+    {"IOBUF_INTERMDISABLE", "IO", nullptr},
+    {"IOBUFE3", "IO", nullptr},
+
+    {"IOBUFDS", "IO", "IOB"},
+    {"IOBUFDS_DCIEN", "IO", "IOB"},
+    {"IOBUFDS_DIFF_OUT", "IO", "IOB"},
+    {"IOBUFDS_DIFF_OUT_DCIEN", "IO", "IOB"},
+    {"IOBUFDS_DIFF_OUT_INTERMDISABLE", "IO", "IOB"},
+    {"IOBUFDSE3", "IO", "IOB"},
+
+    {"OBUF", "O", nullptr},
+    {"OBUFT", "O", nullptr},
+
+    {"OBUFDS", "O", "OB"},
+    {"OBUFDS_GTE3", "O", "OB"},
+    {"OBUFDS_GTE3_ADV", "O", "OB"},
+    {"OBUFDS_GTE4", "O", "OB"},
+    {"OBUFDS_GTE4_ADV", "O", "OB"},
+    {"OBUFTDS", "O", "OB"},
+};
+} // namespace
+
+void get_invertible_pins(Context *ctx, std::unordered_map<IdString, std::unordered_set<IdString>> &invertible_pins)
+{
+    for (auto &entry : invertible_pin_table)
+        if (!(entry.xcup_only && ctx->xc7))
+            invertible_pins[ctx->id(entry.cell)].insert(ctx->id(entry.pin));
 }
 
 void get_tied_pins(Context *ctx, std::unordered_map<IdString, std::unordered_map<IdString, bool>> &tied_pins)
@@ -663,42 +717,12 @@ void get_bram36_ul_pins(Context *ctx, std::vector<std::pair<IdString, std::vecto
 // Gets a list of pins that are to be directly connected to a top level IO pin (only)
 void get_top_level_pins(Context *ctx, std::unordered_map<IdString, std::unordered_set<IdString>> &toplevel_pins)
 {
-    toplevel_pins[ctx->id("IBUF")] = {ctx->id("I")};
-    toplevel_pins[ctx->id("IBUF_ANALOG")] = {ctx->id("I")};
-    toplevel_pins[ctx->id("IBUF_IBUFDISABLE")] = {ctx->id("I")};
-    toplevel_pins[ctx->id("IBUF_INTERMDISABLE")] = {ctx->id("I")};
-    toplevel_pins[ctx->id("IBUFE3")] = {ctx->id("I")};
-
-    toplevel_pins[ctx->id("IBUFDS")] = {ctx->id("I"), ctx->id("IB")};
-    toplevel_pins[ctx->id("IBUFDS_DIFF_OUT")] = {ctx->id("I"), ctx->id("IB")};
-    toplevel_pins[ctx->id("IBUFDS_DIFF_OUT_IBUFDISABLE")] = {ctx->id("I"), ctx->id("IB")};
-    toplevel_pins[ctx->id("IBUFDS_DIFF_OUT_INTERMDISABLE")] = {ctx->id("I"), ctx->id("IB")};
-    toplevel_pins[ctx->id("IBUFDS_GTE3")] = {ctx->id("I"), ctx->id("IB")};
-    toplevel_pins[ctx->id("IBUFDS_GTE4")] = {ctx->id("I"), ctx->id("IB")};
-    toplevel_pins[ctx->id("IBUFDS_INTERMDISABLE")] = {ctx->id("I"), ctx->id("IB")};
-    toplevel_pins[ctx->id("IBUFDSE3")] = {ctx->id("I"), ctx->id("IB")};
-
-    toplevel_pins[ctx->id("IOBUF")] = {ctx->id("IO")};
-    toplevel_pins[ctx->id("IOBUF_DCIEN")] = {ctx->id("IO")};
-    toplevel_pins[ctx->id("IOBUF_INTERMDISABLE")] = {ctx->id("IO")};
-    toplevel_pins[ctx->id("IOBUFE3")] = {ctx->id("IO")};
-
-    toplevel_pins[ctx->id("IOBUFDS")] = {ctx->id("IO"), ctx->id("IOB")};
-    toplevel_pins[ctx->id("IOBUFDS_DCIEN")] = {ctx->id("IO"), ctx->id("IOB")};
-    toplevel_pins[ctx->id("IOBUFDS_DIFF_OUT")] = {ctx->id("IO"), ctx->id("IOB")};
-    toplevel_pins[ctx->id("IOBUFDS_DIFF_OUT_DCIEN")] = {ctx->id("IO"), ctx->id("IOB")};
-    toplevel_pins[ctx->id("IOBUFDS_DIFF_OUT_INTERMDISABLE")] = {ctx->id("IO"), ctx->id("IOB")};
-    toplevel_pins[ctx->id("IOBUFDSE3")] = {ctx->id("IO"), ctx->id("IOB")};
-
-    toplevel_pins[ctx->id("OBUF")] = {ctx->id("O")};
-    toplevel_pins[ctx->id("OBUFT")] = {ctx->id("O")};
-
-    toplevel_pins[ctx->id("OBUFDS")] = {ctx->id("O"), ctx->id("OB")};
-    toplevel_pins[ctx->id("OBUFDS_GTE3")] = {ctx->id("O"), ctx->id("OB")};
-    toplevel_pins[ctx->id("OBUFDS_GTE3_ADV")] = {ctx->id("O"), ctx->id("OB")};
-    toplevel_pins[ctx->id("OBUFDS_GTE4")] = {ctx->id("O"), ctx->id("OB")};
-    toplevel_pins[ctx->id("OBUFDS_GTE4_ADV")] = {ctx->id("O"), ctx->id("OB")};
-    toplevel_pins[ctx->id("OBUFTDS")] = {ctx->id("O"), ctx->id("OB")};
+    for (auto &entry : top_level_pin_table) {
+        auto &pins = toplevel_pins[ctx->id(entry.cell)];
+        pins.insert(ctx->id(entry.pin));
+        if (entry.pin2 != nullptr)
+            pins.insert(ctx->id(entry.pin2));
+    }
 }
 
-NEXTPNR_NAMESPACE_END
\ No newline at end of file
+NEXTPNR_NAMESPACE_END
@@ -25,3 +25,76 @@ class BBAWriter:
 		print("u32 {} {}".format(int(n), comment), file=self.f)
 	def pop(self):
 		print("pop", file=self.f)
+	def finish(self):
+		pass
+
+# Binary encoding of the same commands, read directly by bbasm without tokenising text. Label
+# names are only written once, the first time they are used; values are LEB128 varints.
+# Comments are dropped, use the text format for debug (bbasm -d) output.
+BINARY_MAGIC = b"BBABIN01"
+OP_PRE, OP_POST, OP_PUSH, OP_POP, OP_OFFSET32, OP_LABEL_NAME, OP_LABEL, OP_REF, OP_U8, OP_U16, OP_U32, OP_ALIGN, OP_STR, OP_END = range(1, 15)
+
+class BinaryBBAWriter:
+	def __init__(self, f):
+		self.f = f
+		self.buf = bytearray(BINARY_MAGIC)
+		self.labels = {}
+	def _varint(self, n):
+		n &= 0xFFFFFFFF
+		while n >= 0x80:
+			self.buf.append((n & 0x7F) | 0x80)
+			n >>= 7
+		self.buf.append(n)
+	def _bytes(self, s):
+		b = s.encode()
+		self._varint(len(b))
+		self.buf += b
+	def _op(self, op):
+		if len(self.buf) >= (1 << 20):
+			self.f.write(self.buf)
+			self.buf = bytearray()
+		self.buf.append(op)
+	def _labelref(self, op, name):
+		idx = self.labels.get(name)
+		if idx is None:
+			idx = len(self.labels)
+			self.labels[name] = idx
+			self._op(OP_LABEL_NAME)
+			self._bytes(name)
+		self._op(op)
+		self._varint(idx)
+	def pre(self, s):
+		self._op(OP_PRE)
+		self._bytes(s)
+	def post(self, s):
+		self._op(OP_POST)
+		self._bytes(s)
+	def push(self, s):
+		self._op(OP_PUSH)
+		self._bytes(s)
+	def offset32(self):
+		self._op(OP_OFFSET32)
+	def ref(self, r, comment=""):
+		self._labelref(OP_REF, r)
+	def str(self, s, comment=""):
+		self._op(OP_STR)
+		self._bytes(s)
+	def align(self):
+		self._op(OP_ALIGN)
+	def label(self, s):
+		self._labelref(OP_LABEL, s)
+	def u8(self, n, comment=""):
+		self._op(OP_U8)
+		self._varint(int(n))
+	def u16(self, n, comment=""):
+		self._op(OP_U16)
+		self._varint(int(n))
+	def u32(self, n, comment=""):
+		self._op(OP_U32)
+		self._varint(int(n))
+	def pop(self):
+		self._op(OP_POP)
+	def finish(self):
+		self._op(OP_END)
+		self.f.write(self.buf)
+		self.buf = bytearray()
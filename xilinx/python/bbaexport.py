@@ -1,34 +1,44 @@
 from xilinx_device import *
-from bba import BBAWriter
+from bba import BBAWriter, BinaryBBAWriter
 import sys, argparse
 import bels, constid
 from nextpnr_structs import *
 import os
 
-def main():
+def family_roots(device, xraydb_root, metadata_root):
+	# The database paths given are for Artix-7; other 7-series families live alongside
+	if "xc7z" in device:
+		metadata_root = metadata_root.replace("artix7", "zynq7")
+		xraydb_root = xraydb_root.replace("artix7", "zynq7")
+	if "xc7k" in device:
+		metadata_root = metadata_root.replace("artix7", "kintex7")
+		xraydb_root = xraydb_root.replace("artix7", "kintex7")
+	return xraydb_root, metadata_root
 
+def make_parser():
 	rwbase = os.path.join(os.path.dirname(os.path.realpath(__file__)), "..")
-
 	parser = argparse.ArgumentParser()
 	parser.add_argument("--xray", help="Project X-Ray device database path for current family (e.g. ../prjxray-db/artix7)", type=str, default=os.path.join(rwbase, "external", "prjxray-db", "artix7"))
 	parser.add_argument("--metadata", help="nextpnr-xilinx site metadata root", type=str, default=os.path.join(rwbase, "external", "nextpnr-xilinx-meta", "artix7"))
-	parser.add_argument("--device", help="name of device to export", type=str, required=True)
 	parser.add_argument("--constids", help="name of nextpnr constids file to read", type=str, default=os.path.join(rwbase, "constids.inc"))
+	parser.add_argument("--binary", help="write the binary bba encoding instead of text (much smaller and faster to assemble)", action="store_true")
+	parser.add_argument("--compress-nodes", help="share tile wire lists between nodes of the same shape (much smaller chipdb)", action="store_true")
+	return parser
+
+def main():
+	parser = make_parser()
+	parser.add_argument("--device", help="name of device to export", type=str, required=True)
 	parser.add_argument("--bba", help="bba file to write", type=str, required=True)
 	args = parser.parse_args()
+	export_device(args.device, args.xray, args.metadata, args.constids, args.bba, args.binary, args.compress_nodes)
+
+def export_device(device, xray, metadata, constids, bba_path, binary=False, compress_nodes=False):
 	# Read baked-in constids
-	with open(args.constids, "r") as cf:
+	with open(constids, "r") as cf:
 		constid.read_base(cf)
 	# Read and parse X-ray database
-	metadata_root = args.metadata
-	xraydb_root = args.xray
-	if "xc7z" in args.device:
-		metadata_root = metadata_root.replace("artix7", "zynq7")
-		xraydb_root = xraydb_root.replace("artix7", "zynq7")
-	if "xc7k" in args.device:
-		metadata_root = metadata_root.replace("artix7", "kintex7")
-		xraydb_root = xraydb_root.replace("artix7", "kintex7")
-	d = import_device(args.device, xraydb_root, metadata_root)
+	xraydb_root, metadata_root = family_roots(device, xray, metadata)
+	d = import_device(device, xraydb_root, metadata_root)
 	# Import tile types
 	seen_tiletypes = set()
 	tile_types = []
@@ -60,8 +70,8 @@ def main():
 			tile_insts.append(nti)
 
 	# Begin writing bba
-	with open(args.bba, "w") as bbaf:
-		bba = BBAWriter(bbaf)
+	with open(bba_path, "wb" if binary else "w") as bbaf:
+		bba = BinaryBBAWriter(bbaf) if binary else BBAWriter(bbaf)
 		bba.pre('#include "nextpnr.h"')
 		bba.pre('NEXTPNR_NAMESPACE_BEGIN')
 		bba.post('NEXTPNR_NAMESPACE_END')
@@ -162,6 +172,34 @@ def main():
 		total = len(d.tiles)
 		node_wire_count = []
 		node_intent = []
+		node_tw_label = []
+		node_origin = []
+		shape_labels = {}
+		def add_node(wires, intent):
+			# wires is the list of (tile index, wire index in tile) in the node
+			node = len(node_wire_count)
+			for tileidx, wire_idx in wires:
+				tile_insts[tileidx].tilewire_to_node[wire_idx] = node
+			if compress_nodes:
+				# Share the tile wire list between all nodes with the same shape relative to their first tile
+				origin = wires[0][0]
+				shape = tuple((tileidx - origin, wire_idx) for tileidx, wire_idx in wires)
+				if shape not in shape_labels:
+					shape_labels[shape] = "ns{}".format(len(shape_labels))
+					bba.label(shape_labels[shape])
+					for dtile, wire_idx in shape:
+						bba.u32(dtile) # tile index relative to node origin
+						bba.u32(wire_idx) # wire index in tile
+				node_tw_label.append(shape_labels[shape])
+				node_origin.append(origin)
+			else:
+				node_tw_label.append("n{}_tw".format(node))
+				bba.label(node_tw_label[-1])
+				for tileidx, wire_idx in wires:
+					bba.u32(tileidx) # tile index
+					bba.u32(wire_idx) # wire index in tile
+			node_intent.append(intent)
+			node_wire_count.append(len(wires))
 		for row in range(d.height):
 			gnd_nodes = []
 			vcc_nodes = []
@@ -190,53 +228,35 @@ def main():
 					# an explicit data structure wasting memory
 					if len(n.wires) > 1:
 						# List of tile wires in node
-						bba.label("n{}_tw".format(len(node_wire_count)))
+						node_wires = []
 						# Add interconnect tiles first for better delay estimates in nextpnr
 						for j in range(2):
 							for w in n.wires:
 								if (w.tile.tile_type() in ("INT", "INT_L", "INT_R")) != (j == 0):
 									continue
-								tileidx = w.tile.y * d.width + w.tile.x
-								bba.u32(tileidx) # tile index
-								bba.u32(w.index) # wire index in tile
-								tile_insts[tileidx].tilewire_to_node[w.index] = len(node_wire_count)
-						node_intent.append(constid.make(n.wires[0].intent()))
-						node_wire_count.append(len(n.wires))
+								node_wires.append((w.tile.y * d.width + w.tile.x, w.index))
+						add_node(node_wires, constid.make(n.wires[0].intent()))
 			# Connect up row and column ground nodes
 			for i in range(2):
-				wire_count = 0
-				bba.label("n{}_tw".format(len(node_wire_count)))
+				node_wires = []
 				for n in (vcc_nodes if i == 1 else gnd_nodes):
 					for w in n.wires:
-						tileidx = w.tile.y * d.width + w.tile.x
-						bba.u32(tileidx) # tile index
-						bba.u32(w.index) # wire index in tile
-						tile_insts[tileidx].tilewire_to_node[w.index] = len(node_wire_count)
-						wire_count += 1
+						node_wires.append((w.tile.y * d.width + w.tile.x, w.index))
 				for col in range(d.width):
-					t = d.tiles_by_xy[col, row]
 					tileidx = row * d.width + col
-					bba.u32(tileidx)
 					wire_idx = tile_types[tile_insts[tileidx].tile_type].row_vcc_wire_index if i == 1 else tile_types[tile_insts[tileidx].tile_type].row_gnd_wire_index
-					bba.u32(wire_idx)
-					tile_insts[tileidx].tilewire_to_node[wire_idx] = len(node_wire_count)
-					wire_count += 1
-				node_wire_count.append(wire_count)
-				node_intent.append(constid.make("PSEUDO_VCC" if i == 1 else "PSEUDO_GND"))
+					node_wires.append((tileidx, wire_idx))
+				add_node(node_wires, constid.make("PSEUDO_VCC" if i == 1 else "PSEUDO_GND"))
 		# Create the global Vcc and Ground nodes
 		for i in range(2):
-			wire_count = 0
-			bba.label("n{}_tw".format(len(node_wire_count)))
+			node_wires = []
 			for row in range(d.height):
-				t = d.tiles_by_xy[0, row]
 				tileidx = row * d.width
-				bba.u32(tileidx)
 				wire_idx = tile_types[tile_insts[tileidx].tile_type].global_vcc_wire_index if i == 1 else tile_types[tile_insts[tileidx].tile_type].global_gnd_wire_index
-				bba.u32(wire_idx)
-				tile_insts[tileidx].tilewire_to_node[wire_idx] = len(node_wire_count)
-				wire_count += 1
-			node_wire_count.append(wire_count)
-			node_intent.append(constid.make("PSEUDO_VCC" if i == 1 else "PSEUDO_GND"))
+				node_wires.append((tileidx, wire_idx))
+			add_node(node_wires, constid.make("PSEUDO_VCC" if i == 1 else "PSEUDO_GND"))
+		if compress_nodes:
+			print("    {} nodes share {} tile wire lists".format(len(node_wire_count), len(shape_labels)))
 		print("Exporting tile and site instances...")
 		for ti in tile_insts:
 			# Mapping from tile wire to node index
@@ -268,7 +288,11 @@ def main():
 		for i in range(len(node_wire_count)):
 			bba.u32(node_wire_count[i]) # number of tile wires in node
 			bba.u32(node_intent[i]) # intent code constid of node
-			bba.ref("n{}_tw".format(i)) # reference to list of tile wires in node, created earlier
+			bba.ref(node_tw_label[i]) # reference to list of tile wires in node, created earlier
+		if compress_nodes:
+			bba.label("node_origins")
+			for origin in node_origin:
+				bba.u32(origin) # tile index added to the node's shared tile wire list
 		# Wire timing classes
 		bba.label("wire_timing_classes")
 		for wc, i in sorted(timing.wire_classes.items(), key=lambda e: e[1]):
@@ -329,11 +353,25 @@ def main():
 		bba.ref("tile_cell_timing") # ref to list of cell timing tile types
 		bba.ref("wire_timing_classes") # ref to wire class data list
 		bba.ref("pip_timing_classes") # ref to pip class data list
+		# Name indices, sorted by the UTF-8 bytes of the name to match strcmp
+		bba.label("tiles_by_name")
+		for ti in sorted(tile_insts, key=lambda t: t.name.encode()):
+			bba.u32(ti.index) # tile index
+		site_refs = [(si, ti.index, j) for ti in tile_insts for j, si in enumerate(ti.sites)]
+		bba.label("sites_by_name")
+		for si, t, j in sorted(site_refs, key=lambda r: r[0].name.encode()):
+			bba.u32(t) # tile index
+			bba.u32(j) # site index in tile
+		pin_refs = [r for r in site_refs if r[0].package_pin not in (".", "")]
+		bba.label("sites_by_package_pin")
+		for si, t, j in sorted(pin_refs, key=lambda r: r[0].package_pin.encode()):
+			bba.u32(t) # tile index
+			bba.u32(j) # site index in tile
 		# Main chip info structure
 		bba.label("chip_info")
 		bba.str(d.name) # device name char*
 		bba.str("prjxray") # generator name char*
-		bba.u32(1) # version
+		bba.u32(3) # version
 		bba.u32(d.width) # tile grid width
 		bba.u32(d.height) # tile grid height
 		bba.u32(len(tile_insts)) # number of tiles
@@ -345,6 +383,17 @@ def main():
 		bba.ref("extra_constids") # reference to list of constid strings (extra to baked-in ones)
 		bba.u32(1) # only one speed grade currently
 		bba.ref("timing") # timing data
+		if compress_nodes:
+			bba.ref("node_origins") # reference to list of node origin tiles
+		else:
+			bba.u32(0) # no node origin list
+		bba.u32(1 if compress_nodes else 0) # flags (1: node origin list present)
+		bba.ref("tiles_by_name") # reference to tile indices sorted by name
+		bba.u32(len(site_refs)) # number of sites
+		bba.ref("sites_by_name") # reference to sites sorted by name
+		bba.u32(len(pin_refs)) # number of package pins
+		bba.ref("sites_by_package_pin") # reference to sites sorted by package pin
 		bba.pop()
+		bba.finish()
 if __name__ == '__main__':
 	main()
@@ -0,0 +1,92 @@
+import bbaexport
+import hashlib, json, multiprocessing, os, sys, traceback
+
+# Export several devices in parallel worker processes, skipping any device whose
+# inputs are unchanged since its .bba was last written. Each export runs in a
+# fresh process, as constid and timing class numbering is global to the exporter.
+
+def input_files(device, xraydb_root, metadata_root):
+	# All files that import_device (and hence the exporter) may read for this device
+	fabricname = device.split('t')[0] + "t"
+	tilegrid = os.path.join(xraydb_root, fabricname, "tilegrid.json")
+	with open(tilegrid, "r") as gf:
+		tgj = json.load(gf)
+	tile_types = set()
+	site_types = set()
+	for tiledata in tgj.values():
+		tile_types.add(tiledata["type"])
+		site_types.update(tiledata["sites"].values())
+	files = [tilegrid,
+		os.path.join(xraydb_root, fabricname, "tileconn.json"),
+		os.path.join(xraydb_root, device, "package_pins.csv"),
+		os.path.join(metadata_root, "wire_intents.json")]
+	for tt in sorted(tile_types):
+		files.append(os.path.join(xraydb_root, "tile_type_" + tt + ".json"))
+		files.append(os.path.join(xraydb_root, "timings", tt + ".sdf"))
+	for st in sorted(site_types):
+		files.append(os.path.join(metadata_root, "site_type_" + st + ".json"))
+	return files
+
+def input_hash(device, xray, metadata, constids, options):
+	xraydb_root, metadata_root = bbaexport.family_roots(device, xray, metadata)
+	h = hashlib.sha256()
+	h.update(device.encode())
+	h.update(options.encode())
+	srcdir = os.path.dirname(os.path.realpath(__file__))
+	sources = [os.path.join(srcdir, f) for f in sorted(os.listdir(srcdir)) if f.endswith(".py")]
+	for fn in [constids] + sources + input_files(device, xraydb_root, metadata_root):
+		h.update(b"\0" + os.path.basename(fn).encode() + b"\0")
+		if not os.path.exists(fn):
+			h.update(b"missing")
+			continue
+		with open(fn, "rb") as f:
+			for chunk in iter(lambda: f.read(1 << 20), b""):
+				h.update(chunk)
+	return h.hexdigest()
+
+def run_export(job):
+	device, xray, metadata, constids, bba_path, binary, compress_nodes, digest = job
+	try:
+		bbaexport.export_device(device, xray, metadata, constids, bba_path + ".tmp", binary, compress_nodes)
+		os.replace(bba_path + ".tmp", bba_path)
+		with open(bba_path + ".hash", "w") as hf:
+			print(digest, file=hf)
+		return device, None
+	except Exception:
+		return device, traceback.format_exc()
+
+def main():
+	parser = bbaexport.make_parser()
+	parser.add_argument("--devices", help="names of devices to export", type=str, nargs="+", required=True)
+	parser.add_argument("--out-dir", help="directory to write <device>.bba (or .bbab with --binary) files to", type=str, required=True)
+	parser.add_argument("--jobs", help="number of parallel export processes", type=int, default=multiprocessing.cpu_count())
+	parser.add_argument("--force", help="re-export even if inputs are unchanged", action="store_true")
+	args = parser.parse_args()
+	os.makedirs(args.out_dir, exist_ok=True)
+
+	jobs = []
+	for device in args.devices:
+		bba_path = os.path.join(args.out_dir, device + (".bbab" if args.binary else ".bba"))
+		options = "binary={} compress_nodes={}".format(args.binary, args.compress_nodes)
+		digest = input_hash(device, args.xray, args.metadata, args.constids, options)
+		if not args.force and os.path.exists(bba_path) and os.path.exists(bba_path + ".hash"):
+			with open(bba_path + ".hash", "r") as hf:
+				if hf.read().strip() == digest:
+					print("{}: up to date".format(device))
+					continue
+		jobs.append((device, args.xray, args.metadata, args.constids, bba_path, args.binary, args.compress_nodes, digest))
+
+	failed = False
+	if len(jobs) > 0:
+		# maxtasksperchild=1 so every export starts from empty constid/timing tables
+		with multiprocessing.Pool(processes=max(1, min(args.jobs, len(jobs))), maxtasksperchild=1) as pool:
+			for device, err in pool.imap_unordered(run_export, jobs):
+				if err is None:
+					print("{}: exported".format(device))
+				else:
+					print("{}: export failed\n{}".format(device, err), file=sys.stderr)
+					failed = True
+	sys.exit(1 if failed else 0)
+
+if __name__ == '__main__':
+	main()
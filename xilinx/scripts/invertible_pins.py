@@ -25,7 +25,7 @@ for filename in sys.argv[1:]:
                 else:
                     params = ["%s[%d]" % (pname, i) for i in range(ubound + 1)]
                 for p in params:
-                    print('        invertible_pins[ctx->id("%s")].insert(ctx->id("%s"));' % (modname, p))
+                    print('    {"%s", "%s", false},' % (modname, p))
 
             im2 = invparam_2_re.match(line)
             if im2:
@@ -34,4 +34,4 @@ for filename in sys.argv[1:]:
                     continue # IS_D_INVERTED isn't heavily used
                 params = [pname]
                 for p in params:
-                    print('        invertible_pins[ctx->id("%s")].insert(ctx->id("%s"));' % (modname, p))
\ No newline at end of file
+                    print('    {"%s", "%s", false},' % (modname, p))
\ No newline at end of file
@@ -17,10 +17,220 @@
  *
  */
 
+#include <algorithm>
+#include <regex>
 #include "log.h"
 #include "nextpnr.h"
 NEXTPNR_NAMESPACE_BEGIN
 
+namespace {
+
+// Match a string against a glob pattern as Vivado does for object names: '*' matches any sequence (including
+// hierarchy separators), '?' any one character and '\' escapes the next one. Brackets are literal, as they are
+// used for bus indices
+bool glob_match(const char *pat, const char *str)
+{
+    const char *star_pat = nullptr, *star_str = nullptr;
+    while (*str != '\0') {
+        if (*pat == '*') {
+            star_pat = ++pat;
+            star_str = str;
+            continue;
+        }
+        bool matched = false;
+        const char *next_pat = pat;
+        if (*pat == '?') {
+            matched = true;
+            next_pat = pat + 1;
+        } else {
+            if (*pat == '\\' && pat[1] != '\0')
+                ++pat;
+            matched = (*pat != '\0' && *pat == *str);
+            next_pat = pat + 1;
+        }
+        if (matched) {
+            pat = next_pat;
+            ++str;
+        } else if (star_pat != nullptr) {
+            pat = star_pat;
+            str = ++star_str;
+        } else {
+            return false;
+        }
+    }
+    while (*pat == '*')
+        ++pat;
+    return *pat == '\0';
+}
+
+// The part of a glob pattern before its first special character, with escapes removed. exact is set if the
+// pattern has no special characters at all
+std::string glob_prefix(const std::string &pat, bool &exact)
+{
+    std::string prefix;
+    for (size_t i = 0; i < pat.size(); i++) {
+        char c = pat.at(i);
+        if (c == '*' || c == '?') {
+            exact = false;
+            return prefix;
+        }
+        if (c == '\\' && i + 1 < pat.size())
+            c = pat.at(++i);
+        prefix += c;
+    }
+    exact = true;
+    return prefix;
+}
+
+std::string to_lower(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+enum XdcObjectKind
+{
+    XDC_PORT,
+    XDC_CELL,
+    XDC_NET,
+    XDC_PIN,
+    XDC_KIND_COUNT
+};
+
+const char *xdc_kind_names[XDC_KIND_COUNT] = {"ports", "cells", "nets", "pins"};
+
+// The result of an object query: indices into the object table of one kind, in name order
+struct XdcObjects
+{
+    XdcObjectKind kind;
+    std::vector<int> ids;
+};
+
+// Tables of the design objects that XDC queries can return, with the names of each kind sorted so that patterns
+// with a literal prefix only visit the names starting with it. Tables are built the first time a kind is queried.
+// For -hierarchical queries, every name is also indexed from the start of each level of hierarchy in it.
+struct XdcObjectIndex
+{
+    Context *ctx;
+    // Cells of the top-level ports
+    std::vector<CellInfo *> ports;
+    std::vector<CellInfo *> cells;
+    std::vector<NetInfo *> nets;
+    std::vector<std::pair<CellInfo *, IdString>> pins;
+
+    struct NameTable
+    {
+        bool built = false, hier_built = false;
+        std::vector<std::string> names;
+        // (name, object) sorted by name
+        std::vector<std::pair<std::string, int>> by_name;
+        // (name from a level of hierarchy down, object) sorted by name
+        std::vector<std::pair<std::string, int>> by_hier_name;
+    };
+    NameTable tables[XDC_KIND_COUNT];
+
+    explicit XdcObjectIndex(Context *ctx) : ctx(ctx) {}
+
+    static bool is_port_cell(Context *ctx, const CellInfo *ci)
+    {
+        return ci->type == ctx->id("$nextpnr_ibuf") || ci->type == ctx->id("$nextpnr_obuf") ||
+               ci->type == ctx->id("$nextpnr_iobuf");
+    }
+
+    NameTable &get_table(XdcObjectKind kind)
+    {
+        NameTable &t = tables[kind];
+        if (t.built)
+            return t;
+        switch (kind) {
+        case XDC_PORT:
+        case XDC_CELL:
+            for (auto &cell : ctx->cells) {
+                if (is_port_cell(ctx, cell.second.get()) != (kind == XDC_PORT))
+                    continue;
+                (kind == XDC_PORT ? ports : cells).push_back(cell.second.get());
+                t.names.push_back(cell.first.str(ctx));
+            }
+            break;
+        case XDC_NET:
+            for (auto &net : ctx->nets) {
+                nets.push_back(net.second.get());
+                t.names.push_back(net.first.str(ctx));
+            }
+            break;
+        case XDC_PIN:
+            for (auto &cell : ctx->cells) {
+                if (is_port_cell(ctx, cell.second.get()))
+                    continue;
+                for (auto &port : cell.second->ports) {
+                    pins.emplace_back(cell.second.get(), port.first);
+                    t.names.push_back(cell.first.str(ctx) + "/" + port.first.str(ctx));
+                }
+            }
+            break;
+        default:
+            NPNR_ASSERT_FALSE("invalid object kind");
+        }
+        t.by_name.reserve(t.names.size());
+        for (int i = 0; i < int(t.names.size()); i++)
+            t.by_name.emplace_back(t.names.at(i), i);
+        std::sort(t.by_name.begin(), t.by_name.end());
+        t.built = true;
+        return t;
+    }
+
+    const std::vector<std::pair<std::string, int>> &get_hier_names(XdcObjectKind kind)
+    {
+        NameTable &t = get_table(kind);
+        if (!t.hier_built) {
+            for (int i = 0; i < int(t.names.size()); i++) {
+                const std::string &name = t.names.at(i);
+                // For pins, the hierarchy is that of the cell
+                size_t end = (kind == XDC_PIN) ? name.rfind('/') : name.size();
+                t.by_hier_name.emplace_back(name, i);
+                for (size_t pos = 0; pos < end; pos++)
+                    if (name.at(pos) == '/' || name.at(pos) == '.')
+                        t.by_hier_name.emplace_back(name.substr(pos + 1), i);
+            }
+            std::sort(t.by_hier_name.begin(), t.by_hier_name.end());
+            t.hier_built = true;
+        }
+        return t.by_hier_name;
+    }
+
+    // Find the objects of a kind with a name matching a pattern; results are appended to ids
+    void match(XdcObjectKind kind, const std::string &pattern, bool hier, bool regexp, bool nocase,
+               std::vector<int> &ids)
+    {
+        const auto &names = hier ? get_hier_names(kind) : get_table(kind).by_name;
+        if (regexp) {
+            std::regex re(pattern, nocase ? (std::regex::ECMAScript | std::regex::icase) : std::regex::ECMAScript);
+            for (auto &entry : names)
+                if (std::regex_match(entry.first, re))
+                    ids.push_back(entry.second);
+        } else if (nocase) {
+            std::string lower_pat = to_lower(pattern);
+            for (auto &entry : names)
+                if (glob_match(lower_pat.c_str(), to_lower(entry.first).c_str()))
+                    ids.push_back(entry.second);
+        } else {
+            bool exact;
+            std::string prefix = glob_prefix(pattern, exact);
+            auto begin = std::lower_bound(names.begin(), names.end(), std::make_pair(prefix, -1));
+            for (auto it = begin; it != names.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+                if (exact ? (it->first == prefix) : glob_match(pattern.c_str(), it->first.c_str()))
+                    ids.push_back(it->second);
+                else if (exact)
+                    break;
+            }
+        }
+    }
+
+    std::string name_of(XdcObjectKind kind, int id) { return get_table(kind).names.at(id); }
+};
+
+} // namespace
+
 void Arch::parseXdc(std::istream &in)
 {
 
@@ -76,42 +286,143 @@ void Arch::parseXdc(std::istream &in)
         return split_args;
     };
 
-    auto get_cells = [&](std::string str) {
-        std::vector<CellInfo *> tgt_cells;
-        if (str.empty() || str.front() != '[')
-            log_error("failed to parse target (on line %d)\n", lineno);
-        str = str.substr(1, str.size() - 2);
-        auto split = split_to_args(str, false);
+    XdcObjectIndex index(getCtx());
+    // Results of queries by their text, as the same query is often repeated across lines
+    std::unordered_map<std::string, XdcObjects> query_cache;
+    int empty_queries = 0;
+
+    // Evaluate an object query, '[get_<kind> <options> <patterns>]'
+    std::function<XdcObjects(const std::string &)> query = [&](const std::string &str) {
+        if (str.size() < 2 || str.front() != '[' || str.back() != ']')
+            log_error("failed to parse target '%s' (on line %d)\n", str.c_str(), lineno);
+        auto cached = query_cache.find(str);
+        if (cached != query_cache.end())
+            return cached->second;
+        auto split = split_to_args(str.substr(1, str.size() - 2), true);
         if (split.size() < 1)
             log_error("failed to parse target (on line %d)\n", lineno);
-        if (split.front() != "get_ports")
-            log_error("targets other than 'get_ports' are not supported (on line %d)\n", lineno);
-        if (split.size() < 2)
-            log_error("failed to parse target (on line %d)\n", lineno);
-        IdString cellname = id(strip_quotes(split.at(1)));
-        if (cells.count(cellname))
-            tgt_cells.push_back(cells.at(cellname).get());
-        return tgt_cells;
+        XdcObjects result;
+        const std::string &cmd = split.front();
+        if (cmd == "get_ports")
+            result.kind = XDC_PORT;
+        else if (cmd == "get_cells")
+            result.kind = XDC_CELL;
+        else if (cmd == "get_nets")
+            result.kind = XDC_NET;
+        else if (cmd == "get_pins")
+            result.kind = XDC_PIN;
+        else
+            log_error("targets other than 'get_ports', 'get_cells', 'get_nets' or 'get_pins' are not supported (on "
+                      "line %d)\n",
+                      lineno);
+        bool hier = false, regexp = false, nocase = false, quiet = false;
+        std::vector<std::string> patterns;
+        std::vector<XdcObjects> of_objects;
+        for (size_t i = 1; i < split.size(); i++) {
+            const std::string &arg = split.at(i);
+            if (arg == "-hierarchical" || arg == "-hier")
+                hier = true;
+            else if (arg == "-regexp")
+                regexp = true;
+            else if (arg == "-nocase")
+                nocase = true;
+            else if (arg == "-quiet")
+                quiet = true;
+            else if (arg == "-of_objects" || arg == "-of") {
+                if (++i >= split.size())
+                    log_error("expected objects after '%s' (on line %d)\n", arg.c_str(), lineno);
+                of_objects.push_back(query(split.at(i)));
+            } else if (arg == "--")
+                continue;
+            else if (arg.front() == '-')
+                log_error("option '%s' of '%s' is not supported (on line %d)\n", arg.c_str(), cmd.c_str(), lineno);
+            else
+                for (auto &pat : split_to_args(strip_quotes(arg), false))
+                    patterns.push_back(strip_quotes(pat));
+        }
+
+        if (!of_objects.empty()) {
+            if (!patterns.empty())
+                log_error("patterns together with -of_objects are not supported (on line %d)\n", lineno);
+            // Go through the pins (cell and port) of the objects, and pick the objects of the kind asked for
+            index.get_table(result.kind);
+            std::unordered_map<const void *, int> obj_idx;
+            if (result.kind == XDC_PORT || result.kind == XDC_CELL) {
+                auto &objs = (result.kind == XDC_PORT) ? index.ports : index.cells;
+                for (int i = 0; i < int(objs.size()); i++)
+                    obj_idx[objs.at(i)] = i;
+            } else if (result.kind == XDC_NET) {
+                for (int i = 0; i < int(index.nets.size()); i++)
+                    obj_idx[index.nets.at(i)] = i;
+            }
+            std::unordered_map<CellInfo *, std::unordered_map<IdString, int>> pin_idx;
+            if (result.kind == XDC_PIN)
+                for (int i = 0; i < int(index.pins.size()); i++)
+                    pin_idx[index.pins.at(i).first][index.pins.at(i).second] = i;
+            auto add_pin = [&](CellInfo *cell, IdString port) {
+                if (result.kind == XDC_NET) {
+                    NetInfo *net = cell->ports.at(port).net;
+                    if (net != nullptr && obj_idx.count(net))
+                        result.ids.push_back(obj_idx.at(net));
+                } else if (result.kind == XDC_PIN) {
+                    auto fnd = pin_idx.find(cell);
+                    if (fnd != pin_idx.end() && fnd->second.count(port))
+                        result.ids.push_back(fnd->second.at(port));
+                } else if (obj_idx.count(cell)) {
+                    result.ids.push_back(obj_idx.at(cell));
+                }
+            };
+            for (auto &objs : of_objects) {
+                if (objs.kind == result.kind)
+                    log_error("'%s' of %s is not supported (on line %d)\n", cmd.c_str(), xdc_kind_names[objs.kind],
+                              lineno);
+                for (int id : objs.ids) {
+                    if (objs.kind == XDC_PIN) {
+                        add_pin(index.pins.at(id).first, index.pins.at(id).second);
+                    } else if (objs.kind == XDC_NET) {
+                        NetInfo *net = index.nets.at(id);
+                        if (net->driver.cell != nullptr)
+                            add_pin(net->driver.cell, net->driver.port);
+                        for (auto &usr : net->users)
+                            add_pin(usr.cell, usr.port);
+                    } else {
+                        CellInfo *cell = (objs.kind == XDC_PORT) ? index.ports.at(id) : index.cells.at(id);
+                        for (auto &port : cell->ports)
+                            add_pin(cell, port.first);
+                    }
+                }
+            }
+        } else {
+            if (patterns.empty())
+                log_error("expected a pattern for '%s' (on line %d)\n", cmd.c_str(), lineno);
+            for (auto &pat : patterns) {
+                try {
+                    index.match(result.kind, pat, hier, regexp, nocase, result.ids);
+                } catch (const std::regex_error &e) {
+                    log_error("invalid regular expression '%s' (on line %d)\n", pat.c_str(), lineno);
+                }
+            }
+        }
+        // Names are unique within a kind, so this puts the results in name order
+        std::sort(result.ids.begin(), result.ids.end(),
+                  [&](int a, int b) { return index.name_of(result.kind, a) < index.name_of(result.kind, b); });
+        result.ids.erase(std::unique(result.ids.begin(), result.ids.end()), result.ids.end());
+        if (result.ids.empty() && !quiet)
+            ++empty_queries;
+        query_cache[str] = result;
+        return result;
     };
 
-    auto get_nets = [&](std::string str) {
-        std::vector<NetInfo *> tgt_nets;
-        if (str.empty() || str.front() != '[')
-            log_error("failed to parse target (on line %d)\n", lineno);
-        str = str.substr(1, str.size() - 2);
-        auto split = split_to_args(str, false);
-        if (split.size() < 1)
-            log_error("failed to parse target (on line %d)\n", lineno);
-        if (split.front() != "get_ports" && split.front() != "get_nets")
-            log_error("targets other than 'get_ports' or 'get_nets' are not supported (on line %d)\n", lineno);
-        if (split.size() < 2)
-            log_error("failed to parse target (on line %d)\n", lineno);
-        IdString netname = id(split.at(1));
-        NetInfo *maybe_net = getNetByAlias(netname);
-        if (maybe_net != nullptr)
-            tgt_nets.push_back(maybe_net);
-        return tgt_nets;
+    // Constraints are collected and applied once the whole file has been parsed
+    struct PendingProperty
+    {
+        XdcObjectKind kind;
+        int id;
+        IdString key;
+        std::string value;
     };
+    std::vector<PendingProperty> properties;
+    std::vector<std::pair<NetInfo *, double>> clocks;
 
     while (std::getline(in, line)) {
         ++lineno;
@@ -119,6 +430,14 @@ void Arch::parseXdc(std::istream &in)
         size_t cstart = line.find('#');
         if (cstart != std::string::npos)
             line = line.substr(0, cstart);
+        // Join lines continued with a trailing backslash
+        size_t last = line.find_last_not_of(" \t\r\n");
+        if (last != std::string::npos && line.at(last) == '\\') {
+            linebuf += line.substr(0, last) + " ";
+            continue;
+        }
+        line = linebuf + line;
+        linebuf.clear();
         if (isempty(line))
             continue;
 
@@ -146,10 +465,16 @@ void Arch::parseXdc(std::istream &in)
                 log_warning("[current_design] isn't supported, ignoring (on line %d)\n", lineno);
                 continue;
             }
-            std::vector<CellInfo *> dest = get_cells(arguments.at(3));
-            for (auto c : dest)
-                for (const auto &pair : arg_pairs)
-                    c->attrs[id(pair.first)] = std::string(pair.second);
+            XdcObjects dest = query(arguments.at(3));
+            if (dest.kind == XDC_PIN) {
+                log_warning("properties on pins aren't supported, ignoring (on line %d)\n", lineno);
+                continue;
+            }
+            for (const auto &pair : arg_pairs) {
+                IdString key = id(pair.first);
+                for (int obj : dest.ids)
+                    properties.push_back(PendingProperty{dest.kind, obj, key, pair.second});
+            }
         } else if (cmd == "create_clock") {
             double period = 0;
             bool got_period = false;
@@ -169,12 +494,25 @@ void Arch::parseXdc(std::istream &in)
             }
             if (!got_period)
                 log_error("found create_clock without period (on line %d)", lineno);
-            std::vector<NetInfo *> dest = get_nets(arguments.at(cursor));
-            for (auto n : dest) {
-                n->clkconstr = std::unique_ptr<ClockConstraint>(new ClockConstraint);
-                n->clkconstr->period = getDelayFromNS(period);
-                n->clkconstr->high.delay = n->clkconstr->period.delay / 2;
-                n->clkconstr->low.delay = n->clkconstr->period.delay / 2;
+            if (cursor >= int(arguments.size()))
+                log_error("found create_clock without target (on line %d)\n", lineno);
+            XdcObjects dest = query(arguments.at(cursor));
+            for (int obj : dest.ids) {
+                if (dest.kind == XDC_NET) {
+                    clocks.emplace_back(index.nets.at(obj), period);
+                } else if (dest.kind == XDC_PORT) {
+                    // The net of a top-level port has the name of the port
+                    NetInfo *net = getNetByAlias(index.ports.at(obj)->name);
+                    if (net != nullptr)
+                        clocks.emplace_back(net, period);
+                } else if (dest.kind == XDC_PIN) {
+                    auto &pin = index.pins.at(obj);
+                    NetInfo *net = pin.first->ports.at(pin.second).net;
+                    if (net != nullptr)
+                        clocks.emplace_back(net, period);
+                } else {
+                    log_error("create_clock on cells is not supported (on line %d)\n", lineno);
+                }
             }
         } else {
             log_info("ignoring unsupported XDC command '%s' (on line %d)\n", cmd.c_str(), lineno);
@@ -182,6 +520,24 @@ void Arch::parseXdc(std::istream &in)
     }
     if (!isempty(linebuf))
         log_error("unexpected end of XDC file\n");
+
+    // Apply the constraints in file order, so that later lines take precedence
+    for (auto &prop : properties) {
+        if (prop.kind == XDC_NET)
+            index.nets.at(prop.id)->attrs[prop.key] = prop.value;
+        else
+            ((prop.kind == XDC_PORT) ? index.ports : index.cells).at(prop.id)->attrs[prop.key] = prop.value;
+    }
+    for (auto &clk : clocks) {
+        NetInfo *n = clk.first;
+        n->clkconstr = std::unique_ptr<ClockConstraint>(new ClockConstraint);
+        n->clkconstr->period = getDelayFromNS(clk.second);
+        n->clkconstr->high.min_delay = n->clkconstr->high.max_delay = n->clkconstr->period.max_delay / 2;
+        n->clkconstr->low = n->clkconstr->high;
+    }
+    log_info("Applied %d properties and %d clock constraints from XDC.\n", int(properties.size()), int(clocks.size()));
+    if (empty_queries > 0)
+        log_info("    %d object queries matched nothing.\n", empty_queries);
 }
 
 NEXTPNR_NAMESPACE_END